@@ -0,0 +1,531 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// rocr_bench: micro-benchmarks for the runtime paths whose latency or
+// throughput we track between drops.  Only the public HSA API is used so the
+// binary runs against any installed runtime.  Results are written as a single
+// JSON document for CI trend dashboards.
+//
+// Usage: rocr_bench [--iterations N] [--filter SUBSTR] [--code-object FILE]
+//                  [--output FILE]
+//
+// The copy engine is fixed when the runtime first loads, so SDMA and blit
+// kernel bandwidth are measured by separate runs with HSA_ENABLE_SDMA unset
+// and set to 0; each result records which engine was selected.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "inc/hsa.h"
+#include "inc/hsa_ext_amd.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double ElapsedNs(Clock::time_point start) {
+  return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+struct Options {
+  uint32_t iterations = 1000;
+  std::string filter;
+  std::string code_object;
+  std::string output;
+};
+
+struct Result {
+  std::string name;
+  std::string params;  // JSON object body, without braces.
+  double value;
+  std::string unit;
+};
+
+std::vector<Result> results;
+Options options;
+
+bool Enabled(const char* name) {
+  return options.filter.empty() || strstr(name, options.filter.c_str()) != nullptr;
+}
+
+void Record(const std::string& name, const std::string& params, double value,
+            const char* unit) {
+  results.push_back({name, params, value, unit});
+}
+
+std::string Param(const char* key, uint64_t value) {
+  return "\"" + std::string(key) + "\": " + std::to_string(value);
+}
+
+std::string Param(const char* key, const char* value) {
+  return "\"" + std::string(key) + "\": \"" + value + "\"";
+}
+
+double Median(std::vector<double>& samples) {
+  if (samples.empty()) return 0.0;
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+#define CHECK(x)                                                                \
+  do {                                                                          \
+    hsa_status_t check_status_ = (x);                                           \
+    if (check_status_ != HSA_STATUS_SUCCESS) {                                  \
+      const char* msg = nullptr;                                                \
+      hsa_status_string(check_status_, &msg);                                   \
+      fprintf(stderr, "%s:%d: %s failed: %s\n", __FILE__, __LINE__, #x,         \
+              msg != nullptr ? msg : "unknown error");                          \
+      exit(1);                                                                  \
+    }                                                                           \
+  } while (false)
+
+struct System {
+  hsa_agent_t cpu = {0};
+  hsa_agent_t gpu = {0};
+  hsa_amd_memory_pool_t system_pool = {0};
+  hsa_amd_memory_pool_t gpu_pool = {0};
+  bool has_gpu = false;
+  bool has_gpu_pool = false;
+};
+
+hsa_status_t FindPool(hsa_amd_memory_pool_t pool, void* data) {
+  hsa_amd_segment_t segment;
+  CHECK(hsa_amd_memory_pool_get_info(pool, HSA_AMD_MEMORY_POOL_INFO_SEGMENT, &segment));
+  if (segment != HSA_AMD_SEGMENT_GLOBAL) return HSA_STATUS_SUCCESS;
+
+  bool alloc_allowed = false;
+  CHECK(hsa_amd_memory_pool_get_info(pool, HSA_AMD_MEMORY_POOL_INFO_RUNTIME_ALLOC_ALLOWED,
+                                     &alloc_allowed));
+  if (!alloc_allowed) return HSA_STATUS_SUCCESS;
+
+  *reinterpret_cast<hsa_amd_memory_pool_t*>(data) = pool;
+  return HSA_STATUS_INFO_BREAK;
+}
+
+hsa_status_t FindAgent(hsa_agent_t agent, void* data) {
+  System* sys = reinterpret_cast<System*>(data);
+  hsa_device_type_t type;
+  CHECK(hsa_agent_get_info(agent, HSA_AGENT_INFO_DEVICE, &type));
+
+  if (type == HSA_DEVICE_TYPE_CPU && sys->cpu.handle == 0) {
+    sys->cpu = agent;
+    hsa_amd_agent_iterate_memory_pools(agent, FindPool, &sys->system_pool);
+  } else if (type == HSA_DEVICE_TYPE_GPU && !sys->has_gpu) {
+    sys->gpu = agent;
+    sys->has_gpu = true;
+    sys->has_gpu_pool =
+        hsa_amd_agent_iterate_memory_pools(agent, FindPool, &sys->gpu_pool) ==
+        HSA_STATUS_INFO_BREAK;
+  }
+  return HSA_STATUS_SUCCESS;
+}
+
+System Discover() {
+  System sys;
+  CHECK(hsa_iterate_agents(FindAgent, &sys));
+  if (sys.cpu.handle == 0 || sys.system_pool.handle == 0) {
+    fprintf(stderr, "No CPU agent with an allocatable system pool.\n");
+    exit(1);
+  }
+  return sys;
+}
+
+// Cold init is the first load of the process; warm init reuses the platform
+// kept alive by the previous hsa_shut_down.
+void BenchInit() {
+  Clock::time_point start = Clock::now();
+  CHECK(hsa_init());
+  const double cold = ElapsedNs(start);
+  if (!Enabled("hsa_init")) return;
+
+  Record("hsa_init", Param("phase", "cold"), cold / 1000.0, "us");
+
+  std::vector<double> warm;
+  for (uint32_t i = 0; i < 10; i++) {
+    CHECK(hsa_shut_down());
+    start = Clock::now();
+    CHECK(hsa_init());
+    warm.push_back(ElapsedNs(start));
+  }
+  Record("hsa_init", Param("phase", "warm"), Median(warm) / 1000.0, "us");
+}
+
+// Round trip of a store on one thread waking a blocked waiter on another,
+// halved to give the one-way store-to-wake latency.
+void BenchSignalWake(const System& sys) {
+  if (!Enabled("signal_wake")) return;
+
+  struct Kind {
+    const char* name;
+    uint64_t attributes;
+  };
+  const Kind kinds[] = {{"interrupt", 0}, {"default", HSA_AMD_SIGNAL_AMD_GPU_ONLY}};
+
+  for (const Kind& kind : kinds) {
+    hsa_signal_t ping, pong;
+    CHECK(hsa_amd_signal_create(0, 1, &sys.cpu, kind.attributes, &ping));
+    CHECK(hsa_amd_signal_create(0, 1, &sys.cpu, kind.attributes, &pong));
+
+    const uint32_t iterations = options.iterations;
+    std::thread responder([&]() {
+      for (uint32_t i = 1; i <= iterations; i++) {
+        hsa_signal_wait_scacquire(ping, HSA_SIGNAL_CONDITION_EQ, i, UINT64_MAX,
+                                  HSA_WAIT_STATE_BLOCKED);
+        hsa_signal_store_screlease(pong, i);
+      }
+    });
+
+    std::vector<double> samples;
+    samples.reserve(iterations);
+    for (uint32_t i = 1; i <= iterations; i++) {
+      Clock::time_point start = Clock::now();
+      hsa_signal_store_screlease(ping, i);
+      hsa_signal_wait_scacquire(pong, HSA_SIGNAL_CONDITION_EQ, i, UINT64_MAX,
+                                HSA_WAIT_STATE_BLOCKED);
+      samples.push_back(ElapsedNs(start) / 2.0);
+    }
+    responder.join();
+
+    Record("signal_wake", Param("signal", kind.name), Median(samples), "ns");
+    CHECK(hsa_signal_destroy(ping));
+    CHECK(hsa_signal_destroy(pong));
+  }
+}
+
+// Cost of hsa_amd_signal_wait_any when only the last of N signals is
+// satisfied, so every call scans the full set.
+void BenchWaitAny(const System& sys) {
+  if (!Enabled("signal_wait_any")) return;
+
+  const uint32_t counts[] = {1, 4, 16, 64};
+  for (uint32_t count : counts) {
+    std::vector<hsa_signal_t> signals(count);
+    std::vector<hsa_signal_condition_t> conds(count, HSA_SIGNAL_CONDITION_EQ);
+    std::vector<hsa_signal_value_t> values(count, 0);
+    for (hsa_signal_t& signal : signals)
+      CHECK(hsa_amd_signal_create(1, 1, &sys.cpu, 0, &signal));
+    hsa_signal_store_relaxed(signals.back(), 0);
+
+    Clock::time_point start = Clock::now();
+    for (uint32_t i = 0; i < options.iterations; i++) {
+      hsa_signal_value_t value;
+      hsa_amd_signal_wait_any(count, &signals[0], &conds[0], &values[0], UINT64_MAX,
+                              HSA_WAIT_STATE_BLOCKED, &value);
+    }
+    Record("signal_wait_any", Param("signals", count),
+           ElapsedNs(start) / options.iterations, "ns");
+
+    for (hsa_signal_t signal : signals) CHECK(hsa_signal_destroy(signal));
+  }
+}
+
+// Packets per second through one user mode queue.  Barrier-AND packets with
+// no dependencies take the same doorbell and packet processor path as a null
+// kernel without needing a code object.
+void BenchDispatch(const System& sys) {
+  if (!Enabled("dispatch_rate") || !sys.has_gpu) return;
+
+  uint32_t queue_size = 0;
+  CHECK(hsa_agent_get_info(sys.gpu, HSA_AGENT_INFO_QUEUE_MAX_SIZE, &queue_size));
+  queue_size = std::min(queue_size, 4096u);
+
+  hsa_queue_t* queue;
+  CHECK(hsa_queue_create(sys.gpu, queue_size, HSA_QUEUE_TYPE_SINGLE, nullptr, nullptr,
+                         UINT32_MAX, UINT32_MAX, &queue));
+  hsa_signal_t done;
+  CHECK(hsa_signal_create(1, 0, nullptr, &done));
+
+  const uint32_t batch = queue_size / 2;
+  const uint32_t iterations = std::max(options.iterations, batch);
+  hsa_barrier_and_packet_t* packets =
+      reinterpret_cast<hsa_barrier_and_packet_t*>(queue->base_address);
+
+  Clock::time_point start = Clock::now();
+  for (uint32_t i = 0; i < iterations; i++) {
+    const uint64_t index = hsa_queue_add_write_index_relaxed(queue, 1);
+    while (index - hsa_queue_load_read_index_scacquire(queue) >= queue->size) {
+    }
+
+    hsa_barrier_and_packet_t* packet = &packets[index & (queue->size - 1)];
+    memset(reinterpret_cast<uint8_t*>(packet) + sizeof(uint32_t), 0,
+           sizeof(*packet) - sizeof(uint32_t));
+    const bool last = (i + 1 == iterations);
+    if (last) packet->completion_signal = done;
+
+    uint16_t header = HSA_PACKET_TYPE_BARRIER_AND << HSA_PACKET_HEADER_TYPE;
+    if (last) {
+      header |= 1 << HSA_PACKET_HEADER_BARRIER;
+      header |= HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_SCRELEASE_FENCE_SCOPE;
+    }
+    __atomic_store_n(&packet->header, header, __ATOMIC_RELEASE);
+    if (last || (i % batch) == batch - 1)
+      hsa_signal_store_screlease(queue->doorbell_signal, index);
+  }
+  hsa_signal_wait_scacquire(done, HSA_SIGNAL_CONDITION_EQ, 0, UINT64_MAX,
+                            HSA_WAIT_STATE_BLOCKED);
+  const double ns = ElapsedNs(start);
+
+  Record("dispatch_rate", Param("packet", "barrier_and"), iterations / (ns / 1e9),
+         "packets/s");
+
+  CHECK(hsa_signal_destroy(done));
+  CHECK(hsa_queue_destroy(queue));
+}
+
+// hsa_amd_memory_async_copy bandwidth by size and direction.
+void BenchCopy(const System& sys) {
+  if (!Enabled("copy_bandwidth") || !sys.has_gpu || !sys.has_gpu_pool) return;
+
+  const char* sdma = getenv("HSA_ENABLE_SDMA");
+  const char* engine = (sdma != nullptr && strcmp(sdma, "0") == 0) ? "blit_kernel" : "sdma";
+
+  const size_t max_size = 64 << 20;
+  void *host, *dev_a, *dev_b;
+  CHECK(hsa_amd_memory_pool_allocate(sys.system_pool, max_size, 0, &host));
+  CHECK(hsa_amd_memory_pool_allocate(sys.gpu_pool, max_size, 0, &dev_a));
+  CHECK(hsa_amd_memory_pool_allocate(sys.gpu_pool, max_size, 0, &dev_b));
+  CHECK(hsa_amd_agents_allow_access(1, &sys.gpu, nullptr, host));
+  memset(host, 0x5a, max_size);
+
+  struct Direction {
+    const char* name;
+    void* dst;
+    hsa_agent_t dst_agent;
+    void* src;
+    hsa_agent_t src_agent;
+  };
+  const Direction directions[] = {{"h2d", dev_a, sys.gpu, host, sys.cpu},
+                                  {"d2h", host, sys.cpu, dev_a, sys.gpu},
+                                  {"d2d", dev_b, sys.gpu, dev_a, sys.gpu}};
+  const size_t sizes[] = {4 << 10, 64 << 10, 1 << 20, 16 << 20, 64 << 20};
+
+  hsa_signal_t done;
+  CHECK(hsa_signal_create(1, 0, nullptr, &done));
+
+  for (const Direction& dir : directions) {
+    for (size_t size : sizes) {
+      const uint32_t reps = std::max<uint32_t>(4, uint32_t((256u << 20) / size));
+      std::vector<double> samples;
+      for (uint32_t i = 0; i < std::min(reps, options.iterations); i++) {
+        hsa_signal_store_relaxed(done, 1);
+        Clock::time_point start = Clock::now();
+        CHECK(hsa_amd_memory_async_copy(dir.dst, dir.dst_agent, dir.src, dir.src_agent, size,
+                                        0, nullptr, done));
+        hsa_signal_wait_scacquire(done, HSA_SIGNAL_CONDITION_LT, 1, UINT64_MAX,
+                                  HSA_WAIT_STATE_BLOCKED);
+        samples.push_back(ElapsedNs(start));
+      }
+      const std::string params = Param("direction", dir.name) + ", " + Param("engine", engine) +
+          ", " + Param("bytes", size);
+      Record("copy_bandwidth", params, double(size) / Median(samples), "GB/s");
+    }
+  }
+
+  CHECK(hsa_signal_destroy(done));
+  CHECK(hsa_amd_memory_pool_free(dev_b));
+  CHECK(hsa_amd_memory_pool_free(dev_a));
+  CHECK(hsa_amd_memory_pool_free(host));
+}
+
+// hsa_amd_memory_pool_allocate/free pairs per second with T threads sharing
+// one pool.
+void BenchPoolAlloc(const System& sys) {
+  if (!Enabled("pool_alloc")) return;
+
+  struct Target {
+    const char* name;
+    hsa_amd_memory_pool_t pool;
+    bool valid;
+  };
+  const Target targets[] = {{"system", sys.system_pool, true},
+                            {"device", sys.gpu_pool, sys.has_gpu_pool}};
+  const uint32_t thread_counts[] = {1, 2, 4, 8};
+  const size_t size = 64 << 10;
+
+  for (const Target& target : targets) {
+    if (!target.valid) continue;
+    for (uint32_t threads : thread_counts) {
+      std::atomic<uint32_t> ready(0);
+      std::atomic<bool> go(false);
+      std::vector<std::thread> workers;
+      for (uint32_t t = 0; t < threads; t++) {
+        workers.emplace_back([&]() {
+          ready++;
+          while (!go.load(std::memory_order_acquire)) {
+          }
+          for (uint32_t i = 0; i < options.iterations; i++) {
+            void* ptr;
+            CHECK(hsa_amd_memory_pool_allocate(target.pool, size, 0, &ptr));
+            CHECK(hsa_amd_memory_pool_free(ptr));
+          }
+        });
+      }
+      while (ready.load() != threads) {
+      }
+
+      Clock::time_point start = Clock::now();
+      go.store(true, std::memory_order_release);
+      for (std::thread& worker : workers) worker.join();
+      const double ns = ElapsedNs(start);
+
+      const std::string params = Param("pool", target.name) + ", " +
+          Param("threads", threads) + ", " + Param("bytes", size);
+      Record("pool_alloc", params, double(threads) * options.iterations / (ns / 1e9),
+             "ops/s");
+    }
+  }
+}
+
+// Reader, executable load and freeze for a code object supplied on the
+// command line.
+void BenchCodeObjectLoad(const System& sys) {
+  if (!Enabled("code_object_load") || options.code_object.empty() || !sys.has_gpu) return;
+
+  FILE* file = fopen(options.code_object.c_str(), "rb");
+  if (file == nullptr) {
+    fprintf(stderr, "Cannot open %s\n", options.code_object.c_str());
+    exit(1);
+  }
+  fseek(file, 0, SEEK_END);
+  std::vector<char> blob(ftell(file));
+  fseek(file, 0, SEEK_SET);
+  const bool read = fread(&blob[0], 1, blob.size(), file) == blob.size();
+  fclose(file);
+  if (!read || blob.empty()) {
+    fprintf(stderr, "Cannot read %s\n", options.code_object.c_str());
+    exit(1);
+  }
+
+  std::vector<double> samples;
+  for (uint32_t i = 0; i < std::min(options.iterations, 100u); i++) {
+    Clock::time_point start = Clock::now();
+    hsa_code_object_reader_t reader;
+    CHECK(hsa_code_object_reader_create_from_memory(&blob[0], blob.size(), &reader));
+    hsa_executable_t executable;
+    CHECK(hsa_executable_create_alt(HSA_PROFILE_FULL, HSA_DEFAULT_FLOAT_ROUNDING_MODE_DEFAULT,
+                                    nullptr, &executable));
+    CHECK(hsa_executable_load_agent_code_object(executable, sys.gpu, reader, nullptr,
+                                                nullptr));
+    CHECK(hsa_executable_freeze(executable, nullptr));
+    samples.push_back(ElapsedNs(start));
+
+    CHECK(hsa_executable_destroy(executable));
+    CHECK(hsa_code_object_reader_destroy(reader));
+  }
+  Record("code_object_load", Param("bytes", blob.size()), Median(samples) / 1000.0, "us");
+}
+
+void WriteResults() {
+  FILE* out = stdout;
+  if (!options.output.empty()) {
+    out = fopen(options.output.c_str(), "w");
+    if (out == nullptr) {
+      fprintf(stderr, "Cannot open %s\n", options.output.c_str());
+      exit(1);
+    }
+  }
+
+  uint16_t major = 0, minor = 0;
+  hsa_system_get_info(HSA_SYSTEM_INFO_VERSION_MAJOR, &major);
+  hsa_system_get_info(HSA_SYSTEM_INFO_VERSION_MINOR, &minor);
+
+  fprintf(out, "{\n  \"runtime\": \"%u.%u\",\n  \"iterations\": %u,\n  \"results\": [", major,
+          minor, options.iterations);
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result& r = results[i];
+    fprintf(out, "%s\n    {\"name\": \"%s\", \"params\": {%s}, \"value\": %.3f, \"unit\": \"%s\"}",
+            i == 0 ? "" : ",", r.name.c_str(), r.params.c_str(), r.value, r.unit.c_str());
+  }
+  fprintf(out, "\n  ]\n}\n");
+
+  if (out != stdout) fclose(out);
+}
+
+void ParseOptions(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    const bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "--iterations") == 0 && has_value) {
+      options.iterations = std::max(1, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--filter") == 0 && has_value) {
+      options.filter = argv[++i];
+    } else if (strcmp(argv[i], "--code-object") == 0 && has_value) {
+      options.code_object = argv[++i];
+    } else if (strcmp(argv[i], "--output") == 0 && has_value) {
+      options.output = argv[++i];
+    } else {
+      fprintf(stderr,
+              "Usage: %s [--iterations N] [--filter SUBSTR] [--code-object FILE] "
+              "[--output FILE]\n",
+              argv[0]);
+      exit(1);
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  ParseOptions(argc, argv);
+
+  BenchInit();
+  const System sys = Discover();
+
+  BenchSignalWake(sys);
+  BenchWaitAny(sys);
+  BenchDispatch(sys);
+  BenchCopy(sys);
+  BenchPoolAlloc(sys);
+  BenchCodeObjectLoad(sys);
+
+  WriteResults();
+  CHECK(hsa_shut_down());
+  return 0;
+}
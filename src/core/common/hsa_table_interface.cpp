@@ -883,6 +883,15 @@ hsa_status_t HSA_API
                                      agent, agent_tick, system_tick);
 }
 
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API
+    hsa_amd_profiling_convert_ticks_to_system_domain(hsa_agent_t agent,
+                                                     const uint64_t* agent_ticks,
+                                                     uint64_t* system_ticks, size_t count) {
+  return amdExtTable->hsa_amd_profiling_convert_ticks_to_system_domain_fn(agent, agent_ticks,
+                                                                          system_ticks, count);
+}
+
 // Mirrors Amd Extension Apis
 hsa_status_t HSA_API
     hsa_amd_signal_async_handler(hsa_signal_t signal,
@@ -912,6 +921,12 @@ uint32_t HSA_API
                                      wait_hint, satisfying_value);
 }
 
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_signal_wait_stats(hsa_signal_t signal,
+                                               hsa_amd_signal_wait_stats_t* stats) {
+  return amdExtTable->hsa_amd_signal_wait_stats_fn(signal, stats);
+}
+
 // Mirrors Amd Extension Apis
 hsa_status_t HSA_API hsa_amd_queue_cu_set_mask(const hsa_queue_t* queue,
                                                uint32_t num_cu_mask_count,
@@ -920,6 +935,31 @@ hsa_status_t HSA_API hsa_amd_queue_cu_set_mask(const hsa_queue_t* queue,
                                      queue, num_cu_mask_count, cu_mask);
 }
 
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_queue_submit(hsa_queue_t* queue, const void* packets,
+                                          uint32_t count, uint64_t timeout_ns) {
+  return amdExtTable->hsa_amd_queue_submit_fn(queue, packets, count, timeout_ns);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_queue_set_agent_dispatch_handler(hsa_queue_t* queue,
+                                                              hsa_amd_agent_dispatch_handler handler,
+                                                              void* data) {
+  return amdExtTable->hsa_amd_queue_set_agent_dispatch_handler_fn(queue, handler, data);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_queue_set_class(hsa_queue_t* queue,
+                                             hsa_amd_queue_class_t queue_class, uint32_t weight) {
+  return amdExtTable->hsa_amd_queue_set_class_fn(queue, queue_class, weight);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_queue_get_progress_stats(const hsa_queue_t* queue,
+                                                      hsa_amd_queue_progress_stats_t* stats) {
+  return amdExtTable->hsa_amd_queue_get_progress_stats_fn(queue, stats);
+}
+
 // Mirrors Amd Extension Apis
 hsa_status_t HSA_API
     hsa_amd_memory_pool_get_info(hsa_amd_memory_pool_t memory_pool,
@@ -951,6 +991,11 @@ hsa_status_t HSA_API hsa_amd_memory_pool_free(void* ptr) {
   return amdExtTable->hsa_amd_memory_pool_free_fn(ptr);
 }
 
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_memory_pool_free_async(void* ptr, hsa_signal_t signal) {
+  return amdExtTable->hsa_amd_memory_pool_free_async_fn(ptr, signal);
+}
+
 // Mirrors Amd Extension Apis
 hsa_status_t HSA_API
     hsa_amd_memory_async_copy(void* dst, hsa_agent_t dst_agent, const void* src,
@@ -974,6 +1019,16 @@ hsa_status_t HSA_API hsa_amd_memory_async_copy_rect(
                                                         dep_signals, completion_signal);
 }
 
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_memory_async_copy_batch(
+    uint32_t num_copies, const hsa_amd_memory_copy_desc_t* copies, hsa_agent_t dst_agent,
+    hsa_agent_t src_agent, uint32_t num_dep_signals, const hsa_signal_t* dep_signals,
+    hsa_signal_t completion_signal) {
+  return amdExtTable->hsa_amd_memory_async_copy_batch_fn(num_copies, copies, dst_agent, src_agent,
+                                                         num_dep_signals, dep_signals,
+                                                         completion_signal);
+}
+
 // Mirrors Amd Extension Apis
 hsa_status_t HSA_API hsa_amd_agent_memory_pool_get_info(
     hsa_agent_t agent, hsa_amd_memory_pool_t memory_pool,
@@ -1029,6 +1084,11 @@ hsa_status_t HSA_API hsa_amd_memory_unlock(void* host_ptr) {
 
 }
 
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_memory_lock_cache_invalidate(void* host_ptr, size_t size) {
+  return amdExtTable->hsa_amd_memory_lock_cache_invalidate_fn(host_ptr, size);
+}
+
 // Mirrors Amd Extension Apis
 hsa_status_t HSA_API
     hsa_amd_memory_fill(void* ptr, uint32_t value, size_t count) {
@@ -1136,6 +1196,14 @@ hsa_status_t hsa_amd_queue_intercept_register(hsa_queue_t* queue,
   return amdExtTable->hsa_amd_queue_intercept_register_fn(queue, callback, user_data);
 }
 
+// Mirrors Amd Extension Apis
+hsa_status_t hsa_amd_queue_intercept_set_mode(hsa_queue_t* queue,
+                                              hsa_amd_queue_intercept_handler callback,
+                                              void* user_data,
+                                              hsa_amd_queue_intercept_mode_t mode) {
+  return amdExtTable->hsa_amd_queue_intercept_set_mode_fn(queue, callback, user_data, mode);
+}
+
 // Mirrors Amd Extension Apis
 hsa_status_t HSA_API hsa_amd_queue_set_priority(hsa_queue_t* queue,
                                                 hsa_amd_queue_priority_t priority) {
@@ -1154,3 +1222,297 @@ hsa_status_t HSA_API hsa_amd_deregister_deallocation_callback(void* ptr,
                                                       hsa_amd_deallocation_callback_t callback) {
   return amdExtTable->hsa_amd_deregister_deallocation_callback_fn(ptr, callback);
 }
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_executable_load_agent_code_objects(
+    hsa_executable_t executable, uint32_t num_agents, const hsa_agent_t* agents,
+    hsa_code_object_reader_t code_object_reader, const char* options,
+    hsa_loaded_code_object_t* loaded_code_objects) {
+  return amdExtTable->hsa_amd_executable_load_agent_code_objects_fn(
+      executable, num_agents, agents, code_object_reader, options, loaded_code_objects);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_executable_get_kernels(hsa_executable_t executable,
+                                                    hsa_amd_executable_kernel_t* kernels,
+                                                    uint32_t* count) {
+  return amdExtTable->hsa_amd_executable_get_kernels_fn(executable, kernels, count);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_memory_async_fill(void* ptr, uint32_t value, uint32_t value_size,
+                                               size_t count, uint32_t num_dep_signals,
+                                               const hsa_signal_t* dep_signals,
+                                               hsa_signal_t completion_signal) {
+  return amdExtTable->hsa_amd_memory_async_fill_fn(ptr, value, value_size, count,
+                                                   num_dep_signals, dep_signals,
+                                                   completion_signal);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_memory_async_fill_rect(
+    const hsa_pitched_ptr_t* dst, const hsa_dim3_t* dst_offset, const hsa_dim3_t* range,
+    uint32_t value, uint32_t value_size, uint32_t num_dep_signals,
+    const hsa_signal_t* dep_signals, hsa_signal_t completion_signal) {
+  return amdExtTable->hsa_amd_memory_async_fill_rect_fn(dst, dst_offset, range, value,
+                                                        value_size, num_dep_signals, dep_signals,
+                                                        completion_signal);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_agent_get_memory_pools(hsa_agent_t agent, hsa_agent_t accessing_agent,
+                                                    hsa_amd_memory_pool_desc_t* memory_pools,
+                                                    uint32_t* count) {
+  return amdExtTable->hsa_amd_agent_get_memory_pools_fn(agent, accessing_agent, memory_pools,
+                                                        count);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_memory_async_prefetch(const void* ptr, size_t size,
+                                                   hsa_agent_t agent, uint32_t num_dep_signals,
+                                                   const hsa_signal_t* dep_signals,
+                                                   hsa_signal_t completion_signal) {
+  return amdExtTable->hsa_amd_memory_async_prefetch_fn(ptr, size, agent, num_dep_signals,
+                                                       dep_signals, completion_signal);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_launch_template_create(hsa_queue_t* queue,
+                                                    hsa_executable_symbol_t kernel,
+                                                    const hsa_kernel_dispatch_packet_t* dispatch,
+                                                    hsa_amd_launch_template_t* launch) {
+  return amdExtTable->hsa_amd_launch_template_create_fn(queue, kernel, dispatch, launch);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_launch_template_dispatch(hsa_amd_launch_template_t launch,
+                                                      const void* kernarg,
+                                                      hsa_signal_t completion_signal) {
+  return amdExtTable->hsa_amd_launch_template_dispatch_fn(launch, kernarg, completion_signal);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_launch_template_destroy(hsa_amd_launch_template_t launch) {
+  return amdExtTable->hsa_amd_launch_template_destroy_fn(launch);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_queue_capture_begin(hsa_queue_t* queue) {
+  return amdExtTable->hsa_amd_queue_capture_begin_fn(queue);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_queue_capture_end(hsa_queue_t* queue, hsa_amd_graph_t* graph) {
+  return amdExtTable->hsa_amd_queue_capture_end_fn(queue, graph);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_graph_launch(hsa_amd_graph_t graph, hsa_queue_t* queue,
+                                          hsa_signal_t completion_signal) {
+  return amdExtTable->hsa_amd_graph_launch_fn(graph, queue, completion_signal);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_graph_destroy(hsa_amd_graph_t graph) {
+  return amdExtTable->hsa_amd_graph_destroy_fn(graph);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_queue_create_device_enqueue(
+    hsa_agent_t agent, uint32_t size, hsa_queue_type32_t type,
+    void (*callback)(hsa_status_t status, hsa_queue_t* source, void* data), void* data,
+    uint32_t private_segment_size, uint32_t group_segment_size, hsa_queue_t** queue) {
+  return amdExtTable->hsa_amd_queue_create_device_enqueue_fn(
+      agent, size, type, callback, data, private_segment_size, group_segment_size, queue);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_queue_fence(uint32_t num_queues, hsa_queue_t* const* queues,
+                                         uint32_t num_copy_agents,
+                                         const hsa_agent_t* copy_agents) {
+  return amdExtTable->hsa_amd_queue_fence_fn(num_queues, queues, num_copy_agents, copy_agents);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_agent_link_cost(hsa_agent_t src_agent, hsa_agent_t dst_agent,
+                                             hsa_amd_link_cost_t* cost) {
+  return amdExtTable->hsa_amd_agent_link_cost_fn(src_agent, dst_agent, cost);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_image_import_async(hsa_agent_t agent, const void* src_memory,
+                                                size_t src_row_pitch, size_t src_slice_pitch,
+                                                hsa_ext_image_t dst_image,
+                                                const hsa_ext_image_region_t* image_region,
+                                                uint32_t num_dep_signals,
+                                                const hsa_signal_t* dep_signals,
+                                                hsa_signal_t completion_signal) {
+  return amdExtTable->hsa_amd_image_import_async_fn(agent, src_memory, src_row_pitch,
+                                                    src_slice_pitch, dst_image, image_region,
+                                                    num_dep_signals, dep_signals,
+                                                    completion_signal);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_image_export_async(hsa_agent_t agent, hsa_ext_image_t src_image,
+                                                void* dst_memory, size_t dst_row_pitch,
+                                                size_t dst_slice_pitch,
+                                                const hsa_ext_image_region_t* image_region,
+                                                uint32_t num_dep_signals,
+                                                const hsa_signal_t* dep_signals,
+                                                hsa_signal_t completion_signal) {
+  return amdExtTable->hsa_amd_image_export_async_fn(agent, src_image, dst_memory, dst_row_pitch,
+                                                    dst_slice_pitch, image_region,
+                                                    num_dep_signals, dep_signals,
+                                                    completion_signal);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_image_copy_async(hsa_agent_t agent, hsa_ext_image_t src_image,
+                                              const hsa_dim3_t* src_offset,
+                                              hsa_ext_image_t dst_image,
+                                              const hsa_dim3_t* dst_offset,
+                                              const hsa_dim3_t* range, uint32_t num_dep_signals,
+                                              const hsa_signal_t* dep_signals,
+                                              hsa_signal_t completion_signal) {
+  return amdExtTable->hsa_amd_image_copy_async_fn(agent, src_image, src_offset, dst_image,
+                                                  dst_offset, range, num_dep_signals, dep_signals,
+                                                  completion_signal);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_image_clear_async(hsa_agent_t agent, hsa_ext_image_t image,
+                                               const void* data,
+                                               const hsa_ext_image_region_t* image_region,
+                                               uint32_t num_dep_signals,
+                                               const hsa_signal_t* dep_signals,
+                                               hsa_signal_t completion_signal) {
+  return amdExtTable->hsa_amd_image_clear_async_fn(agent, image, data, image_region,
+                                                   num_dep_signals, dep_signals,
+                                                   completion_signal);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_profile_pool_create(hsa_agent_t agent, uint32_t command_size,
+                                                 uint32_t output_size, uint32_t num_buffers,
+                                                 uint32_t batch_size,
+                                                 hsa_amd_profile_data_callback_t callback,
+                                                 void* user_data, hsa_amd_profile_pool_t* pool) {
+  return amdExtTable->hsa_amd_profile_pool_create_fn(agent, command_size, output_size, num_buffers,
+                                                     batch_size, callback, user_data, pool);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_profile_pool_acquire(hsa_amd_profile_pool_t pool,
+                                                  hsa_amd_profile_buffer_t* buffer) {
+  return amdExtTable->hsa_amd_profile_pool_acquire_fn(pool, buffer);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_profile_pool_submit(hsa_amd_profile_pool_t pool, uint32_t id,
+                                                 hsa_signal_t ready_signal) {
+  return amdExtTable->hsa_amd_profile_pool_submit_fn(pool, id, ready_signal);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_profile_pool_flush(hsa_amd_profile_pool_t pool) {
+  return amdExtTable->hsa_amd_profile_pool_flush_fn(pool);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_profile_pool_destroy(hsa_amd_profile_pool_t pool) {
+  return amdExtTable->hsa_amd_profile_pool_destroy_fn(pool);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_agents_allow_access_batch(uint32_t num_agents,
+                                                       const hsa_agent_t* agents,
+                                                       const uint32_t* flags,
+                                                       uint32_t num_ptrs,
+                                                       const void* const* ptrs) {
+  return amdExtTable->hsa_amd_agents_allow_access_batch_fn(num_agents, agents, flags, num_ptrs,
+                                                           ptrs);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_memory_tag_set(uint32_t tag) {
+  return amdExtTable->hsa_amd_memory_tag_set_fn(tag);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_memory_budget_set(hsa_amd_memory_pool_t pool, uint32_t tag,
+                                               size_t limit,
+                                               hsa_amd_memory_budget_callback_t callback,
+                                               void* data) {
+  return amdExtTable->hsa_amd_memory_budget_set_fn(pool, tag, limit, callback, data);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_memory_usage_get(hsa_amd_memory_pool_t pool, uint32_t tag,
+                                              hsa_amd_memory_usage_t* usage) {
+  return amdExtTable->hsa_amd_memory_usage_get_fn(pool, tag, usage);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_signal_group_wait_n(hsa_signal_group_t signal_group,
+                                                 uint32_t num_required,
+                                                 hsa_signal_condition_t condition,
+                                                 hsa_signal_value_t compare_value,
+                                                 uint64_t timeout_hint,
+                                                 hsa_wait_state_t wait_state_hint,
+                                                 uint32_t* num_satisfied) {
+  return amdExtTable->hsa_amd_signal_group_wait_n_fn(signal_group, num_required, condition,
+                                                     compare_value, timeout_hint, wait_state_hint,
+                                                     num_satisfied);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_signal_group_wait_all(hsa_signal_group_t signal_group,
+                                                   hsa_signal_condition_t condition,
+                                                   hsa_signal_value_t compare_value,
+                                                   uint64_t timeout_hint,
+                                                   hsa_wait_state_t wait_state_hint,
+                                                   uint32_t* num_satisfied) {
+  return amdExtTable->hsa_amd_signal_group_wait_all_fn(signal_group, condition, compare_value,
+                                                       timeout_hint, wait_state_hint,
+                                                       num_satisfied);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_memory_file_read_async(int fd, uint64_t file_offset, void* dst,
+                                                    size_t size, hsa_agent_t dst_agent,
+                                                    uint32_t num_dep_signals,
+                                                    const hsa_signal_t* dep_signals,
+                                                    hsa_signal_t completion_signal) {
+  return amdExtTable->hsa_amd_memory_file_read_async_fn(fd, file_offset, dst, size, dst_agent,
+                                                        num_dep_signals, dep_signals,
+                                                        completion_signal);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_memory_file_write_async(int fd, uint64_t file_offset,
+                                                     const void* src, size_t size,
+                                                     hsa_agent_t src_agent,
+                                                     uint32_t num_dep_signals,
+                                                     const hsa_signal_t* dep_signals,
+                                                     hsa_signal_t completion_signal) {
+  return amdExtTable->hsa_amd_memory_file_write_async_fn(fd, file_offset, src, size, src_agent,
+                                                         num_dep_signals, dep_signals,
+                                                         completion_signal);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_memory_async_copy_multicast(
+    uint32_t num_dsts, void* const* dsts, const hsa_agent_t* dst_agents, const void* src,
+    hsa_agent_t src_agent, size_t size, uint32_t num_dep_signals,
+    const hsa_signal_t* dep_signals, hsa_signal_t completion_signal) {
+  return amdExtTable->hsa_amd_memory_async_copy_multicast_fn(num_dsts, dsts, dst_agents, src,
+                                                             src_agent, size, num_dep_signals,
+                                                             dep_signals, completion_signal);
+}
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_thread_policy_set(hsa_amd_thread_class_t thread_class,
+                                               const hsa_amd_thread_policy_t* policy) {
+  return amdExtTable->hsa_amd_thread_policy_set_fn(thread_class, policy);
+}
@@ -48,6 +48,8 @@
 #include <assert.h>
 #include <vector>
 
+#include "inc/hsa_ext_amd.h"
+
 #include "core/inc/checked.h"
 #include "core/inc/isa.h"
 #include "core/inc/queue.h"
@@ -62,6 +64,12 @@ typedef void (*HsaEventCallback)(hsa_status_t status, hsa_queue_t* source,
 
 class MemoryRegion;
 
+// @brief Destination range of a memory fill, @p size is in bytes.
+struct FillRange {
+  void* ptr;
+  size_t size;
+};
+
 // Agent is intended to be an pure interface class and may be wrapped or
 // replaced by tools libraries. All funtions other than Convert, node_id,
 // device_type, and public_handle must be virtual.
@@ -162,6 +170,28 @@ class Agent : public Checked<0xF6BC25EB17E6F917> {
     return HSA_STATUS_ERROR;
   }
 
+  // @brief Submit several DMA copies sharing dependencies and a completion
+  // signal. This call does not wait until the copies are finished.
+  //
+  // @details The agent must be able to access every source and destination.
+  // The copies will be performed after all signals in @p dep_signals have
+  // value of 0. Once every copy has completed, the value of out_signal is
+  // decremented.
+  //
+  // @param [in] copies List of copies.
+  // @param [in] dst_agent Agent that owns the destinations.
+  // @param [in] src_agent Agent that owns the sources.
+  // @param [in] dep_signals Array of signal dependency.
+  // @param [in] out_signal Completion signal.
+  //
+  // @retval HSA_STATUS_SUCCESS The memory copies are submitted.
+  virtual hsa_status_t DmaCopyBatch(const std::vector<hsa_amd_memory_copy_desc_t>& copies,
+                                    core::Agent& dst_agent, core::Agent& src_agent,
+                                    std::vector<core::Signal*>& dep_signals,
+                                    core::Signal& out_signal) {
+    return HSA_STATUS_ERROR;
+  }
+
   // @brief Submit DMA command to set the content of a pointer and wait
   // until it is finished.
   //
@@ -176,6 +206,24 @@ class Agent : public Checked<0xF6BC25EB17E6F917> {
     return HSA_STATUS_ERROR;
   }
 
+  // @brief Submit DMA commands to set the content of @p ranges. The call is
+  // non blocking.
+  //
+  // @details The agent must be able to access every range. Ranges start and
+  // end on dword boundaries.
+  //
+  // @param [in] ranges Memory to be set.
+  // @param [in] value The pattern that will be used to set each dword.
+  // @param [in] dep_signals Signals that must reach zero before the fill starts.
+  // @param [out] out_signal Decremented once, after every range is set.
+  //
+  // @retval HSA_STATUS_SUCCESS The memory fill is submitted.
+  virtual hsa_status_t DmaFill(const std::vector<FillRange>& ranges, uint32_t value,
+                               std::vector<core::Signal*>& dep_signals,
+                               core::Signal& out_signal) {
+    return HSA_STATUS_ERROR;
+  }
+
   // @brief Invoke the user provided callback for each region accessible by
   // this agent.
   //
@@ -250,10 +298,14 @@ class Agent : public Checked<0xF6BC25EB17E6F917> {
   __forceinline bool profiling_enabled() const { return profiling_enabled_; }
 
   // @brief Setter for profiling_enabled_.
+  // Set the flag first so blits created while existing ones are being
+  // switched over see the new mode.
   virtual hsa_status_t profiling_enabled(bool enable) {
+    const bool previous = profiling_enabled_;
+    profiling_enabled_ = enable;
     const hsa_status_t stat = EnableDmaProfiling(enable);
-    if (HSA_STATUS_SUCCESS == stat) {
-      profiling_enabled_ = enable;
+    if (HSA_STATUS_SUCCESS != stat) {
+      profiling_enabled_ = previous;
     }
 
     return stat;
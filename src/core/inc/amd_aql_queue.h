@@ -43,6 +43,8 @@
 #ifndef HSA_RUNTIME_CORE_INC_AMD_HW_AQL_COMMAND_PROCESSOR_H_
 #define HSA_RUNTIME_CORE_INC_AMD_HW_AQL_COMMAND_PROCESSOR_H_
 
+#include <set>
+
 #include "core/inc/runtime.h"
 #include "core/inc/signal.h"
 #include "core/inc/queue.h"
@@ -64,10 +66,17 @@ class AqlQueue : public core::Queue, private core::LocalSignal, public core::Doo
   // Acquires/releases queue resources and requests HW schedule/deschedule.
   AqlQueue(GpuAgent* agent, size_t req_size_pkts, HSAuint32 node_id,
            ScratchInfo& scratch, core::HsaEventCallback callback,
-           void* err_data, bool is_kv = false);
+           void* err_data, bool is_kv = false, bool device_ring = false);
 
   ~AqlQueue();
 
+  /// @brief Fill up to @p max entries of @p stats with the queues of the
+  /// process and return the number of queues.
+  static uint64_t CollectStats(hsa_amd_stats_queue_t* stats, uint32_t max);
+
+  /// @brief Agent executing the queue.
+  GpuAgent* agent() const { return agent_; }
+
   /// @brief Queue interfaces
   hsa_status_t Inactivate() override;
 
@@ -183,8 +192,8 @@ class AqlQueue : public core::Queue, private core::LocalSignal, public core::Doo
   /// @return hsa_status_t
   hsa_status_t SetCUMasking(const uint32_t num_cu_mask_count, const uint32_t* cu_mask) override;
 
-  // @brief Submits a block of PM4 and waits until it has been executed.
-  void ExecutePM4(uint32_t* cmd_data, size_t cmd_size_b) override;
+  // @brief Submits a block of PM4 and, if @p wait, waits until it has been executed.
+  void ExecutePM4(uint32_t* cmd_data, size_t cmd_size_b, bool wait = true) override;
 
   /// @brief Update signal value using Relaxed semantics
   void StoreRelaxed(hsa_signal_value_t value) override;
@@ -192,6 +201,9 @@ class AqlQueue : public core::Queue, private core::LocalSignal, public core::Doo
   /// @brief Update signal value using Release semantics
   void StoreRelease(hsa_signal_value_t value) override;
 
+  /// @brief Release a ring buffer allocated for a queue of @p agent.
+  static void FreeRingBuffer(const GpuAgent& agent, void* ring, uint32_t alloc_bytes);
+
  protected:
   bool _IsA(Queue::rtti_t id) const override { return id == &rtti_id_; }
 
@@ -200,13 +212,22 @@ class AqlQueue : public core::Queue, private core::LocalSignal, public core::Doo
   uint32_t ComputeRingBufferMaxPkts();
 
   // (De)allocates and (de)registers ring_buf_.
+  // Rings of destroyed queues are recycled through the agent's ring cache when @p recycle is set.
+  // Device enqueue rings are neither taken from nor returned to the cache.
   void AllocRegisteredRingBuffer(uint32_t queue_size_pkts);
-  void FreeRegisteredRingBuffer();
+
+  // Places a device enqueue ring in host visible frame buffer, returns false if there is none.
+  bool AllocDeviceRingBuffer(uint32_t queue_size_pkts);
+  void FreeRegisteredRingBuffer(bool recycle = false);
 
   /// @brief Abstracts the file handle use for double mapping queues.
   void CloseRingBufferFD(const char* ring_buf_shm_path, int fd) const;
   int CreateRingBufferFD(const char* ring_buf_shm_path, uint32_t ring_buf_phys_size_bytes) const;
 
+  /// @brief Write the hardware doorbell for doorbell value @p value.  Caller must hold the
+  /// legacy doorbell lock.
+  void RingLegacyDoorbell(uint64_t value);
+
   /// @brief Define the Scratch Buffer Descriptor and related parameters
   /// that enable kernel access scratch memory
   void InitScratchSRD();
@@ -224,6 +245,12 @@ class AqlQueue : public core::Queue, private core::LocalSignal, public core::Doo
   // This may be larger than (amd_queue_.hsa_queue.size * sizeof(AqlPacket)).
   uint32_t ring_buf_alloc_bytes_;
 
+  // Largest legacy doorbell value stored, and the number of legacy doorbell stores published
+  // and rung.  Rings are coalesced under amd_queue_.legacy_doorbell_lock.
+  volatile uint64_t legacy_doorbell_value_;
+  volatile uint64_t legacy_doorbell_requests_;
+  volatile uint64_t legacy_doorbell_served_;
+
   // Id of the Queue used in communication with thunk
   HSA_QUEUEID queue_id_;
 
@@ -241,6 +268,12 @@ class AqlQueue : public core::Queue, private core::LocalSignal, public core::Doo
   // Handle of scratch memory descriptor
   ScratchInfo queue_scratch_;
 
+  // Largest scratch per thread requested by the queue's dispatches.
+  size_t scratch_high_water_;
+
+  // Admission slot among the agent's scratch waiters, zero when not waiting.
+  uint64_t scratch_ticket_;
+
   AMD::callback_t<core::HsaEventCallback> errors_callback_;
 
   void* errors_data_;
@@ -248,10 +281,30 @@ class AqlQueue : public core::Queue, private core::LocalSignal, public core::Doo
   // Is KV device queue
   bool is_kv_queue_;
 
-  // GPU-visible indirect buffer holding PM4 commands.
+  // Ring is written by device-side producers, see hsa_amd_queue_create_device_enqueue.
+  bool device_ring_;
+
+  // ring_buf_ was allocated from the agent's frame buffer through Runtime::AllocateMemory.
+  bool ring_buf_in_vram_;
+
+  // GPU-visible ring of indirect buffers holding PM4 commands, pm4_ib_size_b_ bytes each.
+  static const uint32_t kPM4IBSlots = 4;
   void* pm4_ib_buf_;
   uint32_t pm4_ib_size_b_;
-  KernelMutex pm4_ib_mutex_;
+
+  // Slot i is used by tickets i, i + kPM4IBSlots, ...  A ticket waits for its turn, then for the
+  // packet of the previous user of the slot to be consumed before overwriting the IB.
+  struct PM4IBSlot {
+    std::atomic<uint64_t> turn;
+    uint64_t packet_index;
+  };
+  PM4IBSlot pm4_ib_slots_[kPM4IBSlots];
+  std::atomic<uint64_t> pm4_ib_ticket_;
+  // Notified when a slot's turn passes to its next ticket.
+  ProgressEvent pm4_ib_turn_event_;
+
+  // Fills an AQL slot with commands running a PM4 IB, encoded for the agent's ISA.
+  void (*pm4_slot_encoder_)(uint32_t* slot_data, const void* ib, uint32_t ib_size_dw);
 
   // Error handler control variable.
   std::atomic<uint32_t> dynamicScratchState;
@@ -263,15 +316,22 @@ class AqlQueue : public core::Queue, private core::LocalSignal, public core::Doo
   // Thunk dispatch and wavefront scheduling priority
   HSA_QUEUE_PRIORITY priority_;
 
+  // Queue has a scheduling class in the agent's QueueScheduler.
+  bool scheduled_;
+  friend class QueueScheduler;
+
   // Shared event used for queue errors
   static HsaEvent* queue_event_;
 
   // Queue count - used to ref count queue_event_
   static std::atomic<uint32_t> queue_count_;
 
-  // Mutex for queue_event_ manipulation
+  // Mutex for queue_event_ manipulation and ::live_queues_
   static KernelMutex queue_lock_;
 
+  // Fully constructed queues, for CollectStats.
+  static std::set<AqlQueue*> live_queues_;
+
   static int rtti_id_;
 
   // Forbid copying and moving of this object
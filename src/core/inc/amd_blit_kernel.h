@@ -43,13 +43,17 @@
 #ifndef HSA_RUNTIME_CORE_INC_AMD_BLIT_KERNEL_H_
 #define HSA_RUNTIME_CORE_INC_AMD_BLIT_KERNEL_H_
 
-#include <map>
-#include <mutex>
 #include <stdint.h>
+#include <deque>
+#include <utility>
 
 #include "core/inc/blit.h"
+#include "core/util/locks.h"
 
 namespace amd {
+class GpuAgent;
+class MemoryRegion;
+
 class BlitKernel : public core::Blit {
  public:
   explicit BlitKernel(core::Queue* queue);
@@ -97,6 +101,18 @@ class BlitKernel : public core::Blit {
       std::vector<core::Signal*>& dep_signals,
       core::Signal& out_signal) override;
 
+  /// @brief Submit one dispatch per copy in @p copies with a single queue
+  /// reservation and doorbell update. The copies run concurrently and
+  /// @p out_signal is decremented once, after all of them have finished.
+  ///
+  /// @param copies List of copies.
+  /// @param dep_signals Arrays of dependent signal.
+  /// @param out_signal Output signal.
+  virtual hsa_status_t SubmitLinearCopyBatch(
+      const std::vector<hsa_amd_memory_copy_desc_t>& copies,
+      std::vector<core::Signal*>& dep_signals,
+      core::Signal& out_signal) override;
+
   /// @brief Submit an AQL packet to perform memory fill. The call is blocking
   /// until the command execution is finished.
   ///
@@ -106,8 +122,30 @@ class BlitKernel : public core::Blit {
   virtual hsa_status_t SubmitLinearFillCommand(void* ptr, uint32_t value,
                                                size_t count) override;
 
+  /// @brief Submit one fill dispatch per range in @p ranges with a single
+  /// queue reservation. The fills run concurrently and @p out_signal is
+  /// decremented once, after all of them have finished.
+  ///
+  /// @param ranges Ranges to fill, dword aligned.
+  /// @param value Value to be set to each dword.
+  /// @param dep_signals Arrays of dependent signal.
+  /// @param out_signal Output signal.
+  virtual hsa_status_t SubmitLinearFillCommand(const std::vector<core::FillRange>& ranges,
+                                               uint32_t value,
+                                               std::vector<core::Signal*>& dep_signals,
+                                               core::Signal& out_signal) override;
+
   virtual hsa_status_t EnableProfiling(bool enable) override;
 
+  virtual hsa_status_t SubmitBarrier(std::vector<core::Signal*>& dep_signals,
+                                     core::Signal& out_signal) override;
+
+  /// @brief Number of AQL packets, including barriers, not yet processed.
+  virtual uint64_t Backlog() override;
+
+  /// @brief Packets of the queue, including barriers, in bytes.
+  virtual void RingUsage(uint64_t& used, uint64_t& size) override;
+
  private:
   union KernelArgs {
     struct __ALIGNED__(16) {
@@ -144,7 +182,8 @@ class BlitKernel : public core::Blit {
   };
 
   /// Reserve a slot in the queue buffer. The call will wait until the queue
-  /// buffer has a room.
+  /// buffer has a room and the kernarg slots of the reserved packets are free.
+  /// A kernarg fence may be placed ahead of the returned index.
   uint64_t AcquireWriteIndex(uint32_t num_packet);
 
   /// Update the queue doorbell register with ::write_index. This
@@ -155,39 +194,63 @@ class BlitKernel : public core::Blit {
   void PopulateQueue(uint64_t index, uint64_t code_handle, void* args,
                      uint32_t grid_size_x, hsa_signal_t completion_signal);
 
-  KernelArgs* ObtainAsyncKernelCopyArg();
+  /// Returns the signal to complete for @p out_signal.  AQL packets can only
+  /// decrement their signal, so timeline signals are completed through a
+  /// proxy.  Returns null if the proxy could not be created.
+  core::Signal* CompletionSignal(core::Signal& out_signal);
 
-  /// AQL code object and size for each kernel.
-  enum class KernelType {
-    CopyAligned,
-    CopyMisaligned,
-    Fill,
-  };
+  /// Returns the kernarg slot of the dispatch at @p packet_index.
+  KernelArgs* ObtainAsyncKernelCopyArg(uint64_t packet_index);
 
-  struct KernelCode {
-    void* code_buf_;
-    size_t code_buf_size_;
-  };
+  /// Write barrier-AND packets for @p dep_signals starting at @p write_index.
+  /// Returns the index following the last barrier.
+  uint64_t PopulateBarriers(uint64_t write_index,
+                            const std::vector<core::Signal*>& dep_signals);
 
-  std::map<KernelType, KernelCode> kernels_;
+  /// Returns the grid size for a copy of @p size bytes.
+  int CopyWorkitems(size_t size) const;
+
+  /// Fill @p args for a copy spread over @p num_workitems and return the
+  /// code handle of the kernel to dispatch.
+  uint64_t PopulateCopyArgs(KernelArgs* args, void* dst, const void* src, size_t size,
+                            int num_workitems);
+
+  /// Fill @p args for setting @p size bytes at @p ptr to @p value and return
+  /// the grid size.
+  int PopulateFillArgs(KernelArgs* args, void* ptr, uint32_t value, size_t size);
+
+  /// Agent owning the kernel code objects, which are shared by its blits and
+  /// assembled when first dispatched.
+  const GpuAgent* agent_;
 
   /// AQL queue for submitting the vector copy kernel.
   core::Queue* queue_;
   uint32_t queue_bitmask_;
 
-  /// Pointer to the kernel argument buffer.
+  /// Pointer to the kernel argument buffer, indexed by packet index.
   KernelArgs* kernarg_async_;
   uint32_t kernarg_async_mask_;
-  volatile uint32_t kernarg_async_counter_;
+  size_t kernarg_async_size_;
 
-  /// Completion signal for every kernel dispatched.
-  hsa_signal_t completion_signal_;
+  /// Barrier packets reserved with the copies at least every quarter queue.  Each decrements
+  /// ::kernarg_fence_ once every packet ahead of it has completed, so a kernarg slot is
+  /// rewritten only after the dispatch that last read it is done.
+  KernelMutex kernarg_lock_;
+  core::unique_signal_ptr kernarg_fence_;
+  uint64_t kernarg_fence_seq_;
 
-  /// Lock to synchronize access to kernarg_ and completion_signal_
-  std::mutex lock_;
+  /// Packet index and sequence number of the fences that may still guard a slot.
+  std::deque<std::pair<uint64_t, uint64_t>> kernarg_fences_;
+
+  /// VRAM kernarg pool holding ::kernarg_async_, null when it is in system
+  /// memory.
+  const MemoryRegion* kernarg_region_;
 
   /// Number of CUs on the underlying agent.
   int num_cus_;
+
+  /// Largest copy grid, enough waves per CU to saturate memory on this ISA.
+  int max_copy_workitems_;
 };
 }  // namespace amd
 
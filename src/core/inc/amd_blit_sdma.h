@@ -43,6 +43,7 @@
 #ifndef HSA_RUNTIME_CORE_INC_AMD_BLIT_SDMA_H_
 #define HSA_RUNTIME_CORE_INC_AMD_BLIT_SDMA_H_
 
+#include <atomic>
 #include <mutex>
 #include <stdint.h>
 #include <vector>
@@ -59,11 +60,14 @@ namespace amd {
 
 class BlitSdmaBase : public core::Blit {
  public:
-  static const size_t kQueueSize;
   static const size_t kCopyPacketSize;
   static const size_t kMaxSingleCopySize;
   static const size_t kMaxSingleFillSize;
   virtual bool isSDMA() const override { return true; }
+
+  /// @brief Ring size in bytes, HSA_SDMA_QUEUE_SIZE rounded to a power of two.
+  static size_t QueueSize();
+
   virtual hsa_status_t SubmitCopyRectCommand(const hsa_pitched_ptr_t* dst,
                                              const hsa_dim3_t* dst_offset,
                                              const hsa_pitched_ptr_t* src,
@@ -124,6 +128,17 @@ class BlitSdma : public BlitSdmaBase {
       std::vector<core::Signal*>& dep_signals,
       core::Signal& out_signal) override;
 
+  /// @brief Submit the copy packets of every copy in @p copies with a single
+  /// ring reservation and doorbell update. Batches too large for one
+  /// reservation are split, with only the last part signaling @p out_signal.
+  ///
+  /// @param copies List of copies.
+  /// @param dep_signals Arrays of dependent signal.
+  /// @param out_signal Output signal.
+  virtual hsa_status_t SubmitLinearCopyBatch(const std::vector<hsa_amd_memory_copy_desc_t>& copies,
+                                             std::vector<core::Signal*>& dep_signals,
+                                             core::Signal& out_signal) override;
+
   virtual hsa_status_t SubmitCopyRectCommand(const hsa_pitched_ptr_t* dst,
                                              const hsa_dim3_t* dst_offset,
                                              const hsa_pitched_ptr_t* src,
@@ -139,8 +154,24 @@ class BlitSdma : public BlitSdmaBase {
   virtual hsa_status_t SubmitLinearFillCommand(void* ptr, uint32_t value,
                                                size_t count) override;
 
+  virtual hsa_status_t SubmitLinearFillCommand(const std::vector<core::FillRange>& ranges,
+                                               uint32_t value,
+                                               std::vector<core::Signal*>& dep_signals,
+                                               core::Signal& out_signal) override;
+
   virtual hsa_status_t EnableProfiling(bool enable) override;
 
+  /// @brief Polls @p dep_signals and decrements @p out_signal with no command in between.
+  virtual hsa_status_t SubmitBarrier(std::vector<core::Signal*>& dep_signals,
+                                     core::Signal& out_signal) override;
+
+  /// @brief Submitted ring space the engine has not yet read, in units of
+  /// linear copy packets.
+  virtual uint64_t Backlog() override;
+
+  /// @brief Ring space reserved by submissions that the engine has not read yet.
+  virtual void RingUsage(uint64_t& used, uint64_t& size) override;
+
  private:
   /// @brief Acquires the address into queue buffer where a new command
   /// packet of specified size could be written. The address that is
@@ -162,10 +193,9 @@ class BlitSdma : public BlitSdmaBase {
 
   /// @brief Updates the Write Register of compute device to the end of
   /// SDMA packet written into queue buffer. The update to Write Register
-  /// will be safe under multi-threaded usage scenario. Furthermore, updates
-  /// to Write Register are blocking until all prior updates are completed
-  /// i.e. if two threads T1 & T2 were to call release, then updates by T2
-  /// will block until T1 has completed its update (assumes T1 acquired the
+  /// will be safe under multi-threaded usage scenario. Releases never wait
+  /// for earlier reservations: if T2 releases before T1, T2's commands are
+  /// published along with T1's when T1 releases (assumes T1 acquired the
   /// write address first).
   ///
   /// @param curr_index Index passed back from AcquireWriteAddress.
@@ -200,9 +230,15 @@ class BlitSdma : public BlitSdmaBase {
   void BuildFillCommand(char* cmd_addr, uint32_t num_fill_command, void* ptr, uint32_t value,
                         size_t count);
 
+  /// @brief Build a write linear command carrying the @p size bytes at @p src
+  /// inline.  @p size must be a whole number of dwords.
+  void BuildWriteCommand(char* cmd_addr, void* dst, const void* src, size_t size);
+
   void BuildPollCommand(char* cmd_addr, void* addr, uint32_t reference);
 
-  void BuildAtomicDecrementCommand(char* cmd_addr, void* addr);
+  /// @brief Build an atomic command adding @p value to the 64 bit integer at
+  /// @p addr.
+  void BuildAtomicAddCommand(char* cmd_addr, void* addr, int64_t value);
 
   void BuildGetGlobalTimestampCommand(char* cmd_addr, void* write_address);
 
@@ -212,6 +248,14 @@ class BlitSdma : public BlitSdmaBase {
                              const std::vector<core::Signal*>& dep_signals,
                              core::Signal& out_signal);
 
+  /// @brief Submit @p cmds after @p dep_signals. The start timestamp is
+  /// recorded into @p start_signal and completion is reported through
+  /// @p end_signal. Either may be NULL when another submission on this ring
+  /// covers it.
+  hsa_status_t SubmitCommand(const void* cmds, size_t cmd_size,
+                             const std::vector<core::Signal*>& dep_signals,
+                             core::Signal* start_signal, core::Signal* end_signal);
+
   hsa_status_t SubmitBlockingCommand(const void* cmds, size_t cmd_size);
 
   // Agent object owning the SDMA engine.
@@ -220,10 +264,12 @@ class BlitSdma : public BlitSdmaBase {
   /// Base address of the Queue buffer at construction time.
   char* queue_start_addr_;
 
-  // Internal signals for blocking APIs
-  core::unique_signal_ptr signals_[2];
-  KernelMutex lock_;
-  bool parity_;
+  /// Ring size in bytes, a power of two.
+  size_t queue_size_;
+
+  /// Bounce buffers for end timestamps, one per copy packet sized piece of the
+  /// ring.  Allocated when profiling is first enabled.
+  std::atomic<uint64_t*> end_ts_slots_;
 
   /// Queue resource descriptor for doorbell, read
   /// and write indices
@@ -233,6 +279,28 @@ class BlitSdma : public BlitSdmaBase {
   RingIndexTy cached_reserve_index_;
   RingIndexTy cached_commit_index_;
 
+  // Reservations written ahead of cached_commit_index_, as [start, end) pairs.  The writer
+  // that finishes the reservation at the commit index publishes these as well.
+  std::vector<std::pair<RingIndexTy, RingIndexTy>> finished_;
+
+  // Protects cached_commit_index_ updates and finished_.
+  KernelMutex commit_lock_{"BlitSdma::commit_lock_"};
+
+  // Written by the engine when it passes a submission made while the ring was more than half
+  // full, so threads waiting for ring space sleep until the engine progresses.  NULL when
+  // interrupts are disabled.
+  core::Signal* progress_signal_;
+
+  // Value stored to progress_signal_ by the next wake point.
+  std::atomic<uint32_t> progress_seq_;
+
+  // Longest sleep for ring space, bounds the wait when no wake point is in flight.
+  static const uint64_t kProgressWaitUs = 200;
+
+  /// @brief Block until the engine has likely freed ring space.  Paces the wait with @p wait
+  /// when there is no progress signal.
+  void WaitForProgress(AdaptiveWait& wait);
+
   static const uint32_t linear_copy_command_size_;
 
   static const uint32_t fill_command_size_;
@@ -249,6 +317,9 @@ class BlitSdma : public BlitSdmaBase {
 
   static const uint32_t trap_command_size_;
 
+  // Host to device copies up to this size are written inline into the ring.
+  static const size_t kMaxInlineCopySize = 1024;
+
   // Flag to indicate if sDMA queue is used for H2D copy operations
   // true if used for H2D operations, false otherwise
   const bool sdma_h2d_;
@@ -106,6 +106,15 @@ class CpuAgent : public core::Agent {
   // @brief Returns number of data caches.
   __forceinline size_t num_cache() const { return cache_props_.size(); }
 
+  // @brief Returns the id of the first CPU core of this node.
+  __forceinline uint32_t first_cpu_id() const { return properties_.CComputeIdLo; }
+
+  // @brief Returns the number of CPU cores of this node.
+  __forceinline uint32_t num_cpus() const { return properties_.NumCPUCores; }
+
+  // @brief Returns the OS NUMA node of this node's CPUs, -1 if unknown.
+  __forceinline int32_t os_numa_node() const { return os_numa_node_; }
+
   // @brief Returns Hive ID
   __forceinline uint64_t HiveId() const { return  properties_.HiveID; }
 
@@ -125,6 +134,19 @@ class CpuAgent : public core::Agent {
   const core::Isa* isa() const override { return NULL; }
 
  private:
+  // @brief Queue limits when CPU queues are executed by the runtime.
+  static const uint32_t kMaxQueues = 128;
+  static const uint32_t kMinQueueSize = 64;
+  static const uint32_t kMaxQueueSize = 0x20000;
+
+  // @brief Initial doorbell value, below the first packet index so its store ends a wait.
+  static const hsa_signal_value_t kDoorbellIdle = -1;
+
+  // @brief Returns true if CPU queues are executed by runtime worker threads.
+  bool HostQueuesEnabled() const {
+    return core::Runtime::runtime_singleton_->flag().host_queue_threads() != 0;
+  }
+
   // @brief Query the driver to get the region list owned by this agent.
   void InitRegionList();
 
@@ -147,6 +169,9 @@ class CpuAgent : public core::Agent {
   // @brief Node property.
   const HsaNodeProperties properties_;
 
+  // @brief OS NUMA node of the CPUs, KFD numbers nodes independently.
+  int32_t os_numa_node_;
+
   // @brief Array of data cache property. The array index represents the cache
   // level.
   std::vector<HsaCacheProperties> cache_props_;
@@ -45,8 +45,10 @@
 #ifndef HSA_RUNTIME_CORE_INC_AMD_GPU_AGENT_H_
 #define HSA_RUNTIME_CORE_INC_AMD_GPU_AGENT_H_
 
-#include <vector>
+#include <functional>
 #include <map>
+#include <memory>
+#include <vector>
 
 #include "hsakmt.h"
 
@@ -61,6 +63,8 @@
 
 namespace amd {
 class MemoryRegion;
+class QueuePool;
+class QueueScheduler;
 
 // @brief Contains scratch memory information.
 struct ScratchInfo {
@@ -70,6 +74,9 @@ struct ScratchInfo {
   ptrdiff_t queue_process_offset;
   bool large;
   bool retry;
+  // Queue using the scratch, set once the queue exists.  Large scratch of a known queue is kept
+  // until another queue runs short of scratch.
+  amd_queue_t* queue;
 };
 
 // @brief Interface to represent a GPU agent.
@@ -139,9 +146,24 @@ class GpuAgentInt : public core::Agent {
   // @param [out] time Timestamp in agent domain.
   virtual uint64_t TranslateTime(uint64_t tick) = 0;
 
+  // @brief Translate @p count timestamps from agent domain to host domain.
+  //
+  // @param [in] ticks Timestamps in agent domain.
+  // @param [out] system_ticks Timestamps in host domain, may alias @p ticks.
+  // @param [in] count Number of timestamps.
+  virtual void TranslateTime(const uint64_t* ticks, uint64_t* system_ticks, size_t count) = 0;
+
   // @brief Invalidate caches on the agent which may hold code object data.
   virtual void InvalidateCodeCaches() = 0;
 
+  // @brief Record that the code caches of the agent may hold stale lines.
+  // Requests are coalesced and issued by the next FlushCodeCaches.
+  virtual void DeferInvalidateCodeCaches() = 0;
+
+  // @brief Issue the code cache invalidation recorded by
+  // DeferInvalidateCodeCaches, if any.
+  virtual void FlushCodeCaches() = 0;
+
   // @brief Sets the coherency type of this agent.
   //
   // @param [in] type New coherency type.
@@ -200,15 +222,28 @@ class GpuAgent : public GpuAgentInt {
   // @brief Assembles SP3 shader source into ISA or AQL code object.
   //
   // @param [in] src_sp3 SP3 shader source text representation.
-  // @param [in] func_name Name of the SP3 function to assemble.
+  // @param [in] shader Precompiled shader to assemble.
   // @param [in] assemble_target ISA or AQL assembly target.
   // @param [out] code_buf Code object buffer.
   // @param [out] code_buf_size Size of code object buffer in bytes.
   enum class AssembleTarget { ISA, AQL };
 
-  void AssembleShader(const char* func_name, AssembleTarget assemble_target, void*& code_buf,
+  // @brief Precompiled shaders, rows of the shader table used by AssembleShader.
+  enum ShaderKind {
+    ShaderTrapHandler,
+    ShaderCopyAligned,
+    ShaderCopyMisaligned,
+    ShaderFill,
+    ShaderCount
+  };
+
+  void AssembleShader(ShaderKind shader, AssembleTarget assemble_target, void*& code_buf,
                       size_t& code_buf_size) const;
 
+  // @brief Returns the AQL code object of @p shader for blit kernels.  It is
+  // assembled on first use and shared by every blit kernel of this agent.
+  uint64_t BlitShaderCode(ShaderKind shader) const;
+
   // @brief Frees code object created by AssembleShader.
   //
   // @param [in] code_buf Code object buffer.
@@ -245,15 +280,38 @@ class GpuAgent : public GpuAgentInt {
                            const hsa_dim3_t* range, hsa_amd_copy_direction_t dir,
                            std::vector<core::Signal*>& dep_signals, core::Signal& out_signal);
 
+  // @brief Override from core::Agent.
+  hsa_status_t DmaCopyBatch(const std::vector<hsa_amd_memory_copy_desc_t>& copies,
+                            core::Agent& dst_agent, core::Agent& src_agent,
+                            std::vector<core::Signal*>& dep_signals,
+                            core::Signal& out_signal) override;
+
   // @brief Override from core::Agent.
   hsa_status_t DmaFill(void* ptr, uint32_t value, size_t count) override;
 
-  // @brief Get the next available end timestamp object.
-  uint64_t* ObtainEndTsObject();
+  // @brief Appends the engines asynchronous copies have been issued to.
+  // Engines not created yet have no work to order against and are skipped.
+  void AsyncCopyEngines(std::vector<core::Blit*>& engines);
+
+  // @brief Override from core::Agent.
+  hsa_status_t DmaFill(const std::vector<core::FillRange>& ranges, uint32_t value,
+                       std::vector<core::Signal*>& dep_signals,
+                       core::Signal& out_signal) override;
+
+  // @brief Allocate @p count end timestamp objects, each kTsSize bytes and
+  // kTsSize aligned, in device memory. Release with Runtime::FreeMemory.
+  uint64_t* AllocateEndTsSlots(size_t count);
+
+  // Each end ts is 32 bytes.
+  static const size_t kTsSize = 32;
 
   // @brief Override from core::Agent.
   hsa_status_t GetInfo(hsa_agent_info_t attribute, void* value) const override;
 
+  // @brief Fill @p stats for the runtime statistics page.  Engines are not
+  // created by the call.
+  void CollectStats(hsa_amd_stats_agent_t& stats);
+
   // @brief Override from core::Agent.
   hsa_status_t QueueCreate(size_t size, hsa_queue_type32_t queue_type,
                            core::HsaEventCallback event_callback, void* data,
@@ -267,18 +325,37 @@ class GpuAgent : public GpuAgentInt {
   // @brief Override from amd::GpuAgentInt.
   void ReleaseQueueScratch(ScratchInfo& scratch) override;
 
-  // @brief Register signal for notification when scratch may become available.
-  // @p signal is notified by OR'ing with @p value.
-  void AddScratchNotifier(hsa_signal_t signal, hsa_signal_value_t value) {
+  // @brief Returns true if newly acquired large scratch must be released after one use, because
+  // queues are waiting for scratch or the firmware requires it.
+  bool ScratchSingleUse() {
     ScopedAcquire<KernelMutex> lock(&scratch_lock_);
-    scratch_notifiers_[signal] = value;
+    return !scratch_waiters_.empty() ||
+        ((isa_->GetMajorVersion() == 8) && (GetMicrocodeVersion() < 729));
   }
 
+  // @brief Register signal for notification when @p size bytes of scratch may become available.
+  // @p signal is notified by OR'ing with @p value.  Waiters are admitted in order of @p priority,
+  // then arrival, and only while the freed scratch covers their request.  @p ticket holds the
+  // waiter's arrival slot: zero requests a new one, which is stored back, and a waiter woken
+  // without enough scratch passes it again to keep its place.
+  void AddScratchNotifier(hsa_signal_t signal, hsa_signal_value_t value, size_t size,
+                          int priority, uint64_t& ticket);
+
   // @brief Deregister scratch notification signal.
-  void RemoveScratchNotifier(hsa_signal_t signal) {
-    ScopedAcquire<KernelMutex> lock(&scratch_lock_);
-    scratch_notifiers_.erase(signal);
-  }
+  void RemoveScratchNotifier(hsa_signal_t signal);
+
+  // @brief Take a ring buffer of @p size_pkts packets released by a destroyed queue.
+  //
+  // @retval false if none is cached.
+  bool TakeRingBuffer(uint32_t size_pkts, void*& ring, uint32_t& alloc_bytes);
+
+  // @brief Keep the ring buffer of a destroyed queue for reuse.
+  //
+  // @retval false if the cache is full and the caller must free the ring.
+  bool CacheRingBuffer(uint32_t size_pkts, void* ring, uint32_t alloc_bytes);
+
+  // @brief Returns the priority and CU mask policy of this agent's classified queues.
+  QueueScheduler& queue_scheduler() { return *queue_scheduler_; }
 
   // @brief Override from amd::GpuAgentInt.
   void TranslateTime(core::Signal* signal,
@@ -287,9 +364,20 @@ class GpuAgent : public GpuAgentInt {
   // @brief Override from amd::GpuAgentInt.
   uint64_t TranslateTime(uint64_t tick) override;
 
+  // @brief Override from amd::GpuAgentInt.
+  void TranslateTime(const uint64_t* ticks, uint64_t* system_ticks, size_t count) override;
+
   // @brief Override from amd::GpuAgentInt.
   void InvalidateCodeCaches() override;
 
+  // @brief Override from amd::GpuAgentInt.
+  void DeferInvalidateCodeCaches() override {
+    code_cache_invalidate_pending_.store(true, std::memory_order_release);
+  }
+
+  // @brief Override from amd::GpuAgentInt.
+  void FlushCodeCaches() override;
+
   // @brief Override from amd::GpuAgentInt.
   bool current_coherency_type(hsa_amd_coherency_type_t type) override;
 
@@ -328,6 +416,29 @@ class GpuAgent : public GpuAgentInt {
   // @brief Override from amd::GpuAgentInt.
   __forceinline bool is_kv_device() const override { return is_kv_device_; }
 
+  // @brief Frame buffer region of the agent, null on agents without local memory.
+  __forceinline const MemoryRegion* local_region() const { return local_region_; }
+
+  // @brief Kernarg pool in the frame buffer, null unless HSA_VRAM_KERNARG is set and the whole
+  // frame buffer is host visible.
+  __forceinline const MemoryRegion* kernarg_region() const { return kernarg_region_; }
+
+  // @brief Make host writes to the frame buffer visible to the GPU.  Needed between writing
+  // ::kernarg_region memory and ringing a doorbell.
+  __forceinline void FlushHdp() const {
+    // The full fence drains write-combining buffers ahead of the flush register write, reading
+    // the register back waits for the flush to be posted.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    *HDP_flush_.HDP_MEM_FLUSH_CNTL = 1;
+    (void)*reinterpret_cast<volatile uint32_t*>(HDP_flush_.HDP_MEM_FLUSH_CNTL);
+  }
+
+  // @brief Create a queue whose ring and doorbell are written by kernels running on this agent.
+  // Never served from the queue pool since pooled queues keep write indices on the host.
+  hsa_status_t DeviceEnqueueQueueCreate(size_t size, core::HsaEventCallback event_callback,
+                                        void* data, uint32_t private_segment_size,
+                                        uint32_t group_segment_size, core::Queue** queue);
+
   // @brief Override from amd::GpuAgentInt.
   __forceinline hsa_profile_t profile() const override { return profile_; }
 
@@ -348,6 +459,11 @@ class GpuAgent : public GpuAgentInt {
   // @brief Create a queue through HSA API to allow tools to intercept.
   core::Queue* CreateInterceptibleQueue();
 
+  // @brief Create a hardware AQL queue, bypassing the queue pool.
+  hsa_status_t CreateAqlQueue(size_t size, core::HsaEventCallback event_callback, void* data,
+                              uint32_t private_segment_size, uint32_t group_segment_size,
+                              core::Queue** queue, bool device_ring = false);
+
   // @brief Create SDMA blit object.
   //
   // @retval NULL if SDMA blit creation and initialization failed.
@@ -358,6 +474,22 @@ class GpuAgent : public GpuAgentInt {
   // @retval NULL if Kernel blit creation and initialization failed.
   core::Blit* CreateBlitKernel(core::Queue* queue);
 
+  // @brief Select the blit servicing asynchronous copies between the agents.
+  lazy_ptr<core::Blit>& GetAsyncBlit(const core::Agent& dst_agent, const core::Agent& src_agent);
+
+  // @brief Split a host<->device copy across several SDMA engines.
+  //
+  // Every stripe waits on @p dep_signals.  The last page of the range is
+  // copied on the primary engine once all stripes have landed and that
+  // submission alone decrements @p out_signal.
+  //
+  // @param [in] h2d True for host to device, false for device to host.
+  // @param [in] stripes Requested number of engines, clamped to the engines
+  // available and to ::kMinSdmaStripeSize per engine.
+  hsa_status_t DmaCopyStriped(void* dst, const void* src, size_t size, bool h2d,
+                              uint32_t stripes, std::vector<core::Signal*>& dep_signals,
+                              core::Signal& out_signal);
+
   // @brief Invoke the user provided callback for every region in @p regions.
   //
   // @param [in] regions Array of region object.
@@ -371,7 +503,28 @@ class GpuAgent : public GpuAgentInt {
       hsa_status_t (*callback)(hsa_region_t region, void* data),
       void* data) const;
 
-  // @brief Update ::t1_ tick count.
+  // @brief Clock correlation used to translate agent ticks.
+  struct ClockSnapshot {
+    uint64_t gpu;
+    uint64_t system;
+    // System ticks per agent tick since ::t0_, zero before the first sync.
+    double ratio;
+    // Agent ticks past ::gpu that are extrapolated before resyncing.
+    uint64_t resync_ticks;
+  };
+
+  // @brief Read the latest published clock correlation without locking.
+  void LoadClocks(ClockSnapshot& clocks) const;
+
+  // @brief Make sure @p clocks is usable for @p max_tick, resyncing if it is
+  // older than kClockResyncInterval at @p max_tick or was never synced.
+  void RefreshClocks(ClockSnapshot& clocks, uint64_t max_tick);
+
+  // @brief Translate @p tick with @p clocks.
+  uint64_t TranslateTime(const ClockSnapshot& clocks, uint64_t tick);
+
+  // @brief Update ::t1_ tick count and publish the new correlation. Caller
+  // holds ::t1_lock_.
   void SyncClocks();
 
   // @brief Binds the second-level trap handler to this node.
@@ -389,53 +542,217 @@ class GpuAgent : public GpuAgentInt {
   // @brief Maximum number of queues that can be created.
   uint32_t max_queues_;
 
+  // @brief Hardware queues shared by user queues, if HSA_QUEUE_POOL_SIZE is set.
+  std::unique_ptr<QueuePool> queue_pool_;
+
+  friend class QueuePool;
+
+  // @brief Priority and CU mask policy of classified queues.
+  std::unique_ptr<QueueScheduler> queue_scheduler_;
+
   // @brief Object to manage scratch memory.
   SmallHeap scratch_pool_;
 
   // @brief Current short duration scratch memory size.
   size_t scratch_used_large_;
 
-  // @brief Notifications for scratch release.
-  std::map<hsa_signal_t, hsa_signal_value_t> scratch_notifiers_;
+  // @brief Set once ReserveScratchPool has run, whether or not it succeeded.
+  bool scratch_pool_reserved_;
+
+  // @brief Queue waiting for scratch release.
+  struct ScratchWaiter {
+    hsa_signal_t signal;
+    hsa_signal_value_t value;
+    size_t size;
+    int priority;
+    uint64_t ticket;
+  };
+
+  // @brief Wake the waiters whose requests fit in the free scratch.  Must hold scratch_lock_.
+  void NotifyScratchWaiters();
+
+  // @brief Waiters for scratch release, in admission order.
+  std::vector<ScratchWaiter> scratch_waiters_;
+
+  // @brief Arrival order of scratch waiters.
+  uint64_t scratch_waiter_ticket_;
+
+  // @brief Queues keeping large scratch until it is needed elsewhere.
+  std::vector<amd_queue_t*> large_scratch_holders_;
 
   // @brief Default scratch size per queue.
   size_t queue_scratch_len_;
 
+  // @brief Ring buffer released by a destroyed queue.
+  struct CachedRing {
+    uint32_t size_pkts;
+    void* ring;
+    uint32_t alloc_bytes;
+  };
+
+  // @brief Ring buffers kept for reuse, bounded by HSA_RING_BUFFER_CACHE.
+  std::vector<CachedRing> ring_cache_;
+
+  // @brief Mutex to protect ::ring_cache_.
+  KernelMutex ring_cache_lock_{"GpuAgent::ring_cache_lock_"};
+
   // @brief Default scratch size per work item.
   size_t scratch_per_thread_;
 
-  // @brief Blit interfaces for each data path.
-  enum BlitEnum { BlitHostToDev, BlitDevToHost, BlitDevToDev, BlitCount };
+  // @brief Blit interfaces for each data path.  BlitHostToDevKernel and
+  // BlitDevToHostKernel are the compute alternatives to SDMA engines chosen
+  // by ::SelectAsyncBlit.
+  enum BlitEnum {
+    BlitHostToDev,
+    BlitDevToHost,
+    BlitDevToDev,
+    BlitHostToDevKernel,
+    BlitDevToHostKernel,
+    BlitCount
+  };
 
   lazy_ptr<core::Blit> blits_[BlitCount];
 
+  // @brief Copies at or below this size run on the compute blit unless its
+  // queue is saturated.
+  static const size_t kBlitKernelMaxSmallCopy = 64 * 1024;
+
+  // @brief Copies at or above this size always run on SDMA.
+  static const size_t kBlitSdmaMinLargeCopy = 4 * 1024 * 1024;
+
+  // @brief Compute blit queue backlog, in packets, treated as saturated.
+  static const uint64_t kBlitKernelBusyBacklog = 16;
+
+  // @brief SDMA backlog, in copy packets, above which medium copies move to an
+  // idle compute blit.
+  static const uint64_t kBlitSdmaBusyBacklog = 8;
+
+  // @brief Async copy counters per direction, indexed by BlitHostToDev,
+  // BlitDevToHost or BlitDevToDev.
+  struct BlitStats {
+    std::atomic<uint64_t> sdma_copies;
+    std::atomic<uint64_t> sdma_bytes;
+    std::atomic<uint64_t> kernel_copies;
+    std::atomic<uint64_t> kernel_bytes;
+  };
+  BlitStats blit_stats_[3];
+
+  // @brief Accounts a submitted copy of @p bytes in @p copies pieces.
+  void RecordBlit(BlitEnum dir, bool sdma, uint64_t copies, uint64_t bytes);
+
+  // @brief Maximum number of SDMA engines a single copy is striped across.
+  static const uint32_t kMaxSdmaStripes = 8;
+
+  // @brief Smallest share of a striped copy given to one engine.
+  static const size_t kMinSdmaStripeSize = 16 * 1024 * 1024;
+
+  // @brief Additional SDMA blits used for striping, indexed by
+  // [BlitHostToDev or BlitDevToHost][stripe - 1].  Stripe 0 is ::blits_.
+  lazy_ptr<core::Blit> sdma_stripes_[2][kMaxSdmaStripes - 1];
+
+  // @brief Per stripe completion signals of striped copies, oldest first.
+  // Element 0 of each group tracks the stripe on the primary engine.
+  std::vector<std::vector<core::unique_signal_ptr>> stripe_signals_[2];
+
+  // @brief Mutex to protect access to ::stripe_signals_.
+  KernelMutex stripe_lock_{"GpuAgent::stripe_lock_"};
+
+  // @brief Submits one part of a striped copy.  Part i < engines.size() runs on engine i and
+  // decrements the signal passed, the completing part runs last on the primary engine.
+  typedef std::function<hsa_status_t(core::Blit* blit, size_t part,
+                                     std::vector<core::Signal*>& dep_signals,
+                                     core::Signal& signal)>
+      StripeSubmit;
+
+  // @brief Returns up to @p stripes SDMA engines for @p dir, primary first.
+  std::vector<core::Blit*> StripeEngines(BlitEnum dir, uint32_t stripes);
+
+  // @brief Returns the engine with the smallest backlog out of the first @p rings SDMA engines
+  // of @p dir.  The rings are shared with striped copies.
+  core::Blit* LeastBusyRing(BlitEnum dir, uint32_t rings);
+
+  // @brief Direction of an asynchronous copy, as indexed into ::blit_stats_.
+  BlitEnum AsyncBlitDirection(const core::Agent& dst_agent, const core::Agent& src_agent) const;
+
+  // @brief Pick SDMA or the compute blit for a host<->device copy from its size,
+  // alignment and the backlog of both engines.  Returns the primary engine of
+  // @p dir when the cost model is disabled or has no alternative.
+  lazy_ptr<core::Blit>& SelectAsyncBlit(BlitEnum dir, void* dst, const void* src, size_t size);
+
+  // @brief Runs @p submit for every part of a copy split over @p engines.  Stripes wait on
+  // @p dep_signals, the completing part waits on every stripe and decrements @p out_signal.
+  // Stripes an engine refuses are queued on engine 0.  An error is returned only after the
+  // stripes already queued have finished.
+  hsa_status_t SubmitStriped(BlitEnum dir, const std::vector<core::Blit*>& engines,
+                             const StripeSubmit& submit, std::vector<core::Signal*>& dep_signals,
+                             core::Signal& out_signal);
+
   // @brief AQL queues for cache management and blit compute usage.
   enum QueueEnum {
-    QueueUtility,   // Cache management and device to {host,device} blit compute
-    QueueBlitOnly,  // Host to device blit
+    QueueUtility,    // Cache management, and device to {host,device} blit compute when shared
+    QueueBlitOnly,   // Host to device blit
+    QueueDevToHost,  // Device to host blit with HSA_DEDICATED_BLIT_QUEUES
+    QueueDevToDev,   // First device to device blit with HSA_DEDICATED_BLIT_QUEUES
     QueueCount
   };
 
   lazy_ptr<core::Queue> queues_[QueueCount];
 
+  // @brief Returns the queue running the compute blits of @p queue, which is
+  // the utility queue unless blit queues are dedicated.
+  lazy_ptr<core::Queue>& BlitQueue(QueueEnum queue);
+
+  // @brief Creates an internal queue restricted to the HSA_BLIT_CU_MASK CUs.
+  core::Queue* CreateBlitQueue();
+
+  // @brief Maximum number of dedicated device to device blit queues.
+  static const uint32_t kMaxDevToDevQueues = 4;
+
+  // @brief Device to device queues and blits past the first, which are
+  // ::queues_[QueueDevToDev] and ::blits_[BlitDevToDev].
+  lazy_ptr<core::Queue> d2d_queues_[kMaxDevToDevQueues - 1];
+  lazy_ptr<core::Blit> d2d_blits_[kMaxDevToDevQueues - 1];
+
+  // @brief Next device to device blit used by asynchronous copies.
+  std::atomic<uint32_t> d2d_next_;
+
+  // @brief Returns the device to device blit for the next asynchronous copy,
+  // round robin over the dedicated queues.
+  lazy_ptr<core::Blit>& DevToDevBlit();
+
   // @brief Mutex to protect the update to coherency type.
-  KernelMutex coherency_lock_;
+  KernelMutex coherency_lock_{"GpuAgent::coherency_lock_"};
 
   // @brief Mutex to protect access to scratch pool.
-  KernelMutex scratch_lock_;
+  KernelMutex scratch_lock_{"GpuAgent::scratch_lock_"};
 
-  // @brief Mutex to protect access to ::t1_.
-  KernelMutex t1_lock_;
+  // @brief Mutex serializing ::SyncClocks.
+  KernelMutex t1_lock_{"GpuAgent::t1_lock_"};
 
   // @brief Mutex to protect access to blit objects.
-  KernelMutex blit_lock_;
+  KernelMutex blit_lock_{"GpuAgent::blit_lock_"};
 
   // @brief GPU tick on initialization.
   HsaClockCounters t0_;
 
   HsaClockCounters t1_;
 
-  double historical_clock_ratio_;
+  // @brief ClockSnapshot published by SyncClocks as a seqlock, odd
+  // ::t1_seq_ while an update is in progress.
+  std::atomic<uint32_t> t1_seq_;
+  std::atomic<uint64_t> t1_gpu_;
+  std::atomic<uint64_t> t1_system_;
+  std::atomic<double> t1_ratio_;
+  std::atomic<uint64_t> t1_resync_ticks_;
+
+  // @brief Interval between clock resyncs, in milliseconds. Timestamps within
+  // the interval are extrapolated from the last correlation.
+  static const uint32_t kClockResyncInterval = 1;
+
+  std::atomic<double> historical_clock_ratio_;
+
+  // @brief Set while a deferred code cache invalidation is outstanding.
+  std::atomic<bool> code_cache_invalidate_pending_;
 
   // @brief Array of GPU cache property.
   std::vector<HsaCacheProperties> cache_props_;
@@ -448,8 +765,17 @@ class GpuAgent : public GpuAgentInt {
 
   MemoryRegion* local_region_;
 
+  MemoryRegion* kernarg_region_;
+
   core::Isa* isa_;
 
+  // @brief Value of HSA_AGENT_INFO_NAME, built once from the ISA.
+  char name_[HSA_PUBLIC_NAME_SIZE];
+
+  // @brief Value of HSA_AMD_AGENT_INFO_PRODUCT_NAME, narrowed once from the
+  // marketing name.
+  char product_name_[HSA_PUBLIC_NAME_SIZE];
+
   // @brief HSA profile.
   hsa_profile_t profile_;
 
@@ -459,6 +785,13 @@ class GpuAgent : public GpuAgentInt {
 
   size_t trap_code_buf_size_;
 
+  // @brief Code objects returned by BlitShaderCode, null until first use.
+  mutable std::atomic<void*> blit_shader_code_[ShaderCount];
+  mutable size_t blit_shader_size_[ShaderCount];
+
+  // @brief Serializes assembly of ::blit_shader_code_.
+  mutable KernelMutex blit_shader_lock_{"GpuAgent::blit_shader_lock_"};
+
   // @brief Mappings from doorbell index to queue, for trap handler.
   // Correlates with output of s_sendmsg(MSG_GET_DOORBELL) for queue identification.
   amd_queue_t** doorbell_queue_map_;
@@ -476,36 +809,25 @@ class GpuAgent : public GpuAgentInt {
   // @brief Query the driver to get the region list owned by this agent.
   void InitRegionList();
 
-  // @brief Reserve memory for scratch pool to be used by AQL queue of this
-  // agent.
+  // @brief Size the scratch pool to be used by AQL queues of this agent.
   void InitScratchPool();
 
+  // @brief Reserve the scratch aperture sized by InitScratchPool, on the first
+  // call only. Must hold scratch_lock_.
+  void ReserveScratchPool();
+
   // @brief Query the driver to get the cache properties.
   void InitCacheList();
 
   // @brief Create internal queues and blits.
   void InitDma();
 
-  // @brief Initialize memory pool for end timestamp object.
-  // @retval True if the memory pool for end timestamp object is initialized.
-  bool InitEndTsPool();
-
   // @brief Alternative aperture base address. Only on KV.
   uintptr_t ape1_base_;
 
   // @brief Alternative aperture size. Only on KV.
   size_t ape1_size_;
 
-  // Each end ts is 32 bytes.
-  static const size_t kTsSize = 32;
-
-  // Number of element in the pool.
-  uint32_t end_ts_pool_size_;
-
-  std::atomic<uint32_t> end_ts_pool_counter_;
-
-  std::atomic<uint64_t*> end_ts_base_addr_;
-
   DISALLOW_COPY_AND_ASSIGN(GpuAgent);
 };
 
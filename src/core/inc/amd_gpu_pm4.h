@@ -43,6 +43,8 @@
 #ifndef HSA_RUNTIME_CORE_INC_AMD_GPU_PM4_H_
 #define HSA_RUNTIME_CORE_INC_AMD_GPU_PM4_H_
 
+#include <stdint.h>
+
 #define PM4_HDR_IT_OPCODE_NOP                             0x10
 #define PM4_HDR_IT_OPCODE_INDIRECT_BUFFER                 0x3F
 #define PM4_HDR_IT_OPCODE_RELEASE_MEM                     0x49
@@ -76,4 +78,63 @@
 #define PM4_RELEASE_MEM_DW1_EVENT_INDEX(x)                 (((x) & 0xF) << 8)
 #  define PM4_RELEASE_MEM_EVENT_INDEX_AQL                  0x7
 
+namespace amd {
+
+/// @brief PM4 packet encoders for graphics IP major version GfxIp. The
+/// version is a template parameter, chosen once per queue or agent, so that
+/// encoding a packet does not test it.
+template <uint32_t GfxIp> struct Pm4 {
+  enum : uint32_t {
+    kIndirectBufferSizeDw = 4,
+    kReleaseMemSizeDw = 7,
+    kAcquireMemSizeDw = 7
+  };
+
+  static uint32_t Header(uint32_t it_opcode, uint32_t pkt_size_dw) {
+    return PM4_HDR(it_opcode, pkt_size_dw, GfxIp);
+  }
+
+  /// @brief Writes a NOP of @p size_dw dwords, at least one, to @p cmd.
+  static void Nop(uint32_t* cmd, uint32_t size_dw) {
+    cmd[0] = Header(PM4_HDR_IT_OPCODE_NOP, size_dw);
+    for (uint32_t i = 1; i < size_dw; ++i) cmd[i] = 0;
+  }
+
+  /// @brief Writes a command to @p cmd that runs the @p ib_size_dw dwords of
+  /// PM4 at @p ib.
+  static void IndirectBuffer(uint32_t* cmd, const void* ib, uint32_t ib_size_dw) {
+    cmd[0] = Header(PM4_HDR_IT_OPCODE_INDIRECT_BUFFER, kIndirectBufferSizeDw);
+    cmd[1] = PM4_INDIRECT_BUFFER_DW1_IB_BASE_LO(uint32_t(uintptr_t(ib) >> 2));
+    cmd[2] = PM4_INDIRECT_BUFFER_DW2_IB_BASE_HI(uint32_t(uint64_t(uintptr_t(ib)) >> 32));
+    cmd[3] = PM4_INDIRECT_BUFFER_DW3_IB_SIZE(ib_size_dw) | PM4_INDIRECT_BUFFER_DW3_IB_VALID(1);
+  }
+
+  /// @brief Writes a command to @p cmd that advances the AQL read index and
+  /// invalidates the header of the packet it is part of.
+  static void ReleaseMemAql(uint32_t* cmd) {
+    cmd[0] = Header(PM4_HDR_IT_OPCODE_RELEASE_MEM, kReleaseMemSizeDw);
+    cmd[1] = PM4_RELEASE_MEM_DW1_EVENT_INDEX(PM4_RELEASE_MEM_EVENT_INDEX_AQL);
+    for (uint32_t i = 2; i < kReleaseMemSizeDw; ++i) cmd[i] = 0;
+  }
+
+  /// @brief Writes a command to @p cmd that invalidates the instruction,
+  /// scalar and texture caches over the whole address space, writing back
+  /// dirty texture cache lines first.
+  static void AcquireMemInvalidateCaches(uint32_t* cmd) {
+    cmd[0] = Header(PM4_HDR_IT_OPCODE_ACQUIRE_MEM, kAcquireMemSizeDw);
+    cmd[1] = PM4_ACQUIRE_MEM_DW1_COHER_CNTL(
+        PM4_ACQUIRE_MEM_COHER_CNTL_SH_ICACHE_ACTION_ENA |
+        PM4_ACQUIRE_MEM_COHER_CNTL_SH_KCACHE_ACTION_ENA |
+        PM4_ACQUIRE_MEM_COHER_CNTL_TC_ACTION_ENA |
+        PM4_ACQUIRE_MEM_COHER_CNTL_TC_WB_ACTION_ENA);
+    cmd[2] = PM4_ACQUIRE_MEM_DW2_COHER_SIZE(0xFFFFFFFF);
+    cmd[3] = PM4_ACQUIRE_MEM_DW3_COHER_SIZE_HI(0xFF);
+    cmd[4] = 0;
+    cmd[5] = 0;
+    cmd[6] = 0;
+  }
+};
+
+}  // namespace amd
+
 #endif  // header guard
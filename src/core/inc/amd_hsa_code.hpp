@@ -231,6 +231,18 @@ namespace code {
       amd::elf::Section* debugLine;
       amd::elf::Section* debugAbbrev;
 
+      /// Set by InitHeadersAsBuffer, for note queries before img is built.
+      const char* headerElf;
+      size_t headerSize;
+      const char* headerNotes;
+      uint64_t headerNotesSize;
+      uint16_t headerMachine;
+      uint32_t headerEFlags;
+      uint32_t headerABIVersion;
+
+      bool GetHeaderNote(const std::string& name, uint32_t type, void** desc, uint32_t* desc_size);
+      uint32_t ABIVersion() const { return img ? img->ABIVersion() : headerABIVersion; }
+
       bool PullElf();
       bool PullElfV1();
       bool PullElfV2();
@@ -240,7 +252,9 @@ namespace code {
       bool GetAmdNote(uint32_t type, S** desc)
       {
         uint32_t desc_size;
-        if (!img->note()->getNote("AMD", type, (void**) desc, &desc_size)) {
+        bool found = img ? img->note()->getNote("AMD", type, (void**) desc, &desc_size)
+                         : GetHeaderNote("AMD", type, (void**) desc, &desc_size);
+        if (!found) {
           out << "Failed to find note, type: " << type << std::endl;
           return false;
         }
@@ -266,8 +280,8 @@ namespace code {
       amd::elf::Section* HsaText() { assert(hsatext); return hsatext; }
       const amd::elf::Section* HsaText() const { assert(hsatext); return hsatext; }
       amd::elf::SymbolTable* Symtab() { assert(img); return img->symtab(); }
-      uint16_t Machine() const { return img->Machine(); }
-      uint32_t EFlags() const { return img->EFlags(); }
+      uint16_t Machine() const { return img ? img->Machine() : headerMachine; }
+      uint32_t EFlags() const { return img ? img->EFlags() : headerEFlags; }
 
       AmdHsaCode(bool combineDataSegments = true);
       virtual ~AmdHsaCode();
@@ -279,6 +293,12 @@ namespace code {
       bool InitFromBuffer(const void* buffer, size_t size);
       bool InitAsBuffer(const void* buffer, size_t size);
       bool InitAsHandle(hsa_code_object_t code_handle);
+      /// Reads only the ELF header and locates the notes, without building
+      /// the ELF image or any section and symbol. Only note queries, such as
+      /// GetInfo, GetIsa and GetCodeObjectVersion, work until InitAsBuffer
+      /// completes the parse.
+      bool InitHeadersAsBuffer(const void* buffer, size_t size);
+      bool InitHeadersAsHandle(hsa_code_object_t code_handle);
       bool InitNew(bool xnack = false);
       bool Freeze();
       hsa_code_object_t GetHandle();
@@ -396,6 +416,10 @@ namespace code {
       Section* AddHsaHlDebug(const std::string& name, const void* data, size_t size);
     };
 
+    /// Reads the ISA name of the code object in the @p size bytes at @p elf
+    /// from its ELF header and notes, without parsing the ELF.
+    bool GetElfIsa(const void* elf, size_t size, std::string& isaName);
+
     class AmdHsaCodeManager {
     private:
       typedef std::unordered_map<uint64_t, AmdHsaCode*> CodeMap;
@@ -48,6 +48,7 @@
 #include "hsa.h"
 #include "hsa_ext_image.h"
 #include "hsa_ven_amd_loader.h"
+#include "hsa_ext_amd.h"
 #include "amd_hsa_elf.h"
 #include <string>
 #include <mutex>
@@ -216,6 +217,9 @@ public:
   virtual uint64_t getLoadBase() const = 0;
   virtual uint64_t getLoadSize() const = 0;
   virtual int64_t getDelta() const = 0;
+  virtual uint64_t getRelocationCount() const = 0;
+  /// @returns nanoseconds spent applying relocations.
+  virtual uint64_t getRelocationTime() const = 0;
 
 protected:
   LoadedCodeObject() {}
@@ -300,8 +304,26 @@ public:
     const char *options,
     hsa_loaded_code_object_t *loaded_code_object = nullptr) = 0;
 
+  /// @brief Loads @p code_object once for each of the @p num_agents distinct
+  /// @p agents. The code object is parsed once, and for code object v2 and
+  /// later the segments of each agent are allocated, copied and relocated
+  /// concurrently. Symbols are registered once all agents are loaded.
+  /// @p loaded_code_objects, if not null, receives one handle per agent.
+  virtual hsa_status_t LoadCodeObjects(
+    const hsa_agent_t *agents,
+    size_t num_agents,
+    hsa_code_object_t code_object,
+    size_t code_object_size,
+    const char *options,
+    hsa_loaded_code_object_t *loaded_code_objects = nullptr) = 0;
+
   virtual hsa_status_t Freeze(const char *options) = 0;
 
+  /// @brief Fills up to @p *count entries of @p kernels with the kernels of
+  /// a frozen executable and sets @p *count to the number of kernels.
+  virtual hsa_status_t GetKernels(hsa_amd_executable_kernel_t *kernels,
+                                  uint32_t *count) = 0;
+
   virtual hsa_status_t Validate(uint32_t *result) = 0;
 
   /// @note needed for hsa v1.0.
@@ -45,6 +45,13 @@
 #ifndef HSA_RUNTIME_CORE_INC_AMD_MEMORY_REGION_H_
 #define HSA_RUNTIME_CORE_INC_AMD_MEMORY_REGION_H_
 
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
 #include "hsakmt.h"
 
 #include "core/inc/agent.h"
@@ -94,8 +101,10 @@ class MemoryRegion : public core::MemoryRegion {
   /// @brief Unpin memory.
   static void MakeKfdMemoryUnresident(const void* ptr);
 
+  /// @param kernarg Expose local memory as a kernarg pool of @p owner, written
+  /// by the host through the BAR.  Requires a host visible frame buffer.
   MemoryRegion(bool fine_grain, bool full_profile, core::Agent* owner,
-               const HsaMemoryProperties& mem_props);
+               const HsaMemoryProperties& mem_props, bool kernarg = false);
 
   ~MemoryRegion();
 
@@ -112,17 +121,46 @@ class MemoryRegion : public core::MemoryRegion {
                                 hsa_amd_agent_memory_pool_info_t attribute,
                                 void* value) const;
 
+  /// @brief Fill @p desc with the attributes of this pool and its access from
+  /// @p agent.
+  void GetPoolDesc(const core::Agent& agent, hsa_amd_memory_pool_desc_t* desc) const;
+
   hsa_status_t AllowAccess(uint32_t num_agents, const hsa_agent_t* agents,
                            const void* ptr, size_t size) const;
 
+  /// @brief AllowAccess for several allocations of this region, given as (pointer, size)
+  /// pairs.  Agents are validated and locks taken once for the batch, and fragments sharing a
+  /// block are mapped with a single call.
+  hsa_status_t AllowAccess(uint32_t num_agents, const hsa_agent_t* agents,
+                           const std::vector<std::pair<const void*, size_t>>& ranges) const;
+
+  /// @brief Keep the allocation at @p ptr out of the block cache once freed, for memory shared
+  /// outside of the owner.
+  void ExcludeFromBlockCache(const void* ptr) const;
+
   hsa_status_t CanMigrate(const MemoryRegion& dst, bool& result) const;
 
   hsa_status_t Migrate(uint32_t flag, const void* ptr) const;
 
+  /// @brief Registers and maps @p host_ptr for @p agents.  Internal locks held
+  /// only for the duration of a copy pass @p cached false, so they neither
+  /// reuse nor populate the pin cache and never outlive the caller's pointer.
   hsa_status_t Lock(uint32_t num_agents, const hsa_agent_t* agents,
-                    void* host_ptr, size_t size, void** agent_ptr) const;
+                    void* host_ptr, size_t size, void** agent_ptr, bool cached = true) const;
+
+  /// @brief Undoes Lock, @p cached must match the value passed to it.
+  hsa_status_t Unlock(void* host_ptr, bool cached = true) const;
 
-  hsa_status_t Unlock(void* host_ptr) const;
+  /// @brief Maps a lazily mapped allocation of @p size bytes at @p ptr to
+  /// @p agent, together with the agents it was mapped to before.
+  ///
+  /// @param lazy (output) false if @p ptr is not lazily mapped.
+  hsa_status_t MapOnFirstUse(const void* ptr, size_t size, const core::Agent& agent,
+                             bool& lazy) const;
+
+  const HsaMemFlags& mem_flag() const { return mem_flag_; }
+
+  const HsaMemMapFlags& map_flag() const { return map_flag_; }
 
   HSAuint64 GetBaseAddress() const { return mem_props_.VirtualBaseAddress; }
 
@@ -146,6 +184,8 @@ class MemoryRegion : public core::MemoryRegion {
     return mem_props_.HeapType == HSA_HEAPTYPE_SYSTEM;
   }
 
+  __forceinline bool IsKernarg() const { return kernarg_; }
+
   __forceinline bool IsLDS() const {
     return mem_props_.HeapType == HSA_HEAPTYPE_GPU_LDS;
   }
@@ -166,9 +206,14 @@ class MemoryRegion : public core::MemoryRegion {
     return static_cast<uint32_t>(mem_props_.MemoryClockMax);
   }
 
+  /// Fills @p stats with the allocation counters and fragment state.
+  void GetStats(hsa_amd_memory_pool_stats_t* stats) const;
+
  private:
   const HsaMemoryProperties mem_props_;
 
+  const bool kernarg_;
+
   HsaMemFlags mem_flag_;
 
   HsaMemMapFlags map_flag_;
@@ -177,9 +222,28 @@ class MemoryRegion : public core::MemoryRegion {
 
   HSAuint64 virtual_size_;
 
-  mutable KernelMutex access_lock_;
+  // Attributes reported by GetInfo and GetPoolInfo.  They only depend on the
+  // heap type and granularity so they are computed once at construction.
+  struct Info {
+    hsa_region_segment_t segment;
+    uint32_t global_flags;
+    size_t alloc_max_size;
+    size_t alloc_granule;
+    size_t alloc_alignment;
+    bool alloc_allowed;
+  } info_;
+
+  void InitInfo();
+
+  mutable KernelMutex access_lock_{"MemoryRegion::access_lock_"};
+
+  // System allocations made with AllocateLazyMap that AllowAccess hasn't taken
+  // over yet, with the GPU nodes they are mapped to.  Protected by access_lock_.
+  mutable std::map<const void*, std::vector<uint32_t>> lazy_allocations_;
 
   static const size_t kPageSize_ = 4096;
+  static const size_t kHugePageSize_ = 2 * 1024 * 1024;
+  static const size_t kIpcGranule_ = 64 * 1024;
 
   // Determine access type allowed to requesting device
   hsa_amd_memory_pool_access_t GetAccessInfo(const core::Agent& agent,
@@ -192,11 +256,130 @@ class MemoryRegion : public core::MemoryRegion {
    public:
     explicit BlockAllocator(MemoryRegion& region) : region_(region) {}
     void* alloc(size_t request_size, size_t& allocated_size) const;
-    void free(void* ptr, size_t length) const { region_.Free(ptr, length); }
+    void free(void* ptr, size_t length) const {
+      region_.TrackFragmentBlock(ptr, false);
+      region_.FreeBlock(ptr, length);
+    }
     size_t block_size() const { return block_size_; }
   };
 
   mutable SimpleHeap<BlockAllocator> fragment_allocator_;
+
+  /// Protects fragment_allocator_.
+  mutable KernelMutex fragment_lock_{"MemoryRegion::fragment_lock_"};
+
+  /// Bases of the blocks held by fragment_allocator_, so frees can tell
+  /// fragments from other allocations of fragment size without taking
+  /// fragment_lock_.  Protected by fragment_blocks_lock_.
+  mutable std::set<uintptr_t> fragment_blocks_;
+  mutable KernelSharedMutex fragment_blocks_lock_;
+
+  // Fragments up to kMaxBinnedFragment are rounded up to a size class and
+  // recycled through bins.  Threads are spread over kFragmentBinSlots bin sets
+  // so that small allocations from many threads rarely share a lock.  Bins go
+  // to fragment_allocator_ for several fragments at a time and hand them back
+  // in batches once a bin set holds more than kMaxBinBytes.
+  static const size_t kMaxBinnedFragment = 256 * 1024;
+  static const uint32_t kNumSizeClasses = 20;
+  static const uint32_t kFragmentBinSlots = 16;
+  static const size_t kMaxBinBytes = 1024 * 1024;
+  static const size_t kBinRefillBytes = 64 * 1024;
+
+  struct FragmentBins {
+    KernelMutex lock;
+    std::vector<void*> free[kNumSizeClasses];
+    size_t bytes = 0;
+  };
+
+  mutable FragmentBins fragment_bins_[kFragmentBinSlots];
+
+  /// Returns the size class of a page aligned size up to kMaxBinnedFragment.
+  static uint32_t SizeClass(size_t size);
+
+  static size_t ClassSize(uint32_t size_class);
+
+  /// Returns the bin set of the calling thread.
+  FragmentBins& LocalBins() const;
+
+  void* AllocateFragment(size_t size) const;
+
+  /// Frees a fragment, returns false if @p ptr is not a fragment.
+  bool FreeFragment(void* ptr, size_t size) const;
+
+  /// Adds or removes a block of fragment_allocator_ from fragment_blocks_.
+  void TrackFragmentBlock(const void* base, bool add) const;
+
+  /// Returns true if @p ptr lies in a block of fragment_allocator_.
+  bool InFragmentBlock(const void* ptr) const;
+
+  /// Returns fragments held in @p bins to fragment_allocator_.  Requires
+  /// fragment_lock_ and the lock of @p bins.
+  void ReturnFragments(FragmentBins& bins, bool all) const;
+
+  /// Returns all binned fragments and releases the unused blocks.
+  void TrimFragments() const;
+
+  /// Frees a block of fragment_allocator_.
+  void FreeBlock(void* ptr, size_t size) const;
+
+  // Freed large VRAM allocations stay allocated and mapped in block_cache_,
+  // newest first, for reuse by allocations of the same size.  Only plain
+  // allocations that are still mapped to the owner alone are kept, so blocks
+  // are bucketed by size only.  block_cache_lock_ is never held while calling
+  // into KFD.
+  struct CachedBlock {
+    void* ptr;
+    size_t size;
+  };
+
+  mutable std::list<CachedBlock> block_cache_;
+  mutable size_t block_cache_bytes_;
+
+  /// Live allocations that may enter block_cache_ when freed.
+  mutable std::set<const void*> cacheable_blocks_;
+
+  /// Live exported VRAM allocations of fragment size.  They are standalone
+  /// KFD allocations that importers may still map, so they are freed to KFD
+  /// rather than binned.  Protected by block_cache_lock_.
+  mutable std::set<const void*> ipc_blocks_;
+
+  mutable KernelMutex block_cache_lock_{"MemoryRegion::block_cache_lock_"};
+
+  /// Returns a cached block of exactly @p size or NULL.
+  void* TakeCachedBlock(size_t size) const;
+
+  /// Caches a freed allocation, returns false if it can't be cached.
+  bool CacheBlock(void* ptr, size_t size) const;
+
+  /// Releases all cached blocks.
+  void TrimBlockCache() const;
+
+  // Counters reported through HSA_AMD_MEMORY_POOL_INFO_STATS.  Fragment
+  // allocator blocks count as driver bytes but not as allocations.
+  mutable std::atomic<uint64_t> driver_bytes_;
+  mutable std::atomic<uint64_t> used_bytes_;
+  mutable std::atomic<uint64_t> alloc_count_;
+  mutable std::atomic<uint64_t> free_count_;
+  mutable std::atomic<uint64_t> failed_alloc_count_;
+  mutable std::atomic<uint64_t> trim_count_;
+
+  // Ring of the most recent allocation events, only present with
+  // HSA_MEMORY_POOL_TRACE=1.
+  struct AllocTrace {
+    KernelMutex lock;
+    uint64_t total = 0;
+    hsa_amd_memory_pool_trace_event_t events[HSA_AMD_MEMORY_POOL_TRACE_EVENTS];
+  };
+
+  std::unique_ptr<AllocTrace> trace_;
+
+  /// Counts a successful allocation.
+  void RecordAlloc(const void* ptr, size_t size) const;
+
+  /// Records an event if tracing is enabled.
+  void Trace(hsa_amd_memory_pool_trace_op_t op, const void* ptr, size_t size) const;
+
+  void GetTrace(hsa_amd_memory_pool_trace_t* trace) const;
 };
 
 }  // namespace
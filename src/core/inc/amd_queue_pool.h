@@ -0,0 +1,194 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HSA_RUNTIME_CORE_INC_AMD_QUEUE_POOL_H_
+#define HSA_RUNTIME_CORE_INC_AMD_QUEUE_POOL_H_
+
+#include <memory>
+#include <vector>
+
+#include "core/inc/agent.h"
+#include "core/inc/queue.h"
+#include "core/util/locks.h"
+#include "core/util/utils.h"
+
+namespace amd {
+class GpuAgent;
+class PooledQueue;
+
+/// @brief Multiplexes logical queues onto a bounded set of hardware queues of one agent.
+///
+/// Hardware queues are created on demand up to the pool size and kept after their last logical
+/// queue is destroyed, so their ring and scratch are reused by later queues.  Each new logical
+/// queue is placed on a hardware queue at least as large as requested, chosen round robin or by
+/// the fewest outstanding packets.  Hardware queue errors are reported to every logical queue on
+/// it and the failed queue is retired.
+class QueuePool {
+ public:
+  enum Policy { PolicyRoundRobin, PolicyLeastLoaded };
+
+  QueuePool(GpuAgent* agent, uint32_t max_hw_queues, Policy policy);
+  ~QueuePool();
+
+  /// @brief Create a logical queue of at least @p size packets.  Logical queues share rings, so
+  /// only multiple producer queues may be pooled.
+  ///
+  /// @retval HSA_STATUS_ERROR_OUT_OF_RESOURCES No hardware queue can hold @p size packets and the
+  /// pool is full.
+  hsa_status_t QueueCreate(size_t size, core::HsaEventCallback event_callback, void* data,
+                           uint32_t private_segment_size, uint32_t group_segment_size,
+                           core::Queue** queue);
+
+ private:
+  friend class PooledQueue;
+
+  struct Slot {
+    std::unique_ptr<core::Queue> queue;
+    uint32_t size;
+    QueuePool* pool;
+    bool failed;
+    std::vector<PooledQueue*> clients;
+  };
+
+  /// @brief Pick a healthy hardware queue of at least @p size packets, or nullptr.
+  Slot* Select(size_t size);
+
+  /// @brief Detach @p client from its hardware queue.  Failed queues are destroyed once unused.
+  void Release(PooledQueue* client);
+
+  /// @brief Error callback of the hardware queues, forwards to the affected logical queues.
+  static void ErrorHandler(hsa_status_t status, hsa_queue_t* source, void* data);
+
+  GpuAgent* agent_;
+  const uint32_t max_hw_queues_;
+  const Policy policy_;
+  uint32_t next_;
+
+  KernelMutex lock_{"QueuePool::lock_"};
+  std::vector<std::unique_ptr<Slot>> slots_;
+
+  DISALLOW_COPY_AND_ASSIGN(QueuePool);
+};
+
+/// @brief Logical queue sharing a hardware queue of a QueuePool.
+///
+/// The public queue structure is a copy of the hardware queue's, so packets written through it
+/// land in the shared ring and ring the shared doorbell.  Index operations are forwarded to the
+/// hardware queue.  Inactivation only detaches the logical queue.
+class PooledQueue : public core::Queue {
+ public:
+  PooledQueue(QueuePool* pool, QueuePool::Slot* slot, core::Queue* hw_queue,
+              core::HsaEventCallback event_callback, void* data);
+  ~PooledQueue();
+
+  hsa_status_t Inactivate() override;
+  hsa_status_t SetPriority(HSA_QUEUE_PRIORITY priority) override {
+    return hw_queue_->SetPriority(priority);
+  }
+  uint64_t LoadReadIndexAcquire() override { return hw_queue_->LoadReadIndexAcquire(); }
+  uint64_t LoadReadIndexRelaxed() override { return hw_queue_->LoadReadIndexRelaxed(); }
+  uint64_t LoadWriteIndexRelaxed() override { return hw_queue_->LoadWriteIndexRelaxed(); }
+  uint64_t LoadWriteIndexAcquire() override { return hw_queue_->LoadWriteIndexAcquire(); }
+  void StoreReadIndexRelaxed(uint64_t value) override { assert(false); }
+  void StoreReadIndexRelease(uint64_t value) override { assert(false); }
+  void StoreWriteIndexRelaxed(uint64_t value) override {
+    hw_queue_->StoreWriteIndexRelaxed(value);
+  }
+  void StoreWriteIndexRelease(uint64_t value) override {
+    hw_queue_->StoreWriteIndexRelease(value);
+  }
+  uint64_t CasWriteIndexAcqRel(uint64_t expected, uint64_t value) override {
+    return hw_queue_->CasWriteIndexAcqRel(expected, value);
+  }
+  uint64_t CasWriteIndexAcquire(uint64_t expected, uint64_t value) override {
+    return hw_queue_->CasWriteIndexAcquire(expected, value);
+  }
+  uint64_t CasWriteIndexRelaxed(uint64_t expected, uint64_t value) override {
+    return hw_queue_->CasWriteIndexRelaxed(expected, value);
+  }
+  uint64_t CasWriteIndexRelease(uint64_t expected, uint64_t value) override {
+    return hw_queue_->CasWriteIndexRelease(expected, value);
+  }
+  uint64_t AddWriteIndexAcqRel(uint64_t value) override {
+    return hw_queue_->AddWriteIndexAcqRel(value);
+  }
+  uint64_t AddWriteIndexAcquire(uint64_t value) override {
+    return hw_queue_->AddWriteIndexAcquire(value);
+  }
+  uint64_t AddWriteIndexRelaxed(uint64_t value) override {
+    return hw_queue_->AddWriteIndexRelaxed(value);
+  }
+  uint64_t AddWriteIndexRelease(uint64_t value) override {
+    return hw_queue_->AddWriteIndexRelease(value);
+  }
+
+  /// @brief CU masks would apply to every logical queue on the hardware queue, so they are
+  /// refused.
+  hsa_status_t SetCUMasking(const uint32_t num_cu_mask_count, const uint32_t* cu_mask) override {
+    return HSA_STATUS_ERROR_INVALID_QUEUE;
+  }
+  void ExecutePM4(uint32_t* cmd_data, size_t cmd_size_b, bool wait = true) override {
+    hw_queue_->ExecutePM4(cmd_data, cmd_size_b, wait);
+  }
+  void SetProfiling(bool enabled) override { hw_queue_->SetProfiling(enabled); }
+
+ protected:
+  bool _IsA(rtti_t id) const override { return id == &rtti_id_; }
+
+ private:
+  friend class QueuePool;
+
+  static int rtti_id_;
+
+  QueuePool* pool_;
+  QueuePool::Slot* slot_;
+  core::Queue* hw_queue_;
+  core::HsaEventCallback event_callback_;
+  void* event_data_;
+  bool active_;
+
+  DISALLOW_COPY_AND_ASSIGN(PooledQueue);
+};
+
+}  // namespace amd
+
+#endif  // header guard
@@ -0,0 +1,119 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// HSA runtime C++ interface file.
+
+#ifndef HSA_RUNTME_CORE_INC_AMD_QUEUE_SCHEDULER_H_
+#define HSA_RUNTME_CORE_INC_AMD_QUEUE_SCHEDULER_H_
+
+#include <atomic>
+#include <vector>
+
+#include "hsakmt.h"
+
+#include "inc/hsa_ext_amd.h"
+#include "core/inc/signal.h"
+#include "core/util/locks.h"
+#include "core/util/os.h"
+#include "core/util/utils.h"
+
+namespace amd {
+class AqlQueue;
+
+/// @brief Adjusts the hardware priority and CU mask of an agent's classified queues.
+///
+/// Every HSA_QUEUE_SCHED_INTERVAL microseconds the backlog (write index minus read index) of the
+/// classified queues is sampled.  While any latency class queue has a backlog, latency queues run
+/// at maximum priority on all CUs and batch queues drop to minimum priority on a share of the CUs
+/// given by their weight.  Once latency queues have been idle for a few samples every classified
+/// queue returns to normal priority on all CUs.  Hardware state is only updated on transitions.
+class QueueScheduler {
+ public:
+  explicit QueueScheduler(uint32_t cu_count);
+  ~QueueScheduler();
+
+  /// @brief Place @p queue in @p queue_class with relative @p weight.  The default class
+  /// releases the queue and restores its normal priority and CU mask.
+  hsa_status_t SetClass(AqlQueue* queue, hsa_amd_queue_class_t queue_class, uint32_t weight);
+
+  /// @brief Forget @p queue, which is being destroyed.
+  void Remove(AqlQueue* queue);
+
+ private:
+  struct Entry {
+    AqlQueue* queue;
+    hsa_amd_queue_class_t queue_class;
+    uint32_t weight;
+  };
+
+  // Latency queue samples without backlog before batch queues get their resources back.
+  static const uint32_t kIdleSamples = 8;
+
+  static void ThreadLoop(void* arg);
+
+  /// @brief Sample queue backlogs and update hardware state on a transition.
+  void Sample();
+
+  /// @brief Program the priority and CU mask of @p entry for the current state.
+  void Apply(const Entry& entry);
+
+  static void SetCUMask(AqlQueue* queue, const std::vector<uint32_t>& mask);
+
+  const uint32_t cu_count_;
+  std::vector<uint32_t> full_mask_;
+  std::vector<uint32_t> batch_mask_;
+
+  KernelMutex lock_{"QueueScheduler::lock_"};
+  std::vector<Entry> entries_;
+  bool protecting_;
+  bool dirty_;
+  uint32_t idle_samples_;
+
+  std::atomic<bool> exit_;
+  core::unique_signal_ptr wake_;
+  os::Thread thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(QueueScheduler);
+};
+
+}  // namespace amd
+#endif  // header guard
@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// HSA runtime C++ interface file.
+
+#ifndef HSA_RUNTME_CORE_INC_ASYNC_EXECUTOR_H_
+#define HSA_RUNTME_CORE_INC_ASYNC_EXECUTOR_H_
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "core/util/locks.h"
+#include "core/util/os.h"
+#include "core/util/utils.h"
+
+namespace core {
+
+/// @brief Worker threads running asynchronous signal handlers and functions so that the event
+/// monitoring threads only detect completions.
+///
+/// Jobs are queued in two lanes.  The runtime lane has a worker of its own and is served first
+/// by the user lane workers, so a slow application callback can not hold up runtime handlers.
+class AsyncExecutor {
+ public:
+  enum Lane { kRuntimeLane = 0, kUserLane = 1 };
+
+  AsyncExecutor()
+      : started_(false), exit_(false), runtime_seq_(0), user_seq_(0), user_running_(0) {}
+  ~AsyncExecutor() { Shutdown(); }
+
+  /// @brief Start the runtime lane worker and @p user_workers user lane workers.
+  bool Start(uint32_t user_workers);
+
+  /// @brief True between a successful Start and Shutdown.
+  bool started() const { return started_.load(std::memory_order_acquire); }
+
+  /// @brief Queue @p run on @p lane.  @p cancel runs instead, on the calling thread, if the
+  /// executor is not started, or on the shutting down thread if the job was still queued.
+  void Submit(Lane lane, std::function<void()> run, std::function<void()> cancel);
+
+  /// @brief Wait for running jobs and cancel the queued ones.
+  void Shutdown();
+
+  /// @brief Cancel the queued user lane jobs and wait for the running ones.  The workers keep
+  /// running.
+  void DrainUserLane();
+
+ private:
+  struct Job {
+    std::function<void()> run;
+    std::function<void()> cancel;
+  };
+
+  struct Worker {
+    AsyncExecutor* executor;
+    bool reserved;
+    os::Thread thread;
+  };
+
+  static void WorkerLoop(void* arg);
+
+  std::atomic<bool> started_;
+  bool exit_;
+
+  KernelMutex lock_{"AsyncExecutor::lock_"};
+  std::deque<Job> lanes_[2];
+
+  // Bumped by every job the runtime worker or the user workers can take, they sleep on them.
+  volatile uint32_t runtime_seq_;
+  volatile uint32_t user_seq_;
+
+  // User lane jobs being run, DrainUserLane sleeps on it.
+  volatile uint32_t user_running_;
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncExecutor);
+};
+
+}  // namespace core
+#endif  // header guard
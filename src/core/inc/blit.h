@@ -44,8 +44,11 @@
 #define HSA_RUNTIME_CORE_INC_BLIT_H_
 
 #include <stdint.h>
+#include <algorithm>
+#include <vector>
 
 #include "core/inc/agent.h"
+#include "core/inc/signal.h"
 
 namespace core {
 class Blit {
@@ -95,6 +98,25 @@ class Blit {
       void* dst, const void* src, size_t size,
       std::vector<core::Signal*>& dep_signals, core::Signal& out_signal) = 0;
 
+  /// @brief Submit several linear copy commands sharing dependencies and a
+  /// completion signal. The call is non blocking. The transfers will start
+  /// after all dependent signals are satisfied. After every transfer is
+  /// completed, the out signal will be decremented once.
+  ///
+  /// @param copies List of copies.
+  /// @param dep_signals Arrays of dependent signal.
+  /// @param out_signal Output signal.
+  ///
+  /// @return HSA_STATUS_ERROR_OUT_OF_RESOURCES if the blit can not submit
+  /// more than one copy against a single completion.
+  virtual hsa_status_t SubmitLinearCopyBatch(
+      const std::vector<hsa_amd_memory_copy_desc_t>& copies,
+      std::vector<core::Signal*>& dep_signals, core::Signal& out_signal) {
+    if (copies.size() != 1) return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+    return SubmitLinearCopyCommand(copies[0].dst, copies[0].src, copies[0].size, dep_signals,
+                                   out_signal);
+  }
+
   /// @brief Submit a linear fill command to the the underlying compute device's
   /// control block. The call is blocking until the command execution is
   /// finished.
@@ -105,6 +127,20 @@ class Blit {
   virtual hsa_status_t SubmitLinearFillCommand(void* ptr, uint32_t value,
                                                size_t num) = 0;
 
+  /// @brief Submit linear fill commands sharing dependencies and a completion
+  /// signal. The call is non blocking. The fills will start after all
+  /// dependent signals are satisfied. After every range is filled, the out
+  /// signal will be decremented once.
+  ///
+  /// @param ranges Ranges to fill, dword aligned.
+  /// @param value Value to be set to each dword.
+  /// @param dep_signals Arrays of dependent signal.
+  /// @param out_signal Output signal.
+  virtual hsa_status_t SubmitLinearFillCommand(const std::vector<FillRange>& ranges,
+                                               uint32_t value,
+                                               std::vector<core::Signal*>& dep_signals,
+                                               core::Signal& out_signal) = 0;
+
   /// @brief Enable profiling of the asynchronous copy command. The timestamp
   /// of each copy request will be stored in the completion signal structure.
   ///
@@ -114,8 +150,43 @@ class Blit {
   /// successful.
   virtual hsa_status_t EnableProfiling(bool enable) = 0;
 
+  /// @brief Submit a command that completes after every previously submitted
+  /// command and after all of @p dep_signals reached 0, and then decrements
+  /// @p out_signal. Later commands start only after it completed.
+  ///
+  /// @param dep_signals Arrays of dependent signal.
+  /// @param out_signal Output signal.
+  virtual hsa_status_t SubmitBarrier(std::vector<core::Signal*>& dep_signals,
+                                     core::Signal& out_signal) = 0;
+
   /// @brief Blit operations use SDMA.
   virtual bool isSDMA() const { return false; }
+
+  /// @brief Approximate number of submitted commands the engine has not yet
+  /// fetched.  Used to balance copies between engines, 0 if unknown.
+  virtual uint64_t Backlog() { return 0; }
+
+  /// @brief Bytes of the command ring holding submitted commands the engine
+  /// has not consumed, in @p used, and the ring size, in @p size.  Both are 0
+  /// if unknown.
+  virtual void RingUsage(uint64_t& used, uint64_t& size) {
+    used = 0;
+    size = 0;
+  }
+
+ protected:
+  /// @brief Copy the entries of @p dep_signals that still need a device side
+  /// wait into @p pending. Dependencies that already reached zero and
+  /// repeated signals are dropped.
+  static void PendingDependencies(const std::vector<core::Signal*>& dep_signals,
+                                  std::vector<core::Signal*>& pending) {
+    pending.clear();
+    for (core::Signal* dep : dep_signals) {
+      if (dep->LoadAcquire() == 0) continue;
+      if (std::find(pending.begin(), pending.end(), dep) != pending.end()) continue;
+      pending.push_back(dep);
+    }
+  }
 };
 }  // namespace core
 
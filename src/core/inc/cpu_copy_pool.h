@@ -0,0 +1,190 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// HSA runtime C++ interface file.
+
+#ifndef HSA_RUNTME_CORE_INC_CPU_COPY_POOL_H_
+#define HSA_RUNTME_CORE_INC_CPU_COPY_POOL_H_
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "core/inc/agent.h"
+#include "core/inc/signal.h"
+#include "core/util/locks.h"
+#include "core/util/os.h"
+#include "core/util/utils.h"
+
+namespace core {
+
+/// @brief Persistent worker threads servicing asynchronous CPU to CPU copies.
+///
+/// Workers are spread across the CPU agents (NUMA nodes) and bound to the cores of their node.
+/// Each worker owns a queue.  Copies are queued to the workers of the destination node and large
+/// copies are split across all of them.  A worker sleeps on its own control signal together with
+/// the dependencies of every copy it holds rather than blocking on one dependency at a time.
+class CpuCopyPool {
+ public:
+  CpuCopyPool() : started_(false) {}
+  ~CpuCopyPool() { Shutdown(); }
+
+  /// @brief Queue a copy.  @p completion_signal is decremented once, after every signal in
+  /// @p dep_signals has reached zero and all data has been copied.
+  hsa_status_t Submit(void* dst, const Agent& dst_agent, const void* src, size_t size,
+                      const std::vector<Signal*>& dep_signals, Signal& completion_signal,
+                      bool profiling_enabled);
+
+  /// @brief Copy and wait for completion.  Copies large enough to be split are spread over the
+  /// workers of the destination node, smaller ones run on the calling thread.
+  hsa_status_t CopySync(void* dst, const Agent& dst_agent, const void* src, size_t size);
+
+  /// @brief Queue several copies sharing dependencies.  @p completion_signal is decremented once,
+  /// after every copy in @p copies has finished.  Each worker is woken at most once per batch.
+  hsa_status_t SubmitBatch(const std::vector<hsa_amd_memory_copy_desc_t>& copies,
+                           const Agent& dst_agent, const std::vector<Signal*>& dep_signals,
+                           Signal& completion_signal, bool profiling_enabled);
+
+  /// @brief Queue a fill of every dword in @p ranges with @p value.  @p completion_signal is
+  /// decremented once, after every range has been set.
+  hsa_status_t SubmitFill(const std::vector<FillRange>& ranges, uint32_t value,
+                          const Agent& dst_agent, const std::vector<Signal*>& dep_signals,
+                          Signal& completion_signal, bool profiling_enabled);
+
+  /// @brief Queue a host task.  @p task runs on a worker of @p agent's node once every signal
+  /// in @p dep_signals has reached zero, then @p completion_signal is decremented, or failed if
+  /// @p task returns false.  @p user marks tasks of the application, see CancelUserTasks.
+  hsa_status_t SubmitTask(std::function<bool()> task, const Agent& agent,
+                          const std::vector<Signal*>& dep_signals, Signal& completion_signal,
+                          bool user = false);
+
+  /// @brief Fail the completion signal of every queued user task and wait for the running
+  /// ones.  The workers keep running.
+  void CancelUserTasks();
+
+  /// @brief Stop and join all workers.  Queued copies and tasks which have not started fail
+  /// their completion signals.
+  void Shutdown();
+
+ private:
+  /// @brief State shared by the parts of one submitted copy.
+  struct Copy {
+    std::vector<Signal*> dep_signals;
+    Signal* completion_signal;
+    std::function<bool()> job;
+    bool profiling_enabled;
+    bool user;
+    std::atomic<uint32_t> parts;
+    std::atomic<bool> started;
+    std::atomic<bool> failed;
+  };
+
+  /// @brief Part of a copy, or of a fill if @p src is NULL, or the job of a host task.
+  struct Task {
+    void* dst;
+    const void* src;
+    size_t size;
+    uint32_t value;
+    std::shared_ptr<Copy> copy;
+  };
+
+  struct Worker {
+    uint32_t first_cpu;
+    uint32_t num_cpus;
+    std::atomic<bool> exit;
+    KernelMutex lock;
+    std::vector<Task> incoming;
+    // CancelUserTasks bumps the request, the worker copies it to cancel_done once it has
+    // failed its user tasks.
+    volatile uint32_t cancel_request;
+    volatile uint32_t cancel_done;
+    unique_signal_ptr wake;
+    os::Thread thread;
+  };
+
+  /// @brief Workers bound to one CPU agent.
+  struct Node {
+    const Agent* agent;
+    std::vector<Worker*> workers;
+    std::atomic<uint32_t> next;
+  };
+
+  // Copies smaller than this are never split.
+  static const size_t kSplitThreshold = 8 * 1024 * 1024;
+
+  // Smallest part of a split copy.
+  static const size_t kMinPartSize = 2 * 1024 * 1024;
+
+  /// @brief Create the workers on first use.
+  bool Start();
+
+  /// @brief Split @p copies into tasks and hand them to the workers.  A NULL source in
+  /// @p copies requests a fill with @p value.
+  hsa_status_t Enqueue(const std::vector<hsa_amd_memory_copy_desc_t>& copies, uint32_t value,
+                       const Agent& dst_agent, const std::vector<Signal*>& dep_signals,
+                       Signal& completion_signal, bool profiling_enabled);
+
+  /// @brief Node owning @p agent, or the first node.  The pool must be started.
+  Node* NodeOf(const Agent& agent);
+
+  static void WorkerLoop(void* arg);
+
+  static void Run(const Task& task);
+
+  /// @brief Retire @p task without running it, failing its copy.
+  static void Drop(const Task& task);
+
+  /// @brief Signal the copy of @p task if it was the last part outstanding.
+  static void Finish(const Task& task);
+
+  std::atomic<bool> started_;
+  KernelMutex lock_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::unique_ptr<Node>> nodes_;
+
+  DISALLOW_COPY_AND_ASSIGN(CpuCopyPool);
+};
+
+}  // namespace core
+#endif  // header guard
@@ -156,8 +156,25 @@ class BusyWaitSignal : public Signal {
   bool _IsA(rtti_t id) const { return id == &rtti_id_; }
 
  private:
+  /// @brief Wakes host waiters of an IPC signal after a host update of its value.
+  __forceinline void Notify() {
+    if (ipc_block_ == nullptr) return;
+    // Orders the value update before the waiter check, pairing with the waiter registering
+    // before its last look at the value.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (atomic::Load(&ipc_block_->ipc_waiters, std::memory_order_relaxed) == 0) return;
+    atomic::Increment(&ipc_block_->ipc_wake_seq, std::memory_order_release);
+    os::WakeAllOnSharedAddress(&ipc_block_->ipc_wake_seq);
+  }
+
+  /// @brief Sleeps up to @p timeout_us while the value of an IPC signal is @p value.
+  void SleepIpc(int64_t value, uint32_t timeout_us);
+
   static int rtti_id_;
 
+  /// @variable ABI block shared with other processes, nullptr unless IPC enabled.
+  SharedSignal* ipc_block_;
+
   DISALLOW_COPY_AND_ASSIGN(BusyWaitSignal);
 };
 
@@ -0,0 +1,117 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+// 
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+// 
+// Developed by:
+// 
+//                 AMD Research and AMD HSA Software Development
+// 
+//                 Advanced Micro Devices, Inc.
+// 
+//                 www.amd.com
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+// 
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// HSA runtime C++ interface file.
+
+#ifndef HSA_RUNTME_CORE_INC_FINALIZATION_CACHE_H_
+#define HSA_RUNTME_CORE_INC_FINALIZATION_CACHE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "hsa_api_trace_int.h"
+
+#include "core/util/utils.h"
+
+namespace core {
+
+/// @brief On-disk cache of finalized code objects.
+///
+/// Entries are keyed by a hash of the finalizer library's identity, the
+/// program's BRIG modules and machine model, the target ISA, call convention,
+/// control directives and options.
+/// Each entry is written to a temporary file and renamed into place, so
+/// processes sharing the directory only ever see complete entries. When the
+/// directory grows past the size limit the least recently used entries are
+/// removed.
+class FinalizationCache {
+ public:
+  /// @param dir Cache directory, created if missing.
+  /// @param max_size Size limit of the directory contents in bytes.
+  /// @param finalizer Identity of the finalizer library, see os::GetLibIdentity.
+  /// Entries from a different build of the finalizer are never returned.
+  FinalizationCache(const std::string& dir, size_t max_size, const std::string& finalizer);
+
+  /// @brief Same contract as hsa_ext_program_finalize. Returns a cached code
+  /// object when one matches, otherwise finalizes through @p api and stores
+  /// the result.
+  hsa_status_t Finalize(const FinalizerExtTable& api, hsa_ext_program_t program, hsa_isa_t isa,
+                        int32_t call_convention,
+                        hsa_ext_control_directives_t control_directives, const char* options,
+                        hsa_code_object_type_t code_object_type,
+                        hsa_code_object_t* code_object);
+
+ private:
+  struct Key {
+    uint64_t h1;
+    uint64_t h2;
+    uint64_t length;
+  };
+
+  /// @brief Hash the finalization inputs. Returns false if the program can
+  /// not be inspected, in which case the cache is bypassed.
+  bool MakeKey(const FinalizerExtTable& api, hsa_ext_program_t program, hsa_isa_t isa,
+               int32_t call_convention, const hsa_ext_control_directives_t& control_directives,
+               const char* options, hsa_code_object_type_t code_object_type, Key& key) const;
+
+  std::string EntryPath(const Key& key) const;
+
+  bool Lookup(const Key& key, std::vector<char>& image) const;
+
+  void Store(const Key& key, const void* image, size_t size);
+
+  /// @brief Remove least recently used entries until the directory fits the
+  /// size limit.
+  void Trim();
+
+  std::string dir_;
+  size_t max_size_;
+  std::string finalizer_;
+
+  DISALLOW_COPY_AND_ASSIGN(FinalizationCache);
+};
+
+}  // namespace core
+
+#endif  // header guard
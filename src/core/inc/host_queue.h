@@ -43,6 +43,7 @@
 #ifndef HSA_RUNTIME_CORE_INC_HOST_QUEUE_H_
 #define HSA_RUNTIME_CORE_INC_HOST_QUEUE_H_
 
+#include "core/inc/host_queue_processor.h"
 #include "core/inc/memory_region.h"
 #include "core/inc/queue.h"
 #include "core/inc/runtime.h"
@@ -53,11 +54,21 @@ class HostQueue : public Queue {
  public:
   static __forceinline bool IsType(core::Queue* queue) { return queue->IsType(&rtti_id_); }
 
+  /// @brief Create a queue in @p region.  The queue destroys @p doorbell_signal when
+  /// @p own_doorbell is set.
   HostQueue(hsa_region_t region, uint32_t ring_size, hsa_queue_type32_t type,
-            uint32_t features, hsa_signal_t doorbell_signal);
+            uint32_t features, hsa_signal_t doorbell_signal, bool own_doorbell = false);
 
   ~HostQueue();
 
+  /// @brief Set the function executing agent dispatch packets.  Returns false if the
+  /// queue's packets are not executed by the runtime.
+  bool SetAgentDispatchHandler(hsa_amd_agent_dispatch_handler handler, void* data) {
+    if (processor_ == nullptr) return false;
+    processor_->SetAgentDispatchHandler(this, handler, data);
+    return true;
+  }
+
   hsa_status_t Inactivate() override { return HSA_STATUS_SUCCESS; }
   hsa_status_t SetPriority(HSA_QUEUE_PRIORITY priority) override {
     return HSA_STATUS_ERROR_INVALID_QUEUE;
@@ -147,7 +158,7 @@ class HostQueue : public Queue {
     return HSA_STATUS_ERROR;
   }
 
-  void ExecutePM4(uint32_t* cmd_data, size_t cmd_size_b) override {
+  void ExecutePM4(uint32_t* cmd_data, size_t cmd_size_b, bool wait = true) override {
     assert(false && "HostQueue::ExecutePM4 is unimplemented");
   }
 
@@ -169,6 +180,12 @@ class HostQueue : public Queue {
   static const size_t kRingAlignment = 256;
   const uint32_t size_;
   void* ring_;
+  const bool own_doorbell_;
+
+  // Packet processor executing this queue, if any, and the worker owning it.
+  HostQueueProcessor* processor_;
+  uint32_t worker_;
+  friend class HostQueueProcessor;
 
   // Host queue id counter, starting from 0x80000000 to avoid overlaping
   // with aql queue id.
@@ -0,0 +1,138 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// HSA runtime C++ interface file.
+
+#ifndef HSA_RUNTME_CORE_INC_HOST_QUEUE_PROCESSOR_H_
+#define HSA_RUNTME_CORE_INC_HOST_QUEUE_PROCESSOR_H_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "core/inc/agent.h"
+#include "core/inc/signal.h"
+#include "core/util/locks.h"
+#include "core/util/os.h"
+#include "core/util/utils.h"
+
+namespace core {
+
+class HostQueue;
+
+/// @brief Worker threads executing the AQL packets of CPU agent queues.
+///
+/// Each queue is owned by one worker, so its packets run in order.  A worker sleeps on its control
+/// signal together with the doorbell of every queue it owns, or the dependencies of the barrier
+/// packet a queue is blocked on, and is woken by doorbell stores.  Barrier-AND, barrier-OR and
+/// agent dispatch packets are supported.  Agent dispatches run on the worker thread through the
+/// queue's agent dispatch handler, called without the worker's lock held so it may use the
+/// queue API, though it must not destroy its own queue.
+class HostQueueProcessor {
+ public:
+  HostQueueProcessor() : started_(false), next_(0) {}
+  ~HostQueueProcessor() { Shutdown(); }
+
+  /// @brief Start executing the packets of @p queue.  @p callback is invoked on a worker
+  /// thread when a packet can not be executed, after which the queue stops processing.
+  hsa_status_t Attach(HostQueue* queue, HsaEventCallback callback, void* data);
+
+  /// @brief Stop executing the packets of @p queue.  Blocks while a packet of the queue runs.
+  void Detach(HostQueue* queue);
+
+  /// @brief Set the function executing agent dispatch packets of @p queue.
+  void SetAgentDispatchHandler(HostQueue* queue, hsa_amd_agent_dispatch_handler handler,
+                               void* data);
+
+  /// @brief Stop and join all workers.  Attached queues are detached.
+  void Shutdown();
+
+ private:
+  struct Entry {
+    HostQueue* queue;
+    HsaEventCallback callback;
+    void* callback_data;
+    hsa_amd_agent_dispatch_handler handler;
+    void* handler_data;
+    bool failed;
+  };
+
+  struct Worker {
+    std::atomic<bool> exit;
+    KernelMutex lock;
+    std::vector<Entry> entries;
+    // Queue whose handler or callback runs unlocked, Detach waits for it to return.
+    HostQueue* running;
+    // Bumped when running is cleared.
+    volatile uint32_t calls_done;
+    unique_signal_ptr wake;
+    os::Thread thread;
+  };
+
+  /// @brief Create the workers on first use.
+  bool Start();
+
+  static Entry* Find(Worker* worker, HostQueue* queue);
+
+  static void WorkerLoop(void* arg);
+
+  /// @brief Execute the ready packets of @p queue and add the condition it next waits for to
+  /// @p waits.  Called with the worker's lock held, which is dropped around user callbacks.
+  static void Process(Worker* worker, HostQueue* queue, SignalWaitSet& waits);
+
+  /// @brief Run @p call for @p queue with the worker's lock dropped.
+  template <typename F> static void CallUnlocked(Worker* worker, HostQueue* queue, F call);
+
+  /// @brief Returns true if the barrier with @p deps may complete, otherwise adds the conditions
+  /// it waits for to @p waits.
+  static bool BarrierReady(const hsa_signal_t* deps, bool wait_all, SignalWaitSet& waits);
+
+  std::atomic<bool> started_;
+  std::atomic<uint32_t> next_;
+  KernelMutex lock_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  DISALLOW_COPY_AND_ASSIGN(HostQueueProcessor);
+};
+
+}  // namespace core
+#endif  // header guard
@@ -0,0 +1,351 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// HSA runtime C++ interface file.
+
+#ifndef HSA_RUNTME_CORE_INC_HSA_API_STATS_H_
+#define HSA_RUNTME_CORE_INC_HSA_API_STATS_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+
+#include "core/inc/hsa_api_trace_int.h"
+#include "core/util/utils.h"
+
+// APIs counted by ApiStats, by their CoreApiTable and AmdExtTable entry names less the _fn
+// suffix.  APIs missing here still work, they are just not counted.
+#define HSA_API_STATS_CORE_APIS(X) \
+  X(hsa_init) \
+  X(hsa_shut_down) \
+  X(hsa_system_get_info) \
+  X(hsa_system_extension_supported) \
+  X(hsa_system_get_extension_table) \
+  X(hsa_iterate_agents) \
+  X(hsa_agent_get_info) \
+  X(hsa_queue_create) \
+  X(hsa_soft_queue_create) \
+  X(hsa_queue_destroy) \
+  X(hsa_queue_inactivate) \
+  X(hsa_queue_load_read_index_scacquire) \
+  X(hsa_queue_load_read_index_relaxed) \
+  X(hsa_queue_load_write_index_scacquire) \
+  X(hsa_queue_load_write_index_relaxed) \
+  X(hsa_queue_store_write_index_relaxed) \
+  X(hsa_queue_store_write_index_screlease) \
+  X(hsa_queue_cas_write_index_scacq_screl) \
+  X(hsa_queue_cas_write_index_scacquire) \
+  X(hsa_queue_cas_write_index_relaxed) \
+  X(hsa_queue_cas_write_index_screlease) \
+  X(hsa_queue_add_write_index_scacq_screl) \
+  X(hsa_queue_add_write_index_scacquire) \
+  X(hsa_queue_add_write_index_relaxed) \
+  X(hsa_queue_add_write_index_screlease) \
+  X(hsa_queue_store_read_index_relaxed) \
+  X(hsa_queue_store_read_index_screlease) \
+  X(hsa_agent_iterate_regions) \
+  X(hsa_region_get_info) \
+  X(hsa_agent_get_exception_policies) \
+  X(hsa_agent_extension_supported) \
+  X(hsa_memory_register) \
+  X(hsa_memory_deregister) \
+  X(hsa_memory_allocate) \
+  X(hsa_memory_free) \
+  X(hsa_memory_copy) \
+  X(hsa_memory_assign_agent) \
+  X(hsa_signal_create) \
+  X(hsa_signal_destroy) \
+  X(hsa_signal_load_relaxed) \
+  X(hsa_signal_load_scacquire) \
+  X(hsa_signal_store_relaxed) \
+  X(hsa_signal_store_screlease) \
+  X(hsa_signal_wait_relaxed) \
+  X(hsa_signal_wait_scacquire) \
+  X(hsa_signal_and_relaxed) \
+  X(hsa_signal_and_scacquire) \
+  X(hsa_signal_and_screlease) \
+  X(hsa_signal_and_scacq_screl) \
+  X(hsa_signal_or_relaxed) \
+  X(hsa_signal_or_scacquire) \
+  X(hsa_signal_or_screlease) \
+  X(hsa_signal_or_scacq_screl) \
+  X(hsa_signal_xor_relaxed) \
+  X(hsa_signal_xor_scacquire) \
+  X(hsa_signal_xor_screlease) \
+  X(hsa_signal_xor_scacq_screl) \
+  X(hsa_signal_exchange_relaxed) \
+  X(hsa_signal_exchange_scacquire) \
+  X(hsa_signal_exchange_screlease) \
+  X(hsa_signal_exchange_scacq_screl) \
+  X(hsa_signal_add_relaxed) \
+  X(hsa_signal_add_scacquire) \
+  X(hsa_signal_add_screlease) \
+  X(hsa_signal_add_scacq_screl) \
+  X(hsa_signal_subtract_relaxed) \
+  X(hsa_signal_subtract_scacquire) \
+  X(hsa_signal_subtract_screlease) \
+  X(hsa_signal_subtract_scacq_screl) \
+  X(hsa_signal_cas_relaxed) \
+  X(hsa_signal_cas_scacquire) \
+  X(hsa_signal_cas_screlease) \
+  X(hsa_signal_cas_scacq_screl) \
+  X(hsa_isa_from_name) \
+  X(hsa_isa_get_info) \
+  X(hsa_isa_compatible) \
+  X(hsa_code_object_serialize) \
+  X(hsa_code_object_deserialize) \
+  X(hsa_code_object_destroy) \
+  X(hsa_code_object_get_info) \
+  X(hsa_code_object_get_symbol) \
+  X(hsa_code_symbol_get_info) \
+  X(hsa_code_object_iterate_symbols) \
+  X(hsa_executable_create) \
+  X(hsa_executable_destroy) \
+  X(hsa_executable_load_code_object) \
+  X(hsa_executable_freeze) \
+  X(hsa_executable_get_info) \
+  X(hsa_executable_global_variable_define) \
+  X(hsa_executable_agent_global_variable_define) \
+  X(hsa_executable_readonly_variable_define) \
+  X(hsa_executable_validate) \
+  X(hsa_executable_get_symbol) \
+  X(hsa_executable_symbol_get_info) \
+  X(hsa_executable_iterate_symbols) \
+  X(hsa_status_string) \
+  X(hsa_extension_get_name) \
+  X(hsa_system_major_extension_supported) \
+  X(hsa_system_get_major_extension_table) \
+  X(hsa_agent_major_extension_supported) \
+  X(hsa_cache_get_info) \
+  X(hsa_agent_iterate_caches) \
+  X(hsa_signal_silent_store_relaxed) \
+  X(hsa_signal_silent_store_screlease) \
+  X(hsa_signal_group_create) \
+  X(hsa_signal_group_destroy) \
+  X(hsa_signal_group_wait_any_scacquire) \
+  X(hsa_signal_group_wait_any_relaxed) \
+  X(hsa_agent_iterate_isas) \
+  X(hsa_isa_get_info_alt) \
+  X(hsa_isa_get_exception_policies) \
+  X(hsa_isa_get_round_method) \
+  X(hsa_wavefront_get_info) \
+  X(hsa_isa_iterate_wavefronts) \
+  X(hsa_code_object_get_symbol_from_name) \
+  X(hsa_code_object_reader_create_from_file) \
+  X(hsa_code_object_reader_create_from_memory) \
+  X(hsa_code_object_reader_destroy) \
+  X(hsa_executable_create_alt) \
+  X(hsa_executable_load_program_code_object) \
+  X(hsa_executable_load_agent_code_object) \
+  X(hsa_executable_validate_alt) \
+  X(hsa_executable_get_symbol_by_name) \
+  X(hsa_executable_iterate_agent_symbols) \
+  X(hsa_executable_iterate_program_symbols)
+
+#define HSA_API_STATS_AMD_EXT_APIS(X) \
+  X(hsa_amd_coherency_get_type) \
+  X(hsa_amd_coherency_set_type) \
+  X(hsa_amd_profiling_set_profiler_enabled) \
+  X(hsa_amd_profiling_async_copy_enable) \
+  X(hsa_amd_profiling_get_dispatch_time) \
+  X(hsa_amd_profiling_get_async_copy_time) \
+  X(hsa_amd_profiling_convert_tick_to_system_domain) \
+  X(hsa_amd_signal_async_handler) \
+  X(hsa_amd_async_function) \
+  X(hsa_amd_signal_wait_any) \
+  X(hsa_amd_queue_cu_set_mask) \
+  X(hsa_amd_memory_pool_get_info) \
+  X(hsa_amd_agent_iterate_memory_pools) \
+  X(hsa_amd_memory_pool_allocate) \
+  X(hsa_amd_memory_pool_free) \
+  X(hsa_amd_memory_async_copy) \
+  X(hsa_amd_agent_memory_pool_get_info) \
+  X(hsa_amd_agents_allow_access) \
+  X(hsa_amd_memory_pool_can_migrate) \
+  X(hsa_amd_memory_migrate) \
+  X(hsa_amd_memory_lock) \
+  X(hsa_amd_memory_unlock) \
+  X(hsa_amd_memory_fill) \
+  X(hsa_amd_interop_map_buffer) \
+  X(hsa_amd_interop_unmap_buffer) \
+  X(hsa_amd_image_create) \
+  X(hsa_amd_pointer_info) \
+  X(hsa_amd_pointer_info_set_userdata) \
+  X(hsa_amd_ipc_memory_create) \
+  X(hsa_amd_ipc_memory_attach) \
+  X(hsa_amd_ipc_memory_detach) \
+  X(hsa_amd_signal_create) \
+  X(hsa_amd_ipc_signal_create) \
+  X(hsa_amd_ipc_signal_attach) \
+  X(hsa_amd_register_system_event_handler) \
+  X(hsa_amd_queue_intercept_create) \
+  X(hsa_amd_queue_intercept_register) \
+  X(hsa_amd_queue_set_priority) \
+  X(hsa_amd_memory_async_copy_rect) \
+  X(hsa_amd_runtime_queue_create_register) \
+  X(hsa_amd_memory_lock_to_pool) \
+  X(hsa_amd_register_deallocation_callback) \
+  X(hsa_amd_deregister_deallocation_callback) \
+  X(hsa_amd_memory_async_copy_batch) \
+  X(hsa_amd_signal_wait_stats) \
+  X(hsa_amd_memory_pool_free_async) \
+  X(hsa_amd_memory_lock_cache_invalidate) \
+  X(hsa_amd_queue_submit) \
+  X(hsa_amd_queue_intercept_set_mode) \
+  X(hsa_amd_queue_set_agent_dispatch_handler) \
+  X(hsa_amd_queue_set_class) \
+  X(hsa_amd_queue_get_progress_stats) \
+  X(hsa_amd_profiling_convert_ticks_to_system_domain) \
+  X(hsa_amd_executable_load_agent_code_objects) \
+  X(hsa_amd_executable_get_kernels) \
+  X(hsa_amd_memory_async_fill) \
+  X(hsa_amd_memory_async_fill_rect) \
+  X(hsa_amd_agent_get_memory_pools) \
+  X(hsa_amd_memory_async_prefetch) \
+  X(hsa_amd_launch_template_create) \
+  X(hsa_amd_launch_template_dispatch) \
+  X(hsa_amd_launch_template_destroy) \
+  X(hsa_amd_queue_capture_begin) \
+  X(hsa_amd_queue_capture_end) \
+  X(hsa_amd_graph_launch) \
+  X(hsa_amd_graph_destroy) \
+  X(hsa_amd_queue_create_device_enqueue) \
+  X(hsa_amd_queue_fence) \
+  X(hsa_amd_agent_link_cost) \
+  X(hsa_amd_image_import_async) \
+  X(hsa_amd_image_export_async) \
+  X(hsa_amd_image_copy_async) \
+  X(hsa_amd_image_clear_async) \
+  X(hsa_amd_profile_pool_create) \
+  X(hsa_amd_profile_pool_acquire) \
+  X(hsa_amd_profile_pool_submit) \
+  X(hsa_amd_profile_pool_flush) \
+  X(hsa_amd_profile_pool_destroy) \
+  X(hsa_amd_agents_allow_access_batch) \
+  X(hsa_amd_memory_tag_set) \
+  X(hsa_amd_memory_budget_set) \
+  X(hsa_amd_memory_usage_get) \
+  X(hsa_amd_signal_group_wait_n) \
+  X(hsa_amd_signal_group_wait_all) \
+  X(hsa_amd_memory_file_read_async) \
+  X(hsa_amd_memory_file_write_async) \
+  X(hsa_amd_memory_async_copy_multicast) \
+  X(hsa_amd_thread_policy_set)
+
+namespace core {
+
+/// @brief Per API call counts and sampled latency histograms.
+///
+/// Enable replaces every counted entry of the API table with a wrapper that counts the call and
+/// times one call in every HSA_API_STATS calls.  Counters are sharded by thread so counting costs
+/// an uncontended atomic add.  Tools loaded afterwards wrap the counting entries, so their own
+/// overhead is not included.
+class ApiStats {
+ public:
+  /// @brief Install counting wrappers into @p table, timing one call in @p period.
+  static void Enable(HsaApiTable& table, uint32_t period);
+
+  /// @brief Print counters of the APIs that were called to @p out, busiest first, and reset them.
+  static void Report(FILE* out);
+
+ private:
+  enum Api {
+#define HSA_API_STATS_ID(name) k_##name,
+    HSA_API_STATS_CORE_APIS(HSA_API_STATS_ID)
+    HSA_API_STATS_AMD_EXT_APIS(HSA_API_STATS_ID)
+#undef HSA_API_STATS_ID
+    kNumApis
+  };
+
+  // Latency bucket i counts sampled calls taking [2^(i+6), 2^(i+7)) ns, the first and last
+  // bucket also take shorter and longer calls.
+  static const uint32_t kBuckets = 16;
+  static const uint32_t kShards = 8;
+
+  struct Counters {
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> sampled;
+    std::atomic<uint64_t> sampled_ns;
+    std::atomic<uint64_t> buckets[kBuckets];
+  };
+
+  typedef void (*AnyFn)();
+
+  /// @brief Times the enclosing call if it is sampled.
+  class Sample {
+   public:
+    explicit Sample(uint32_t api);
+    ~Sample();
+
+   private:
+    Counters* counters_;
+    uint64_t start_;
+    DISALLOW_COPY_AND_ASSIGN(Sample);
+  };
+
+  template <typename Fn> struct Wrapper;
+
+  template <typename R, typename... Args> struct Wrapper<R (*)(Args...)> {
+    template <uint32_t Id> static R Call(Args... args) {
+      Sample sample(Id);
+      return reinterpret_cast<R (*)(Args...)>(next_[Id])(args...);
+    }
+  };
+
+  template <uint32_t Id, typename Fn> static void Install(Fn& entry, const char* name) {
+    if (entry == nullptr) return;
+    Fn wrapper = &Wrapper<Fn>::template Call<Id>;
+    if (entry == wrapper) return;
+    names_[Id] = name;
+    next_[Id] = reinterpret_cast<AnyFn>(entry);
+    entry = wrapper;
+  }
+
+  static uint32_t period_;
+  // kShards arrays of per API counters, allocated by the first Enable.
+  static Counters (*shards_)[kNumApis];
+  static AnyFn next_[kNumApis];
+  static const char* names_[kNumApis];
+};
+
+}  // namespace core
+#endif  // header guard
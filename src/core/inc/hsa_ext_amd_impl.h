@@ -83,6 +83,12 @@ hsa_status_t HSA_API
                                                     uint64_t agent_tick,
                                                     uint64_t* system_tick);
 
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API
+    hsa_amd_profiling_convert_ticks_to_system_domain(hsa_agent_t agent,
+                                                     const uint64_t* agent_ticks,
+                                                     uint64_t* system_ticks, size_t count);
+
 // Mirrors Amd Extension Apis
 hsa_status_t HSA_API
     hsa_amd_signal_async_handler(hsa_signal_t signal,
@@ -107,11 +113,28 @@ uint32_t HSA_API
                             hsa_wait_state_t wait_hint,
                             hsa_signal_value_t* satisfying_value);
 
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_signal_wait_stats(hsa_signal_t signal,
+                                               hsa_amd_signal_wait_stats_t* stats);
+
 // Mirrors Amd Extension Apis
 hsa_status_t HSA_API hsa_amd_queue_cu_set_mask(const hsa_queue_t* queue,
                                                uint32_t num_cu_mask_count,
                                                const uint32_t* cu_mask);
 
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_queue_submit(hsa_queue_t* queue, const void* packets,
+                                          uint32_t count, uint64_t timeout_ns);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_queue_get_progress_stats(const hsa_queue_t* queue,
+                                                      hsa_amd_queue_progress_stats_t* stats);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_queue_set_agent_dispatch_handler(hsa_queue_t* queue,
+                                                              hsa_amd_agent_dispatch_handler handler,
+                                                              void* data);
+
 // Mirrors Amd Extension Apis
 hsa_status_t HSA_API
     hsa_amd_memory_pool_get_info(hsa_amd_memory_pool_t memory_pool,
@@ -132,6 +155,9 @@ hsa_status_t HSA_API
 // Mirrors Amd Extension Apis
 hsa_status_t HSA_API hsa_amd_memory_pool_free(void* ptr);
 
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_memory_pool_free_async(void* ptr, hsa_signal_t signal);
+
 // Mirrors Amd Extension Apis
 hsa_status_t HSA_API
     hsa_amd_memory_async_copy(void* dst, hsa_agent_t dst_agent, const void* src,
@@ -147,6 +173,12 @@ hsa_status_t HSA_API hsa_amd_memory_async_copy_rect(
     hsa_amd_copy_direction_t dir, uint32_t num_dep_signals, const hsa_signal_t* dep_signals,
     hsa_signal_t completion_signal);
 
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_memory_async_copy_batch(
+    uint32_t num_copies, const hsa_amd_memory_copy_desc_t* copies, hsa_agent_t dst_agent,
+    hsa_agent_t src_agent, uint32_t num_dep_signals, const hsa_signal_t* dep_signals,
+    hsa_signal_t completion_signal);
+
 // Mirrors Amd Extension Apis
 hsa_status_t HSA_API hsa_amd_agent_memory_pool_get_info(
     hsa_agent_t agent, hsa_amd_memory_pool_t memory_pool,
@@ -181,6 +213,9 @@ hsa_status_t HSA_API hsa_amd_memory_lock_to_pool(void* host_ptr, size_t size, hs
 // Mirrors Amd Extension Apis
 hsa_status_t HSA_API hsa_amd_memory_unlock(void* host_ptr);
 
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_memory_lock_cache_invalidate(void* host_ptr, size_t size);
+
 // Mirrors Amd Extension Apis
 hsa_status_t HSA_API
     hsa_amd_memory_fill(void* ptr, uint32_t value, size_t count);
@@ -233,6 +268,10 @@ hsa_status_t HSA_API hsa_amd_register_system_event_handler(hsa_amd_system_event_
 hsa_status_t HSA_API hsa_amd_queue_set_priority(hsa_queue_t* queue,
                                                 hsa_amd_queue_priority_t priority);
 
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_queue_set_class(hsa_queue_t* queue,
+                                             hsa_amd_queue_class_t queue_class, uint32_t weight);
+
 // Mirrors Amd Extension Apis
 hsa_status_t HSA_API hsa_amd_register_deallocation_callback(
     void* ptr, hsa_amd_deallocation_callback_t callback, void* user_data);
@@ -241,6 +280,199 @@ hsa_status_t HSA_API hsa_amd_register_deallocation_callback(
 hsa_status_t HSA_API hsa_amd_deregister_deallocation_callback(
     void* ptr, hsa_amd_deallocation_callback_t callback);
 
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_executable_load_agent_code_objects(
+    hsa_executable_t executable, uint32_t num_agents, const hsa_agent_t* agents,
+    hsa_code_object_reader_t code_object_reader, const char* options,
+    hsa_loaded_code_object_t* loaded_code_objects);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_executable_get_kernels(hsa_executable_t executable,
+                                                    hsa_amd_executable_kernel_t* kernels,
+                                                    uint32_t* count);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_memory_async_fill(void* ptr, uint32_t value, uint32_t value_size,
+                                               size_t count, uint32_t num_dep_signals,
+                                               const hsa_signal_t* dep_signals,
+                                               hsa_signal_t completion_signal);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_memory_async_fill_rect(
+    const hsa_pitched_ptr_t* dst, const hsa_dim3_t* dst_offset, const hsa_dim3_t* range,
+    uint32_t value, uint32_t value_size, uint32_t num_dep_signals,
+    const hsa_signal_t* dep_signals, hsa_signal_t completion_signal);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_agent_get_memory_pools(hsa_agent_t agent, hsa_agent_t accessing_agent,
+                                                    hsa_amd_memory_pool_desc_t* memory_pools,
+                                                    uint32_t* count);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_memory_async_prefetch(const void* ptr, size_t size,
+                                                   hsa_agent_t agent, uint32_t num_dep_signals,
+                                                   const hsa_signal_t* dep_signals,
+                                                   hsa_signal_t completion_signal);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_launch_template_create(hsa_queue_t* queue,
+                                                    hsa_executable_symbol_t kernel,
+                                                    const hsa_kernel_dispatch_packet_t* dispatch,
+                                                    hsa_amd_launch_template_t* launch);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_launch_template_dispatch(hsa_amd_launch_template_t launch,
+                                                      const void* kernarg,
+                                                      hsa_signal_t completion_signal);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_launch_template_destroy(hsa_amd_launch_template_t launch);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_queue_capture_begin(hsa_queue_t* queue);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_queue_capture_end(hsa_queue_t* queue, hsa_amd_graph_t* graph);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_graph_launch(hsa_amd_graph_t graph, hsa_queue_t* queue,
+                                          hsa_signal_t completion_signal);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_graph_destroy(hsa_amd_graph_t graph);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_queue_create_device_enqueue(
+    hsa_agent_t agent, uint32_t size, hsa_queue_type32_t type,
+    void (*callback)(hsa_status_t status, hsa_queue_t* source, void* data), void* data,
+    uint32_t private_segment_size, uint32_t group_segment_size, hsa_queue_t** queue);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_queue_fence(uint32_t num_queues, hsa_queue_t* const* queues,
+                                         uint32_t num_copy_agents,
+                                         const hsa_agent_t* copy_agents);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_agent_link_cost(hsa_agent_t src_agent, hsa_agent_t dst_agent,
+                                             hsa_amd_link_cost_t* cost);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_image_import_async(hsa_agent_t agent, const void* src_memory,
+                                                size_t src_row_pitch, size_t src_slice_pitch,
+                                                hsa_ext_image_t dst_image,
+                                                const hsa_ext_image_region_t* image_region,
+                                                uint32_t num_dep_signals,
+                                                const hsa_signal_t* dep_signals,
+                                                hsa_signal_t completion_signal);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_image_export_async(hsa_agent_t agent, hsa_ext_image_t src_image,
+                                                void* dst_memory, size_t dst_row_pitch,
+                                                size_t dst_slice_pitch,
+                                                const hsa_ext_image_region_t* image_region,
+                                                uint32_t num_dep_signals,
+                                                const hsa_signal_t* dep_signals,
+                                                hsa_signal_t completion_signal);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_image_copy_async(hsa_agent_t agent, hsa_ext_image_t src_image,
+                                              const hsa_dim3_t* src_offset,
+                                              hsa_ext_image_t dst_image,
+                                              const hsa_dim3_t* dst_offset,
+                                              const hsa_dim3_t* range, uint32_t num_dep_signals,
+                                              const hsa_signal_t* dep_signals,
+                                              hsa_signal_t completion_signal);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_image_clear_async(hsa_agent_t agent, hsa_ext_image_t image,
+                                               const void* data,
+                                               const hsa_ext_image_region_t* image_region,
+                                               uint32_t num_dep_signals,
+                                               const hsa_signal_t* dep_signals,
+                                               hsa_signal_t completion_signal);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_profile_pool_create(hsa_agent_t agent, uint32_t command_size,
+                                                 uint32_t output_size, uint32_t num_buffers,
+                                                 uint32_t batch_size,
+                                                 hsa_amd_profile_data_callback_t callback,
+                                                 void* user_data, hsa_amd_profile_pool_t* pool);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_profile_pool_acquire(hsa_amd_profile_pool_t pool,
+                                                  hsa_amd_profile_buffer_t* buffer);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_profile_pool_submit(hsa_amd_profile_pool_t pool, uint32_t id,
+                                                 hsa_signal_t ready_signal);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_profile_pool_flush(hsa_amd_profile_pool_t pool);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_profile_pool_destroy(hsa_amd_profile_pool_t pool);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_agents_allow_access_batch(uint32_t num_agents,
+                                                       const hsa_agent_t* agents,
+                                                       const uint32_t* flags,
+                                                       uint32_t num_ptrs,
+                                                       const void* const* ptrs);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_memory_tag_set(uint32_t tag);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_memory_budget_set(hsa_amd_memory_pool_t pool, uint32_t tag,
+                                               size_t limit,
+                                               hsa_amd_memory_budget_callback_t callback,
+                                               void* data);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_memory_usage_get(hsa_amd_memory_pool_t pool, uint32_t tag,
+                                              hsa_amd_memory_usage_t* usage);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_signal_group_wait_n(hsa_signal_group_t signal_group,
+                                                 uint32_t num_required,
+                                                 hsa_signal_condition_t condition,
+                                                 hsa_signal_value_t compare_value,
+                                                 uint64_t timeout_hint,
+                                                 hsa_wait_state_t wait_state_hint,
+                                                 uint32_t* num_satisfied);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_signal_group_wait_all(hsa_signal_group_t signal_group,
+                                                   hsa_signal_condition_t condition,
+                                                   hsa_signal_value_t compare_value,
+                                                   uint64_t timeout_hint,
+                                                   hsa_wait_state_t wait_state_hint,
+                                                   uint32_t* num_satisfied);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_memory_file_read_async(int fd, uint64_t file_offset, void* dst,
+                                                    size_t size, hsa_agent_t dst_agent,
+                                                    uint32_t num_dep_signals,
+                                                    const hsa_signal_t* dep_signals,
+                                                    hsa_signal_t completion_signal);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_memory_file_write_async(int fd, uint64_t file_offset,
+                                                     const void* src, size_t size,
+                                                     hsa_agent_t src_agent,
+                                                     uint32_t num_dep_signals,
+                                                     const hsa_signal_t* dep_signals,
+                                                     hsa_signal_t completion_signal);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_memory_async_copy_multicast(
+    uint32_t num_dsts, void* const* dsts, const hsa_agent_t* dst_agents, const void* src,
+    hsa_agent_t src_agent, size_t size, uint32_t num_dep_signals,
+    const hsa_signal_t* dep_signals, hsa_signal_t completion_signal);
+
+// Mirrors Amd Extension Apis
+hsa_status_t HSA_API hsa_amd_thread_policy_set(hsa_amd_thread_class_t thread_class,
+                                               const hsa_amd_thread_policy_t* policy);
 }  // end of AMD namespace
 
 #endif  // header guard
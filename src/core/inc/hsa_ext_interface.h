@@ -43,11 +43,14 @@
 #ifndef HSA_RUNTME_CORE_INC_AMD_EXT_INTERFACE_H_
 #define HSA_RUNTME_CORE_INC_AMD_EXT_INTERFACE_H_
 
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "hsa_api_trace_int.h"
 
+#include "core/inc/finalization_cache.h"
+
 #include "core/util/os.h"
 #include "core/util/utils.h"
 
@@ -65,6 +68,9 @@ class ExtensionEntryPoints {
   // Table of function pointers for Hsa Extension Finalizer
   FinalizerExtTable finalizer_api;
 
+  // Persistent cache in front of hsa_ext_program_finalize, null if disabled.
+  std::unique_ptr<FinalizationCache> finalization_cache;
+
   ExtensionEntryPoints();
 
   bool LoadFinalizer(std::string library_name);
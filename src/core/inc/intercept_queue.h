@@ -52,6 +52,7 @@
 #include "core/inc/signal.h"
 #include "core/inc/interrupt_signal.h"
 #include "core/inc/exceptions.h"
+#include "core/inc/packet_graph.h"
 #include "core/util/locks.h"
 
 namespace core {
@@ -116,8 +117,8 @@ class QueueWrapper : public Queue {
   hsa_status_t SetCUMasking(const uint32_t num_cu_mask_count, const uint32_t* cu_mask) override {
     return wrapped->SetCUMasking(num_cu_mask_count, cu_mask);
   }
-  void ExecutePM4(uint32_t* cmd_data, size_t cmd_size_b) override {
-    wrapped->ExecutePM4(cmd_data, cmd_size_b);
+  void ExecutePM4(uint32_t* cmd_data, size_t cmd_size_b, bool wait = true) override {
+    wrapped->ExecutePM4(cmd_data, cmd_size_b, wait);
   }
   void SetProfiling(bool enabled) override { wrapped->SetProfiling(enabled); }
 
@@ -193,27 +194,58 @@ class InterceptQueue : public QueueProxy, private LocalSignal, public DoorbellSi
 
   void AddInterceptor(hsa_amd_queue_intercept_handler interceptor, void* data) {
     assert(interceptor != nullptr && "Packet intercept callback was nullptr.");
-    interceptors.push_back(std::make_pair(interceptor, data));
+    ScopedAcquire<KernelMutex> lock(&lock_);
+    interceptors.push_back({interceptor, data, HSA_AMD_QUEUE_INTERCEPT_MODE_REWRITE});
+    UpdateChain();
   }
 
+  // @brief Change how a registered interceptor takes part in packet processing.
+  // Returns false if @p interceptor was not registered with @p data.
+  bool SetInterceptorMode(hsa_amd_queue_intercept_handler interceptor, void* data,
+                          hsa_amd_queue_intercept_mode_t mode);
+
   hsa_status_t Inactivate() override {
     active_ = false;
     return wrapped->Inactivate();
   }
 
+  // @brief Record packets into a new graph instead of submitting them to hardware.  Applies to
+  // packets processed after the call.  Returns false if a capture is already in progress.
+  bool BeginCapture();
+
+  // @brief Stop capturing and return the captured graph, nullptr if no capture was in progress.
+  PacketGraph* EndCapture();
+
  private:
+  // Graph receiving final packets while capturing.  Guarded by lock_.
+  std::unique_ptr<PacketGraph> capture_;
+
   // Serialize packet interception processing.
   KernelMutex lock_;
 
   // Largest processed packet index.
   uint64_t next_packet_;
 
-  // Post interception packet overflow buffer
-  std::vector<AqlPacket> overflow_;
+  // Post interception packets waiting for hardware queue space, in submission order.
+  // Ring sized to the wrapped queue, indexed by monotonic head and tail.  Guarded by lock_.
+  std::unique_ptr<AqlPacket[]> overflow_;
+  uint64_t overflow_head_;
+  uint64_t overflow_tail_;
 
   // Index at which async intercept processing was scheduled.
   uint64_t retry_index_;
 
+  bool OverflowEmpty() const { return overflow_head_ == overflow_tail_; }
+
+  // Append packets behind those already stashed, draining to hardware if the ring is full.
+  void Stash(const AqlPacket* packets, uint64_t count);
+
+  // Submit stashed packets in order.  Returns true once the overflow ring is empty.
+  bool DrainOverflow();
+
+  // Record @p count packets starting at user packet @p index.
+  void TraceDispatches(Tracer& tracer, const AqlPacket* packets, uint64_t count, uint64_t index);
+
   // Event signal to use for async packet processing and control flag.
   InterruptSignal* async_doorbell_;
   std::atomic<bool> quit_;
@@ -224,8 +256,26 @@ class InterceptQueue : public QueueProxy, private LocalSignal, public DoorbellSi
   // Proxy packet buffer
   SharedArray<AqlPacket, 4096> buffer_;
 
-  // Packet transform callbacks
-  std::vector<std::pair<AMD::callback_t<hsa_amd_queue_intercept_handler>, void*>> interceptors;
+  struct Interceptor {
+    AMD::callback_t<hsa_amd_queue_intercept_handler> handler;
+    void* data;
+    hsa_amd_queue_intercept_mode_t mode;
+  };
+
+  // Registered packet callbacks, in registration order.  Element 0 is the final submission.
+  std::vector<Interceptor> interceptors;
+
+  // Submission followed by the rewriting interceptors, and the observing interceptors.
+  // Rebuilt from ::interceptors under ::lock_.
+  std::vector<Interceptor> chain_;
+  std::vector<Interceptor> observers_;
+
+  // Rebuild ::chain_ and ::observers_.
+  void UpdateChain();
+
+  // Forward runs of valid packets straight to the hardware queue.  Used when no interceptor
+  // rewrites packets.
+  uint64_t PassThrough(uint64_t index, uint64_t end);
 
   static const hsa_signal_value_t DOORBELL_MAX = 0xFFFFFFFFFFFFFFFFull;
 
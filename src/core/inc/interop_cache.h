@@ -0,0 +1,132 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// HSA runtime C++ interface file.
+
+#ifndef HSA_RUNTME_CORE_INC_INTEROP_CACHE_H_
+#define HSA_RUNTME_CORE_INC_INTEROP_CACHE_H_
+
+#include <list>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "core/inc/hsa_internal.h"
+#include "core/util/locks.h"
+#include "core/util/utils.h"
+
+namespace core {
+
+/// @brief Mapping cache for graphics buffers mapped with hsa_amd_interop_map_buffer.
+///
+/// Mappings are keyed by the identity of the file behind the interop handle, not the handle
+/// itself, since descriptors are reused once closed, and by the nodes they are mapped to.  They
+/// are reference counted so repeated maps of a buffer share one driver registration.  After its
+/// last unmap a mapping stays registered until more than HSA_INTEROP_CACHE_SIZE mappings are
+/// idle, so buffers mapped once per frame are only registered once.  An idle mapping keeps the
+/// graphics buffer alive.
+class InteropCache {
+ public:
+  InteropCache() {}
+  ~InteropCache() { Flush(); }
+
+  /// @brief Map the buffer of @p handle to @p nodes, or reuse an existing mapping.
+  ///
+  /// @param first (output) True if the buffer was newly registered.
+  hsa_status_t Map(int handle, const std::vector<uint32_t>& nodes, size_t* size, void** ptr,
+                   size_t* metadata_size, const void** metadata, bool& first);
+
+  /// @brief Release one map of @p ptr.
+  ///
+  /// @param status (output) Result of the unmap, if handled.
+  ///
+  /// @retval false @p ptr was not mapped through the cache.
+  bool Unmap(const void* ptr, hsa_status_t& status);
+
+  /// @brief Unregister all idle mappings.
+  void Flush();
+
+ private:
+  struct Key {
+    uint64_t device;
+    uint64_t inode;
+    std::vector<uint32_t> nodes;
+    bool operator<(const Key& rhs) const {
+      if (device != rhs.device) return device < rhs.device;
+      if (inode != rhs.inode) return inode < rhs.inode;
+      return nodes < rhs.nodes;
+    }
+  };
+
+  struct Mapping {
+    Key key;
+    void* ptr;
+    size_t size;
+    size_t metadata_size;
+    const void* metadata;
+    uint32_t refs;
+    std::list<Mapping*>::iterator idle;
+  };
+
+  /// @brief Unregister and drop an idle mapping.
+  void Evict(Mapping* mapping);
+
+  /// @brief Evict least recently used idle mappings until their number fits the limit.
+  void Trim();
+
+  KernelMutex lock_;
+
+  // Mappings by buffer identity and sorted node ids.
+  std::map<Key, std::unique_ptr<Mapping>> mappings_;
+
+  // Mappings by address.
+  std::map<const void*, Mapping*> by_ptr_;
+
+  // Idle mappings, most recently unmapped first.
+  std::list<Mapping*> idle_;
+
+  DISALLOW_COPY_AND_ASSIGN(InteropCache);
+};
+
+}  // namespace core
+#endif  // header guard
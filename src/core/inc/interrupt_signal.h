@@ -73,18 +73,15 @@ class InterruptSignal : private LocalSignal, public Signal {
     using unique_event_ptr = ::std::unique_ptr<HsaEvent, Deleter>;
 
     EventPool() : allEventsAllocated(false) {}
+    ~EventPool() { clear(); }
 
     HsaEvent* alloc();
     void free(HsaEvent* evt);
-    void clear() {
-      events_.clear();
-      allEventsAllocated = false;
-    }
+    void clear();
 
    private:
-    KernelMutex lock_;
-    std::vector<unique_event_ptr> events_;
-    bool allEventsAllocated;
+    FreeListCache<HsaEvent*> events_;
+    std::atomic<bool> allEventsAllocated;
   };
 
   static HsaEvent* CreateEvent(HSA_EVENTTYPE type, bool manual_reset);
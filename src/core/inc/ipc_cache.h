@@ -0,0 +1,132 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// HSA runtime C++ interface file.
+
+#ifndef HSA_RUNTME_CORE_INC_IPC_CACHE_H_
+#define HSA_RUNTME_CORE_INC_IPC_CACHE_H_
+
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "core/inc/hsa_internal.h"
+#include "inc/hsa_ext_amd.h"
+#include "core/util/locks.h"
+#include "core/util/utils.h"
+
+namespace core {
+
+/// @brief Import cache for memory attached with hsa_amd_ipc_memory_attach.
+///
+/// Imports are keyed by the shared handle of the exported block and the nodes it is mapped to,
+/// and reference counted, so repeated or concurrent attaches of the same block share one driver
+/// registration and mapping.  After its last detach an import stays mapped until more than
+/// HSA_IPC_CACHE_SIZE imports are idle, keeping the exporter's memory alive until then.
+class IpcCache {
+ public:
+  IpcCache() {}
+  ~IpcCache() { Flush(); }
+
+  /// @brief Attach the block of @p handle, with fragment bits cleared, to @p nodes, or to all
+  /// GPUs if @p nodes is empty.
+  ///
+  /// @param offset Byte offset of the attached pointer in the block.
+  /// @param ptr (output) Block address plus @p offset.
+  /// @param size (output) Size of the block.
+  /// @param first Called under the cache lock with @p ptr and @p size if @p ptr was not attached
+  /// before, so its bookkeeping can't interleave with the last detach of an earlier attach.
+  hsa_status_t Attach(const hsa_amd_ipc_memory_t& handle, const std::vector<uint32_t>& nodes,
+                      size_t offset, void** ptr, size_t* size,
+                      const std::function<void(void*, size_t)>& first);
+
+  /// @brief Release one attach of @p ptr.
+  ///
+  /// @param last Called under the cache lock if this was the last attach of @p ptr.
+  ///
+  /// @retval false @p ptr was not returned by Attach.
+  bool Detach(const void* ptr, const std::function<void()>& last);
+
+  /// @brief Unmap all idle imports.
+  void Flush();
+
+ private:
+  typedef std::pair<std::vector<uint32_t>, std::vector<uint32_t>> Key;
+
+  struct Import {
+    Key key;
+    void* base;
+    size_t size;
+    uint32_t refs;
+    std::list<Import*>::iterator idle;
+  };
+
+  struct Attachment {
+    Import* import;
+    uint32_t count;
+  };
+
+  /// @brief Unmap and drop an idle import.
+  void Evict(Import* import);
+
+  /// @brief Evict least recently used idle imports until their number fits the limit.
+  void Trim();
+
+  KernelMutex lock_;
+
+  // Imports by shared handle and sorted node ids.
+  std::map<Key, std::unique_ptr<Import>> imports_;
+
+  // Idle imports, most recently detached first.
+  std::list<Import*> idle_;
+
+  // Outstanding attaches by returned pointer.
+  std::map<const void*, Attachment> attached_;
+
+  DISALLOW_COPY_AND_ASSIGN(IpcCache);
+};
+
+}  // namespace core
+#endif  // header guard
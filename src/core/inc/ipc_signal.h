@@ -98,11 +98,28 @@ class IPCSignal : private SharedMemorySignal, public BusyWaitSignal {
   }
 
  private:
+  struct HandleLess {
+    bool operator()(const hsa_amd_ipc_signal_t& lhs, const hsa_amd_ipc_signal_t& rhs) const {
+      return memcmp(&lhs, &rhs, sizeof(lhs)) < 0;
+    }
+  };
+
   static int rtti_id_;
   static KernelMutex lock_;
 
-  explicit IPCSignal(SharedMemorySignal&& abi_block)
-      : SharedMemorySignal(std::move(abi_block)), BusyWaitSignal(signal(), true) {}
+  /// Attached signals by IPC handle, so repeated attaches skip mapping the
+  /// shared page only to find the signal already open.  Protected by lock_.
+  static std::map<hsa_amd_ipc_signal_t, hsa_signal_t, HandleLess> attached_;
+
+  IPCSignal(SharedMemorySignal&& abi_block, const hsa_amd_ipc_signal_t& ipc_handle)
+      : SharedMemorySignal(std::move(abi_block)),
+        BusyWaitSignal(signal(), true),
+        ipc_handle_(ipc_handle) {}
+
+  ~IPCSignal();
+
+  /// IPC handle this signal was attached from.
+  const hsa_amd_ipc_signal_t ipc_handle_;
 
   DISALLOW_COPY_AND_ASSIGN(IPCSignal);
 };
@@ -102,6 +102,11 @@ class Isa final: public amd::hsa::common::Signed<0xB13594F2BD8F212D> {
     return isa_object;
   }
 
+  /// @returns This Isa's index in the IsaRegistry, which identifies it as
+  /// well as its full name does.
+  uint32_t id() const {
+    return id_;
+  }
   /// @returns This Isa's version.
   const Version &version() const {
     return version_;
@@ -165,6 +170,12 @@ class Isa final: public amd::hsa::common::Signed<0xB13594F2BD8F212D> {
     assert(isa_handle.handle);
     return IsCompatible(Object(isa_handle));
   }
+  /// @returns True if code objects for @p code_object_isa run on agents with
+  /// this Isa, false otherwise.
+  bool Supports(const Isa *code_object_isa) const {
+    assert(code_object_isa);
+    return (supported_isas_ >> code_object_isa->id_) & 1;
+  }
   /// @brief Isa is always in valid state.
   bool IsValid() const {
     return true;
@@ -185,13 +196,19 @@ class Isa final: public amd::hsa::common::Signed<0xB13594F2BD8F212D> {
 
  private:
   /// @brief Default constructor.
-  Isa(): version_(Version(-1, -1, -1)), xnackEnabled_(false), sramEcc_(false) {}
+  Isa(): id_(0), supported_isas_(0), version_(Version(-1, -1, -1)), xnackEnabled_(false), sramEcc_(false) {}
 
   /// @brief Construct from @p version.
-  Isa(const Version &version): version_(version), xnackEnabled_(false), sramEcc_(false) {}
+  Isa(const Version &version): id_(0), supported_isas_(0), version_(version), xnackEnabled_(false), sramEcc_(false) {}
 
   /// @brief Construct from @p version.
-  Isa(const Version &version, const bool xnack, const bool ecc): version_(version), xnackEnabled_(xnack), sramEcc_(ecc) {}
+  Isa(const Version &version, const bool xnack, const bool ecc): id_(0), supported_isas_(0), version_(version), xnackEnabled_(xnack), sramEcc_(ecc) {}
+
+  /// @brief Isa's index in the IsaRegistry.
+  uint32_t id_;
+
+  /// @brief Bit mask of the ids of the Isas that this Isa runs code for.
+  uint64_t supported_isas_;
 
   /// @brief Isa's version.
   Version version_;
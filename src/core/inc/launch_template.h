@@ -0,0 +1,111 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// HSA runtime C++ interface file.
+
+#ifndef HSA_RUNTME_CORE_INC_LAUNCH_TEMPLATE_H_
+#define HSA_RUNTME_CORE_INC_LAUNCH_TEMPLATE_H_
+
+#include <stdint.h>
+
+#include "core/inc/hsa_internal.h"
+#include "core/inc/checked.h"
+#include "core/inc/queue.h"
+#include "inc/hsa_ext_amd.h"
+#include "core/util/utils.h"
+
+namespace core {
+
+/// @brief Pre-encoded dispatch of one kernel to one queue.
+///
+/// The packet is built once from the kernel symbol and the launch geometry.  Each launch
+/// reserves a queue slot, copies the kernel arguments into a kernarg slot owned by the
+/// template and indexed by the packet index, writes the packet body and publishes the header.
+/// No lock is taken.
+class LaunchTemplate : public Checked<0x6C1A3F8E5B2D9047> {
+ public:
+  static __forceinline hsa_amd_launch_template_t Convert(LaunchTemplate* launch) {
+    const hsa_amd_launch_template_t handle = {
+        static_cast<uint64_t>(reinterpret_cast<uintptr_t>(launch))};
+    return handle;
+  }
+  static __forceinline LaunchTemplate* Convert(hsa_amd_launch_template_t launch) {
+    return reinterpret_cast<LaunchTemplate*>(static_cast<uintptr_t>(launch.handle));
+  }
+
+  /// @brief Builds a template dispatching @p kernel to @p queue.
+  ///
+  /// @param dispatch Header, setup, workgroup and grid sizes of the launch.  Segment sizes are
+  /// raised to those required by @p kernel.
+  static hsa_status_t Create(Queue* queue, hsa_executable_symbol_t kernel,
+                             const hsa_kernel_dispatch_packet_t& dispatch,
+                             LaunchTemplate*& launch);
+
+  ~LaunchTemplate();
+
+  /// @brief Submits one dispatch with a copy of the @p kernarg_size() bytes at @p kernarg.
+  hsa_status_t Launch(const void* kernarg, hsa_signal_t completion_signal);
+
+  uint32_t kernarg_size() const { return kernarg_size_; }
+
+ private:
+  LaunchTemplate(Queue* queue, const hsa_kernel_dispatch_packet_t& packet, uint8_t* kernargs,
+                 uint32_t kernarg_size, size_t kernarg_stride, uint64_t kernarg_mask);
+
+  Queue* queue_;
+
+  /// Packet written by every launch, without kernarg address and completion signal.
+  hsa_kernel_dispatch_packet_t packet_;
+
+  /// Kernarg slots, twice the queue depth as for blit kernels.  A slot is rewritten only once
+  /// the queue has room for a packet a whole queue length past its dispatch.
+  uint8_t* kernargs_;
+  uint32_t kernarg_size_;
+  size_t kernarg_stride_;
+  uint64_t kernarg_mask_;
+
+  DISALLOW_COPY_AND_ASSIGN(LaunchTemplate);
+};
+
+}  // namespace core
+
+#endif  // header guard
@@ -0,0 +1,109 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// HSA runtime C++ interface file.
+
+#ifndef HSA_RUNTME_CORE_INC_LINK_TOPOLOGY_H_
+#define HSA_RUNTME_CORE_INC_LINK_TOPOLOGY_H_
+
+#include <atomic>
+#include <vector>
+
+#include "core/inc/hsa_internal.h"
+#include "core/util/locks.h"
+
+namespace core {
+class Agent;
+
+/// @brief Path costs between every pair of nodes, derived from the direct IO links reported by
+/// the KFD.
+///
+/// Nodes without a direct link are joined through the path with the fewest links, then the
+/// highest bandwidth.  A path's bandwidth is that of its slowest link and its latency the sum of
+/// its links'.  Links without bandwidth or latency information are given typical values of
+/// their type.  With HSA_LINK_CALIBRATION=1, the bandwidth between each GPU and its nearest CPU
+/// is replaced by that of a timed copy on the GPU's blits, once, on first query.
+class LinkTopology {
+ public:
+  struct Cost {
+    /// @brief Links on the path, 0 for the same node or unconnected nodes.
+    uint32_t hops;
+    /// @brief Latency in ns.
+    uint32_t latency;
+    /// @brief Bandwidth in MB/s, 0 for the same node or unconnected nodes.
+    uint64_t bandwidth;
+    /// @brief Bandwidth was measured.
+    bool calibrated;
+  };
+
+  LinkTopology() : num_nodes_(0), built_(false), calibrating_(false) {}
+
+  /// @brief Drop all costs, they are rebuilt for @p num_nodes nodes on next query.
+  void Reset(size_t num_nodes);
+
+  /// @brief Cost of moving data from @p node_from to @p node_to.
+  Cost Get(uint32_t node_from, uint32_t node_to);
+
+ private:
+  // Size of the calibration copies.
+  static const size_t kCalibrationSize = 16 * 1024 * 1024;
+
+  /// @brief Compute ::costs_ from the runtime's link matrix.  Caller holds ::lock_.
+  void Build();
+
+  /// @brief Time host<->device copies on every GPU and update ::costs_.
+  void Calibrate();
+
+  /// @brief Measured bandwidth of one copy in MB/s, 0 on failure.
+  static uint64_t TimeCopy(Agent* gpu, void* dst, Agent& dst_agent, const void* src,
+                           Agent& src_agent);
+
+  size_t num_nodes_;
+  std::vector<Cost> costs_;
+  bool built_;
+  std::atomic<bool> calibrating_;
+  KernelMutex lock_;
+};
+
+}  // namespace core
+
+#endif  // header guard
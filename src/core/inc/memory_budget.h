@@ -0,0 +1,117 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// HSA runtime C++ interface file.
+
+#ifndef HSA_RUNTME_CORE_INC_MEMORY_BUDGET_H_
+#define HSA_RUNTME_CORE_INC_MEMORY_BUDGET_H_
+
+#include <initializer_list>
+#include <map>
+#include <utility>
+
+#include "core/inc/hsa_internal.h"
+#include "core/util/locks.h"
+#include "core/util/utils.h"
+
+#include "inc/hsa_ext_amd.h"
+
+namespace core {
+class MemoryRegion;
+
+/// @brief Usage accounting and budgets for application allocations.
+///
+/// Allocations made through the public APIs are charged to the accounting tag of the calling
+/// thread in their memory pool, and to the pool's process wide account under
+/// HSA_AMD_MEMORY_TAG_ALL.  A charge that would take either account over its limit runs the
+/// account's callback, which may free memory and ask for a retry, and otherwise fails before the
+/// driver is asked for memory.
+class MemoryBudget {
+ public:
+  MemoryBudget() {}
+
+  /// @brief Set the accounting tag of the calling thread, 0 by default.
+  static void SetThreadTag(uint32_t tag);
+
+  /// @brief Accounting tag of the calling thread.
+  static uint32_t ThreadTag();
+
+  /// @brief Charge @p size bytes in @p region to @p tag.
+  ///
+  /// @retval HSA_STATUS_ERROR_OUT_OF_RESOURCES The charge exceeds a budget and no callback made
+  /// room for it.
+  hsa_status_t Charge(uint32_t tag, const MemoryRegion* region, size_t size);
+
+  /// @brief Return a charge made by Charge.
+  void Release(uint32_t tag, const MemoryRegion* region, size_t size);
+
+  /// @brief Set the budget of @p tag in @p region.  SIZE_MAX removes the limit.
+  void SetLimit(uint32_t tag, const MemoryRegion* region, size_t limit,
+                hsa_amd_memory_budget_callback_t callback, void* data);
+
+  /// @brief Usage of @p tag in @p region.
+  void GetUsage(uint32_t tag, const MemoryRegion* region, hsa_amd_memory_usage_t* usage);
+
+ private:
+  struct Account {
+    Account() : used(0), peak(0), limit(SIZE_MAX), allocations(0), callback(nullptr), data(nullptr) {}
+
+    size_t used;
+    size_t peak;
+    size_t limit;
+    uint64_t allocations;
+    hsa_amd_memory_budget_callback_t callback;
+    void* data;
+  };
+
+  typedef std::pair<uint32_t, const MemoryRegion*> Key;
+
+  KernelMutex lock_{"MemoryBudget::lock_"};
+
+  // Accounts by tag and region, HSA_AMD_MEMORY_TAG_ALL holding the region totals.
+  std::map<Key, Account> accounts_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemoryBudget);
+};
+
+}  // namespace core
+#endif  // header guard
@@ -86,7 +86,13 @@ class MemoryRegion : public Checked<0x9C961F19EE175BB3> {
     AllocateExecutable = (1 << 1),  // Set executable permission
     AllocateDoubleMap = (1 << 2),   // Map twice VA allocation to backing store
     AllocateDirect = (1 << 3),      // Bypass fragment cache.
-    AllocateIPC = (1 << 4),         // System memory that can be IPC-shared
+    AllocateIPC = (1 << 4),         // Memory that will be IPC-shared
+    AllocateHugePage = (1 << 5),    // Back with and map as 2MB pages
+    AllocateLazyMap = (1 << 6),     // Map system memory to GPU agents on first use
+    AllocateUser = (1 << 7),        // Made by the application, runtime only, not passed to regions
+    AllocateZero = (1 << 8),        // Zero initialized, runtime only, not passed to regions
+    AllocatePrefault = (1 << 9),    // Back every page of system memory at allocation
+    AllocateNumaBind = (1 << 10),   // Place system memory on the NUMA node of the owner
   };
 
   typedef uint32_t AllocateFlags;
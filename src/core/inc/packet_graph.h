@@ -0,0 +1,107 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// HSA runtime C++ interface file.
+
+#ifndef HSA_RUNTME_CORE_INC_PACKET_GRAPH_H_
+#define HSA_RUNTME_CORE_INC_PACKET_GRAPH_H_
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include "core/inc/hsa_internal.h"
+#include "core/inc/checked.h"
+#include "core/inc/queue.h"
+#include "core/inc/signal.h"
+#include "inc/hsa_ext_amd.h"
+#include "core/util/locks.h"
+#include "core/util/utils.h"
+
+namespace core {
+
+/// @brief AQL packets captured from an intercept queue, replayed with bulk submissions.
+///
+/// Packets keep the kernel argument buffers and signals they were captured with.  Completion
+/// signals are recycled: each replay first restores them to their values at capture.
+class PacketGraph : public Checked<0x2F7B5C91D4E8A316> {
+ public:
+  static __forceinline hsa_amd_graph_t Convert(PacketGraph* graph) {
+    const hsa_amd_graph_t handle = {static_cast<uint64_t>(reinterpret_cast<uintptr_t>(graph))};
+    return handle;
+  }
+  static __forceinline PacketGraph* Convert(hsa_amd_graph_t graph) {
+    return reinterpret_cast<PacketGraph*>(static_cast<uintptr_t>(graph.handle));
+  }
+
+  PacketGraph();
+
+  /// @brief Waits for the last replay before releasing the graph.
+  ~PacketGraph();
+
+  /// @brief Appends @p count packets, as they would have been submitted to hardware.
+  void Record(const AqlPacket* packets, uint64_t count);
+
+  /// @brief Submits the captured packets to @p queue, followed by a barrier decrementing
+  /// @p completion_signal if it is not null.  Waits for the previous replay to finish first.
+  hsa_status_t Launch(Queue* queue, hsa_signal_t completion_signal);
+
+  size_t size() const { return packets_.size(); }
+
+ private:
+  std::vector<AqlPacket> packets_;
+
+  /// Completion signals of the captured packets and their values at capture.
+  std::vector<std::pair<hsa_signal_t, hsa_signal_value_t>> signals_;
+
+  /// Decremented by the barrier closing each replay.
+  unique_signal_ptr done_;
+
+  /// Serializes replays.
+  KernelMutex lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(PacketGraph);
+};
+
+}  // namespace core
+
+#endif  // header guard
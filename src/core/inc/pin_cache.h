@@ -0,0 +1,139 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// HSA runtime C++ interface file.
+
+#ifndef HSA_RUNTME_CORE_INC_PIN_CACHE_H_
+#define HSA_RUNTME_CORE_INC_PIN_CACHE_H_
+
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "core/inc/hsa_internal.h"
+#include "core/util/locks.h"
+#include "core/util/utils.h"
+
+namespace amd {
+class MemoryRegion;
+}
+
+namespace core {
+
+/// @brief Registration cache for host memory locked with hsa_amd_memory_lock.
+///
+/// Locked ranges are registered with the driver page aligned and reference counted, so
+/// overlapping or repeated locks of the same memory share one registration.  A range stays
+/// registered and mapped after its last unlock until it is evicted, either because the idle
+/// ranges exceed HSA_PIN_CACHE_SIZE, because a new lock overlaps it or because the application
+/// invalidated it.  The cache cannot observe munmap, so applications enabling it must invalidate
+/// ranges before unmapping them.
+class PinCache {
+ public:
+  PinCache() : idle_bytes_(0) {}
+  ~PinCache() { Flush(); }
+
+  /// @brief True if HSA_PIN_CACHE_SIZE enables the cache.
+  bool enabled() const;
+
+  /// @brief Lock @p size bytes at @p host_ptr for @p nodes through @p region.
+  ///
+  /// @param status (output) Result of the lock, if handled.
+  ///
+  /// @retval false The range partially overlaps a range in use and must be locked uncached.
+  bool Lock(const amd::MemoryRegion& region, const std::vector<uint32_t>& nodes, void* host_ptr,
+            size_t size, void** agent_ptr, hsa_status_t& status);
+
+  /// @brief Release one lock of @p host_ptr made by Lock.
+  ///
+  /// @retval false @p host_ptr was not locked through the cache.
+  bool Unlock(const void* host_ptr);
+
+  /// @brief Unregister the idle ranges overlapping @p size bytes at @p ptr.  Ranges still locked
+  /// are unregistered by their last unlock and are not reused.
+  void Invalidate(const void* ptr, size_t size);
+
+  /// @brief Unregister all idle ranges.
+  void Flush();
+
+ private:
+  struct Range {
+    const amd::MemoryRegion* region;
+    uintptr_t base;
+    size_t size;
+    // Sorted GPU node ids the range is mapped to.
+    std::vector<uint32_t> nodes;
+    uintptr_t agent_base;
+    uint32_t refs;
+    bool stale;
+    std::list<Range*>::iterator idle;
+  };
+
+  typedef std::map<uintptr_t, std::unique_ptr<Range>> RangeMap;
+
+  /// @brief First range ending after @p addr.
+  RangeMap::iterator FirstOverlap(uintptr_t addr);
+
+  /// @brief Unregister and drop an unused range.
+  void Evict(RangeMap::iterator it);
+
+  /// @brief Evict least recently used idle ranges until the idle total fits the limit.
+  void Trim();
+
+  KernelMutex lock_{"PinCache::lock_"};
+
+  // Registered ranges by base address.  Ranges do not overlap.
+  RangeMap ranges_;
+
+  // Idle ranges, most recently unlocked first.
+  std::list<Range*> idle_;
+  size_t idle_bytes_;
+
+  // Outstanding locks by the host pointer passed to Lock.
+  std::map<const void*, std::vector<Range*>> locks_;
+
+  DISALLOW_COPY_AND_ASSIGN(PinCache);
+};
+
+}  // namespace core
+#endif  // header guard
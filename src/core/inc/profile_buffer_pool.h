@@ -0,0 +1,146 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// HSA runtime C++ interface file.
+
+#ifndef HSA_RUNTME_CORE_INC_PROFILE_BUFFER_POOL_H_
+#define HSA_RUNTME_CORE_INC_PROFILE_BUFFER_POOL_H_
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include "core/inc/hsa_internal.h"
+#include "core/inc/agent.h"
+#include "core/inc/checked.h"
+#include "core/inc/signal.h"
+#include "inc/hsa_ext_amd.h"
+#include "core/util/locks.h"
+#include "core/util/utils.h"
+
+namespace core {
+
+/// @brief Recycled counter collection buffers for one GPU.
+///
+/// Output buffers live in device local memory and command buffers in fine grain system memory,
+/// which the profiling library writes from the host.  Submitted buffers are read back to a
+/// system memory staging area with one batched DMA copy per batch_size buffers, gated on their
+/// ready signals.  The data callback then runs on a host worker for each buffer of the batch,
+/// after which the buffers are free again.
+class ProfileBufferPool : public Checked<0x6A1D93C07E25B4F8> {
+ public:
+  static __forceinline hsa_amd_profile_pool_t Convert(ProfileBufferPool* pool) {
+    const hsa_amd_profile_pool_t handle = {static_cast<uint64_t>(reinterpret_cast<uintptr_t>(pool))};
+    return handle;
+  }
+  static __forceinline ProfileBufferPool* Convert(hsa_amd_profile_pool_t pool) {
+    return reinterpret_cast<ProfileBufferPool*>(static_cast<uintptr_t>(pool.handle));
+  }
+
+  ProfileBufferPool(Agent* agent, uint32_t command_size, uint32_t output_size,
+                    uint32_t num_buffers, uint32_t batch_size,
+                    hsa_amd_profile_data_callback_t callback, void* user_data);
+
+  /// @brief Flushes submitted buffers and releases the memory.
+  ~ProfileBufferPool();
+
+  /// @brief Allocate the buffers.  Must succeed before any other call.
+  hsa_status_t Init();
+
+  /// @brief Hand out a free buffer, reading back submitted buffers first if
+  /// none is free.
+  hsa_status_t Acquire(hsa_amd_profile_buffer_t* buffer);
+
+  /// @brief Queue buffer @p id for readback once @p ready_signal reaches 0.
+  ///
+  /// @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT if @p id is not held by the
+  /// caller, such as a buffer submitted twice.
+  hsa_status_t Submit(uint32_t id, Signal* ready_signal);
+
+  /// @brief Read back every submitted buffer and wait for their callbacks.
+  hsa_status_t Flush();
+
+ private:
+  /// @brief Buffers read back by one DMA copy.
+  struct Batch {
+    std::vector<uint32_t> ids;
+    unique_signal_ptr copied;
+  };
+
+  /// @brief Start the readback of the queued buffers.  Caller holds lock_.
+  hsa_status_t IssueBatch();
+
+  /// @brief Deliver the data of @p batch and free its buffers.
+  void Complete(const Batch& batch);
+
+  Agent* agent_;
+  Agent* cpu_agent_;
+  const uint32_t command_size_;
+  const uint32_t output_size_;
+  const uint32_t num_buffers_;
+  const uint32_t batch_size_;
+  hsa_amd_profile_data_callback_t callback_;
+  void* user_data_;
+
+  uint8_t* commands_;
+  uint8_t* outputs_;
+  uint8_t* staging_;
+
+  KernelMutex lock_{"ProfileBufferPool::lock_"};
+  std::vector<uint32_t> free_;
+  // Buffers handed out by Acquire and not submitted yet, by id.
+  std::vector<bool> held_;
+  std::vector<uint32_t> queued_ids_;
+  std::vector<Signal*> queued_signals_;
+
+  /// Notified whenever buffers are freed.
+  ProgressEvent freed_;
+
+  /// Number of batches whose callbacks have not finished.
+  unique_signal_ptr in_flight_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProfileBufferPool);
+};
+
+}  // namespace core
+
+#endif  // header guard
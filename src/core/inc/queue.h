@@ -49,10 +49,12 @@
 #include "core/common/shared.h"
 
 #include "core/inc/checked.h"
+#include "core/util/locks.h"
 
 #include "core/util/utils.h"
 
 #include "inc/amd_hsa_queue.h"
+#include "inc/hsa_ext_amd.h"
 
 #include "hsakmt.h"
 
@@ -143,7 +145,14 @@ All funtions other than Convert and public_handle must be virtual.
 */
 class Queue : public Checked<0xFA3906A679F9DB49>, private LocalQueue {
  public:
-  Queue() : LocalQueue(), amd_queue_(queue()->amd_queue) {
+  Queue()
+      : LocalQueue(),
+        amd_queue_(queue()->amd_queue) {
+    for (ProgressSample& sample : progress_) {
+      sample.read = 0;
+      sample.sample_ns = 0;
+      sample.moved_ns = 0;
+    }
     queue()->core_queue = this;
     public_handle_ = Convert(this);
   }
@@ -295,14 +304,25 @@ class Queue : public Checked<0xFA3906A679F9DB49>, private LocalQueue {
   virtual hsa_status_t SetCUMasking(const uint32_t num_cu_mask_count,
                                     const uint32_t* cu_mask) = 0;
 
-  // @brief Submits a block of PM4 and waits until it has been executed.
-  virtual void ExecutePM4(uint32_t* cmd_data, size_t cmd_size_b) = 0;
+  // @brief Submits a block of PM4 and, if @p wait, waits until it has been executed.
+  // Submissions are executed in order, so a later waiting submission also waits for earlier
+  // non-waiting ones.
+  virtual void ExecutePM4(uint32_t* cmd_data, size_t cmd_size_b, bool wait = true) = 0;
 
   virtual void SetProfiling(bool enabled) {
     AMD_HSA_BITS_SET(amd_queue_.queue_properties, AMD_QUEUE_PROPERTIES_ENABLE_PROFILING,
                      (enabled != 0));
   }
 
+  /// @brief Independent samplers of GetProgressStats.  Each keeps its own previous sample, so the
+  /// scheduler polling a queue doesn't shorten the interval seen by the application.
+  enum ProgressSampler { kProgressApi = 0, kProgressScheduler = 1, kProgressSamplers = 2 };
+
+  /// @brief Sample the read and write indices and report the queue's depth, its dispatch rate
+  /// since the previous sample of @p sampler and how long it has held packets without progress.
+  void GetProgressStats(hsa_amd_queue_progress_stats_t* stats,
+                        ProgressSampler sampler = kProgressApi);
+
   /// @ brief Reports async queue errors to stderr if no other error handler was registered.
   static void DefaultErrorHandler(hsa_status_t status, hsa_queue_t* source, void* data);
 
@@ -328,8 +348,36 @@ class Queue : public Checked<0xFA3906A679F9DB49>, private LocalQueue {
   hsa_queue_t* public_handle_;
 
  private:
+  // Read index progress at the previous GetProgressStats sample of each sampler.
+  struct ProgressSample {
+    uint64_t read;
+    uint64_t sample_ns;
+    uint64_t moved_ns;
+  };
+  KernelMutex progress_lock_;
+  ProgressSample progress_[kProgressSamplers];
+
   DISALLOW_COPY_AND_ASSIGN(Queue);
 };
+
+/// @brief Writes @p count packets to @p queue and rings its doorbell once.
+///
+/// Slots are reserved with a compare and swap only once the queue has room for all packets, so
+/// producers never hold reserved slots while waiting.  Packet bodies are written first and the
+/// headers published in order.  Works on any Queue implementation, including proxy queues.
+///
+/// @param timeout_ns Longest wait for queue space, UINT64_MAX waits indefinitely.
+///
+/// @retval HSA_STATUS_ERROR_OUT_OF_RESOURCES The queue stayed too full for @p timeout_ns.
+hsa_status_t SubmitPackets(Queue* queue, const AqlPacket* packets, uint32_t count,
+                           uint64_t timeout_ns);
+
+/// @brief Reserves @p count consecutive slots of @p queue, as ::SubmitPackets does, and returns
+/// the first in @p write_index.  The caller writes the packets and rings the doorbell.
+///
+/// @retval HSA_STATUS_ERROR_OUT_OF_RESOURCES The queue stayed too full for @p timeout_ns.
+hsa_status_t ReservePackets(Queue* queue, uint32_t count, uint64_t timeout_ns,
+                            uint64_t& write_index);
 }
 
 #endif  // header guard
@@ -45,6 +45,7 @@
 #ifndef HSA_RUNTME_CORE_INC_RUNTIME_H_
 #define HSA_RUNTME_CORE_INC_RUNTIME_H_
 
+#include <atomic>
 #include <vector>
 #include <map>
 #include <memory>
@@ -56,6 +57,18 @@
 #include "core/inc/hsa_ext_amd_impl.h"
 
 #include "core/inc/agent.h"
+#include "core/inc/async_executor.h"
+#include "core/inc/cpu_copy_pool.h"
+#include "core/inc/host_queue_processor.h"
+#include "core/inc/interop_cache.h"
+#include "core/inc/ipc_cache.h"
+#include "core/inc/link_topology.h"
+#include "core/inc/memory_budget.h"
+#include "core/inc/pin_cache.h"
+#include "core/inc/tracer.h"
+#include "core/inc/stats_export.h"
+#include "core/inc/zero_pool.h"
+#include "core/inc/thread_policy.h"
 #include "core/inc/exceptions.h"
 #include "core/inc/memory_region.h"
 #include "core/inc/signal.h"
@@ -63,6 +76,7 @@
 #include "core/util/flag.h"
 #include "core/util/locks.h"
 #include "core/util/os.h"
+#include "core/util/sharded_range_map.h"
 #include "core/util/utils.h"
 
 #include "core/inc/amd_loader_context.hpp"
@@ -115,6 +129,16 @@ class Runtime {
   /// @retval True if the connection to kernel driver is opened.
   static bool IsOpen();
 
+  /// @brief Checks whether a warm shutdown kept the agents loaded.
+  static bool IsWarm();
+
+  /// @brief Run the deferred initialization of the tool libraries exporting
+  /// OnLoadDeferred, once.
+  ///
+  /// @retval true if it ran now, so the tools may have replaced API table
+  /// entries the caller was reached through.
+  bool LoadDeferredTools();
+
   // @brief Callback handler for VM fault access.
   static bool VMFaultHandler(hsa_signal_value_t val, void* arg);
 
@@ -147,6 +171,40 @@ class Runtime {
   /// @retval The link information between source and destination nodes.
   const LinkInfo GetLinkInfo(uint32_t node_id_from, uint32_t node_id_to);
 
+  /// @brief Query the cost of the best path between two nodes, which need
+  /// not be directly linked.
+  /// @param [in] node_id_from Node id of the source node.
+  /// @param [in] node_id_to Node id of the destination node.
+  LinkTopology::Cost GetLinkCost(uint32_t node_id_from, uint32_t node_id_to) {
+    return link_topology_.Get(node_id_from, node_id_to);
+  }
+
+  /// @brief Find the CPU agent closest to an agent by NUMA distance, then by
+  /// hop count.
+  /// @param [in] agent Agent to place memory for.
+  /// @retval @p agent for CPU agents, the first CPU agent if no link
+  /// information is available.
+  Agent* GetNearestCpuAgent(const Agent& agent);
+
+  /// @brief Find the CPU agent whose memory gives the fastest path from
+  /// @p src_agent to @p dst_agent, by link cost.
+  Agent* GetStagingCpuAgent(const Agent& src_agent, const Agent& dst_agent);
+
+  /// @brief Find the fine grain system region of the CPU agent closest to
+  /// @p agent.
+  const MemoryRegion* GetNearestSystemRegion(const Agent& agent);
+
+  /// @brief Allocate fine grain system memory close to @p agent. Memory is
+  /// released with ::system_deallocator.
+  ///
+  /// @param [in] agent Agent that will use the memory.
+  /// @param [in] size Allocation size in bytes.
+  /// @param [in] alloc_flags Allocation flags.
+  ///
+  /// @retval NULL if the allocation failed.
+  void* AllocateNearSystemMemory(const Agent& agent, size_t size,
+                                 MemoryRegion::AllocateFlags alloc_flags);
+
   /// @brief Invoke the user provided call back for each agent in the agent
   /// list.
   ///
@@ -180,6 +238,19 @@ class Runtime {
   /// @retval ::HSA_STATUS_SUCCESS if @p ptr is successfully released.
   hsa_status_t FreeMemory(void* ptr);
 
+  /// @brief Free memory previously allocated with AllocateMemory from an
+  /// asynchronous events thread once @p signal reaches 0. Frees that become
+  /// ready together are released in one pass.
+  ///
+  /// @param [in] ptr Address of the memory to be freed.
+  /// @param [in] signal Signal guarding the last use of @p ptr, or a null
+  /// handle to release the memory as soon as possible.
+  ///
+  /// @retval ::HSA_STATUS_ERROR_INVALID_ALLOCATION If @p ptr is not the address
+  /// of previous allocation via ::core::Runtime::AllocateMemory
+  /// @retval ::HSA_STATUS_SUCCESS if the release of @p ptr is queued.
+  hsa_status_t FreeMemoryAsync(void* ptr, hsa_signal_t signal);
+
   hsa_status_t RegisterReleaseNotifier(void* ptr, hsa_amd_deallocation_callback_t callback,
                                        void* user_data);
 
@@ -217,6 +288,67 @@ class Runtime {
                           std::vector<core::Signal*>& dep_signals,
                           core::Signal& completion_signal);
 
+  /// @brief Non-blocking submission of several memory copies which share
+  /// agents, dependencies and a completion signal.
+  ///
+  /// @details The copies are performed after all signals in @p dep_signals
+  /// have value of 0. @p completion_signal is decremented once, after every
+  /// copy has finished.
+  ///
+  /// @param [in] copies Non-empty list of copies, none of zero size.
+  /// @param [in] dst_agent Agent object associated with the destinations.
+  /// @param [in] src_agent Agent object associated with the sources.
+  /// @param [in] dep_signals Array of signal dependency.
+  /// @param [in] completion_signal Completion signal object.
+  ///
+  /// @retval ::HSA_STATUS_SUCCESS if the copies have been submitted
+  /// successfully.
+  hsa_status_t CopyMemoryBatch(const std::vector<hsa_amd_memory_copy_desc_t>& copies,
+                               core::Agent& dst_agent, core::Agent& src_agent,
+                               std::vector<core::Signal*>& dep_signals,
+                               core::Signal& completion_signal);
+
+  /// @brief Non-blocking copy of one source to several destinations.
+  ///
+  /// @details Destinations are fed along a relay tree built from the link
+  /// topology: a destination GPU with a direct XGMI link to a GPU which
+  /// already holds the data, and which that GPU can write to, is copied from
+  /// it instead of from @p src.  The copy is split in chunks so that every
+  /// hop of the tree forwards a chunk while the next one arrives.  The copies
+  /// are performed after all signals in @p dep_signals have value of 0.
+  /// @p completion_signal is decremented once, after every destination has
+  /// been written.
+  ///
+  /// @param [in] dsts Non-empty list of destinations, each @p size bytes.
+  /// @param [in] dst_agents Agent associated with each destination.
+  /// @param [in] src Memory address of the source.
+  /// @param [in] src_agent Agent object associated with the source.
+  /// @param [in] size Copy size in bytes, not zero.
+  /// @param [in] dep_signals Array of signal dependency.
+  /// @param [in] completion_signal Completion signal object.
+  ///
+  /// @retval ::HSA_STATUS_SUCCESS if the copies have been submitted
+  /// successfully.  A failure after part of the tree was submitted is
+  /// reported by leaving @p completion_signal negative.
+  hsa_status_t CopyMemoryMulticast(const std::vector<void*>& dsts,
+                                   const std::vector<core::Agent*>& dst_agents,
+                                   const void* src, core::Agent& src_agent, size_t size,
+                                   std::vector<core::Signal*>& dep_signals,
+                                   core::Signal& completion_signal);
+
+  /// @brief Hold back later work on every queue in @p queues and on the copy
+  /// engines of every GPU agent in @p copy_agents until all of them have
+  /// finished their work submitted so far.
+  ///
+  /// @details Each participant decrements a common arrival signal and then
+  /// waits on it, entirely on the device. The signals are released by the
+  /// async signal handler once every participant has passed the fence.
+  ///
+  /// @retval ::HSA_STATUS_SUCCESS if the fence has been submitted to every
+  /// participant.
+  hsa_status_t QueueFence(const std::vector<Queue*>& queues,
+                          const std::vector<Agent*>& copy_agents);
+
   /// @brief Fill the first @p count of uint32_t in ptr with value.
   ///
   /// @param [in] ptr Memory address to be filled.
@@ -226,6 +358,84 @@ class Runtime {
   /// @retval ::HSA_STATUS_SUCCESS if memory fill is successful and completed.
   hsa_status_t FillMemory(void* ptr, uint32_t value, size_t count);
 
+  /// @brief Returns the value of HSA_SYSTEM_INFO_TIMESTAMP.
+  ///
+  /// @details The KFD system clock is extrapolated from timer::fast_clock and
+  /// corrected against the driver every kSystemClockResyncInterval, so most
+  /// calls do not enter the kernel. Resyncs never step the clock backwards.
+  uint64_t SystemTimestamp();
+
+  /// @brief Returns the value of HSA_SYSTEM_INFO_TIMESTAMP_FREQUENCY.
+  uint64_t sys_clock_freq() const {
+    assert(sys_clock_freq_ != 0 &&
+           "Use of HSA_SYSTEM_INFO_TIMESTAMP_FREQUENCY before HSA "
+           "initialization completes.");
+    return sys_clock_freq_;
+  }
+
+  /// @brief Set every dword in @p ranges to @p value, asynchronously.
+  ///
+  /// @param [in] ranges Dword aligned ranges within a single allocation.
+  /// @param [in] value The pattern that will be used to set each dword.
+  /// @param [in] dep_signals Array of signal dependency.
+  /// @param [in] completion_signal Completion signal object.
+  ///
+  /// @retval ::HSA_STATUS_SUCCESS if the fill has been submitted
+  /// successfully.
+  hsa_status_t FillMemory(const std::vector<core::FillRange>& ranges, uint32_t value,
+                          std::vector<core::Signal*>& dep_signals,
+                          core::Signal& completion_signal);
+
+  /// @brief Run @p task on a host worker thread near @p agent once every
+  /// signal in @p dep_signals has reached zero, then decrement
+  /// @p completion_signal.  A task returning false fails the signal instead,
+  /// see Signal::FailRelease.  Tasks of the application set @p user and are
+  /// cancelled by a warm shutdown.
+  ///
+  /// @retval ::HSA_STATUS_SUCCESS if the task has been queued.
+  hsa_status_t SubmitHostTask(std::function<bool()> task, const Agent& agent,
+                              const std::vector<core::Signal*>& dep_signals,
+                              core::Signal& completion_signal, bool user = false);
+
+  /// @brief Returns a single use signal, with value 1, for producers that can
+  /// only decrement or store their completion signal.  Once the proxy reaches
+  /// zero @p timeline takes the proxy's profiling timestamps and is advanced
+  /// by one, and the proxy is destroyed.  Storing a negative value drops the
+  /// proxy without advancing @p timeline.
+  ///
+  /// @retval nullptr if the proxy could not be armed.
+  Signal* CreateTimelineProxy(Signal& timeline);
+
+  /// @brief Sample signal, event, memory pool, engine and queue counters into
+  /// @p page, leaving its header fields untouched.
+  void CollectStats(hsa_amd_stats_page_t& page);
+
+  /// @brief Stream @p size bytes between @p fd at @p file_offset and @p ptr,
+  /// accessible to the GPU @p agent, once every signal in @p dep_signals has
+  /// reached zero, then decrement @p completion_signal.
+  ///
+  /// @details Data is staged through a ring of pinned system memory buffers
+  /// so file I/O overlaps the DMA copies. A failed transfer leaves
+  /// @p completion_signal negative.
+  ///
+  /// @param [in] to_device True to read the file into @p ptr, false to write
+  /// @p ptr to the file.
+  ///
+  /// @retval ::HSA_STATUS_SUCCESS if the transfer has been queued.
+  hsa_status_t CopyFile(int fd, uint64_t file_offset, void* ptr, size_t size, Agent& agent,
+                        bool to_device, const std::vector<core::Signal*>& dep_signals,
+                        core::Signal& completion_signal);
+
+  /// @brief Make @p size bytes at @p ptr resident for @p agent once every
+  /// signal in @p dep_signals has reached zero, then decrement
+  /// @p completion_signal.
+  ///
+  /// @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT if the range is not within an
+  /// allocation.
+  hsa_status_t PrefetchMemory(const void* ptr, size_t size, Agent& agent,
+                              const std::vector<core::Signal*>& dep_signals,
+                              core::Signal& completion_signal);
+
   /// @brief Set agents as the whitelist to access ptr.
   ///
   /// @param [in] num_agents The number of agent handles in @p agents array.
@@ -238,6 +448,14 @@ class Runtime {
   hsa_status_t AllowAccess(uint32_t num_agents, const hsa_agent_t* agents,
                            const void* ptr);
 
+  /// @brief AllowAccess for @p num_ptrs allocations at once.  Pointers are looked up before
+  /// any access changes, and each memory region updates its share of the batch under a single
+  /// acquisition of its locks.
+  ///
+  /// @retval ::HSA_STATUS_ERROR A pointer is not a runtime allocation.
+  hsa_status_t AllowAccess(uint32_t num_agents, const hsa_agent_t* agents,
+                           uint32_t num_ptrs, const void* const* ptrs);
+
   /// @brief Query system information.
   ///
   /// @param [in] attribute System info attribute to query.
@@ -262,11 +480,15 @@ class Runtime {
   /// @param [in] arg Pointer to the argument that will be provided to @p
   /// handler.
   ///
+  /// @param [in] user True for application handlers, which run on the user lane of
+  /// ::async_executor_ when it is started.  Runtime handlers use its reserved lane.
+  ///
   /// @retval ::HSA_STATUS_SUCCESS Registration is successful.
   hsa_status_t SetAsyncSignalHandler(hsa_signal_t signal,
                                      hsa_signal_condition_t cond,
                                      hsa_signal_value_t value,
-                                     hsa_amd_signal_handler handler, void* arg);
+                                     hsa_amd_signal_handler handler, void* arg,
+                                     bool user = false);
 
   hsa_status_t InteropMap(uint32_t num_agents, Agent** agents,
                           int interop_handle, uint32_t flags, size_t* size,
@@ -293,8 +515,29 @@ class Runtime {
 
   hsa_status_t IPCDetach(void* ptr);
 
+  /// @brief Records the owner of a mapped range that is not in the allocation
+  /// map, so copies can classify pointers into it without a thunk query.
+  void RegisterPtrOwner(const void* ptr, size_t size, Agent* owner) {
+    ptr_owner_map_.Insert(ptr, size, std::move(owner));
+  }
+
+  /// @brief Drops the range registered at @p ptr, if any.
+  void DeregisterPtrOwner(const void* ptr) {
+    ptr_owner_map_.Erase(ptr, [](size_t, Agent*&) { return true; });
+  }
+
+  PinCache& pin_cache() { return pin_cache_; }
+
+  MemoryBudget& memory_budget() { return memory_budget_; }
+
+  Tracer& tracer() { return tracer_; }
+
+  HostQueueProcessor& host_queue_processor() { return host_queue_processor_; }
+
   const std::vector<Agent*>& cpu_agents() { return cpu_agents_; }
 
+  ThreadPolicies& thread_policies() { return thread_policies_; }
+
   const std::vector<Agent*>& gpu_agents() { return gpu_agents_; }
 
   const std::vector<uint32_t>& gpu_ids() { return gpu_ids_; }
@@ -344,9 +587,23 @@ class Runtime {
   static void AsyncEventsLoop(void*);
 
   struct AllocationRegion {
-    AllocationRegion() : region(NULL), size(0), user_ptr(nullptr) {}
-    AllocationRegion(const MemoryRegion* region_arg, size_t size_arg)
-        : region(region_arg), size(size_arg), user_ptr(nullptr) {}
+    AllocationRegion()
+        : region(NULL),
+          size(0),
+          user_ptr(nullptr),
+          user(false),
+          tag(0),
+          charged(0),
+          zeroed(false) {}
+    AllocationRegion(const MemoryRegion* region_arg, size_t size_arg, bool user_arg = false,
+                     uint32_t tag_arg = 0, size_t charged_arg = 0, bool zeroed_arg = false)
+        : region(region_arg),
+          size(size_arg),
+          user_ptr(nullptr),
+          user(user_arg),
+          tag(tag_arg),
+          charged(charged_arg),
+          zeroed(zeroed_arg) {}
 
     struct notifier_t {
       void* ptr;
@@ -357,39 +614,145 @@ class Runtime {
     const MemoryRegion* region;
     size_t size;
     void* user_ptr;
+    // Allocated through the public APIs, freed by a warm shutdown.
+    bool user;
+    // Accounting tag charged in memory_budget_, for user allocations.
+    uint32_t tag;
+    // Bytes charged to ::tag, the requested size rather than the rounded up
+    // ::size.
+    size_t charged;
+    // Zero initialized device memory, scrubbed by zero_pool_ for reuse once freed.  Cleared
+    // once the memory is made accessible to other agents, shared memory is not recycled.
+    bool zeroed;
     std::unique_ptr<std::vector<notifier_t>> notifiers;
   };
 
-  struct AsyncEventsControl {
-    AsyncEventsControl() : async_events_thread_(NULL) {}
-    void Shutdown();
+  /// @brief Allocation removed from allocation_map_ and not yet released.
+  struct DeferredFree {
+    const MemoryRegion* region;
+    void* ptr;
+    size_t size;
+    bool user;
+    uint32_t tag;
+    size_t charged;
+    bool zeroed;
+    std::unique_ptr<std::vector<AllocationRegion::notifier_t>> notifiers;
+  };
 
-    hsa_signal_t wake;
-    os::Thread async_events_thread_;
-    KernelMutex lock;
-    bool exit;
+  /// @brief Removes @p ptr from allocation_map_ into @p alloc.
+  hsa_status_t TakeAllocation(void* ptr, DeferredFree& alloc);
+
+  /// @brief Runs the release notifiers of @p alloc and frees its memory.
+  static hsa_status_t ReleaseAllocation(DeferredFree& alloc);
+
+  /// @brief Queues @p alloc for the next release pass, scheduling one if
+  /// needed.
+  void QueueDeferredFree(DeferredFree* alloc);
+
+  /// @brief Releases all queued frees.
+  static void ReleaseDeferredFrees(void* arg);
+
+  /// @brief Signal handler queueing the DeferredFree in @p arg.
+  static bool DeferredFreeReady(hsa_signal_value_t value, void* arg);
+
+  /// @brief Signal handler completing the timeline linked to a proxy.
+  static bool TimelineProxyDone(hsa_signal_value_t value, void* arg);
+
+  /// @brief Prefetch waiting for its dependencies.
+  struct DeferredPrefetch {
+    const void* ptr;
+    size_t size;
+    Agent* agent;
+    std::vector<core::Signal*> dep_signals;
+    size_t next_dep;
+    core::Signal* completion_signal;
   };
 
+  /// @brief Signal handler advancing the DeferredPrefetch in @p arg to its
+  /// next pending dependency, or running it once there is none.
+  static bool PrefetchReady(hsa_signal_value_t value, void* arg);
+
   struct AsyncEvents {
     void PushBack(hsa_signal_t signal, hsa_signal_condition_t cond,
                   hsa_signal_value_t value, hsa_amd_signal_handler handler,
-                  void* arg);
+                  void* arg, bool user);
 
-    void CopyIndex(size_t dst, size_t src);
+    /// @brief Removes entry @p index, moving the last entry into its place.
+    void Remove(size_t index);
 
     size_t Size();
 
-    void PopBack();
-
     void Clear();
 
-    std::vector<hsa_signal_t> signal_;
-    std::vector<hsa_signal_condition_t> cond_;
-    std::vector<hsa_signal_value_t> value_;
+    SignalWaitSet signal_;
     std::vector<hsa_amd_signal_handler> handler_;
     std::vector<void*> arg_;
+    std::vector<bool> user_;
+  };
+
+  /// @brief Handler registration waiting to be picked up by a monitoring
+  /// thread.
+  struct AsyncEventNode {
+    hsa_signal_t signal;
+    hsa_signal_condition_t cond;
+    hsa_signal_value_t value;
+    hsa_amd_signal_handler handler;
+    void* arg;
+    bool user;
+    AsyncEventNode* next;
+  };
+
+  /// @brief State of one asynchronous event monitoring thread.
+  struct AsyncEventsControl {
+    AsyncEventsControl()
+        : async_events_thread_(NULL),
+          started(false),
+          new_async_events_(NULL),
+          watched(0),
+          drop_user(false),
+          drop_request(0),
+          drop_done(0) {}
+    void Shutdown();
+
+    hsa_signal_t wake;
+    os::Thread async_events_thread_;
+    bool exit;
+    std::atomic<bool> started;
+
+    // Handlers watched by the thread.  Only the thread itself touches these
+    // once it is running.
+    AsyncEvents async_events_;
+
+    // Lock-free stack of new registrations, newest first.  Any thread may
+    // push; the monitoring thread takes the whole stack at once.
+    std::atomic<AsyncEventNode*> new_async_events_;
+
+    // Handlers in ::async_events_, published by the thread for statistics.
+    std::atomic<uint32_t> watched;
+
+    // While set the thread discards application handlers, watched or newly registered.  The
+    // thread copies ::drop_request to ::drop_done once it has swept them.
+    std::atomic<bool> drop_user;
+    volatile uint32_t drop_request;
+    volatile uint32_t drop_done;
   };
 
+  /// @brief Make every monitoring thread discard application handlers and wait until each
+  /// one has swept them.
+  void DropUserAsyncEvents();
+
+  /// @brief Stop application work that would cross a warm restart: handlers, async
+  /// functions and host tasks.  Queued work is cancelled, running work is waited for.
+  void CancelUserWork();
+
+  /// @brief Hands a registration to the monitoring thread of @p control.
+  static void QueueAsyncEvent(AsyncEventsControl& control, AsyncEventNode* node);
+
+  /// @brief Runs the handler of @p node, satisfied with @p value, on ::async_executor_.  Kept
+  /// handlers are queued back to @p control.
+  void ExecuteAsyncEvent(AsyncEventsControl& control, AsyncEventNode* node,
+                         hsa_signal_value_t value);
+
   // Will be created before any user could call hsa_init but also could be
   // destroyed before incorrectly written programs call hsa_shutdown.
   static KernelMutex bootstrap_lock_;
@@ -402,12 +765,19 @@ class Runtime {
 
   ~Runtime() {}
 
-  /// @brief Open connection to kernel driver.
+  /// @brief Open connection to kernel driver.  After a warm shutdown only
+  /// reloads the per session state: loader, extensions, tracer and tools.
   hsa_status_t Load();
 
-  /// @brief Close connection to kernel driver and cleanup resources.
+  /// @brief Close connection to kernel driver and cleanup resources.  With
+  /// HSA_WARM_RESTART only the per session state is released along with the
+  /// application's remaining allocations; agents, regions, internal queues
+  /// and blits stay loaded for the next Load.
   void Unload();
 
+  /// @brief Free the allocations the application did not free.
+  void FreeUserAllocations();
+
   /// @brief Dynamically load extension libraries (images, finalizer) and
   /// call OnLoad method on each loaded library.
   void LoadExtensions();
@@ -415,6 +785,42 @@ class Runtime {
   /// @brief Call OnUnload method on each extension library then close it.
   void UnloadExtensions();
 
+  /// @brief Finds the agent owning all of [ptr, ptr + size) in the allocation
+  /// map or the registered ranges.  Returns false if the range is unknown.
+  bool LookupPtrOwner(const void* ptr, size_t size, Agent*& owner);
+
+  /// @brief Maps the lazily mapped system allocation holding [ptr, ptr + size)
+  /// to @p agent before a copy by @p agent uses it.
+  ///
+  /// @param [out] lazy false if the range is not lazily mapped.
+  hsa_status_t MapOnFirstUse(const void* ptr, size_t size, Agent& agent, bool& lazy);
+
+  /// @brief Checks whether the allocation holding @p ptr is mapped to @p agent.
+  bool IsMapped(const void* ptr, const Agent& agent);
+
+  /// @brief Records the submission of an asynchronous copy of @p size bytes by node @p node_id.
+  void TraceAsyncCopy(uint32_t node_id, size_t size);
+
+  /// @brief Correlate timer::fast_clock with the KFD system clock and
+  /// publish the result for SystemTimestamp. Must hold sys_clock_lock_.
+  ///
+  /// @retval false if the driver could not be queried.
+  bool SyncSystemClock();
+
+  /// @brief Choose the agent filling [@p ptr, @p ptr + @p size).
+  ///
+  /// @param [out] fill_agent GPU which can access the range, or NULL if the
+  /// range is filled by the host.
+  /// @param [out] owner Agent owning the allocation.
+  ///
+  /// @retval ::HSA_STATUS_ERROR_INVALID_ALLOCATION if the range is not within
+  /// one allocation.
+  hsa_status_t FillAgent(void* ptr, size_t size, core::Agent** fill_agent,
+                         core::Agent** owner);
+
+  /// @brief Registers the owner reported by the thunk for a newly mapped range.
+  void RegisterMappedPtrOwner(void* ptr, size_t size);
+
   /// @brief Dynamically load tool libraries and call OnUnload method on each
   /// loaded library.
   void LoadTools();
@@ -424,7 +830,6 @@ class Runtime {
 
   /// @brief Close tool libraries.
   void CloseTools();
-
   // @brief Binds virtual memory access fault handler to this node.
   void BindVmFaultHandler();
 
@@ -439,14 +844,50 @@ class Runtime {
   /// @retval Index in ::link_matrix_.
   uint32_t GetIndexLinkInfo(uint32_t node_id_from, uint32_t node_id_to);
 
-  // Mutex object to protect multithreaded access to ::allocation_map_,
-  // KFD map/unmap, register/unregister, and access to hsaKmtQueryPointerInfo
-  // registered & mapped arrays.
-  KernelMutex memory_lock_;
+  /// @brief Get an idle staging buffer of ::kStagingBufferSize bytes in @p region, allocating one
+  /// if needed. Staging buffers are system memory mapped to all GPUs.
+  /// @retval nullptr if a buffer could not be allocated.
+  void* AcquireStagingBuffer(const MemoryRegion* region);
+
+  /// @brief Return a buffer obtained from ::AcquireStagingBuffer to the idle list.
+  void ReleaseStagingBuffer(const MemoryRegion* region, void* buffer);
+
+  /// @brief Copy between a GPU and unregistered system memory by pinning and copying in chunks,
+  /// so that the next chunk is pinned while the previous one is in flight.
+  hsa_status_t PipelinedLockedCopy(void* dst, const void* src, size_t size, Agent* gpu_agent,
+                                   bool h2d);
+
+  /// @brief Blocking body of ::CopyFile, run on a host worker.
+  hsa_status_t StreamFile(int fd, uint64_t file_offset, void* ptr, size_t size,
+                          Agent& gpu_agent, bool to_device);
+
+  // Synchronous CPU-GPU copies up to this size are staged instead of pinned.
+  static const size_t kStagingBufferSize = 1024 * 1024;
+
+  // Chunk size for pinning and copying large CPU-GPU copies.
+  static const size_t kLockedCopyChunkSize = 16 * 1024 * 1024;
+
+  // Mutex object to protect multithreaded access to KFD map/unmap,
+  // register/unregister, and access to hsaKmtQueryPointerInfo registered &
+  // mapped arrays.
+  KernelMutex memory_lock_{"Runtime::memory_lock_"};
 
   // Array containing tools library handles.
   std::vector<os::LibHandle> tool_libs_;
 
+  // OnLoadDeferred entries of the loaded tools, called by LoadDeferredTools.
+  struct DeferredTool {
+    bool (*init)(::HsaApiTable*, uint64_t, uint64_t, const char* const*);
+    std::string name;
+  };
+  std::vector<DeferredTool> deferred_tools_;
+  std::atomic<bool> deferred_tools_pending_{false};
+  KernelMutex deferred_tools_lock_{"Runtime::deferred_tools_lock_"};
+
+  // Set while the OnLoadDeferred entries run, without deferred_tools_lock_ so
+  // that they can call back into the runtime.  Other callers sleep on it.
+  volatile uint32_t deferred_tools_running_ = 0;
+
   // Agent list containing all CPU agents in the platform.
   std::vector<Agent*> cpu_agents_;
 
@@ -468,6 +909,45 @@ class Runtime {
   // Matrix of IO link.
   std::vector<LinkInfo> link_matrix_;
 
+  // Path costs derived from ::link_matrix_.
+  LinkTopology link_topology_;
+
+  // Worker threads for asynchronous CPU to CPU copies.
+  CpuCopyPool cpu_copy_pool_;
+
+  // Registration cache for locked host memory.
+  PinCache pin_cache_;
+
+  // Usage accounting and budgets of user allocations.
+  MemoryBudget memory_budget_;
+
+  // Scrubbed device memory for zero initialized allocations.
+  ZeroPool zero_pool_;
+
+  // Affinity and scheduling of the internal threads.
+  ThreadPolicies thread_policies_;
+
+  // Import cache for attached IPC memory.
+  IpcCache ipc_cache_;
+
+  // Mapping cache for graphics interop buffers.
+  InteropCache interop_cache_;
+
+  // Dispatch, copy and fill tracing.
+  Tracer tracer_;
+
+  // Counters published to shared memory for external monitors.
+  StatsExport stats_export_;
+
+  // Worker threads executing CPU agent queues.
+  HostQueueProcessor host_queue_processor_;
+
+  // Idle staging buffers for small synchronous copies.
+  std::map<const MemoryRegion*, std::vector<void*>> staging_buffers_;
+
+  // Mutex object to protect ::staging_buffers_.
+  KernelMutex staging_lock_{"Runtime::staging_lock_"};
+
   // Loader instance.
   amd::hsa::loader::Loader* loader_;
 
@@ -478,7 +958,11 @@ class Runtime {
   amd::hsa::code::AmdHsaCodeManager code_manager_;
 
   // Contains the region, address, and size of previously allocated memory.
-  std::map<const void*, AllocationRegion> allocation_map_;
+  // Lookups only take a shared lock, see ShardedRangeMap.
+  ShardedRangeMap<AllocationRegion> allocation_map_;
+
+  // Owners of locked, imported and interop ranges.
+  ShardedRangeMap<Agent*> ptr_owner_map_;
 
   // Allocator using ::system_region_
   std::function<void*(size_t, size_t, MemoryRegion::AllocateFlags)>
@@ -490,15 +974,49 @@ class Runtime {
   // Deprecated HSA Region API GPU (for legacy APU support only)
   Agent* region_gpu_;
 
-  AsyncEventsControl async_events_control_;
+  // Asynchronous event monitoring threads.  A signal always maps to the same
+  // thread so its handlers run in registration order.
+  std::vector<std::unique_ptr<AsyncEventsControl>> async_events_control_;
 
-  AsyncEvents async_events_;
+  // Serializes monitoring thread start up.
+  KernelMutex async_events_lock_{"Runtime::async_events_lock_"};
 
-  AsyncEvents new_async_events_;
+  // Round robin thread selection for plain functions.
+  std::atomic<uint32_t> async_events_next_;
+
+  // Runs async handlers off the monitoring threads if HSA_ASYNC_HANDLER_WORKERS is set.
+  AsyncExecutor async_executor_;
+
+  // Frees ready for release, whether a release pass is scheduled and whether
+  // the runtime stopped taking deferred frees.
+  std::vector<std::unique_ptr<DeferredFree>> deferred_frees_;
+  bool deferred_free_scheduled_;
+  bool deferred_free_closed_;
+  KernelMutex deferred_free_lock_{"Runtime::deferred_free_lock_"};
+
+  // Serializes release passes with runtime shutdown.
+  KernelMutex deferred_release_lock_{"Runtime::deferred_release_lock_"};
 
   // System clock frequency.
   uint64_t sys_clock_freq_;
 
+  // @brief Correlation of timer::fast_clock with the KFD system clock,
+  // published by SyncSystemClock as a seqlock, odd ::sys_clock_seq_ while an
+  // update is in progress. Times are fast_clock picoseconds.
+  std::atomic<uint32_t> sys_clock_seq_;
+  std::atomic<double> sys_clock_time_;
+  std::atomic<uint64_t> sys_clock_tick_;
+  std::atomic<double> sys_clock_ratio_;
+
+  // @brief First correlation, the ratio is measured against it.
+  double sys_clock_time0_;
+  uint64_t sys_clock_tick0_;
+
+  KernelMutex sys_clock_lock_{"Runtime::sys_clock_lock_"};
+
+  // @brief Interval between system clock resyncs, in milliseconds.
+  static const uint32_t kSystemClockResyncInterval = 100;
+
   // Number of Numa Nodes
   size_t num_nodes_;
 
@@ -513,7 +1031,7 @@ class Runtime {
       system_event_handlers_;
 
   // System event handler lock
-  KernelMutex system_event_lock_;
+  KernelMutex system_event_lock_{"Runtime::system_event_lock_"};
 
   // Internal queue creation notifier
   AMD::callback_t<hsa_amd_runtime_queue_notifier> internal_queue_create_notifier_;
@@ -523,6 +1041,13 @@ class Runtime {
   // Holds reference count to runtime object.
   std::atomic<uint32_t> ref_count_;
 
+  // Agents are discovered and the kernel driver is open, possibly while ref_count_ is zero after
+  // a warm shutdown.
+  bool platform_loaded_;
+
+  // Tool libraries wrapped or added agents, so shutdowns are never warm.
+  bool tools_own_agents_;
+
   // Track environment variables.
   Flag flag_;
 
@@ -49,6 +49,7 @@ namespace amd {
 // Reference: http://people.freedesktop.org/~agd5f/dma_packets.txt
 
 const unsigned int SDMA_OP_COPY = 1;
+const unsigned int SDMA_OP_WRITE = 2;
 const unsigned int SDMA_OP_FENCE = 5;
 const unsigned int SDMA_OP_TRAP = 6;
 const unsigned int SDMA_OP_POLL_REGMEM = 8;
@@ -57,6 +58,7 @@ const unsigned int SDMA_OP_CONST_FILL = 11;
 const unsigned int SDMA_OP_TIMESTAMP = 13;
 const unsigned int SDMA_SUBOP_COPY_LINEAR = 0;
 const unsigned int SDMA_SUBOP_COPY_LINEAR_RECT = 4;
+const unsigned int SDMA_SUBOP_WRITE_LINEAR = 0;
 const unsigned int SDMA_SUBOP_TIMESTAMP_GET_GLOBAL = 2;
 const unsigned int SDMA_ATOMIC_ADD64 = 47;
 
@@ -287,6 +289,42 @@ typedef struct SDMA_PKT_CONSTANT_FILL_TAG {
   static const size_t kMaxSize_ = 0x3fffe0;
 } SDMA_PKT_CONSTANT_FILL;
 
+// Write linear header, followed in the ring by the dwords to write.
+typedef struct SDMA_PKT_WRITE_UNTILED_TAG {
+  union {
+    struct {
+      unsigned int op : 8;
+      unsigned int sub_op : 8;
+      unsigned int reserved_0 : 16;
+    };
+    unsigned int DW_0_DATA;
+  } HEADER_UNION;
+
+  union {
+    struct {
+      unsigned int dst_addr_31_0 : 32;
+    };
+    unsigned int DW_1_DATA;
+  } DST_ADDR_LO_UNION;
+
+  union {
+    struct {
+      unsigned int dst_addr_63_32 : 32;
+    };
+    unsigned int DW_2_DATA;
+  } DST_ADDR_HI_UNION;
+
+  union {
+    struct {
+      unsigned int count : 20;
+      unsigned int reserved_0 : 4;
+      unsigned int sw : 2;
+      unsigned int reserved_1 : 6;
+    };
+    unsigned int DW_3_DATA;
+  } DW_3_UNION;
+} SDMA_PKT_WRITE_UNTILED;
+
 typedef struct SDMA_PKT_FENCE_TAG {
   union {
     struct {
@@ -48,6 +48,7 @@
 #include <map>
 #include <functional>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 #include <utility>
 
@@ -59,9 +60,12 @@
 #include "core/inc/exceptions.h"
 
 #include "core/util/utils.h"
+#include "core/util/free_list_cache.h"
 #include "core/util/locks.h"
+#include "core/util/timer.h"
 
 #include "inc/amd_hsa_signal.h"
+#include "inc/hsa_ext_amd.h"
 
 // Allow hsa_signal_t to be keys in STL structures.
 namespace std {
@@ -84,11 +88,21 @@ struct SharedSignal {
   amd_signal_t amd_signal;
   Signal* core_signal;
   Check<0x71FCCA6A3D5D5276, true> id;
+  // Set when load, store, add and subtract are plain atomics on amd_signal.value that need no
+  // wake up, see BusyWaitSignal.  Never set for IPC signals.
+  bool plain_ops;
+  // Host waiters of an IPC signal, in any process, sleeping on ipc_wake_seq.  Host updates of
+  // the value bump the sequence and wake them.
+  volatile uint32_t ipc_waiters;
+  volatile uint32_t ipc_wake_seq;
 
   SharedSignal() {
     memset(&amd_signal, 0, sizeof(amd_signal));
     amd_signal.kind = AMD_SIGNAL_KIND_INVALID;
     core_signal = nullptr;
+    plain_ops = false;
+    ipc_waiters = 0;
+    ipc_wake_seq = 0;
   }
 
   bool IsValid() const { return (Convert(this).handle != 0) && id.IsValid(); }
@@ -101,6 +115,17 @@ struct SharedSignal {
     return ret;
   }
 
+  /// @brief Returns the value of @p signal if its frequent operations may be done directly on it,
+  /// nullptr if they must go through the Signal object.  Destroyed signals have an invalid kind.
+  static __forceinline volatile int64_t* PlainValue(hsa_signal_t signal) {
+    if (signal.handle == 0) return nullptr;
+    SharedSignal* shared = Convert(signal);
+    if (!shared->id.IsValid() || !shared->plain_ops ||
+        (shared->amd_signal.kind != AMD_SIGNAL_KIND_USER))
+      return nullptr;
+    return &shared->amd_signal.value;
+  }
+
   static __forceinline hsa_signal_t Convert(const SharedSignal* signal) {
     assert(signal != nullptr && "Conversion on null Signal object.");
     const uint64_t handle = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(&signal->amd_signal));
@@ -114,6 +139,9 @@ static_assert(std::is_trivially_destructible<SharedSignal>::value,
               "SharedSignal must not be modified on delete for IPC use.");
 
 /// @brief Pool class for SharedSignal suitable for use with Shared.
+///
+/// Free slots are kept in a thread sharded cache so that alloc and free only
+/// take lock_ to grow the pool.
 class SharedSignalPool_t : private BaseShared {
  public:
   SharedSignalPool_t() : block_size_(minblock_) {}
@@ -123,10 +151,13 @@ class SharedSignalPool_t : private BaseShared {
   void free(SharedSignal* ptr);
   void clear();
 
+  /// @brief Number of signals the allocated blocks hold.
+  size_t capacity();
+
  private:
   static const size_t minblock_ = 4096 / sizeof(SharedSignal);
-  KernelMutex lock_;
-  std::vector<SharedSignal*> free_list_;
+  KernelMutex lock_{"SharedSignalPool_t::lock_"};
+  FreeListCache<SharedSignal*> free_list_;
   std::vector<std::pair<void*, size_t>> block_list_;
   size_t block_size_;
 };
@@ -145,6 +176,64 @@ class LocalSignal {
   Shared<SharedSignal, SharedSignalPool_t> local_signal_;
 };
 
+/// @brief Sizes the polling phase of signal waits from the wait times seen so
+/// far and keeps the wait counters reported by hsa_amd_signal_wait_stats.
+///
+/// Waits expected to end within kMaxSpin poll for about twice the expected
+/// time before sleeping.  Longer waits poll for only kMinSpin.  Updates are
+/// relaxed; concurrent waiters may lose an update, which only delays learning.
+class WaitPolicy {
+ public:
+  WaitPolicy();
+
+  /// @brief Returns how long a wait should poll before sleeping.
+  timer::fast_clock::duration Spin() const;
+
+  /// @brief Returns the expected wait time in nanoseconds.
+  uint64_t Expected() const { return expected_ns_.load(std::memory_order_relaxed); }
+
+  /// @brief Records a finished wait.  Only waits that met their condition
+  /// update the expected wait time.
+  void Record(bool satisfied, timer::fast_clock::duration elapsed, uint32_t sleeps,
+              timer::fast_clock::duration sleep_time);
+
+  void GetStats(hsa_amd_signal_wait_stats_t* stats) const;
+
+ private:
+  static const uint64_t kMaxSpinNs = 200000;
+  static const uint64_t kMinSpinNs = 10000;
+
+  /// @variable Moving average of the wait time, in nanoseconds.
+  std::atomic<uint64_t> expected_ns_;
+
+  std::atomic<uint64_t> waits_;
+  std::atomic<uint64_t> spin_ns_;
+  std::atomic<uint64_t> sleeps_;
+  std::atomic<uint64_t> sleep_ns_;
+
+  DISALLOW_COPY_AND_ASSIGN(WaitPolicy);
+};
+
+/// @brief Paces the polls of a spinning wait.  Pauses the processor between
+/// the first polls and yields it after that.
+class SpinBackoff {
+ public:
+  SpinBackoff() : polls_(0) {}
+
+  void Pause() {
+    if (polls_ < kPausePolls) {
+      polls_++;
+      CpuRelax();
+    } else {
+      os::YieldThread();
+    }
+  }
+
+ private:
+  static const uint32_t kPausePolls = 64;
+  uint32_t polls_;
+};
+
 /// @brief An abstract base class which helps implement the public hsa_signal_t
 /// type (an opaque handle) and its associated APIs. At its core, signal uses
 /// a 32 or 64 bit value. This value can be waitied on or signaled atomically
@@ -158,6 +247,9 @@ class Signal {
 
     waiting_ = 0;
     retained_ = 1;
+    event_sleeper_ = false;
+    wake_seq_ = 0;
+    timeline_ = false;
 
     if (enableIPC) {
       abi_block->core_signal = nullptr;
@@ -167,6 +259,11 @@ class Signal {
     }
   }
 
+  /// @brief Signal objects are recycled through per size class free lists
+  /// rather than the general heap.
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr, size_t size);
+
   /// @brief Interface to discard a signal handle (hsa_signal_t)
   /// Decrements signal ref count and invokes doDestroySignal() when
   /// Signal is no longer in use.
@@ -324,6 +421,34 @@ class Signal {
 
   __forceinline core::Agent* async_copy_agent() { return async_copy_agent_; }
 
+  WaitPolicy& wait_policy() { return wait_policy_; }
+
+  /// @brief Switches the signal to timeline mode.  Runtime producers then
+  /// advance the value by one per completed operation instead of
+  /// decrementing it.  Must be called before the signal is handed out.
+  void MakeTimeline() { timeline_ = true; }
+
+  bool timeline() const { return timeline_; }
+
+  /// @brief Reports completion of one runtime operation on the signal.
+  void CompleteRelease() {
+    if (timeline_)
+      AddRelease(1);
+    else
+      SubRelease(1);
+  }
+
+  /// @brief Reports failure of one runtime operation on the signal, leaving
+  /// its value negative.  Timeline signals are not advanced for it.
+  void FailRelease() {
+    if (timeline_) {
+      StoreRelease(-1);
+    } else {
+      StoreRelaxed(-1);
+      SubRelease(1);
+    }
+  }
+
   /// @brief Structure which defines key signal elements like type and value.
   /// Address of this struct is used as a value for the opaque handle of type
   /// hsa_signal_t provided to the public API.
@@ -345,12 +470,50 @@ class Signal {
   /// Value of zero means no waits.
   std::atomic<uint32_t> waiting_;
 
+  /// @brief Claims the signal's kernel event for sleeping.  Kernel events wake
+  /// a single sleeper, so only one waiter sleeps on the event at a time.  The
+  /// others sleep on ::wake_seq_ until that waiter returns.
+  bool AcquireEventSleep() {
+    bool expected = false;
+    return event_sleeper_.compare_exchange_strong(expected, true);
+  }
+
+  /// @brief Ends an event sleep and wakes the waiters sleeping behind it.
+  void ReleaseEventSleep() {
+    event_sleeper_.store(false);
+    atomic::Add(&wake_seq_, 1U);
+    os::WakeAllOnAddress(&wake_seq_);
+  }
+
+  /// @variable Set while a waiter sleeps on the kernel event.
+  std::atomic<bool> event_sleeper_;
+
+  /// @variable Advanced each time the event sleeper returns.
+  volatile uint32_t wake_seq_;
+
   /// @variable Pointer to agent used to perform an async copy.
   core::Agent* async_copy_agent_;
 
+  /// @variable Set for timeline signals, see MakeTimeline().
+  bool timeline_;
+
+  /// @variable Spin sizing and counters of waits on this signal.
+  WaitPolicy wait_policy_;
+
  private:
-  static KernelMutex ipcLock_;
-  static std::map<decltype(hsa_signal_t::handle), Signal*> ipcMap_;
+  /// @brief Registered IPC signals, sharded by handle so lookups of different
+  /// signals do not serialize.
+  struct IpcShard {
+    KernelMutex lock;
+    std::unordered_map<decltype(hsa_signal_t::handle), Signal*> map;
+  };
+  static const uint32_t kIpcShards = 16;
+  static IpcShard ipcShards_[kIpcShards];
+
+  static IpcShard& ipcShard(decltype(hsa_signal_t::handle) handle) {
+    // IPC signals are page aligned, mix in the page number.
+    return ipcShards_[((handle >> 12) ^ (handle >> 6)) % kIpcShards];
+  }
 
   static Signal* lookupIpc(hsa_signal_t signal);
   static Signal* duplicateIpc(hsa_signal_t signal);
@@ -364,9 +527,61 @@ class Signal {
   void registerIpc();
   bool deregisterIpc();
 
+  friend class SignalWaitSet;
+
   DISALLOW_COPY_AND_ASSIGN(Signal);
 };
 
+/// @brief Signal conditions waited on repeatedly.
+///
+/// Signals stay retained while in the set and the list of their kernel events
+/// is only rebuilt after the set changes, so waiting costs one pass over the
+/// signal values per wakeup rather than rebuilding the wait state.  Waits
+/// poll for the spin of the signal expected to complete first and are recorded
+/// against the signal that satisfied them.
+class SignalWaitSet {
+ public:
+  SignalWaitSet();
+  ~SignalWaitSet() { Clear(); }
+
+  void Add(hsa_signal_t signal, hsa_signal_condition_t cond, hsa_signal_value_t value);
+
+  /// @brief Removes the entry at @p index, moving the last entry into its place.
+  void Remove(size_t index);
+
+  void Clear();
+
+  size_t Size() const { return signals_.size(); }
+
+  hsa_signal_t Get(size_t index) const { return signals_[index]; }
+  hsa_signal_condition_t Condition(size_t index) const { return conds_[index]; }
+  hsa_signal_value_t Value(size_t index) const { return values_[index]; }
+
+  /// @brief Waits until any signal in the set satisfies its condition or
+  /// timeout is reached, with the semantics of Signal::WaitAny.
+  uint32_t Wait(uint64_t timeout_hint, hsa_wait_state_t wait_hint,
+                hsa_signal_value_t* satisfying_value);
+
+ private:
+  static const uint32_t kFollowerSliceMs = 1;
+
+  void UpdateEvents();
+
+  std::vector<hsa_signal_t> signals_;
+  std::vector<hsa_signal_condition_t> conds_;
+  std::vector<hsa_signal_value_t> values_;
+
+  /// @variable Sorted unique events of all signals, valid if ::sleepable_.
+  std::vector<HsaEvent*> events_;
+  bool sleepable_;
+  bool events_dirty_;
+
+  /// @variable First index scanned by the next wait.
+  uint32_t next_;
+
+  DISALLOW_COPY_AND_ASSIGN(SignalWaitSet);
+};
+
 /// @brief Handle signal operations which are not for use on doorbells.
 class DoorbellSignal : public Signal {
  public:
@@ -563,6 +778,18 @@ class SignalGroup : public Checked<0xBD35DDDD578F091> {
   const hsa_signal_t* List() const { return signals; }
   uint32_t Count() const { return count; }
 
+  /// @brief Waits until at least @p required signals of the group have been seen satisfying
+  /// @p condition or timeout is reached.  @p satisfied receives the number of satisfied
+  /// signals, less than @p required on timeout.  Returns false if a signal was destroyed
+  /// before enough were satisfied.  @p condition must be a valid condition.
+  ///
+  /// Once every remaining signal is needed the wait sleeps on the last signal of the group
+  /// only, which for in order completions such as a fan-out on one engine is the last to
+  /// finish, so the waiter wakes once for the whole group.
+  bool Wait(uint32_t required, hsa_signal_condition_t condition,
+            hsa_signal_value_t compare_value, uint64_t timeout, hsa_wait_state_t wait_hint,
+            uint32_t& satisfied) const;
+
  private:
   hsa_signal_t* signals;
   const uint32_t count;
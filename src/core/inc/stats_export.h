@@ -0,0 +1,98 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// HSA runtime C++ interface file.
+
+#ifndef HSA_RUNTME_CORE_INC_STATS_EXPORT_H_
+#define HSA_RUNTME_CORE_INC_STATS_EXPORT_H_
+
+#include <stdint.h>
+#include <string>
+
+#include "inc/hsa_ext_amd.h"
+#include "core/util/os.h"
+#include "core/util/utils.h"
+
+namespace core {
+
+/// @brief Publishes runtime counters to a named shared memory segment.
+///
+/// A thread of its own samples the runtime with Runtime::CollectStats every
+/// interval and copies the sample into the segment, an hsa_amd_stats_page_t,
+/// under a sequence lock.  Monitors in other processes read the page without
+/// any involvement of the runtime, and the paths the counters describe are
+/// not instrumented for it.
+class StatsExport {
+ public:
+  StatsExport() : segment_(NULL), page_(NULL), thread_(NULL), exit_(0), interval_ms_(0) {}
+  ~StatsExport() { Close(); }
+
+  /// @brief Create the segment @p name, if not empty, and start publishing
+  /// every @p interval_ms milliseconds.
+  void Open(const std::string& name, uint32_t interval_ms);
+
+  /// @brief Stop publishing and remove the segment.
+  void Close();
+
+ private:
+  static void PublishLoop(void* arg);
+
+  /// @brief Sample the runtime and update the page.
+  void Publish();
+
+  os::SharedSegment segment_;
+  hsa_amd_stats_page_t* page_;
+  os::Thread thread_;
+
+  // Set to stop ::thread_, which sleeps on it between updates.
+  volatile uint32_t exit_;
+  uint32_t interval_ms_;
+
+  // Sample being prepared, copied to the page in one go to keep the window
+  // readers retry on short.
+  hsa_amd_stats_page_t sample_;
+
+  DISALLOW_COPY_AND_ASSIGN(StatsExport);
+};
+
+}  // namespace core
+#endif  // header guard
@@ -0,0 +1,143 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// HSA runtime C++ interface file.
+
+#ifndef HSA_RUNTME_CORE_INC_THREAD_POLICY_H_
+#define HSA_RUNTME_CORE_INC_THREAD_POLICY_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "inc/hsa_ext_amd.h"
+#include "core/util/locks.h"
+#include "core/util/os.h"
+#include "core/util/utils.h"
+
+namespace core {
+
+/// @brief CPU affinity and scheduling of the runtime's internal threads.
+///
+/// Policies are set per thread class from HSA_THREAD_POLICY or
+/// hsa_amd_thread_policy_set.  Threads apply the policy of their class
+/// themselves, when they start and each time they wake after a change, so
+/// updates reach running threads without having to track their handles.
+/// Fields left unset do not touch the thread, or give it back the affinity
+/// and scheduling it had before a policy first set them.
+class ThreadPolicies {
+ public:
+  /// @brief Internal thread classes, in the order of hsa_amd_thread_class_t.
+  enum Class { kAsyncEvents, kAsyncHandlers, kHostQueue, kCpuCopy, kQueueScheduler, kNumClasses };
+
+  struct Policy {
+    Policy() : numa_node(-1), sched(HSA_AMD_THREAD_SCHED_DEFAULT), priority(0) {}
+
+    // CPUs the threads may run on, none to keep the affinity.
+    std::vector<uint32_t> cpus;
+    // Node of the CPU agent whose cores the threads run on when cpus is empty, -1 for none.
+    int32_t numa_node;
+    hsa_amd_thread_sched_t sched;
+    int32_t priority;
+  };
+
+  /// @brief Policy state of one thread, kept by the thread itself.
+  struct ThreadState {
+    ThreadState()
+        : generation(0),
+          saved(false),
+          cpus_saved(false),
+          sched_saved(false),
+          cpus_set(false),
+          sched_set(false),
+          sched(os::kSchedNormal),
+          priority(0) {}
+
+    // Generation of the policies last applied.
+    uint32_t generation;
+    // Affinity and scheduling of the thread before its first update.
+    bool saved;
+    bool cpus_saved;
+    bool sched_saved;
+    // Whether the applied policy changed the affinity or scheduling.
+    bool cpus_set;
+    bool sched_set;
+    std::vector<uint32_t> cpus;
+    os::ThreadSched sched;
+    int priority;
+  };
+
+  ThreadPolicies() : generation_(0) {}
+
+  /// @brief Replace every policy with those described by @p spec.
+  ///
+  /// @p spec is a list of "class:key=value,key=value" entries separated by
+  /// ';'.  Classes are events, handlers, host_queue, copy and scheduler.  Keys
+  /// are cpus (ranges such as 0-3+8), numa, sched (normal, batch, idle, fifo
+  /// or rr) and prio.  Malformed entries are skipped.
+  void Parse(const std::string& spec);
+
+  /// @brief Set the policy of @p cls.
+  void Set(Class cls, const Policy& policy);
+
+  /// @brief Apply the policy of @p cls to the calling thread if policies
+  /// changed since the generation in @p state, which is updated.  Each thread
+  /// passes its own state, default constructed when it starts.
+  void Apply(Class cls, ThreadState& state) {
+    if (generation_.load(std::memory_order_acquire) != state.generation) Update(cls, state);
+  }
+
+ private:
+  void Update(Class cls, ThreadState& state);
+
+  KernelMutex lock_{"ThreadPolicies::lock_"};
+
+  Policy policies_[kNumClasses];
+
+  // Advanced by each change.
+  std::atomic<uint32_t> generation_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadPolicies);
+};
+
+}  // namespace core
+#endif  // header guard
@@ -0,0 +1,158 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// HSA runtime C++ interface file.
+
+#ifndef HSA_RUNTME_CORE_INC_TRACER_H_
+#define HSA_RUNTME_CORE_INC_TRACER_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "inc/hsa_ext_amd.h"
+#include "core/util/locks.h"
+#include "core/util/os.h"
+#include "core/util/utils.h"
+
+namespace core {
+
+/// @brief Always-on tracing of dispatches, copies and fills.
+///
+/// Every producing thread appends to its own fixed size ring, so recording is a few stores and
+/// never blocks.  A thread finding its ring half full drains all rings if no other thread is
+/// draining, delivering records to the trace file and to tool OnTrace callbacks.  Records that
+/// do not fit a full ring are dropped and counted.
+class Tracer {
+ public:
+  typedef void (*Consumer)(const hsa_amd_trace_record_t* records, size_t count,
+                           uint64_t tick_frequency);
+
+  Tracer() : id_(next_id_++), enabled_(false), file_(NULL), dropped_(0) {}
+  ~Tracer() { Close(); }
+
+  /// @brief Open the trace file at @p path, if not empty, and enable tracing.
+  void Open(const std::string& path);
+
+  /// @brief Deliver records to @p consumer as well, and enable tracing.
+  void AddConsumer(Consumer consumer);
+
+  /// @brief Drain all rings, close the trace file and disable tracing.
+  void Close();
+
+  bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  /// @brief Host tick in the domain of trace records.
+  static uint64_t Now() { return os::ReadAccurateClock(); }
+
+  /// @brief Append @p record to the calling thread's ring.
+  void Record(const hsa_amd_trace_record_t& record);
+
+  /// @brief Record a blocking operation, from construction to destruction.
+  class Span {
+   public:
+    Span(Tracer& tracer, uint32_t kind, size_t size) : tracer_(tracer), start_(0) {
+      if (!tracer_.enabled()) return;
+      memset(&record_, 0, sizeof(record_));
+      record_.kind = kind;
+      record_.size = size;
+      start_ = Now();
+    }
+    ~Span() {
+      if (start_ == 0) return;
+      record_.start = start_;
+      record_.end = Now();
+      tracer_.Record(record_);
+    }
+
+   private:
+    Tracer& tracer_;
+    uint64_t start_;
+    hsa_amd_trace_record_t record_;
+    DISALLOW_COPY_AND_ASSIGN(Span);
+  };
+
+ private:
+  static const uint32_t kRingSize = 1024;
+
+  struct Ring {
+    Ring() : head(0), tail(0) {}
+    // Written only by the owning thread.
+    std::atomic<uint64_t> head;
+    // Written only by the draining thread.
+    std::atomic<uint64_t> tail;
+    hsa_amd_trace_record_t records[kRingSize];
+  };
+
+  /// @brief Ring of the calling thread, created on first use.
+  Ring* LocalRing();
+
+  /// @brief Deliver every ring's records.  Must hold drain_lock_.
+  void Drain();
+
+  // Distinguishes tracers of successive runtime instances in thread local ring lookups.
+  static std::atomic<uint64_t> next_id_;
+  const uint64_t id_;
+
+  std::atomic<bool> enabled_;
+
+  // Rings of all threads that recorded.  Rings outlive their threads so records of exited threads
+  // are still delivered.
+  KernelMutex rings_lock_{"Tracer::rings_lock_"};
+  std::vector<std::unique_ptr<Ring>> rings_;
+
+  // Serializes Drain and consumer changes.
+  KernelMutex drain_lock_{"Tracer::drain_lock_"};
+  FILE* file_;
+  std::vector<Consumer> consumers_;
+  std::vector<hsa_amd_trace_record_t> batch_;
+
+  std::atomic<uint64_t> dropped_;
+
+  DISALLOW_COPY_AND_ASSIGN(Tracer);
+};
+
+}  // namespace core
+#endif  // header guard
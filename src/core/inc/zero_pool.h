@@ -0,0 +1,113 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// HSA runtime C++ interface file.
+
+#ifndef HSA_RUNTME_CORE_INC_ZERO_POOL_H_
+#define HSA_RUNTME_CORE_INC_ZERO_POOL_H_
+
+#include <map>
+#include <vector>
+
+#include "core/inc/hsa_internal.h"
+#include "core/util/locks.h"
+#include "core/util/utils.h"
+
+namespace core {
+class MemoryRegion;
+class Signal;
+
+/// @brief Device memory scrubbed in the background for zero initialized allocations.
+///
+/// Buffers of zero initialized allocations are handed back here when they are freed instead of
+/// to their region.  The owning GPU fills them with zeros asynchronously, with SDMA constant fill
+/// where it is available, and later zero initialized allocations of about the same size take
+/// them once the fill has landed.  That keeps the fill off the allocation path.  At most
+/// HSA_ZERO_POOL_SIZE MB are held.
+class ZeroPool {
+ public:
+  ZeroPool() : held_bytes_(0) {}
+
+  /// @brief Take a scrubbed buffer of @p size bytes or slightly more from @p region.
+  ///
+  /// @param size (in/out) Requested size, updated to the size of the buffer.
+  ///
+  /// @retval NULL if no scrubbed buffer fits.
+  void* Take(const MemoryRegion* region, size_t& size);
+
+  /// @brief Queue @p ptr, an allocation of @p size bytes from @p region, for scrubbing.
+  ///
+  /// @retval false if the buffer was not taken and must be freed by the caller.
+  bool Put(const MemoryRegion* region, void* ptr, size_t size);
+
+  /// @brief Free the buffers held for @p region, or for every region if it is null, once their
+  /// scrubs have landed.
+  ///
+  /// @retval Bytes released.
+  size_t Trim(const MemoryRegion* region);
+
+ private:
+  struct Buffer {
+    const MemoryRegion* region;
+    void* ptr;
+    size_t size;
+    // Reaches zero once the buffer is filled.
+    Signal* scrubbed;
+  };
+
+  typedef std::multimap<size_t, Buffer> BufferMap;
+
+  /// @brief Wait for the scrub of each buffer then return it to its region.
+  static void Release(const std::vector<Buffer>& buffers);
+
+  KernelMutex lock_{"ZeroPool::lock_"};
+
+  // Buffers by region and size.
+  std::map<const MemoryRegion*, BufferMap> buffers_;
+
+  size_t held_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(ZeroPool);
+};
+
+}  // namespace core
+#endif  // header guard
@@ -67,23 +67,75 @@
 #include "core/inc/default_signal.h"
 #include "core/inc/hsa_ext_amd_impl.h"
 #include "core/inc/amd_gpu_pm4.h"
+#include "core/inc/amd_queue_scheduler.h"
 
 namespace amd {
+
+namespace {
+
+// Fills the 64 byte AQL slot @p slot_data with commands that run the
+// @p ib_size_dw dwords of PM4 at @p ib, as a set of PM4 fitting in the slot.
+template <uint32_t GfxIp> void EncodePM4Slot(uint32_t* slot_data, const void* ib,
+                                             uint32_t ib_size_dw) {
+  typedef Pm4<GfxIp> Encoder;
+  constexpr uint32_t slot_size_dw = 0x40 / sizeof(uint32_t);
+  constexpr uint32_t nop_pad_size_dw =
+      slot_size_dw - (Encoder::kIndirectBufferSizeDw + Encoder::kReleaseMemSizeDw);
+
+  // Pad the queue slot, then execute the IB, then advance the read index and
+  // invalidate the packet header. The last command must come last since it
+  // releases the queue slot for writing.
+  Encoder::Nop(slot_data, nop_pad_size_dw);
+  Encoder::IndirectBuffer(&slot_data[nop_pad_size_dw], ib, ib_size_dw);
+  Encoder::ReleaseMemAql(&slot_data[nop_pad_size_dw + Encoder::kIndirectBufferSizeDw]);
+}
+
+// From GFX9 the packet processor runs the IB from a vendor specific AQL
+// packet.
+template <> void EncodePM4Slot<9>(uint32_t* slot_data, const void* ib, uint32_t ib_size_dw) {
+  struct amd_aql_pm4_ib {
+    uint16_t header;
+    uint16_t ven_hdr;
+    uint32_t ib_jump_cmd[Pm4<9>::kIndirectBufferSizeDw];
+    uint32_t dw_cnt_remain;
+    uint32_t reserved[8];
+    hsa_signal_t completion_signal;
+  };
+  static_assert(sizeof(amd_aql_pm4_ib) == 0x40, "AQL PM4 IB packet must fill a queue slot");
+
+  constexpr uint32_t AMD_AQL_FORMAT_PM4_IB = 0x1;
+
+  amd_aql_pm4_ib aql_pm4_ib{};
+  aql_pm4_ib.header = HSA_PACKET_TYPE_VENDOR_SPECIFIC << HSA_PACKET_HEADER_TYPE;
+  aql_pm4_ib.ven_hdr = AMD_AQL_FORMAT_PM4_IB;
+  Pm4<9>::IndirectBuffer(aql_pm4_ib.ib_jump_cmd, ib, ib_size_dw);
+  aql_pm4_ib.dw_cnt_remain = 0xA;
+
+  memcpy(slot_data, &aql_pm4_ib, sizeof(aql_pm4_ib));
+}
+
+}  // namespace
+
 // Queue::amd_queue_ is cache-aligned for performance.
 const uint32_t kAmdQueueAlignBytes = 0x40;
 
 HsaEvent* AqlQueue::queue_event_ = nullptr;
 std::atomic<uint32_t> AqlQueue::queue_count_(0);
-KernelMutex AqlQueue::queue_lock_;
+KernelMutex AqlQueue::queue_lock_("AqlQueue::queue_lock_");
+std::set<AqlQueue*> AqlQueue::live_queues_;
 int AqlQueue::rtti_id_ = 0;
 
 AqlQueue::AqlQueue(GpuAgent* agent, size_t req_size_pkts, HSAuint32 node_id, ScratchInfo& scratch,
-                   core::HsaEventCallback callback, void* err_data, bool is_kv)
+                   core::HsaEventCallback callback, void* err_data, bool is_kv,
+                   bool device_ring)
     : Queue(),
       LocalSignal(0, false),
       DoorbellSignal(signal()),
       ring_buf_(nullptr),
       ring_buf_alloc_bytes_(0),
+      legacy_doorbell_value_(0),
+      legacy_doorbell_requests_(0),
+      legacy_doorbell_served_(0),
       queue_id_(HSA_QUEUEID(-1)),
       active_(false),
       agent_(agent),
@@ -91,11 +143,20 @@ AqlQueue::AqlQueue(GpuAgent* agent, size_t req_size_pkts, HSAuint32 node_id, Scr
       errors_callback_(callback),
       errors_data_(err_data),
       is_kv_queue_(is_kv),
+      device_ring_(device_ring),
+      ring_buf_in_vram_(false),
       pm4_ib_buf_(nullptr),
       pm4_ib_size_b_(0x1000),
+      pm4_ib_ticket_(0),
+      pm4_slot_encoder_(nullptr),
       dynamicScratchState(0),
       suspended_(false),
-      priority_(HSA_QUEUE_PRIORITY_NORMAL) {
+      priority_(HSA_QUEUE_PRIORITY_NORMAL),
+      scheduled_(false) {
+  queue_scratch_.queue = &amd_queue_;
+  scratch_high_water_ = queue_scratch_.size_per_thread;
+  scratch_ticket_ = 0;
+
   // When queue_full_workaround_ is set to 1, the ring buffer is internally
   // doubled in size. Virtual addresses in the upper half of the ring allocation
   // are mapped to the same set of pages backing the lower half.
@@ -108,9 +169,31 @@ AqlQueue::AqlQueue(GpuAgent* agent, size_t req_size_pkts, HSAuint32 node_id, Scr
           ? 1
           : 0;
 
+  // Pick the PM4 encoding of this agent once, ExecutePM4 does not test it.
+  switch (isa->GetMajorVersion()) {
+    case 7:
+      pm4_slot_encoder_ = EncodePM4Slot<7>;
+      break;
+    case 8:
+      pm4_slot_encoder_ = EncodePM4Slot<8>;
+      break;
+    case 9:
+      pm4_slot_encoder_ = EncodePM4Slot<9>;
+      break;
+    default:
+      pm4_slot_encoder_ = nullptr;
+      break;
+  }
+
   // Identify doorbell semantics for this agent.
   doorbell_type_ = agent->properties().Capability.ui32.DoorbellType;
 
+  // Device-side producers ring the 64-bit AQL doorbell directly, legacy doorbells need the
+  // host side serialization in StoreRelaxed.
+  if (device_ring_ && doorbell_type_ != 2)
+    throw AMD::hsa_exception(HSA_STATUS_ERROR_INVALID_QUEUE_CREATION,
+                             "Device enqueue requires AQL doorbells.\n");
+
   // Queue size is a function of several restrictions.
   const uint32_t min_pkts = ComputeRingBufferMinPkts();
   const uint32_t max_pkts = ComputeRingBufferMaxPkts();
@@ -262,8 +345,12 @@ AqlQueue::AqlQueue(GpuAgent* agent, size_t req_size_pkts, HSAuint32 node_id, Scr
     throw AMD::hsa_exception(HSA_STATUS_ERROR_OUT_OF_RESOURCES,
                              "Queue event handler failed registration.\n");
 
-  pm4_ib_buf_ = core::Runtime::runtime_singleton_->system_allocator()(
-      pm4_ib_size_b_, 0x1000, core::MemoryRegion::AllocateExecutable);
+  for (uint32_t i = 0; i < kPM4IBSlots; i++) {
+    pm4_ib_slots_[i].turn = i;
+    pm4_ib_slots_[i].packet_index = 0;
+  }
+  pm4_ib_buf_ = core::Runtime::runtime_singleton_->AllocateNearSystemMemory(
+      *agent_, pm4_ib_size_b_ * kPM4IBSlots, core::MemoryRegion::AllocateExecutable);
   if (pm4_ib_buf_ == nullptr)
     throw AMD::hsa_exception(HSA_STATUS_ERROR_OUT_OF_RESOURCES, "PM4 IB allocation failed.\n");
 
@@ -273,6 +360,11 @@ AqlQueue::AqlQueue(GpuAgent* agent, size_t req_size_pkts, HSAuint32 node_id, Scr
 
   active_ = true;
 
+  {
+    ScopedAcquire<KernelMutex> lock(&queue_lock_);
+    live_queues_.insert(this);
+  }
+
   PM4IBGuard.Dismiss();
   RingGuard.Dismiss();
   QueueGuard.Dismiss();
@@ -280,7 +372,27 @@ AqlQueue::AqlQueue(GpuAgent* agent, size_t req_size_pkts, HSAuint32 node_id, Scr
   SignalGuard.Dismiss();
 }
 
+uint64_t AqlQueue::CollectStats(hsa_amd_stats_queue_t* stats, uint32_t max) {
+  ScopedAcquire<KernelMutex> lock(&queue_lock_);
+  uint32_t count = 0;
+  for (AqlQueue* queue : live_queues_) {
+    if (count == max) break;
+    hsa_amd_stats_queue_t& entry = stats[count++];
+    entry.id = queue->amd_queue_.hsa_queue.id;
+    entry.node_id = queue->agent_->node_id();
+    entry.size = queue->amd_queue_.hsa_queue.size;
+    entry.read_index = queue->LoadReadIndexRelaxed();
+    entry.write_index = queue->LoadWriteIndexRelaxed();
+  }
+  return live_queues_.size();
+}
+
 AqlQueue::~AqlQueue() {
+  {
+    ScopedAcquire<KernelMutex> lock(&queue_lock_);
+    live_queues_.erase(this);
+  }
+
   // Remove error handler synchronously.
   // Sequences error handler callbacks with queue destroy.
   dynamicScratchState |= ERROR_HANDLER_TERMINATE;
@@ -291,9 +403,11 @@ AqlQueue::~AqlQueue() {
     HSA::hsa_signal_store_relaxed(amd_queue_.queue_inactive_signal, 0x8000000000000000ull);
   }
 
+  if (scheduled_) agent_->queue_scheduler().Remove(this);
+
   Inactivate();
   agent_->ReleaseQueueScratch(queue_scratch_);
-  FreeRegisteredRingBuffer();
+  FreeRegisteredRingBuffer(true);
   HSA::hsa_signal_destroy(amd_queue_.queue_inactive_signal);
   if (core::g_use_interrupt_wait) {
     ScopedAcquire<KernelMutex> lock(&queue_lock_);
@@ -370,18 +484,51 @@ uint64_t AqlQueue::AddWriteIndexRelease(uint64_t value) {
 }
 
 void AqlQueue::StoreRelaxed(hsa_signal_value_t value) {
+  // Packets may point at kernargs the host wrote to VRAM.
+  if (agent_->kernarg_region() != nullptr) agent_->FlushHdp();
+
   if (doorbell_type_ == 2) {
     // Hardware doorbell supports AQL semantics.
     atomic::Store(signal_.hardware_doorbell_ptr, uint64_t(value), std::memory_order_release);
     return;
   }
 
-  // Acquire spinlock protecting the legacy doorbell.
-  while (atomic::Cas(&amd_queue_.legacy_doorbell_lock, 1U, 0U,
-                     std::memory_order_acquire) != 0) {
-    os::YieldThread();
+  // Publish the doorbell request.  Producers never wait for the doorbell lock: the producer
+  // holding it rings once for every request published so far and rechecks after releasing the
+  // lock, so requests published while it was held are not lost.
+#ifdef HSA_LARGE_MODEL
+  uint64_t pending = atomic::Load(&legacy_doorbell_value_, std::memory_order_relaxed);
+  while (pending < uint64_t(value)) {
+    const uint64_t prev = atomic::Cas(&legacy_doorbell_value_, uint64_t(value), pending,
+                                      std::memory_order_relaxed);
+    if (prev == pending) break;
+    pending = prev;
   }
+#endif
+  atomic::Increment(&legacy_doorbell_requests_, std::memory_order_seq_cst);
+
+  while (atomic::Load(&legacy_doorbell_requests_, std::memory_order_acquire) !=
+         atomic::Load(&legacy_doorbell_served_, std::memory_order_relaxed)) {
+    if (atomic::Cas(&amd_queue_.legacy_doorbell_lock, 1U, 0U, std::memory_order_acquire) != 0)
+      return;
 
+    const uint64_t requests = atomic::Load(&legacy_doorbell_requests_, std::memory_order_acquire);
+    if (requests != legacy_doorbell_served_) {
+      RingLegacyDoorbell(atomic::Load(&legacy_doorbell_value_, std::memory_order_relaxed));
+      atomic::Store(&legacy_doorbell_served_, requests, std::memory_order_relaxed);
+    }
+
+    // Release lock protecting the legacy doorbell.
+    // Also ensures timely delivery of (write-combined) doorbell to HW.
+    atomic::Store(&amd_queue_.legacy_doorbell_lock, 0U, std::memory_order_release);
+
+    // Keep the recheck from being satisfied before the unlock is visible, or a producer that
+    // failed to take the lock in between would have its request dropped.
+    atomic::Fence(std::memory_order_seq_cst);
+  }
+}
+
+void AqlQueue::RingLegacyDoorbell(uint64_t value) {
 #ifdef HSA_LARGE_MODEL
   // AMD hardware convention expects the packet index to point beyond
   // the last packet to be processed. Packet indices written to the
@@ -433,11 +580,6 @@ void AqlQueue::StoreRelaxed(hsa_signal_value_t value) {
       assert(false && "Agent has unsupported doorbell semantics");
     }
   }
-
-  // Release spinlock protecting the legacy doorbell.
-  // Also ensures timely delivery of (write-combined) doorbell to HW.
-  atomic::Store(&amd_queue_.legacy_doorbell_lock, 0U,
-                std::memory_order_release);
 }
 
 void AqlQueue::StoreRelease(hsa_signal_value_t value) {
@@ -481,7 +623,39 @@ uint32_t AqlQueue::ComputeRingBufferMaxPkts() {
   return uint32_t(max_bytes / sizeof(core::AqlPacket));
 }
 
+bool AqlQueue::AllocDeviceRingBuffer(uint32_t queue_size_pkts) {
+  const MemoryRegion* region = agent_->local_region();
+  if (region == nullptr || !region->IsPublic()) return false;
+
+  const size_t bytes = AlignUp(queue_size_pkts * sizeof(core::AqlPacket), 4096);
+  void* ring = nullptr;
+  core::Runtime* runtime = core::Runtime::runtime_singleton_;
+  if (runtime->AllocateMemory(region, bytes, core::MemoryRegion::AllocateNoFlags, &ring) !=
+      HSA_STATUS_SUCCESS)
+    return false;
+
+  // The host still initializes the ring and may submit alongside the device.
+  std::vector<hsa_agent_t> cpus;
+  for (auto cpu : runtime->cpu_agents()) cpus.push_back(cpu->public_handle());
+  if (runtime->AllowAccess(uint32_t(cpus.size()), &cpus[0], ring) != HSA_STATUS_SUCCESS) {
+    runtime->FreeMemory(ring);
+    return false;
+  }
+
+  ring_buf_ = ring;
+  ring_buf_alloc_bytes_ = uint32_t(bytes);
+  ring_buf_in_vram_ = true;
+  return true;
+}
+
 void AqlQueue::AllocRegisteredRingBuffer(uint32_t queue_size_pkts) {
+  if (device_ring_) {
+    if (AllocDeviceRingBuffer(queue_size_pkts)) return;
+    // Fall back to fine grain system memory, coherent with the device but slower to write.
+  } else if (agent_->TakeRingBuffer(queue_size_pkts, ring_buf_, ring_buf_alloc_bytes_)) {
+    return;
+  }
+
   if ((agent_->profile() == HSA_PROFILE_FULL) && queue_full_workaround_) {
     // Compute the physical and virtual size of the queue.
     uint32_t ring_buf_phys_size_bytes =
@@ -615,8 +789,8 @@ void AqlQueue::AllocRegisteredRingBuffer(uint32_t queue_size_pkts) {
     ring_buf_alloc_bytes_ = AlignUp(
         queue_size_pkts * sizeof(core::AqlPacket), 4096);
 
-    ring_buf_ = core::Runtime::runtime_singleton_->system_allocator()(
-        ring_buf_alloc_bytes_, 0x1000, core::MemoryRegion::AllocateExecutable |
+    ring_buf_ = core::Runtime::runtime_singleton_->AllocateNearSystemMemory(
+        *agent_, ring_buf_alloc_bytes_, core::MemoryRegion::AllocateExecutable |
             (queue_full_workaround_ ? core::MemoryRegion::AllocateDoubleMap : 0));
 
     assert(ring_buf_ != NULL && "AQL queue memory allocation failure");
@@ -627,22 +801,34 @@ void AqlQueue::AllocRegisteredRingBuffer(uint32_t queue_size_pkts) {
   }
 }
 
-void AqlQueue::FreeRegisteredRingBuffer() {
-  if ((agent_->profile() == HSA_PROFILE_FULL) && queue_full_workaround_) {
+void AqlQueue::FreeRegisteredRingBuffer(bool recycle) {
+  if (ring_buf_in_vram_) {
+    core::Runtime::runtime_singleton_->FreeMemory(ring_buf_);
+    ring_buf_in_vram_ = false;
+  } else if (!recycle || device_ring_ ||
+      !agent_->CacheRingBuffer(amd_queue_.hsa_queue.size, ring_buf_, ring_buf_alloc_bytes_))
+    FreeRingBuffer(*agent_, ring_buf_, ring_buf_alloc_bytes_);
+
+  ring_buf_ = NULL;
+  ring_buf_alloc_bytes_ = 0;
+}
+
+void AqlQueue::FreeRingBuffer(const GpuAgent& agent, void* ring, uint32_t alloc_bytes) {
+  const core::Isa* isa = agent.isa();
+  const bool queue_full_workaround =
+      (isa->GetMajorVersion() == 7 || isa->GetMajorVersion() == 8);
+
+  if ((agent.profile() == HSA_PROFILE_FULL) && queue_full_workaround) {
 #ifdef __linux__
-    munmap(ring_buf_, ring_buf_alloc_bytes_);
+    munmap(ring, alloc_bytes);
 #endif
 #ifdef _WIN32
-    UnmapViewOfFile(ring_buf_);
-    UnmapViewOfFile(
-        (void*)(uintptr_t(ring_buf_) + (ring_buf_alloc_bytes_ / 2)));
+    UnmapViewOfFile(ring);
+    UnmapViewOfFile((void*)(uintptr_t(ring) + (alloc_bytes / 2)));
 #endif
   } else {
-    core::Runtime::runtime_singleton_->system_deallocator()(ring_buf_);
+    core::Runtime::runtime_singleton_->system_deallocator()(ring);
   }
-
-  ring_buf_ = NULL;
-  ring_buf_alloc_bytes_ = 0;
 }
 
 void AqlQueue::CloseRingBufferFD(const char* ring_buf_shm_path, int fd) const {
@@ -741,9 +927,9 @@ bool AqlQueue::DynamicScratchHandler(hsa_signal_value_t error_code, void* arg) {
 
       HSA::hsa_signal_store_relaxed(queue->amd_queue_.queue_inactive_signal, 0);
       // Resumes queue processing.
-      atomic::Store(&queue->amd_queue_.queue_properties,
-                    queue->amd_queue_.queue_properties & (~AMD_QUEUE_PROPERTIES_USE_SCRATCH_ONCE),
-                    std::memory_order_release);
+      // Other threads set the flag on holders of large scratch.
+      atomic::And(&queue->amd_queue_.queue_properties,
+                  uint32_t(~AMD_QUEUE_PROPERTIES_USE_SCRATCH_ONCE), std::memory_order_release);
       atomic::Fence(std::memory_order_release);
       return true;
     }
@@ -763,9 +949,11 @@ bool AqlQueue::DynamicScratchHandler(hsa_signal_value_t error_code, void* arg) {
 
       uint32_t scratch_request = pkt.dispatch.private_segment_size;
 
-      scratch.size_per_thread = scratch_request;
+      // Grow to the largest request seen so kernels alternating between sizes fault once.
+      scratch.size_per_thread = Max(size_t(scratch_request), queue->scratch_high_water_);
       // Align whole waves to 1KB.
       scratch.size_per_thread = AlignUp(scratch.size_per_thread, 16);
+      queue->scratch_high_water_ = scratch.size_per_thread;
       scratch.size = scratch.size_per_thread * (queue->amd_queue_.max_cu_id + 1) *
           queue->agent_->properties().MaxSlotsScratchCU * queue->agent_->properties().WaveFrontSize;
 
@@ -773,18 +961,22 @@ bool AqlQueue::DynamicScratchHandler(hsa_signal_value_t error_code, void* arg) {
 
       if (scratch.retry) {
         queue->agent_->AddScratchNotifier(queue->amd_queue_.queue_inactive_signal,
-                                          0x8000000000000000ull);
+                                          0x8000000000000000ull, scratch.size, queue->priority_,
+                                          queue->scratch_ticket_);
         queue->dynamicScratchState |= ERROR_HANDLER_SCRATCH_RETRY;
         changeWait = true;
         waitVal = error_code;
       } else {
+        queue->scratch_ticket_ = 0;
         // Out of scratch - promote error
         if (scratch.queue_base == nullptr) {
           errorCode = HSA_STATUS_ERROR_OUT_OF_RESOURCES;
         } else {
-          // Mark large scratch allocation for single use.
-          if (scratch.large) {
-            queue->amd_queue_.queue_properties |= AMD_QUEUE_PROPERTIES_USE_SCRATCH_ONCE;
+          // Mark large scratch allocation for single use if it is needed elsewhere, otherwise it
+          // is kept until another queue runs short.
+          if (scratch.large && queue->agent_->ScratchSingleUse()) {
+            atomic::Or(&queue->amd_queue_.queue_properties,
+                       uint32_t(AMD_QUEUE_PROPERTIES_USE_SCRATCH_ONCE), std::memory_order_release);
             // Set system release fence to flush scratch stores with older firmware versions.
             if ((queue->agent_->isa()->GetMajorVersion() == 8) &&
                 (queue->agent_->GetMicrocodeVersion() < 729)) {
@@ -873,18 +1065,34 @@ hsa_status_t AqlQueue::SetCUMasking(const uint32_t num_cu_mask_count,
   return (HSAKMT_STATUS_SUCCESS == ret) ? HSA_STATUS_SUCCESS : HSA_STATUS_ERROR;
 }
 
-void AqlQueue::ExecutePM4(uint32_t* cmd_data, size_t cmd_size_b) {
-  // pm4_ib_buf_ is a shared resource, so mutually exclude here.
-  ScopedAcquire<KernelMutex> lock(&pm4_ib_mutex_);
-
+void AqlQueue::ExecutePM4(uint32_t* cmd_data, size_t cmd_size_b, bool wait) {
   // Obtain reference to any container queue.
   core::Queue* queue = core::Queue::Convert(public_handle());
 
+  // Claim an IB slot.  The previous user of the slot must have reserved its packet and that
+  // packet must have been consumed before the IB can be overwritten.
+  const uint64_t ticket = pm4_ib_ticket_.fetch_add(1, std::memory_order_relaxed);
+  PM4IBSlot& ib_slot = pm4_ib_slots_[ticket % kPM4IBSlots];
+  AdaptiveWait turn_wait(&pm4_ib_turn_event_);
+  while (ib_slot.turn.load(std::memory_order_acquire) != ticket) turn_wait.Pause();
+  if (ticket >= kPM4IBSlots) {
+    AdaptiveWait consume_wait;
+    while (queue->LoadReadIndexRelaxed() <= ib_slot.packet_index) consume_wait.Pause();
+  }
+  uint32_t* ib = reinterpret_cast<uint32_t*>(uintptr_t(pm4_ib_buf_) +
+                                             (ticket % kPM4IBSlots) * pm4_ib_size_b_);
+
   // Obtain a queue slot for a single AQL packet.
   uint64_t write_idx = queue->AddWriteIndexAcqRel(1);
 
+  // Hand the slot to its next user once it knows which packet to wait for.
+  ib_slot.packet_index = write_idx;
+  ib_slot.turn.store(ticket + kPM4IBSlots, std::memory_order_release);
+  pm4_ib_turn_event_.Notify();
+
+  AdaptiveWait space_wait;
   while ((write_idx - queue->LoadReadIndexRelaxed()) >= queue->amd_queue_.hsa_queue.size) {
-    os::YieldThread();
+    space_wait.Pause();
   }
 
   uint32_t slot_idx = uint32_t(write_idx % queue->amd_queue_.hsa_queue.size);
@@ -894,86 +1102,13 @@ void AqlQueue::ExecutePM4(uint32_t* cmd_data, size_t cmd_size_b) {
 
   // Copy client PM4 command into IB.
   assert(cmd_size_b < pm4_ib_size_b_ && "PM4 exceeds IB size");
-  memcpy(pm4_ib_buf_, cmd_data, cmd_size_b);
+  memcpy(ib, cmd_data, cmd_size_b);
 
-  // Construct a PM4 command to execute the IB.
-  constexpr uint32_t ib_jump_size_dw = 4;
-
-  uint32_t ib_jump_cmd[ib_jump_size_dw] = {
-      PM4_HDR(PM4_HDR_IT_OPCODE_INDIRECT_BUFFER, ib_jump_size_dw, agent_->isa()->GetMajorVersion()),
-      PM4_INDIRECT_BUFFER_DW1_IB_BASE_LO(uint32_t(uintptr_t(pm4_ib_buf_) >> 2)),
-      PM4_INDIRECT_BUFFER_DW2_IB_BASE_HI(uint32_t(uintptr_t(pm4_ib_buf_) >> 32)),
-      (PM4_INDIRECT_BUFFER_DW3_IB_SIZE(uint32_t(cmd_size_b / sizeof(uint32_t))) |
-       PM4_INDIRECT_BUFFER_DW3_IB_VALID(1))};
-
-  // To respect multi-producer semantics, first buffer commands for the queue slot.
+  // Construct the queue slot, which executes the IB.
   constexpr uint32_t slot_size_dw = uint32_t(slot_size_b / sizeof(uint32_t));
   uint32_t slot_data[slot_size_dw];
-
-  if (agent_->isa()->GetMajorVersion() <= 8) {
-    // Construct a set of PM4 to fit inside the AQL packet slot.
-    uint32_t slot_dw_idx = 0;
-
-    // Construct a no-op command to pad the queue slot.
-    constexpr uint32_t rel_mem_size_dw = 7;
-    constexpr uint32_t nop_pad_size_dw = slot_size_dw - (ib_jump_size_dw + rel_mem_size_dw);
-
-    uint32_t* nop_pad = &slot_data[slot_dw_idx];
-    slot_dw_idx += nop_pad_size_dw;
-
-    nop_pad[0] = PM4_HDR(PM4_HDR_IT_OPCODE_NOP, nop_pad_size_dw, agent_->isa()->GetMajorVersion());
-
-    for (uint32_t i = 1; i < nop_pad_size_dw; ++i) {
-      nop_pad[i] = 0;
-    }
-
-    // Copy in command to execute the IB.
-    assert(slot_dw_idx + ib_jump_size_dw <= slot_size_dw && "PM4 exceeded queue slot size");
-    uint32_t* ib_jump = &slot_data[slot_dw_idx];
-    slot_dw_idx += ib_jump_size_dw;
-
-    memcpy(ib_jump, ib_jump_cmd, sizeof(ib_jump_cmd));
-
-    // Construct a command to advance the read index and invalidate the packet
-    // header. This must be the last command since this releases the queue slot
-    // for writing.
-    assert(slot_dw_idx + rel_mem_size_dw <= slot_size_dw && "PM4 exceeded queue slot size");
-    uint32_t* rel_mem = &slot_data[slot_dw_idx];
-
-    rel_mem[0] =
-        PM4_HDR(PM4_HDR_IT_OPCODE_RELEASE_MEM, rel_mem_size_dw, agent_->isa()->GetMajorVersion());
-    rel_mem[1] = PM4_RELEASE_MEM_DW1_EVENT_INDEX(PM4_RELEASE_MEM_EVENT_INDEX_AQL);
-    rel_mem[2] = 0;
-    rel_mem[3] = 0;
-    rel_mem[4] = 0;
-    rel_mem[5] = 0;
-    rel_mem[6] = 0;
-  } else if (agent_->isa()->GetMajorVersion() == 9) {
-    // Construct an AQL packet to jump to the PM4 IB.
-    struct amd_aql_pm4_ib {
-      uint16_t header;
-      uint16_t ven_hdr;
-      uint32_t ib_jump_cmd[4];
-      uint32_t dw_cnt_remain;
-      uint32_t reserved[8];
-      hsa_signal_t completion_signal;
-    };
-
-    constexpr uint32_t AMD_AQL_FORMAT_PM4_IB = 0x1;
-
-    amd_aql_pm4_ib aql_pm4_ib{};
-    aql_pm4_ib.header = HSA_PACKET_TYPE_VENDOR_SPECIFIC << HSA_PACKET_HEADER_TYPE;
-    aql_pm4_ib.ven_hdr = AMD_AQL_FORMAT_PM4_IB;
-    aql_pm4_ib.ib_jump_cmd[0] = ib_jump_cmd[0];
-    aql_pm4_ib.ib_jump_cmd[1] = ib_jump_cmd[1];
-    aql_pm4_ib.ib_jump_cmd[2] = ib_jump_cmd[2];
-    aql_pm4_ib.ib_jump_cmd[3] = ib_jump_cmd[3];
-    aql_pm4_ib.dw_cnt_remain = 0xA;
-
-    memcpy(slot_data, &aql_pm4_ib, sizeof(aql_pm4_ib));
-  } else {
-    assert(false && "AqlQueue::ExecutePM4 not implemented");
-  }
+  assert(pm4_slot_encoder_ && "AqlQueue::ExecutePM4 not implemented");
+  pm4_slot_encoder_(slot_data, ib, uint32_t(cmd_size_b / sizeof(uint32_t)));
 
   // Copy buffered commands into the queue slot.
   // Overwrite the AQL invalid header (first dword) last.
@@ -985,11 +1120,14 @@ void AqlQueue::ExecutePM4(uint32_t* cmd_data, size_t cmd_size_b) {
   core::Signal* doorbell = core::Signal::Convert(queue->amd_queue_.hsa_queue.doorbell_signal);
   doorbell->StoreRelease(write_idx);
 
+  if (!wait) return;
+
   // Wait for the packet to be consumed.
   // Should be switched to a signal wait when aql_pm4_ib can be used on all
   // supported platforms.
+  AdaptiveWait done_wait;
   while (queue->LoadReadIndexRelaxed() <= write_idx) {
-    os::YieldThread();
+    done_wait.Pause();
   }
 }
 
@@ -47,6 +47,8 @@
 #include <string>
 
 #include "core/inc/amd_gpu_agent.h"
+#include "core/inc/amd_memory_region.h"
+#include "core/inc/default_signal.h"
 #include "core/inc/hsa_internal.h"
 #include "core/util/utils.h"
 
@@ -515,48 +517,68 @@ static int kCopyMisalignedUnroll = GetKernelSourceParam("kCopyMisalignedUnroll")
 static int kFillVecWidth = GetKernelSourceParam("kFillVecWidth");
 static int kFillUnroll = GetKernelSourceParam("kFillUnroll");
 
+// Copy waves per CU by GFXIP major version.  The copy loops are latency bound,
+// GFX9 parts with HBM need more loads in flight than older GDDR parts to reach
+// peak bandwidth.
+static int CopyWavesPerCU(uint32_t gfxip_major) {
+  switch (gfxip_major) {
+    case 7:
+    case 8:
+      return 4;
+    default:
+      return 8;
+  }
+}
+
+// Copies spread over just enough workitems for each to move kCopyBytesPerWorkitem.
+// Small copies then launch a single workgroup instead of filling the device.
+static const size_t kCopyBytesPerWorkitem = 64;
+
 BlitKernel::BlitKernel(core::Queue* queue)
     : core::Blit(),
+      agent_(NULL),
       queue_(queue),
       kernarg_async_(NULL),
       kernarg_async_mask_(0),
-      kernarg_async_counter_(0),
-      num_cus_(0) {
-  completion_signal_.handle = 0;
-}
+      kernarg_async_size_(0),
+      kernarg_fence_seq_(0),
+      kernarg_region_(NULL),
+      num_cus_(0),
+      max_copy_workitems_(0) {}
 
 BlitKernel::~BlitKernel() {}
 
 hsa_status_t BlitKernel::Initialize(const core::Agent& agent) {
   queue_bitmask_ = queue_->public_handle()->size - 1;
 
-  hsa_status_t status = HSA::hsa_signal_create(1, 0, NULL, &completion_signal_);
-  if (HSA_STATUS_SUCCESS != status) {
-    return status;
+  // Kernarg slots follow the packet index over twice the queue depth.  A slot is rewritten only
+  // once a fence queued after its last dispatch has completed, see AcquireWriteIndex.
+  // They are only written by the host, so they go to the VRAM kernarg pool when there is one.
+  agent_ = static_cast<const GpuAgent*>(&agent);
+  const uint32_t num_kernarg = queue_->public_handle()->size * 2;
+  kernarg_async_size_ = num_kernarg * AlignUp(sizeof(KernelArgs), 16);
+  kernarg_region_ = agent_->kernarg_region();
+  if (kernarg_region_ != NULL) {
+    void* args = NULL;
+    if (kernarg_region_->Allocate(kernarg_async_size_, core::MemoryRegion::AllocateNoFlags,
+                                  &args) != HSA_STATUS_SUCCESS)
+      kernarg_region_ = NULL;
+    kernarg_async_ = reinterpret_cast<KernelArgs*>(args);
+  }
+  if (kernarg_region_ == NULL) {
+    kernarg_async_ = reinterpret_cast<KernelArgs*>(
+        core::Runtime::runtime_singleton_->AllocateNearSystemMemory(
+            agent, kernarg_async_size_, core::MemoryRegion::AllocateNoFlags));
   }
+  if (kernarg_async_ == NULL) return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
 
-  kernarg_async_ = reinterpret_cast<KernelArgs*>(
-      core::Runtime::runtime_singleton_->system_allocator()(
-          queue_->public_handle()->size * AlignUp(sizeof(KernelArgs), 16), 16,
-          core::MemoryRegion::AllocateNoFlags));
+  kernarg_async_mask_ = num_kernarg - 1;
 
-  kernarg_async_mask_ = queue_->public_handle()->size - 1;
+  kernarg_fence_.reset(new core::DefaultSignal(0));
 
   // Obtain the number of compute units in the underlying agent.
-  const GpuAgent& gpuAgent = static_cast<const GpuAgent&>(agent);
-  num_cus_ = gpuAgent.properties().NumFComputeCores / 4;
-
-  // Assemble shaders to AQL code objects.
-  std::map<KernelType, const char*> kernel_names = {
-      {KernelType::CopyAligned, "CopyAligned"},
-      {KernelType::CopyMisaligned, "CopyMisaligned"},
-      {KernelType::Fill, "Fill"}};
-
-  for (auto kernel_name : kernel_names) {
-    KernelCode& kernel = kernels_[kernel_name.first];
-    gpuAgent.AssembleShader(kernel_name.second, GpuAgent::AssembleTarget::AQL, kernel.code_buf_,
-                            kernel.code_buf_size_);
-  }
+  num_cus_ = agent_->properties().NumFComputeCores / 4;
+  max_copy_workitems_ = 64 * CopyWavesPerCU(agent_->isa()->GetMajorVersion()) * num_cus_;
 
   if (agent.profiling_enabled()) {
     return EnableProfiling(true);
@@ -566,21 +588,12 @@ hsa_status_t BlitKernel::Initialize(const core::Agent& agent) {
 }
 
 hsa_status_t BlitKernel::Destroy(const core::Agent& agent) {
-  std::lock_guard<std::mutex> guard(lock_);
-
-  const GpuAgent& gpuAgent = static_cast<const GpuAgent&>(agent);
-
-  for (auto kernel_pair : kernels_) {
-    gpuAgent.ReleaseShader(kernel_pair.second.code_buf_,
-                           kernel_pair.second.code_buf_size_);
-  }
-
+  // Kernel code objects belong to the agent.
   if (kernarg_async_ != NULL) {
-    core::Runtime::runtime_singleton_->system_deallocator()(kernarg_async_);
-  }
-
-  if (completion_signal_.handle != 0) {
-    HSA::hsa_signal_destroy(completion_signal_);
+    if (kernarg_region_ != NULL)
+      kernarg_region_->Free(kernarg_async_, kernarg_async_size_);
+    else
+      core::Runtime::runtime_singleton_->system_deallocator()(kernarg_async_);
   }
 
   return HSA_STATUS_SUCCESS;
@@ -588,22 +601,19 @@ hsa_status_t BlitKernel::Destroy(const core::Agent& agent) {
 
 hsa_status_t BlitKernel::SubmitLinearCopyCommand(void* dst, const void* src,
                                                  size_t size) {
-  // Protect completion_signal_.
-  std::lock_guard<std::mutex> guard(lock_);
-
-  HSA::hsa_signal_store_relaxed(completion_signal_, 1);
+  // Each blocking call waits on its own signal so concurrent callers do not serialize.
+  core::unique_signal_ptr completion_signal(new core::DefaultSignal(1));
 
   std::vector<core::Signal*> dep_signals(0);
 
-  hsa_status_t stat = SubmitLinearCopyCommand(
-      dst, src, size, dep_signals, *core::Signal::Convert(completion_signal_));
+  hsa_status_t stat = SubmitLinearCopyCommand(dst, src, size, dep_signals, *completion_signal);
 
   if (stat != HSA_STATUS_SUCCESS) {
     return stat;
   }
 
   // Wait for the packet to finish.
-  if (HSA::hsa_signal_wait_scacquire(completion_signal_, HSA_SIGNAL_CONDITION_LT, 1, uint64_t(-1),
+  if (completion_signal->WaitAcquire(HSA_SIGNAL_CONDITION_LT, 1, uint64_t(-1),
                                      HSA_WAIT_STATE_ACTIVE) != 0) {
     // Signal wait returned unexpected value.
     return HSA_STATUS_ERROR;
@@ -615,14 +625,91 @@ hsa_status_t BlitKernel::SubmitLinearCopyCommand(void* dst, const void* src,
 hsa_status_t BlitKernel::SubmitLinearCopyCommand(
     void* dst, const void* src, size_t size,
     std::vector<core::Signal*>& dep_signals, core::Signal& out_signal) {
+  core::Signal* completion = CompletionSignal(out_signal);
+  if (completion == nullptr) return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+
+  // Only dependencies that are still outstanding need a barrier slot.
+  std::vector<core::Signal*> pending;
+  PendingDependencies(dep_signals, pending);
+
   // Reserve write index for barrier(s) + dispatch packet.
-  const uint32_t num_barrier_packet = uint32_t((dep_signals.size() + 4) / 5);
+  const uint32_t num_barrier_packet = uint32_t((pending.size() + 4) / 5);
   const uint32_t total_num_packet = num_barrier_packet + 1;
 
   uint64_t write_index = AcquireWriteIndex(total_num_packet);
   uint64_t write_index_temp = write_index;
 
   // Insert barrier packets to handle dependent signals.
+  write_index = PopulateBarriers(write_index, pending);
+
+  // Insert dispatch packet for copy kernel.
+  KernelArgs* args = ObtainAsyncKernelCopyArg(write_index);
+  const int num_workitems = CopyWorkitems(size);
+  const uint64_t code_handle = PopulateCopyArgs(args, dst, src, size, num_workitems);
+
+  hsa_signal_t signal = {(core::Signal::Convert(completion)).handle};
+  PopulateQueue(write_index, code_handle, args, num_workitems, signal);
+
+  // Submit barrier(s) and dispatch packets.
+  ReleaseWriteIndex(write_index_temp, total_num_packet);
+
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t BlitKernel::SubmitLinearCopyBatch(
+    const std::vector<hsa_amd_memory_copy_desc_t>& copies,
+    std::vector<core::Signal*>& dep_signals, core::Signal& out_signal) {
+  // Every copy gets its own dispatch.  Dispatches without a completion signal
+  // carry no barrier bit so the copies overlap across the CUs.  The last
+  // dispatch sets the barrier bit and signals, reporting the whole batch.
+  // Batches larger than half the queue are written in several reservations.
+  core::Signal* completion = CompletionSignal(out_signal);
+  if (completion == nullptr) return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+
+  std::vector<core::Signal*> pending;
+  PendingDependencies(dep_signals, pending);
+  const uint32_t num_barrier_packet = uint32_t((pending.size() + 4) / 5);
+  const uint32_t max_num_packet = Max(queue_->public_handle()->size / 2, num_barrier_packet + 1);
+  const hsa_signal_t no_signal = {0};
+  const hsa_signal_t signal = {(core::Signal::Convert(completion)).handle};
+
+  size_t next = 0;
+  while (next < copies.size()) {
+    const uint32_t num_barrier = (next == 0) ? num_barrier_packet : 0;
+    const uint32_t num_dispatch =
+        uint32_t(Min(copies.size() - next, size_t(max_num_packet - num_barrier)));
+    const uint32_t total_num_packet = num_barrier + num_dispatch;
+
+    uint64_t write_index = AcquireWriteIndex(total_num_packet);
+    uint64_t write_index_temp = write_index;
+
+    if (num_barrier != 0) write_index = PopulateBarriers(write_index, pending);
+
+    for (uint32_t i = 0; i < num_dispatch; ++i, ++next, ++write_index) {
+      const hsa_amd_memory_copy_desc_t& copy = copies[next];
+
+      const int num_workitems = CopyWorkitems(copy.size);
+
+      KernelArgs* args = ObtainAsyncKernelCopyArg(write_index);
+      const uint64_t code_handle =
+          PopulateCopyArgs(args, copy.dst, copy.src, copy.size, num_workitems);
+      PopulateQueue(write_index, code_handle, args, num_workitems,
+                    (next + 1 == copies.size()) ? signal : no_signal);
+    }
+
+    ReleaseWriteIndex(write_index_temp, total_num_packet);
+  }
+
+  return HSA_STATUS_SUCCESS;
+}
+
+core::Signal* BlitKernel::CompletionSignal(core::Signal& out_signal) {
+  if (!out_signal.timeline()) return &out_signal;
+  return core::Runtime::runtime_singleton_->CreateTimelineProxy(out_signal);
+}
+
+uint64_t BlitKernel::PopulateBarriers(uint64_t write_index,
+                                      const std::vector<core::Signal*>& dep_signals) {
   // Barrier bit keeps signal checking traffic from competing with a copy.
   const uint16_t kBarrierPacketHeader = (HSA_PACKET_TYPE_BARRIER_AND << HSA_PACKET_HEADER_TYPE) |
       (1 << HSA_PACKET_HEADER_BARRIER) |
@@ -653,20 +740,25 @@ hsa_status_t BlitKernel::SubmitLinearCopyCommand(
     }
   }
 
-  // Insert dispatch packet for copy kernel.
-  KernelArgs* args = ObtainAsyncKernelCopyArg();
-  KernelCode* kernel_code = nullptr;
-  int num_workitems = 0;
+  return write_index;
+}
+
+int BlitKernel::CopyWorkitems(size_t size) const {
+  const uint64_t workitems = AlignUp(uint64_t(size / kCopyBytesPerWorkitem) + 1, 64);
+  return int(Min(uint64_t(max_copy_workitems_), workitems));
+}
+
+uint64_t BlitKernel::PopulateCopyArgs(KernelArgs* args, void* dst, const void* src, size_t size,
+                                      int num_workitems) {
+  uint64_t code_handle = 0;
 
   bool aligned = ((uintptr_t(src) & 0x3) == (uintptr_t(dst) & 0x3));
 
   if (aligned) {
     // Use dword-based aligned kernel.
-    kernel_code = &kernels_[KernelType::CopyAligned];
+    code_handle = agent_->BlitShaderCode(GpuAgent::ShaderCopyAligned);
 
     // Compute the size of each copy phase.
-    num_workitems = 64 * 4 * num_cus_;
-
     // Phase 1 (byte copy) ends when destination is 0x100-aligned.
     uintptr_t src_start = uintptr_t(src);
     uintptr_t dst_start = uintptr_t(dst);
@@ -698,11 +790,9 @@ hsa_status_t BlitKernel::SubmitLinearCopyCommand(
     args->copy_aligned.num_workitems = num_workitems;
   } else {
     // Use byte-based misaligned kernel.
-    kernel_code = &kernels_[KernelType::CopyMisaligned];
+    code_handle = agent_->BlitShaderCode(GpuAgent::ShaderCopyMisaligned);
 
     // Compute the size of each copy phase.
-    num_workitems = 64 * 4 * num_cus_;
-
     // Phase 1 (unrolled byte copy) ends when last whole block fits.
     uintptr_t src_start = uintptr_t(src);
     uintptr_t dst_start = uintptr_t(dst);
@@ -719,73 +809,215 @@ hsa_status_t BlitKernel::SubmitLinearCopyCommand(
     args->copy_misaligned.num_workitems = num_workitems;
   }
 
-  hsa_signal_t signal = {(core::Signal::Convert(&out_signal)).handle};
-  PopulateQueue(write_index, uintptr_t(kernel_code->code_buf_), args,
-                num_workitems, signal);
-
-  // Submit barrier(s) and dispatch packets.
-  ReleaseWriteIndex(write_index_temp, total_num_packet);
-
-  return HSA_STATUS_SUCCESS;
+  return code_handle;
 }
 
 hsa_status_t BlitKernel::SubmitLinearFillCommand(void* ptr, uint32_t value,
                                                  size_t count) {
-  std::lock_guard<std::mutex> guard(lock_);
-
   // Reject misaligned base address.
   if ((uintptr_t(ptr) & 0x3) != 0) {
     return HSA_STATUS_ERROR;
   }
 
+  core::unique_signal_ptr completion_signal(new core::DefaultSignal(1));
+
+  std::vector<core::Signal*> dep_signals(0);
+  const core::FillRange range = {ptr, count * sizeof(uint32_t)};
+
+  hsa_status_t stat = SubmitLinearFillCommand(std::vector<core::FillRange>(1, range), value,
+                                              dep_signals, *completion_signal);
+
+  if (stat != HSA_STATUS_SUCCESS) {
+    return stat;
+  }
+
+  // Wait for the packet to finish.
+  if (completion_signal->WaitAcquire(HSA_SIGNAL_CONDITION_LT, 1, uint64_t(-1),
+                                     HSA_WAIT_STATE_ACTIVE) != 0) {
+    // Signal wait returned unexpected value.
+    return HSA_STATUS_ERROR;
+  }
+
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t BlitKernel::SubmitLinearFillCommand(const std::vector<core::FillRange>& ranges,
+                                                 uint32_t value,
+                                                 std::vector<core::Signal*>& dep_signals,
+                                                 core::Signal& out_signal) {
+  for (const core::FillRange& range : ranges) {
+    if (!IsMultipleOf(range.ptr, sizeof(uint32_t)) || !IsMultipleOf(range.size, sizeof(uint32_t)))
+      return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  // Same packet layout as SubmitLinearCopyBatch, only the last dispatch
+  // carries the barrier bit and the completion signal.
+  core::Signal* completion = CompletionSignal(out_signal);
+  if (completion == nullptr) return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+
+  std::vector<core::Signal*> pending;
+  PendingDependencies(dep_signals, pending);
+  const uint32_t num_barrier_packet = uint32_t((pending.size() + 4) / 5);
+  const uint32_t max_num_packet = Max(queue_->public_handle()->size / 2, num_barrier_packet + 1);
+  const hsa_signal_t no_signal = {0};
+  const hsa_signal_t signal = {(core::Signal::Convert(completion)).handle};
+
+  size_t next = 0;
+  while (next < ranges.size()) {
+    const uint32_t num_barrier = (next == 0) ? num_barrier_packet : 0;
+    const uint32_t num_dispatch =
+        uint32_t(Min(ranges.size() - next, size_t(max_num_packet - num_barrier)));
+    const uint32_t total_num_packet = num_barrier + num_dispatch;
+
+    uint64_t write_index = AcquireWriteIndex(total_num_packet);
+    uint64_t write_index_temp = write_index;
+
+    if (num_barrier != 0) write_index = PopulateBarriers(write_index, pending);
+
+    for (uint32_t i = 0; i < num_dispatch; ++i, ++next, ++write_index) {
+      KernelArgs* args = ObtainAsyncKernelCopyArg(write_index);
+      const int num_workitems = PopulateFillArgs(args, ranges[next].ptr, value, ranges[next].size);
+      PopulateQueue(write_index, agent_->BlitShaderCode(GpuAgent::ShaderFill), args,
+                    num_workitems, (next + 1 == ranges.size()) ? signal : no_signal);
+    }
+
+    ReleaseWriteIndex(write_index_temp, total_num_packet);
+  }
+
+  return HSA_STATUS_SUCCESS;
+}
+
+int BlitKernel::PopulateFillArgs(KernelArgs* args, void* ptr, uint32_t value, size_t size) {
   // Compute the size of each fill phase.
-  int num_workitems = 64 * num_cus_;
+  const int num_workitems = 64 * num_cus_;
 
   // Phase 1 (unrolled dwordx4 copy) ends when last whole block fits.
   uintptr_t dst_start = uintptr_t(ptr);
-  uint64_t fill_size = count * sizeof(uint32_t);
-
   uint64_t phase1_block =
       num_workitems * sizeof(uint32_t) * kFillUnroll * kFillVecWidth;
-  uint64_t phase1_size = (fill_size / phase1_block) * phase1_block;
+  uint64_t phase1_size = (size / phase1_block) * phase1_block;
 
-  KernelArgs* args = ObtainAsyncKernelCopyArg();
   args->fill.phase1_dst_start = dst_start;
   args->fill.phase2_dst_start = dst_start + phase1_size;
-  args->fill.phase2_dst_end = dst_start + fill_size;
+  args->fill.phase2_dst_end = dst_start + size;
   args->fill.fill_value = value;
   args->fill.num_workitems = num_workitems;
 
-  // Submit dispatch packet.
-  HSA::hsa_signal_store_relaxed(completion_signal_, 1);
+  return num_workitems;
+}
 
-  uint64_t write_index = AcquireWriteIndex(1);
-  PopulateQueue(write_index, uintptr_t(kernels_[KernelType::Fill].code_buf_),
-                args, num_workitems, completion_signal_);
-  ReleaseWriteIndex(write_index, 1);
+hsa_status_t BlitKernel::EnableProfiling(bool enable) {
+  queue_->SetProfiling(enable);
+  return HSA_STATUS_SUCCESS;
+}
 
-  // Wait for the packet to finish.
-  if (HSA::hsa_signal_wait_scacquire(completion_signal_, HSA_SIGNAL_CONDITION_LT, 1, uint64_t(-1),
-                                     HSA_WAIT_STATE_ACTIVE) != 0) {
-    // Signal wait returned unexpected value.
-    return HSA_STATUS_ERROR;
-  }
+hsa_status_t BlitKernel::SubmitBarrier(std::vector<core::Signal*>& dep_signals,
+                                       core::Signal& out_signal) {
+  core::Signal* completion = CompletionSignal(out_signal);
+  if (completion == nullptr) return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+
+  std::vector<core::Signal*> pending;
+  PendingDependencies(dep_signals, pending);
+
+  // Dependency barriers, then one signalling barrier whose barrier bit orders it after every
+  // packet before it.
+  const uint32_t num_barrier_packet = uint32_t((pending.size() + 4) / 5);
+  const uint32_t total_num_packet = num_barrier_packet + 1;
+
+  uint64_t write_index = AcquireWriteIndex(total_num_packet);
+  const uint64_t write_index_temp = write_index;
+
+  write_index = PopulateBarriers(write_index, pending);
+
+  hsa_barrier_and_packet_t* queue_buffer =
+      reinterpret_cast<hsa_barrier_and_packet_t*>(queue_->public_handle()->base_address);
+  hsa_barrier_and_packet_t barrier_packet = {0};
+  barrier_packet.header = HSA_PACKET_TYPE_INVALID;
+  barrier_packet.completion_signal = core::Signal::Convert(completion);
+  queue_buffer[write_index & queue_bitmask_] = barrier_packet;
+  std::atomic_thread_fence(std::memory_order_release);
+  queue_buffer[write_index & queue_bitmask_].header =
+      (HSA_PACKET_TYPE_BARRIER_AND << HSA_PACKET_HEADER_TYPE) | (1 << HSA_PACKET_HEADER_BARRIER) |
+      (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_SCACQUIRE_FENCE_SCOPE) |
+      (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_SCRELEASE_FENCE_SCOPE);
+
+  ReleaseWriteIndex(write_index_temp, total_num_packet);
 
   return HSA_STATUS_SUCCESS;
 }
 
-hsa_status_t BlitKernel::EnableProfiling(bool enable) {
-  queue_->SetProfiling(enable);
-  return HSA_STATUS_SUCCESS;
+uint64_t BlitKernel::Backlog() {
+  // The queue may be shared with other blits, the backlog is that of the queue.
+  return queue_->LoadWriteIndexRelaxed() - queue_->LoadReadIndexRelaxed();
+}
+
+void BlitKernel::RingUsage(uint64_t& used, uint64_t& size) {
+  used = Backlog() * sizeof(core::AqlPacket);
+  size = queue_->public_handle()->size * sizeof(core::AqlPacket);
 }
 
 uint64_t BlitKernel::AcquireWriteIndex(uint32_t num_packet) {
-  assert(queue_->public_handle()->size >= num_packet);
+  const uint64_t queue_size = queue_->public_handle()->size;
+  const uint64_t num_kernarg = uint64_t(kernarg_async_mask_) + 1;
+
+  ScopedAcquire<KernelMutex> lock(&kernarg_lock_);
+
+  // Prepend a fence once the newest one is more than a quarter queue behind the reservation.
+  // The queue may be shared, so the index is claimed with a CAS to place the fence exactly.
+  uint64_t write_index = queue_->LoadWriteIndexRelaxed();
+  uint32_t num_fence;
+  while (true) {
+    num_fence = (kernarg_fences_.empty() ||
+                 write_index + num_packet - kernarg_fences_.back().first > queue_size / 4)
+        ? 1
+        : 0;
+    assert(queue_size >= num_packet + num_fence);
+    const uint64_t prev =
+        queue_->CasWriteIndexAcqRel(write_index, write_index + num_fence + num_packet);
+    if (prev == write_index) break;
+    write_index = prev;
+  }
 
-  uint64_t write_index = queue_->AddWriteIndexAcqRel(num_packet);
+  AdaptiveWait wait;
+  while (write_index + num_fence + num_packet - queue_->LoadReadIndexRelaxed() > queue_size) {
+    wait.Pause();
+  }
 
-  while (write_index + num_packet - queue_->LoadReadIndexRelaxed() > queue_->public_handle()->size) {
-    os::YieldThread();
+  if (num_fence != 0) {
+    // Barrier bit: the fence signals only after every packet ahead of it has completed.
+    const uint16_t kFencePacketHeader = (HSA_PACKET_TYPE_BARRIER_AND << HSA_PACKET_HEADER_TYPE) |
+        (1 << HSA_PACKET_HEADER_BARRIER) |
+        (HSA_FENCE_SCOPE_NONE << HSA_PACKET_HEADER_SCACQUIRE_FENCE_SCOPE) |
+        (HSA_FENCE_SCOPE_AGENT << HSA_PACKET_HEADER_SCRELEASE_FENCE_SCOPE);
+
+    hsa_barrier_and_packet_t fence = {0};
+    fence.header = HSA_PACKET_TYPE_INVALID;
+    fence.completion_signal = core::Signal::Convert(kernarg_fence_.get());
+
+    hsa_barrier_and_packet_t* queue_buffer =
+        reinterpret_cast<hsa_barrier_and_packet_t*>(queue_->public_handle()->base_address);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    queue_buffer[write_index & queue_bitmask_] = fence;
+    std::atomic_thread_fence(std::memory_order_release);
+    queue_buffer[write_index & queue_bitmask_].header = kFencePacketHeader;
+
+    kernarg_fences_.push_back(std::make_pair(write_index, kernarg_fence_seq_++));
+    ++write_index;
+  }
+
+  // The slots of this reservation were last read by dispatches a kernarg ring earlier.  The
+  // oldest fence queued after them covers those dispatches; fences complete in order and each
+  // decrements the signal from zero, so fence n is done once the value drops below -n.
+  const uint64_t last = write_index + num_packet - 1;
+  if (last >= num_kernarg) {
+    while (kernarg_fences_.front().first <= last - num_kernarg) kernarg_fences_.pop_front();
+    const std::pair<uint64_t, uint64_t>& guard = kernarg_fences_.front();
+
+    // Only the fence just written can be unsubmitted, when other producers filled the gap.
+    if ((num_fence != 0) && (guard.first + 1 == write_index)) ReleaseWriteIndex(guard.first, 1);
+
+    kernarg_fence_->WaitAcquire(HSA_SIGNAL_CONDITION_LT, -hsa_signal_value_t(guard.second),
+                                uint64_t(-1), HSA_WAIT_STATE_ACTIVE);
   }
 
   return write_index;
@@ -805,7 +1037,8 @@ void BlitKernel::PopulateQueue(uint64_t index, uint64_t code_handle, void* args,
 
   hsa_kernel_dispatch_packet_t packet = {0};
 
-  static const uint16_t kDispatchPacketHeader =
+  // Only signaling dispatches wait for the packets ahead of them.
+  const uint16_t kDispatchPacketHeader =
       (HSA_PACKET_TYPE_KERNEL_DISPATCH << HSA_PACKET_HEADER_TYPE) |
       (((completion_signal.handle != 0) ? 1 : 0) << HSA_PACKET_HEADER_BARRIER) |
       (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_SCACQUIRE_FENCE_SCOPE) |
@@ -835,11 +1068,8 @@ void BlitKernel::PopulateQueue(uint64_t index, uint64_t code_handle, void* args,
   queue_buffer[index & queue_bitmask_].header = kDispatchPacketHeader;
 }
 
-BlitKernel::KernelArgs* BlitKernel::ObtainAsyncKernelCopyArg() {
-  const uint32_t index =
-      atomic::Add(&kernarg_async_counter_, 1U, std::memory_order_acquire) & kernarg_async_mask_;
-
-  KernelArgs* arg = &kernarg_async_[index];
+BlitKernel::KernelArgs* BlitKernel::ObtainAsyncKernelCopyArg(uint64_t packet_index) {
+  KernelArgs* arg = &kernarg_async_[packet_index & kernarg_async_mask_];
   assert(IsMultipleOf(arg, 16));
   return arg;
 }
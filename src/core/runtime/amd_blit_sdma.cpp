@@ -54,6 +54,7 @@
 #include "core/inc/sdma_registers.h"
 #include "core/inc/signal.h"
 #include "core/inc/interrupt_signal.h"
+#include "core/util/stream_copy.h"
 
 namespace amd {
 
@@ -69,7 +70,16 @@ inline uint32_t ptrhigh32(const void* p) {
 #endif
 }
 
-const size_t BlitSdmaBase::kQueueSize = 1024 * 1024;
+size_t BlitSdmaBase::QueueSize() {
+  // Keep rings between 64KB and 16MB.
+  const size_t size = Min(Max(core::Runtime::runtime_singleton_->flag().sdma_queue_size(),
+                              size_t(64 * 1024)),
+                          size_t(16 * 1024 * 1024));
+  size_t ret = 64 * 1024;
+  while (ret < size) ret *= 2;
+  return ret;
+}
+
 const size_t BlitSdmaBase::kCopyPacketSize = sizeof(SDMA_PKT_COPY_LINEAR);
 const size_t BlitSdmaBase::kMaxSingleCopySize = SDMA_PKT_COPY_LINEAR::kMaxSize_;
 const size_t BlitSdmaBase::kMaxSingleFillSize = SDMA_PKT_CONSTANT_FILL::kMaxSize_;
@@ -103,9 +113,12 @@ template <typename RingIndexTy, bool HwIndexMonotonic, int SizeToCountOffset>
 BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::BlitSdma(bool copy_direction)
     : agent_(NULL),
       queue_start_addr_(NULL),
-      parity_(false),
+      queue_size_(0),
+      end_ts_slots_(NULL),
       cached_reserve_index_(0),
       cached_commit_index_(0),
+      progress_signal_(NULL),
+      progress_seq_(0),
       sdma_h2d_(copy_direction),
       platform_atomic_support_(true),
       hdp_flush_support_(false) {
@@ -138,7 +151,8 @@ hsa_status_t BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::Initial
     platform_atomic_support_ = false;
   } else {
     const core::Runtime::LinkInfo& link = core::Runtime::runtime_singleton_->GetLinkInfo(
-        agent_->node_id(), core::Runtime::runtime_singleton_->cpu_agents()[0]->node_id());
+        agent_->node_id(),
+        core::Runtime::runtime_singleton_->GetNearestCpuAgent(*agent_)->node_id());
     platform_atomic_support_ = link.info.atomic_support_64bit;
   }
 
@@ -148,14 +162,16 @@ hsa_status_t BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::Initial
   }
 
   // Allocate queue buffer.
-  queue_start_addr_ = (char*)core::Runtime::runtime_singleton_->system_allocator()(
-      kQueueSize, 0x1000, core::MemoryRegion::AllocateExecutable);
+  queue_size_ = QueueSize();
+  queue_start_addr_ = (char*)core::Runtime::runtime_singleton_->AllocateNearSystemMemory(
+      *agent_, queue_size_, core::MemoryRegion::AllocateExecutable);
 
   if (queue_start_addr_ == NULL) {
     return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
   }
   MAKE_NAMED_SCOPE_GUARD(cleanupOnException, [&]() { Destroy(agent); };);
-  std::memset(queue_start_addr_, 0, kQueueSize);
+  // The ring is only read by the engine, don't pull it through the caches.
+  stream::HostFill(queue_start_addr_, 0, queue_size_ / sizeof(uint32_t));
 
   // Access kernel driver to initialize the queue control block
   // This call binds user mode queue object to underlying compute
@@ -163,15 +179,14 @@ hsa_status_t BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::Initial
   const HSA_QUEUE_TYPE kQueueType_ = HSA_QUEUE_SDMA;
   if (HSAKMT_STATUS_SUCCESS != hsaKmtCreateQueue(agent_->node_id(), kQueueType_, 100,
                                                  HSA_QUEUE_PRIORITY_MAXIMUM, queue_start_addr_,
-                                                 kQueueSize, NULL, &queue_resource_)) {
+                                                 queue_size_, NULL, &queue_resource_)) {
     return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
   }
 
   cached_reserve_index_ = *reinterpret_cast<RingIndexTy*>(queue_resource_.Queue_write_ptr);
   cached_commit_index_ = cached_reserve_index_;
 
-  signals_[0].reset(new core::InterruptSignal(0));
-  signals_[1].reset(new core::InterruptSignal(0));
+  if (core::g_use_interrupt_wait) progress_signal_ = new core::InterruptSignal(0);
 
   cleanupOnException.Dismiss();
   return HSA_STATUS_SUCCESS;
@@ -189,17 +204,27 @@ hsa_status_t BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::Destroy
     memset(&queue_resource_, 0, sizeof(queue_resource_));
   }
 
+  // The engine no longer writes the progress signal once its queue is gone.
+  if (progress_signal_ != NULL) {
+    progress_signal_->DestroySignal();
+    progress_signal_ = NULL;
+  }
+
   if (queue_start_addr_ != NULL) {
     // Release queue buffer.
     core::Runtime::runtime_singleton_->system_deallocator()(queue_start_addr_);
   }
 
+  uint64_t* end_ts_slots = end_ts_slots_.exchange(NULL);
+  if (end_ts_slots != NULL) {
+    core::Runtime::runtime_singleton_->FreeMemory(end_ts_slots);
+  }
+
   queue_start_addr_ = NULL;
   cached_reserve_index_ = 0;
   cached_commit_index_ = 0;
+  finished_.clear();
 
-  signals_[0].reset();
-  signals_[1].reset();
 
   return HSA_STATUS_SUCCESS;
 }
@@ -207,28 +232,14 @@ hsa_status_t BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::Destroy
 template <typename RingIndexTy, bool HwIndexMonotonic, int SizeToCountOffset>
 hsa_status_t BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::SubmitBlockingCommand(
     const void* cmd, size_t cmd_size) {
-  ScopedAcquire<KernelMutex> lock(&lock_);
-
-  // Alternate between completion signals
-  // Using two allows overlapping command writing and copies
-  core::Signal* completionSignal;
-  if (parity_)
-    completionSignal = signals_[0].get();
-  else
-    completionSignal = signals_[1].get();
-  parity_ ^= true;
-
-  // Wait for prior operation with this signal to complete
-  completionSignal->WaitRelaxed(HSA_SIGNAL_CONDITION_EQ, 0, -1, HSA_WAIT_STATE_BLOCKED);
-
-  // Mark signal as in use, guard against exception leaving the signal in an unusable state.
-  completionSignal->StoreRelaxed(2);
-  MAKE_SCOPE_GUARD([&]() { completionSignal->StoreRelaxed(0); });
-  lock.Release();
+  // Each call waits on its own signal, so blocking commands from several threads share the ring.
+  // Signal objects and their events are pooled.
+  core::unique_signal_ptr completionSignal(new core::InterruptSignal(1));
 
   // Submit command and wait for completion
   hsa_status_t ret = SubmitCommand(cmd, cmd_size, std::vector<core::Signal*>(), *completionSignal);
-  completionSignal->WaitRelaxed(HSA_SIGNAL_CONDITION_EQ, 1, -1, HSA_WAIT_STATE_BLOCKED);
+  if (ret != HSA_STATUS_SUCCESS) return ret;
+  completionSignal->WaitRelaxed(HSA_SIGNAL_CONDITION_EQ, 0, -1, HSA_WAIT_STATE_BLOCKED);
   return ret;
 }
 
@@ -236,10 +247,29 @@ template <typename RingIndexTy, bool HwIndexMonotonic, int SizeToCountOffset>
 hsa_status_t BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::SubmitCommand(
     const void* cmd, size_t cmd_size, const std::vector<core::Signal*>& dep_signals,
     core::Signal& out_signal) {
-  // The signal is 64 bit value, and poll checks for 32 bit value. So we
-  // need to use two poll operations per dependent signal.
-  const uint32_t num_poll_command =
-      static_cast<uint32_t>(2 * dep_signals.size());
+  return SubmitCommand(cmd, cmd_size, dep_signals, &out_signal, &out_signal);
+}
+
+template <typename RingIndexTy, bool HwIndexMonotonic, int SizeToCountOffset>
+hsa_status_t BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::SubmitCommand(
+    const void* cmd, size_t cmd_size, const std::vector<core::Signal*>& dep_signals,
+    core::Signal* start_signal, core::Signal* end_signal) {
+  // Only dependencies that are still outstanding are polled.
+  std::vector<core::Signal*> pending;
+  PendingDependencies(dep_signals, pending);
+
+  // The signal is 64 bit value, and poll checks for 32 bit value. A signal
+  // that is waited on only moves towards zero, so the upper half needs a poll
+  // only if it is non-zero now.
+  std::vector<uint32_t*> poll_addrs;
+  poll_addrs.reserve(2 * pending.size());
+  for (core::Signal* dep : pending) {
+    uint32_t* signal_addr = reinterpret_cast<uint32_t*>(dep->ValueLocation());
+    const hsa_signal_value_t value = dep->LoadRelaxed();
+    if ((value < 0) || (uint64_t(value) > UINT32_MAX)) poll_addrs.push_back(&signal_addr[1]);
+    poll_addrs.push_back(&signal_addr[0]);
+  }
+  const uint32_t num_poll_command = static_cast<uint32_t>(poll_addrs.size());
   const uint32_t total_poll_command_size =
       (num_poll_command * poll_command_size_);
 
@@ -247,22 +277,38 @@ hsa_status_t BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::SubmitC
   // profiling in the middle of the call.
   const bool profiling_enabled = agent_->profiling_enabled();
 
-  uint64_t* end_ts_addr = NULL;
+  uint64_t* end_ts_slots = end_ts_slots_.load(std::memory_order_acquire);
   uint32_t total_timestamp_command_size = 0;
 
-  if (profiling_enabled) {
+  if (profiling_enabled && (start_signal != NULL)) {
+    total_timestamp_command_size += timestamp_command_size_;
+  }
+
+  if (profiling_enabled && (end_signal != NULL)) {
     // SDMA timestamp packet requires 32 byte of aligned memory, but
     // amd_signal_t::end_ts is not 32 byte aligned. So an extra copy packet to
     // read from a 32 byte aligned bounce buffer is required to avoid changing
-    // the amd_signal_t ABI.
-
-    end_ts_addr = agent_->ObtainEndTsObject();
-    if (end_ts_addr == NULL) {
-      return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+    // the amd_signal_t ABI.  The bounce slot is owned by the ring position of
+    // this submission.  Engines created after profiling was enabled get their
+    // slots here.
+    if (end_ts_slots == NULL) {
+      if (EnableProfiling(true) != HSA_STATUS_SUCCESS) {
+        return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+      }
+      end_ts_slots = end_ts_slots_.load(std::memory_order_acquire);
     }
 
-    total_timestamp_command_size =
-        (2 * timestamp_command_size_) + linear_copy_command_size_;
+    total_timestamp_command_size += timestamp_command_size_ + linear_copy_command_size_;
+  }
+
+  // A timeline signal is advanced by one.  Without platform atomics the value
+  // can only be stored, which races with other submissions, so the packets
+  // complete a proxy and the host advances the timeline.
+  core::Signal* timeline_proxy = NULL;
+  if ((end_signal != NULL) && end_signal->timeline() && !platform_atomic_support_) {
+    timeline_proxy = core::Runtime::runtime_singleton_->CreateTimelineProxy(*end_signal);
+    if (timeline_proxy == NULL) return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+    end_signal = timeline_proxy;
   }
 
   // On agent that does not support platform atomic, we replace it with
@@ -270,17 +316,18 @@ hsa_status_t BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::SubmitC
   // is used and not write packet is because the SDMA engine may overlap a
   // serial copy/write packets.
   const uint64_t completion_signal_value =
-      static_cast<uint64_t>(out_signal.LoadRelaxed() - 1);
-  const size_t sync_command_size = (platform_atomic_support_)
-                                       ? atomic_command_size_
-                                       : (completion_signal_value > UINT32_MAX)
-                                             ? 2 * fence_command_size_
-                                             : fence_command_size_;
+      (end_signal != NULL) ? static_cast<uint64_t>(end_signal->LoadRelaxed() - 1) : 0;
+  const size_t sync_command_size = (end_signal == NULL)
+      ? 0
+      : (platform_atomic_support_) ? atomic_command_size_
+                                   : (completion_signal_value > UINT32_MAX)
+                                         ? 2 * fence_command_size_
+                                         : fence_command_size_;
 
   // If the signal is an interrupt signal, we also need to make SDMA engine to
   // send interrupt packet to IH.
   const size_t interrupt_command_size =
-      (out_signal.signal_.event_mailbox_ptr != 0)
+      ((end_signal != NULL) && (end_signal->signal_.event_mailbox_ptr != 0))
           ? (fence_command_size_ + trap_command_size_)
           : 0;
 
@@ -292,30 +339,38 @@ hsa_status_t BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::SubmitC
     }
   }
 
+  // Leave a wake point for threads that may soon wait for ring space.
+  uint32_t wake_command_size = 0;
+  if (progress_signal_ != NULL) {
+    const RingIndexTy hw_read_index =
+        atomic::Load(reinterpret_cast<RingIndexTy*>(queue_resource_.Queue_read_ptr),
+                     std::memory_order_relaxed);
+    const RingIndexTy reserve_index =
+        atomic::Load(&cached_reserve_index_, std::memory_order_relaxed);
+    if (WrapIntoRing(reserve_index - hw_read_index) > queue_size_ / 2)
+      wake_command_size = 2 * fence_command_size_ + trap_command_size_;
+  }
+
   const uint32_t total_command_size = total_poll_command_size + cmd_size + sync_command_size +
-      total_timestamp_command_size + interrupt_command_size + flush_cmd_size;
+      total_timestamp_command_size + interrupt_command_size + flush_cmd_size + wake_command_size;
 
   RingIndexTy curr_index;
   char* command_addr = AcquireWriteAddress(total_command_size, curr_index);
 
   if (command_addr == NULL) {
+    if (timeline_proxy != NULL) timeline_proxy->StoreRelease(-1);
     return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
   }
 
-  for (size_t i = 0; i < dep_signals.size(); ++i) {
-    uint32_t* signal_addr =
-        reinterpret_cast<uint32_t*>(dep_signals[i]->ValueLocation());
-    // Wait for the higher 64 bit to 0.
-    BuildPollCommand(command_addr, &signal_addr[1], 0);
-    command_addr += poll_command_size_;
-    // Then wait for the lower 64 bit to 0.
-    BuildPollCommand(command_addr, &signal_addr[0], 0);
+  // Wait for the higher 32 bit (when needed) and then the lower 32 bit to 0.
+  for (uint32_t* poll_addr : poll_addrs) {
+    BuildPollCommand(command_addr, poll_addr, 0);
     command_addr += poll_command_size_;
   }
 
-  if (profiling_enabled) {
+  if (profiling_enabled && (start_signal != NULL)) {
     BuildGetGlobalTimestampCommand(
-        command_addr, reinterpret_cast<void*>(&out_signal.signal_.start_ts));
+        command_addr, reinterpret_cast<void*>(&start_signal->signal_.start_ts));
     command_addr += timestamp_command_size_;
   }
 
@@ -339,7 +394,34 @@ hsa_status_t BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::SubmitC
     }
   }
 
+  if (wake_command_size != 0) {
+    BuildFenceCommand(command_addr,
+                      reinterpret_cast<uint32_t*>(progress_signal_->ValueLocation()),
+                      progress_seq_.fetch_add(1, std::memory_order_relaxed) + 1);
+    command_addr += fence_command_size_;
+
+    BuildFenceCommand(command_addr,
+                      reinterpret_cast<uint32_t*>(progress_signal_->signal_.event_mailbox_ptr),
+                      static_cast<uint32_t>(progress_signal_->signal_.event_id));
+    command_addr += fence_command_size_;
+
+    BuildTrapCommand(command_addr);
+    command_addr += trap_command_size_;
+  }
+
+  // Without an end signal the submission only carries commands; completion is
+  // reported by a later submission on this ring.
+  if (end_signal == NULL) {
+    ReleaseWriteAddress(curr_index, total_command_size);
+    return HSA_STATUS_SUCCESS;
+  }
+
+  core::Signal& out_signal = *end_signal;
+
   if (profiling_enabled) {
+    const size_t kNumU64 = GpuAgent::kTsSize / sizeof(uint64_t);
+    uint64_t* end_ts_addr =
+        &end_ts_slots[(WrapIntoRing(curr_index) / linear_copy_command_size_) * kNumU64];
     assert(IsMultipleOf(end_ts_addr, 32));
     BuildGetGlobalTimestampCommand(command_addr,
                                    reinterpret_cast<void*>(end_ts_addr));
@@ -351,9 +433,11 @@ hsa_status_t BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::SubmitC
     command_addr += linear_copy_command_size_;
   }
 
-  // After transfer is completed, decrement the signal value.
+  // After transfer is completed, decrement the signal value, or advance it for
+  // a timeline.
   if (platform_atomic_support_) {
-    BuildAtomicDecrementCommand(command_addr, out_signal.ValueLocation());
+    BuildAtomicAddCommand(command_addr, out_signal.ValueLocation(),
+                          out_signal.timeline() ? 1 : -1);
     command_addr += atomic_command_size_;
 
   } else {
@@ -402,6 +486,25 @@ template <typename RingIndexTy, bool HwIndexMonotonic, int SizeToCountOffset>
 hsa_status_t BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::SubmitLinearCopyCommand(
     void* dst, const void* src, size_t size, std::vector<core::Signal*>& dep_signals,
     core::Signal& out_signal) {
+  // Small host to device updates carry their data in the ring.  Host memory is read now, so
+  // only when every dependency is already met.  That also drops their poll packets.
+  if (sdma_h2d_ && (size != 0) && (size <= kMaxInlineCopySize) &&
+      IsMultipleOf(size, sizeof(uint32_t)) && IsMultipleOf(dst, sizeof(uint32_t))) {
+    bool ready = true;
+    for (core::Signal* dep : dep_signals) {
+      if (dep->LoadAcquire() != 0) {
+        ready = false;
+        break;
+      }
+    }
+    if (ready) {
+      uint32_t buff[(sizeof(SDMA_PKT_WRITE_UNTILED) + kMaxInlineCopySize) / sizeof(uint32_t)];
+      BuildWriteCommand(reinterpret_cast<char*>(buff), dst, src, size);
+      const std::vector<core::Signal*> no_deps;
+      return SubmitCommand(buff, sizeof(SDMA_PKT_WRITE_UNTILED) + size, no_deps, out_signal);
+    }
+  }
+
   // Break the copy into multiple copy operations when the copy size exceeds
   // the SDMA linear copy limit.
   const uint32_t num_copy_command = (size + kMaxSingleCopySize - 1) / kMaxSingleCopySize;
@@ -414,6 +517,45 @@ hsa_status_t BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::SubmitL
                        out_signal);
 }
 
+template <typename RingIndexTy, bool HwIndexMonotonic, int SizeToCountOffset>
+hsa_status_t BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::SubmitLinearCopyBatch(
+    const std::vector<hsa_amd_memory_copy_desc_t>& copies, std::vector<core::Signal*>& dep_signals,
+    core::Signal& out_signal) {
+  // Assemble the copy packets of every range back to back.
+  std::vector<SDMA_PKT_COPY_LINEAR> buff;
+  for (const hsa_amd_memory_copy_desc_t& copy : copies) {
+    const uint32_t num_copy_command =
+        (copy.size + kMaxSingleCopySize - 1) / kMaxSingleCopySize;
+    const size_t first = buff.size();
+    buff.resize(first + num_copy_command);
+    BuildCopyCommand(reinterpret_cast<char*>(&buff[first]), num_copy_command, copy.dst, copy.src,
+                     copy.size);
+  }
+
+  // Small batches go out as one submission.  Larger ones are cut so a single
+  // reservation never claims more than a quarter of the ring.  The ring
+  // executes in order so only the first part needs to wait on the
+  // dependencies and only the last part needs to signal.
+  const size_t max_packets = (queue_size_ / 4) / sizeof(SDMA_PKT_COPY_LINEAR);
+  if (buff.size() <= max_packets)
+    return SubmitCommand(&buff[0], buff.size() * sizeof(SDMA_PKT_COPY_LINEAR), dep_signals,
+                         out_signal);
+
+  const std::vector<core::Signal*> no_deps;
+  for (size_t first = 0; first < buff.size(); first += max_packets) {
+    const size_t count = Min(max_packets, buff.size() - first);
+    const bool head = (first == 0);
+    const bool tail = (first + count == buff.size());
+    hsa_status_t err =
+        SubmitCommand(&buff[first], count * sizeof(SDMA_PKT_COPY_LINEAR),
+                      head ? dep_signals : no_deps, head ? &out_signal : NULL,
+                      tail ? &out_signal : NULL);
+    if (err != HSA_STATUS_SUCCESS) return err;
+  }
+
+  return HSA_STATUS_SUCCESS;
+}
+
 template <typename RingIndexTy, bool HwIndexMonotonic, int SizeToCountOffset>
 hsa_status_t BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::SubmitCopyRectCommand(
     const hsa_pitched_ptr_t* dst, const hsa_dim3_t* dst_offset, const hsa_pitched_ptr_t* src,
@@ -490,20 +632,103 @@ hsa_status_t BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::SubmitL
   return SubmitBlockingCommand(&buff[0], buff.size() * sizeof(SDMA_PKT_CONSTANT_FILL));
 }
 
+template <typename RingIndexTy, bool HwIndexMonotonic, int SizeToCountOffset>
+hsa_status_t BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::SubmitLinearFillCommand(
+    const std::vector<core::FillRange>& ranges, uint32_t value,
+    std::vector<core::Signal*>& dep_signals, core::Signal& out_signal) {
+  // Assemble the fill packets of every range back to back.
+  std::vector<SDMA_PKT_CONSTANT_FILL> buff;
+  for (const core::FillRange& range : ranges) {
+    if (!IsMultipleOf(range.ptr, sizeof(uint32_t)) || !IsMultipleOf(range.size, sizeof(uint32_t)))
+      return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    const uint32_t num_fill_command =
+        (range.size + kMaxSingleFillSize - 1) / kMaxSingleFillSize;
+    const size_t first = buff.size();
+    buff.resize(first + num_fill_command);
+    BuildFillCommand(reinterpret_cast<char*>(&buff[first]), num_fill_command, range.ptr, value,
+                     range.size / sizeof(uint32_t));
+  }
+
+  // Cut large batches as in SubmitLinearCopyBatch, the ring executes in order.
+  const size_t max_packets = (queue_size_ / 4) / sizeof(SDMA_PKT_CONSTANT_FILL);
+  if (buff.size() <= max_packets)
+    return SubmitCommand(&buff[0], buff.size() * sizeof(SDMA_PKT_CONSTANT_FILL), dep_signals,
+                         out_signal);
+
+  const std::vector<core::Signal*> no_deps;
+  for (size_t first = 0; first < buff.size(); first += max_packets) {
+    const size_t count = Min(max_packets, buff.size() - first);
+    const bool head = (first == 0);
+    const bool tail = (first + count == buff.size());
+    hsa_status_t err =
+        SubmitCommand(&buff[first], count * sizeof(SDMA_PKT_CONSTANT_FILL),
+                      head ? dep_signals : no_deps, head ? &out_signal : NULL,
+                      tail ? &out_signal : NULL);
+    if (err != HSA_STATUS_SUCCESS) return err;
+  }
+
+  return HSA_STATUS_SUCCESS;
+}
+
 template <typename RingIndexTy, bool HwIndexMonotonic, int SizeToCountOffset>
 hsa_status_t BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::EnableProfiling(
     bool enable) {
+  if (!enable || (end_ts_slots_.load(std::memory_order_acquire) != NULL)) {
+    return HSA_STATUS_SUCCESS;
+  }
+
+  // One timestamp per copy packet sized piece of the ring.  A profiled submission is larger
+  // than a copy packet, so submissions in flight never share a slot, and a slot is reused
+  // only after the ring has wrapped past the copy that read it.
+  const size_t count = (queue_size_ + linear_copy_command_size_ - 1) / linear_copy_command_size_;
+  uint64_t* slots = agent_->AllocateEndTsSlots(count);
+  if (slots == NULL) {
+    return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+  }
+
+  uint64_t* expected = NULL;
+  if (!end_ts_slots_.compare_exchange_strong(expected, slots)) {
+    core::Runtime::runtime_singleton_->FreeMemory(slots);
+  }
   return HSA_STATUS_SUCCESS;
 }
 
+template <typename RingIndexTy, bool HwIndexMonotonic, int SizeToCountOffset>
+hsa_status_t BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::SubmitBarrier(
+    std::vector<core::Signal*>& dep_signals, core::Signal& out_signal) {
+  return SubmitCommand(NULL, 0, dep_signals, out_signal);
+}
+
+template <typename RingIndexTy, bool HwIndexMonotonic, int SizeToCountOffset>
+uint64_t BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::Backlog() {
+  // Commit index is always < queue_size_ away from HW read index.
+  const RingIndexTy commit_index = atomic::Load(&cached_commit_index_, std::memory_order_relaxed);
+  const RingIndexTy hw_read_index =
+      atomic::Load(reinterpret_cast<RingIndexTy*>(queue_resource_.Queue_read_ptr),
+                   std::memory_order_relaxed);
+  return WrapIntoRing(commit_index - hw_read_index) / linear_copy_command_size_;
+}
+
+template <typename RingIndexTy, bool HwIndexMonotonic, int SizeToCountOffset>
+void BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::RingUsage(uint64_t& used,
+                                                                           uint64_t& size) {
+  const RingIndexTy reserve_index = atomic::Load(&cached_reserve_index_, std::memory_order_relaxed);
+  const RingIndexTy hw_read_index =
+      atomic::Load(reinterpret_cast<RingIndexTy*>(queue_resource_.Queue_read_ptr),
+                   std::memory_order_relaxed);
+  used = WrapIntoRing(reserve_index - hw_read_index);
+  size = queue_size_;
+}
+
 template <typename RingIndexTy, bool HwIndexMonotonic, int SizeToCountOffset>
 char* BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::AcquireWriteAddress(
     uint32_t cmd_size, RingIndexTy& curr_index) {
   // Ring is full when all but one byte is written.
-  if (cmd_size >= kQueueSize) {
+  if (cmd_size >= queue_size_) {
     return NULL;
   }
 
+  AdaptiveWait wait;
   while (true) {
     curr_index = atomic::Load(&cached_reserve_index_, std::memory_order_acquire);
 
@@ -520,63 +745,87 @@ char* BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::AcquireWriteAd
 
     if (CanWriteUpto(new_index) == false) {
       // Wait for read index to move and try again.
-      os::YieldThread();
+      WaitForProgress(wait);
       continue;
     }
 
-    // Try to reserve this part of the ring.
+    // Try to reserve this part of the ring.  On failure another thread reserved curr_index and
+    // made progress, so retry straight away.
     if (atomic::Cas(&cached_reserve_index_, new_index, curr_index, std::memory_order_release) ==
         curr_index) {
       return queue_start_addr_ + WrapIntoRing(curr_index);
     }
-
-    // Another thread reserved curr_index, try again.
-    os::YieldThread();
   }
 
   return NULL;
 }
 
 template <typename RingIndexTy, bool HwIndexMonotonic, int SizeToCountOffset>
-void BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::UpdateWriteAndDoorbellRegister(
-    RingIndexTy curr_index, RingIndexTy new_index) {
-  while (true) {
-    // Make sure that the address before ::curr_index is already released.
-    // Otherwise the CP may read invalid packets.
-    if (atomic::Load(&cached_commit_index_, std::memory_order_acquire) == curr_index) {
-      if (core::Runtime::runtime_singleton_->flag().sdma_wait_idle()) {
-        // TODO: remove when sdma wpointer issue is resolved.
-        // Wait until the SDMA engine finish processing all packets before
-        // updating the wptr and doorbell.
-        while (WrapIntoRing(*reinterpret_cast<RingIndexTy*>(queue_resource_.Queue_read_ptr)) !=
-               WrapIntoRing(curr_index)) {
-          os::YieldThread();
-        }
-      }
+void BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::WaitForProgress(AdaptiveWait& wait) {
+  if (progress_signal_ == NULL) {
+    wait.Pause();
+    return;
+  }
 
-      // Update write pointer and doorbel register.
-      *reinterpret_cast<RingIndexTy*>(queue_resource_.Queue_write_ptr) =
-          (HwIndexMonotonic ? new_index : WrapIntoRing(new_index));
+  // A wake point passed between the full ring check and here is only noticed at the timeout.
+  const hsa_signal_value_t seen = progress_signal_->LoadRelaxed();
+  const uint64_t timeout =
+      core::Runtime::runtime_singleton_->sys_clock_freq() * kProgressWaitUs / 1000000;
+  progress_signal_->WaitRelaxed(HSA_SIGNAL_CONDITION_NE, seen, timeout, HSA_WAIT_STATE_BLOCKED);
+}
 
-      // Ensure write pointer is visible to GPU before doorbell.
-      std::atomic_thread_fence(std::memory_order_release);
+template <typename RingIndexTy, bool HwIndexMonotonic, int SizeToCountOffset>
+void BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::UpdateWriteAndDoorbellRegister(
+    RingIndexTy curr_index, RingIndexTy new_index) {
+  ScopedAcquire<KernelMutex> lock(&commit_lock_);
 
-      *reinterpret_cast<RingIndexTy*>(queue_resource_.Queue_DoorBell) =
-          (HwIndexMonotonic ? new_index : WrapIntoRing(new_index));
+  // Commands before ::curr_index are still being written.  Otherwise the engine may read
+  // invalid packets, so leave this reservation for the thread writing at the commit index.
+  if (atomic::Load(&cached_commit_index_, std::memory_order_relaxed) != curr_index) {
+    finished_.push_back(std::make_pair(curr_index, new_index));
+    return;
+  }
 
-      atomic::Store(&cached_commit_index_, new_index, std::memory_order_release);
-      break;
+  // Take every reservation that finished early and now follows on.
+  for (size_t i = 0; i < finished_.size();) {
+    if (finished_[i].first == new_index) {
+      new_index = finished_[i].second;
+      finished_[i] = finished_.back();
+      finished_.pop_back();
+      i = 0;
+      continue;
     }
+    i++;
+  }
 
-    // Waiting for another thread to submit preceding commands first.
-    os::YieldThread();
+  if (core::Runtime::runtime_singleton_->flag().sdma_wait_idle()) {
+    // TODO: remove when sdma wpointer issue is resolved.
+    // Wait until the SDMA engine finish processing all packets before
+    // updating the wptr and doorbell.
+    AdaptiveWait wait;
+    while (WrapIntoRing(*reinterpret_cast<RingIndexTy*>(queue_resource_.Queue_read_ptr)) !=
+           WrapIntoRing(curr_index)) {
+      wait.Pause();
+    }
   }
+
+  // Update write pointer and doorbel register.
+  *reinterpret_cast<RingIndexTy*>(queue_resource_.Queue_write_ptr) =
+      (HwIndexMonotonic ? new_index : WrapIntoRing(new_index));
+
+  // Ensure write pointer is visible to GPU before doorbell.
+  std::atomic_thread_fence(std::memory_order_release);
+
+  *reinterpret_cast<RingIndexTy*>(queue_resource_.Queue_DoorBell) =
+      (HwIndexMonotonic ? new_index : WrapIntoRing(new_index));
+
+  atomic::Store(&cached_commit_index_, new_index, std::memory_order_release);
 }
 
 template <typename RingIndexTy, bool HwIndexMonotonic, int SizeToCountOffset>
 void BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::ReleaseWriteAddress(
     RingIndexTy curr_index, uint32_t cmd_size) {
-  if (cmd_size > kQueueSize) {
+  if (cmd_size > queue_size_) {
     assert(false && "cmd_addr is outside the queue buffer range");
     return;
   }
@@ -588,7 +837,7 @@ template <typename RingIndexTy, bool HwIndexMonotonic, int SizeToCountOffset>
 void BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::PadRingToEnd(
     RingIndexTy curr_index) {
   // Reserve region from here to the end of the ring.
-  RingIndexTy new_index = curr_index + (kQueueSize - WrapIntoRing(curr_index));
+  RingIndexTy new_index = curr_index + (queue_size_ - WrapIntoRing(curr_index));
 
   // Check whether the engine has finished using this region.
   if (CanWriteUpto(new_index) == false) {
@@ -609,7 +858,7 @@ void BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::PadRingToEnd(
 template <typename RingIndexTy, bool HwIndexMonotonic, int SizeToCountOffset>
 uint32_t BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::WrapIntoRing(
     RingIndexTy index) {
-  return index & (kQueueSize - 1);
+  return index & (queue_size_ - 1);
 }
 
 template <typename RingIndexTy, bool HwIndexMonotonic, int SizeToCountOffset>
@@ -623,15 +872,15 @@ bool BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::CanWriteUpto(
     read_index = hw_read_index;
   } else {
     // Calculate distance from commit index to HW read index.
-    // Commit index is always < kQueueSize away from HW read index.
+    // Commit index is always < queue_size_ away from HW read index.
     RingIndexTy commit_index = atomic::Load(&cached_commit_index_, std::memory_order_relaxed);
     RingIndexTy dist_to_read_index = WrapIntoRing(commit_index - hw_read_index);
     read_index = commit_index - dist_to_read_index;
   }
 
   // Check whether the read pointer has passed the given index.
-  // At most we can submit (kQueueSize - 1) bytes at a time.
-  return (upto_index - read_index) < kQueueSize;
+  // At most we can submit (queue_size_ - 1) bytes at a time.
+  return (upto_index - read_index) < queue_size_;
 }
 
 template <typename RingIndexTy, bool HwIndexMonotonic, int SizeToCountOffset>
@@ -841,6 +1090,26 @@ void BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::BuildFillComman
   assert(count == 0 && "SDMA fill command count error.");
 }
 
+template <typename RingIndexTy, bool HwIndexMonotonic, int SizeToCountOffset>
+void BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::BuildWriteCommand(
+    char* cmd_addr, void* dst, const void* src, size_t size) {
+  assert(IsMultipleOf(size, sizeof(uint32_t)) && "SDMA write size must be whole dwords.");
+  SDMA_PKT_WRITE_UNTILED* packet_addr = reinterpret_cast<SDMA_PKT_WRITE_UNTILED*>(cmd_addr);
+
+  memset(packet_addr, 0, sizeof(SDMA_PKT_WRITE_UNTILED));
+
+  packet_addr->HEADER_UNION.op = SDMA_OP_WRITE;
+  packet_addr->HEADER_UNION.sub_op = SDMA_SUBOP_WRITE_LINEAR;
+
+  packet_addr->DST_ADDR_LO_UNION.dst_addr_31_0 = ptrlow32(dst);
+  packet_addr->DST_ADDR_HI_UNION.dst_addr_63_32 = ptrhigh32(dst);
+
+  // Count is in dwords, with the same base as the copy count.
+  packet_addr->DW_3_UNION.count = uint32_t(size / sizeof(uint32_t)) + SizeToCountOffset;
+
+  memcpy(packet_addr + 1, src, size);
+}
+
 template <typename RingIndexTy, bool HwIndexMonotonic, int SizeToCountOffset>
 void BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::BuildPollCommand(
     char* cmd_addr, void* addr, uint32_t reference) {
@@ -864,8 +1133,8 @@ void BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::BuildPollComman
 }
 
 template <typename RingIndexTy, bool HwIndexMonotonic, int SizeToCountOffset>
-void BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::BuildAtomicDecrementCommand(
-    char* cmd_addr, void* addr) {
+void BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::BuildAtomicAddCommand(
+    char* cmd_addr, void* addr, int64_t value) {
   SDMA_PKT_ATOMIC* packet_addr = reinterpret_cast<SDMA_PKT_ATOMIC*>(cmd_addr);
 
   memset(packet_addr, 0, sizeof(SDMA_PKT_ATOMIC));
@@ -876,8 +1145,8 @@ void BlitSdma<RingIndexTy, HwIndexMonotonic, SizeToCountOffset>::BuildAtomicDecr
   packet_addr->ADDR_LO_UNION.addr_31_0 = ptrlow32(addr);
   packet_addr->ADDR_HI_UNION.addr_63_32 = ptrhigh32(addr);
 
-  packet_addr->SRC_DATA_LO_UNION.src_data_31_0 = 0xffffffff;
-  packet_addr->SRC_DATA_HI_UNION.src_data_63_32 = 0xffffffff;
+  packet_addr->SRC_DATA_LO_UNION.src_data_31_0 = static_cast<uint32_t>(value);
+  packet_addr->SRC_DATA_HI_UNION.src_data_63_32 = static_cast<uint32_t>(uint64_t(value) >> 32);
 }
 
 template <typename RingIndexTy, bool HwIndexMonotonic, int SizeToCountOffset>
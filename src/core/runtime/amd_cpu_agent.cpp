@@ -46,13 +46,25 @@
 #include <cstring>
 
 #include "core/inc/amd_memory_region.h"
+#include "core/inc/default_signal.h"
 #include "core/inc/host_queue.h"
+#include "core/inc/interrupt_signal.h"
+#include "core/inc/runtime.h"
 
 #include "hsa_ext_image.h"
 
 namespace amd {
 CpuAgent::CpuAgent(HSAuint32 node, const HsaNodeProperties& node_props)
-    : core::Agent(node, kAmdCpuDevice), properties_(node_props) {
+    : core::Agent(node, kAmdCpuDevice), properties_(node_props), os_numa_node_(-1) {
+  // Any online CPU of the node will do.
+  for (uint32_t i = 0; i < num_cpus(); i++) {
+    uint32_t numa_node;
+    if (os::GetCpuNumaNode(first_cpu_id() + i, numa_node)) {
+      os_numa_node_ = int32_t(numa_node);
+      break;
+    }
+  }
+
   InitRegionList();
 
   InitCacheList();
@@ -213,7 +225,9 @@ hsa_status_t CpuAgent::GetInfo(hsa_agent_info_t attribute, void* value) const {
       std::memcpy(value, "CPU", sizeof("CPU"));
       break;
     case HSA_AGENT_INFO_FEATURE:
-      *((hsa_agent_feature_t*)value) = static_cast<hsa_agent_feature_t>(0);
+      *((hsa_agent_feature_t*)value) = HostQueuesEnabled()
+          ? HSA_AGENT_FEATURE_AGENT_DISPATCH
+          : static_cast<hsa_agent_feature_t>(0);
       break;
     case HSA_AGENT_INFO_MACHINE_MODEL:
 #if defined(HSA_LARGE_MODEL)
@@ -255,13 +269,13 @@ hsa_status_t CpuAgent::GetInfo(hsa_agent_info_t attribute, void* value) const {
       *((uint32_t*)value) = 0;
       break;
     case HSA_AGENT_INFO_QUEUES_MAX:
-      *((uint32_t*)value) = 0;
+      *((uint32_t*)value) = HostQueuesEnabled() ? kMaxQueues : 0;
       break;
     case HSA_AGENT_INFO_QUEUE_MIN_SIZE:
-      *((uint32_t*)value) = 0;
+      *((uint32_t*)value) = HostQueuesEnabled() ? kMinQueueSize : 0;
       break;
     case HSA_AGENT_INFO_QUEUE_MAX_SIZE:
-      *((uint32_t*)value) = 0;
+      *((uint32_t*)value) = HostQueuesEnabled() ? kMaxQueueSize : 0;
       break;
     case HSA_AGENT_INFO_QUEUE_TYPE:
       *((hsa_queue_type32_t*)value) = HSA_QUEUE_TYPE_MULTI;
@@ -356,6 +370,13 @@ hsa_status_t CpuAgent::GetInfo(hsa_agent_info_t attribute, void* value) const {
     case HSA_AMD_AGENT_INFO_HDP_FLUSH:
       *((hsa_amd_hdp_flush_t*)value) = {nullptr, nullptr};
       break;
+    case HSA_AMD_AGENT_INFO_NEAREST_HOST_POOL: {
+      const core::MemoryRegion* region =
+          core::Runtime::runtime_singleton_->GetNearestSystemRegion(*this);
+      ((hsa_amd_memory_pool_t*)value)->handle =
+          core::MemoryRegion::Convert(const_cast<core::MemoryRegion*>(region)).handle;
+      break;
+    }
     default:
       return HSA_STATUS_ERROR_INVALID_ARGUMENT;
       break;
@@ -368,8 +389,39 @@ hsa_status_t CpuAgent::QueueCreate(size_t size, hsa_queue_type32_t queue_type,
                                    void* data, uint32_t private_segment_size,
                                    uint32_t group_segment_size,
                                    core::Queue** queue) {
-  // No HW AQL packet processor on CPU device.
-  return HSA_STATUS_ERROR;
+  // No HW AQL packet processor on CPU device, packets are only executed by runtime threads.
+  if (!HostQueuesEnabled()) return HSA_STATUS_ERROR;
+
+  if ((size < kMinQueueSize) || (size > kMaxQueueSize))
+    return HSA_STATUS_ERROR_INVALID_QUEUE_CREATION;
+
+  const core::MemoryRegion* ring_region = nullptr;
+  for (const core::MemoryRegion* region : regions_) {
+    if (region->fine_grain()) {
+      ring_region = region;
+      break;
+    }
+  }
+  if (ring_region == nullptr) return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+
+  core::Signal* doorbell;
+  if (core::g_use_interrupt_wait)
+    doorbell = new core::InterruptSignal(kDoorbellIdle);
+  else
+    doorbell = new core::DefaultSignal(kDoorbellIdle);
+  MAKE_NAMED_SCOPE_GUARD(doorbellGuard, [&]() { doorbell->DestroySignal(); });
+
+  std::unique_ptr<core::HostQueue> host_queue(new core::HostQueue(
+      core::MemoryRegion::Convert(ring_region), uint32_t(size), queue_type,
+      HSA_QUEUE_FEATURE_AGENT_DISPATCH, core::Signal::Convert(doorbell), true));
+  doorbellGuard.Dismiss();
+
+  hsa_status_t err = core::Runtime::runtime_singleton_->host_queue_processor().Attach(
+      host_queue.get(), event_callback, data);
+  if (err != HSA_STATUS_SUCCESS) return err;
+
+  *queue = host_queue.release();
+  return HSA_STATUS_SUCCESS;
 }
 
 }  // namespace amd
@@ -46,7 +46,7 @@
 #include <atomic>
 #include <cstring>
 #include <climits>
-#include <map>
+#include <cstdio>
 #include <string>
 #include <vector>
 #include <memory>
@@ -58,6 +58,9 @@
 #include "core/inc/amd_gpu_pm4.h"
 #include "core/inc/amd_gpu_shaders.h"
 #include "core/inc/amd_memory_region.h"
+#include "core/inc/amd_queue_pool.h"
+#include "core/inc/amd_queue_scheduler.h"
+#include "core/inc/default_signal.h"
 #include "core/inc/interrupt_signal.h"
 #include "core/inc/isa.h"
 #include "core/inc/runtime.h"
@@ -77,25 +80,36 @@ GpuAgent::GpuAgent(HSAuint32 node, const HsaNodeProperties& node_props)
     : GpuAgentInt(node),
       properties_(node_props),
       current_coherency_type_(HSA_AMD_COHERENCY_TYPE_COHERENT),
+      scratch_used_large_(0),
+      scratch_pool_reserved_(false),
+      scratch_waiter_ticket_(0),
       blits_(),
+      blit_stats_(),
       queues_(),
+      d2d_next_(0),
       local_region_(NULL),
+      kernarg_region_(NULL),
       is_kv_device_(false),
       trap_code_buf_(NULL),
       trap_code_buf_size_(0),
+      blit_shader_code_(),
+      blit_shader_size_(),
       doorbell_queue_map_(NULL),
       memory_bus_width_(0),
       memory_max_frequency_(0),
       ape1_base_(0),
-      ape1_size_(0),
-      end_ts_pool_size_(0),
-      end_ts_pool_counter_(0),
-      end_ts_base_addr_(NULL) {
+      ape1_size_(0) {
   const bool is_apu_node = (properties_.NumCPUCores > 0);
   profile_ = (is_apu_node) ? HSA_PROFILE_FULL : HSA_PROFILE_BASE;
 
   HSAKMT_STATUS err = hsaKmtGetClockCounters(node_id(), &t0_);
   t1_ = t0_;
+  t1_seq_ = 0;
+  t1_gpu_ = t0_.GPUClockCounter;
+  t1_system_ = t0_.SystemClockCounter;
+  t1_ratio_ = 0.0;
+  t1_resync_ticks_ = 0;
+  code_cache_invalidate_pending_ = false;
   historical_clock_ratio_ = 0.0;
   assert(err == HSAKMT_STATUS_SUCCESS && "hsaGetClockCounters error");
 
@@ -113,6 +127,17 @@ GpuAgent::GpuAgent(HSAuint32 node, const HsaNodeProperties& node_props)
     is_kv_device_ = true;
   }
 
+  // Agent names are immutable, format them once rather than on every query.
+  std::memset(name_, 0, sizeof(name_));
+  snprintf(name_, sizeof(name_), "gfx%d%d%d", isa_->GetMajorVersion(), isa_->GetMinorVersion(),
+           isa_->GetStepping());
+
+  std::memset(product_name_, 0, sizeof(product_name_));
+  for (uint32_t idx = 0; properties_.MarketingName[idx] != 0 && idx < sizeof(product_name_) - 1;
+       idx++) {
+    product_name_[idx] = (uint8_t)properties_.MarketingName[idx];
+  }
+
   current_coherency_type((profile_ == HSA_PROFILE_FULL)
                              ? HSA_AMD_COHERENCY_TYPE_COHERENT
                              : HSA_AMD_COHERENCY_TYPE_NONCOHERENT);
@@ -130,6 +155,18 @@ GpuAgent::GpuAgent(HSAuint32 node, const HsaNodeProperties& node_props)
   max_queues_ = std::min(128U, max_queues_);
 #endif
 
+  const uint32_t pool_size = core::Runtime::runtime_singleton_->flag().queue_pool_size();
+  if (pool_size != 0) {
+    const QueuePool::Policy policy =
+        (core::Runtime::runtime_singleton_->flag().queue_pool_policy() == "load")
+            ? QueuePool::PolicyLeastLoaded
+            : QueuePool::PolicyRoundRobin;
+    queue_pool_.reset(new QueuePool(this, std::min(pool_size, max_queues_), policy));
+  }
+
+  queue_scheduler_.reset(
+      new QueueScheduler(properties_.NumFComputeCores / properties_.NumSIMDPerCU));
+
   // Populate region list.
   InitRegionList();
 
@@ -138,6 +175,9 @@ GpuAgent::GpuAgent(HSAuint32 node, const HsaNodeProperties& node_props)
 }
 
 GpuAgent::~GpuAgent() {
+  queue_pool_.reset();
+  queue_scheduler_.reset();
+
   for (int i = 0; i < BlitCount; ++i) {
     if (blits_[i] != nullptr) {
       hsa_status_t status = blits_[i]->Destroy(*this);
@@ -145,10 +185,30 @@ GpuAgent::~GpuAgent() {
     }
   }
 
-  if (end_ts_base_addr_ != NULL) {
-    core::Runtime::runtime_singleton_->FreeMemory(end_ts_base_addr_);
+  for (auto& direction : sdma_stripes_) {
+    for (auto& blit : direction) {
+      if (blit != nullptr) {
+        hsa_status_t status = blit->Destroy(*this);
+        assert(status == HSA_STATUS_SUCCESS);
+      }
+    }
   }
 
+  for (auto& blit : d2d_blits_) {
+    if (blit != nullptr) {
+      hsa_status_t status = blit->Destroy(*this);
+      assert(status == HSA_STATUS_SUCCESS);
+    }
+  }
+
+  // Internal queues return their rings to the cache, release them before it.
+  for (auto& queue : d2d_queues_) queue.reset();
+  for (auto& queue : queues_) queue.reset();
+
+  for (auto& cached : ring_cache_)
+    AqlQueue::FreeRingBuffer(*this, cached.ring, cached.alloc_bytes);
+  ring_cache_.clear();
+
   if (ape1_base_ != 0) {
     _aligned_free(reinterpret_cast<void*>(ape1_base_));
   }
@@ -163,79 +223,66 @@ GpuAgent::~GpuAgent() {
     ReleaseShader(trap_code_buf_, trap_code_buf_size_);
   }
 
+  for (int i = 0; i < ShaderCount; ++i) {
+    void* code = blit_shader_code_[i].load(std::memory_order_relaxed);
+    if (code != NULL) ReleaseShader(code, blit_shader_size_[i]);
+  }
+
   std::for_each(regions_.begin(), regions_.end(), DeleteObject());
   regions_.clear();
 }
 
-void GpuAgent::AssembleShader(const char* func_name, AssembleTarget assemble_target,
-                              void*& code_buf, size_t& code_buf_size) const {
-  // Select precompiled shader implementation from name/target.
-  struct ASICShader {
-    const void* code;
-    size_t size;
-    int num_sgprs;
-    int num_vgprs;
-  };
-
-  struct CompiledShader {
-    ASICShader compute_7;
-    ASICShader compute_8;
-    ASICShader compute_9;
-  };
+namespace {
+struct ASICShader {
+  const void* code;
+  size_t size;
+  int num_sgprs;
+  int num_vgprs;
+};
+
+// Precompiled shaders indexed by [GpuAgent::ShaderKind][gfx major version - 7].
+const ASICShader kCompiledShaders[GpuAgent::ShaderCount][3] = {
+    // ShaderTrapHandler
+    {
+        {NULL, 0, 0, 0},
+        {kCodeTrapHandler8, sizeof(kCodeTrapHandler8), 2, 4},
+        {kCodeTrapHandler9, sizeof(kCodeTrapHandler9), 2, 4},
+    },
+    // ShaderCopyAligned
+    {
+        {kCodeCopyAligned7, sizeof(kCodeCopyAligned7), 32, 12},
+        {kCodeCopyAligned8, sizeof(kCodeCopyAligned8), 32, 12},
+        {kCodeCopyAligned8, sizeof(kCodeCopyAligned8), 32, 12},
+    },
+    // ShaderCopyMisaligned
+    {
+        {kCodeCopyMisaligned7, sizeof(kCodeCopyMisaligned7), 23, 10},
+        {kCodeCopyMisaligned8, sizeof(kCodeCopyMisaligned8), 23, 10},
+        {kCodeCopyMisaligned8, sizeof(kCodeCopyMisaligned8), 23, 10},
+    },
+    // ShaderFill
+    {
+        {kCodeFill7, sizeof(kCodeFill7), 19, 8},
+        {kCodeFill8, sizeof(kCodeFill8), 19, 8},
+        {kCodeFill8, sizeof(kCodeFill8), 19, 8},
+    }};
+}  // namespace
 
-  std::map<std::string, CompiledShader> compiled_shaders = {
-      {"TrapHandler",
-       {
-           {NULL, 0, 0, 0},
-           {kCodeTrapHandler8, sizeof(kCodeTrapHandler8), 2, 4},
-           {kCodeTrapHandler9, sizeof(kCodeTrapHandler9), 2, 4},
-       }},
-      {"CopyAligned",
-       {
-           {kCodeCopyAligned7, sizeof(kCodeCopyAligned7), 32, 12},
-           {kCodeCopyAligned8, sizeof(kCodeCopyAligned8), 32, 12},
-           {kCodeCopyAligned8, sizeof(kCodeCopyAligned8), 32, 12},
-       }},
-      {"CopyMisaligned",
-       {
-           {kCodeCopyMisaligned7, sizeof(kCodeCopyMisaligned7), 23, 10},
-           {kCodeCopyMisaligned8, sizeof(kCodeCopyMisaligned8), 23, 10},
-           {kCodeCopyMisaligned8, sizeof(kCodeCopyMisaligned8), 23, 10},
-       }},
-      {"Fill",
-       {
-           {kCodeFill7, sizeof(kCodeFill7), 19, 8},
-           {kCodeFill8, sizeof(kCodeFill8), 19, 8},
-           {kCodeFill8, sizeof(kCodeFill8), 19, 8},
-       }}};
-
-  auto compiled_shader_it = compiled_shaders.find(func_name);
-  assert(compiled_shader_it != compiled_shaders.end() &&
-         "Precompiled shader unavailable");
-
-  ASICShader* asic_shader = NULL;
-
-  switch (isa_->GetMajorVersion()) {
-    case 7:
-      asic_shader = &compiled_shader_it->second.compute_7;
-      break;
-    case 8:
-      asic_shader = &compiled_shader_it->second.compute_8;
-      break;
-    case 9:
-      asic_shader = &compiled_shader_it->second.compute_9;
-      break;
-    default:
-      assert(false && "Precompiled shader unavailable for target");
-  }
+void GpuAgent::AssembleShader(ShaderKind shader, AssembleTarget assemble_target,
+                              void*& code_buf, size_t& code_buf_size) const {
+  // Select precompiled shader implementation from kind/target.
+  const uint32_t major = isa_->GetMajorVersion();
+  assert(major >= 7 && major <= 9 && "Precompiled shader unavailable for target");
+  const ASICShader* asic_shader = &kCompiledShaders[shader][major - 7];
+  assert(asic_shader->code != NULL && "Precompiled shader unavailable");
 
   // Allocate a GPU-visible buffer for the shader.
   size_t header_size =
       (assemble_target == AssembleTarget::AQL ? sizeof(amd_kernel_code_t) : 0);
   code_buf_size = AlignUp(header_size + asic_shader->size, 0x1000);
 
-  code_buf = core::Runtime::runtime_singleton_->system_allocator()(
-      code_buf_size, 0x1000, core::MemoryRegion::AllocateExecutable);
+  code_buf = core::Runtime::runtime_singleton_->AllocateNearSystemMemory(
+      *this, code_buf_size, core::MemoryRegion::AllocateExecutable);
   assert(code_buf != NULL && "Code buffer allocation failed");
 
   memset(code_buf, 0, code_buf_size);
@@ -272,6 +319,19 @@ void GpuAgent::AssembleShader(const char* func_name, AssembleTarget assemble_tar
          asic_shader->size);
 }
 
+uint64_t GpuAgent::BlitShaderCode(ShaderKind shader) const {
+  void* code = blit_shader_code_[shader].load(std::memory_order_acquire);
+  if (code != NULL) return uint64_t(code);
+
+  ScopedAcquire<KernelMutex> lock(&blit_shader_lock_);
+  code = blit_shader_code_[shader].load(std::memory_order_relaxed);
+  if (code == NULL) {
+    AssembleShader(shader, AssembleTarget::AQL, code, blit_shader_size_[shader]);
+    blit_shader_code_[shader].store(code, std::memory_order_release);
+  }
+  return uint64_t(code);
+}
+
 void GpuAgent::ReleaseShader(void* code_buf, size_t code_buf_size) const {
   core::Runtime::runtime_singleton_->system_deallocator()(code_buf);
 }
@@ -279,6 +339,10 @@ void GpuAgent::ReleaseShader(void* code_buf, size_t code_buf_size) const {
 void GpuAgent::InitRegionList() {
   const bool is_apu_node = (properties_.NumCPUCores > 0);
 
+  const Flag& flag = core::Runtime::runtime_singleton_->flag();
+  const bool vram_kernarg = flag.vram_kernarg() && !is_apu_node;
+  int kernarg_bank = -1;
+
   std::vector<HsaMemoryProperties> mem_props(properties_.NumMemoryBanks);
   if (HSAKMT_STATUS_SUCCESS ==
       hsaKmtGetNodeMemoryProperties(node_id(), properties_.NumMemoryBanks,
@@ -313,6 +377,8 @@ void GpuAgent::InitRegionList() {
                 (core::Runtime::runtime_singleton_->flag().fine_grain_pcie())) {
               regions_.push_back(new MemoryRegion(true, false, this, mem_props[mem_idx]));
             }
+            // A fully host visible frame buffer means a large BAR.
+            if (vram_kernarg && region->IsPublic()) kernarg_bank = int(mem_idx);
           }
           break;
         }
@@ -323,7 +389,7 @@ void GpuAgent::InitRegionList() {
           }
           break;
         case HSA_HEAPTYPE_MMIO_REMAP:
-          if (core::Runtime::runtime_singleton_->flag().fine_grain_pcie()) {
+          if (core::Runtime::runtime_singleton_->flag().fine_grain_pcie() || vram_kernarg) {
             // Remap offsets defined in kfd_ioctl.h
             HDP_flush_.HDP_MEM_FLUSH_CNTL = (uint32_t*)mem_props[mem_idx].VirtualBaseAddress;
             HDP_flush_.HDP_REG_FLUSH_CNTL = HDP_flush_.HDP_MEM_FLUSH_CNTL + 1;
@@ -334,14 +400,16 @@ void GpuAgent::InitRegionList() {
       }
     }
   }
+
+  // Kernargs written to VRAM must be flushed out of HDP before dispatch, without the flush
+  // registers the pool isn't offered.
+  if (kernarg_bank >= 0 && HDP_flush_.HDP_MEM_FLUSH_CNTL != nullptr) {
+    kernarg_region_ = new MemoryRegion(true, false, this, mem_props[kernarg_bank], true);
+    regions_.push_back(kernarg_region_);
+  }
 }
 
 void GpuAgent::InitScratchPool() {
-  HsaMemFlags flags;
-  flags.Value = 0;
-  flags.ui32.Scratch = 1;
-  flags.ui32.HostAccess = 1;
-
   scratch_per_thread_ =
       core::Runtime::runtime_singleton_->flag().scratch_mem_size();
   if (scratch_per_thread_ == 0)
@@ -352,6 +420,17 @@ void GpuAgent::InitScratchPool() {
   const uint32_t num_cu =
       properties_.NumFComputeCores / properties_.NumSIMDPerCU;
   queue_scratch_len_ = AlignUp(32 * 64 * num_cu * scratch_per_thread_, 65536);
+}
+
+void GpuAgent::ReserveScratchPool() {
+  if (scratch_pool_reserved_) return;
+  scratch_pool_reserved_ = true;
+
+  HsaMemFlags flags;
+  flags.Value = 0;
+  flags.ui32.Scratch = 1;
+  flags.ui32.HostAccess = 1;
+
   size_t max_scratch_len = queue_scratch_len_ * max_queues_;
 
 #if defined(HSA_LARGE_MODEL) && defined(__linux__)
@@ -406,56 +485,16 @@ void GpuAgent::InitCacheList() {
                                      cache_props_[i].CacheLevel, cache_props_[i].CacheSize));
 }
 
-bool GpuAgent::InitEndTsPool() {
-  if (HSA_PROFILE_FULL == profile_) {
-    return true;
-  }
-
-  if (end_ts_base_addr_.load(std::memory_order_acquire) != NULL) {
-    return true;
-  }
-
-  ScopedAcquire<KernelMutex> lock(&blit_lock_);
-
-  if (end_ts_base_addr_.load(std::memory_order_relaxed) != NULL) {
-    return true;
-  }
-
-  end_ts_pool_size_ =
-      static_cast<uint32_t>((BlitSdmaBase::kQueueSize + BlitSdmaBase::kCopyPacketSize - 1) /
-                            (BlitSdmaBase::kCopyPacketSize));
-
-  // Allocate end timestamp object for both h2d and d2h DMA.
-  const size_t alloc_size = 2 * end_ts_pool_size_ * kTsSize;
-
-  core::Runtime* runtime = core::Runtime::runtime_singleton_;
-
+uint64_t* GpuAgent::AllocateEndTsSlots(size_t count) {
   uint64_t* buff = NULL;
   if (HSA_STATUS_SUCCESS !=
-      runtime->AllocateMemory(local_region_, alloc_size,
-                              MemoryRegion::AllocateRestrict,
-                              reinterpret_cast<void**>(&buff))) {
-    return false;
-  }
-
-  end_ts_base_addr_.store(buff, std::memory_order_release);
-
-  return true;
-}
-
-uint64_t* GpuAgent::ObtainEndTsObject() {
-  if (end_ts_base_addr_ == NULL) {
+      core::Runtime::runtime_singleton_->AllocateMemory(local_region_, count * kTsSize,
+                                                        MemoryRegion::AllocateRestrict,
+                                                        reinterpret_cast<void**>(&buff))) {
     return NULL;
   }
-
-  const uint32_t end_ts_index =
-      end_ts_pool_counter_.fetch_add(1U, std::memory_order_acq_rel) %
-      end_ts_pool_size_;
-  const static size_t kNumU64 = kTsSize / sizeof(uint64_t);
-  uint64_t* end_ts_addr = &end_ts_base_addr_[end_ts_index * kNumU64];
-  assert(IsMultipleOf(end_ts_addr, kTsSize));
-
-  return end_ts_addr;
+  assert(IsMultipleOf(buff, kTsSize));
+  return buff;
 }
 
 hsa_status_t GpuAgent::IterateRegion(
@@ -530,13 +569,57 @@ hsa_status_t GpuAgent::VisitRegion(
 core::Queue* GpuAgent::CreateInterceptibleQueue() {
   // Disabled intercept of internal queues pending tools updates.
   core::Queue* queue = nullptr;
-  QueueCreate(minAqlSize_, HSA_QUEUE_TYPE_MULTI, NULL, NULL, 0, 0, &queue);
+  CreateAqlQueue(minAqlSize_, NULL, NULL, 0, 0, &queue);
   if (queue != nullptr)
     core::Runtime::runtime_singleton_->InternalQueueCreateNotify(core::Queue::Convert(queue),
                                                                  this->public_handle());
   return queue;
 }
 
+// Parses a hex CU mask, most significant digit first, into 32 bit words with the lowest CUs in
+// the first word.  Returns an empty mask if @p str is empty or not hex.
+static std::vector<uint32_t> ParseCuMask(const std::string& str) {
+  const size_t begin = (str.compare(0, 2, "0x") == 0 || str.compare(0, 2, "0X") == 0) ? 2 : 0;
+  std::vector<uint32_t> mask;
+  uint32_t bit = 0;
+  for (size_t i = str.size(); i > begin; i--, bit += 4) {
+    const char c = str[i - 1];
+    uint32_t digit;
+    if (c >= '0' && c <= '9')
+      digit = c - '0';
+    else if (c >= 'a' && c <= 'f')
+      digit = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+      digit = c - 'A' + 10;
+    else
+      return std::vector<uint32_t>();
+    if (bit % 32 == 0) mask.push_back(0);
+    mask.back() |= digit << (bit % 32);
+  }
+  return mask;
+}
+
+core::Queue* GpuAgent::CreateBlitQueue() {
+  core::Queue* queue = CreateInterceptibleQueue();
+  if (queue == nullptr)
+    throw AMD::hsa_exception(HSA_STATUS_ERROR_OUT_OF_RESOURCES, "Internal queue creation failed.");
+
+  // Leave CUs to user kernels.  A mask the queue rejects leaves it on all CUs.
+  const std::vector<uint32_t> mask =
+      ParseCuMask(core::Runtime::runtime_singleton_->flag().blit_cu_mask());
+  if (!mask.empty() &&
+      queue->SetCUMasking(uint32_t(mask.size() * 32), &mask[0]) != HSA_STATUS_SUCCESS)
+    debug_print("Invalid HSA_BLIT_CU_MASK, blit queue uses all CUs.\n");
+
+  return queue;
+}
+
+lazy_ptr<core::Queue>& GpuAgent::BlitQueue(QueueEnum queue) {
+  assert(((queue == QueueDevToHost) || (queue == QueueDevToDev)) && "Not a shared blit queue.");
+  return core::Runtime::runtime_singleton_->flag().dedicated_blit_queues() ? queues_[queue]
+                                                                           : queues_[QueueUtility];
+}
+
 core::Blit* GpuAgent::CreateBlitSdma(bool h2d) {
   core::Blit* sdma;
 
@@ -546,7 +629,9 @@ core::Blit* GpuAgent::CreateBlitSdma(bool h2d) {
     sdma = new BlitSdmaV4(h2d);
   }
 
-  if (sdma->Initialize(*this) != HSA_STATUS_SUCCESS) {
+  // Blits are created lazily, pick up a profiling mode set before first use.
+  if (sdma->Initialize(*this) != HSA_STATUS_SUCCESS ||
+      (profiling_enabled() && sdma->EnableProfiling(true) != HSA_STATUS_SUCCESS)) {
     sdma->Destroy(*this);
     delete sdma;
     sdma = NULL;
@@ -558,7 +643,8 @@ core::Blit* GpuAgent::CreateBlitSdma(bool h2d) {
 core::Blit* GpuAgent::CreateBlitKernel(core::Queue* queue) {
   BlitKernel* kernl = new BlitKernel(queue);
 
-  if (kernl->Initialize(*this) != HSA_STATUS_SUCCESS) {
+  if (kernl->Initialize(*this) != HSA_STATUS_SUCCESS ||
+      (profiling_enabled() && kernl->EnableProfiling(true) != HSA_STATUS_SUCCESS)) {
     kernl->Destroy(*this);
     delete kernl;
     kernl = NULL;
@@ -576,10 +662,13 @@ void GpuAgent::InitDma() {
                                "Internal queue creation failed.");
     return ret;
   };
+  auto blit_queue_lambda = [this]() { return CreateBlitQueue(); };
   // Dedicated compute queue for host-to-device blits.
-  queues_[QueueBlitOnly].reset(queue_lambda);
-  // Share utility queue with device-to-host blits.
+  queues_[QueueBlitOnly].reset(blit_queue_lambda);
+  // Utility queue, shared with device-to-{host,device} blits unless they have their own.
   queues_[QueueUtility].reset(queue_lambda);
+  queues_[QueueDevToHost].reset(blit_queue_lambda);
+  queues_[QueueDevToDev].reset(blit_queue_lambda);
 
   // Decide which engine to use for blits.
   auto blit_lambda = [this](bool h2d, lazy_ptr<core::Queue>& queue) {
@@ -600,13 +689,45 @@ void GpuAgent::InitDma() {
   };
 
   blits_[BlitHostToDev].reset([blit_lambda, this]() { return blit_lambda(true, queues_[QueueBlitOnly]); });
-  blits_[BlitDevToHost].reset([blit_lambda, this]() { return blit_lambda(false, queues_[QueueUtility]); });
+  blits_[BlitDevToHost].reset(
+      [blit_lambda, this]() { return blit_lambda(false, BlitQueue(QueueDevToHost)); });
   blits_[BlitDevToDev].reset([this]() {
-    auto ret = CreateBlitKernel((*queues_[QueueUtility]).get());
+    auto ret = CreateBlitKernel((*BlitQueue(QueueDevToDev)).get());
+    if (ret == nullptr)
+      throw AMD::hsa_exception(HSA_STATUS_ERROR_OUT_OF_RESOURCES, "Blit creation failed.");
+    return ret;
+  });
+  // Compute alternatives to SDMA host<->device blits, only created by the cost model.
+  blits_[BlitHostToDevKernel].reset([this]() {
+    auto ret = CreateBlitKernel((*queues_[QueueBlitOnly]).get());
     if (ret == nullptr)
       throw AMD::hsa_exception(HSA_STATUS_ERROR_OUT_OF_RESOURCES, "Blit creation failed.");
     return ret;
   });
+  blits_[BlitDevToHostKernel].reset([this]() {
+    auto ret = CreateBlitKernel((*BlitQueue(QueueDevToHost)).get());
+    if (ret == nullptr)
+      throw AMD::hsa_exception(HSA_STATUS_ERROR_OUT_OF_RESOURCES, "Blit creation failed.");
+    return ret;
+  });
+
+  // Further device-to-device queues, used round robin by DevToDevBlit.
+  for (uint32_t i = 0; i < kMaxDevToDevQueues - 1; i++) {
+    d2d_queues_[i].reset(blit_queue_lambda);
+    d2d_blits_[i].reset([this, i]() {
+      auto ret = CreateBlitKernel((*d2d_queues_[i]).get());
+      if (ret == nullptr)
+        throw AMD::hsa_exception(HSA_STATUS_ERROR_OUT_OF_RESOURCES, "Blit creation failed.");
+      return ret;
+    });
+  }
+
+  // Extra SDMA queues for striping, KFD distributes queues across engines.
+  // Failure is not fatal, the copy is spread over fewer engines instead.
+  for (uint32_t i = 0; i < kMaxSdmaStripes - 1; i++) {
+    sdma_stripes_[BlitHostToDev][i].reset([this]() { return CreateBlitSdma(true); });
+    sdma_stripes_[BlitDevToHost][i].reset([this]() { return CreateBlitSdma(false); });
+  }
 }
 
 void GpuAgent::PreloadBlits() {
@@ -616,7 +737,8 @@ void GpuAgent::PreloadBlits() {
 }
 
 hsa_status_t GpuAgent::PostToolsInit() {
-  // Defer memory allocation until agents have been discovered.
+  // Defer memory allocation until agents have been discovered. The scratch
+  // aperture itself is reserved by the first scratch request.
   InitScratchPool();
   BindTrapHandler();
   InitDma();
@@ -633,38 +755,305 @@ hsa_status_t GpuAgent::DmaCopy(void* dst, core::Agent& dst_agent,
                                size_t size,
                                std::vector<core::Signal*>& dep_signals,
                                core::Signal& out_signal) {
-  lazy_ptr<core::Blit>& blit =
-    (src_agent.device_type() == core::Agent::kAmdCpuDevice &&
-     dst_agent.device_type() == core::Agent::kAmdGpuDevice)
-       ? blits_[BlitHostToDev]
-       : (src_agent.device_type() == core::Agent::kAmdGpuDevice &&
-          dst_agent.device_type() == core::Agent::kAmdCpuDevice)
-            ? blits_[BlitDevToHost]
-            : (src_agent.node_id() == dst_agent.node_id())
-              ? blits_[BlitDevToDev] : blits_[BlitDevToHost];
+  const BlitEnum dir = AsyncBlitDirection(dst_agent, src_agent);
 
   if (profiling_enabled()) {
     // Track the agent so we could translate the resulting timestamp to system
     // domain correctly.
     out_signal.async_copy_agent(core::Agent::Convert(this->public_handle()));
+    lazy_ptr<core::Blit>& blit = GetAsyncBlit(dst_agent, src_agent);
+    hsa_status_t stat = blit->SubmitLinearCopyCommand(dst, src, size, dep_signals, out_signal);
+    if (stat == HSA_STATUS_SUCCESS) RecordBlit(dir, blit->isSDMA(), 1, size);
+    return stat;
+  }
+
+  // Alternative engines are created without profiling, so are only used while it is off.
+  lazy_ptr<core::Blit>& blit = ((dir == BlitHostToDev) || (dir == BlitDevToHost))
+      ? SelectAsyncBlit(dir, dst, src, size)
+      : GetAsyncBlit(dst_agent, src_agent);
+
+  // Striped copies have no single start timestamp so are not profiled.
+  const uint32_t stripes = core::Runtime::runtime_singleton_->flag().sdma_stripes();
+  if ((stripes > 1) && (size >= 2 * kMinSdmaStripeSize) &&
+      ((&blit == &blits_[BlitHostToDev]) || (&blit == &blits_[BlitDevToHost])) &&
+      blit->isSDMA()) {
+    hsa_status_t stat = DmaCopyStriped(dst, src, size, &blit == &blits_[BlitHostToDev], stripes,
+                                       dep_signals, out_signal);
+    if (stat == HSA_STATUS_SUCCESS) RecordBlit(dir, true, 1, size);
+    return stat;
+  }
+
+  const uint32_t rings = core::Runtime::runtime_singleton_->flag().sdma_rings();
+  if ((rings > 1) && ((&blit == &blits_[BlitHostToDev]) || (&blit == &blits_[BlitDevToHost])) &&
+      blit->isSDMA()) {
+    core::Blit* ring = LeastBusyRing(dir, rings);
+    hsa_status_t stat = ring->SubmitLinearCopyCommand(dst, src, size, dep_signals, out_signal);
+    if (stat == HSA_STATUS_SUCCESS) RecordBlit(dir, true, 1, size);
+    return stat;
   }
 
   hsa_status_t stat = blit->SubmitLinearCopyCommand(dst, src, size, dep_signals, out_signal);
+  if (stat == HSA_STATUS_SUCCESS) RecordBlit(dir, blit->isSDMA(), 1, size);
+
+  return stat;
+}
+
+void GpuAgent::AsyncCopyEngines(std::vector<core::Blit*>& engines) {
+  auto add = [&](lazy_ptr<core::Blit>& blit) {
+    if (blit.created()) engines.push_back((*blit).get());
+  };
+  for (auto& blit : blits_) add(blit);
+  for (auto& dir : sdma_stripes_)
+    for (auto& blit : dir) add(blit);
+  for (auto& blit : d2d_blits_) add(blit);
+}
+
+hsa_status_t GpuAgent::DmaCopyBatch(const std::vector<hsa_amd_memory_copy_desc_t>& copies,
+                                    core::Agent& dst_agent, core::Agent& src_agent,
+                                    std::vector<core::Signal*>& dep_signals,
+                                    core::Signal& out_signal) {
+  lazy_ptr<core::Blit>& blit = GetAsyncBlit(dst_agent, src_agent);
+
+  if (profiling_enabled()) {
+    // Track the agent so we could translate the resulting timestamp to system
+    // domain correctly.
+    out_signal.async_copy_agent(core::Agent::Convert(this->public_handle()));
+  }
+
+  hsa_status_t stat = blit->SubmitLinearCopyBatch(copies, dep_signals, out_signal);
+  if (stat == HSA_STATUS_SUCCESS) {
+    uint64_t bytes = 0;
+    for (const auto& copy : copies) bytes += copy.size;
+    RecordBlit(AsyncBlitDirection(dst_agent, src_agent), blit->isSDMA(), copies.size(), bytes);
+  }
 
   return stat;
 }
 
+lazy_ptr<core::Blit>& GpuAgent::GetAsyncBlit(const core::Agent& dst_agent,
+                                             const core::Agent& src_agent) {
+  return (src_agent.device_type() == core::Agent::kAmdCpuDevice &&
+          dst_agent.device_type() == core::Agent::kAmdGpuDevice)
+      ? blits_[BlitHostToDev]
+      : (src_agent.device_type() == core::Agent::kAmdGpuDevice &&
+         dst_agent.device_type() == core::Agent::kAmdCpuDevice)
+          ? blits_[BlitDevToHost]
+          : (src_agent.node_id() == dst_agent.node_id())
+            ? DevToDevBlit() : blits_[BlitDevToHost];
+}
+
+lazy_ptr<core::Blit>& GpuAgent::DevToDevBlit() {
+  const Flag& flag = core::Runtime::runtime_singleton_->flag();
+  if (!flag.dedicated_blit_queues() || (flag.d2d_blit_queues() <= 1)) return blits_[BlitDevToDev];
+
+  const uint32_t count = Min(flag.d2d_blit_queues(), uint32_t(kMaxDevToDevQueues));
+  const uint32_t index = d2d_next_.fetch_add(1, std::memory_order_relaxed) % count;
+  return (index == 0) ? blits_[BlitDevToDev] : d2d_blits_[index - 1];
+}
+
+GpuAgent::BlitEnum GpuAgent::AsyncBlitDirection(const core::Agent& dst_agent,
+                                                const core::Agent& src_agent) const {
+  if (src_agent.device_type() == core::Agent::kAmdCpuDevice &&
+      dst_agent.device_type() == core::Agent::kAmdGpuDevice)
+    return BlitHostToDev;
+  if (src_agent.device_type() == core::Agent::kAmdGpuDevice &&
+      dst_agent.device_type() == core::Agent::kAmdCpuDevice)
+    return BlitDevToHost;
+  // Peer copies run on the device-to-host engine but are accounted as device to device.
+  return BlitDevToDev;
+}
+
+lazy_ptr<core::Blit>& GpuAgent::SelectAsyncBlit(BlitEnum dir, void* dst, const void* src,
+                                                size_t size) {
+  assert(((dir == BlitHostToDev) || (dir == BlitDevToHost)) && "Not a host<->device copy.");
+  lazy_ptr<core::Blit>& primary = blits_[dir];
+  if (!core::Runtime::runtime_singleton_->flag().blit_cost_model()) return primary;
+
+  // Nothing to choose from once the primary engine is already a compute blit.
+  if (!primary->isSDMA()) return primary;
+
+  // Large copies reach full bandwidth on SDMA without taking CUs from the application, and
+  // the compute blit falls back to byte accesses when source and destination are misaligned.
+  const bool misaligned = ((uintptr_t(dst) ^ uintptr_t(src)) & 3) != 0;
+  if ((size >= kBlitSdmaMinLargeCopy) || misaligned) return primary;
+
+  lazy_ptr<core::Blit>& kernel =
+      blits_[(dir == BlitHostToDev) ? BlitHostToDevKernel : BlitDevToHostKernel];
+  const uint64_t kernel_backlog = kernel->Backlog();
+
+  // Small copies finish sooner on the compute blit, which has no engine startup latency.
+  if (size <= kBlitKernelMaxSmallCopy) {
+    return (kernel_backlog < kBlitKernelBusyBacklog) ? kernel : primary;
+  }
+
+  // Medium copies only move off a backlogged SDMA engine onto an idle compute queue.
+  if ((kernel_backlog == 0) && (primary->Backlog() > kBlitSdmaBusyBacklog)) return kernel;
+
+  return primary;
+}
+
+void GpuAgent::CollectStats(hsa_amd_stats_agent_t& stats) {
+  std::memset(&stats, 0, sizeof(stats));
+  stats.node_id = node_id();
+  GetInfo(hsa_agent_info_t(HSA_AMD_AGENT_INFO_BLIT_STATS), &stats.blits);
+
+  const BlitEnum dirs[3] = {BlitHostToDev, BlitDevToHost, BlitDevToDev};
+  for (int i = 0; i < 3; i++) {
+    if (blits_[dirs[i]].created())
+      blits_[dirs[i]]->RingUsage(stats.rings[i].used, stats.rings[i].size);
+  }
+
+  {
+    ScopedAcquire<KernelMutex> lock(&scratch_lock_);
+    stats.scratch_size = scratch_pool_.size();
+    stats.scratch_free = scratch_pool_.remaining();
+  }
+
+  if (local_region_ != nullptr) local_region_->GetStats(&stats.local_pool);
+}
+
+void GpuAgent::RecordBlit(BlitEnum dir, bool sdma, uint64_t copies, uint64_t bytes) {
+  BlitStats& stats = blit_stats_[dir];
+  if (sdma) {
+    stats.sdma_copies.fetch_add(copies, std::memory_order_relaxed);
+    stats.sdma_bytes.fetch_add(bytes, std::memory_order_relaxed);
+  } else {
+    stats.kernel_copies.fetch_add(copies, std::memory_order_relaxed);
+    stats.kernel_bytes.fetch_add(bytes, std::memory_order_relaxed);
+  }
+}
+
+std::vector<core::Blit*> GpuAgent::StripeEngines(BlitEnum dir, uint32_t stripes) {
+  // Stripe 0 and the completing submission use the primary engine.
+  std::vector<core::Blit*> engines(1, (*blits_[dir]).get());
+  stripes = Min(stripes, uint32_t(kMaxSdmaStripes));
+  for (uint32_t i = 1; i < stripes; i++) {
+    core::Blit* blit = (*sdma_stripes_[dir][i - 1]).get();
+    if (blit != nullptr) engines.push_back(blit);
+  }
+  return engines;
+}
+
+core::Blit* GpuAgent::LeastBusyRing(BlitEnum dir, uint32_t rings) {
+  const std::vector<core::Blit*> engines = StripeEngines(dir, rings);
+  core::Blit* best = engines[0];
+  uint64_t best_backlog = best->Backlog();
+  for (size_t i = 1; (i < engines.size()) && (best_backlog != 0); i++) {
+    const uint64_t backlog = engines[i]->Backlog();
+    if (backlog < best_backlog) {
+      best = engines[i];
+      best_backlog = backlog;
+    }
+  }
+  return best;
+}
+
+hsa_status_t GpuAgent::SubmitStriped(BlitEnum dir, const std::vector<core::Blit*>& engines,
+                                     const StripeSubmit& submit,
+                                     std::vector<core::Signal*>& dep_signals,
+                                     core::Signal& out_signal) {
+  std::vector<core::unique_signal_ptr> signals;
+  std::vector<core::Signal*> tail_deps;
+  for (size_t i = 0; i < engines.size(); i++) {
+    signals.emplace_back(new core::DefaultSignal(1));
+    tail_deps.push_back(signals.back().get());
+  }
+
+  ScopedAcquire<KernelMutex> lock(&stripe_lock_);
+
+  // Engines retire submissions in order, so once stripe 0 of a group has
+  // completed every earlier group's completing submission has finished
+  // polling its signals.
+  auto& pending = stripe_signals_[dir];
+  for (size_t i = pending.size(); i > 1; i--) {
+    if (pending[i - 1][0]->LoadRelaxed() == 0) {
+      pending.erase(pending.begin(), pending.begin() + (i - 1));
+      break;
+    }
+  }
+
+  // A stripe refused by its engine goes to engine 0, which completes the copy anyway.
+  hsa_status_t stat = HSA_STATUS_SUCCESS;
+  size_t queued = 0;
+  for (; queued < engines.size(); queued++) {
+    stat = submit(engines[queued], queued, dep_signals, *signals[queued]);
+    if ((stat != HSA_STATUS_SUCCESS) && (queued != 0))
+      stat = submit(engines[0], queued, dep_signals, *signals[queued]);
+    if (stat != HSA_STATUS_SUCCESS) break;
+  }
+
+  if (stat == HSA_STATUS_SUCCESS) {
+    stat = submit(engines[0], engines.size(), tail_deps, out_signal);
+    if (stat == HSA_STATUS_SUCCESS) {
+      pending.push_back(std::move(signals));
+      return stat;
+    }
+  }
+
+  // The failure is reported once no queued stripe can still write the destination.
+  lock.Release();
+  for (size_t i = 0; i < queued; i++)
+    signals[i]->WaitRelaxed(HSA_SIGNAL_CONDITION_EQ, 0, uint64_t(-1), HSA_WAIT_STATE_BLOCKED);
+  return stat;
+}
+
+hsa_status_t GpuAgent::DmaCopyStriped(void* dst, const void* src, size_t size, bool h2d,
+                                      uint32_t stripes, std::vector<core::Signal*>& dep_signals,
+                                      core::Signal& out_signal) {
+  const BlitEnum dir = h2d ? BlitHostToDev : BlitDevToHost;
+
+  std::vector<core::Blit*> engines =
+      StripeEngines(dir, Min(stripes, uint32_t(size / kMinSdmaStripeSize)));
+
+  if (engines.size() == 1)
+    return engines[0]->SubmitLinearCopyCommand(dst, src, size, dep_signals, out_signal);
+
+  // The completing submission carries the last page so it is never empty.
+  const size_t kTailSize = 4096;
+  char* dst_ptr = reinterpret_cast<char*>(dst);
+  const char* src_ptr = reinterpret_cast<const char*>(src);
+  const size_t body = size - kTailSize;
+  const size_t stripe_size = AlignUp(body / engines.size(), kTailSize);
+  const size_t num_stripes = engines.size();
+
+  auto submit = [&](core::Blit* blit, size_t part, std::vector<core::Signal*>& deps,
+                    core::Signal& signal) {
+    if (part == num_stripes)
+      return blit->SubmitLinearCopyCommand(dst_ptr + body, src_ptr + body, kTailSize, deps, signal);
+    const size_t offset = part * stripe_size;
+    const size_t len = (part == num_stripes - 1) ? (body - offset) : stripe_size;
+    return blit->SubmitLinearCopyCommand(dst_ptr + offset, src_ptr + offset, len, deps, signal);
+  };
+  return SubmitStriped(dir, engines, submit, dep_signals, out_signal);
+}
+
+// Validate a rect copy against its surfaces.  Rows must not wrap an edge.
+static bool RectInBounds(const hsa_pitched_ptr_t* dst, const hsa_dim3_t* dst_offset,
+                         const hsa_pitched_ptr_t* src, const hsa_dim3_t* src_offset,
+                         const hsa_dim3_t* range) {
+  if (uint64_t(src_offset->x) + range->x > src->pitch ||
+      uint64_t(dst_offset->x) + range->x > dst->pitch)
+    return false;
+  if ((src->slice != 0) && (uint64_t(src_offset->y) + range->y) > src->slice / src->pitch)
+    return false;
+  if ((dst->slice != 0) && (uint64_t(dst_offset->y) + range->y) > dst->slice / dst->pitch)
+    return false;
+  if (range->z > 1 && (src->slice == 0 || dst->slice == 0)) return false;
+  return true;
+}
+
 hsa_status_t GpuAgent::DmaCopyRect(const hsa_pitched_ptr_t* dst, const hsa_dim3_t* dst_offset,
                                    const hsa_pitched_ptr_t* src, const hsa_dim3_t* src_offset,
                                    const hsa_dim3_t* range, hsa_amd_copy_direction_t dir,
                                    std::vector<core::Signal*>& dep_signals,
                                    core::Signal& out_signal) {
-  if (isa_->GetMajorVersion() < 9) return HSA_STATUS_ERROR_INVALID_AGENT;
-
-  lazy_ptr<core::Blit>& blit =
-      (dir == hsaHostToDevice) ? blits_[BlitHostToDev] : blits_[BlitDevToHost];
+  if (!RectInBounds(dst, dst_offset, src, src_offset, range))
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
 
-  if (!blit->isSDMA()) return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+  const BlitEnum blit_dir = (dir == hsaHostToDevice) ? BlitHostToDev
+      : (dir == hsaDeviceToDevice)                  ? BlitDevToDev
+                                                    : BlitDevToHost;
+  lazy_ptr<core::Blit>& blit = blits_[blit_dir];
 
   if (profiling_enabled()) {
     // Track the agent so we could translate the resulting timestamp to system
@@ -672,22 +1061,105 @@ hsa_status_t GpuAgent::DmaCopyRect(const hsa_pitched_ptr_t* dst, const hsa_dim3_
     out_signal.async_copy_agent(core::Agent::Convert(this->public_handle()));
   }
 
-  BlitSdmaBase* sdmaBlit = static_cast<BlitSdmaBase*>((*blit).get());
-  hsa_status_t stat = sdmaBlit->SubmitCopyRectCommand(dst, dst_offset, src, src_offset, range,
-                                                      dep_signals, out_signal);
+  // Merge rows, then slices, that are contiguous in both surfaces.
+  size_t run = range->x;
+  size_t rows = range->y;
+  size_t slices = range->z;
+  if ((src->pitch == run) && (dst->pitch == run)) {
+    run *= rows;
+    rows = 1;
+    if ((slices == 1) || ((src->slice == run) && (dst->slice == run))) {
+      run *= slices;
+      slices = 1;
+    }
+  }
 
-  return stat;
+  char* dst_base = reinterpret_cast<char*>(dst->base) + dst_offset->z * dst->slice +
+      dst_offset->y * dst->pitch + dst_offset->x;
+  const char* src_base = reinterpret_cast<const char*>(src->base) + src_offset->z * src->slice +
+      src_offset->y * src->pitch + src_offset->x;
+
+  if (rows * slices == 1)
+    return blit->SubmitLinearCopyCommand(dst_base, src_base, run, dep_signals, out_signal);
+
+  // Device to device copies and engines without rect support go row by row.  The blit kernel
+  // runs the rows as concurrent dispatches.
+  const bool sdma_rect = (blit_dir != BlitDevToDev) && blit->isSDMA() &&
+      (isa_->GetMajorVersion() >= 9);
+  if (!sdma_rect) {
+    std::vector<hsa_amd_memory_copy_desc_t> copies;
+    copies.reserve(rows * slices);
+    for (size_t z = 0; z < slices; z++) {
+      for (size_t y = 0; y < rows; y++) {
+        hsa_amd_memory_copy_desc_t copy;
+        copy.dst = dst_base + z * dst->slice + y * dst->pitch;
+        copy.src = src_base + z * src->slice + y * src->pitch;
+        copy.size = run;
+        copies.push_back(copy);
+      }
+    }
+    return blit->SubmitLinearCopyBatch(copies, dep_signals, out_signal);
+  }
+
+  // Large volumes are cut into slabs of slices over the striping engines, the last slice
+  // completes the copy on the primary engine.
+  const uint32_t stripes = core::Runtime::runtime_singleton_->flag().sdma_stripes();
+  const uint64_t bytes = uint64_t(range->x) * range->y * range->z;
+  std::vector<core::Blit*> engines;
+  if ((stripes > 1) && !profiling_enabled() && (range->z > 2) &&
+      (bytes >= 2 * kMinSdmaStripeSize)) {
+    engines = StripeEngines(blit_dir, Min(stripes, uint32_t(bytes / kMinSdmaStripeSize),
+                                          uint32_t(range->z - 1)));
+  }
+
+  if (engines.size() <= 1) {
+    BlitSdmaBase* sdmaBlit = static_cast<BlitSdmaBase*>((*blit).get());
+    return sdmaBlit->SubmitCopyRectCommand(dst, dst_offset, src, src_offset, range, dep_signals,
+                                           out_signal);
+  }
+
+  const uint32_t body = range->z - 1;
+  const uint32_t slab = (body + uint32_t(engines.size()) - 1) / uint32_t(engines.size());
+  engines.resize((body + slab - 1) / slab);
+  const size_t num_slabs = engines.size();
+
+  auto submit = [&](core::Blit* engine, size_t part, std::vector<core::Signal*>& deps,
+                    core::Signal& signal) {
+    // The tail is the last slice, after the body rather than at part * slab.
+    const uint32_t first = (part == num_slabs) ? body : uint32_t(part) * slab;
+    hsa_dim3_t src_off = *src_offset;
+    hsa_dim3_t dst_off = *dst_offset;
+    hsa_dim3_t sub = *range;
+    src_off.z += first;
+    dst_off.z += first;
+    sub.z = (part == num_slabs) ? 1 : Min(slab, body - first);
+    return static_cast<BlitSdmaBase*>(engine)->SubmitCopyRectCommand(dst, &dst_off, src, &src_off,
+                                                                     &sub, deps, signal);
+  };
+  return SubmitStriped(blit_dir, engines, submit, dep_signals, out_signal);
 }
 
 hsa_status_t GpuAgent::DmaFill(void* ptr, uint32_t value, size_t count) {
   return blits_[BlitDevToDev]->SubmitLinearFillCommand(ptr, value, count);
 }
 
-hsa_status_t GpuAgent::EnableDmaProfiling(bool enable) {
-  if (enable && !InitEndTsPool()) {
-    return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+hsa_status_t GpuAgent::DmaFill(const std::vector<core::FillRange>& ranges, uint32_t value,
+                               std::vector<core::Signal*>& dep_signals,
+                               core::Signal& out_signal) {
+  // Asynchronous fills go to the device to host engine, SDMA constant fill
+  // where it is available, so that they leave the CUs to the application.
+  lazy_ptr<core::Blit>& blit = blits_[BlitDevToHost];
+
+  if (profiling_enabled()) {
+    // Track the agent so we could translate the resulting timestamp to system
+    // domain correctly.
+    out_signal.async_copy_agent(core::Agent::Convert(this->public_handle()));
   }
 
+  return blit->SubmitLinearFillCommand(ranges, value, dep_signals, out_signal);
+}
+
+hsa_status_t GpuAgent::EnableDmaProfiling(bool enable) {
   for (int i = 0; i < BlitCount; ++i) {
     if (blits_[i].created()) {
       const hsa_status_t stat = blits_[i]->EnableProfiling(enable);
@@ -697,9 +1169,40 @@ hsa_status_t GpuAgent::EnableDmaProfiling(bool enable) {
     }
   }
 
+  for (auto& direction : sdma_stripes_) {
+    for (auto& blit : direction) {
+      if (blit.created()) {
+        const hsa_status_t stat = blit->EnableProfiling(enable);
+        if (stat != HSA_STATUS_SUCCESS) {
+          return stat;
+        }
+      }
+    }
+  }
+
+  for (auto& blit : d2d_blits_) {
+    if (blit.created()) {
+      const hsa_status_t stat = blit->EnableProfiling(enable);
+      if (stat != HSA_STATUS_SUCCESS) {
+        return stat;
+      }
+    }
+  }
+
   return HSA_STATUS_SUCCESS;
 }
 
+// Probing for the profiling library means a dlopen, do it once per process.
+static bool AqlProfileAvailable() {
+  static const bool available = []() {
+    os::LibHandle lib = os::LoadLib(kAqlProfileLib);
+    if (lib == NULL) return false;
+    os::CloseLib(lib);
+    return true;
+  }();
+  return available;
+}
+
 hsa_status_t GpuAgent::GetInfo(hsa_agent_info_t attribute, void* value) const {
   
   // agent, and vendor name size limit
@@ -709,14 +1212,9 @@ hsa_status_t GpuAgent::GetInfo(hsa_agent_info_t attribute, void* value) const {
     
     // Build agent name by concatenating the Major, Minor and Stepping Ids
     // of devices compute capability with a prefix of "gfx"
-    case HSA_AGENT_INFO_NAME: {
-      std::stringstream name;
-      std::memset(value, 0, HSA_PUBLIC_NAME_SIZE);
-      char* temp = reinterpret_cast<char*>(value);
-      name << "gfx" << isa_->GetMajorVersion() << isa_->GetMinorVersion() << isa_->GetStepping();
-      std::strcpy(temp, name.str().c_str());
+    case HSA_AGENT_INFO_NAME:
+      std::memcpy(value, name_, sizeof(name_));
       break;
-    }
     case HSA_AGENT_INFO_VENDOR_NAME:
       std::memset(value, 0, HSA_PUBLIC_NAME_SIZE);
       std::memcpy(value, "AMD", sizeof("AMD"));
@@ -811,8 +1309,7 @@ hsa_status_t GpuAgent::GetInfo(hsa_agent_info_t attribute, void* value) const {
         setFlag(HSA_EXTENSION_IMAGES);
       }
 
-      if (os::LibHandle lib = os::LoadLib(kAqlProfileLib)) {
-        os::CloseLib(lib);
+      if (AqlProfileAvailable()) {
         setFlag(HSA_EXTENSION_AMD_AQLPROFILE);
       }
 
@@ -881,15 +1378,9 @@ hsa_status_t GpuAgent::GetInfo(hsa_agent_info_t attribute, void* value) const {
     
     // The code copies HsaNodeProperties.MarketingName a Unicode string
     // which is encoded in UTF-16 as a 7-bit ASCII string
-    case HSA_AMD_AGENT_INFO_PRODUCT_NAME: {
-      std::memset(value, 0, HSA_PUBLIC_NAME_SIZE);
-      char* temp = reinterpret_cast<char*>(value);
-      for (uint32_t idx = 0;
-           properties_.MarketingName[idx] != 0 && idx < HSA_PUBLIC_NAME_SIZE - 1; idx++) {
-        temp[idx] = (uint8_t)properties_.MarketingName[idx];
-      }
+    case HSA_AMD_AGENT_INFO_PRODUCT_NAME:
+      std::memcpy(value, product_name_, sizeof(product_name_));
       break;
-    }
     case HSA_AMD_AGENT_INFO_MAX_WAVES_PER_CU:
       *((uint32_t*)value) = static_cast<uint32_t>(
           properties_.NumSIMDPerCU * properties_.MaxWavesPerSIMD);
@@ -906,6 +1397,25 @@ hsa_status_t GpuAgent::GetInfo(hsa_agent_info_t attribute, void* value) const {
     case HSA_AMD_AGENT_INFO_HDP_FLUSH:
       *((hsa_amd_hdp_flush_t*)value) = HDP_flush_;
       break;
+    case HSA_AMD_AGENT_INFO_NEAREST_HOST_POOL: {
+      const core::MemoryRegion* region =
+          core::Runtime::runtime_singleton_->GetNearestSystemRegion(*this);
+      ((hsa_amd_memory_pool_t*)value)->handle =
+          core::MemoryRegion::Convert(const_cast<core::MemoryRegion*>(region)).handle;
+      break;
+    }
+    case HSA_AMD_AGENT_INFO_BLIT_STATS: {
+      hsa_amd_agent_blit_stats_t* stats = reinterpret_cast<hsa_amd_agent_blit_stats_t*>(value);
+      hsa_amd_blit_engine_stats_t* out[3] = {&stats->host_to_device, &stats->device_to_host,
+                                             &stats->device_to_device};
+      for (int i = 0; i < 3; i++) {
+        out[i]->sdma_copies = blit_stats_[i].sdma_copies.load(std::memory_order_relaxed);
+        out[i]->sdma_bytes = blit_stats_[i].sdma_bytes.load(std::memory_order_relaxed);
+        out[i]->kernel_copies = blit_stats_[i].kernel_copies.load(std::memory_order_relaxed);
+        out[i]->kernel_bytes = blit_stats_[i].kernel_bytes.load(std::memory_order_relaxed);
+      }
+      break;
+    }
     default:
       return HSA_STATUS_ERROR_INVALID_ARGUMENT;
       break;
@@ -928,11 +1438,67 @@ hsa_status_t GpuAgent::QueueCreate(size_t size, hsa_queue_type32_t queue_type,
     return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
   }
 
+  // Single producer queues store the write index without reserving slots, so they can not share
+  // a ring with other producers.
+  if ((queue_pool_ != nullptr) && (queue_type == HSA_QUEUE_TYPE_MULTI)) {
+    return queue_pool_->QueueCreate(size, event_callback, data, private_segment_size,
+                                    group_segment_size, queue);
+  }
+
+  return CreateAqlQueue(size, event_callback, data, private_segment_size, group_segment_size,
+                        queue);
+}
+
+hsa_status_t GpuAgent::DeviceEnqueueQueueCreate(size_t size, core::HsaEventCallback event_callback,
+                                                void* data, uint32_t private_segment_size,
+                                                uint32_t group_segment_size,
+                                                core::Queue** queue) {
+  if (!IsPowerOfTwo(size)) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  if (size > maxAqlSize_) {
+    return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+  }
+
+  return CreateAqlQueue(size, event_callback, data, private_segment_size, group_segment_size,
+                        queue, true);
+}
+
+bool GpuAgent::TakeRingBuffer(uint32_t size_pkts, void*& ring, uint32_t& alloc_bytes) {
+  ScopedAcquire<KernelMutex> lock(&ring_cache_lock_);
+  for (auto it = ring_cache_.begin(); it != ring_cache_.end(); ++it) {
+    if (it->size_pkts == size_pkts) {
+      ring = it->ring;
+      alloc_bytes = it->alloc_bytes;
+      ring_cache_.erase(it);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool GpuAgent::CacheRingBuffer(uint32_t size_pkts, void* ring, uint32_t alloc_bytes) {
+  ScopedAcquire<KernelMutex> lock(&ring_cache_lock_);
+  if (ring_cache_.size() >= core::Runtime::runtime_singleton_->flag().ring_buffer_cache())
+    return false;
+  ring_cache_.push_back({size_pkts, ring, alloc_bytes});
+  return true;
+}
+
+hsa_status_t GpuAgent::CreateAqlQueue(size_t size, core::HsaEventCallback event_callback,
+                                      void* data, uint32_t private_segment_size,
+                                      uint32_t group_segment_size, core::Queue** queue,
+                                      bool device_ring) {
   // Allocate scratch memory
   ScratchInfo scratch;
   if (private_segment_size == UINT_MAX) {
     private_segment_size = 0;
   }
+  // Deferred scratch is acquired by the queue's scratch fault handler on first use.
+  if (core::Runtime::runtime_singleton_->flag().defer_queue_scratch()) {
+    private_segment_size = 0;
+  }
   scratch.size_per_thread = private_segment_size;
 
   const uint32_t num_cu = properties_.NumFComputeCores / properties_.NumSIMDPerCU;
@@ -940,6 +1506,7 @@ hsa_status_t GpuAgent::QueueCreate(size_t size, hsa_queue_type32_t queue_type,
       scratch.size_per_thread * properties_.MaxSlotsScratchCU * properties_.WaveFrontSize * num_cu;
   scratch.queue_base = nullptr;
   scratch.queue_process_offset = 0;
+  scratch.queue = nullptr;
 
   MAKE_NAMED_SCOPE_GUARD(scratchGuard, [&]() { ReleaseQueueScratch(scratch); });
 
@@ -957,7 +1524,8 @@ hsa_status_t GpuAgent::QueueCreate(size_t size, hsa_queue_type32_t queue_type,
 
   // Create an HW AQL queue
   auto aql_queue =
-      new AqlQueue(this, size, node_id(), scratch, event_callback, data, is_kv_device_);
+      new AqlQueue(this, size, node_id(), scratch, event_callback, data, is_kv_device_,
+                   device_ring);
   *queue = aql_queue;
 
   // Calculate index of the queue doorbell within the doorbell aperture.
@@ -984,6 +1552,8 @@ void GpuAgent::AcquireQueueScratch(ScratchInfo& scratch) {
   if (size_per_wave > MAX_WAVE_SCRATCH) return;
 
   ScopedAcquire<KernelMutex> lock(&scratch_lock_);
+  ReserveScratchPool();
+
   // Limit to 1/8th of scratch pool for small scratch and 1/4 of that for a single queue.
   size_t small_limit = scratch_pool_.size() >> 3;
   size_t single_limit = small_limit >> 2;
@@ -1008,7 +1578,10 @@ void GpuAgent::AcquireQueueScratch(ScratchInfo& scratch) {
       HSAuint64 alternate_va;
       if (hsaKmtMapMemoryToGPU(scratch.queue_base, scratch.size, &alternate_va) ==
           HSAKMT_STATUS_SUCCESS) {
-        if (large) scratch_used_large_ += scratch.size;
+        if (large) {
+          scratch_used_large_ += scratch.size;
+          if (scratch.queue != nullptr) large_scratch_holders_.push_back(scratch.queue);
+        }
         return;
       }
     }
@@ -1018,10 +1591,21 @@ void GpuAgent::AcquireQueueScratch(ScratchInfo& scratch) {
   scratch_pool_.free(scratch.queue_base);
   scratch.queue_base = nullptr;
 
-  // Retry if large may yield needed space.
+  // Retry if large may yield needed space.  Queues keeping large scratch give it up once their
+  // current dispatch ends.  Idle holders would never dispatch again to do so, so only wait while
+  // one of them still has packets to process; otherwise trim occupancy below instead.
   if (scratch_used_large_ != 0) {
-    scratch.retry = true;
-    return;
+    bool busy_holder = large_scratch_holders_.empty();
+    for (amd_queue_t* holder : large_scratch_holders_) {
+      atomic::Or(&holder->queue_properties, uint32_t(AMD_QUEUE_PROPERTIES_USE_SCRATCH_ONCE),
+                 std::memory_order_seq_cst);
+      busy_holder |= atomic::Load(&holder->read_dispatch_id, std::memory_order_acquire) !=
+          atomic::Load(&holder->write_dispatch_id, std::memory_order_acquire);
+    }
+    if (busy_holder) {
+      scratch.retry = true;
+      return;
+    }
   }
 
   // Attempt to trim the maximum number of concurrent waves to allow scratch to fit.
@@ -1030,6 +1614,8 @@ void GpuAgent::AcquireQueueScratch(ScratchInfo& scratch) {
   uint64_t num_cus = properties_.NumFComputeCores / properties_.NumSIMDPerCU;
   uint64_t total_waves = scratch.size / size_per_wave;
   uint64_t waves_per_cu = total_waves / num_cus;
+  // Start from the largest occupancy the free scratch could hold.
+  waves_per_cu = Min(waves_per_cu, uint64_t(scratch_pool_.remaining() / (num_cus * size_per_wave)));
   while (waves_per_cu != 0) {
     size_t size = waves_per_cu * num_cus * size_per_wave;
     void* base = scratch_pool_.alloc(size);
@@ -1046,6 +1632,7 @@ void GpuAgent::AcquireQueueScratch(ScratchInfo& scratch) {
               : uintptr_t(scratch.queue_base) - uintptr_t(scratch_pool_.base());
       scratch.large = true;
       scratch_used_large_ += scratch.size;
+      if (scratch.queue != nullptr) large_scratch_holders_.push_back(scratch.queue);
       return;
     }
     scratch_pool_.free(base);
@@ -1072,25 +1659,86 @@ void GpuAgent::ReleaseQueueScratch(ScratchInfo& scratch) {
   scratch_pool_.free(scratch.queue_base);
   scratch.queue_base = nullptr;
 
-  if (scratch.large) scratch_used_large_ -= scratch.size;
+  if (scratch.large) {
+    scratch_used_large_ -= scratch.size;
+    auto holder =
+        std::find(large_scratch_holders_.begin(), large_scratch_holders_.end(), scratch.queue);
+    if (holder != large_scratch_holders_.end()) large_scratch_holders_.erase(holder);
+  }
 
-  // Notify waiters that additional scratch may be available.
-  for (auto notifier : scratch_notifiers_)
-    HSA::hsa_signal_or_relaxed(notifier.first, notifier.second);
+  NotifyScratchWaiters();
+}
+
+void GpuAgent::AddScratchNotifier(hsa_signal_t signal, hsa_signal_value_t value, size_t size,
+                                  int priority, uint64_t& ticket) {
+  ScopedAcquire<KernelMutex> lock(&scratch_lock_);
+  for (auto it = scratch_waiters_.begin(); it != scratch_waiters_.end(); it++) {
+    if (it->signal.handle == signal.handle) {
+      scratch_waiters_.erase(it);
+      break;
+    }
+  }
+
+  if (ticket == 0) ticket = ++scratch_waiter_ticket_;
+  ScratchWaiter waiter = {signal, value, size, priority, ticket};
+  auto pos = std::upper_bound(
+      scratch_waiters_.begin(), scratch_waiters_.end(), waiter,
+      [](const ScratchWaiter& lhs, const ScratchWaiter& rhs) {
+        return (lhs.priority != rhs.priority) ? (lhs.priority > rhs.priority)
+                                              : (lhs.ticket < rhs.ticket);
+      });
+  scratch_waiters_.insert(pos, waiter);
+}
+
+void GpuAgent::RemoveScratchNotifier(hsa_signal_t signal) {
+  ScopedAcquire<KernelMutex> lock(&scratch_lock_);
+  for (auto it = scratch_waiters_.begin(); it != scratch_waiters_.end(); it++) {
+    if (it->signal.handle == signal.handle) {
+      scratch_waiters_.erase(it);
+      return;
+    }
+  }
+}
+
+void GpuAgent::NotifyScratchWaiters() {
+  // Grant freed scratch in admission order, waking only waiters it covers.  Stop at the first
+  // waiter that does not fit so that smaller, later requests can not starve it.  Once no large
+  // scratch is outstanding nothing more will be released for the head waiter, so wake it to
+  // trim its occupancy instead.
+  size_t budget = scratch_pool_.remaining();
+  auto it = scratch_waiters_.begin();
+  while (it != scratch_waiters_.end()) {
+    if (it->size > budget) {
+      if ((it == scratch_waiters_.begin()) && (scratch_used_large_ == 0)) {
+        HSA::hsa_signal_or_relaxed(it->signal, it->value);
+        it = scratch_waiters_.erase(it);
+      }
+      break;
+    }
+    budget -= it->size;
+    HSA::hsa_signal_or_relaxed(it->signal, it->value);
+    it = scratch_waiters_.erase(it);
+  }
 }
 
 void GpuAgent::TranslateTime(core::Signal* signal,
                              hsa_amd_profiling_dispatch_time_t& time) {
   // Order is important, we want to translate the end time first to ensure that packet duration is
   // not impacted by clock measurement latency jitter.
-  time.end = TranslateTime(signal->signal_.end_ts);
-  time.start = TranslateTime(signal->signal_.start_ts);
-
-  if ((signal->signal_.start_ts == 0) || (signal->signal_.end_ts == 0) ||
-      (signal->signal_.start_ts > t1_.GPUClockCounter) ||
-      (signal->signal_.end_ts > t1_.GPUClockCounter) ||
-      (signal->signal_.start_ts < t0_.GPUClockCounter) ||
-      (signal->signal_.end_ts < t0_.GPUClockCounter))
+  const uint64_t start_ts = signal->signal_.start_ts;
+  const uint64_t end_ts = signal->signal_.end_ts;
+
+  ClockSnapshot clocks;
+  LoadClocks(clocks);
+  RefreshClocks(clocks, Max(start_ts, end_ts));
+  time.end = TranslateTime(clocks, end_ts);
+  time.start = TranslateTime(clocks, start_ts);
+
+  if ((start_ts == 0) || (end_ts == 0) ||
+      (start_ts > clocks.gpu + clocks.resync_ticks) ||
+      (end_ts > clocks.gpu + clocks.resync_ticks) ||
+      (start_ts < t0_.GPUClockCounter) ||
+      (end_ts < t0_.GPUClockCounter))
     debug_print("Signal %p time stamps may be invalid.", &signal->signal_);
 }
 
@@ -1101,11 +1749,61 @@ frequency adjustment (ie the profiling with NTP problem).  This is fixed by usin
 for early times.
 Intervals larger than t0_ will be frequency adjusted.  This admits a numerical error of not more
 than twice the frequency stability (~10^-5).
+Times up to kClockResyncInterval past the last clock sync are extrapolated rather than resyncing,
+so conversion rarely enters the kernel and never takes a lock when it does not.
 */
 uint64_t GpuAgent::TranslateTime(uint64_t tick) {
-  // Ensure interpolation for times during program execution.
-  ScopedAcquire<KernelMutex> lock(&t1_lock_);
-  if ((t1_.GPUClockCounter < tick) || (t1_.GPUClockCounter == t0_.GPUClockCounter)) SyncClocks();
+  ClockSnapshot clocks;
+  LoadClocks(clocks);
+  RefreshClocks(clocks, tick);
+  return TranslateTime(clocks, tick);
+}
+
+void GpuAgent::TranslateTime(const uint64_t* ticks, uint64_t* system_ticks, size_t count) {
+  if (count == 0) return;
+
+  uint64_t max_tick = 0;
+  for (size_t i = 0; i < count; i++) max_tick = Max(max_tick, ticks[i]);
+
+  ClockSnapshot clocks;
+  LoadClocks(clocks);
+  RefreshClocks(clocks, max_tick);
+  for (size_t i = 0; i < count; i++) system_ticks[i] = TranslateTime(clocks, ticks[i]);
+}
+
+void GpuAgent::LoadClocks(ClockSnapshot& clocks) const {
+  uint32_t seq;
+  do {
+    seq = t1_seq_.load(std::memory_order_acquire);
+    clocks.gpu = t1_gpu_.load(std::memory_order_relaxed);
+    clocks.system = t1_system_.load(std::memory_order_relaxed);
+    clocks.ratio = t1_ratio_.load(std::memory_order_relaxed);
+    clocks.resync_ticks = t1_resync_ticks_.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while (((seq & 1) != 0) || (seq != t1_seq_.load(std::memory_order_relaxed)));
+}
+
+void GpuAgent::RefreshClocks(ClockSnapshot& clocks, uint64_t max_tick) {
+  const bool synced = (clocks.ratio != 0.0);
+  if (synced && ((max_tick <= clocks.gpu) || (max_tick - clocks.gpu <= clocks.resync_ticks)))
+    return;
+
+  // Only one thread resyncs.  Others keep extrapolating from the last correlation unless there is
+  // none yet.
+  if (!synced) {
+    t1_lock_.Acquire();
+  } else if (!t1_lock_.Try()) {
+    return;
+  }
+  MAKE_SCOPE_GUARD([&]() { t1_lock_.Release(); });
+
+  ClockSnapshot latest;
+  LoadClocks(latest);
+  if (latest.gpu == clocks.gpu) SyncClocks();
+  LoadClocks(clocks);
+}
+
+uint64_t GpuAgent::TranslateTime(const ClockSnapshot& clocks, uint64_t tick) {
 
   // Good for ~300 yrs
   // uint64_t sysdelta = t1_.SystemClockCounter - t0_.SystemClockCounter;
@@ -1118,14 +1816,16 @@ uint64_t GpuAgent::TranslateTime(uint64_t tick) {
 
   // Good for ~3.5 months.
   uint64_t system_tick = 0;
-  double ratio = double(t1_.SystemClockCounter - t0_.SystemClockCounter) /
-      double(t1_.GPUClockCounter - t0_.GPUClockCounter);
-  system_tick = uint64_t(ratio * double(int64_t(tick - t1_.GPUClockCounter))) + t1_.SystemClockCounter;
+  const double ratio = clocks.ratio;
+  system_tick = uint64_t(ratio * double(int64_t(tick - clocks.gpu))) + clocks.system;
 
   // tick predates HSA startup - extrapolate with fixed clock ratio
   if (tick < t0_.GPUClockCounter) {
-    if (historical_clock_ratio_ == 0.0) historical_clock_ratio_ = ratio;
-    system_tick = uint64_t(historical_clock_ratio_ * double(int64_t(tick - t0_.GPUClockCounter))) +
+    // The first translation of such a tick fixes the ratio used for all of them.
+    double historical_ratio = 0.0;
+    if (historical_clock_ratio_.compare_exchange_strong(historical_ratio, ratio))
+      historical_ratio = ratio;
+    system_tick = uint64_t(historical_ratio * double(int64_t(tick - t0_.GPUClockCounter))) +
         t0_.SystemClockCounter;
   }
 
@@ -1179,6 +1879,23 @@ uint16_t GpuAgent::GetSdmaMicrocodeVersion() const {
 void GpuAgent::SyncClocks() {
   HSAKMT_STATUS err = hsaKmtGetClockCounters(node_id(), &t1_);
   assert(err == HSAKMT_STATUS_SUCCESS && "hsaGetClockCounters error");
+
+  // No correlation until the agent clock has advanced since t0_.
+  if (t1_.GPUClockCounter == t0_.GPUClockCounter) return;
+
+  const double ratio = double(t1_.SystemClockCounter - t0_.SystemClockCounter) /
+      double(t1_.GPUClockCounter - t0_.GPUClockCounter);
+  const uint64_t resync_ticks =
+      uint64_t(double(t0_.SystemClockFrequencyHz / 1000 * kClockResyncInterval) / ratio);
+
+  const uint32_t seq = t1_seq_.load(std::memory_order_relaxed);
+  t1_seq_.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  t1_gpu_.store(t1_.GPUClockCounter, std::memory_order_relaxed);
+  t1_system_.store(t1_.SystemClockCounter, std::memory_order_relaxed);
+  t1_ratio_.store(ratio, std::memory_order_relaxed);
+  t1_resync_ticks_.store(resync_ticks, std::memory_order_relaxed);
+  t1_seq_.store(seq + 2, std::memory_order_release);
 }
 
 void GpuAgent::BindTrapHandler() {
@@ -1193,14 +1910,14 @@ void GpuAgent::BindTrapHandler() {
   }
 
   // Assemble the trap handler source code.
-  AssembleShader("TrapHandler", AssembleTarget::ISA, trap_code_buf_, trap_code_buf_size_);
+  AssembleShader(ShaderTrapHandler, AssembleTarget::ISA, trap_code_buf_, trap_code_buf_size_);
 
   // Make an empty map from doorbell index to queue.
   // The trap handler uses this to retrieve a wave's amd_queue_t*.
   auto doorbell_queue_map_size = MAX_NUM_DOORBELLS * sizeof(amd_queue_t*);
 
-  doorbell_queue_map_ = (amd_queue_t**)core::Runtime::runtime_singleton_->system_allocator()(
-      doorbell_queue_map_size, 0x1000, 0);
+  doorbell_queue_map_ = (amd_queue_t**)core::Runtime::runtime_singleton_->AllocateNearSystemMemory(
+      *this, doorbell_queue_map_size, 0);
   assert(doorbell_queue_map_ != NULL && "Doorbell queue map allocation failed");
 
   memset(doorbell_queue_map_, 0, doorbell_queue_map_size);
@@ -1229,24 +1946,29 @@ void GpuAgent::InvalidateCodeCaches() {
   }
 
   // Invalidate caches which may hold lines of code object allocation.
-  constexpr uint32_t cache_inv_size_dw = 7;
-  uint32_t cache_inv[cache_inv_size_dw];
-
-  cache_inv[0] = PM4_HDR(PM4_HDR_IT_OPCODE_ACQUIRE_MEM, cache_inv_size_dw,
-                         isa_->GetMajorVersion());
-  cache_inv[1] = PM4_ACQUIRE_MEM_DW1_COHER_CNTL(
-      PM4_ACQUIRE_MEM_COHER_CNTL_SH_ICACHE_ACTION_ENA |
-      PM4_ACQUIRE_MEM_COHER_CNTL_SH_KCACHE_ACTION_ENA |
-      PM4_ACQUIRE_MEM_COHER_CNTL_TC_ACTION_ENA |
-      PM4_ACQUIRE_MEM_COHER_CNTL_TC_WB_ACTION_ENA);
-  cache_inv[2] = PM4_ACQUIRE_MEM_DW2_COHER_SIZE(0xFFFFFFFF);
-  cache_inv[3] = PM4_ACQUIRE_MEM_DW3_COHER_SIZE_HI(0xFF);
-  cache_inv[4] = 0;
-  cache_inv[5] = 0;
-  cache_inv[6] = 0;
+  uint32_t cache_inv[Pm4<7>::kAcquireMemSizeDw];
+  static_assert(uint32_t(Pm4<7>::kAcquireMemSizeDw) == uint32_t(Pm4<8>::kAcquireMemSizeDw) &&
+                    uint32_t(Pm4<8>::kAcquireMemSizeDw) == uint32_t(Pm4<9>::kAcquireMemSizeDw),
+                "ACQUIRE_MEM size differs between ISAs");
+  if (isa_->GetMajorVersion() == 7) {
+    Pm4<7>::AcquireMemInvalidateCaches(cache_inv);
+  } else if (isa_->GetMajorVersion() == 8) {
+    Pm4<8>::AcquireMemInvalidateCaches(cache_inv);
+  } else {
+    Pm4<9>::AcquireMemInvalidateCaches(cache_inv);
+  }
 
   // Submit the command to the utility queue and wait for it to complete.
   queues_[QueueUtility]->ExecutePM4(cache_inv, sizeof(cache_inv));
 }
 
+void GpuAgent::FlushCodeCaches() {
+  // Clear the request before issuing so that a request racing with the
+  // invalidation is flushed again by its own caller.
+  if (code_cache_invalidate_pending_.load(std::memory_order_acquire) &&
+      code_cache_invalidate_pending_.exchange(false, std::memory_order_acq_rel)) {
+    InvalidateCodeCaches();
+  }
+}
+
 }  // namespace
@@ -53,6 +53,8 @@
 #include <cstdlib>
 #include <utility>
 #include "core/inc/hsa_internal.h"
+#include "core/util/locks.h"
+#include "core/util/stream_copy.h"
 #include "core/util/utils.h"
 #include "inc/hsa_ext_amd.h"
 
@@ -152,7 +154,7 @@ bool MallocedMemory::Copy(size_t offset, const void *src, size_t size)
   assert(this->Allocated());
   assert(nullptr != src);
   assert(0 < size);
-  memcpy(this->Address(offset), src, size);
+  stream::HostCopy(this->Address(offset), src, size);
   return true;
 }
 
@@ -235,7 +237,7 @@ bool MappedMemory::Copy(size_t offset, const void *src, size_t size)
   assert(this->Allocated());
   assert(nullptr != src);
   assert(0 < size);
-  memcpy(this->Address(offset), src, size);
+  stream::HostCopy(this->Address(offset), src, size);
   return true;
 }
 
@@ -269,8 +271,7 @@ public:
 
   void* Address(size_t offset = 0) const override
     { assert(this->Allocated()); return (char*)ptr_ + offset; }
-  void* HostAddress(size_t offset = 0) const override
-    { assert(this->Allocated()); return (char*)host_ptr_ + offset; }
+  void* HostAddress(size_t offset = 0) const override;
   bool Allocated() const override
     { return nullptr != ptr_; }
 
@@ -283,9 +284,15 @@ private:
   RegionMemory(const RegionMemory&);
   RegionMemory& operator=(const RegionMemory&);
 
+  /// Returns the GPU agent owning region_, or null for system memory.
+  core::Agent* GpuOwner() const;
+
   hsa_region_t region_;
   void *ptr_;
-  void *host_ptr_;
+  /// Host shadow that Copy writes into. Released once the contents are
+  /// uploaded by Freeze and read back on demand by HostAddress.
+  mutable void *host_ptr_;
+  mutable KernelMutex host_lock_;
   size_t size_;
 };
 
@@ -315,7 +322,11 @@ bool RegionMemory::Allocate(size_t size, size_t align, bool zero)
   assert(!this->Allocated());
   assert(0 < size);
   assert(0 < align && 0 == (align & (align - 1)));
-  if (HSA_STATUS_SUCCESS != HSA::hsa_memory_allocate(region_, size, &ptr_)) {
+  // Code and data are used by GPUs directly, so they must not be mapped lazily.
+  if (HSA_STATUS_SUCCESS !=
+      core::Runtime::runtime_singleton_->AllocateMemory(core::MemoryRegion::Convert(region_),
+                                                        size, core::MemoryRegion::AllocateNoFlags,
+                                                        &ptr_)) {
     ptr_ = nullptr;
     return false;
   }
@@ -333,12 +344,38 @@ bool RegionMemory::Allocate(size_t size, size_t align, bool zero)
   return true;
 }
 
+core::Agent* RegionMemory::GpuOwner() const
+{
+  core::Agent* agent = reinterpret_cast<amd::MemoryRegion*>(
+                           core::MemoryRegion::Convert(region_))->owner();
+  return (agent != NULL && agent->device_type() == core::Agent::kAmdGpuDevice) ? agent : NULL;
+}
+
+void* RegionMemory::HostAddress(size_t offset) const
+{
+  assert(this->Allocated());
+  ScopedAcquire<KernelMutex> lock(&host_lock_);
+  if (nullptr == host_ptr_) {
+    // Tools asking for the host copy of a frozen segment get a fresh read back.
+    void *host_ptr = nullptr;
+    if (HSA_STATUS_SUCCESS != HSA::hsa_memory_allocate(RegionMemory::System(), size_, &host_ptr)) {
+      return nullptr;
+    }
+    if (HSA_STATUS_SUCCESS != GpuOwner()->DmaCopy(host_ptr, ptr_, size_)) {
+      HSA::hsa_memory_free(host_ptr);
+      return nullptr;
+    }
+    host_ptr_ = host_ptr;
+  }
+  return (char*)host_ptr_ + offset;
+}
+
 bool RegionMemory::Copy(size_t offset, const void *src, size_t size)
 {
   assert(this->Allocated() && nullptr != host_ptr_);
   assert(nullptr != src);
   assert(0 < size);
-  memcpy((char*)host_ptr_ + offset, src, size);
+  stream::HostCopy((char*)host_ptr_ + offset, src, size);
   return true;
 }
 
@@ -357,45 +394,22 @@ void RegionMemory::Free()
 bool RegionMemory::Freeze() {
   assert(this->Allocated() && nullptr != host_ptr_);
 
-  core::Agent* agent = reinterpret_cast<amd::MemoryRegion*>(
-                           core::MemoryRegion::Convert(region_))->owner();
-  if (agent != NULL && agent->device_type() == core::Agent::kAmdGpuDevice) {
+  core::Agent* agent = GpuOwner();
+  if (agent != NULL) {
     if (HSA_STATUS_SUCCESS != agent->DmaCopy(ptr_, host_ptr_, size_)) {
       return false;
     }
+    // The device copy is now authoritative, stop holding the segment twice.
+    ScopedAcquire<KernelMutex> lock(&host_lock_);
+    HSA::hsa_memory_free(host_ptr_);
+    host_ptr_ = nullptr;
   } else {
-    memcpy(ptr_, host_ptr_, size_);
+    stream::HostCopy(ptr_, host_ptr_, size_);
   }
 
   return true;
 }
 
-hsa_status_t IsIsaEquivalent(hsa_isa_t isa, void *data) {
-  assert(data);
-
-  std::pair<hsa_isa_t, bool> *data_pair = (std::pair<hsa_isa_t, bool>*)data;
-  assert(data_pair);
-  assert(data_pair->first.handle != 0);
-  assert(data_pair->second != true);
-
-  const core::Isa *agent_isa = core::Isa::Object(isa);
-  assert(agent_isa);
-  const core::Isa *code_object_isa = core::Isa::Object(data_pair->first);
-  assert(code_object_isa);
-
-  // SRAM ECC enabled code may run on a system without ECC
-  // but a system which has ECC enabled requires ECC enabled code.
-  if (agent_isa->sramEccEnabled() && !code_object_isa->sramEccEnabled())
-    return HSA_STATUS_SUCCESS;
-
-  if (agent_isa->version() == code_object_isa->version()) {
-    data_pair->second = true;
-    return HSA_STATUS_INFO_BREAK;
-  }
-
-  return HSA_STATUS_SUCCESS;
-}
-
 }  // namespace anonymous
 
 namespace amd {
@@ -420,12 +434,17 @@ bool LoaderContext::IsaSupportedByAgent(hsa_agent_t agent,
                                         hsa_isa_t code_object_isa) {
   assert(agent.handle != 0);
 
-  std::pair<hsa_isa_t, bool> data(code_object_isa, false);
-  hsa_status_t status = HSA::hsa_agent_iterate_isas(agent, IsIsaEquivalent, &data);
-  if (status != HSA_STATUS_SUCCESS && status != HSA_STATUS_INFO_BREAK) {
+  const core::Agent *agent_object = core::Agent::Convert(agent);
+  if (!agent_object || !agent_object->IsValid()) {
+    return false;
+  }
+  const core::Isa *agent_isa = agent_object->isa();
+  if (!agent_isa) {
     return false;
   }
-  return data.second;
+  const core::Isa *code_object_isa_object = core::Isa::Object(code_object_isa);
+  assert(code_object_isa_object);
+  return agent_isa->Supports(code_object_isa_object);
 }
 
 void* LoaderContext::SegmentAlloc(amdgpu_hsa_elf_segment_t segment,
@@ -481,8 +500,10 @@ void* LoaderContext::SegmentAlloc(amdgpu_hsa_elf_segment_t segment,
       assert(false);
     }
 
-    // Invalidate agent caches which may hold lines of the new allocation.
-    ((GpuAgentInt*)core::Agent::Convert(agent))->InvalidateCodeCaches();
+    // Agent caches may hold lines of the new allocation. The invalidation is
+    // coalesced with other code allocations and issued when the segment is
+    // frozen, before any code in it can run.
+    ((GpuAgentInt*)core::Agent::Convert(agent))->DeferInvalidateCodeCaches();
 
     break;
   }
@@ -543,13 +564,21 @@ void* LoaderContext::SegmentHostAddress(amdgpu_hsa_elf_segment_t segment, // not
   return ((SegmentMemory*)seg)->HostAddress(offset);
 }
 
-bool LoaderContext::SegmentFreeze(amdgpu_hsa_elf_segment_t segment, // not used.
-                                  hsa_agent_t agent,                // not used.
+bool LoaderContext::SegmentFreeze(amdgpu_hsa_elf_segment_t segment,
+                                  hsa_agent_t agent,
                                   void* seg,
                                   size_t size)                      // not used.
 {
   assert(nullptr != seg);
-  return ((SegmentMemory*)seg)->Freeze();
+  if (!((SegmentMemory*)seg)->Freeze()) {
+    return false;
+  }
+  if (AMDGPU_HSA_SEGMENT_CODE_AGENT == segment) {
+    // Issue the invalidations deferred by SegmentAlloc. Only the first code
+    // segment frozen after a batch of allocations pays for it.
+    ((GpuAgentInt*)core::Agent::Convert(agent))->FlushCodeCaches();
+  }
+  return true;
 }
 
 bool LoaderContext::ImageExtensionSupported() {
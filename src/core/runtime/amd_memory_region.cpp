@@ -96,12 +96,24 @@ void MemoryRegion::MakeKfdMemoryUnresident(const void* ptr) {
 }
 
 MemoryRegion::MemoryRegion(bool fine_grain, bool full_profile, core::Agent* owner,
-                           const HsaMemoryProperties& mem_props)
+                           const HsaMemoryProperties& mem_props, bool kernarg)
     : core::MemoryRegion(fine_grain, full_profile, owner),
       mem_props_(mem_props),
+      kernarg_(kernarg),
       max_single_alloc_size_(0),
       virtual_size_(0),
-      fragment_allocator_(BlockAllocator(*this)) {
+      fragment_allocator_(BlockAllocator(*this)),
+      block_cache_bytes_(0),
+      driver_bytes_(0),
+      used_bytes_(0),
+      alloc_count_(0),
+      free_count_(0),
+      failed_alloc_count_(0),
+      trim_count_(0) {
+  const Flag& flag = core::Runtime::runtime_singleton_->flag();
+  if (flag.memory_pool_trace()) trace_.reset(new AllocTrace());
+  fragment_allocator_.set_cache_policy(flag.fragment_cache_ratio(), 1, flag.fragment_cache_max());
+
   virtual_size_ = GetPhysicalSize();
 
   mem_flag_.Value = 0;
@@ -114,6 +126,7 @@ MemoryRegion::MemoryRegion(bool fine_grain, bool full_profile, core::Agent* owne
     mem_flag_.ui32.NoSubstitute = 1;
     mem_flag_.ui32.HostAccess =
         (mem_props_.HeapType == HSA_HEAPTYPE_FRAME_BUFFER_PRIVATE) ? 0 : 1;
+    assert((!kernarg_ || mem_flag_.ui32.HostAccess) && "Kernarg VRAM must be host visible.");
     mem_flag_.ui32.NonPaged = 1;
 
     virtual_size_ = kGpuVmSize;
@@ -134,9 +147,309 @@ MemoryRegion::MemoryRegion(bool fine_grain, bool full_profile, core::Agent* owne
   assert(GetVirtualSize() != 0);
   assert(GetPhysicalSize() <= GetVirtualSize());
   assert(IsMultipleOf(max_single_alloc_size_, kPageSize_));
+
+  InitInfo();
+}
+
+void MemoryRegion::InitInfo() {
+  switch (mem_props_.HeapType) {
+    case HSA_HEAPTYPE_SYSTEM:
+    case HSA_HEAPTYPE_FRAME_BUFFER_PRIVATE:
+    case HSA_HEAPTYPE_FRAME_BUFFER_PUBLIC:
+      info_.segment = HSA_REGION_SEGMENT_GLOBAL;
+      break;
+    case HSA_HEAPTYPE_GPU_LDS:
+      info_.segment = HSA_REGION_SEGMENT_GROUP;
+      break;
+    default:
+      // Not reported, only global and group regions are exposed.
+      info_.segment = HSA_REGION_SEGMENT_GLOBAL;
+      break;
+  }
+
+  switch (mem_props_.HeapType) {
+    case HSA_HEAPTYPE_SYSTEM:
+      info_.global_flags =
+          fine_grain() ? (HSA_REGION_GLOBAL_FLAG_KERNARG | HSA_REGION_GLOBAL_FLAG_FINE_GRAINED)
+                       : HSA_REGION_GLOBAL_FLAG_COARSE_GRAINED;
+      break;
+    case HSA_HEAPTYPE_FRAME_BUFFER_PRIVATE:
+    case HSA_HEAPTYPE_FRAME_BUFFER_PUBLIC:
+      info_.global_flags =
+          fine_grain() ? HSA_REGION_GLOBAL_FLAG_FINE_GRAINED : HSA_REGION_GLOBAL_FLAG_COARSE_GRAINED;
+      if (kernarg_) info_.global_flags |= HSA_REGION_GLOBAL_FLAG_KERNARG;
+      break;
+    default:
+      info_.global_flags = 0;
+      break;
+  }
+
+  const bool runtime_alloc = IsSystem() || IsLocalMemory();
+  info_.alloc_max_size = (runtime_alloc || IsScratch()) ? max_single_alloc_size_ : 0;
+  info_.alloc_allowed = runtime_alloc;
+  info_.alloc_granule = runtime_alloc ? kPageSize_ : 0;
+  info_.alloc_alignment = runtime_alloc ? kPageSize_ : 0;
+}
+
+MemoryRegion::~MemoryRegion() {
+  TrimBlockCache();
+
+  // Hand binned fragments back so the heap releases their blocks.
+  ScopedAcquire<KernelMutex> heap_lock(&fragment_lock_);
+  for (FragmentBins& bins : fragment_bins_) ReturnFragments(bins, true);
+}
+
+// Size classes in pages, four per doubling above four pages.
+static constexpr uint32_t kFragmentClassPages[] = {1,  2,  3,  4,  5,  6,  7,  8,  10, 12,
+                                                   14, 16, 20, 24, 28, 32, 40, 48, 56, 64};
+
+uint32_t MemoryRegion::SizeClass(size_t size) {
+  static_assert(sizeof(kFragmentClassPages) / sizeof(kFragmentClassPages[0]) == kNumSizeClasses,
+                "Size class table does not match kNumSizeClasses.");
+  static_assert(kFragmentClassPages[kNumSizeClasses - 1] * kPageSize_ == kMaxBinnedFragment,
+                "Largest size class must be kMaxBinnedFragment.");
+  const uint32_t pages = uint32_t(Max(size / kPageSize_, size_t(1)));
+  return uint32_t(std::lower_bound(kFragmentClassPages, kFragmentClassPages + kNumSizeClasses,
+                                   pages) -
+                  kFragmentClassPages);
+}
+
+size_t MemoryRegion::ClassSize(uint32_t size_class) {
+  return kFragmentClassPages[size_class] * kPageSize_;
+}
+
+MemoryRegion::FragmentBins& MemoryRegion::LocalBins() const {
+  static std::atomic<uint32_t> next_slot(0);
+  static thread_local uint32_t slot = uint32_t(-1);
+  if (slot == uint32_t(-1)) slot = next_slot++ % kFragmentBinSlots;
+  return fragment_bins_[slot];
+}
+
+void* MemoryRegion::AllocateFragment(size_t size) const {
+  if (size > kMaxBinnedFragment) {
+    ScopedAcquire<KernelMutex> heap_lock(&fragment_lock_);
+    return fragment_allocator_.alloc(size);
+  }
+
+  const uint32_t size_class = SizeClass(size);
+  const size_t class_size = ClassSize(size_class);
+  FragmentBins& bins = LocalBins();
+  ScopedAcquire<KernelMutex> lock(&bins.lock);
+  std::vector<void*>& bin = bins.free[size_class];
+
+  if (bin.empty()) {
+    // Refill with a single trip to the heap.  Only the first fragment is
+    // required to succeed.
+    const size_t count = Max(kBinRefillBytes / class_size, size_t(1));
+    ScopedAcquire<KernelMutex> heap_lock(&fragment_lock_);
+    for (size_t i = 0; i < count; i++) {
+      try {
+        bin.push_back(fragment_allocator_.alloc(class_size));
+      } catch (...) {
+        if (bin.empty()) throw;
+        break;
+      }
+      bins.bytes += class_size;
+    }
+  }
+
+  void* ret = bin.back();
+  bin.pop_back();
+  bins.bytes -= class_size;
+  return ret;
+}
+
+void MemoryRegion::TrackFragmentBlock(const void* base, bool add) const {
+  ScopedAcquire<KernelSharedMutex> lock(&fragment_blocks_lock_);
+  if (add)
+    fragment_blocks_.insert(uintptr_t(base));
+  else
+    fragment_blocks_.erase(uintptr_t(base));
+}
+
+bool MemoryRegion::InFragmentBlock(const void* ptr) const {
+  ScopedAcquire<KernelSharedMutex::Shared> lock(fragment_blocks_lock_.shared());
+  auto it = fragment_blocks_.upper_bound(uintptr_t(ptr));
+  if (it == fragment_blocks_.begin()) return false;
+  --it;
+  return uintptr_t(ptr) - *it < fragment_allocator_.max_alloc();
+}
+
+bool MemoryRegion::FreeFragment(void* ptr, size_t size) const {
+  if (size > fragment_allocator_.max_alloc()) return false;
+
+  // Size alone does not make a fragment, allocations with flags or made
+  // while the fragment allocator was disabled come straight from KFD.
+  if (!InFragmentBlock(ptr)) return false;
+
+  if (size > kMaxBinnedFragment || !IsLocalMemory() ||
+      core::Runtime::runtime_singleton_->flag().disable_fragment_alloc()) {
+    ScopedAcquire<KernelMutex> heap_lock(&fragment_lock_);
+    return fragment_allocator_.free(ptr);
+  }
+
+  const uint32_t size_class = SizeClass(size);
+  FragmentBins& bins = LocalBins();
+  ScopedAcquire<KernelMutex> lock(&bins.lock);
+  bins.free[size_class].push_back(ptr);
+  bins.bytes += ClassSize(size_class);
+
+  if (bins.bytes > kMaxBinBytes) {
+    ScopedAcquire<KernelMutex> heap_lock(&fragment_lock_);
+    ReturnFragments(bins, false);
+  }
+  return true;
+}
+
+void MemoryRegion::ReturnFragments(FragmentBins& bins, bool all) const {
+  // Without @p all keep the newer half of each bin, which is more likely to
+  // still be in the caches.
+  for (uint32_t size_class = 0; size_class < kNumSizeClasses; size_class++) {
+    std::vector<void*>& bin = bins.free[size_class];
+    const size_t count = all ? bin.size() : (bin.size() + 1) / 2;
+    for (size_t i = 0; i < count; i++) {
+      const bool freed = fragment_allocator_.free(bin[i]);
+      assert(freed && "Binned fragment unknown to the fragment heap.");
+      (void)freed;
+    }
+    bin.erase(bin.begin(), bin.begin() + count);
+    bins.bytes -= count * ClassSize(size_class);
+  }
+}
+
+void MemoryRegion::TrimFragments() const {
+  for (FragmentBins& bins : fragment_bins_) {
+    ScopedAcquire<KernelMutex> lock(&bins.lock);
+    ScopedAcquire<KernelMutex> heap_lock(&fragment_lock_);
+    ReturnFragments(bins, true);
+  }
+  ScopedAcquire<KernelMutex> heap_lock(&fragment_lock_);
+  fragment_allocator_.trim();
 }
 
-MemoryRegion::~MemoryRegion() {}
+void MemoryRegion::FreeBlock(void* ptr, size_t size) const {
+  ScopedAcquire<KernelMutex> lock(&core::Runtime::runtime_singleton_->memory_lock_);
+  MakeKfdMemoryUnresident(ptr);
+  FreeKfdMemory(ptr, size);
+  driver_bytes_ -= size;
+}
+
+void MemoryRegion::Trace(hsa_amd_memory_pool_trace_op_t op, const void* ptr, size_t size) const {
+  if (!trace_) return;
+  const uint64_t now = os::ReadAccurateClock();
+  ScopedAcquire<KernelMutex> lock(&trace_->lock);
+  hsa_amd_memory_pool_trace_event_t& event =
+      trace_->events[trace_->total % HSA_AMD_MEMORY_POOL_TRACE_EVENTS];
+  event.time_ns = now;
+  event.address = reinterpret_cast<uintptr_t>(ptr);
+  event.size = size;
+  event.op = op;
+  event.reserved = 0;
+  trace_->total++;
+}
+
+void MemoryRegion::GetStats(hsa_amd_memory_pool_stats_t* stats) const {
+  stats->driver_bytes = driver_bytes_.load(std::memory_order_relaxed);
+  stats->used_bytes = used_bytes_.load(std::memory_order_relaxed);
+  stats->alloc_count = alloc_count_.load(std::memory_order_relaxed);
+  stats->free_count = free_count_.load(std::memory_order_relaxed);
+  stats->failed_alloc_count = failed_alloc_count_.load(std::memory_order_relaxed);
+  stats->trim_count = trim_count_.load(std::memory_order_relaxed);
+
+  {
+    ScopedAcquire<KernelMutex> lock(&block_cache_lock_);
+    stats->cached_bytes = block_cache_bytes_;
+  }
+
+  // Binned fragments are free memory the heap counts as used.
+  uint64_t binned_bytes = 0;
+  uint64_t largest_binned = 0;
+  for (FragmentBins& bins : fragment_bins_) {
+    ScopedAcquire<KernelMutex> lock(&bins.lock);
+    binned_bytes += bins.bytes;
+    for (uint32_t size_class = kNumSizeClasses; size_class-- > 0;) {
+      if (bins.free[size_class].empty()) continue;
+      largest_binned = Max(largest_binned, uint64_t(ClassSize(size_class)));
+      break;
+    }
+  }
+
+  ScopedAcquire<KernelMutex> heap_lock(&fragment_lock_);
+  stats->fragment_block_bytes = fragment_allocator_.block_size() + fragment_allocator_.cache_size();
+  stats->fragment_free_bytes =
+      fragment_allocator_.free_size() + fragment_allocator_.cache_size() + binned_bytes;
+  stats->largest_free_fragment = Max(uint64_t(fragment_allocator_.largest_free()), largest_binned);
+}
+
+void MemoryRegion::GetTrace(hsa_amd_memory_pool_trace_t* trace) const {
+  trace->total_count = 0;
+  trace->count = 0;
+  trace->reserved = 0;
+  if (!trace_) return;
+
+  // Convert to nanoseconds on the way out to keep recording cheap.
+  const double ns_per_tick = 1e9 / double(os::AccurateClockFrequency());
+  ScopedAcquire<KernelMutex> lock(&trace_->lock);
+  const uint64_t count = Min(trace_->total, uint64_t(HSA_AMD_MEMORY_POOL_TRACE_EVENTS));
+  const uint64_t first = trace_->total - count;
+  for (uint64_t i = 0; i < count; i++) {
+    trace->events[i] = trace_->events[(first + i) % HSA_AMD_MEMORY_POOL_TRACE_EVENTS];
+    trace->events[i].time_ns = uint64_t(double(trace->events[i].time_ns) * ns_per_tick);
+  }
+  trace->total_count = trace_->total;
+  trace->count = uint32_t(count);
+}
+
+void* MemoryRegion::TakeCachedBlock(size_t size) const {
+  ScopedAcquire<KernelMutex> lock(&block_cache_lock_);
+  for (auto it = block_cache_.begin(); it != block_cache_.end(); it++) {
+    if (it->size != size) continue;
+    void* ret = it->ptr;
+    block_cache_bytes_ -= size;
+    block_cache_.erase(it);
+    cacheable_blocks_.insert(ret);
+    return ret;
+  }
+  return nullptr;
+}
+
+void MemoryRegion::ExcludeFromBlockCache(const void* ptr) const {
+  ScopedAcquire<KernelMutex> lock(&block_cache_lock_);
+  cacheable_blocks_.erase(ptr);
+}
+
+bool MemoryRegion::CacheBlock(void* ptr, size_t size) const {
+  const size_t limit = core::Runtime::runtime_singleton_->flag().large_block_cache_size();
+  std::vector<CachedBlock> evicted;
+  {
+    ScopedAcquire<KernelMutex> lock(&block_cache_lock_);
+    if (cacheable_blocks_.erase(ptr) == 0) return false;
+    if (size > limit) return false;
+
+    CachedBlock block = {ptr, size};
+    block_cache_.push_front(block);
+    block_cache_bytes_ += size;
+    while (block_cache_bytes_ > limit) {
+      evicted.push_back(block_cache_.back());
+      block_cache_bytes_ -= block_cache_.back().size;
+      block_cache_.pop_back();
+    }
+  }
+
+  for (auto& block : evicted) FreeBlock(block.ptr, block.size);
+  return true;
+}
+
+void MemoryRegion::TrimBlockCache() const {
+  std::list<CachedBlock> blocks;
+  {
+    ScopedAcquire<KernelMutex> lock(&block_cache_lock_);
+    blocks.swap(block_cache_);
+    block_cache_bytes_ = 0;
+  }
+
+  for (auto& block : blocks) FreeBlock(block.ptr, block.size);
+}
 
 hsa_status_t MemoryRegion::Allocate(size_t& size, AllocateFlags alloc_flags, void** address) const {
   if (address == NULL) {
@@ -151,9 +464,26 @@ hsa_status_t MemoryRegion::Allocate(size_t& size, AllocateFlags alloc_flags, voi
     return HSA_STATUS_ERROR_INVALID_ALLOCATION;
   }
 
+  // Only system memory is mapped lazily, prefaulted or bound to a NUMA node.
+  if (!IsSystem()) alloc_flags &= ~(AllocateLazyMap | AllocatePrefault | AllocateNumaBind);
+
+  // Huge page allocations are whole 2MB pages mapped to GPUs with 2MB page
+  // table fragments.  In huge page mode large system allocations get them by
+  // default.
+  bool huge_page = ((alloc_flags & AllocateHugePage) != 0);
+  huge_page |= IsSystem() && (size >= kHugePageSize_) &&
+      core::Runtime::runtime_singleton_->flag().system_huge_pages();
+  if (huge_page) {
+    size = AlignUp(size, kHugePageSize_);
+    if (size > max_single_alloc_size_) {
+      return HSA_STATUS_ERROR_INVALID_ALLOCATION;
+    }
+  }
+
   size = AlignUp(size, kPageSize_);
 
   HsaMemFlags kmt_alloc_flags(mem_flag_);
+  if (huge_page) kmt_alloc_flags.ui32.PageSize = HSA_PAGE_SIZE_2MB;
   kmt_alloc_flags.ui32.ExecuteAccess =
       (alloc_flags & AllocateExecutable ? 1 : 0);
   kmt_alloc_flags.ui32.AQLQueueMemory =
@@ -169,24 +499,60 @@ hsa_status_t MemoryRegion::Allocate(size_t& size, AllocateFlags alloc_flags, voi
     useSubAlloc &= ((alloc_flags & (~AllocateRestrict)) == 0);
     useSubAlloc &= (size <= fragment_allocator_.max_alloc());
     if (useSubAlloc) {
-      *address = fragment_allocator_.alloc(size);
+      *address = AllocateFragment(size);
+      RecordAlloc(*address, size);
       return HSA_STATUS_SUCCESS;
     }
-    if (subAllocEnabled) {
+    if (alloc_flags & AllocateIPC) {
+      // Exported allocations are shared and imported whole, keep them close to
+      // the requested size.  64KB matches the page size importers map with.
+      // They are not fragments even when small, see ipc_blocks_.
+      size = AlignUp(size, kIpcGranule_);
+    } else if (subAllocEnabled) {
       // Pad up larger VRAM allocations.
       size = AlignUp(size, fragment_allocator_.max_alloc());
     }
   }
 
+  // Plain VRAM allocations may reuse a cached block of the same size.
+  const bool cacheable = IsLocalMemory() && ((alloc_flags & (~AllocateRestrict)) == 0);
+  if (cacheable) {
+    *address = TakeCachedBlock(size);
+    if (*address != nullptr) {
+      RecordAlloc(*address, size);
+      return HSA_STATUS_SUCCESS;
+    }
+  }
+
   // Allocate memory.
-  // If it fails attempt to release memory from the block allocator and retry.
+  // If it fails attempt to release cached memory and retry.  Block allocations
+  // come from within the fragment allocator, which can't be trimmed at that
+  // point.
   *address = AllocateKfdMemory(kmt_alloc_flags, owner()->node_id(), size);
   if (*address == nullptr) {
-    fragment_allocator_.trim();
+    trim_count_++;
+    Trace(HSA_AMD_MEMORY_POOL_TRACE_TRIM, nullptr, size);
+    if ((alloc_flags & AllocateDirect) == 0) TrimFragments();
+    TrimBlockCache();
     *address = AllocateKfdMemory(kmt_alloc_flags, owner()->node_id(), size);
   }
 
+  const bool direct = ((alloc_flags & AllocateDirect) != 0);
   if (*address != nullptr) {
+    driver_bytes_ += size;
+
+    // System memory is still untouched, so THP can back it before pinning.
+    if (huge_page && IsSystem()) os::AdviseHugePages(*address, size);
+
+    // Place and back the pages now rather than on first touch by the CPU.
+    // GPU mappings pin the pages, binding first makes pinning use the node.
+    if ((alloc_flags & AllocateNumaBind) &&
+        (owner()->device_type() == core::Agent::kAmdCpuDevice)) {
+      const int32_t numa_node = static_cast<const CpuAgent*>(owner())->os_numa_node();
+      if (numa_node >= 0) os::BindToNumaNode(*address, size, uint32_t(numa_node));
+    }
+    if (alloc_flags & AllocatePrefault) os::PrefaultMemory(*address, size);
+
     // Commit the memory.
     // For system memory, on non-restricted allocation, map it to all GPUs. On
     // restricted allocation, only CPU is allowed to access by default, so
@@ -194,10 +560,19 @@ hsa_status_t MemoryRegion::Allocate(size_t& size, AllocateFlags alloc_flags, voi
     // For local memory, only map it to the owning GPU. Mapping to other GPU,
     // if the access is allowed, is performed on AllowAccess.
     HsaMemMapFlags map_flag = map_flag_;
+    if (huge_page) map_flag.ui32.PageSize = HSA_PAGE_SIZE_2MB;
     size_t map_node_count = 1;
     const uint32_t owner_node_id = owner()->node_id();
     const uint32_t* map_node_id = &owner_node_id;
 
+    if (IsSystem() && ((alloc_flags & (AllocateRestrict | AllocateLazyMap)) == AllocateLazyMap)) {
+      // Mapped on AllowAccess or by the first copy using it.
+      ScopedAcquire<KernelMutex> lock(&access_lock_);
+      lazy_allocations_[*address];
+      RecordAlloc(*address, size);
+      return HSA_STATUS_SUCCESS;
+    }
+
     if (IsSystem()) {
       if ((alloc_flags & AllocateRestrict) == 0) {
         // Map to all GPU agents.
@@ -205,17 +580,20 @@ hsa_status_t MemoryRegion::Allocate(size_t& size, AllocateFlags alloc_flags, voi
 
         if (map_node_count == 0) {
           // No need to pin since no GPU in the platform.
+          if (!direct) RecordAlloc(*address, size);
           return HSA_STATUS_SUCCESS;
         }
 
         map_node_id = &core::Runtime::runtime_singleton_->gpu_ids()[0];
       } else {
         // No need to pin it for CPU exclusive access.
+        if (!direct) RecordAlloc(*address, size);
         return HSA_STATUS_SUCCESS;
       }
     }
 
     uint64_t alternate_va = 0;
+    ScopedAcquire<KernelMutex> lock(&core::Runtime::runtime_singleton_->memory_lock_);
     const bool is_resident = MakeKfdMemoryResident(
         map_node_count, map_node_id, *address, size, &alternate_va, map_flag);
 
@@ -224,22 +602,65 @@ hsa_status_t MemoryRegion::Allocate(size_t& size, AllocateFlags alloc_flags, voi
 
     if (require_pinning && !is_resident) {
       FreeKfdMemory(*address, size);
+      driver_bytes_ -= size;
       *address = NULL;
+      failed_alloc_count_++;
+      Trace(HSA_AMD_MEMORY_POOL_TRACE_ALLOC_FAILED, nullptr, size);
       return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
     }
 
+    if (cacheable) {
+      ScopedAcquire<KernelMutex> cache_lock(&block_cache_lock_);
+      cacheable_blocks_.insert(*address);
+    }
+    if (IsLocalMemory() && (alloc_flags & AllocateIPC) &&
+        (size <= fragment_allocator_.max_alloc())) {
+      ScopedAcquire<KernelMutex> cache_lock(&block_cache_lock_);
+      ipc_blocks_.insert(*address);
+    }
+
+    if (!direct) RecordAlloc(*address, size);
     return HSA_STATUS_SUCCESS;
   }
 
+  failed_alloc_count_++;
+  Trace(HSA_AMD_MEMORY_POOL_TRACE_ALLOC_FAILED, nullptr, size);
   return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
 }
 
+void MemoryRegion::RecordAlloc(const void* ptr, size_t size) const {
+  used_bytes_ += size;
+  alloc_count_++;
+  Trace(HSA_AMD_MEMORY_POOL_TRACE_ALLOC, ptr, size);
+}
+
 hsa_status_t MemoryRegion::Free(void* address, size_t size) const {
-  if (fragment_allocator_.free(address)) return HSA_STATUS_SUCCESS;
+  used_bytes_ -= size;
+  free_count_++;
+  Trace(HSA_AMD_MEMORY_POOL_TRACE_FREE, address, size);
+
+  if (IsSystem()) {
+    ScopedAcquire<KernelMutex> lock(&access_lock_);
+    lazy_allocations_.erase(address);
+  }
+
+  bool ipc = false;
+  if (IsLocalMemory() && (size <= fragment_allocator_.max_alloc())) {
+    ScopedAcquire<KernelMutex> lock(&block_cache_lock_);
+    ipc = (ipc_blocks_.erase(address) != 0);
+  }
+
+  if (!ipc) {
+    if (FreeFragment(address, size)) return HSA_STATUS_SUCCESS;
 
+    if (CacheBlock(address, size)) return HSA_STATUS_SUCCESS;
+  }
+
+  ScopedAcquire<KernelMutex> lock(&core::Runtime::runtime_singleton_->memory_lock_);
   MakeKfdMemoryUnresident(address);
 
   FreeKfdMemory(address, size);
+  driver_bytes_ -= size;
 
   return HSA_STATUS_SUCCESS;
 }
@@ -248,94 +669,32 @@ hsa_status_t MemoryRegion::GetInfo(hsa_region_info_t attribute,
                                    void* value) const {
   switch (attribute) {
     case HSA_REGION_INFO_SEGMENT:
-      switch (mem_props_.HeapType) {
-        case HSA_HEAPTYPE_SYSTEM:
-        case HSA_HEAPTYPE_FRAME_BUFFER_PRIVATE:
-        case HSA_HEAPTYPE_FRAME_BUFFER_PUBLIC:
-          *((hsa_region_segment_t*)value) = HSA_REGION_SEGMENT_GLOBAL;
-          break;
-        case HSA_HEAPTYPE_GPU_LDS:
-          *((hsa_region_segment_t*)value) = HSA_REGION_SEGMENT_GROUP;
-          break;
-        default:
-          assert(false && "Memory region should only be global, group");
-          break;
-      }
+      assert((IsSystem() || IsLocalMemory() || IsLDS()) &&
+             "Memory region should only be global, group");
+      *((hsa_region_segment_t*)value) = info_.segment;
       break;
     case HSA_REGION_INFO_GLOBAL_FLAGS:
-      switch (mem_props_.HeapType) {
-        case HSA_HEAPTYPE_SYSTEM:
-          *((uint32_t*)value) = fine_grain()
-                                    ? (HSA_REGION_GLOBAL_FLAG_KERNARG |
-                                       HSA_REGION_GLOBAL_FLAG_FINE_GRAINED)
-                                    : HSA_REGION_GLOBAL_FLAG_COARSE_GRAINED;
-          break;
-        case HSA_HEAPTYPE_FRAME_BUFFER_PRIVATE:
-        case HSA_HEAPTYPE_FRAME_BUFFER_PUBLIC:
-          *((uint32_t*)value) = fine_grain() ? HSA_REGION_GLOBAL_FLAG_FINE_GRAINED
-                                             : HSA_REGION_GLOBAL_FLAG_COARSE_GRAINED;
-          break;
-        default:
-          *((uint32_t*)value) = 0;
-          break;
-      }
+      *((uint32_t*)value) = info_.global_flags;
       break;
     case HSA_REGION_INFO_SIZE:
       *((size_t*)value) = static_cast<size_t>(GetPhysicalSize());
       break;
     case HSA_REGION_INFO_ALLOC_MAX_SIZE:
-      switch (mem_props_.HeapType) {
-        case HSA_HEAPTYPE_FRAME_BUFFER_PRIVATE:
-        case HSA_HEAPTYPE_FRAME_BUFFER_PUBLIC:
-        case HSA_HEAPTYPE_SYSTEM:
-        case HSA_HEAPTYPE_GPU_SCRATCH:
-          *((size_t*)value) = max_single_alloc_size_;
-          break;
-        default:
-          *((size_t*)value) = 0;
-      }
+      *((size_t*)value) = info_.alloc_max_size;
       break;
     case HSA_REGION_INFO_RUNTIME_ALLOC_ALLOWED:
-      switch (mem_props_.HeapType) {
-        case HSA_HEAPTYPE_SYSTEM:
-        case HSA_HEAPTYPE_FRAME_BUFFER_PRIVATE:
-        case HSA_HEAPTYPE_FRAME_BUFFER_PUBLIC:
-          *((bool*)value) = true;
-          break;
-        default:
-          *((bool*)value) = false;
-          break;
-      }
+      *((bool*)value) = info_.alloc_allowed;
       break;
     case HSA_REGION_INFO_RUNTIME_ALLOC_GRANULE:
-      switch (mem_props_.HeapType) {
-        case HSA_HEAPTYPE_SYSTEM:
-        case HSA_HEAPTYPE_FRAME_BUFFER_PRIVATE:
-        case HSA_HEAPTYPE_FRAME_BUFFER_PUBLIC:
-          *((size_t*)value) = kPageSize_;
-          break;
-        default:
-          *((size_t*)value) = 0;
-          break;
-      }
+      *((size_t*)value) = info_.alloc_granule;
       break;
     case HSA_REGION_INFO_RUNTIME_ALLOC_ALIGNMENT:
-      switch (mem_props_.HeapType) {
-        case HSA_HEAPTYPE_SYSTEM:
-        case HSA_HEAPTYPE_FRAME_BUFFER_PRIVATE:
-        case HSA_HEAPTYPE_FRAME_BUFFER_PUBLIC:
-          *((size_t*)value) = kPageSize_;
-          break;
-        default:
-          *((size_t*)value) = 0;
-          break;
-      }
+      *((size_t*)value) = info_.alloc_alignment;
       break;
     default:
       switch ((hsa_amd_region_info_t)attribute) {
         case HSA_AMD_REGION_INFO_HOST_ACCESSIBLE:
-          *((bool*)value) =
-              (mem_props_.HeapType == HSA_HEAPTYPE_SYSTEM) ? true : false;
+          *((bool*)value) = IsSystem() || kernarg_;
           break;
         case HSA_AMD_REGION_INFO_BASE:
           *((void**)value) = reinterpret_cast<void*>(GetBaseAddress());
@@ -369,6 +728,15 @@ hsa_status_t MemoryRegion::GetPoolInfo(hsa_amd_memory_pool_info_t attribute,
     case HSA_AMD_MEMORY_POOL_INFO_ACCESSIBLE_BY_ALL:
       *((bool*)value) = IsSystem() ? true : false;
       break;
+    case HSA_AMD_MEMORY_POOL_INFO_HUGE_PAGE_SIZE:
+      *((size_t*)value) = (IsSystem() || IsLocalMemory()) ? kHugePageSize_ : 0;
+      break;
+    case HSA_AMD_MEMORY_POOL_INFO_STATS:
+      GetStats(reinterpret_cast<hsa_amd_memory_pool_stats_t*>(value));
+      break;
+    case HSA_AMD_MEMORY_POOL_INFO_TRACE:
+      GetTrace(reinterpret_cast<hsa_amd_memory_pool_trace_t*>(value));
+      break;
     default:
       return HSA_STATUS_ERROR_INVALID_ARGUMENT;
   }
@@ -384,6 +752,14 @@ hsa_amd_memory_pool_access_t MemoryRegion::GetAccessInfo(
     return HSA_AMD_MEMORY_POOL_ACCESS_ALLOWED_BY_DEFAULT;
   }
 
+  // Kernargs in VRAM are written by the host through the BAR mapping every allocation has, and
+  // only read by the owner.
+  if (kernarg_) {
+    return (agent.device_type() == core::Agent::kAmdCpuDevice)
+        ? HSA_AMD_MEMORY_POOL_ACCESS_ALLOWED_BY_DEFAULT
+        : HSA_AMD_MEMORY_POOL_ACCESS_NEVER_ALLOWED;
+  }
+
   // Requesting device does not have a link
   if (link_info.num_hop < 1) {
     return HSA_AMD_MEMORY_POOL_ACCESS_NEVER_ALLOWED;
@@ -471,95 +847,146 @@ hsa_status_t MemoryRegion::GetAgentPoolInfo(
   return HSA_STATUS_SUCCESS;
 }
 
+void MemoryRegion::GetPoolDesc(const core::Agent& agent, hsa_amd_memory_pool_desc_t* desc) const {
+  const core::Runtime::LinkInfo link_info =
+      core::Runtime::runtime_singleton_->GetLinkInfo(agent.node_id(), owner()->node_id());
+
+  memset(desc, 0, sizeof(hsa_amd_memory_pool_desc_t));
+  desc->memory_pool.handle = Convert(this).handle;
+  desc->segment = static_cast<hsa_amd_segment_t>(info_.segment);
+  desc->global_flags = info_.global_flags;
+  desc->size = static_cast<size_t>(GetPhysicalSize());
+  desc->alloc_max_size = info_.alloc_max_size;
+  desc->alloc_granule = info_.alloc_granule;
+  desc->alloc_alignment = info_.alloc_alignment;
+  desc->access = GetAccessInfo(agent, link_info);
+  desc->num_link_hops =
+      (desc->access != HSA_AMD_MEMORY_POOL_ACCESS_NEVER_ALLOWED) ? link_info.num_hop : 0;
+  desc->alloc_allowed = info_.alloc_allowed;
+  desc->accessible_by_all = IsSystem();
+}
+
 hsa_status_t MemoryRegion::AllowAccess(uint32_t num_agents,
                                        const hsa_agent_t* agents,
                                        const void* ptr, size_t size) const {
-  if (num_agents == 0 || agents == NULL || ptr == NULL || size == 0) {
+  return AllowAccess(num_agents, agents,
+                     std::vector<std::pair<const void*, size_t>>(1, std::make_pair(ptr, size)));
+}
+
+hsa_status_t MemoryRegion::AllowAccess(
+    uint32_t num_agents, const hsa_agent_t* agents,
+    const std::vector<std::pair<const void*, size_t>>& ranges) const {
+  if (num_agents == 0 || agents == NULL || ranges.empty()) {
     return HSA_STATUS_ERROR_INVALID_ARGUMENT;
   }
+  for (const auto& range : ranges) {
+    if (range.first == NULL || range.second == 0) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
 
   if (!IsSystem() && !IsLocalMemory()) {
     return HSA_STATUS_ERROR;
   }
 
-  // Adjust for fragments.  Make accessibility sticky for fragments since this will satisfy the
-  // union of accessible agents between the fragments in the block.
-  hsa_amd_pointer_info_t info;
-  uint32_t agent_count = 0;
-  hsa_agent_t* accessible = nullptr;
-  MAKE_SCOPE_GUARD([&]() { free(accessible); });
-  core::Runtime::PtrInfoBlockData blockInfo;
-  std::vector<uint64_t> union_agents;
-  info.size = sizeof(info);
-
-  ScopedAcquire<KernelMutex> lock(&access_lock_);
-  if (core::Runtime::runtime_singleton_->PtrInfo(const_cast<void*>(ptr), &info, malloc,
-                                                 &agent_count, &accessible,
-                                                 &blockInfo) == HSA_STATUS_SUCCESS) {
-    if (blockInfo.length != size || info.sizeInBytes != size) {
-      for (int i = 0; i < num_agents; i++) union_agents.push_back(agents[i].handle);
-      for (int i = 0; i < agent_count; i++) union_agents.push_back(accessible[i].handle);
-      std::sort(union_agents.begin(), union_agents.end());
-      const auto& last = std::unique(union_agents.begin(), union_agents.end());
-      union_agents.erase(last, union_agents.end());
-
-      agents = reinterpret_cast<hsa_agent_t*>(&union_agents[0]);
-      num_agents = union_agents.size();
-      size = blockInfo.length;
-      ptr = blockInfo.base;
-    }
-  }
-
-  bool cpu_in_list = false;
-
-  std::set<GpuAgentInt*> whitelist_gpus;
-  std::vector<uint32_t> whitelist_nodes;
   for (uint32_t i = 0; i < num_agents; ++i) {
     core::Agent* agent = core::Agent::Convert(agents[i]);
     if (agent == NULL || !agent->IsValid()) {
       return HSA_STATUS_ERROR_INVALID_AGENT;
     }
-
-    if (agent->device_type() == core::Agent::kAmdGpuDevice) {
-      whitelist_nodes.push_back(agent->node_id());
-      whitelist_gpus.insert(reinterpret_cast<GpuAgentInt*>(agent));
-    } else {
-      cpu_in_list = true;
-    }
   }
 
-  if (whitelist_nodes.size() == 0 && IsSystem()) {
-    assert(cpu_in_list);
-    // This is a system region and only CPU agents in the whitelist.
-    // Remove old mappings.
-    amd::MemoryRegion::MakeKfdMemoryUnresident(ptr);
-    return HSA_STATUS_SUCCESS;
+  // Blocks mapped to other agents may not be reused.
+  if (IsLocalMemory()) {
+    ScopedAcquire<KernelMutex> cache_lock(&block_cache_lock_);
+    for (const auto& range : ranges) cacheable_blocks_.erase(range.first);
   }
 
-  // If this is a local memory region, the owning gpu always needs to be in
-  // the whitelist.
-  if (IsLocalMemory() &&
-      std::find(whitelist_nodes.begin(), whitelist_nodes.end(), owner()->node_id()) ==
-          whitelist_nodes.end()) {
-    whitelist_nodes.push_back(owner()->node_id());
-    whitelist_gpus.insert(reinterpret_cast<GpuAgentInt*>(owner()));
+  ScopedAcquire<KernelMutex> lock(&access_lock_);
+
+  // Adjust for fragments.  Make accessibility sticky for fragments since this will satisfy the
+  // union of accessible agents between the fragments in the block.  Fragments of one block in
+  // the batch share its mapping.
+  struct Mapping {
+    size_t size;
+    std::vector<uint64_t> agents;
+  };
+  std::map<const void*, Mapping> mappings;
+  for (const auto& range : ranges) {
+    const void* ptr = range.first;
+    size_t size = range.second;
+
+    // Explicit access control ends lazy mapping.
+    if (IsSystem()) lazy_allocations_.erase(ptr);
+
+    hsa_amd_pointer_info_t info;
+    uint32_t agent_count = 0;
+    hsa_agent_t* accessible = nullptr;
+    MAKE_SCOPE_GUARD([&]() { free(accessible); });
+    core::Runtime::PtrInfoBlockData blockInfo;
+    info.size = sizeof(info);
+
+    std::vector<uint64_t> union_agents;
+    for (uint32_t i = 0; i < num_agents; i++) union_agents.push_back(agents[i].handle);
+    if (core::Runtime::runtime_singleton_->PtrInfo(const_cast<void*>(ptr), &info, malloc,
+                                                   &agent_count, &accessible,
+                                                   &blockInfo) == HSA_STATUS_SUCCESS) {
+      if (blockInfo.length != size || info.sizeInBytes != size) {
+        for (uint32_t i = 0; i < agent_count; i++) union_agents.push_back(accessible[i].handle);
+        size = blockInfo.length;
+        ptr = blockInfo.base;
+      }
+    }
+
+    Mapping& mapping = mappings[ptr];
+    mapping.size = size;
+    mapping.agents.insert(mapping.agents.end(), union_agents.begin(), union_agents.end());
   }
 
-  HsaMemMapFlags map_flag = map_flag_;
-  map_flag.ui32.HostAccess |= (cpu_in_list) ? 1 : 0;
+  ScopedAcquire<KernelMutex> memory_lock(&core::Runtime::runtime_singleton_->memory_lock_);
+  for (auto& entry : mappings) {
+    const void* ptr = entry.first;
+    Mapping& mapping = entry.second;
+    std::sort(mapping.agents.begin(), mapping.agents.end());
+    mapping.agents.erase(std::unique(mapping.agents.begin(), mapping.agents.end()),
+                         mapping.agents.end());
+
+    bool cpu_in_list = false;
+    std::vector<uint32_t> whitelist_nodes;
+    for (uint64_t handle : mapping.agents) {
+      const hsa_agent_t handle_agent = {handle};
+      core::Agent* agent = core::Agent::Convert(handle_agent);
+      if (agent->device_type() == core::Agent::kAmdGpuDevice) {
+        whitelist_nodes.push_back(agent->node_id());
+      } else {
+        cpu_in_list = true;
+      }
+    }
+
+    if (whitelist_nodes.size() == 0 && IsSystem()) {
+      assert(cpu_in_list);
+      // This is a system region and only CPU agents in the whitelist.
+      // Remove old mappings.
+      amd::MemoryRegion::MakeKfdMemoryUnresident(ptr);
+      continue;
+    }
+
+    // If this is a local memory region, the owning gpu always needs to be in
+    // the whitelist.
+    if (IsLocalMemory() &&
+        std::find(whitelist_nodes.begin(), whitelist_nodes.end(), owner()->node_id()) ==
+            whitelist_nodes.end()) {
+      whitelist_nodes.push_back(owner()->node_id());
+    }
+
+    HsaMemMapFlags map_flag = map_flag_;
+    map_flag.ui32.HostAccess |= (cpu_in_list) ? 1 : 0;
 
-  {
-    ScopedAcquire<KernelMutex> lock(&core::Runtime::runtime_singleton_->memory_lock_);
     uint64_t alternate_va = 0;
-    if (!amd::MemoryRegion::MakeKfdMemoryResident(
-      whitelist_nodes.size(), &whitelist_nodes[0], ptr,
-      size, &alternate_va, map_flag)) {
-        return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+    if (!amd::MemoryRegion::MakeKfdMemoryResident(whitelist_nodes.size(), &whitelist_nodes[0],
+                                                  ptr, mapping.size, &alternate_va, map_flag)) {
+      return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
     }
   }
 
-  lock.Release();
-
   return HSA_STATUS_SUCCESS;
 }
 
@@ -577,7 +1004,7 @@ hsa_status_t MemoryRegion::Migrate(uint32_t flag, const void* ptr) const {
 
 hsa_status_t MemoryRegion::Lock(uint32_t num_agents, const hsa_agent_t* agents,
                                 void* host_ptr, size_t size,
-                                void** agent_ptr) const {
+                                void** agent_ptr, bool cached) const {
   if (!IsSystem()) {
     return HSA_STATUS_ERROR;
   }
@@ -618,6 +1045,12 @@ hsa_status_t MemoryRegion::Lock(uint32_t num_agents, const hsa_agent_t* agents,
     return HSA_STATUS_SUCCESS;
   }
 
+  core::PinCache& pin_cache = core::Runtime::runtime_singleton_->pin_cache();
+  if (cached && pin_cache.enabled()) {
+    hsa_status_t status;
+    if (pin_cache.Lock(*this, whitelist_nodes, host_ptr, size, agent_ptr, status)) return status;
+  }
+
   // Call kernel driver to register and pin the memory.
   if (RegisterMemory(host_ptr, size, mem_flag_)) {
     uint64_t alternate_va = 0;
@@ -629,6 +1062,7 @@ hsa_status_t MemoryRegion::Lock(uint32_t num_agents, const hsa_agent_t* agents,
         *agent_ptr = host_ptr;
       }
 
+      core::Runtime::runtime_singleton_->RegisterPtrOwner(host_ptr, size, owner());
       return HSA_STATUS_SUCCESS;
     }
     amd::MemoryRegion::DeregisterMemory(host_ptr);
@@ -638,7 +1072,7 @@ hsa_status_t MemoryRegion::Lock(uint32_t num_agents, const hsa_agent_t* agents,
   return HSA_STATUS_ERROR;
 }
 
-hsa_status_t MemoryRegion::Unlock(void* host_ptr) const {
+hsa_status_t MemoryRegion::Unlock(void* host_ptr, bool cached) const {
   if (!IsSystem()) {
     return HSA_STATUS_ERROR;
   }
@@ -647,12 +1081,38 @@ hsa_status_t MemoryRegion::Unlock(void* host_ptr) const {
     return HSA_STATUS_SUCCESS;
   }
 
+  if (cached && core::Runtime::runtime_singleton_->pin_cache().Unlock(host_ptr)) {
+    return HSA_STATUS_SUCCESS;
+  }
+
+  core::Runtime::runtime_singleton_->DeregisterPtrOwner(host_ptr);
   MakeKfdMemoryUnresident(host_ptr);
   DeregisterMemory(host_ptr);
 
   return HSA_STATUS_SUCCESS;
 }
 
+hsa_status_t MemoryRegion::MapOnFirstUse(const void* ptr, size_t size, const core::Agent& agent,
+                                         bool& lazy) const {
+  ScopedAcquire<KernelMutex> lock(&access_lock_);
+  auto it = lazy_allocations_.find(ptr);
+  lazy = (it != lazy_allocations_.end());
+  if (!lazy) return HSA_STATUS_SUCCESS;
+
+  std::vector<uint32_t>& nodes = it->second;
+  if (std::find(nodes.begin(), nodes.end(), agent.node_id()) != nodes.end())
+    return HSA_STATUS_SUCCESS;
+
+  nodes.push_back(agent.node_id());
+  ScopedAcquire<KernelMutex> memory_lock(&core::Runtime::runtime_singleton_->memory_lock_);
+  uint64_t alternate_va = 0;
+  if (!MakeKfdMemoryResident(nodes.size(), &nodes[0], ptr, size, &alternate_va, map_flag_)) {
+    nodes.pop_back();
+    return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+  }
+  return HSA_STATUS_SUCCESS;
+}
+
 hsa_status_t MemoryRegion::AssignAgent(void* ptr, size_t size,
                                        const core::Agent& agent,
                                        hsa_access_permission_t access) const {
@@ -664,13 +1124,17 @@ void* MemoryRegion::BlockAllocator::alloc(size_t request_size, size_t& allocated
 
   void* ret;
   size_t bsize = block_size();
-  hsa_status_t err = region_.Allocate(
-      bsize, core::MemoryRegion::AllocateRestrict | core::MemoryRegion::AllocateDirect, &ret);
+  hsa_status_t err = region_.Allocate(bsize,
+                                     core::MemoryRegion::AllocateRestrict |
+                                         core::MemoryRegion::AllocateDirect |
+                                         core::MemoryRegion::AllocateHugePage,
+                                     &ret);
   if (err != HSA_STATUS_SUCCESS)
     throw ::AMD::hsa_exception(err, "MemoryRegion::BlockAllocator::alloc failed.");
   assert(ret != nullptr && "Region returned nullptr on success.");
 
   allocated_size = block_size();
+  region_.TrackFragmentBlock(ret, true);
   return ret;
 }
 
@@ -0,0 +1,205 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "core/inc/amd_queue_pool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "core/inc/amd_gpu_agent.h"
+
+namespace amd {
+
+int PooledQueue::rtti_id_ = 0;
+
+PooledQueue::PooledQueue(QueuePool* pool, QueuePool::Slot* slot, core::Queue* hw_queue,
+                         core::HsaEventCallback event_callback, void* data)
+    : Queue(),
+      pool_(pool),
+      slot_(slot),
+      hw_queue_(hw_queue),
+      event_callback_(event_callback),
+      event_data_(data),
+      active_(true) {
+  memcpy(&amd_queue_, &hw_queue_->amd_queue_, sizeof(amd_queue_t));
+}
+
+PooledQueue::~PooledQueue() { pool_->Release(this); }
+
+hsa_status_t PooledQueue::Inactivate() {
+  ScopedAcquire<KernelMutex> lock(&pool_->lock_);
+  active_ = false;
+  return HSA_STATUS_SUCCESS;
+}
+
+QueuePool::QueuePool(GpuAgent* agent, uint32_t max_hw_queues, Policy policy)
+    : agent_(agent), max_hw_queues_(Max(1U, max_hw_queues)), policy_(policy), next_(0) {}
+
+QueuePool::~QueuePool() { slots_.clear(); }
+
+hsa_status_t QueuePool::QueueCreate(size_t size, core::HsaEventCallback event_callback,
+                                    void* data, uint32_t private_segment_size,
+                                    uint32_t group_segment_size, core::Queue** queue) {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+
+  // Retire failed hardware queues nobody uses, their error may have come with no client attached.
+  slots_.erase(std::remove_if(slots_.begin(), slots_.end(),
+                              [](const std::unique_ptr<Slot>& candidate) {
+                                return candidate->failed && candidate->clients.empty();
+                              }),
+               slots_.end());
+
+  // Prefer recycling an unused hardware queue.
+  Slot* slot = nullptr;
+  Slot* small_idle = nullptr;
+  for (auto& candidate : slots_) {
+    if (candidate->failed || !candidate->clients.empty()) continue;
+    if (candidate->size >= size) {
+      slot = candidate.get();
+      break;
+    }
+    small_idle = candidate.get();
+  }
+
+  if (slot == nullptr) {
+    const bool full = (slots_.size() >= max_hw_queues_);
+    if (full && small_idle == nullptr) {
+      slot = Select(size);
+      if (slot == nullptr) return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+    } else {
+      // Create a hardware queue, replacing an unused one which is too small when full.
+      if (full) {
+        for (auto it = slots_.begin(); it != slots_.end(); ++it) {
+          if (it->get() == small_idle) {
+            slots_.erase(it);
+            break;
+          }
+        }
+      }
+
+      std::unique_ptr<Slot> new_slot(new Slot());
+      new_slot->size = 0;
+      new_slot->failed = false;
+      new_slot->pool = this;
+      core::Queue* hw_queue = nullptr;
+      hsa_status_t err =
+          agent_->CreateAqlQueue(size, ErrorHandler, new_slot.get(), private_segment_size,
+                                 group_segment_size, &hw_queue);
+      if (err != HSA_STATUS_SUCCESS) return err;
+      new_slot->queue.reset(hw_queue);
+      new_slot->size = hw_queue->amd_queue_.hsa_queue.size;
+      slot = new_slot.get();
+      slots_.push_back(std::move(new_slot));
+    }
+  }
+
+  PooledQueue* client =
+      new PooledQueue(this, slot, slot->queue.get(), event_callback, data);
+  slot->clients.push_back(client);
+  *queue = client;
+  return HSA_STATUS_SUCCESS;
+}
+
+QueuePool::Slot* QueuePool::Select(size_t size) {
+  std::vector<Slot*> fits;
+  for (auto& slot : slots_) {
+    if (!slot->failed && slot->size >= size) fits.push_back(slot.get());
+  }
+  if (fits.empty()) return nullptr;
+
+  if (policy_ == PolicyRoundRobin) return fits[next_++ % fits.size()];
+
+  // Fewest outstanding packets, then fewest logical queues.
+  Slot* best = nullptr;
+  uint64_t best_load = 0;
+  for (Slot* slot : fits) {
+    const uint64_t load =
+        slot->queue->LoadWriteIndexRelaxed() - slot->queue->LoadReadIndexRelaxed();
+    if (best == nullptr || load < best_load ||
+        (load == best_load && slot->clients.size() < best->clients.size())) {
+      best = slot;
+      best_load = load;
+    }
+  }
+  return best;
+}
+
+void QueuePool::Release(PooledQueue* client) {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  Slot* slot = client->slot_;
+  auto& clients = slot->clients;
+  clients.erase(std::remove(clients.begin(), clients.end(), client), clients.end());
+
+  if (slot->failed && clients.empty()) {
+    for (auto it = slots_.begin(); it != slots_.end(); ++it) {
+      if (it->get() == slot) {
+        slots_.erase(it);
+        break;
+      }
+    }
+  }
+}
+
+void QueuePool::ErrorHandler(hsa_status_t status, hsa_queue_t* source, void* data) {
+  Slot* slot = reinterpret_cast<Slot*>(data);
+  QueuePool* pool = slot->pool;
+
+  struct Report {
+    core::HsaEventCallback callback;
+    void* data;
+    hsa_queue_t* queue;
+  };
+  std::vector<Report> reports;
+  {
+    ScopedAcquire<KernelMutex> lock(&pool->lock_);
+    slot->failed = true;
+    for (PooledQueue* client : slot->clients) {
+      if (client->active_ && client->event_callback_ != nullptr)
+        reports.push_back({client->event_callback_, client->event_data_, client->public_handle()});
+    }
+  }
+
+  for (auto& report : reports) report.callback(status, report.queue, report.data);
+}
+
+}  // namespace amd
@@ -0,0 +1,200 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "core/inc/amd_queue_scheduler.h"
+
+#include "core/inc/amd_aql_queue.h"
+#include "core/inc/interrupt_signal.h"
+#include "core/inc/runtime.h"
+
+namespace amd {
+
+QueueScheduler::QueueScheduler(uint32_t cu_count)
+    : cu_count_(Max(1U, cu_count)),
+      protecting_(false),
+      dirty_(false),
+      idle_samples_(0),
+      exit_(false),
+      thread_(nullptr) {
+  full_mask_.assign((cu_count_ + 31) / 32, 0);
+  for (uint32_t cu = 0; cu < cu_count_; cu++) full_mask_[cu / 32] |= 1U << (cu % 32);
+  batch_mask_ = full_mask_;
+}
+
+QueueScheduler::~QueueScheduler() {
+  if (thread_ == nullptr) return;
+  exit_ = true;
+  wake_->StoreRelease(1);
+  os::WaitForThread(thread_);
+  os::CloseThread(thread_);
+}
+
+hsa_status_t QueueScheduler::SetClass(AqlQueue* queue, hsa_amd_queue_class_t queue_class,
+                                      uint32_t weight) {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+
+  auto it = entries_.begin();
+  while ((it != entries_.end()) && (it->queue != queue)) it++;
+
+  if (queue_class == HSA_AMD_QUEUE_CLASS_DEFAULT) {
+    if (it == entries_.end()) return HSA_STATUS_SUCCESS;
+    if (protecting_) {
+      queue->SetPriority(HSA_QUEUE_PRIORITY_NORMAL);
+      SetCUMask(queue, full_mask_);
+    }
+    entries_.erase(it);
+    queue->scheduled_ = false;
+    dirty_ = true;
+    return HSA_STATUS_SUCCESS;
+  }
+
+  if (thread_ == nullptr) {
+    wake_.reset(new core::InterruptSignal(0));
+    thread_ = os::CreateThread(ThreadLoop, this);
+    if (thread_ == nullptr) return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+  }
+
+  const Entry entry = {queue, queue_class, Max(1U, weight)};
+  if (it == entries_.end()) {
+    entries_.push_back(entry);
+    queue->scheduled_ = true;
+  } else {
+    *it = entry;
+  }
+  dirty_ = true;
+
+  wake_->StoreRelease(1);
+  return HSA_STATUS_SUCCESS;
+}
+
+void QueueScheduler::Remove(AqlQueue* queue) {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  for (size_t i = 0; i < entries_.size(); i++) {
+    if (entries_[i].queue == queue) {
+      entries_[i] = entries_.back();
+      entries_.pop_back();
+      dirty_ = true;
+      return;
+    }
+  }
+}
+
+void QueueScheduler::SetCUMask(AqlQueue* queue, const std::vector<uint32_t>& mask) {
+  queue->SetCUMasking(uint32_t(mask.size() * 32), &mask[0]);
+}
+
+void QueueScheduler::Apply(const Entry& entry) {
+  if (!protecting_) {
+    entry.queue->SetPriority(HSA_QUEUE_PRIORITY_NORMAL);
+    SetCUMask(entry.queue, full_mask_);
+  } else if (entry.queue_class == HSA_AMD_QUEUE_CLASS_LATENCY) {
+    entry.queue->SetPriority(HSA_QUEUE_PRIORITY_MAXIMUM);
+    SetCUMask(entry.queue, full_mask_);
+  } else {
+    entry.queue->SetPriority(HSA_QUEUE_PRIORITY_MINIMUM);
+    SetCUMask(entry.queue, batch_mask_);
+  }
+}
+
+void QueueScheduler::Sample() {
+  uint64_t latency_weight = 0;
+  uint64_t batch_weight = 0;
+  bool backlog = false;
+
+  for (const Entry& entry : entries_) {
+    hsa_amd_queue_progress_stats_t stats;
+    entry.queue->GetProgressStats(&stats, core::Queue::kProgressScheduler);
+    if (entry.queue_class == HSA_AMD_QUEUE_CLASS_LATENCY) {
+      latency_weight += entry.weight;
+      backlog |= (stats.depth != 0);
+    } else {
+      batch_weight += entry.weight;
+    }
+  }
+
+  idle_samples_ = backlog ? 0 : idle_samples_ + 1;
+  const bool protect = backlog || (protecting_ && (idle_samples_ < kIdleSamples));
+  if ((protect == protecting_) && !dirty_) return;
+
+  // Batch queues keep the upper CUs in proportion to their weight.
+  if (protect && (batch_weight != 0)) {
+    const uint32_t batch_cus =
+        Max(1U, uint32_t(cu_count_ * batch_weight / (batch_weight + latency_weight)));
+    batch_mask_.assign(full_mask_.size(), 0);
+    for (uint32_t cu = cu_count_ - batch_cus; cu < cu_count_; cu++)
+      batch_mask_[cu / 32] |= 1U << (cu % 32);
+  }
+
+  // Reprogram every queue on a transition or after the set of queues changed.
+  protecting_ = protect;
+  dirty_ = false;
+  for (const Entry& entry : entries_) Apply(entry);
+}
+
+void QueueScheduler::ThreadLoop(void* arg) {
+  QueueScheduler* scheduler = reinterpret_cast<QueueScheduler*>(arg);
+  const uint32_t interval = Max(1U, core::Runtime::runtime_singleton_->flag().queue_sched_interval());
+  core::ThreadPolicies::ThreadState policy_state;
+
+  while (!scheduler->exit_) {
+    core::Runtime::runtime_singleton_->thread_policies().Apply(
+        core::ThreadPolicies::kQueueScheduler, policy_state);
+
+    bool idle;
+    {
+      ScopedAcquire<KernelMutex> lock(&scheduler->lock_);
+      idle = scheduler->entries_.empty();
+      if (!idle) scheduler->Sample();
+    }
+
+    // Sleep until a queue is classified when there is nothing to watch.
+    if (idle) {
+      scheduler->wake_->WaitRelaxed(HSA_SIGNAL_CONDITION_NE, 0, uint64_t(-1),
+                                    HSA_WAIT_STATE_BLOCKED);
+      scheduler->wake_->StoreRelaxed(0);
+      continue;
+    }
+    os::uSleep(interval);
+  }
+}
+
+}  // namespace amd
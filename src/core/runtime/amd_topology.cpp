@@ -44,6 +44,7 @@
 
 #include <algorithm>
 #include <cstring>
+#include <exception>
 #include <vector>
 #include <map>
 #include <string>
@@ -59,6 +60,7 @@
 #include "core/inc/amd_cpu_agent.h"
 #include "core/inc/amd_gpu_agent.h"
 #include "core/inc/amd_memory_region.h"
+#include "core/util/os.h"
 #include "core/util/utils.h"
 
 namespace amd {
@@ -229,6 +231,24 @@ void RegisterLinkInfo(uint32_t node_id, uint32_t num_link) {
   }
 }
 
+/// @brief Per node state of a Gpu constructed on a discovery thread.
+struct GpuDiscovery {
+  HSAuint32 node_id;
+  HsaNodeProperties node_prop;
+  GpuAgent* gpu;
+  os::Thread thread;
+  std::exception_ptr error;
+};
+
+static void DiscoverGpuThread(void* arg) {
+  GpuDiscovery* job = reinterpret_cast<GpuDiscovery*>(arg);
+  try {
+    job->gpu = new GpuAgent(job->node_id, job->node_prop);
+  } catch (...) {
+    job->error = std::current_exception();
+  }
+}
+
 /**
  * Process the list of Gpus that are surfaced to user
  */
@@ -236,20 +256,52 @@ static void SurfaceGpuList(std::vector<int32_t>& gpu_list) {
   // Process user visible Gpu devices
   int32_t invalidIdx = -1;
   int32_t list_sz = gpu_list.size();
-  HsaNodeProperties node_prop = {0};
+  std::vector<GpuDiscovery> jobs;
+  jobs.reserve(list_sz);
   for (int32_t idx = 0; idx < list_sz; idx++) {
     if (gpu_list[idx] == invalidIdx) {
       break;
     }
 
     // Obtain properties of the node
-    HSAKMT_STATUS err_val = hsaKmtGetNodeProperties(gpu_list[idx], &node_prop);
+    GpuDiscovery job = {HSAuint32(gpu_list[idx]), {0}, nullptr, nullptr, nullptr};
+    HSAKMT_STATUS err_val = hsaKmtGetNodeProperties(job.node_id, &job.node_prop);
     assert(err_val == HSAKMT_STATUS_SUCCESS && "Error in getting Node Properties");
+    assert((job.node_prop.NumFComputeCores != 0) && "GPU device failed discovery.");
+    if (job.node_prop.NumFComputeCores != 0) jobs.push_back(job);
+  }
+
+  // Agent construction queries the thunk for memory banks, caches and clocks
+  // of each node. Overlap it across nodes, then register the agents in list
+  // order so that agent enumeration does not depend on thread timing.
+  // Fall back to constructing in place if a thread can not be created.
+  const bool parallel =
+      (jobs.size() > 1) && core::Runtime::runtime_singleton_->flag().parallel_discovery();
+  if (parallel) {
+    for (auto& job : jobs) job.thread = os::CreateThread(DiscoverGpuThread, &job);
+  }
+
+  // Join every thread before reporting a failure, the jobs live on this stack.
+  for (auto& job : jobs) {
+    if (job.thread != nullptr) {
+      os::WaitForThread(job.thread);
+      os::CloseThread(job.thread);
+    } else {
+      DiscoverGpuThread(&job);
+    }
+  }
+
+  for (auto& job : jobs) {
+    if (job.error) {
+      for (auto& other : jobs) delete other.gpu;
+      std::rethrow_exception(job.error);
+    }
+  }
 
-    // Instantiate a Gpu device. The IO links
+  for (auto& job : jobs) {
+    // Register the Gpu device. The IO links
     // of this node have already been registered
-    const GpuAgent* gpu = DiscoverGpu(gpu_list[idx], node_prop);
-    assert((node_prop.NumFComputeCores != 0) && (gpu != nullptr) && "GPU device failed discovery.");
+    core::Runtime::runtime_singleton_->RegisterAgent(job.gpu);
   }
 }
 
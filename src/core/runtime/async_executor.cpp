@@ -0,0 +1,196 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "core/inc/async_executor.h"
+
+#include "core/inc/runtime.h"
+
+namespace core {
+
+// Idle workers recheck for exit at this interval in case a wakeup is lost to a racing submit.
+static const uint32_t kIdleSliceMs = 100;
+
+bool AsyncExecutor::Start(uint32_t user_workers) {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  if (started_.load(std::memory_order_relaxed)) return true;
+  exit_ = false;
+
+  for (uint32_t i = 0; i < user_workers + 1; i++) {
+    std::unique_ptr<Worker> worker(new Worker());
+    worker->executor = this;
+    worker->reserved = (i == 0);
+    worker->thread = os::CreateThread(WorkerLoop, worker.get());
+    if (worker->thread == NULL) break;
+    workers_.push_back(std::move(worker));
+  }
+
+  if (workers_.size() != user_workers + 1) {
+    exit_ = true;
+    lock.Release();
+    for (auto& worker : workers_) {
+      os::WaitForThread(worker->thread);
+      os::CloseThread(worker->thread);
+    }
+    workers_.clear();
+    return false;
+  }
+
+  started_.store(true, std::memory_order_release);
+  return true;
+}
+
+void AsyncExecutor::Submit(Lane lane, std::function<void()> run, std::function<void()> cancel) {
+  {
+    ScopedAcquire<KernelMutex> lock(&lock_);
+    if (started_.load(std::memory_order_relaxed) && !exit_) {
+      Job job;
+      job.run = std::move(run);
+      job.cancel = std::move(cancel);
+      lanes_[lane].push_back(std::move(job));
+      // User workers also take runtime jobs, so one is woken in case the runtime worker is busy.
+      if (lane == kRuntimeLane) runtime_seq_++;
+      user_seq_++;
+      lock.Release();
+      if (lane == kRuntimeLane) os::WakeOneOnAddress(&runtime_seq_);
+      os::WakeOneOnAddress(&user_seq_);
+      return;
+    }
+  }
+  if (cancel) cancel();
+}
+
+void AsyncExecutor::Shutdown() {
+  std::deque<Job> cancelled;
+  {
+    ScopedAcquire<KernelMutex> lock(&lock_);
+    if (!started_.load(std::memory_order_relaxed)) return;
+    exit_ = true;
+    runtime_seq_++;
+    user_seq_++;
+  }
+  os::WakeAllOnAddress(&runtime_seq_);
+  os::WakeAllOnAddress(&user_seq_);
+
+  for (auto& worker : workers_) {
+    os::WaitForThread(worker->thread);
+    os::CloseThread(worker->thread);
+  }
+  workers_.clear();
+
+  {
+    ScopedAcquire<KernelMutex> lock(&lock_);
+    for (auto& lane : lanes_) {
+      for (auto& job : lane) cancelled.push_back(std::move(job));
+      lane.clear();
+    }
+    started_.store(false, std::memory_order_release);
+  }
+
+  for (auto& job : cancelled)
+    if (job.cancel) job.cancel();
+}
+
+void AsyncExecutor::DrainUserLane() {
+  std::deque<Job> cancelled;
+  uint32_t running;
+  {
+    ScopedAcquire<KernelMutex> lock(&lock_);
+    cancelled.swap(lanes_[kUserLane]);
+    running = user_running_;
+  }
+
+  for (auto& job : cancelled)
+    if (job.cancel) job.cancel();
+
+  while (running != 0) {
+    os::WaitOnAddress(&user_running_, running, kIdleSliceMs);
+    ScopedAcquire<KernelMutex> lock(&lock_);
+    running = user_running_;
+  }
+}
+
+void AsyncExecutor::WorkerLoop(void* arg) {
+  Worker* worker = reinterpret_cast<Worker*>(arg);
+  AsyncExecutor* executor = worker->executor;
+  volatile uint32_t* seq = worker->reserved ? &executor->runtime_seq_ : &executor->user_seq_;
+  ThreadPolicies::ThreadState policy_state;
+
+  while (true) {
+    Runtime::runtime_singleton_->thread_policies().Apply(ThreadPolicies::kAsyncHandlers,
+                                                         policy_state);
+
+    Job job;
+    bool user = false;
+    uint32_t observed;
+    {
+      ScopedAcquire<KernelMutex> lock(&executor->lock_);
+      if (executor->exit_) return;
+
+      // Runtime jobs first, user workers take user jobs only when there are none.
+      std::deque<Job>& runtime_lane = executor->lanes_[kRuntimeLane];
+      std::deque<Job>& user_lane = executor->lanes_[kUserLane];
+      if (!runtime_lane.empty()) {
+        job = std::move(runtime_lane.front());
+        runtime_lane.pop_front();
+      } else if (!worker->reserved && !user_lane.empty()) {
+        job = std::move(user_lane.front());
+        user_lane.pop_front();
+        user = true;
+        executor->user_running_++;
+      }
+      observed = *seq;
+    }
+
+    if (job.run) {
+      job.run();
+      if (user) {
+        ScopedAcquire<KernelMutex> lock(&executor->lock_);
+        if (--executor->user_running_ == 0) os::WakeAllOnAddress(&executor->user_running_);
+      }
+      continue;
+    }
+
+    os::WaitOnAddress(seq, observed, kIdleSliceMs);
+  }
+}
+
+}  // namespace core
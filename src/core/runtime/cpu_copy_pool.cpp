@@ -0,0 +1,402 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "core/inc/cpu_copy_pool.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "core/inc/amd_cpu_agent.h"
+#include "core/inc/default_signal.h"
+#include "core/inc/interrupt_signal.h"
+#include "core/inc/runtime.h"
+#include "core/util/stream_copy.h"
+
+namespace core {
+
+bool CpuCopyPool::Start() {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  if (started_) return !workers_.empty();
+
+  const uint32_t threads_per_node =
+      Max(1U, Runtime::runtime_singleton_->flag().cpu_copy_threads());
+
+  for (Agent* agent : Runtime::runtime_singleton_->cpu_agents()) {
+    const amd::CpuAgent* cpu = static_cast<const amd::CpuAgent*>(agent);
+    std::unique_ptr<Node> node(new Node());
+    node->agent = agent;
+    node->next = 0;
+
+    for (uint32_t i = 0; i < threads_per_node; i++) {
+      std::unique_ptr<Worker> worker(new Worker());
+      worker->first_cpu = cpu->first_cpu_id();
+      worker->num_cpus = cpu->num_cpus();
+      worker->exit = false;
+      worker->cancel_request = 0;
+      worker->cancel_done = 0;
+      worker->wake.reset(new InterruptSignal(0));
+      worker->thread = os::CreateThread(WorkerLoop, worker.get());
+      if (worker->thread == nullptr) break;
+      node->workers.push_back(worker.get());
+      workers_.push_back(std::move(worker));
+    }
+
+    if (!node->workers.empty()) nodes_.push_back(std::move(node));
+  }
+
+  started_ = true;
+  return !workers_.empty();
+}
+
+void CpuCopyPool::Shutdown() {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+
+  for (auto& worker : workers_) {
+    worker->exit = true;
+    worker->wake->StoreRelease(1);
+  }
+  for (auto& worker : workers_) {
+    os::WaitForThread(worker->thread);
+    os::CloseThread(worker->thread);
+    for (const Task& task : worker->incoming) Drop(task);
+    worker->incoming.clear();
+  }
+
+  nodes_.clear();
+  workers_.clear();
+  started_ = false;
+}
+
+hsa_status_t CpuCopyPool::Submit(void* dst, const Agent& dst_agent, const void* src, size_t size,
+                                 const std::vector<Signal*>& dep_signals,
+                                 Signal& completion_signal, bool profiling_enabled) {
+  const hsa_amd_memory_copy_desc_t copy = {dst, src, size};
+  return SubmitBatch(std::vector<hsa_amd_memory_copy_desc_t>(1, copy), dst_agent, dep_signals,
+                     completion_signal, profiling_enabled);
+}
+
+hsa_status_t CpuCopyPool::CopySync(void* dst, const Agent& dst_agent, const void* src,
+                                   size_t size) {
+  if (size < kSplitThreshold) {
+    stream::HostCopy(dst, src, size);
+    return HSA_STATUS_SUCCESS;
+  }
+
+  unique_signal_ptr done(new DefaultSignal(1));
+  hsa_status_t err = Submit(dst, dst_agent, src, size, std::vector<Signal*>(), *done, false);
+  if (err != HSA_STATUS_SUCCESS) {
+    stream::HostCopy(dst, src, size);
+    return HSA_STATUS_SUCCESS;
+  }
+  done->WaitRelaxed(HSA_SIGNAL_CONDITION_EQ, 0, uint64_t(-1), HSA_WAIT_STATE_BLOCKED);
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t CpuCopyPool::SubmitBatch(const std::vector<hsa_amd_memory_copy_desc_t>& copies,
+                                      const Agent& dst_agent,
+                                      const std::vector<Signal*>& dep_signals,
+                                      Signal& completion_signal, bool profiling_enabled) {
+  return Enqueue(copies, 0, dst_agent, dep_signals, completion_signal, profiling_enabled);
+}
+
+hsa_status_t CpuCopyPool::SubmitFill(const std::vector<FillRange>& ranges, uint32_t value,
+                                     const Agent& dst_agent,
+                                     const std::vector<Signal*>& dep_signals,
+                                     Signal& completion_signal, bool profiling_enabled) {
+  std::vector<hsa_amd_memory_copy_desc_t> fills;
+  fills.reserve(ranges.size());
+  for (const FillRange& range : ranges) {
+    const hsa_amd_memory_copy_desc_t fill = {range.ptr, nullptr, range.size};
+    fills.push_back(fill);
+  }
+  return Enqueue(fills, value, dst_agent, dep_signals, completion_signal, profiling_enabled);
+}
+
+hsa_status_t CpuCopyPool::Enqueue(const std::vector<hsa_amd_memory_copy_desc_t>& copies,
+                                  uint32_t value, const Agent& dst_agent,
+                                  const std::vector<Signal*>& dep_signals,
+                                  Signal& completion_signal, bool profiling_enabled) {
+  if (!started_.load(std::memory_order_acquire) && !Start())
+    return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+  if (nodes_.empty()) return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+
+  // Prefer the workers of the node owning the destination.
+  Node* node = NodeOf(dst_agent);
+
+  const uint32_t num_workers = uint32_t(node->workers.size());
+
+  std::shared_ptr<Copy> copy(new Copy());
+  copy->dep_signals = dep_signals;
+  copy->completion_signal = &completion_signal;
+  copy->profiling_enabled = profiling_enabled;
+  copy->user = false;
+  copy->started = false;
+  copy->failed = false;
+
+  // Split large copies and deal all parts round robin before publishing any of them.
+  std::vector<std::vector<Task>> assigned(num_workers);
+  uint32_t next = node->next.load(std::memory_order_relaxed);
+  uint32_t total_parts = 0;
+  for (const hsa_amd_memory_copy_desc_t& range : copies) {
+    uint32_t parts = 1;
+    if (range.size >= kSplitThreshold)
+      parts = uint32_t(Min(size_t(num_workers), range.size / kMinPartSize));
+
+    const size_t part_size = AlignUp(range.size / parts, 4096);
+    size_t offset = 0;
+    for (uint32_t i = 0; i < parts; i++) {
+      Task task;
+      task.dst = reinterpret_cast<uint8_t*>(range.dst) + offset;
+      task.src = (range.src == nullptr) ? nullptr
+                                        : reinterpret_cast<const uint8_t*>(range.src) + offset;
+      task.value = value;
+      task.size = (i == parts - 1) ? (range.size - offset) : part_size;
+      task.copy = copy;
+      offset += task.size;
+      assigned[next++ % num_workers].push_back(task);
+    }
+    total_parts += parts;
+  }
+  copy->parts = total_parts;
+  node->next.fetch_add(total_parts);
+
+  for (uint32_t i = 0; i < num_workers; i++) {
+    if (assigned[i].empty()) continue;
+    Worker* worker = node->workers[i];
+    {
+      ScopedAcquire<KernelMutex> lock(&worker->lock);
+      worker->incoming.insert(worker->incoming.end(), assigned[i].begin(), assigned[i].end());
+    }
+    worker->wake->StoreRelease(1);
+  }
+
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t CpuCopyPool::SubmitTask(std::function<bool()> task, const Agent& agent,
+                                     const std::vector<Signal*>& dep_signals,
+                                     Signal& completion_signal, bool user) {
+  if (!started_.load(std::memory_order_acquire) && !Start())
+    return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+  if (nodes_.empty()) return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+
+  Node* node = NodeOf(agent);
+
+  std::shared_ptr<Copy> copy(new Copy());
+  copy->dep_signals = dep_signals;
+  copy->completion_signal = &completion_signal;
+  copy->job = std::move(task);
+  copy->profiling_enabled = false;
+  copy->user = user;
+  copy->started = false;
+  copy->failed = false;
+  copy->parts = 1;
+
+  Task job;
+  job.dst = nullptr;
+  job.src = nullptr;
+  job.size = 0;
+  job.value = 0;
+  job.copy = copy;
+
+  Worker* worker = node->workers[node->next.fetch_add(1) % node->workers.size()];
+  {
+    ScopedAcquire<KernelMutex> lock(&worker->lock);
+    worker->incoming.push_back(job);
+  }
+  worker->wake->StoreRelease(1);
+  return HSA_STATUS_SUCCESS;
+}
+
+void CpuCopyPool::CancelUserTasks() {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+
+  for (auto& worker : workers_) {
+    {
+      ScopedAcquire<KernelMutex> worker_lock(&worker->lock);
+      worker->cancel_request++;
+    }
+    worker->wake->StoreRelease(1);
+  }
+
+  // A worker acknowledges between tasks, so a running user task has returned by then.
+  for (auto& worker : workers_) {
+    while (true) {
+      uint32_t done;
+      uint32_t request;
+      {
+        ScopedAcquire<KernelMutex> worker_lock(&worker->lock);
+        done = worker->cancel_done;
+        request = worker->cancel_request;
+      }
+      if (done == request) break;
+      os::WaitOnAddress(&worker->cancel_done, done, 10);
+    }
+  }
+}
+
+CpuCopyPool::Node* CpuCopyPool::NodeOf(const Agent& agent) {
+  for (auto& candidate : nodes_) {
+    if (candidate->agent == &agent) return candidate.get();
+  }
+  return nodes_[0].get();
+}
+
+void CpuCopyPool::Run(const Task& task) {
+  Copy& copy = *task.copy;
+
+  if (copy.profiling_enabled && !copy.started.exchange(true)) {
+    Runtime::runtime_singleton_->GetSystemInfo(HSA_SYSTEM_INFO_TIMESTAMP,
+                                               &copy.completion_signal->signal_.start_ts);
+  }
+
+  // Host tasks are a single part.
+  if (copy.job) {
+    if (!copy.job()) copy.failed = true;
+  } else if (task.src != nullptr) {
+    stream::HostCopy(task.dst, task.src, task.size);
+  } else {
+    stream::HostFill(task.dst, task.value, task.size / sizeof(uint32_t));
+  }
+
+  Finish(task);
+}
+
+void CpuCopyPool::Drop(const Task& task) {
+  task.copy->failed = true;
+  Finish(task);
+}
+
+void CpuCopyPool::Finish(const Task& task) {
+  Copy& copy = *task.copy;
+  if (copy.parts.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+  if (copy.profiling_enabled) {
+    Runtime::runtime_singleton_->GetSystemInfo(HSA_SYSTEM_INFO_TIMESTAMP,
+                                               &copy.completion_signal->signal_.end_ts);
+  }
+
+  if (copy.failed)
+    copy.completion_signal->FailRelease();
+  else
+    copy.completion_signal->CompleteRelease();
+}
+
+void CpuCopyPool::WorkerLoop(void* arg) {
+  Worker* worker = reinterpret_cast<Worker*>(arg);
+  if (worker->num_cpus != 0) os::SetThreadAffinity(worker->first_cpu, worker->num_cpus);
+  ThreadPolicies::ThreadState policy_state;
+
+  std::vector<Task> pending;
+  std::vector<hsa_signal_t> signals;
+  std::vector<hsa_signal_condition_t> conds;
+  std::vector<hsa_signal_value_t> values;
+
+  while (!worker->exit) {
+    Runtime::runtime_singleton_->thread_policies().Apply(ThreadPolicies::kCpuCopy,
+                                                         policy_state);
+
+    uint32_t cancel;
+    {
+      ScopedAcquire<KernelMutex> lock(&worker->lock);
+      pending.insert(pending.end(), worker->incoming.begin(), worker->incoming.end());
+      worker->incoming.clear();
+      cancel = worker->cancel_request;
+    }
+
+    if (cancel != worker->cancel_done) {
+      size_t index = 0;
+      while (index < pending.size()) {
+        if (!pending[index].copy->user) {
+          index++;
+          continue;
+        }
+        Drop(pending[index]);
+        pending[index] = std::move(pending.back());
+        pending.pop_back();
+      }
+      {
+        ScopedAcquire<KernelMutex> lock(&worker->lock);
+        worker->cancel_done = cancel;
+      }
+      os::WakeAllOnAddress(&worker->cancel_done);
+    }
+
+    // Control signal first, then the first unsatisfied dependency of each waiting copy.
+    signals.assign(1, Signal::Convert(worker->wake.get()));
+    conds.assign(1, HSA_SIGNAL_CONDITION_NE);
+    values.assign(1, 0);
+
+    size_t index = 0;
+    while (index < pending.size()) {
+      Signal* blocker = nullptr;
+      for (Signal* dep : pending[index].copy->dep_signals) {
+        if (dep->IsValid() && (dep->LoadRelaxed() != 0)) {
+          blocker = dep;
+          break;
+        }
+      }
+
+      if (blocker != nullptr) {
+        signals.push_back(Signal::Convert(blocker));
+        conds.push_back(HSA_SIGNAL_CONDITION_EQ);
+        values.push_back(0);
+        index++;
+        continue;
+      }
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      Run(pending[index]);
+      pending[index] = std::move(pending.back());
+      pending.pop_back();
+    }
+
+    if (Signal::WaitAny(uint32_t(signals.size()), &signals[0], &conds[0], &values[0],
+                        uint64_t(-1), HSA_WAIT_STATE_BLOCKED, nullptr) == 0)
+      worker->wake->StoreRelaxed(0);
+  }
+
+  // Copies left when the pool stops will not run.
+  for (const Task& task : pending) Drop(task);
+}
+
+}  // namespace core
@@ -41,6 +41,7 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "core/inc/default_signal.h"
+#include "core/inc/runtime.h"
 #include "core/util/timer.h"
 
 namespace core {
@@ -48,10 +49,16 @@ namespace core {
 int DefaultSignal::rtti_id_ = 0;
 int BusyWaitSignal::rtti_id_ = 0;
 
+// Sleep slices of IPC signal waits, bounding how late a GPU update is seen.
+static const uint32_t kMinIpcSleepUs = 20;
+static const uint32_t kMaxIpcSleepUs = 1000;
+
 BusyWaitSignal::BusyWaitSignal(SharedSignal* abi_block, bool enableIPC)
-    : Signal(abi_block, enableIPC) {
+    : Signal(abi_block, enableIPC), ipc_block_(enableIPC ? abi_block : nullptr) {
   signal_.kind = AMD_SIGNAL_KIND_USER;
   signal_.event_mailbox_ptr = NULL;
+  // IPC handles are resolved through the IPC registry, keep them on the checked path.
+  abi_block->plain_ops = !enableIPC;
 }
 
 hsa_signal_value_t BusyWaitSignal::LoadRelaxed() {
@@ -66,10 +73,12 @@ hsa_signal_value_t BusyWaitSignal::LoadAcquire() {
 
 void BusyWaitSignal::StoreRelaxed(hsa_signal_value_t value) {
   atomic::Store(&signal_.value, int64_t(value), std::memory_order_relaxed);
+  Notify();
 }
 
 void BusyWaitSignal::StoreRelease(hsa_signal_value_t value) {
   atomic::Store(&signal_.value, int64_t(value), std::memory_order_release);
+  Notify();
 }
 
 hsa_signal_value_t BusyWaitSignal::WaitRelaxed(hsa_signal_condition_t condition,
@@ -89,12 +98,20 @@ hsa_signal_value_t BusyWaitSignal::WaitRelaxed(hsa_signal_condition_t condition,
   timer::fast_clock::time_point start_time, time;
   start_time = timer::fast_clock::now();
 
-  uint64_t hsa_freq;
-  HSA::hsa_system_get_info(HSA_SYSTEM_INFO_TIMESTAMP_FREQUENCY, &hsa_freq);
+  const uint64_t hsa_freq = Runtime::runtime_singleton_->sys_clock_freq();
   const timer::fast_clock::duration fast_timeout =
       timer::duration_from_seconds<timer::fast_clock::duration>(
           double(timeout) / double(hsa_freq));
 
+  // Poll only as long as waits on this signal usually take, then fall back to
+  // short sleeps.
+  const timer::fast_clock::duration spin =
+      (wait_hint == HSA_WAIT_STATE_ACTIVE) ? fast_timeout : wait_policy_.Spin();
+
+  uint32_t sleeps = 0;
+  timer::fast_clock::duration sleep_time(0);
+  uint32_t ipc_sleep_us = kMinIpcSleepUs;
+  SpinBackoff backoff;
   while (true) {
     if (!IsValid()) return 0;
 
@@ -120,17 +137,51 @@ hsa_signal_value_t BusyWaitSignal::WaitRelaxed(hsa_signal_condition_t condition,
       default:
         return 0;
     }
-    if (condition_met) return hsa_signal_value_t(value);
+    if (condition_met) {
+      wait_policy_.Record(true, timer::fast_clock::now() - start_time, sleeps, sleep_time);
+      return hsa_signal_value_t(value);
+    }
 
     time = timer::fast_clock::now();
     if (time - start_time > fast_timeout) {
+      wait_policy_.Record(false, time - start_time, sleeps, sleep_time);
       value = atomic::Load(&signal_.value, std::memory_order_relaxed);
       return hsa_signal_value_t(value);
     }
-    os::uSleep(20);
+
+    if (time - start_time < spin) {
+      backoff.Pause();
+      continue;
+    }
+
+    if (ipc_block_ != nullptr) {
+      // Host updates from any process wake the sleep, GPU updates are seen at the end of the
+      // slice, which grows while the wait goes on.
+      const uint64_t remaining_us = uint64_t(
+          std::chrono::duration_cast<std::chrono::microseconds>(fast_timeout - (time - start_time))
+              .count());
+      SleepIpc(value, uint32_t(Max(Min(uint64_t(ipc_sleep_us), remaining_us), uint64_t(1))));
+      ipc_sleep_us = Min(ipc_sleep_us * 2, kMaxIpcSleepUs);
+    } else {
+      os::uSleep(20);
+    }
+    sleep_time += timer::fast_clock::now() - time;
+    sleeps++;
   }
 }
 
+void BusyWaitSignal::SleepIpc(int64_t value, uint32_t timeout_us) {
+  atomic::Increment(&ipc_block_->ipc_waiters, std::memory_order_seq_cst);
+  MAKE_SCOPE_GUARD([&]() { atomic::Decrement(&ipc_block_->ipc_waiters); });
+
+  const uint32_t seq = atomic::Load(&ipc_block_->ipc_wake_seq, std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (atomic::Load(&signal_.value, std::memory_order_relaxed) != value) return;
+
+  if (!os::WaitOnSharedAddressUs(&ipc_block_->ipc_wake_seq, seq, timeout_us))
+    os::uSleep(int(timeout_us));
+}
+
 hsa_signal_value_t BusyWaitSignal::WaitAcquire(hsa_signal_condition_t condition,
                                                hsa_signal_value_t compare_value, uint64_t timeout,
                                                hsa_wait_state_t wait_hint) {
@@ -142,130 +193,162 @@ hsa_signal_value_t BusyWaitSignal::WaitAcquire(hsa_signal_condition_t condition,
 
 void BusyWaitSignal::AndRelaxed(hsa_signal_value_t value) {
   atomic::And(&signal_.value, int64_t(value), std::memory_order_relaxed);
+  Notify();
 }
 
 void BusyWaitSignal::AndAcquire(hsa_signal_value_t value) {
   atomic::And(&signal_.value, int64_t(value), std::memory_order_acquire);
+  Notify();
 }
 
 void BusyWaitSignal::AndRelease(hsa_signal_value_t value) {
   atomic::And(&signal_.value, int64_t(value), std::memory_order_release);
+  Notify();
 }
 
 void BusyWaitSignal::AndAcqRel(hsa_signal_value_t value) {
   atomic::And(&signal_.value, int64_t(value), std::memory_order_acq_rel);
+  Notify();
 }
 
 void BusyWaitSignal::OrRelaxed(hsa_signal_value_t value) {
   atomic::Or(&signal_.value, int64_t(value), std::memory_order_relaxed);
+  Notify();
 }
 
 void BusyWaitSignal::OrAcquire(hsa_signal_value_t value) {
   atomic::Or(&signal_.value, int64_t(value), std::memory_order_acquire);
+  Notify();
 }
 
 void BusyWaitSignal::OrRelease(hsa_signal_value_t value) {
   atomic::Or(&signal_.value, int64_t(value), std::memory_order_release);
+  Notify();
 }
 
 void BusyWaitSignal::OrAcqRel(hsa_signal_value_t value) {
   atomic::Or(&signal_.value, int64_t(value), std::memory_order_acq_rel);
+  Notify();
 }
 
 void BusyWaitSignal::XorRelaxed(hsa_signal_value_t value) {
   atomic::Xor(&signal_.value, int64_t(value), std::memory_order_relaxed);
+  Notify();
 }
 
 void BusyWaitSignal::XorAcquire(hsa_signal_value_t value) {
   atomic::Xor(&signal_.value, int64_t(value), std::memory_order_acquire);
+  Notify();
 }
 
 void BusyWaitSignal::XorRelease(hsa_signal_value_t value) {
   atomic::Xor(&signal_.value, int64_t(value), std::memory_order_release);
+  Notify();
 }
 
 void BusyWaitSignal::XorAcqRel(hsa_signal_value_t value) {
   atomic::Xor(&signal_.value, int64_t(value), std::memory_order_acq_rel);
+  Notify();
 }
 
 void BusyWaitSignal::AddRelaxed(hsa_signal_value_t value) {
   atomic::Add(&signal_.value, int64_t(value), std::memory_order_relaxed);
+  Notify();
 }
 
 void BusyWaitSignal::AddAcquire(hsa_signal_value_t value) {
   atomic::Add(&signal_.value, int64_t(value), std::memory_order_acquire);
+  Notify();
 }
 
 void BusyWaitSignal::AddRelease(hsa_signal_value_t value) {
   atomic::Add(&signal_.value, int64_t(value), std::memory_order_release);
+  Notify();
 }
 
 void BusyWaitSignal::AddAcqRel(hsa_signal_value_t value) {
   atomic::Add(&signal_.value, int64_t(value), std::memory_order_acq_rel);
+  Notify();
 }
 
 void BusyWaitSignal::SubRelaxed(hsa_signal_value_t value) {
   atomic::Sub(&signal_.value, int64_t(value), std::memory_order_relaxed);
+  Notify();
 }
 
 void BusyWaitSignal::SubAcquire(hsa_signal_value_t value) {
   atomic::Sub(&signal_.value, int64_t(value), std::memory_order_acquire);
+  Notify();
 }
 
 void BusyWaitSignal::SubRelease(hsa_signal_value_t value) {
   atomic::Sub(&signal_.value, int64_t(value), std::memory_order_release);
+  Notify();
 }
 
 void BusyWaitSignal::SubAcqRel(hsa_signal_value_t value) {
   atomic::Sub(&signal_.value, int64_t(value), std::memory_order_acq_rel);
+  Notify();
 }
 
 hsa_signal_value_t BusyWaitSignal::ExchRelaxed(hsa_signal_value_t value) {
-  return hsa_signal_value_t(atomic::Exchange(&signal_.value, int64_t(value),
-                                             std::memory_order_relaxed));
+  const hsa_signal_value_t ret = hsa_signal_value_t(
+      atomic::Exchange(&signal_.value, int64_t(value), std::memory_order_relaxed));
+  Notify();
+  return ret;
 }
 
 hsa_signal_value_t BusyWaitSignal::ExchAcquire(hsa_signal_value_t value) {
-  return hsa_signal_value_t(atomic::Exchange(&signal_.value, int64_t(value),
-                                             std::memory_order_acquire));
+  const hsa_signal_value_t ret = hsa_signal_value_t(
+      atomic::Exchange(&signal_.value, int64_t(value), std::memory_order_acquire));
+  Notify();
+  return ret;
 }
 
 hsa_signal_value_t BusyWaitSignal::ExchRelease(hsa_signal_value_t value) {
-  return hsa_signal_value_t(atomic::Exchange(&signal_.value, int64_t(value),
-                                             std::memory_order_release));
+  const hsa_signal_value_t ret = hsa_signal_value_t(
+      atomic::Exchange(&signal_.value, int64_t(value), std::memory_order_release));
+  Notify();
+  return ret;
 }
 
 hsa_signal_value_t BusyWaitSignal::ExchAcqRel(hsa_signal_value_t value) {
-  return hsa_signal_value_t(atomic::Exchange(&signal_.value, int64_t(value),
-                                             std::memory_order_acq_rel));
+  const hsa_signal_value_t ret = hsa_signal_value_t(
+      atomic::Exchange(&signal_.value, int64_t(value), std::memory_order_acq_rel));
+  Notify();
+  return ret;
 }
 
 hsa_signal_value_t BusyWaitSignal::CasRelaxed(hsa_signal_value_t expected,
                                               hsa_signal_value_t value) {
-  return hsa_signal_value_t(atomic::Cas(&signal_.value, int64_t(value),
-                                        int64_t(expected),
-                                        std::memory_order_relaxed));
+  const hsa_signal_value_t ret = hsa_signal_value_t(
+      atomic::Cas(&signal_.value, int64_t(value), int64_t(expected), std::memory_order_relaxed));
+  Notify();
+  return ret;
 }
 
 hsa_signal_value_t BusyWaitSignal::CasAcquire(hsa_signal_value_t expected,
                                               hsa_signal_value_t value) {
-  return hsa_signal_value_t(atomic::Cas(&signal_.value, int64_t(value),
-                                        int64_t(expected),
-                                        std::memory_order_acquire));
+  const hsa_signal_value_t ret = hsa_signal_value_t(
+      atomic::Cas(&signal_.value, int64_t(value), int64_t(expected), std::memory_order_acquire));
+  Notify();
+  return ret;
 }
 
 hsa_signal_value_t BusyWaitSignal::CasRelease(hsa_signal_value_t expected,
                                               hsa_signal_value_t value) {
-  return hsa_signal_value_t(atomic::Cas(&signal_.value, int64_t(value),
-                                        int64_t(expected),
-                                        std::memory_order_release));
+  const hsa_signal_value_t ret = hsa_signal_value_t(
+      atomic::Cas(&signal_.value, int64_t(value), int64_t(expected), std::memory_order_release));
+  Notify();
+  return ret;
 }
 
 hsa_signal_value_t BusyWaitSignal::CasAcqRel(hsa_signal_value_t expected,
                                              hsa_signal_value_t value) {
-  return hsa_signal_value_t(atomic::Cas(&signal_.value, int64_t(value),
-                                        int64_t(expected),
-                                        std::memory_order_acq_rel));
+  const hsa_signal_value_t ret = hsa_signal_value_t(
+      atomic::Cas(&signal_.value, int64_t(value), int64_t(expected), std::memory_order_acq_rel));
+  Notify();
+  return ret;
 }
 
 }  // namespace core
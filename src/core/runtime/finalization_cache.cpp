@@ -0,0 +1,344 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "core/inc/finalization_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+#include "core/inc/isa.h"
+#include "inc/Brig.h"
+
+namespace core {
+
+namespace {
+// Bump when the entry layout or the key inputs change.
+const uint64_t kCacheFormatVersion = 2;
+
+const char kEntryMagic[8] = {'H', 'S', 'A', 'F', 'C', 'A', 'C', 'H'};
+const char kEntrySuffix[] = ".hsaco";
+
+struct EntryHeader {
+  char magic[8];
+  uint64_t h1;
+  uint64_t h2;
+  uint64_t length;
+  uint64_t size;
+};
+
+// Two independent 64 bit lanes plus the input length, wide enough that
+// distinct programs in one cache directory do not collide in practice.
+class KeyHasher {
+ public:
+  KeyHasher() : h1_(0xcbf29ce484222325ULL), h2_(0x9e3779b97f4a7c15ULL), length_(0) {}
+
+  void Add(const void* data, size_t size) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    length_ += size;
+    while (size >= sizeof(uint64_t)) {
+      uint64_t word;
+      memcpy(&word, bytes, sizeof(word));
+      Mix(word);
+      bytes += sizeof(word);
+      size -= sizeof(word);
+    }
+    if (size != 0) {
+      uint64_t word = 0;
+      memcpy(&word, bytes, size);
+      Mix(word);
+    }
+  }
+
+  template <typename T> void Add(const T& value) { Add(&value, sizeof(value)); }
+
+  void Add(const std::string& value) {
+    Add(uint64_t(value.size()));
+    Add(value.data(), value.size());
+  }
+
+  uint64_t h1() const { return h1_; }
+  uint64_t h2() const { return h2_ ^ length_; }
+  uint64_t length() const { return length_; }
+
+ private:
+  void Mix(uint64_t word) {
+    h1_ = (h1_ ^ word) * 0x100000001b3ULL;
+    h2_ += word * 0xc2b2ae3d27d4eb4fULL;
+    h2_ = ((h2_ << 31) | (h2_ >> 33)) * 0x9e3779b97f4a7c15ULL;
+  }
+
+  uint64_t h1_;
+  uint64_t h2_;
+  uint64_t length_;
+};
+
+hsa_status_t AllocImage(size_t size, hsa_callback_data_t data, void** address) {
+  *address = malloc(size);
+  return (*address != NULL) ? HSA_STATUS_SUCCESS : HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+}
+}  // namespace
+
+FinalizationCache::FinalizationCache(const std::string& dir, size_t max_size,
+                                     const std::string& finalizer)
+    : dir_(dir), max_size_(max_size), finalizer_(finalizer) {
+#ifdef __linux__
+  mkdir(dir_.c_str(), 0777);
+#endif
+}
+
+hsa_status_t FinalizationCache::Finalize(const FinalizerExtTable& api, hsa_ext_program_t program,
+                                         hsa_isa_t isa, int32_t call_convention,
+                                         hsa_ext_control_directives_t control_directives,
+                                         const char* options,
+                                         hsa_code_object_type_t code_object_type,
+                                         hsa_code_object_t* code_object) {
+  Key key;
+  if (code_object == NULL ||
+      !MakeKey(api, program, isa, call_convention, control_directives, options, code_object_type,
+               key)) {
+    return api.hsa_ext_program_finalize_fn(program, isa, call_convention, control_directives,
+                                           options, code_object_type, code_object);
+  }
+
+  std::vector<char> image;
+  if (Lookup(key, image) &&
+      HSA::hsa_code_object_deserialize(&image[0], image.size(), NULL, code_object) ==
+          HSA_STATUS_SUCCESS) {
+    return HSA_STATUS_SUCCESS;
+  }
+
+  hsa_status_t status = api.hsa_ext_program_finalize_fn(
+      program, isa, call_convention, control_directives, options, code_object_type, code_object);
+  if (status != HSA_STATUS_SUCCESS) return status;
+
+  void* data = NULL;
+  size_t size = 0;
+  hsa_callback_data_t callback_data = {0};
+  if (HSA::hsa_code_object_serialize(*code_object, AllocImage, callback_data, NULL, &data,
+                                     &size) == HSA_STATUS_SUCCESS) {
+    Store(key, data, size);
+    free(data);
+  }
+  return HSA_STATUS_SUCCESS;
+}
+
+bool FinalizationCache::MakeKey(const FinalizerExtTable& api, hsa_ext_program_t program,
+                                hsa_isa_t isa, int32_t call_convention,
+                                const hsa_ext_control_directives_t& control_directives,
+                                const char* options, hsa_code_object_type_t code_object_type,
+                                Key& key) const {
+  const Isa* isa_object = Isa::Object(isa);
+  if (isa_object == NULL) return false;
+
+  hsa_machine_model_t machine_model;
+  hsa_profile_t profile;
+  hsa_default_float_rounding_mode_t rounding_mode;
+  if (api.hsa_ext_program_get_info_fn(program, HSA_EXT_PROGRAM_INFO_MACHINE_MODEL,
+                                      &machine_model) != HSA_STATUS_SUCCESS ||
+      api.hsa_ext_program_get_info_fn(program, HSA_EXT_PROGRAM_INFO_PROFILE, &profile) !=
+          HSA_STATUS_SUCCESS ||
+      api.hsa_ext_program_get_info_fn(program, HSA_EXT_PROGRAM_INFO_DEFAULT_FLOAT_ROUNDING_MODE,
+                                      &rounding_mode) != HSA_STATUS_SUCCESS) {
+    return false;
+  }
+
+  KeyHasher hasher;
+  hasher.Add(kCacheFormatVersion);
+  hasher.Add(finalizer_);
+  hasher.Add(machine_model);
+  hasher.Add(profile);
+  hasher.Add(rounding_mode);
+  hasher.Add(isa_object->GetFullName());
+  hasher.Add(call_convention);
+  hasher.Add(control_directives);
+  hasher.Add(std::string((options != NULL) ? options : ""));
+  hasher.Add(code_object_type);
+
+  // Modules are hashed in the order they were added, which is also the
+  // order the finalizer links them in.
+  hsa_status_t status = api.hsa_ext_program_iterate_modules_fn(
+      program,
+      [](hsa_ext_program_t, hsa_ext_module_t module, void* data) -> hsa_status_t {
+        if (module == NULL) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+        reinterpret_cast<KeyHasher*>(data)->Add(module, size_t(module->byteCount));
+        return HSA_STATUS_SUCCESS;
+      },
+      &hasher);
+  if (status != HSA_STATUS_SUCCESS) return false;
+
+  key.h1 = hasher.h1();
+  key.h2 = hasher.h2();
+  key.length = hasher.length();
+  return true;
+}
+
+std::string FinalizationCache::EntryPath(const Key& key) const {
+  char name[40];
+  snprintf(name, sizeof(name), "%016llx%016llx", (unsigned long long)key.h1,
+           (unsigned long long)key.h2);
+  return dir_ + "/" + name + kEntrySuffix;
+}
+
+bool FinalizationCache::Lookup(const Key& key, std::vector<char>& image) const {
+#ifdef __linux__
+  std::string path = EntryPath(key);
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+
+  EntryHeader header;
+  struct stat info;
+  bool valid = fstat(fd, &info) == 0 &&
+      read(fd, &header, sizeof(header)) == ssize_t(sizeof(header)) &&
+      memcmp(header.magic, kEntryMagic, sizeof(kEntryMagic)) == 0 && header.h1 == key.h1 &&
+      header.h2 == key.h2 && header.length == key.length && header.size != 0 &&
+      uint64_t(info.st_size) == sizeof(header) + header.size;
+  if (valid) {
+    image.resize(header.size);
+    size_t done = 0;
+    while (valid && done < image.size()) {
+      ssize_t ret = read(fd, &image[done], image.size() - done);
+      if (ret <= 0) valid = false;
+      else done += ret;
+    }
+  }
+  close(fd);
+
+  // The modification time orders entries for trimming.
+  if (valid) utime(path.c_str(), NULL);
+  return valid;
+#else
+  return false;
+#endif
+}
+
+void FinalizationCache::Store(const Key& key, const void* image, size_t size) {
+#ifdef __linux__
+  EntryHeader header;
+  memcpy(header.magic, kEntryMagic, sizeof(kEntryMagic));
+  header.h1 = key.h1;
+  header.h2 = key.h2;
+  header.length = key.length;
+  header.size = size;
+
+  // Readers only ever open complete entries: write under a name unique to
+  // this process and call, then rename over the final name.
+  static std::atomic<uint32_t> serial(0);
+  std::string path = EntryPath(key);
+  char suffix[64];
+  snprintf(suffix, sizeof(suffix), ".tmp.%d.%u", int(getpid()), unsigned(serial++));
+  std::string temp = path + suffix;
+
+  int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (fd < 0) return;
+
+  bool ok = write(fd, &header, sizeof(header)) == ssize_t(sizeof(header));
+  const char* bytes = reinterpret_cast<const char*>(image);
+  size_t done = 0;
+  while (ok && done < size) {
+    ssize_t ret = write(fd, bytes + done, size - done);
+    if (ret <= 0) ok = false;
+    else done += ret;
+  }
+  if (close(fd) != 0) ok = false;
+
+  if (!ok || rename(temp.c_str(), path.c_str()) != 0) {
+    unlink(temp.c_str());
+    return;
+  }
+  Trim();
+#endif
+}
+
+void FinalizationCache::Trim() {
+#ifdef __linux__
+  DIR* dir = opendir(dir_.c_str());
+  if (dir == NULL) return;
+
+  struct Entry {
+    time_t mtime;
+    off_t size;
+    std::string path;
+  };
+  std::vector<Entry> entries;
+  uint64_t total = 0;
+  const size_t suffix_len = sizeof(kEntrySuffix) - 1;
+
+  while (dirent* ent = readdir(dir)) {
+    size_t len = strlen(ent->d_name);
+    if (len <= suffix_len || strcmp(ent->d_name + len - suffix_len, kEntrySuffix) != 0) continue;
+    Entry entry;
+    entry.path = dir_ + "/" + ent->d_name;
+    struct stat info;
+    if (stat(entry.path.c_str(), &info) != 0) continue;
+    entry.mtime = info.st_mtime;
+    entry.size = info.st_size;
+    total += info.st_size;
+    entries.push_back(entry);
+  }
+  closedir(dir);
+
+  if (total <= max_size_) return;
+
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b) { return a.mtime < b.mtime; });
+  // Another process may be trimming concurrently, a failed unlink just means
+  // the entry is already gone.
+  for (size_t i = 0; i < entries.size() && total > max_size_; i++) {
+    unlink(entries[i].path.c_str());
+    total -= entries[i].size;
+  }
+#endif
+}
+
+}  // namespace core
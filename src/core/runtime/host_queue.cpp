@@ -51,15 +51,17 @@ int HostQueue::rtti_id_ = 0;
 std::atomic<uint32_t> HostQueue::queue_count_(0x80000000);
 
 HostQueue::HostQueue(hsa_region_t region, uint32_t ring_size, hsa_queue_type32_t type,
-                     uint32_t features, hsa_signal_t doorbell_signal)
-    : Queue(), size_(ring_size) {
+                     uint32_t features, hsa_signal_t doorbell_signal, bool own_doorbell)
+    : Queue(), size_(ring_size), own_doorbell_(own_doorbell), processor_(nullptr), worker_(0) {
   HSA::hsa_memory_register(this, sizeof(HostQueue));
   MAKE_NAMED_SCOPE_GUARD(registerGuard,
                          [&]() { HSA::hsa_memory_deregister(this, sizeof(HostQueue)); });
 
   const size_t queue_buffer_size = size_ * sizeof(AqlPacket);
   if (HSA_STATUS_SUCCESS !=
-      HSA::hsa_memory_allocate(region, queue_buffer_size, &ring_)) {
+      core::Runtime::runtime_singleton_->AllocateMemory(core::MemoryRegion::Convert(region),
+                                                        queue_buffer_size,
+                                                        core::MemoryRegion::AllocateNoFlags, &ring_)) {
     throw AMD::hsa_exception(HSA_STATUS_ERROR_OUT_OF_RESOURCES, "Host queue buffer alloc failed\n");
   }
   MAKE_NAMED_SCOPE_GUARD(bufferGuard, [&]() { HSA::hsa_memory_free(&ring_); });
@@ -95,6 +97,8 @@ HostQueue::HostQueue(hsa_region_t region, uint32_t ring_size, hsa_queue_type32_t
 }
 
 HostQueue::~HostQueue() {
+  if (processor_ != nullptr) processor_->Detach(this);
+  if (own_doorbell_) Signal::Convert(amd_queue_.hsa_queue.doorbell_signal)->DestroySignal();
   HSA::hsa_memory_free(ring_);
   HSA::hsa_memory_deregister(this, sizeof(HostQueue));
 }
@@ -0,0 +1,273 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "core/inc/host_queue_processor.h"
+
+#include "core/inc/host_queue.h"
+#include "core/inc/interrupt_signal.h"
+#include "core/inc/runtime.h"
+
+namespace core {
+
+bool HostQueueProcessor::Start() {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  if (started_) return !workers_.empty();
+
+  const uint32_t threads = Max(1U, Runtime::runtime_singleton_->flag().host_queue_threads());
+  for (uint32_t i = 0; i < threads; i++) {
+    std::unique_ptr<Worker> worker(new Worker());
+    worker->exit = false;
+    worker->running = nullptr;
+    worker->calls_done = 0;
+    worker->wake.reset(new InterruptSignal(0));
+    worker->thread = os::CreateThread(WorkerLoop, worker.get());
+    if (worker->thread == nullptr) break;
+    workers_.push_back(std::move(worker));
+  }
+
+  started_ = true;
+  return !workers_.empty();
+}
+
+void HostQueueProcessor::Shutdown() {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+
+  for (auto& worker : workers_) {
+    worker->exit = true;
+    worker->wake->StoreRelease(1);
+  }
+  for (auto& worker : workers_) {
+    os::WaitForThread(worker->thread);
+    os::CloseThread(worker->thread);
+    for (Entry& entry : worker->entries) entry.queue->processor_ = nullptr;
+  }
+
+  workers_.clear();
+  started_ = false;
+}
+
+hsa_status_t HostQueueProcessor::Attach(HostQueue* queue, HsaEventCallback callback, void* data) {
+  if (!started_.load(std::memory_order_acquire) && !Start())
+    return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+  if (workers_.empty()) return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+
+  const uint32_t index = next_.fetch_add(1) % uint32_t(workers_.size());
+  Worker* worker = workers_[index].get();
+  const Entry entry = {queue, callback, data, nullptr, nullptr, false};
+  {
+    ScopedAcquire<KernelMutex> lock(&worker->lock);
+    queue->processor_ = this;
+    queue->worker_ = index;
+    worker->entries.push_back(entry);
+  }
+  worker->wake->StoreRelease(1);
+  return HSA_STATUS_SUCCESS;
+}
+
+void HostQueueProcessor::Detach(HostQueue* queue) {
+  Worker* worker = workers_[queue->worker_].get();
+  {
+    ScopedAcquire<KernelMutex> lock(&worker->lock);
+    while (worker->running == queue) {
+      const uint32_t done = worker->calls_done;
+      worker->lock.Release();
+      os::WaitOnAddress(&worker->calls_done, done, 100);
+      worker->lock.Acquire();
+    }
+    Entry* entry = Find(worker, queue);
+    if (entry != nullptr) {
+      *entry = worker->entries.back();
+      worker->entries.pop_back();
+    }
+    queue->processor_ = nullptr;
+  }
+  // Have the worker drop its reference to the queue's doorbell.
+  worker->wake->StoreRelease(1);
+}
+
+void HostQueueProcessor::SetAgentDispatchHandler(HostQueue* queue,
+                                                 hsa_amd_agent_dispatch_handler handler,
+                                                 void* data) {
+  Worker* worker = workers_[queue->worker_].get();
+  {
+    ScopedAcquire<KernelMutex> lock(&worker->lock);
+    Entry* entry = Find(worker, queue);
+    if (entry == nullptr) return;
+    entry->handler = handler;
+    entry->handler_data = data;
+  }
+  // Packets waiting for a handler may now run.
+  worker->wake->StoreRelease(1);
+}
+
+HostQueueProcessor::Entry* HostQueueProcessor::Find(Worker* worker, HostQueue* queue) {
+  for (Entry& entry : worker->entries) {
+    if (entry.queue == queue) return &entry;
+  }
+  return nullptr;
+}
+
+bool HostQueueProcessor::BarrierReady(const hsa_signal_t* deps, bool wait_all,
+                                      SignalWaitSet& waits) {
+  const uint32_t kNumDeps = 5;
+  bool any = false;
+
+  for (uint32_t i = 0; i < kNumDeps; i++) {
+    if (deps[i].handle == 0) continue;
+    Signal* dep = Signal::Convert(deps[i]);
+    if (!dep->IsValid()) continue;
+    any = true;
+
+    const bool satisfied = (dep->LoadRelaxed() == 0);
+    if (wait_all && !satisfied) {
+      waits.Add(deps[i], HSA_SIGNAL_CONDITION_EQ, 0);
+      return false;
+    }
+    if (!wait_all && satisfied) return true;
+  }
+
+  // Barrier-OR without dependencies completes immediately.
+  if (wait_all || !any) return true;
+
+  for (uint32_t i = 0; i < kNumDeps; i++) {
+    if ((deps[i].handle != 0) && Signal::Convert(deps[i])->IsValid())
+      waits.Add(deps[i], HSA_SIGNAL_CONDITION_EQ, 0);
+  }
+  return false;
+}
+
+template <typename F>
+void HostQueueProcessor::CallUnlocked(Worker* worker, HostQueue* queue, F call) {
+  worker->running = queue;
+  worker->lock.Release();
+  call();
+  worker->lock.Acquire();
+  worker->running = nullptr;
+  worker->calls_done = worker->calls_done + 1;
+  os::WakeAllOnAddress(&worker->calls_done);
+}
+
+void HostQueueProcessor::Process(Worker* worker, HostQueue* queue, SignalWaitSet& waits) {
+  // Entries may move while the lock is dropped, but not this queue's while it runs.
+  Entry* entry = Find(worker, queue);
+  if (entry->failed) return;
+
+  const hsa_signal_t doorbell = queue->amd_queue_.hsa_queue.doorbell_signal;
+
+  // Sample the doorbell before scanning so a store racing with the scan ends the next wait.
+  const hsa_signal_value_t rung = Signal::Convert(doorbell)->LoadAcquire();
+
+  AqlPacket* ring = reinterpret_cast<AqlPacket*>(queue->amd_queue_.hsa_queue.base_address);
+  const uint64_t mask = queue->amd_queue_.hsa_queue.size - 1;
+  uint64_t read = queue->LoadReadIndexRelaxed();
+
+  while (true) {
+    AqlPacket& packet = ring[read & mask];
+    const uint16_t header = atomic::Load(&packet.dispatch.header, std::memory_order_acquire);
+    const uint16_t type =
+        (header >> HSA_PACKET_HEADER_TYPE) & ((1 << HSA_PACKET_HEADER_WIDTH_TYPE) - 1);
+    if (type == HSA_PACKET_TYPE_INVALID) break;
+
+    hsa_signal_t completion;
+    if (type == HSA_PACKET_TYPE_BARRIER_AND) {
+      if (!BarrierReady(packet.barrier_and.dep_signal, true, waits)) return;
+      completion = packet.barrier_and.completion_signal;
+    } else if (type == HSA_PACKET_TYPE_BARRIER_OR) {
+      if (!BarrierReady(packet.barrier_or.dep_signal, false, waits)) return;
+      completion = packet.barrier_or.completion_signal;
+    } else if (type == HSA_PACKET_TYPE_AGENT_DISPATCH) {
+      // Wait for a handler to be installed.
+      if (entry->handler == nullptr) return;
+      const hsa_amd_agent_dispatch_handler handler = entry->handler;
+      void* const handler_data = entry->handler_data;
+      CallUnlocked(worker, queue, [&]() {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        handler(&packet.agent, handler_data);
+      });
+      entry = Find(worker, queue);
+      completion = packet.agent.completion_signal;
+    } else {
+      // Kernel dispatches can not run on a CPU agent.
+      entry->failed = true;
+      const HsaEventCallback callback = entry->callback;
+      void* const callback_data = entry->callback_data;
+      CallUnlocked(worker, queue, [&]() {
+        callback(HSA_STATUS_ERROR_INVALID_PACKET_FORMAT, Queue::Convert(queue), callback_data);
+      });
+      return;
+    }
+
+    atomic::Store(&packet.dispatch.header, uint16_t(HSA_PACKET_TYPE_INVALID),
+                  std::memory_order_relaxed);
+    queue->StoreReadIndexRelease(++read);
+    if (completion.handle != 0) Signal::Convert(completion)->SubRelease(1);
+  }
+
+  waits.Add(doorbell, HSA_SIGNAL_CONDITION_NE, rung);
+}
+
+void HostQueueProcessor::WorkerLoop(void* arg) {
+  Worker* worker = reinterpret_cast<Worker*>(arg);
+  SignalWaitSet waits;
+  ThreadPolicies::ThreadState policy_state;
+
+  while (!worker->exit) {
+    Runtime::runtime_singleton_->thread_policies().Apply(ThreadPolicies::kHostQueue,
+                                                         policy_state);
+
+    // Control signal first, then what each queue waits for.
+    waits.Clear();
+    waits.Add(Signal::Convert(worker->wake.get()), HSA_SIGNAL_CONDITION_NE, 0);
+    {
+      ScopedAcquire<KernelMutex> lock(&worker->lock);
+      // Indexed, entries may be added or removed while a handler runs unlocked.  Anything
+      // skipped this pass is picked up after the wake store that accompanies the change.
+      for (size_t i = 0; i < worker->entries.size(); i++)
+        Process(worker, worker->entries[i].queue, waits);
+    }
+
+    if (waits.Wait(uint64_t(-1), HSA_WAIT_STATE_BLOCKED, nullptr) == 0)
+      worker->wake->StoreRelaxed(0);
+  }
+}
+
+}  // namespace core
@@ -687,6 +687,15 @@ hsa_status_t hsa_queue_create(
   TRY;
   IS_OPEN();
 
+  // Tools that deferred their initialization may intercept queue creation, so the first queue is
+  // created through the entry they install.  Without a new entry the call goes on here.
+  const decltype(core::hsa_api_table_.core_api.hsa_queue_create_fn) queue_create =
+      core::hsa_api_table_.core_api.hsa_queue_create_fn;
+  if (core::Runtime::runtime_singleton_->LoadDeferredTools() &&
+      (core::hsa_api_table_.core_api.hsa_queue_create_fn != queue_create))
+    return core::hsa_api_table_.core_api.hsa_queue_create_fn(
+        agent_handle, size, type, callback, data, private_segment_size, group_segment_size, queue);
+
   if ((queue == nullptr) || (size == 0) || (!IsPowerOfTwo(size)) || (type < HSA_QUEUE_TYPE_MULTI) ||
       (type > HSA_QUEUE_TYPE_SINGLE)) {
     return HSA_STATUS_ERROR_INVALID_ARGUMENT;
@@ -1085,8 +1094,11 @@ hsa_status_t
   const core::MemoryRegion* mem_region = core::MemoryRegion::Convert(region);
   IS_VALID(mem_region);
 
-  return core::Runtime::runtime_singleton_->AllocateMemory(
-      mem_region, size, core::MemoryRegion::AllocateNoFlags, ptr);
+  const core::MemoryRegion::AllocateFlags alloc_flags =
+      (core::Runtime::runtime_singleton_->flag().lazy_system_mapping()
+       ? core::MemoryRegion::AllocateLazyMap
+       : core::MemoryRegion::AllocateNoFlags) | core::MemoryRegion::AllocateUser;
+  return core::Runtime::runtime_singleton_->AllocateMemory(mem_region, size, alloc_flags, ptr);
   CATCH;
 }
 
@@ -1156,6 +1168,8 @@ hsa_status_t hsa_signal_destroy(hsa_signal_t hsa_signal) {
 }
 
 hsa_signal_value_t hsa_signal_load_relaxed(hsa_signal_t hsa_signal) {
+  volatile int64_t* plain = core::SharedSignal::PlainValue(hsa_signal);
+  if (plain != nullptr) return hsa_signal_value_t(atomic::Load(plain, std::memory_order_relaxed));
   TRY;
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
@@ -1164,6 +1178,8 @@ hsa_signal_value_t hsa_signal_load_relaxed(hsa_signal_t hsa_signal) {
 }
 
 hsa_signal_value_t hsa_signal_load_scacquire(hsa_signal_t hsa_signal) {
+  volatile int64_t* plain = core::SharedSignal::PlainValue(hsa_signal);
+  if (plain != nullptr) return hsa_signal_value_t(atomic::Load(plain, std::memory_order_acquire));
   TRY;
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
@@ -1173,6 +1189,11 @@ hsa_signal_value_t hsa_signal_load_scacquire(hsa_signal_t hsa_signal) {
 
 void hsa_signal_store_relaxed(hsa_signal_t hsa_signal,
                                       hsa_signal_value_t value) {
+  volatile int64_t* plain = core::SharedSignal::PlainValue(hsa_signal);
+  if (plain != nullptr) {
+    atomic::Store(plain, int64_t(value), std::memory_order_relaxed);
+    return;
+  }
   TRY;
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
@@ -1181,6 +1202,11 @@ void hsa_signal_store_relaxed(hsa_signal_t hsa_signal,
 }
 
 void hsa_signal_store_screlease(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
+  volatile int64_t* plain = core::SharedSignal::PlainValue(hsa_signal);
+  if (plain != nullptr) {
+    atomic::Store(plain, int64_t(value), std::memory_order_release);
+    return;
+  }
   TRY;
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
@@ -1373,6 +1399,11 @@ void hsa_signal_xor_scacq_screl(hsa_signal_t hsa_signal, hsa_signal_value_t valu
 }
 
 void hsa_signal_add_relaxed(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
+  volatile int64_t* plain = core::SharedSignal::PlainValue(hsa_signal);
+  if (plain != nullptr) {
+    atomic::Add(plain, int64_t(value), std::memory_order_relaxed);
+    return;
+  }
   TRY;
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
@@ -1381,6 +1412,11 @@ void hsa_signal_add_relaxed(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
 }
 
 void hsa_signal_add_scacquire(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
+  volatile int64_t* plain = core::SharedSignal::PlainValue(hsa_signal);
+  if (plain != nullptr) {
+    atomic::Add(plain, int64_t(value), std::memory_order_acquire);
+    return;
+  }
   TRY;
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
@@ -1389,6 +1425,11 @@ void hsa_signal_add_scacquire(hsa_signal_t hsa_signal, hsa_signal_value_t value)
 }
 
 void hsa_signal_add_screlease(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
+  volatile int64_t* plain = core::SharedSignal::PlainValue(hsa_signal);
+  if (plain != nullptr) {
+    atomic::Add(plain, int64_t(value), std::memory_order_release);
+    return;
+  }
   TRY;
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
@@ -1397,6 +1438,11 @@ void hsa_signal_add_screlease(hsa_signal_t hsa_signal, hsa_signal_value_t value)
 }
 
 void hsa_signal_add_scacq_screl(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
+  volatile int64_t* plain = core::SharedSignal::PlainValue(hsa_signal);
+  if (plain != nullptr) {
+    atomic::Add(plain, int64_t(value), std::memory_order_acq_rel);
+    return;
+  }
   TRY;
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
@@ -1406,6 +1452,11 @@ void hsa_signal_add_scacq_screl(hsa_signal_t hsa_signal, hsa_signal_value_t valu
 
 void hsa_signal_subtract_relaxed(hsa_signal_t hsa_signal,
                                          hsa_signal_value_t value) {
+  volatile int64_t* plain = core::SharedSignal::PlainValue(hsa_signal);
+  if (plain != nullptr) {
+    atomic::Sub(plain, int64_t(value), std::memory_order_relaxed);
+    return;
+  }
   TRY;
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
@@ -1414,6 +1465,11 @@ void hsa_signal_subtract_relaxed(hsa_signal_t hsa_signal,
 }
 
 void hsa_signal_subtract_scacquire(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
+  volatile int64_t* plain = core::SharedSignal::PlainValue(hsa_signal);
+  if (plain != nullptr) {
+    atomic::Sub(plain, int64_t(value), std::memory_order_acquire);
+    return;
+  }
   TRY;
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
@@ -1422,6 +1478,11 @@ void hsa_signal_subtract_scacquire(hsa_signal_t hsa_signal, hsa_signal_value_t v
 }
 
 void hsa_signal_subtract_screlease(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
+  volatile int64_t* plain = core::SharedSignal::PlainValue(hsa_signal);
+  if (plain != nullptr) {
+    atomic::Sub(plain, int64_t(value), std::memory_order_release);
+    return;
+  }
   TRY;
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
@@ -1430,6 +1491,11 @@ void hsa_signal_subtract_screlease(hsa_signal_t hsa_signal, hsa_signal_value_t v
 }
 
 void hsa_signal_subtract_scacq_screl(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
+  volatile int64_t* plain = core::SharedSignal::PlainValue(hsa_signal);
+  if (plain != nullptr) {
+    atomic::Sub(plain, int64_t(value), std::memory_order_acq_rel);
+    return;
+  }
   TRY;
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
@@ -1919,10 +1985,13 @@ hsa_status_t hsa_code_object_get_info(
   IS_OPEN();
   IS_BAD_PTR(value);
 
-  AmdHsaCode *code = GetCodeManager()->FromHandle(code_object);
-  if (!code) {
+  // Every attribute comes from the ELF header or notes, so do not parse the
+  // rest of the code object.
+  AmdHsaCode code_headers;
+  if (!code_headers.InitHeadersAsHandle(code_object)) {
     return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
   }
+  AmdHsaCode *code = &code_headers;
 
   switch (attribute) {
     case HSA_CODE_OBJECT_INFO_ISA: {
@@ -2072,10 +2141,11 @@ struct CodeObjectReaderWrapper final : Signed<0x266E71EDBC718D2C> {
   /// @brief Default constructor.
   CodeObjectReaderWrapper(
       const void *_code_object_memory, size_t _code_object_size,
-      bool _comes_from_file)
+      bool _comes_from_file, bool _mapped = false)
     : code_object_memory(_code_object_memory)
     , code_object_size(_code_object_size)
-    , comes_from_file(_comes_from_file) {}
+    , comes_from_file(_comes_from_file)
+    , mapped(_mapped) {}
 
   /// @brief Default destructor.
   ~CodeObjectReaderWrapper() {}
@@ -2083,6 +2153,9 @@ struct CodeObjectReaderWrapper final : Signed<0x266E71EDBC718D2C> {
   const void *code_object_memory;
   const size_t code_object_size;
   const bool comes_from_file;
+  /// @brief True if code_object_memory is a mapping of the file rather than
+  /// a heap copy of it.
+  const bool mapped;
 };
 
 Loader *GetLoader() {
@@ -2107,6 +2180,22 @@ hsa_status_t hsa_code_object_reader_create_from_file(
     return HSA_STATUS_ERROR_INVALID_FILE;
   }
 
+  // Map the file where possible. The loader parses and uploads segments
+  // straight from the mapped pages, so the file is never copied whole.
+  if (file_size != 0) {
+    void *mapping = os::MapFile(file, file_size);
+    if (mapping) {
+      CodeObjectReaderWrapper *wrapper = new (std::nothrow) CodeObjectReaderWrapper(
+          mapping, file_size, true, true);
+      if (!wrapper) {
+        os::UnmapFile(mapping, file_size);
+        return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+      }
+      *code_object_reader = CodeObjectReaderWrapper::Handle(wrapper);
+      return HSA_STATUS_SUCCESS;
+    }
+  }
+
   unsigned char *code_object_memory = new unsigned char[file_size];
   CHECK_ALLOC(code_object_memory);
 
@@ -2160,7 +2249,9 @@ hsa_status_t hsa_code_object_reader_destroy(
     return HSA_STATUS_ERROR_INVALID_CODE_OBJECT_READER;
   }
 
-  if (wrapper->comes_from_file) {
+  if (wrapper->mapped) {
+    os::UnmapFile(const_cast<void*>(wrapper->code_object_memory), wrapper->code_object_size);
+  } else if (wrapper->comes_from_file) {
     delete [] (unsigned char*)wrapper->code_object_memory;
   }
   delete wrapper;
@@ -2780,3 +2871,47 @@ hsa_status_t hsa_status_string(
 }
 
 }  // end of namespace HSA
+
+namespace AMD {
+
+hsa_status_t hsa_amd_executable_load_agent_code_objects(
+    hsa_executable_t executable, uint32_t num_agents, const hsa_agent_t* agents,
+    hsa_code_object_reader_t code_object_reader, const char* options,
+    hsa_loaded_code_object_t* loaded_code_objects) {
+  TRY;
+  IS_OPEN();
+  IS_BAD_PTR(agents);
+
+  loader::Executable* exec = loader::Executable::Object(executable);
+  if (!exec) {
+    return HSA_STATUS_ERROR_INVALID_EXECUTABLE;
+  }
+
+  HSA::CodeObjectReaderWrapper* wrapper = HSA::CodeObjectReaderWrapper::Object(code_object_reader);
+  if (!wrapper) {
+    return HSA_STATUS_ERROR_INVALID_CODE_OBJECT_READER;
+  }
+
+  hsa_code_object_t code_object = {reinterpret_cast<uint64_t>(wrapper->code_object_memory)};
+  return exec->LoadCodeObjects(agents, num_agents, code_object, wrapper->code_object_size,
+                               options, loaded_code_objects);
+  CATCH;
+}
+
+hsa_status_t hsa_amd_executable_get_kernels(hsa_executable_t executable,
+                                            hsa_amd_executable_kernel_t* kernels,
+                                            uint32_t* count) {
+  TRY;
+  IS_OPEN();
+  IS_BAD_PTR(count);
+
+  loader::Executable* exec = loader::Executable::Object(executable);
+  if (!exec) {
+    return HSA_STATUS_ERROR_INVALID_EXECUTABLE;
+  }
+
+  return exec->GetKernels(kernels, count);
+  CATCH;
+}
+
+}  // end of namespace AMD
@@ -0,0 +1,163 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "core/inc/hsa_api_stats.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "core/util/os.h"
+
+namespace core {
+
+uint32_t ApiStats::period_ = 0;
+ApiStats::Counters (*ApiStats::shards_)[ApiStats::kNumApis] = nullptr;
+ApiStats::AnyFn ApiStats::next_[ApiStats::kNumApis];
+const char* ApiStats::names_[ApiStats::kNumApis];
+
+ApiStats::Sample::Sample(uint32_t api) : counters_(nullptr), start_(0) {
+  static std::atomic<uint32_t> next_shard(0);
+  static thread_local uint32_t shard = uint32_t(-1);
+  static thread_local uint32_t countdown = 0;
+  if (shard == uint32_t(-1)) shard = next_shard++ % kShards;
+
+  Counters& counters = shards_[shard][api];
+  counters.calls.fetch_add(1, std::memory_order_relaxed);
+
+  if (countdown != 0) {
+    countdown--;
+    return;
+  }
+  countdown = period_ - 1;
+  counters_ = &counters;
+  start_ = os::ReadAccurateClock();
+}
+
+ApiStats::Sample::~Sample() {
+  if (counters_ == nullptr) return;
+
+  static const double kNsPerTick = 1e9 / double(os::AccurateClockFrequency());
+  const uint64_t ns = uint64_t(double(os::ReadAccurateClock() - start_) * kNsPerTick);
+
+  uint32_t bucket = 0;
+  for (uint64_t v = ns >> 7; (v != 0) && (bucket < kBuckets - 1); v >>= 1) bucket++;
+
+  counters_->sampled.fetch_add(1, std::memory_order_relaxed);
+  counters_->sampled_ns.fetch_add(ns, std::memory_order_relaxed);
+  counters_->buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void ApiStats::Enable(HsaApiTable& table, uint32_t period) {
+  if (period == 0) return;
+
+  period_ = period;
+  if (shards_ == nullptr) shards_ = new Counters[kShards][kNumApis]();
+
+#define HSA_API_STATS_CORE(name) Install<k_##name>(table.core_api.name##_fn, #name);
+#define HSA_API_STATS_AMD_EXT(name) Install<k_##name>(table.amd_ext_api.name##_fn, #name);
+  HSA_API_STATS_CORE_APIS(HSA_API_STATS_CORE)
+  HSA_API_STATS_AMD_EXT_APIS(HSA_API_STATS_AMD_EXT)
+#undef HSA_API_STATS_CORE
+#undef HSA_API_STATS_AMD_EXT
+}
+
+void ApiStats::Report(FILE* out) {
+  if (shards_ == nullptr) return;
+
+  struct Row {
+    const char* name;
+    uint64_t calls;
+    uint64_t sampled;
+    uint64_t sampled_ns;
+    uint64_t buckets[kBuckets];
+    double total_ns;
+  };
+  std::vector<Row> rows;
+
+  for (uint32_t api = 0; api < kNumApis; api++) {
+    Row row = {names_[api], 0, 0, 0, {}, 0.0};
+    for (uint32_t shard = 0; shard < kShards; shard++) {
+      Counters& counters = shards_[shard][api];
+      row.calls += counters.calls.exchange(0, std::memory_order_relaxed);
+      row.sampled += counters.sampled.exchange(0, std::memory_order_relaxed);
+      row.sampled_ns += counters.sampled_ns.exchange(0, std::memory_order_relaxed);
+      for (uint32_t i = 0; i < kBuckets; i++)
+        row.buckets[i] += counters.buckets[i].exchange(0, std::memory_order_relaxed);
+    }
+    if (row.calls == 0) continue;
+    // Extrapolate the time of unsampled calls from the sampled ones.
+    if (row.sampled != 0) row.total_ns = double(row.sampled_ns) * row.calls / row.sampled;
+    rows.push_back(row);
+  }
+  if (rows.empty()) return;
+
+  std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+    return (a.total_ns != b.total_ns) ? (a.total_ns > b.total_ns) : (a.calls > b.calls);
+  });
+
+  // Upper bound in ns of the bucket holding the sampled call at fraction @p q.
+  const auto& quantile = [](const Row& row, double q) -> uint64_t {
+    const uint64_t rank = uint64_t(q * double(row.sampled - 1));
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < kBuckets; i++) {
+      seen += row.buckets[i];
+      if (seen > rank) return uint64_t(1) << (i + 7);
+    }
+    return uint64_t(1) << (kBuckets + 6);
+  };
+
+  fprintf(out, "HSA API stats, 1 in %u calls timed\n", period_);
+  fprintf(out, "%-56s %12s %12s %10s %10s %10s\n", "api", "calls", "total_us", "avg_ns",
+          "p50_ns<", "p99_ns<");
+  for (const Row& row : rows) {
+    if (row.sampled == 0) {
+      fprintf(out, "%-56s %12llu\n", row.name, (unsigned long long)row.calls);
+      continue;
+    }
+    fprintf(out, "%-56s %12llu %12.1f %10llu %10llu %10llu\n", row.name,
+            (unsigned long long)row.calls, row.total_ns / 1000.0,
+            (unsigned long long)(row.sampled_ns / row.sampled),
+            (unsigned long long)quantile(row, 0.5), (unsigned long long)quantile(row, 0.99));
+  }
+}
+
+}  // namespace core
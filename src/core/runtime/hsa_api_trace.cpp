@@ -56,6 +56,10 @@ hsa_status_t hsa_amd_queue_intercept_create(
     hsa_agent_t agent_handle, uint32_t size, hsa_queue_type32_t type,
     void (*callback)(hsa_status_t status, hsa_queue_t* source, void* data), void* data,
     uint32_t private_segment_size, uint32_t group_segment_size, hsa_queue_t** queue);
+hsa_status_t hsa_amd_queue_intercept_set_mode(hsa_queue_t* queue,
+                                              hsa_amd_queue_intercept_handler callback,
+                                              void* user_data,
+                                              hsa_amd_queue_intercept_mode_t mode);
 
 hsa_status_t hsa_amd_runtime_queue_create_register(hsa_amd_runtime_queue_notifier callback,
                                                    void* user_data);
@@ -389,6 +393,54 @@ void HsaApiTable::UpdateAmdExts() {
   amd_ext_api.hsa_amd_memory_lock_to_pool_fn = AMD::hsa_amd_memory_lock_to_pool;
   amd_ext_api.hsa_amd_register_deallocation_callback_fn = AMD::hsa_amd_register_deallocation_callback;
   amd_ext_api.hsa_amd_deregister_deallocation_callback_fn = AMD::hsa_amd_deregister_deallocation_callback;
+  amd_ext_api.hsa_amd_memory_async_copy_batch_fn = AMD::hsa_amd_memory_async_copy_batch;
+  amd_ext_api.hsa_amd_signal_wait_stats_fn = AMD::hsa_amd_signal_wait_stats;
+  amd_ext_api.hsa_amd_memory_pool_free_async_fn = AMD::hsa_amd_memory_pool_free_async;
+  amd_ext_api.hsa_amd_memory_lock_cache_invalidate_fn = AMD::hsa_amd_memory_lock_cache_invalidate;
+  amd_ext_api.hsa_amd_queue_submit_fn = AMD::hsa_amd_queue_submit;
+  amd_ext_api.hsa_amd_queue_intercept_set_mode_fn = AMD::hsa_amd_queue_intercept_set_mode;
+  amd_ext_api.hsa_amd_queue_set_agent_dispatch_handler_fn =
+      AMD::hsa_amd_queue_set_agent_dispatch_handler;
+  amd_ext_api.hsa_amd_queue_set_class_fn = AMD::hsa_amd_queue_set_class;
+  amd_ext_api.hsa_amd_queue_get_progress_stats_fn = AMD::hsa_amd_queue_get_progress_stats;
+  amd_ext_api.hsa_amd_profiling_convert_ticks_to_system_domain_fn =
+      AMD::hsa_amd_profiling_convert_ticks_to_system_domain;
+  amd_ext_api.hsa_amd_executable_load_agent_code_objects_fn =
+      AMD::hsa_amd_executable_load_agent_code_objects;
+  amd_ext_api.hsa_amd_executable_get_kernels_fn = AMD::hsa_amd_executable_get_kernels;
+  amd_ext_api.hsa_amd_memory_async_fill_fn = AMD::hsa_amd_memory_async_fill;
+  amd_ext_api.hsa_amd_memory_async_fill_rect_fn = AMD::hsa_amd_memory_async_fill_rect;
+  amd_ext_api.hsa_amd_agent_get_memory_pools_fn = AMD::hsa_amd_agent_get_memory_pools;
+  amd_ext_api.hsa_amd_memory_async_prefetch_fn = AMD::hsa_amd_memory_async_prefetch;
+  amd_ext_api.hsa_amd_launch_template_create_fn = AMD::hsa_amd_launch_template_create;
+  amd_ext_api.hsa_amd_launch_template_dispatch_fn = AMD::hsa_amd_launch_template_dispatch;
+  amd_ext_api.hsa_amd_launch_template_destroy_fn = AMD::hsa_amd_launch_template_destroy;
+  amd_ext_api.hsa_amd_queue_capture_begin_fn = AMD::hsa_amd_queue_capture_begin;
+  amd_ext_api.hsa_amd_queue_capture_end_fn = AMD::hsa_amd_queue_capture_end;
+  amd_ext_api.hsa_amd_graph_launch_fn = AMD::hsa_amd_graph_launch;
+  amd_ext_api.hsa_amd_graph_destroy_fn = AMD::hsa_amd_graph_destroy;
+  amd_ext_api.hsa_amd_queue_create_device_enqueue_fn = AMD::hsa_amd_queue_create_device_enqueue;
+  amd_ext_api.hsa_amd_queue_fence_fn = AMD::hsa_amd_queue_fence;
+  amd_ext_api.hsa_amd_agent_link_cost_fn = AMD::hsa_amd_agent_link_cost;
+  amd_ext_api.hsa_amd_image_import_async_fn = AMD::hsa_amd_image_import_async;
+  amd_ext_api.hsa_amd_image_export_async_fn = AMD::hsa_amd_image_export_async;
+  amd_ext_api.hsa_amd_image_copy_async_fn = AMD::hsa_amd_image_copy_async;
+  amd_ext_api.hsa_amd_image_clear_async_fn = AMD::hsa_amd_image_clear_async;
+  amd_ext_api.hsa_amd_profile_pool_create_fn = AMD::hsa_amd_profile_pool_create;
+  amd_ext_api.hsa_amd_profile_pool_acquire_fn = AMD::hsa_amd_profile_pool_acquire;
+  amd_ext_api.hsa_amd_profile_pool_submit_fn = AMD::hsa_amd_profile_pool_submit;
+  amd_ext_api.hsa_amd_profile_pool_flush_fn = AMD::hsa_amd_profile_pool_flush;
+  amd_ext_api.hsa_amd_profile_pool_destroy_fn = AMD::hsa_amd_profile_pool_destroy;
+  amd_ext_api.hsa_amd_agents_allow_access_batch_fn = AMD::hsa_amd_agents_allow_access_batch;
+  amd_ext_api.hsa_amd_memory_tag_set_fn = AMD::hsa_amd_memory_tag_set;
+  amd_ext_api.hsa_amd_memory_budget_set_fn = AMD::hsa_amd_memory_budget_set;
+  amd_ext_api.hsa_amd_memory_usage_get_fn = AMD::hsa_amd_memory_usage_get;
+  amd_ext_api.hsa_amd_signal_group_wait_n_fn = AMD::hsa_amd_signal_group_wait_n;
+  amd_ext_api.hsa_amd_signal_group_wait_all_fn = AMD::hsa_amd_signal_group_wait_all;
+  amd_ext_api.hsa_amd_memory_file_read_async_fn = AMD::hsa_amd_memory_file_read_async;
+  amd_ext_api.hsa_amd_memory_file_write_async_fn = AMD::hsa_amd_memory_file_write_async;
+  amd_ext_api.hsa_amd_memory_async_copy_multicast_fn = AMD::hsa_amd_memory_async_copy_multicast;
+  amd_ext_api.hsa_amd_thread_policy_set_fn = AMD::hsa_amd_thread_policy_set;
 }
 
 class Init {
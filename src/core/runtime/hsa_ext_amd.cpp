@@ -51,15 +51,20 @@
 
 #include "core/inc/runtime.h"
 #include "core/inc/agent.h"
+#include "core/inc/amd_aql_queue.h"
 #include "core/inc/amd_cpu_agent.h"
 #include "core/inc/amd_gpu_agent.h"
 #include "core/inc/amd_memory_region.h"
+#include "core/inc/amd_queue_scheduler.h"
 #include "core/inc/signal.h"
 #include "core/inc/default_signal.h"
 #include "core/inc/interrupt_signal.h"
 #include "core/inc/ipc_signal.h"
 #include "core/inc/intercept_queue.h"
+#include "core/inc/host_queue.h"
 #include "core/inc/exceptions.h"
+#include "core/inc/launch_template.h"
+#include "core/inc/profile_buffer_pool.h"
 
 template <class T>
 struct ValidityError;
@@ -68,6 +73,11 @@ struct ValidityError<core::Signal*> {
   enum { value = HSA_STATUS_ERROR_INVALID_SIGNAL };
 };
 
+template <>
+struct ValidityError<core::SignalGroup*> {
+  enum { value = HSA_STATUS_ERROR_INVALID_SIGNAL_GROUP };
+};
+
 template <>
 struct ValidityError<core::Agent*> {
   enum { value = HSA_STATUS_ERROR_INVALID_AGENT };
@@ -88,6 +98,21 @@ struct ValidityError<core::Queue*> {
   enum { value = HSA_STATUS_ERROR_INVALID_QUEUE };
 };
 
+template <>
+struct ValidityError<core::LaunchTemplate*> {
+  enum { value = HSA_STATUS_ERROR_INVALID_ARGUMENT };
+};
+
+template <>
+struct ValidityError<core::PacketGraph*> {
+  enum { value = HSA_STATUS_ERROR_INVALID_ARGUMENT };
+};
+
+template <>
+struct ValidityError<core::ProfileBufferPool*> {
+  enum { value = HSA_STATUS_ERROR_INVALID_ARGUMENT };
+};
+
 template <class T>
 struct ValidityError<const T*> {
   enum { value = ValidityError<T*>::value };
@@ -225,6 +250,139 @@ hsa_status_t hsa_amd_memory_fill(void* ptr, uint32_t value, size_t count) {
   CATCH;
 }
 
+// Replicate the low @p value_size bytes of @p value across a dword.
+static bool FillPattern(uint32_t value, uint32_t value_size, uint32_t* pattern) {
+  switch (value_size) {
+    case 1:
+      *pattern = (value & 0xFF) * 0x01010101u;
+      return true;
+    case 2:
+      *pattern = (value & 0xFFFF) * 0x00010001u;
+      return true;
+    case 4:
+      *pattern = value;
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Validate the dependencies and completion signal of an asynchronous fill and submit @p ranges.
+static hsa_status_t SubmitFill(const std::vector<core::FillRange>& ranges, uint32_t pattern,
+                               uint32_t num_dep_signals, const hsa_signal_t* dep_signals,
+                               hsa_signal_t completion_signal) {
+  std::vector<core::Signal*> dep_signal_list(num_dep_signals);
+  for (size_t i = 0; i < num_dep_signals; ++i) {
+    core::Signal* dep_signal_obj = core::Signal::Convert(dep_signals[i]);
+    IS_VALID(dep_signal_obj);
+    dep_signal_list[i] = dep_signal_obj;
+  }
+
+  core::Signal* out_signal_obj = core::Signal::Convert(completion_signal);
+  IS_VALID(out_signal_obj);
+
+  if (ranges.empty()) return HSA_STATUS_SUCCESS;
+
+  return core::Runtime::runtime_singleton_->FillMemory(ranges, pattern, dep_signal_list,
+                                                       *out_signal_obj);
+}
+
+hsa_status_t hsa_amd_memory_async_fill(void* ptr, uint32_t value, uint32_t value_size,
+                                       size_t count, uint32_t num_dep_signals,
+                                       const hsa_signal_t* dep_signals,
+                                       hsa_signal_t completion_signal) {
+  TRY;
+  IS_OPEN();
+
+  uint32_t pattern;
+  if ((ptr == nullptr) || !FillPattern(value, value_size, &pattern)) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  if ((num_dep_signals == 0 && dep_signals != NULL) ||
+      (num_dep_signals > 0 && dep_signals == NULL)) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  const size_t size = count * value_size;
+  if (!IsMultipleOf(ptr, sizeof(uint32_t)) || !IsMultipleOf(size, sizeof(uint32_t))) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  std::vector<core::FillRange> ranges;
+  if (size != 0) {
+    const core::FillRange range = {ptr, size};
+    ranges.push_back(range);
+  }
+
+  return SubmitFill(ranges, pattern, num_dep_signals, dep_signals, completion_signal);
+  CATCH;
+}
+
+hsa_status_t hsa_amd_memory_async_fill_rect(const hsa_pitched_ptr_t* dst,
+                                            const hsa_dim3_t* dst_offset,
+                                            const hsa_dim3_t* range, uint32_t value,
+                                            uint32_t value_size, uint32_t num_dep_signals,
+                                            const hsa_signal_t* dep_signals,
+                                            hsa_signal_t completion_signal) {
+  TRY;
+  IS_OPEN();
+
+  uint32_t pattern;
+  if ((dst == nullptr) || (dst_offset == nullptr) || (range == nullptr) ||
+      (dst->base == nullptr) || !FillPattern(value, value_size, &pattern)) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  if ((num_dep_signals == 0 && dep_signals != NULL) ||
+      (num_dep_signals > 0 && dep_signals == NULL)) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  // Same geometry rules as hsa_amd_memory_async_copy_rect, with every row
+  // starting and ending on a dword.
+  if (!IsMultipleOf(dst->base, sizeof(uint32_t)) || !IsMultipleOf(dst->pitch, sizeof(uint32_t)) ||
+      !IsMultipleOf(dst->slice, sizeof(uint32_t)) ||
+      !IsMultipleOf(dst_offset->x, sizeof(uint32_t)) ||
+      !IsMultipleOf(range->x, sizeof(uint32_t))) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+  if (uint64_t(dst_offset->x) + range->x > dst->pitch) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  if ((dst->slice != 0) && (uint64_t(dst_offset->y) + range->y > dst->slice / dst->pitch))
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  if ((range->z > 1) && (dst->slice == 0)) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  // Whole rows merge into one range per layer, and whole layers into one
+  // range, so that only strided rects cost one fill per row.
+  std::vector<core::FillRange> ranges;
+  if ((range->x != 0) && (range->y != 0) && (range->z != 0)) {
+    char* base = static_cast<char*>(dst->base) + uint64_t(dst_offset->z) * dst->slice +
+        uint64_t(dst_offset->y) * dst->pitch + dst_offset->x;
+    const bool whole_rows = (range->x == dst->pitch);
+    const bool whole_layers =
+        whole_rows && ((range->z == 1) || (uint64_t(range->y) * dst->pitch == dst->slice));
+    if (whole_layers) {
+      const core::FillRange fill = {base,
+                                    size_t(range->z - 1) * dst->slice + size_t(range->y) * dst->pitch};
+      ranges.push_back(fill);
+    } else {
+      const uint32_t rows = whole_rows ? 1 : range->y;
+      const size_t row_size = whole_rows ? size_t(range->y) * dst->pitch : range->x;
+      ranges.reserve(size_t(rows) * range->z);
+      for (uint32_t z = 0; z < range->z; z++) {
+        for (uint32_t y = 0; y < rows; y++) {
+          const core::FillRange fill = {base + uint64_t(z) * dst->slice + uint64_t(y) * dst->pitch,
+                                        row_size};
+          ranges.push_back(fill);
+        }
+      }
+    }
+  }
+
+  return SubmitFill(ranges, pattern, num_dep_signals, dep_signals, completion_signal);
+  CATCH;
+}
+
 hsa_status_t hsa_amd_memory_async_copy(void* dst, hsa_agent_t dst_agent_handle, const void* src,
                                        hsa_agent_t src_agent_handle, size_t size,
                                        uint32_t num_dep_signals, const hsa_signal_t* dep_signals,
@@ -265,6 +423,63 @@ hsa_status_t hsa_amd_memory_async_copy(void* dst, hsa_agent_t dst_agent_handle,
   CATCH;
 }
 
+// Validate a file transfer between @p fd and @p ptr on @p agent_handle and queue it.
+static hsa_status_t SubmitFileCopy(int fd, uint64_t file_offset, void* ptr, size_t size,
+                                   hsa_agent_t agent_handle, bool to_device,
+                                   uint32_t num_dep_signals, const hsa_signal_t* dep_signals,
+                                   hsa_signal_t completion_signal) {
+  if (fd < 0 || ptr == NULL) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  if ((num_dep_signals == 0 && dep_signals != NULL) ||
+      (num_dep_signals > 0 && dep_signals == NULL)) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  core::Agent* agent = core::Agent::Convert(agent_handle);
+  IS_VALID(agent);
+  if (agent->device_type() != core::Agent::kAmdGpuDevice) {
+    return HSA_STATUS_ERROR_INVALID_AGENT;
+  }
+
+  std::vector<core::Signal*> dep_signal_list(num_dep_signals);
+  for (size_t i = 0; i < num_dep_signals; ++i) {
+    core::Signal* dep_signal_obj = core::Signal::Convert(dep_signals[i]);
+    IS_VALID(dep_signal_obj);
+    dep_signal_list[i] = dep_signal_obj;
+  }
+
+  core::Signal* out_signal_obj = core::Signal::Convert(completion_signal);
+  IS_VALID(out_signal_obj);
+
+  return core::Runtime::runtime_singleton_->CopyFile(fd, file_offset, ptr, size, *agent,
+                                                     to_device, dep_signal_list,
+                                                     *out_signal_obj);
+}
+
+hsa_status_t hsa_amd_memory_file_read_async(int fd, uint64_t file_offset, void* dst,
+                                            size_t size, hsa_agent_t dst_agent,
+                                            uint32_t num_dep_signals,
+                                            const hsa_signal_t* dep_signals,
+                                            hsa_signal_t completion_signal) {
+  TRY;
+  IS_OPEN();
+  return SubmitFileCopy(fd, file_offset, dst, size, dst_agent, true, num_dep_signals,
+                        dep_signals, completion_signal);
+  CATCH;
+}
+
+hsa_status_t hsa_amd_memory_file_write_async(int fd, uint64_t file_offset, const void* src,
+                                             size_t size, hsa_agent_t src_agent,
+                                             uint32_t num_dep_signals,
+                                             const hsa_signal_t* dep_signals,
+                                             hsa_signal_t completion_signal) {
+  TRY;
+  IS_OPEN();
+  return SubmitFileCopy(fd, file_offset, const_cast<void*>(src), size, src_agent, false,
+                        num_dep_signals, dep_signals, completion_signal);
+  CATCH;
+}
+
 hsa_status_t HSA_API hsa_amd_memory_async_copy_rect(
     const hsa_pitched_ptr_t* dst, const hsa_dim3_t* dst_offset, const hsa_pitched_ptr_t* src,
     const hsa_dim3_t* src_offset, const hsa_dim3_t* range, hsa_agent_t copy_agent,
@@ -310,6 +525,104 @@ hsa_status_t HSA_API hsa_amd_memory_async_copy_rect(
   CATCH;
 }
 
+hsa_status_t HSA_API hsa_amd_memory_async_copy_batch(
+    uint32_t num_copies, const hsa_amd_memory_copy_desc_t* copies, hsa_agent_t dst_agent_handle,
+    hsa_agent_t src_agent_handle, uint32_t num_dep_signals, const hsa_signal_t* dep_signals,
+    hsa_signal_t completion_signal) {
+  TRY;
+  if ((num_copies == 0 && copies != NULL) || (num_copies > 0 && copies == NULL)) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  if ((num_dep_signals == 0 && dep_signals != NULL) ||
+      (num_dep_signals > 0 && dep_signals == NULL)) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  core::Agent* dst_agent = core::Agent::Convert(dst_agent_handle);
+  IS_VALID(dst_agent);
+
+  core::Agent* src_agent = core::Agent::Convert(src_agent_handle);
+  IS_VALID(src_agent);
+
+  // Empty copies are dropped, as with hsa_amd_memory_async_copy.
+  std::vector<hsa_amd_memory_copy_desc_t> copy_list;
+  copy_list.reserve(num_copies);
+  for (uint32_t i = 0; i < num_copies; ++i) {
+    if (copies[i].dst == NULL || copies[i].src == NULL) {
+      return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    }
+    if (copies[i].size != 0) copy_list.push_back(copies[i]);
+  }
+
+  std::vector<core::Signal*> dep_signal_list(num_dep_signals);
+  if (num_dep_signals > 0) {
+    for (size_t i = 0; i < num_dep_signals; ++i) {
+      core::Signal* dep_signal_obj = core::Signal::Convert(dep_signals[i]);
+      IS_VALID(dep_signal_obj);
+      dep_signal_list[i] = dep_signal_obj;
+    }
+  }
+
+  core::Signal* out_signal_obj = core::Signal::Convert(completion_signal);
+  IS_VALID(out_signal_obj);
+
+  if (!copy_list.empty()) {
+    return core::Runtime::runtime_singleton_->CopyMemoryBatch(
+        copy_list, *dst_agent, *src_agent, dep_signal_list, *out_signal_obj);
+  }
+
+  return HSA_STATUS_SUCCESS;
+  CATCH;
+}
+
+hsa_status_t HSA_API hsa_amd_memory_async_copy_multicast(
+    uint32_t num_dsts, void* const* dsts, const hsa_agent_t* dst_agents, const void* src,
+    hsa_agent_t src_agent_handle, size_t size, uint32_t num_dep_signals,
+    const hsa_signal_t* dep_signals, hsa_signal_t completion_signal) {
+  TRY;
+  IS_OPEN();
+  if (num_dsts == 0 || dsts == NULL || dst_agents == NULL || src == NULL) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  if ((num_dep_signals == 0 && dep_signals != NULL) ||
+      (num_dep_signals > 0 && dep_signals == NULL)) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  core::Agent* src_agent = core::Agent::Convert(src_agent_handle);
+  IS_VALID(src_agent);
+
+  std::vector<void*> dst_list(num_dsts);
+  std::vector<core::Agent*> dst_agent_list(num_dsts);
+  for (uint32_t i = 0; i < num_dsts; ++i) {
+    if (dsts[i] == NULL) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    dst_list[i] = dsts[i];
+    core::Agent* dst_agent = core::Agent::Convert(dst_agents[i]);
+    IS_VALID(dst_agent);
+    dst_agent_list[i] = dst_agent;
+  }
+
+  std::vector<core::Signal*> dep_signal_list(num_dep_signals);
+  for (size_t i = 0; i < num_dep_signals; ++i) {
+    core::Signal* dep_signal_obj = core::Signal::Convert(dep_signals[i]);
+    IS_VALID(dep_signal_obj);
+    dep_signal_list[i] = dep_signal_obj;
+  }
+
+  core::Signal* out_signal_obj = core::Signal::Convert(completion_signal);
+  IS_VALID(out_signal_obj);
+
+  if (size > 0) {
+    return core::Runtime::runtime_singleton_->CopyMemoryMulticast(
+        dst_list, dst_agent_list, src, *src_agent, size, dep_signal_list, *out_signal_obj);
+  }
+
+  return HSA_STATUS_SUCCESS;
+  CATCH;
+}
+
 
 hsa_status_t hsa_amd_profiling_set_profiler_enabled(hsa_queue_t* queue, int enable) {
   TRY;
@@ -400,137 +713,639 @@ hsa_status_t hsa_amd_profiling_get_async_copy_time(
     return HSA_STATUS_SUCCESS;
   }
 
-  // The timestamp is already in system domain.
-  time->start = signal->signal_.start_ts;
-  time->end = signal->signal_.end_ts;
-  return HSA_STATUS_SUCCESS;
+  // The timestamp is already in system domain.
+  time->start = signal->signal_.start_ts;
+  time->end = signal->signal_.end_ts;
+  return HSA_STATUS_SUCCESS;
+  CATCH;
+}
+
+hsa_status_t hsa_amd_profiling_convert_tick_to_system_domain(hsa_agent_t agent_handle,
+                                                             uint64_t agent_tick,
+                                                             uint64_t* system_tick) {
+  TRY;
+  IS_OPEN();
+
+  IS_BAD_PTR(system_tick);
+
+  core::Agent* agent = core::Agent::Convert(agent_handle);
+
+  IS_VALID(agent);
+
+  if (agent->device_type() != core::Agent::kAmdGpuDevice) {
+    return HSA_STATUS_ERROR_INVALID_AGENT;
+  }
+
+  amd::GpuAgentInt* gpu_agent = static_cast<amd::GpuAgentInt*>(agent);
+
+  *system_tick = gpu_agent->TranslateTime(agent_tick);
+
+  return HSA_STATUS_SUCCESS;
+  CATCH;
+}
+
+hsa_status_t hsa_amd_profiling_convert_ticks_to_system_domain(hsa_agent_t agent_handle,
+                                                              const uint64_t* agent_ticks,
+                                                              uint64_t* system_ticks,
+                                                              size_t count) {
+  TRY;
+  IS_OPEN();
+
+  if (count != 0) {
+    IS_BAD_PTR(agent_ticks);
+    IS_BAD_PTR(system_ticks);
+  }
+
+  core::Agent* agent = core::Agent::Convert(agent_handle);
+
+  IS_VALID(agent);
+
+  if (agent->device_type() != core::Agent::kAmdGpuDevice) {
+    return HSA_STATUS_ERROR_INVALID_AGENT;
+  }
+
+  amd::GpuAgentInt* gpu_agent = static_cast<amd::GpuAgentInt*>(agent);
+
+  gpu_agent->TranslateTime(agent_ticks, system_ticks, count);
+
+  return HSA_STATUS_SUCCESS;
+  CATCH;
+}
+
+hsa_status_t hsa_amd_signal_create(hsa_signal_value_t initial_value, uint32_t num_consumers,
+                                   const hsa_agent_t* consumers, uint64_t attributes,
+                                   hsa_signal_t* hsa_signal) {
+  struct AgentHandleCompare {
+    bool operator()(const hsa_agent_t& lhs, const hsa_agent_t& rhs) const {
+      return lhs.handle < rhs.handle;
+    }
+  };
+
+  TRY;
+  IS_OPEN();
+  IS_BAD_PTR(hsa_signal);
+
+  core::Signal* ret;
+
+  bool enable_ipc = attributes & HSA_AMD_SIGNAL_IPC;
+  const bool timeline = attributes & HSA_AMD_SIGNAL_TIMELINE;
+  if (enable_ipc && timeline) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  bool use_default =
+      enable_ipc || (attributes & HSA_AMD_SIGNAL_AMD_GPU_ONLY) || (!core::g_use_interrupt_wait);
+
+  if ((!use_default) && (num_consumers != 0)) {
+    IS_BAD_PTR(consumers);
+
+    // Check for duplicates in consumers.
+    std::set<hsa_agent_t, AgentHandleCompare> consumer_set(consumers, consumers + num_consumers);
+    if (consumer_set.size() != num_consumers) {
+      return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    }
+
+    use_default = true;
+    for (const core::Agent* cpu_agent : core::Runtime::runtime_singleton_->cpu_agents()) {
+      use_default &= (consumer_set.find(cpu_agent->public_handle()) == consumer_set.end());
+    }
+  }
+
+  if (use_default) {
+    ret = new core::DefaultSignal(initial_value, enable_ipc);
+  } else {
+    ret = new core::InterruptSignal(initial_value);
+  }
+  if (timeline) ret->MakeTimeline();
+
+  *hsa_signal = core::Signal::Convert(ret);
+  return HSA_STATUS_SUCCESS;
+  CATCH;
+}
+
+uint32_t hsa_amd_signal_wait_any(uint32_t signal_count, hsa_signal_t* hsa_signals,
+                                 hsa_signal_condition_t* conds, hsa_signal_value_t* values,
+                                 uint64_t timeout_hint, hsa_wait_state_t wait_hint,
+                                 hsa_signal_value_t* satisfying_value) {
+  TRY;
+  IS_OPEN();
+  // Do not check for signal invalidation.  Invalidation may occur during async
+  // signal handler loop and is not an error.
+  for (uint i = 0; i < signal_count; i++)
+    assert(hsa_signals[i].handle != 0 && core::SharedSignal::Convert(hsa_signals[i])->IsValid() &&
+           "Invalid signal.");
+
+  return core::Signal::WaitAny(signal_count, hsa_signals, conds, values,
+                               timeout_hint, wait_hint, satisfying_value);
+  CATCHRET(uint32_t);
+}
+
+hsa_status_t hsa_amd_signal_group_wait_n(hsa_signal_group_t signal_group, uint32_t num_required,
+                                         hsa_signal_condition_t condition,
+                                         hsa_signal_value_t compare_value, uint64_t timeout_hint,
+                                         hsa_wait_state_t wait_state_hint,
+                                         uint32_t* num_satisfied) {
+  TRY;
+  IS_OPEN();
+  IS_BAD_PTR(num_satisfied);
+  core::SignalGroup* group = core::SignalGroup::Convert(signal_group);
+  IS_VALID(group);
+  if (num_required == 0 || num_required > group->Count())
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  if (condition != HSA_SIGNAL_CONDITION_EQ && condition != HSA_SIGNAL_CONDITION_NE &&
+      condition != HSA_SIGNAL_CONDITION_LT && condition != HSA_SIGNAL_CONDITION_GTE)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  const bool valid = group->Wait(num_required, condition, compare_value, timeout_hint,
+                                 wait_state_hint, *num_satisfied);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return valid ? HSA_STATUS_SUCCESS : HSA_STATUS_ERROR_INVALID_SIGNAL;
+  CATCH;
+}
+
+hsa_status_t hsa_amd_signal_group_wait_all(hsa_signal_group_t signal_group,
+                                           hsa_signal_condition_t condition,
+                                           hsa_signal_value_t compare_value,
+                                           uint64_t timeout_hint,
+                                           hsa_wait_state_t wait_state_hint,
+                                           uint32_t* num_satisfied) {
+  TRY;
+  IS_OPEN();
+  core::SignalGroup* group = core::SignalGroup::Convert(signal_group);
+  IS_VALID(group);
+  return AMD::hsa_amd_signal_group_wait_n(signal_group, group->Count(), condition,
+                                          compare_value, timeout_hint, wait_state_hint,
+                                          num_satisfied);
+  CATCH;
+}
+
+hsa_status_t hsa_amd_signal_wait_stats(hsa_signal_t hsa_signal,
+                                       hsa_amd_signal_wait_stats_t* stats) {
+  TRY;
+  IS_OPEN();
+  IS_BAD_PTR(stats);
+
+  core::Signal* signal = core::Signal::Convert(hsa_signal);
+  IS_VALID(signal);
+
+  signal->wait_policy().GetStats(stats);
+  return HSA_STATUS_SUCCESS;
+  CATCH;
+}
+
+hsa_status_t hsa_amd_signal_async_handler(hsa_signal_t hsa_signal, hsa_signal_condition_t cond,
+                                          hsa_signal_value_t value, hsa_amd_signal_handler handler,
+                                          void* arg) {
+  TRY;
+  IS_OPEN();
+  IS_BAD_PTR(handler);
+
+  core::Signal* signal = core::Signal::Convert(hsa_signal);
+  IS_VALID(signal);
+  if (core::g_use_interrupt_wait && (!core::InterruptSignal::IsType(signal)))
+    return HSA_STATUS_ERROR_INVALID_SIGNAL;
+  return core::Runtime::runtime_singleton_->SetAsyncSignalHandler(
+      hsa_signal, cond, value, handler, arg, true);
+  CATCH;
+}
+
+hsa_status_t hsa_amd_async_function(void (*callback)(void* arg), void* arg) {
+  TRY;
+  IS_OPEN();
+
+  IS_BAD_PTR(callback);
+  static const hsa_signal_t null_signal = {0};
+  return core::Runtime::runtime_singleton_->SetAsyncSignalHandler(
+      null_signal, HSA_SIGNAL_CONDITION_EQ, 0, (hsa_amd_signal_handler)callback,
+      arg, true);
+  CATCH;
+}
+
+hsa_status_t hsa_amd_queue_cu_set_mask(const hsa_queue_t* queue,
+                                               uint32_t num_cu_mask_count,
+                                               const uint32_t* cu_mask) {
+  TRY;
+  IS_OPEN();
+  IS_BAD_PTR(cu_mask);
+
+  core::Queue* cmd_queue = core::Queue::Convert(queue);
+  IS_VALID(cmd_queue);
+  return cmd_queue->SetCUMasking(num_cu_mask_count, cu_mask);
+  CATCH;
+}
+
+hsa_status_t hsa_amd_queue_submit(hsa_queue_t* queue, const void* packets, uint32_t count,
+                                  uint64_t timeout_ns) {
+  TRY;
+  IS_OPEN();
+  IS_BAD_PTR(packets);
+
+  core::Queue* cmd_queue = core::Queue::Convert(queue);
+  IS_VALID(cmd_queue);
+  return core::SubmitPackets(cmd_queue, reinterpret_cast<const core::AqlPacket*>(packets), count,
+                             timeout_ns);
+  CATCH;
+}
+
+hsa_status_t hsa_amd_launch_template_create(hsa_queue_t* queue, hsa_executable_symbol_t kernel,
+                                            const hsa_kernel_dispatch_packet_t* dispatch,
+                                            hsa_amd_launch_template_t* launch) {
+  TRY;
+  IS_OPEN();
+  IS_BAD_PTR(dispatch);
+  IS_BAD_PTR(launch);
+
+  core::Queue* cmd_queue = core::Queue::Convert(queue);
+  IS_VALID(cmd_queue);
+
+  core::LaunchTemplate* launch_obj;
+  hsa_status_t err = core::LaunchTemplate::Create(cmd_queue, kernel, *dispatch, launch_obj);
+  if (err != HSA_STATUS_SUCCESS) return err;
+
+  *launch = core::LaunchTemplate::Convert(launch_obj);
+  return HSA_STATUS_SUCCESS;
+  CATCH;
+}
+
+hsa_status_t hsa_amd_launch_template_dispatch(hsa_amd_launch_template_t launch,
+                                              const void* kernarg,
+                                              hsa_signal_t completion_signal) {
+  TRY;
+  IS_OPEN();
+
+  core::LaunchTemplate* launch_obj = core::LaunchTemplate::Convert(launch);
+  IS_VALID(launch_obj);
+  if (kernarg == nullptr && launch_obj->kernarg_size() != 0)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  return launch_obj->Launch(kernarg, completion_signal);
+  CATCH;
+}
+
+hsa_status_t hsa_amd_launch_template_destroy(hsa_amd_launch_template_t launch) {
+  TRY;
+  IS_OPEN();
+
+  core::LaunchTemplate* launch_obj = core::LaunchTemplate::Convert(launch);
+  IS_VALID(launch_obj);
+  delete launch_obj;
+  return HSA_STATUS_SUCCESS;
+  CATCH;
+}
+
+hsa_status_t hsa_amd_queue_capture_begin(hsa_queue_t* queue) {
+  TRY;
+  IS_OPEN();
+
+  core::Queue* cmd_queue = core::Queue::Convert(queue);
+  IS_VALID(cmd_queue);
+  if (!core::InterceptQueue::IsType(cmd_queue)) return HSA_STATUS_ERROR_INVALID_QUEUE;
+  core::InterceptQueue* iQueue = static_cast<core::InterceptQueue*>(cmd_queue);
+  return iQueue->BeginCapture() ? HSA_STATUS_SUCCESS : HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  CATCH;
+}
+
+hsa_status_t hsa_amd_queue_capture_end(hsa_queue_t* queue, hsa_amd_graph_t* graph) {
+  TRY;
+  IS_OPEN();
+  IS_BAD_PTR(graph);
+
+  core::Queue* cmd_queue = core::Queue::Convert(queue);
+  IS_VALID(cmd_queue);
+  if (!core::InterceptQueue::IsType(cmd_queue)) return HSA_STATUS_ERROR_INVALID_QUEUE;
+  core::InterceptQueue* iQueue = static_cast<core::InterceptQueue*>(cmd_queue);
+
+  core::PacketGraph* graph_obj = iQueue->EndCapture();
+  if (graph_obj == nullptr) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  *graph = core::PacketGraph::Convert(graph_obj);
+  return HSA_STATUS_SUCCESS;
+  CATCH;
+}
+
+hsa_status_t hsa_amd_graph_launch(hsa_amd_graph_t graph, hsa_queue_t* queue,
+                                  hsa_signal_t completion_signal) {
+  TRY;
+  IS_OPEN();
+
+  core::PacketGraph* graph_obj = core::PacketGraph::Convert(graph);
+  IS_VALID(graph_obj);
+  core::Queue* cmd_queue = core::Queue::Convert(queue);
+  IS_VALID(cmd_queue);
+  return graph_obj->Launch(cmd_queue, completion_signal);
+  CATCH;
+}
+
+hsa_status_t hsa_amd_graph_destroy(hsa_amd_graph_t graph) {
+  TRY;
+  IS_OPEN();
+
+  core::PacketGraph* graph_obj = core::PacketGraph::Convert(graph);
+  IS_VALID(graph_obj);
+  delete graph_obj;
+  return HSA_STATUS_SUCCESS;
+  CATCH;
+}
+
+hsa_status_t hsa_amd_queue_create_device_enqueue(
+    hsa_agent_t agent_handle, uint32_t size, hsa_queue_type32_t type,
+    void (*callback)(hsa_status_t status, hsa_queue_t* source, void* data), void* data,
+    uint32_t private_segment_size, uint32_t group_segment_size, hsa_queue_t** queue) {
+  TRY;
+  IS_OPEN();
+
+  if ((queue == nullptr) || (size == 0) || (!IsPowerOfTwo(size)) ||
+      (type != HSA_QUEUE_TYPE_MULTI)) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  core::Agent* agent = core::Agent::Convert(agent_handle);
+  IS_VALID(agent);
+  if (agent->device_type() != core::Agent::kAmdGpuDevice) {
+    return HSA_STATUS_ERROR_INVALID_AGENT;
+  }
+  amd::GpuAgent* gpu_agent = static_cast<amd::GpuAgent*>(agent);
+
+  if (callback == nullptr) callback = core::Queue::DefaultErrorHandler;
+
+  core::Queue* cmd_queue = nullptr;
+  hsa_status_t status = gpu_agent->DeviceEnqueueQueueCreate(
+      size, callback, data, private_segment_size, group_segment_size, &cmd_queue);
+  if (status != HSA_STATUS_SUCCESS) return status;
+
+  assert(cmd_queue != nullptr && "Queue not returned but status was success.\n");
+  *queue = core::Queue::Convert(cmd_queue);
+  return status;
+  CATCH;
+}
+
+hsa_status_t hsa_amd_queue_fence(uint32_t num_queues, hsa_queue_t* const* queues,
+                                 uint32_t num_copy_agents, const hsa_agent_t* copy_agents) {
+  TRY;
+  IS_OPEN();
+  if ((num_queues != 0 && queues == nullptr) ||
+      (num_copy_agents != 0 && copy_agents == nullptr))
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  std::vector<core::Queue*> queue_list(num_queues);
+  for (uint32_t i = 0; i < num_queues; ++i) {
+    core::Queue* cmd_queue = core::Queue::Convert(queues[i]);
+    IS_VALID(cmd_queue);
+    queue_list[i] = cmd_queue;
+  }
+
+  std::vector<core::Agent*> agent_list(num_copy_agents);
+  for (uint32_t i = 0; i < num_copy_agents; ++i) {
+    core::Agent* agent = core::Agent::Convert(copy_agents[i]);
+    IS_VALID(agent);
+    if (agent->device_type() != core::Agent::kAmdGpuDevice) return HSA_STATUS_ERROR_INVALID_AGENT;
+    agent_list[i] = agent;
+  }
+
+  return core::Runtime::runtime_singleton_->QueueFence(queue_list, agent_list);
   CATCH;
 }
 
-hsa_status_t hsa_amd_profiling_convert_tick_to_system_domain(hsa_agent_t agent_handle,
-                                                             uint64_t agent_tick,
-                                                             uint64_t* system_tick) {
+hsa_status_t hsa_amd_agent_link_cost(hsa_agent_t src_agent, hsa_agent_t dst_agent,
+                                     hsa_amd_link_cost_t* cost) {
   TRY;
   IS_OPEN();
+  IS_BAD_PTR(cost);
+
+  core::Agent* src = core::Agent::Convert(src_agent);
+  IS_VALID(src);
+  core::Agent* dst = core::Agent::Convert(dst_agent);
+  IS_VALID(dst);
+
+  const core::LinkTopology::Cost link =
+      core::Runtime::runtime_singleton_->GetLinkCost(src->node_id(), dst->node_id());
+  cost->hops = link.hops;
+  cost->latency = link.latency;
+  cost->bandwidth = link.bandwidth;
+  cost->calibrated = link.calibrated;
+  return HSA_STATUS_SUCCESS;
+  CATCH;
+}
 
-  IS_BAD_PTR(system_tick);
+// Validate the dependencies and completion signal of an asynchronous image operation and queue
+// @p op to run on a host worker once they are satisfied.
+static hsa_status_t SubmitImageOp(hsa_agent_t agent_handle, uint32_t num_dep_signals,
+                                  const hsa_signal_t* dep_signals,
+                                  hsa_signal_t completion_signal,
+                                  std::function<void()> op) {
+  // Images are implemented by the image extension library.
+  if (core::Runtime::runtime_singleton_->extensions_.image_api.version.major_id == 0) {
+    return HSA_STATUS_ERROR_NOT_INITIALIZED;
+  }
 
-  core::Agent* agent = core::Agent::Convert(agent_handle);
+  if ((num_dep_signals == 0 && dep_signals != NULL) ||
+      (num_dep_signals > 0 && dep_signals == NULL)) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
 
+  core::Agent* agent = core::Agent::Convert(agent_handle);
   IS_VALID(agent);
-
   if (agent->device_type() != core::Agent::kAmdGpuDevice) {
     return HSA_STATUS_ERROR_INVALID_AGENT;
   }
 
-  amd::GpuAgentInt* gpu_agent = static_cast<amd::GpuAgentInt*>(agent);
-
-  *system_tick = gpu_agent->TranslateTime(agent_tick);
+  std::vector<core::Signal*> dep_signal_list(num_dep_signals);
+  for (size_t i = 0; i < num_dep_signals; ++i) {
+    core::Signal* dep_signal_obj = core::Signal::Convert(dep_signals[i]);
+    IS_VALID(dep_signal_obj);
+    dep_signal_list[i] = dep_signal_obj;
+  }
 
-  return HSA_STATUS_SUCCESS;
-  CATCH;
-}
+  core::Signal* out_signal_obj = core::Signal::Convert(completion_signal);
+  IS_VALID(out_signal_obj);
 
-hsa_status_t hsa_amd_signal_create(hsa_signal_value_t initial_value, uint32_t num_consumers,
-                                   const hsa_agent_t* consumers, uint64_t attributes,
-                                   hsa_signal_t* hsa_signal) {
-  struct AgentHandleCompare {
-    bool operator()(const hsa_agent_t& lhs, const hsa_agent_t& rhs) const {
-      return lhs.handle < rhs.handle;
-    }
+  auto task = [op]() {
+    op();
+    return true;
   };
+  return core::Runtime::runtime_singleton_->SubmitHostTask(task, *agent, dep_signal_list,
+                                                           *out_signal_obj, true);
+}
 
+hsa_status_t hsa_amd_image_import_async(hsa_agent_t agent, const void* src_memory,
+                                        size_t src_row_pitch, size_t src_slice_pitch,
+                                        hsa_ext_image_t dst_image,
+                                        const hsa_ext_image_region_t* image_region,
+                                        uint32_t num_dep_signals, const hsa_signal_t* dep_signals,
+                                        hsa_signal_t completion_signal) {
   TRY;
   IS_OPEN();
-  IS_BAD_PTR(hsa_signal);
+  IS_BAD_PTR(src_memory);
+  IS_BAD_PTR(image_region);
 
-  core::Signal* ret;
+  const hsa_ext_image_region_t region = *image_region;
+  return SubmitImageOp(agent, num_dep_signals, dep_signals, completion_signal, [=]() {
+    core::Runtime::runtime_singleton_->extensions_.image_api.hsa_ext_image_import_fn(
+        agent, src_memory, src_row_pitch, src_slice_pitch, dst_image, &region);
+  });
+  CATCH;
+}
 
-  bool enable_ipc = attributes & HSA_AMD_SIGNAL_IPC;
-  bool use_default =
-      enable_ipc || (attributes & HSA_AMD_SIGNAL_AMD_GPU_ONLY) || (!core::g_use_interrupt_wait);
+hsa_status_t hsa_amd_image_export_async(hsa_agent_t agent, hsa_ext_image_t src_image,
+                                        void* dst_memory, size_t dst_row_pitch,
+                                        size_t dst_slice_pitch,
+                                        const hsa_ext_image_region_t* image_region,
+                                        uint32_t num_dep_signals, const hsa_signal_t* dep_signals,
+                                        hsa_signal_t completion_signal) {
+  TRY;
+  IS_OPEN();
+  IS_BAD_PTR(dst_memory);
+  IS_BAD_PTR(image_region);
 
-  if ((!use_default) && (num_consumers != 0)) {
-    IS_BAD_PTR(consumers);
+  const hsa_ext_image_region_t region = *image_region;
+  return SubmitImageOp(agent, num_dep_signals, dep_signals, completion_signal, [=]() {
+    core::Runtime::runtime_singleton_->extensions_.image_api.hsa_ext_image_export_fn(
+        agent, src_image, dst_memory, dst_row_pitch, dst_slice_pitch, &region);
+  });
+  CATCH;
+}
 
-    // Check for duplicates in consumers.
-    std::set<hsa_agent_t, AgentHandleCompare> consumer_set(consumers, consumers + num_consumers);
-    if (consumer_set.size() != num_consumers) {
-      return HSA_STATUS_ERROR_INVALID_ARGUMENT;
-    }
+hsa_status_t hsa_amd_image_copy_async(hsa_agent_t agent, hsa_ext_image_t src_image,
+                                      const hsa_dim3_t* src_offset, hsa_ext_image_t dst_image,
+                                      const hsa_dim3_t* dst_offset, const hsa_dim3_t* range,
+                                      uint32_t num_dep_signals, const hsa_signal_t* dep_signals,
+                                      hsa_signal_t completion_signal) {
+  TRY;
+  IS_OPEN();
+  IS_BAD_PTR(src_offset);
+  IS_BAD_PTR(dst_offset);
+  IS_BAD_PTR(range);
+
+  const hsa_dim3_t src = *src_offset;
+  const hsa_dim3_t dst = *dst_offset;
+  const hsa_dim3_t size = *range;
+  return SubmitImageOp(agent, num_dep_signals, dep_signals, completion_signal, [=]() {
+    core::Runtime::runtime_singleton_->extensions_.image_api.hsa_ext_image_copy_fn(
+        agent, src_image, &src, dst_image, &dst, &size);
+  });
+  CATCH;
+}
 
-    use_default = true;
-    for (const core::Agent* cpu_agent : core::Runtime::runtime_singleton_->cpu_agents()) {
-      use_default &= (consumer_set.find(cpu_agent->public_handle()) == consumer_set.end());
-    }
+hsa_status_t hsa_amd_image_clear_async(hsa_agent_t agent, hsa_ext_image_t image,
+                                       const void* data,
+                                       const hsa_ext_image_region_t* image_region,
+                                       uint32_t num_dep_signals, const hsa_signal_t* dep_signals,
+                                       hsa_signal_t completion_signal) {
+  TRY;
+  IS_OPEN();
+  IS_BAD_PTR(data);
+  IS_BAD_PTR(image_region);
+
+  // The clear value is at most four 32 bit channels.
+  struct ClearValue {
+    uint32_t channel[4];
+  } value;
+  memcpy(&value, data, sizeof(value));
+  const hsa_ext_image_region_t region = *image_region;
+  return SubmitImageOp(agent, num_dep_signals, dep_signals, completion_signal, [=]() {
+    core::Runtime::runtime_singleton_->extensions_.image_api.hsa_ext_image_clear_fn(
+        agent, image, &value, &region);
+  });
+  CATCH;
+}
+
+hsa_status_t hsa_amd_profile_pool_create(hsa_agent_t agent_handle, uint32_t command_size,
+                                         uint32_t output_size, uint32_t num_buffers,
+                                         uint32_t batch_size,
+                                         hsa_amd_profile_data_callback_t callback,
+                                         void* user_data, hsa_amd_profile_pool_t* pool) {
+  TRY;
+  IS_OPEN();
+  IS_BAD_PTR(callback);
+  IS_BAD_PTR(pool);
+  if ((command_size == 0) || (output_size == 0) || (num_buffers == 0)) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
   }
 
-  if (use_default) {
-    ret = new core::DefaultSignal(initial_value, enable_ipc);
-  } else {
-    ret = new core::InterruptSignal(initial_value);
+  core::Agent* agent = core::Agent::Convert(agent_handle);
+  IS_VALID(agent);
+  if (agent->device_type() != core::Agent::kAmdGpuDevice) {
+    return HSA_STATUS_ERROR_INVALID_AGENT;
   }
 
-  *hsa_signal = core::Signal::Convert(ret);
+  std::unique_ptr<core::ProfileBufferPool> pool_obj(new core::ProfileBufferPool(
+      agent, command_size, output_size, num_buffers, batch_size, callback, user_data));
+  hsa_status_t err = pool_obj->Init();
+  if (err != HSA_STATUS_SUCCESS) return err;
+
+  *pool = core::ProfileBufferPool::Convert(pool_obj.release());
   return HSA_STATUS_SUCCESS;
   CATCH;
 }
 
-uint32_t hsa_amd_signal_wait_any(uint32_t signal_count, hsa_signal_t* hsa_signals,
-                                 hsa_signal_condition_t* conds, hsa_signal_value_t* values,
-                                 uint64_t timeout_hint, hsa_wait_state_t wait_hint,
-                                 hsa_signal_value_t* satisfying_value) {
+hsa_status_t hsa_amd_profile_pool_acquire(hsa_amd_profile_pool_t pool,
+                                          hsa_amd_profile_buffer_t* buffer) {
   TRY;
   IS_OPEN();
-  // Do not check for signal invalidation.  Invalidation may occur during async
-  // signal handler loop and is not an error.
-  for (uint i = 0; i < signal_count; i++)
-    assert(hsa_signals[i].handle != 0 && core::SharedSignal::Convert(hsa_signals[i])->IsValid() &&
-           "Invalid signal.");
+  IS_BAD_PTR(buffer);
 
-  return core::Signal::WaitAny(signal_count, hsa_signals, conds, values,
-                               timeout_hint, wait_hint, satisfying_value);
-  CATCHRET(uint32_t);
+  core::ProfileBufferPool* pool_obj = core::ProfileBufferPool::Convert(pool);
+  IS_VALID(pool_obj);
+  return pool_obj->Acquire(buffer);
+  CATCH;
 }
 
-hsa_status_t hsa_amd_signal_async_handler(hsa_signal_t hsa_signal, hsa_signal_condition_t cond,
-                                          hsa_signal_value_t value, hsa_amd_signal_handler handler,
-                                          void* arg) {
+hsa_status_t hsa_amd_profile_pool_submit(hsa_amd_profile_pool_t pool, uint32_t id,
+                                         hsa_signal_t ready_signal) {
   TRY;
   IS_OPEN();
-  IS_BAD_PTR(handler);
 
-  core::Signal* signal = core::Signal::Convert(hsa_signal);
+  core::ProfileBufferPool* pool_obj = core::ProfileBufferPool::Convert(pool);
+  IS_VALID(pool_obj);
+  core::Signal* signal = core::Signal::Convert(ready_signal);
   IS_VALID(signal);
-  if (core::g_use_interrupt_wait && (!core::InterruptSignal::IsType(signal)))
-    return HSA_STATUS_ERROR_INVALID_SIGNAL;
-  return core::Runtime::runtime_singleton_->SetAsyncSignalHandler(
-      hsa_signal, cond, value, handler, arg);
+  return pool_obj->Submit(id, signal);
   CATCH;
 }
 
-hsa_status_t hsa_amd_async_function(void (*callback)(void* arg), void* arg) {
+hsa_status_t hsa_amd_profile_pool_flush(hsa_amd_profile_pool_t pool) {
   TRY;
   IS_OPEN();
 
-  IS_BAD_PTR(callback);
-  static const hsa_signal_t null_signal = {0};
-  return core::Runtime::runtime_singleton_->SetAsyncSignalHandler(
-      null_signal, HSA_SIGNAL_CONDITION_EQ, 0, (hsa_amd_signal_handler)callback,
-      arg);
+  core::ProfileBufferPool* pool_obj = core::ProfileBufferPool::Convert(pool);
+  IS_VALID(pool_obj);
+  return pool_obj->Flush();
   CATCH;
 }
 
-hsa_status_t hsa_amd_queue_cu_set_mask(const hsa_queue_t* queue,
-                                               uint32_t num_cu_mask_count,
-                                               const uint32_t* cu_mask) {
+hsa_status_t hsa_amd_profile_pool_destroy(hsa_amd_profile_pool_t pool) {
   TRY;
   IS_OPEN();
-  IS_BAD_PTR(cu_mask);
+
+  core::ProfileBufferPool* pool_obj = core::ProfileBufferPool::Convert(pool);
+  IS_VALID(pool_obj);
+  delete pool_obj;
+  return HSA_STATUS_SUCCESS;
+  CATCH;
+}
+
+hsa_status_t hsa_amd_queue_get_progress_stats(const hsa_queue_t* queue,
+                                              hsa_amd_queue_progress_stats_t* stats) {
+  TRY;
+  IS_OPEN();
+  IS_BAD_PTR(stats);
 
   core::Queue* cmd_queue = core::Queue::Convert(queue);
   IS_VALID(cmd_queue);
-  return cmd_queue->SetCUMasking(num_cu_mask_count, cu_mask);
+  cmd_queue->GetProgressStats(stats);
+  return HSA_STATUS_SUCCESS;
+  CATCH;
+}
+
+hsa_status_t hsa_amd_queue_set_agent_dispatch_handler(hsa_queue_t* queue,
+                                                      hsa_amd_agent_dispatch_handler handler,
+                                                      void* data) {
+  TRY;
+  IS_OPEN();
+
+  core::Queue* cmd_queue = core::Queue::Convert(queue);
+  IS_VALID(cmd_queue);
+  if (!core::HostQueue::IsType(cmd_queue)) return HSA_STATUS_ERROR_INVALID_QUEUE;
+  core::HostQueue* host_queue = static_cast<core::HostQueue*>(cmd_queue);
+  if (!host_queue->SetAgentDispatchHandler(handler, data)) return HSA_STATUS_ERROR_INVALID_QUEUE;
+  return HSA_STATUS_SUCCESS;
   CATCH;
 }
 
@@ -604,6 +1419,17 @@ hsa_status_t hsa_amd_memory_unlock(void* host_ptr) {
   CATCH;
 }
 
+hsa_status_t hsa_amd_memory_lock_cache_invalidate(void* host_ptr, size_t size) {
+  TRY;
+  IS_OPEN();
+  IS_BAD_PTR(host_ptr);
+
+  core::PinCache& pin_cache = core::Runtime::runtime_singleton_->pin_cache();
+  if (pin_cache.enabled() && size != 0) pin_cache.Invalidate(host_ptr, size);
+  return HSA_STATUS_SUCCESS;
+  CATCH;
+}
+
 hsa_status_t hsa_amd_memory_pool_get_info(hsa_amd_memory_pool_t memory_pool,
                                           hsa_amd_memory_pool_info_t attribute, void* value) {
   TRY;
@@ -645,12 +1471,45 @@ hsa_status_t hsa_amd_agent_iterate_memory_pools(
   CATCH;
 }
 
+hsa_status_t hsa_amd_agent_get_memory_pools(hsa_agent_t agent_handle,
+                                            hsa_agent_t accessing_agent_handle,
+                                            hsa_amd_memory_pool_desc_t* memory_pools,
+                                            uint32_t* count) {
+  TRY;
+  IS_OPEN();
+  IS_BAD_PTR(count);
+  const core::Agent* agent = core::Agent::Convert(agent_handle);
+  IS_VALID(agent);
+  const core::Agent* accessing_agent = core::Agent::Convert(accessing_agent_handle);
+  IS_VALID(accessing_agent);
+
+  // Same pools as hsa_amd_agent_iterate_memory_pools.  CPU agents expose all of
+  // their regions, GPU agents only system, local and LDS memory.
+  const bool is_cpu = (agent->device_type() == core::Agent::kAmdCpuDevice);
+  const uint32_t capacity = (memory_pools != NULL) ? *count : 0;
+  uint32_t found = 0;
+  for (const core::MemoryRegion* region : agent->regions()) {
+    const amd::MemoryRegion* amd_region = static_cast<const amd::MemoryRegion*>(region);
+    if (!is_cpu && !amd_region->IsSystem() && !amd_region->IsLocalMemory() &&
+        !amd_region->IsLDS())
+      continue;
+    if (found < capacity) amd_region->GetPoolDesc(*accessing_agent, &memory_pools[found]);
+    found++;
+  }
+  *count = found;
+  return HSA_STATUS_SUCCESS;
+  CATCH;
+}
+
 hsa_status_t hsa_amd_memory_pool_allocate(hsa_amd_memory_pool_t memory_pool, size_t size,
                                           uint32_t flags, void** ptr) {
   TRY;
   IS_OPEN();
 
-  if (size == 0 || ptr == NULL || flags != 0) {
+  if (size == 0 || ptr == NULL ||
+      (flags & ~(HSA_AMD_MEMORY_POOL_HUGE_PAGE_FLAG | HSA_AMD_MEMORY_POOL_IPC_FLAG |
+                 HSA_AMD_MEMORY_POOL_ZERO_FLAG | HSA_AMD_MEMORY_POOL_PREFAULT_FLAG |
+                 HSA_AMD_MEMORY_POOL_NUMA_BIND_FLAG)) != 0) {
     return HSA_STATUS_ERROR_INVALID_ARGUMENT;
   }
 
@@ -661,8 +1520,17 @@ hsa_status_t hsa_amd_memory_pool_allocate(hsa_amd_memory_pool_t memory_pool, siz
     return (hsa_status_t)HSA_STATUS_ERROR_INVALID_MEMORY_POOL;
   }
 
-  return core::Runtime::runtime_singleton_->AllocateMemory(
-      mem_region, size, core::MemoryRegion::AllocateRestrict, ptr);
+  core::MemoryRegion::AllocateFlags alloc_flags =
+      core::MemoryRegion::AllocateRestrict | core::MemoryRegion::AllocateUser;
+  if (flags & HSA_AMD_MEMORY_POOL_HUGE_PAGE_FLAG) alloc_flags |= core::MemoryRegion::AllocateHugePage;
+  if (flags & HSA_AMD_MEMORY_POOL_IPC_FLAG) alloc_flags |= core::MemoryRegion::AllocateIPC;
+  if (flags & HSA_AMD_MEMORY_POOL_ZERO_FLAG) alloc_flags |= core::MemoryRegion::AllocateZero;
+  if (flags & HSA_AMD_MEMORY_POOL_PREFAULT_FLAG)
+    alloc_flags |= core::MemoryRegion::AllocatePrefault;
+  if (flags & HSA_AMD_MEMORY_POOL_NUMA_BIND_FLAG)
+    alloc_flags |= core::MemoryRegion::AllocateNumaBind;
+
+  return core::Runtime::runtime_singleton_->AllocateMemory(mem_region, size, alloc_flags, ptr);
   CATCH;
 }
 
@@ -670,6 +1538,64 @@ hsa_status_t hsa_amd_memory_pool_free(void* ptr) {
   return HSA::hsa_memory_free(ptr);
 }
 
+hsa_status_t hsa_amd_memory_pool_free_async(void* ptr, hsa_signal_t hsa_signal) {
+  TRY;
+  IS_OPEN();
+
+  if (hsa_signal.handle != 0) {
+    core::Signal* signal = core::Signal::Convert(hsa_signal);
+    IS_VALID(signal);
+    if (core::g_use_interrupt_wait && (!core::InterruptSignal::IsType(signal)))
+      return HSA_STATUS_ERROR_INVALID_SIGNAL;
+  }
+
+  return core::Runtime::runtime_singleton_->FreeMemoryAsync(ptr, hsa_signal);
+  CATCH;
+}
+
+hsa_status_t hsa_amd_memory_tag_set(uint32_t tag) {
+  TRY;
+  IS_OPEN();
+  if (tag == HSA_AMD_MEMORY_TAG_ALL) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  core::MemoryBudget::SetThreadTag(tag);
+  return HSA_STATUS_SUCCESS;
+  CATCH;
+}
+
+hsa_status_t hsa_amd_memory_budget_set(hsa_amd_memory_pool_t pool, uint32_t tag, size_t limit,
+                                       hsa_amd_memory_budget_callback_t callback, void* data) {
+  TRY;
+  IS_OPEN();
+
+  hsa_region_t region = {pool.handle};
+  const core::MemoryRegion* mem_region = core::MemoryRegion::Convert(region);
+  if (mem_region == NULL || !mem_region->IsValid()) {
+    return (hsa_status_t)HSA_STATUS_ERROR_INVALID_MEMORY_POOL;
+  }
+
+  core::Runtime::runtime_singleton_->memory_budget().SetLimit(tag, mem_region, limit, callback,
+                                                              data);
+  return HSA_STATUS_SUCCESS;
+  CATCH;
+}
+
+hsa_status_t hsa_amd_memory_usage_get(hsa_amd_memory_pool_t pool, uint32_t tag,
+                                      hsa_amd_memory_usage_t* usage) {
+  TRY;
+  IS_OPEN();
+  IS_BAD_PTR(usage);
+
+  hsa_region_t region = {pool.handle};
+  const core::MemoryRegion* mem_region = core::MemoryRegion::Convert(region);
+  if (mem_region == NULL || !mem_region->IsValid()) {
+    return (hsa_status_t)HSA_STATUS_ERROR_INVALID_MEMORY_POOL;
+  }
+
+  core::Runtime::runtime_singleton_->memory_budget().GetUsage(tag, mem_region, usage);
+  return HSA_STATUS_SUCCESS;
+  CATCH;
+}
+
 hsa_status_t hsa_amd_agents_allow_access(uint32_t num_agents, const hsa_agent_t* agents,
                                          const uint32_t* flags, const void* ptr) {
   TRY;
@@ -684,6 +1610,21 @@ hsa_status_t hsa_amd_agents_allow_access(uint32_t num_agents, const hsa_agent_t*
   CATCH;
 }
 
+hsa_status_t hsa_amd_agents_allow_access_batch(uint32_t num_agents, const hsa_agent_t* agents,
+                                               const uint32_t* flags, uint32_t num_ptrs,
+                                               const void* const* ptrs) {
+  TRY;
+  IS_OPEN();
+
+  if (num_agents == 0 || agents == NULL || flags != NULL || num_ptrs == 0 || ptrs == NULL) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+  for (uint32_t i = 0; i < num_ptrs; i++) IS_BAD_PTR(ptrs[i]);
+
+  return core::Runtime::runtime_singleton_->AllowAccess(num_agents, agents, num_ptrs, ptrs);
+  CATCH;
+}
+
 hsa_status_t hsa_amd_memory_pool_can_migrate(hsa_amd_memory_pool_t src_memory_pool,
                                              hsa_amd_memory_pool_t dst_memory_pool, bool* result) {
   TRY;
@@ -735,6 +1676,36 @@ hsa_status_t hsa_amd_memory_migrate(const void* ptr,
   CATCH;
 }
 
+hsa_status_t hsa_amd_memory_async_prefetch(const void* ptr, size_t size, hsa_agent_t agent_handle,
+                                           uint32_t num_dep_signals,
+                                           const hsa_signal_t* dep_signals,
+                                           hsa_signal_t completion_signal) {
+  TRY;
+  IS_OPEN();
+
+  if (ptr == NULL || (num_dep_signals == 0 && dep_signals != NULL) ||
+      (num_dep_signals > 0 && dep_signals == NULL)) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  core::Agent* agent = core::Agent::Convert(agent_handle);
+  IS_VALID(agent);
+
+  std::vector<core::Signal*> dep_signal_list(num_dep_signals);
+  for (size_t i = 0; i < num_dep_signals; ++i) {
+    core::Signal* dep_signal_obj = core::Signal::Convert(dep_signals[i]);
+    IS_VALID(dep_signal_obj);
+    dep_signal_list[i] = dep_signal_obj;
+  }
+
+  core::Signal* out_signal_obj = core::Signal::Convert(completion_signal);
+  IS_VALID(out_signal_obj);
+
+  return core::Runtime::runtime_singleton_->PrefetchMemory(ptr, size, *agent, dep_signal_list,
+                                                           *out_signal_obj);
+  CATCH;
+}
+
 hsa_status_t hsa_amd_agent_memory_pool_get_info(
     hsa_agent_t agent_handle, hsa_amd_memory_pool_t memory_pool,
     hsa_amd_agent_memory_pool_info_t attribute, void* value) {
@@ -929,6 +1900,25 @@ hsa_status_t hsa_amd_queue_intercept_register(hsa_queue_t* queue,
   CATCH;
 }
 
+// For use by tools only - not in library export table.
+hsa_status_t hsa_amd_queue_intercept_set_mode(hsa_queue_t* queue,
+                                              hsa_amd_queue_intercept_handler callback,
+                                              void* user_data,
+                                              hsa_amd_queue_intercept_mode_t mode) {
+  TRY;
+  IS_OPEN();
+  IS_BAD_PTR(callback);
+  if (mode > HSA_AMD_QUEUE_INTERCEPT_MODE_DISABLED) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  core::Queue* cmd_queue = core::Queue::Convert(queue);
+  IS_VALID(cmd_queue);
+  if (!core::InterceptQueue::IsType(cmd_queue)) return HSA_STATUS_ERROR_INVALID_QUEUE;
+  core::InterceptQueue* iQueue = static_cast<core::InterceptQueue*>(cmd_queue);
+  if (!iQueue->SetInterceptorMode(callback, user_data, mode))
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  return HSA_STATUS_SUCCESS;
+  CATCH;
+}
+
 hsa_status_t hsa_amd_register_system_event_handler(hsa_amd_system_event_callback_t callback,
                                                    void* data) {
   TRY;
@@ -961,6 +1951,26 @@ hsa_status_t HSA_API hsa_amd_queue_set_priority(hsa_queue_t* queue,
   CATCH;
 }
 
+hsa_status_t hsa_amd_queue_set_class(hsa_queue_t* queue, hsa_amd_queue_class_t queue_class,
+                                     uint32_t weight) {
+  TRY;
+  IS_OPEN();
+  IS_BAD_PTR(queue);
+  if (queue_class > HSA_AMD_QUEUE_CLASS_BATCH) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  core::Queue* cmd_queue = core::Queue::Convert(queue);
+  IS_VALID(cmd_queue);
+
+  // Classify the hardware queue under an intercept queue.
+  if (core::InterceptQueue::IsType(cmd_queue))
+    cmd_queue = static_cast<core::InterceptQueue*>(cmd_queue)->wrapped.get();
+  if (!amd::AqlQueue::IsType(cmd_queue)) return HSA_STATUS_ERROR_INVALID_QUEUE;
+
+  amd::AqlQueue* aql_queue = static_cast<amd::AqlQueue*>(cmd_queue);
+  return aql_queue->agent()->queue_scheduler().SetClass(aql_queue, queue_class, weight);
+  CATCH;
+}
+
 hsa_status_t hsa_amd_register_deallocation_callback(void* ptr,
                                                     hsa_amd_deallocation_callback_t callback,
                                                     void* user_data) {
@@ -986,6 +1996,34 @@ hsa_status_t hsa_amd_deregister_deallocation_callback(void* ptr,
   CATCH;
 }
 
+hsa_status_t hsa_amd_thread_policy_set(hsa_amd_thread_class_t thread_class,
+                                       const hsa_amd_thread_policy_t* policy) {
+  TRY;
+  IS_OPEN();
+  IS_BAD_PTR(policy);
+  if (uint32_t(thread_class) >= core::ThreadPolicies::kNumClasses)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  if (uint32_t(policy->sched) > HSA_AMD_THREAD_SCHED_RR) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  if (policy->num_cpus != 0) IS_BAD_PTR(policy->cpus);
+
+  core::ThreadPolicies::Policy update;
+  update.cpus.assign(policy->cpus, policy->cpus + policy->num_cpus);
+  update.sched = policy->sched;
+  update.priority = policy->priority;
+  if ((policy->num_cpus == 0) && (policy->numa_node >= 0)) {
+    bool found = false;
+    for (const core::Agent* cpu : core::Runtime::runtime_singleton_->cpu_agents())
+      found |= (cpu->node_id() == uint32_t(policy->numa_node));
+    if (!found) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    update.numa_node = policy->numa_node;
+  }
+
+  core::Runtime::runtime_singleton_->thread_policies().Set(
+      core::ThreadPolicies::Class(thread_class), update);
+  return HSA_STATUS_SUCCESS;
+  CATCH;
+}
+
 // For use by tools only - not in library export table.
 hsa_status_t hsa_amd_runtime_queue_create_register(hsa_amd_runtime_queue_notifier callback,
                                                    void* user_data) {
@@ -252,6 +252,7 @@ void ExtensionEntryPoints::Unload() {
     }
   }
   libs_.clear();
+  finalization_cache.reset();
 
   InitFinalizerExtTable();
   InitImageExtTable();
@@ -468,6 +469,16 @@ bool ExtensionEntryPoints::LoadFinalizer(std::string library_name) {
            "Duplicate load of extension import.");
     finalizer_api.hsa_ext_program_finalize_fn =
         (decltype(::hsa_ext_program_finalize)*)ptr;
+
+    // Cached code objects are only valid for the finalizer build that produced them, leave
+    // the cache off if the library file can not be identified.
+    const Flag& flag = core::Runtime::runtime_singleton_->flag();
+    std::string finalizer;
+    if (!flag.finalizer_cache_dir().empty() && flag.finalizer_cache_size() != 0 &&
+        os::GetLibIdentity(lib, finalizer)) {
+      finalization_cache.reset(new FinalizationCache(flag.finalizer_cache_dir(),
+                                                     flag.finalizer_cache_size(), finalizer));
+    }
   }
   
   // Initialize Version of Api Table
@@ -533,7 +544,13 @@ hsa_status_t hsa_ext_program_finalize(
     hsa_ext_program_t program, hsa_isa_t isa, int32_t call_convention,
     hsa_ext_control_directives_t control_directives, const char* options,
     hsa_code_object_type_t code_object_type, hsa_code_object_t* code_object) {
-  return core::Runtime::runtime_singleton_->extensions_.finalizer_api
+  core::ExtensionEntryPoints& extensions = core::Runtime::runtime_singleton_->extensions_;
+  if (extensions.finalization_cache) {
+    return extensions.finalization_cache->Finalize(extensions.finalizer_api, program, isa,
+                                                   call_convention, control_directives, options,
+                                                   code_object_type, code_object);
+  }
+  return extensions.finalizer_api
       .hsa_ext_program_finalize_fn(program, isa, call_convention,
                                    control_directives, options,
                                    code_object_type, code_object);
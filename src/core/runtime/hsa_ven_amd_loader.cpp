@@ -205,6 +205,14 @@ hsa_status_t hsa_ven_amd_loader_loaded_code_object_get_info(
       *((uint64_t*)value) = lcobj->getLoadSize();
       break;
     }
+    case HSA_VEN_AMD_LOADER_LOADED_CODE_OBJECT_INFO_RELOCATION_COUNT: {
+      *((uint64_t*)value) = lcobj->getRelocationCount();
+      break;
+    }
+    case HSA_VEN_AMD_LOADER_LOADED_CODE_OBJECT_INFO_RELOCATION_TIME: {
+      *((uint64_t*)value) = lcobj->getRelocationTime();
+      break;
+    }
     default: {
       return HSA_STATUS_ERROR_INVALID_ARGUMENT;
     }
@@ -72,11 +72,14 @@ InterceptQueue::InterceptQueue(std::unique_ptr<Queue> queue)
       LocalSignal(0, false),
       DoorbellSignal(signal()),
       next_packet_(0),
+      overflow_head_(0),
+      overflow_tail_(0),
       retry_index_(0),
       quit_(false),
       active_(true) {
   buffer_ = SharedArray<AqlPacket, 4096>(wrapped->amd_queue_.hsa_queue.size);
   amd_queue_.hsa_queue.base_address = reinterpret_cast<void*>(&buffer_[0]);
+  overflow_.reset(new AqlPacket[wrapped->amd_queue_.hsa_queue.size]);
 
   // Match the queue's signal ABI block to async_doorbell_'s
   // This allows us to use the queue's signal ABI block from devices to trigger async_doorbell while
@@ -126,8 +129,83 @@ bool InterceptQueue::HandleAsyncDoorbell(hsa_signal_value_t value, void* arg) {
 
 void InterceptQueue::PacketWriter(const void* pkts, uint64_t pkt_count) {
   Cursor.interceptor_index--;
-  auto& handler = Cursor.queue->interceptors[Cursor.interceptor_index];
-  handler.first(pkts, pkt_count, Cursor.pkt_index, handler.second, PacketWriter);
+  auto& handler = Cursor.queue->chain_[Cursor.interceptor_index];
+  handler.handler(pkts, pkt_count, Cursor.pkt_index, handler.data, PacketWriter);
+}
+
+// Writer given to observing interceptors, whose output is ignored.
+static void DiscardWriter(const void* pkts, uint64_t pkt_count) {}
+
+bool InterceptQueue::SetInterceptorMode(hsa_amd_queue_intercept_handler interceptor, void* data,
+                                        hsa_amd_queue_intercept_mode_t mode) {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  for (size_t i = 1; i < interceptors.size(); i++) {
+    if (interceptors[i].handler == interceptor && interceptors[i].data == data) {
+      interceptors[i].mode = mode;
+      UpdateChain();
+      return true;
+    }
+  }
+  return false;
+}
+
+void InterceptQueue::UpdateChain() {
+  chain_.clear();
+  observers_.clear();
+  for (auto& interceptor : interceptors) {
+    if (interceptor.mode == HSA_AMD_QUEUE_INTERCEPT_MODE_REWRITE)
+      chain_.push_back(interceptor);
+    else if (interceptor.mode == HSA_AMD_QUEUE_INTERCEPT_MODE_OBSERVE)
+      observers_.push_back(interceptor);
+  }
+}
+
+uint64_t InterceptQueue::PassThrough(uint64_t index, uint64_t end) {
+  AqlPacket* ring = reinterpret_cast<AqlPacket*>(amd_queue_.hsa_queue.base_address);
+  uint64_t mask = wrapped->amd_queue_.hsa_queue.size - 1;
+
+  while (index < end) {
+    // Longest run of valid packets not wrapping around the ring.  Runs are kept to half the
+    // ring so a full hardware queue always drains enough to take a stashed run.
+    uint64_t run_end = Min(Min(end, (index | mask) + 1), index + (mask + 1) / 2);
+    uint64_t last = index;
+    while (last < run_end && ring[last & mask].IsValid()) last++;
+    if (last == index) break;
+
+    const AqlPacket* run = &ring[index & mask];
+    uint64_t count = last - index;
+
+    for (auto& observer : observers_)
+      observer.handler(run, count, index, observer.data, DiscardWriter);
+
+    Tracer& tracer = Runtime::runtime_singleton_->tracer();
+    if (tracer.enabled()) TraceDispatches(tracer, run, count, index);
+
+    // Stash what doesn't fit, a retry point was scheduled by Submit.
+    bool submitted = Submit(run, count);
+    if (!submitted) Stash(run, count);
+
+    for (uint64_t i = index; i < last; i++)
+      atomic::Store(&ring[i & mask].dispatch.header, kInvalidHeader, std::memory_order_release);
+    index = last;
+
+    if (!submitted) break;
+  }
+  return index;
+}
+
+void InterceptQueue::TraceDispatches(Tracer& tracer, const AqlPacket* packets, uint64_t count,
+                                     uint64_t index) {
+  hsa_amd_trace_record_t record = {};
+  record.kind = HSA_AMD_TRACE_RECORD_DISPATCH;
+  record.queue_id = amd_queue_.hsa_queue.id;
+  record.start = Tracer::Now();
+  for (uint64_t i = 0; i < count; i++) {
+    record.packet_id = index + i;
+    const bool dispatch = (packets[i].type() == HSA_PACKET_TYPE_KERNEL_DISPATCH);
+    record.kernel_object = dispatch ? packets[i].dispatch.kernel_object : 0;
+    tracer.Record(record);
+  }
 }
 
 void InterceptQueue::Submit(const void* pkts, uint64_t pkt_count, uint64_t user_pkt_index,
@@ -135,20 +213,79 @@ void InterceptQueue::Submit(const void* pkts, uint64_t pkt_count, uint64_t user_
   InterceptQueue* queue = reinterpret_cast<InterceptQueue*>(data);
   const AqlPacket* packets = (const AqlPacket*)pkts;
 
-  // Submit final packet transform to hardware.
-  if (queue->Submit(packets, pkt_count)) return;
+  // Submit final packet transform to hardware, unless earlier output is still waiting.
+  if (queue->OverflowEmpty() && queue->Submit(packets, pkt_count)) return;
 
   // Could not submit final packets, stash for later.
-  assert(queue->overflow_.empty() && "Packet intercept error: overflow buffer not empty.\n");
-  for (uint64_t i = 0; i < pkt_count; i++) queue->overflow_.push_back(packets[i]);
+  queue->Stash(packets, pkt_count);
+}
+
+void InterceptQueue::Stash(const AqlPacket* packets, uint64_t count) {
+  uint64_t size = wrapped->amd_queue_.hsa_queue.size;
+  uint64_t mask = size - 1;
+
+  while (count != 0) {
+    // A single packet's transform may exceed the ring, wait for the hardware to take some.
+    if (overflow_tail_ - overflow_head_ == size) {
+      AdaptiveWait backoff;
+      while (!DrainOverflow() && overflow_tail_ - overflow_head_ == size) backoff.Pause();
+      continue;
+    }
+
+    uint64_t room = size - (overflow_tail_ - overflow_head_);
+    uint64_t run = Min(Min(count, room), (overflow_tail_ | mask) + 1 - overflow_tail_);
+    for (uint64_t i = 0; i < run; i++) overflow_[(overflow_tail_ + i) & mask] = packets[i];
+    overflow_tail_ += run;
+    packets += run;
+    count -= run;
+  }
+}
+
+bool InterceptQueue::DrainOverflow() {
+  uint64_t mask = wrapped->amd_queue_.hsa_queue.size - 1;
+
+  while (!OverflowEmpty()) {
+    uint64_t run =
+        Min(overflow_tail_ - overflow_head_, (overflow_head_ | mask) + 1 - overflow_head_);
+    if (!Submit(&overflow_[overflow_head_ & mask], run)) return false;
+    overflow_head_ += run;
+  }
+  return true;
+}
+
+bool InterceptQueue::BeginCapture() {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  if (capture_ != nullptr) return false;
+
+  // Packets stashed before the capture still belong to hardware.
+  AdaptiveWait backoff;
+  while (!DrainOverflow()) backoff.Pause();
+
+  capture_.reset(new PacketGraph());
+  return true;
+}
+
+PacketGraph* InterceptQueue::EndCapture() {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  return capture_.release();
 }
 
 bool InterceptQueue::Submit(const AqlPacket* packets, uint64_t count) {
   if (count == 0) return true;
 
+  if (capture_ != nullptr) {
+    capture_->Record(packets, count);
+    return true;
+  }
+
   AqlPacket* ring = reinterpret_cast<AqlPacket*>(wrapped->amd_queue_.hsa_queue.base_address);
   uint64_t mask = wrapped->amd_queue_.hsa_queue.size - 1;
 
+  // Polls given to the hardware before deferring to the async doorbell.
+  static const uint32_t kRetryPolls = 128;
+  AdaptiveWait backoff;
+  uint32_t polls = 0;
+
   while (true) {
     uint64_t write = wrapped->LoadWriteIndexRelaxed();
     uint64_t read = wrapped->LoadReadIndexRelaxed();
@@ -156,12 +293,19 @@ bool InterceptQueue::Submit(const AqlPacket* packets, uint64_t count) {
 
     // If out of space defer packet insertion.
     if (free_slots <= count) {
+      // The packet processor is usually close behind, retry from this thread for a while.
+      if (polls++ < kRetryPolls) {
+        backoff.Pause();
+        continue;
+      }
+
       // If there is not already a pending retry point add one.
       if (retry_index_ <= read) {
         // Reserve and wait for one slot.
         write = wrapped->AddWriteIndexRelaxed(1);
         read = write - wrapped->amd_queue_.hsa_queue.size + 1;
-        while (wrapped->LoadReadIndexRelaxed() < read) os::YieldThread();
+        AdaptiveWait slot_backoff;
+        while (wrapped->LoadReadIndexRelaxed() < read) slot_backoff.Pause();
 
         // Submit barrer which will wake async queue processing.
         ring[write & mask].barrier_and = kBarrierPacket;
@@ -206,10 +350,18 @@ void InterceptQueue::StoreRelaxed(hsa_signal_value_t value) {
 
   ScopedAcquire<KernelMutex> lock(&lock_);
 
-  // Submit overflow packets.
-  if (!overflow_.empty()) {
-    if (!Submit(&overflow_[0], overflow_.size())) return;
-    overflow_.clear();
+  // Submit overflow packets, they precede anything still in the proxy ring.
+  if (!DrainOverflow()) return;
+
+  uint64_t end = LoadWriteIndexAcquire();
+
+  // Without rewriting interceptors packets are forwarded in runs.
+  if (chain_.size() == 1) {
+    Cursor.queue = this;
+    next_packet_ = PassThrough(next_packet_, end);
+    Cursor.queue = nullptr;
+    atomic::Store(&amd_queue_.read_dispatch_id, next_packet_, std::memory_order_release);
+    return;
   }
 
   Cursor.queue = this;
@@ -218,19 +370,28 @@ void InterceptQueue::StoreRelaxed(hsa_signal_value_t value) {
   uint64_t mask = wrapped->amd_queue_.hsa_queue.size - 1;
 
   // Loop over valid packets and process.
-  uint64_t end = LoadWriteIndexAcquire();
   uint64_t i;
   for (i = next_packet_; i < end; i++) {
     if (!ring[i & mask].IsValid()) break;
 
+    // Observers see the packets as written by the application.
+    for (auto& observer : observers_)
+      observer.handler(&ring[i & mask], 1, i, observer.data, DiscardWriter);
+
     // Process callbacks.
-    Cursor.interceptor_index = interceptors.size() - 1;
+    Cursor.interceptor_index = chain_.size() - 1;
     Cursor.pkt_index = i;
-    auto& handler = interceptors[Cursor.interceptor_index];
-    handler.first(&ring[i & mask], 1, i, handler.second, PacketWriter);
+    auto& handler = chain_[Cursor.interceptor_index];
+    handler.handler(&ring[i & mask], 1, i, handler.data, PacketWriter);
 
     // Invalidate consumed packet
     atomic::Store(&ring[i & mask].dispatch.header, kInvalidHeader, std::memory_order_release);
+
+    // Hardware is full, leave the remaining packets in the proxy ring until the retry.
+    if (!OverflowEmpty()) {
+      i++;
+      break;
+    }
   }
 
   next_packet_ = i;
@@ -0,0 +1,177 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "core/inc/interop_cache.h"
+
+#include <algorithm>
+
+#include "hsakmt.h"
+
+#include "core/inc/runtime.h"
+#include "core/util/os.h"
+
+namespace core {
+
+/// @brief Register and map the buffer of @p handle to @p nodes.
+static hsa_status_t RegisterBuffer(int handle, std::vector<uint32_t>& nodes,
+                                   HsaGraphicsResourceInfo& info) {
+  HSAuint32* node_ids = nodes.empty() ? NULL : reinterpret_cast<HSAuint32*>(&nodes[0]);
+  if (hsaKmtRegisterGraphicsHandleToNodes(handle, &info, nodes.size(), node_ids) !=
+      HSAKMT_STATUS_SUCCESS)
+    return HSA_STATUS_ERROR;
+
+  HSAuint64 altAddress;
+  HsaMemMapFlags map_flags;
+  map_flags.Value = 0;
+  map_flags.ui32.PageSize = HSA_PAGE_SIZE_64KB;
+  if (hsaKmtMapMemoryToGPUNodes(info.MemoryAddress, info.SizeInBytes, &altAddress, map_flags,
+                                nodes.size(), node_ids) != HSAKMT_STATUS_SUCCESS) {
+    map_flags.ui32.PageSize = HSA_PAGE_SIZE_4KB;
+    if (hsaKmtMapMemoryToGPUNodes(info.MemoryAddress, info.SizeInBytes, &altAddress, map_flags,
+                                  nodes.size(), node_ids) != HSAKMT_STATUS_SUCCESS) {
+      hsaKmtDeregisterMemory(info.MemoryAddress);
+      return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+    }
+  }
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t InteropCache::Map(int handle, const std::vector<uint32_t>& nodes, size_t* size,
+                               void** ptr, size_t* metadata_size, const void** metadata,
+                               bool& first) {
+  Key key;
+  key.nodes = nodes;
+  HsaGraphicsResourceInfo info;
+
+  // Buffers that can't be identified are mapped uncached.
+  if (!os::GetFileId(handle, key.device, key.inode)) {
+    hsa_status_t err = RegisterBuffer(handle, key.nodes, info);
+    if (err != HSA_STATUS_SUCCESS) return err;
+    *size = info.SizeInBytes;
+    *ptr = info.MemoryAddress;
+    if (metadata_size != NULL) *metadata_size = info.MetadataSizeInBytes;
+    if (metadata != NULL) *metadata = info.Metadata;
+    first = true;
+    return HSA_STATUS_SUCCESS;
+  }
+
+  std::sort(key.nodes.begin(), key.nodes.end());
+  key.nodes.erase(std::unique(key.nodes.begin(), key.nodes.end()), key.nodes.end());
+
+  ScopedAcquire<KernelMutex> lock(&lock_);
+
+  Mapping* mapping;
+  auto it = mappings_.find(key);
+  if (it != mappings_.end()) {
+    mapping = it->second.get();
+    if (mapping->refs == 0) idle_.erase(mapping->idle);
+    first = false;
+  } else {
+    hsa_status_t err = RegisterBuffer(handle, key.nodes, info);
+    if (err != HSA_STATUS_SUCCESS) return err;
+
+    mapping = new Mapping();
+    mapping->key = key;
+    mapping->ptr = info.MemoryAddress;
+    mapping->size = size_t(info.SizeInBytes);
+    mapping->metadata_size = size_t(info.MetadataSizeInBytes);
+    mapping->metadata = info.Metadata;
+    mapping->refs = 0;
+    mappings_[key].reset(mapping);
+    assert(by_ptr_.find(mapping->ptr) == by_ptr_.end() && "Interop mappings overlap.");
+    by_ptr_[mapping->ptr] = mapping;
+    first = true;
+  }
+
+  mapping->refs++;
+  *size = mapping->size;
+  *ptr = mapping->ptr;
+  if (metadata_size != NULL) *metadata_size = mapping->metadata_size;
+  if (metadata != NULL) *metadata = mapping->metadata;
+  return HSA_STATUS_SUCCESS;
+}
+
+bool InteropCache::Unmap(const void* ptr, hsa_status_t& status) {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+
+  auto it = by_ptr_.find(ptr);
+  if (it == by_ptr_.end()) return false;
+
+  // Idle mappings have no outstanding map to release.
+  Mapping* mapping = it->second;
+  if (mapping->refs == 0) {
+    status = HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    return true;
+  }
+
+  status = HSA_STATUS_SUCCESS;
+  if (--mapping->refs != 0) return true;
+
+  idle_.push_front(mapping);
+  mapping->idle = idle_.begin();
+  Trim();
+  return true;
+}
+
+void InteropCache::Flush() {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  while (!idle_.empty()) Evict(idle_.back());
+}
+
+void InteropCache::Trim() {
+  const size_t limit = Runtime::runtime_singleton_->flag().interop_cache_size();
+  while (idle_.size() > limit) Evict(idle_.back());
+}
+
+void InteropCache::Evict(Mapping* mapping) {
+  assert(mapping->refs == 0 && "Evicting a mapped buffer.");
+  idle_.erase(mapping->idle);
+
+  Runtime::runtime_singleton_->DeregisterPtrOwner(mapping->ptr);
+  hsaKmtUnmapMemoryToGPU(mapping->ptr);
+  hsaKmtDeregisterMemory(mapping->ptr);
+
+  by_ptr_.erase(mapping->ptr);
+  mappings_.erase(mappings_.find(mapping->key));
+}
+
+}  // namespace core
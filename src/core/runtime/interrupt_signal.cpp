@@ -48,24 +48,26 @@
 namespace core {
 
 HsaEvent* InterruptSignal::EventPool::alloc() {
-  ScopedAcquire<KernelMutex> lock(&lock_);
-  if (events_.empty()) {
-    if (!allEventsAllocated) {
-      HsaEvent* evt = InterruptSignal::CreateEvent(HSA_EVENTTYPE_SIGNAL, false);
-      if (evt == nullptr) allEventsAllocated = true;
-      return evt;
-    }
-    return nullptr;
+  HsaEvent* ret;
+  if (events_.Get(ret)) return ret;
+  if (!allEventsAllocated.load(std::memory_order_relaxed)) {
+    HsaEvent* evt = InterruptSignal::CreateEvent(HSA_EVENTTYPE_SIGNAL, false);
+    if (evt == nullptr) allEventsAllocated.store(true, std::memory_order_relaxed);
+    return evt;
   }
-  HsaEvent* ret = events_.back().release();
-  events_.pop_back();
-  return ret;
+  return nullptr;
 }
 
 void InterruptSignal::EventPool::free(HsaEvent* evt) {
   if (evt == nullptr) return;
-  ScopedAcquire<KernelMutex> lock(&lock_);
-  events_.push_back(unique_event_ptr(evt));
+  events_.Put(evt);
+}
+
+void InterruptSignal::EventPool::clear() {
+  std::vector<HsaEvent*> events;
+  events_.Drain(events);
+  for (HsaEvent* evt : events) DestroyEvent(evt);
+  allEventsAllocated.store(false, std::memory_order_relaxed);
 }
 
 int InterruptSignal::rtti_id_ = 0;
@@ -141,29 +143,33 @@ hsa_signal_value_t InterruptSignal::WaitRelaxed(
   Retain();
   MAKE_SCOPE_GUARD([&]() { Release(); });
 
-  uint32_t prior = waiting_++;
+  waiting_++;
   MAKE_SCOPE_GUARD([&]() { waiting_--; });
-  // Allow only the first waiter to sleep (temporary, known to be bad).
-  if (prior != 0) wait_hint = HSA_WAIT_STATE_ACTIVE;
 
   int64_t value;
 
   timer::fast_clock::time_point start_time = timer::fast_clock::now();
 
-  // Set a polling timeout value
-  // Should be a few times bigger than null kernel latency
-  const timer::fast_clock::duration kMaxElapsed = std::chrono::microseconds(200);
-
-  uint64_t hsa_freq;
-  HSA::hsa_system_get_info(HSA_SYSTEM_INFO_TIMESTAMP_FREQUENCY, &hsa_freq);
+  const uint64_t hsa_freq = Runtime::runtime_singleton_->sys_clock_freq();
   const timer::fast_clock::duration fast_timeout =
       timer::duration_from_seconds<timer::fast_clock::duration>(
           double(timeout) / double(hsa_freq));
 
+  // Poll only as long as waits on this signal usually take.
+  const timer::fast_clock::duration spin =
+      (wait_hint == HSA_WAIT_STATE_ACTIVE) ? fast_timeout : wait_policy_.Spin();
+
+  uint32_t sleeps = 0;
+  timer::fast_clock::duration sleep_time(0);
+  SpinBackoff backoff;
   bool condition_met = false;
   while (true) {
     if (!IsValid()) return 0;
 
+    // Sampled before the value so a wake between the check and the sleep is
+    // not lost.
+    const uint32_t wake_seq = atomic::Load(&wake_seq_, std::memory_order_acquire);
+
     value = atomic::Load(&signal_.value, std::memory_order_relaxed);
 
     switch (condition) {
@@ -186,20 +192,20 @@ hsa_signal_value_t InterruptSignal::WaitRelaxed(
       default:
         return 0;
     }
-    if (condition_met) return hsa_signal_value_t(value);
+    if (condition_met) {
+      wait_policy_.Record(true, timer::fast_clock::now() - start_time, sleeps, sleep_time);
+      return hsa_signal_value_t(value);
+    }
 
     timer::fast_clock::time_point time = timer::fast_clock::now();
     if (time - start_time > fast_timeout) {
+      wait_policy_.Record(false, time - start_time, sleeps, sleep_time);
       value = atomic::Load(&signal_.value, std::memory_order_relaxed);
       return hsa_signal_value_t(value);
     }
-    
-    if (wait_hint == HSA_WAIT_STATE_ACTIVE) {
-      continue;
-    }
 
-    if (time - start_time < kMaxElapsed) {
-    //  os::uSleep(20);
+    if (time - start_time < spin) {
+      backoff.Pause();
       continue;
     }
 
@@ -208,7 +214,16 @@ hsa_signal_value_t InterruptSignal::WaitRelaxed(
     uint64_t ct=timer::duration_cast<std::chrono::milliseconds>(
       time_remaining).count();
     wait_ms = (ct>0xFFFFFFFEu) ? 0xFFFFFFFEu : ct;
-    hsaKmtWaitOnEvent(event_, wait_ms);
+
+    // One waiter sleeps on the event and wakes the rest when it returns.
+    if (AcquireEventSleep()) {
+      hsaKmtWaitOnEvent(event_, wait_ms);
+      ReleaseEventSleep();
+    } else {
+      os::WaitOnAddress(&wake_seq_, wake_seq, wait_ms);
+    }
+    sleep_time += timer::fast_clock::now() - time;
+    sleeps++;
   }
 }
 
@@ -0,0 +1,167 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "core/inc/ipc_cache.h"
+
+#include <algorithm>
+
+#include "hsakmt.h"
+
+#include "core/inc/runtime.h"
+
+namespace core {
+
+hsa_status_t IpcCache::Attach(const hsa_amd_ipc_memory_t& handle,
+                              const std::vector<uint32_t>& nodes, size_t offset, void** ptr,
+                              size_t* size, const std::function<void(void*, size_t)>& first) {
+  Key key(std::vector<uint32_t>(handle.handle,
+                                handle.handle + sizeof(handle.handle) / sizeof(handle.handle[0])),
+          nodes);
+  std::sort(key.second.begin(), key.second.end());
+  key.second.erase(std::unique(key.second.begin(), key.second.end()), key.second.end());
+
+  ScopedAcquire<KernelMutex> lock(&lock_);
+
+  Import* import;
+  auto it = imports_.find(key);
+  if (it != imports_.end()) {
+    import = it->second.get();
+    if (offset >= import->size) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    if (import->refs == 0) idle_.erase(import->idle);
+  } else {
+    const HsaSharedMemoryHandle* shared = reinterpret_cast<const HsaSharedMemoryHandle*>(&handle);
+    void* base;
+    HSAuint64 base_size;
+    HSAuint64 alternate_va;
+
+    if (nodes.empty()) {
+      if (hsaKmtRegisterSharedHandle(shared, &base, &base_size) != HSAKMT_STATUS_SUCCESS)
+        return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+      if (hsaKmtMapMemoryToGPU(base, base_size, &alternate_va) != HSAKMT_STATUS_SUCCESS) {
+        hsaKmtDeregisterMemory(base);
+        return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+      }
+    } else {
+      std::vector<HSAuint32> kfd_nodes(key.second.begin(), key.second.end());
+      if (hsaKmtRegisterSharedHandleToNodes(shared, &base, &base_size, kfd_nodes.size(),
+                                            &kfd_nodes[0]) != HSAKMT_STATUS_SUCCESS)
+        return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+      HsaMemMapFlags map_flags;
+      map_flags.Value = 0;
+      map_flags.ui32.PageSize = HSA_PAGE_SIZE_64KB;
+      if (hsaKmtMapMemoryToGPUNodes(base, base_size, &alternate_va, map_flags, kfd_nodes.size(),
+                                    &kfd_nodes[0]) != HSAKMT_STATUS_SUCCESS) {
+        map_flags.ui32.PageSize = HSA_PAGE_SIZE_4KB;
+        if (hsaKmtMapMemoryToGPUNodes(base, base_size, &alternate_va, map_flags,
+                                      kfd_nodes.size(), &kfd_nodes[0]) != HSAKMT_STATUS_SUCCESS) {
+          hsaKmtDeregisterMemory(base);
+          return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+        }
+      }
+    }
+
+    if (offset >= base_size) {
+      hsaKmtUnmapMemoryToGPU(base);
+      hsaKmtDeregisterMemory(base);
+      return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    }
+
+    import = new Import();
+    import->key = key;
+    import->base = base;
+    import->size = size_t(base_size);
+    import->refs = 0;
+    imports_[key].reset(import);
+  }
+
+  import->refs++;
+  *ptr = reinterpret_cast<uint8_t*>(import->base) + offset;
+  *size = import->size;
+
+  Attachment& attachment = attached_[*ptr];
+  attachment.import = import;
+  if (attachment.count++ == 0) first(*ptr, *size);
+  return HSA_STATUS_SUCCESS;
+}
+
+bool IpcCache::Detach(const void* ptr, const std::function<void()>& last) {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+
+  auto attached = attached_.find(ptr);
+  if (attached == attached_.end()) return false;
+
+  Import* import = attached->second.import;
+  if (--attached->second.count == 0) {
+    attached_.erase(attached);
+    last();
+  }
+
+  if (--import->refs != 0) return true;
+
+  idle_.push_front(import);
+  import->idle = idle_.begin();
+  Trim();
+  return true;
+}
+
+void IpcCache::Flush() {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  while (!idle_.empty()) Evict(idle_.back());
+}
+
+void IpcCache::Trim() {
+  const size_t limit = Runtime::runtime_singleton_->flag().ipc_cache_size();
+  while (idle_.size() > limit) Evict(idle_.back());
+}
+
+void IpcCache::Evict(Import* import) {
+  assert(import->refs == 0 && "Evicting an attached import.");
+  idle_.erase(import->idle);
+
+  hsaKmtUnmapMemoryToGPU(import->base);
+  hsaKmtDeregisterMemory(import->base);
+
+  imports_.erase(imports_.find(import->key));
+}
+
+}  // namespace core
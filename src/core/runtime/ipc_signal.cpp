@@ -50,7 +50,8 @@
 namespace core {
 
 int IPCSignal::rtti_id_ = 0;
-KernelMutex IPCSignal::lock_;
+KernelMutex IPCSignal::lock_("IPCSignal::lock_");
+std::map<hsa_amd_ipc_signal_t, hsa_signal_t, IPCSignal::HandleLess> IPCSignal::attached_;
 
 SharedMemory::SharedMemory(const hsa_amd_ipc_memory_t* handle, size_t len) {
   hsa_status_t err = Runtime::runtime_singleton_->IPCAttach(handle, len, 0, NULL, &ptr_);
@@ -77,6 +78,15 @@ void IPCSignal::CreateHandle(Signal* signal, hsa_amd_ipc_signal_t* ipc_handle) {
 }
 
 Signal* IPCSignal::Attach(const hsa_amd_ipc_signal_t* ipc_signal_handle) {
+  {
+    ScopedAcquire<KernelMutex> lock(&lock_);
+    auto it = attached_.find(*ipc_signal_handle);
+    if (it != attached_.end()) {
+      Signal* ret = core::Signal::DuplicateHandle(it->second);
+      if (ret != nullptr) return ret;
+    }
+  }
+
   SharedMemorySignal shared(ipc_signal_handle);
 
   if (!(shared.signal()->IsIPC()))
@@ -87,8 +97,19 @@ Signal* IPCSignal::Attach(const hsa_amd_ipc_signal_t* ipc_signal_handle) {
 
   ScopedAcquire<KernelMutex> lock(&lock_);
   Signal* ret = core::Signal::DuplicateHandle(handle);
-  if (ret == nullptr) ret = new IPCSignal(std::move(shared));
+  if (ret == nullptr) {
+    ret = new IPCSignal(std::move(shared), *ipc_signal_handle);
+    attached_[*ipc_signal_handle] = handle;
+  }
   return ret;
 }
 
+IPCSignal::~IPCSignal() {
+  // Only drop our own entry, the handle may have been attached again while this signal was
+  // being released.
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  auto it = attached_.find(ipc_handle_);
+  if ((it != attached_.end()) && (it->second.handle == Convert(this).handle)) attached_.erase(it);
+}
+
 }  // namespace core
@@ -179,6 +179,20 @@ hsa_round_method_t Isa::GetRoundMethod(
   return HSA_ROUND_METHOD_SINGLE;
 }
 
+namespace {
+
+/// @returns True if code for @p code_object_isa runs on @p agent_isa.
+bool RunsOn(const Isa &code_object_isa, const Isa &agent_isa) {
+  // SRAM ECC enabled code may run on a system without ECC
+  // but a system which has ECC enabled requires ECC enabled code.
+  if (agent_isa.sramEccEnabled() && !code_object_isa.sramEccEnabled())
+    return false;
+
+  return agent_isa.version() == code_object_isa.version();
+}
+
+}  // namespace anonymous
+
 const Isa *IsaRegistry::GetIsa(const std::string &full_name) {
   auto isareg_iter = supported_isas_.find(full_name);
   return isareg_iter == supported_isas_.end() ? nullptr : &isareg_iter->second;
@@ -217,6 +231,21 @@ const IsaRegistry::IsaMap IsaRegistry::GetSupportedIsas() {
   ISAREG_ENTRY_GEN(9, 0, 6, false, false)
   ISAREG_ENTRY_GEN(9, 0, 6, false, true )
 
+  // Intern the Isas and precompute which code objects run on which agents,
+  // which saves comparing names or versions on every code object load.
+  uint32_t id = 0;
+  for (auto &isa : supported_isas) {
+    isa.second.id_ = id++;
+  }
+  assert(id <= 64 && "Isa ids must fit Isa::supported_isas_");
+  for (auto &agent_isa : supported_isas) {
+    for (const auto &code_object_isa : supported_isas) {
+      if (RunsOn(code_object_isa.second, agent_isa.second)) {
+        agent_isa.second.supported_isas_ |= uint64_t(1) << code_object_isa.second.id_;
+      }
+    }
+  }
+
   return supported_isas;
 }
 
@@ -0,0 +1,145 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "core/inc/launch_template.h"
+
+#include <cstring>
+
+#include "core/inc/runtime.h"
+#include "core/util/atomic_helpers.h"
+
+namespace core {
+
+hsa_status_t LaunchTemplate::Create(Queue* queue, hsa_executable_symbol_t kernel,
+                                    const hsa_kernel_dispatch_packet_t& dispatch,
+                                    LaunchTemplate*& launch) {
+  const uint16_t type = (dispatch.header >> HSA_PACKET_HEADER_TYPE) &
+      ((1 << HSA_PACKET_HEADER_WIDTH_TYPE) - 1);
+  if (type != HSA_PACKET_TYPE_KERNEL_DISPATCH) return HSA_STATUS_ERROR_INVALID_PACKET_FORMAT;
+
+  hsa_symbol_kind_t kind;
+  if (HSA::hsa_executable_symbol_get_info(kernel, HSA_EXECUTABLE_SYMBOL_INFO_TYPE, &kind) !=
+          HSA_STATUS_SUCCESS ||
+      kind != HSA_SYMBOL_KIND_KERNEL)
+    return HSA_STATUS_ERROR_INVALID_EXECUTABLE_SYMBOL;
+
+  uint64_t kernel_object;
+  uint32_t kernarg_size, kernarg_align, group_size, private_size;
+  hsa_agent_t agent_handle;
+  const struct {
+    hsa_executable_symbol_info_t attribute;
+    void* value;
+  } queries[] = {
+      {HSA_EXECUTABLE_SYMBOL_INFO_KERNEL_OBJECT, &kernel_object},
+      {HSA_EXECUTABLE_SYMBOL_INFO_KERNEL_KERNARG_SEGMENT_SIZE, &kernarg_size},
+      {HSA_EXECUTABLE_SYMBOL_INFO_KERNEL_KERNARG_SEGMENT_ALIGNMENT, &kernarg_align},
+      {HSA_EXECUTABLE_SYMBOL_INFO_KERNEL_GROUP_SEGMENT_SIZE, &group_size},
+      {HSA_EXECUTABLE_SYMBOL_INFO_KERNEL_PRIVATE_SEGMENT_SIZE, &private_size},
+      {HSA_EXECUTABLE_SYMBOL_INFO_AGENT, &agent_handle}};
+  for (const auto& query : queries) {
+    hsa_status_t err = HSA::hsa_executable_symbol_get_info(kernel, query.attribute, query.value);
+    if (err != HSA_STATUS_SUCCESS) return err;
+  }
+
+  const Agent* agent = Agent::Convert(agent_handle);
+  if (agent == nullptr || !agent->IsValid()) return HSA_STATUS_ERROR_INVALID_AGENT;
+
+  hsa_kernel_dispatch_packet_t packet = dispatch;
+  packet.kernel_object = kernel_object;
+  packet.group_segment_size = Max(packet.group_segment_size, group_size);
+  packet.private_segment_size = Max(packet.private_segment_size, private_size);
+  packet.kernarg_address = nullptr;
+  packet.reserved2 = 0;
+  packet.completion_signal.handle = 0;
+
+  // Packet indices select the slot, so the count is a power of two.
+  const uint64_t slots = uint64_t(queue->amd_queue_.hsa_queue.size) * 2;
+  const size_t stride = AlignUp(size_t(Max(kernarg_size, 1u)), size_t(Max(kernarg_align, 16u)));
+  uint8_t* kernargs = reinterpret_cast<uint8_t*>(Runtime::runtime_singleton_->AllocateNearSystemMemory(
+      *agent, slots * stride, MemoryRegion::AllocateNoFlags));
+  if (kernargs == nullptr) return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+
+  launch = new LaunchTemplate(queue, packet, kernargs, kernarg_size, stride, slots - 1);
+  return HSA_STATUS_SUCCESS;
+}
+
+LaunchTemplate::LaunchTemplate(Queue* queue, const hsa_kernel_dispatch_packet_t& packet,
+                               uint8_t* kernargs, uint32_t kernarg_size, size_t kernarg_stride,
+                               uint64_t kernarg_mask)
+    : queue_(queue),
+      packet_(packet),
+      kernargs_(kernargs),
+      kernarg_size_(kernarg_size),
+      kernarg_stride_(kernarg_stride),
+      kernarg_mask_(kernarg_mask) {}
+
+LaunchTemplate::~LaunchTemplate() { Runtime::runtime_singleton_->FreeMemory(kernargs_); }
+
+hsa_status_t LaunchTemplate::Launch(const void* kernarg, hsa_signal_t completion_signal) {
+  uint64_t index;
+  hsa_status_t err = ReservePackets(queue_, 1, UINT64_MAX, index);
+  if (err != HSA_STATUS_SUCCESS) return err;
+
+  uint8_t* args = &kernargs_[(index & kernarg_mask_) * kernarg_stride_];
+  if (kernarg_size_ != 0) memcpy(args, kernarg, kernarg_size_);
+
+  hsa_kernel_dispatch_packet_t* ring =
+      reinterpret_cast<hsa_kernel_dispatch_packet_t*>(queue_->amd_queue_.hsa_queue.base_address);
+  hsa_kernel_dispatch_packet_t& slot = ring[index & (queue_->amd_queue_.hsa_queue.size - 1)];
+
+  // Body first, leaving the header invalid, then header and setup in one store.
+  atomic::Store(&slot.header, uint16_t(HSA_PACKET_TYPE_INVALID << HSA_PACKET_HEADER_TYPE),
+                std::memory_order_relaxed);
+  memcpy(reinterpret_cast<uint8_t*>(&slot) + sizeof(uint32_t),
+         reinterpret_cast<const uint8_t*>(&packet_) + sizeof(uint32_t),
+         sizeof(packet_) - sizeof(uint32_t));
+  slot.kernarg_address = args;
+  slot.completion_signal = completion_signal;
+
+  const uint32_t header_setup = *reinterpret_cast<const uint32_t*>(&packet_);
+  atomic::Store(reinterpret_cast<uint32_t*>(&slot), header_setup, std::memory_order_release);
+
+  HSA::hsa_signal_store_screlease(queue_->amd_queue_.hsa_queue.doorbell_signal, index);
+  return HSA_STATUS_SUCCESS;
+}
+
+}  // namespace core
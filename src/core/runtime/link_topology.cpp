@@ -0,0 +1,209 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "core/inc/link_topology.h"
+
+#include <algorithm>
+
+#include "core/inc/agent.h"
+#include "core/inc/amd_gpu_agent.h"
+#include "core/inc/amd_memory_region.h"
+#include "core/inc/default_signal.h"
+#include "core/inc/runtime.h"
+#include "core/util/os.h"
+
+namespace core {
+
+namespace {
+// Typical bandwidth, in MB/s, and latency, in ns, of links reported without them.
+void LinkDefaults(hsa_amd_link_info_type_t type, uint64_t& bandwidth, uint32_t& latency) {
+  switch (type) {
+    case HSA_AMD_LINK_INFO_TYPE_XGMI:
+      bandwidth = 25000;
+      latency = 500;
+      break;
+    case HSA_AMD_LINK_INFO_TYPE_HYPERTRANSPORT:
+    case HSA_AMD_LINK_INFO_TYPE_QPI:
+      bandwidth = 19200;
+      latency = 300;
+      break;
+    case HSA_AMD_LINK_INFO_TYPE_INFINBAND:
+      bandwidth = 12500;
+      latency = 2000;
+      break;
+    case HSA_AMD_LINK_INFO_TYPE_PCIE:
+    default:
+      bandwidth = 16000;
+      latency = 1000;
+      break;
+  }
+}
+}  // namespace
+
+void LinkTopology::Reset(size_t num_nodes) {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  num_nodes_ = num_nodes;
+  costs_.clear();
+  built_ = false;
+}
+
+LinkTopology::Cost LinkTopology::Get(uint32_t node_from, uint32_t node_to) {
+  {
+    ScopedAcquire<KernelMutex> lock(&lock_);
+    if (!built_) Build();
+  }
+
+  // Calibration copies query costs themselves, so run it unlocked and only once.
+  if (Runtime::runtime_singleton_->flag().link_calibration() && !calibrating_.exchange(true))
+    Calibrate();
+
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  if ((node_from >= num_nodes_) || (node_to >= num_nodes_)) {
+    Cost none = {0, 0, 0, false};
+    return none;
+  }
+  return costs_[node_from * num_nodes_ + node_to];
+}
+
+void LinkTopology::Build() {
+  const size_t n = num_nodes_;
+  const Cost none = {0, 0, 0, false};
+  costs_.assign(n * n, none);
+
+  for (uint32_t from = 0; from < n; from++) {
+    for (uint32_t to = 0; to < n; to++) {
+      if (from == to) continue;
+      const Runtime::LinkInfo link = Runtime::runtime_singleton_->GetLinkInfo(from, to);
+      if (link.num_hop == 0) continue;
+
+      Cost& cost = costs_[from * n + to];
+      LinkDefaults(link.info.link_type, cost.bandwidth, cost.latency);
+      if (link.info.max_bandwidth != 0) cost.bandwidth = link.info.max_bandwidth;
+      if (link.info.min_latency != 0) cost.latency = link.info.min_latency;
+      cost.hops = 1;
+    }
+  }
+
+  // Floyd-Warshall, preferring fewer links then more bandwidth.
+  for (size_t via = 0; via < n; via++) {
+    for (size_t from = 0; from < n; from++) {
+      const Cost& first = costs_[from * n + via];
+      if ((from == via) || (first.hops == 0)) continue;
+      for (size_t to = 0; to < n; to++) {
+        const Cost& second = costs_[via * n + to];
+        if ((to == via) || (to == from) || (second.hops == 0)) continue;
+
+        Cost path;
+        path.hops = first.hops + second.hops;
+        path.latency = first.latency + second.latency;
+        path.bandwidth = std::min(first.bandwidth, second.bandwidth);
+        path.calibrated = false;
+
+        Cost& best = costs_[from * n + to];
+        if ((best.hops == 0) || (path.hops < best.hops) ||
+            ((path.hops == best.hops) && (path.bandwidth > best.bandwidth)))
+          best = path;
+      }
+    }
+  }
+
+  built_ = true;
+}
+
+uint64_t LinkTopology::TimeCopy(Agent* gpu, void* dst, Agent& dst_agent, const void* src,
+                                Agent& src_agent) {
+  unique_signal_ptr signal(new DefaultSignal(1));
+  std::vector<Signal*> no_deps;
+  const uint64_t start = os::ReadAccurateClock();
+  if (gpu->DmaCopy(dst, dst_agent, src, src_agent, kCalibrationSize, no_deps, *signal) !=
+      HSA_STATUS_SUCCESS)
+    return 0;
+  signal->WaitRelaxed(HSA_SIGNAL_CONDITION_EQ, 0, -1, HSA_WAIT_STATE_BLOCKED);
+  const uint64_t ticks = os::ReadAccurateClock() - start;
+  if (ticks == 0) return 0;
+  const double seconds = double(ticks) / double(os::AccurateClockFrequency());
+  return uint64_t(double(kCalibrationSize) / seconds / (1024.0 * 1024.0));
+}
+
+void LinkTopology::Calibrate() {
+  Runtime* runtime = Runtime::runtime_singleton_;
+  for (Agent* agent : runtime->gpu_agents()) {
+    amd::GpuAgent* gpu = static_cast<amd::GpuAgent*>(agent);
+    if (gpu->local_region() == nullptr) continue;
+    Agent* cpu = runtime->GetNearestCpuAgent(*gpu);
+
+    void* system = runtime->AllocateNearSystemMemory(*gpu, kCalibrationSize,
+                                                     MemoryRegion::AllocateNoFlags);
+    if (system == nullptr) continue;
+    MAKE_SCOPE_GUARD([&]() { runtime->system_deallocator()(system); });
+
+    void* local = nullptr;
+    if (runtime->AllocateMemory(gpu->local_region(), kCalibrationSize,
+                                MemoryRegion::AllocateNoFlags, &local) != HSA_STATUS_SUCCESS)
+      continue;
+    MAKE_SCOPE_GUARD([&]() { runtime->FreeMemory(local); });
+
+    // The first copy of each direction warms up the engine and the page tables.
+    TimeCopy(gpu, local, *gpu, system, *cpu);
+    const uint64_t h2d = TimeCopy(gpu, local, *gpu, system, *cpu);
+    TimeCopy(gpu, system, *cpu, local, *gpu);
+    const uint64_t d2h = TimeCopy(gpu, system, *cpu, local, *gpu);
+
+    ScopedAcquire<KernelMutex> lock(&lock_);
+    if (!built_) Build();
+    const uint32_t g = gpu->node_id();
+    const uint32_t c = cpu->node_id();
+    if ((g >= num_nodes_) || (c >= num_nodes_)) continue;
+    Cost& to_gpu = costs_[c * num_nodes_ + g];
+    Cost& to_cpu = costs_[g * num_nodes_ + c];
+    if (h2d != 0) {
+      to_gpu.bandwidth = h2d;
+      to_gpu.calibrated = true;
+    }
+    if (d2h != 0) {
+      to_cpu.bandwidth = d2h;
+      to_cpu.calibrated = true;
+    }
+  }
+}
+
+}  // namespace core
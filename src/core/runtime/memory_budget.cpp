@@ -0,0 +1,128 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "core/inc/memory_budget.h"
+
+#include "core/inc/memory_region.h"
+
+namespace core {
+
+static thread_local uint32_t ThreadAccountingTag = 0;
+
+void MemoryBudget::SetThreadTag(uint32_t tag) { ThreadAccountingTag = tag; }
+
+uint32_t MemoryBudget::ThreadTag() { return ThreadAccountingTag; }
+
+hsa_status_t MemoryBudget::Charge(uint32_t tag, const MemoryRegion* region, size_t size) {
+  const hsa_region_t handle = MemoryRegion::Convert(region);
+  const hsa_amd_memory_pool_t pool = {handle.handle};
+
+  while (true) {
+    hsa_amd_memory_budget_callback_t callback;
+    void* data;
+    uint32_t over_tag;
+    size_t used, limit;
+    {
+      ScopedAcquire<KernelMutex> lock(&lock_);
+      Account& account = accounts_[Key(tag, region)];
+      Account& total = accounts_[Key(HSA_AMD_MEMORY_TAG_ALL, region)];
+
+      // Check the tag's own budget first, the callback it installed knows what it may evict.
+      Account* over = nullptr;
+      if (size > account.limit || account.used > account.limit - size)
+        over = &account;
+      else if (size > total.limit || total.used > total.limit - size)
+        over = &total;
+
+      if (over == nullptr) {
+        for (Account* charged : {&account, &total}) {
+          charged->used += size;
+          charged->peak = Max(charged->peak, charged->used);
+          charged->allocations++;
+        }
+        return HSA_STATUS_SUCCESS;
+      }
+
+      callback = over->callback;
+      data = over->data;
+      over_tag = (over == &account) ? tag : HSA_AMD_MEMORY_TAG_ALL;
+      used = over->used;
+      limit = over->limit;
+    }
+
+    // The callback runs unlocked so that it can free memory.
+    if (callback == nullptr || !callback(over_tag, pool, size, used, limit, data))
+      return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+  }
+}
+
+void MemoryBudget::Release(uint32_t tag, const MemoryRegion* region, size_t size) {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  for (uint32_t key : {tag, uint32_t(HSA_AMD_MEMORY_TAG_ALL)}) {
+    Account& account = accounts_[Key(key, region)];
+    assert(account.used >= size && account.allocations != 0 && "Unbalanced memory budget release.");
+    account.used -= size;
+    account.allocations--;
+  }
+}
+
+void MemoryBudget::SetLimit(uint32_t tag, const MemoryRegion* region, size_t limit,
+                            hsa_amd_memory_budget_callback_t callback, void* data) {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  Account& account = accounts_[Key(tag, region)];
+  account.limit = limit;
+  account.callback = callback;
+  account.data = data;
+}
+
+void MemoryBudget::GetUsage(uint32_t tag, const MemoryRegion* region,
+                            hsa_amd_memory_usage_t* usage) {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  const auto it = accounts_.find(Key(tag, region));
+  const Account account = (it == accounts_.end()) ? Account() : it->second;
+  usage->used = account.used;
+  usage->peak = account.peak;
+  usage->limit = account.limit;
+  usage->allocations = account.allocations;
+}
+
+}  // namespace core
@@ -0,0 +1,103 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "core/inc/packet_graph.h"
+
+#include "core/inc/default_signal.h"
+#include "core/inc/runtime.h"
+
+namespace core {
+
+static const uint16_t kBarrierHeader = (HSA_PACKET_TYPE_BARRIER_AND << HSA_PACKET_HEADER_TYPE) |
+    (1 << HSA_PACKET_HEADER_BARRIER) |
+    (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_SCACQUIRE_FENCE_SCOPE) |
+    (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_SCRELEASE_FENCE_SCOPE);
+
+PacketGraph::PacketGraph() : done_(new DefaultSignal(0)) {}
+
+PacketGraph::~PacketGraph() {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  done_->WaitRelaxed(HSA_SIGNAL_CONDITION_EQ, 0, uint64_t(-1), HSA_WAIT_STATE_BLOCKED);
+}
+
+void PacketGraph::Record(const AqlPacket* packets, uint64_t count) {
+  for (uint64_t i = 0; i < count; i++) {
+    packets_.push_back(packets[i]);
+
+    // Completion signals share one offset in every packet type.
+    const hsa_signal_t signal = packets[i].dispatch.completion_signal;
+    if (signal.handle == 0) continue;
+    bool known = false;
+    for (const auto& entry : signals_) known |= (entry.first.handle == signal.handle);
+    if (!known) signals_.push_back(std::make_pair(signal, Signal::Convert(signal)->LoadRelaxed()));
+  }
+}
+
+hsa_status_t PacketGraph::Launch(Queue* queue, hsa_signal_t completion_signal) {
+  const uint64_t size = queue->amd_queue_.hsa_queue.size;
+
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  done_->WaitRelaxed(HSA_SIGNAL_CONDITION_EQ, 0, uint64_t(-1), HSA_WAIT_STATE_BLOCKED);
+
+  for (const auto& entry : signals_) Signal::Convert(entry.first)->StoreRelaxed(entry.second);
+  done_->StoreRelaxed(1);
+
+  // Half queue batches keep the submission going while the packet processor drains the ring.
+  const uint64_t batch = Max(size / 2, uint64_t(1));
+  for (size_t i = 0; i < packets_.size(); i += batch) {
+    const uint32_t count = uint32_t(Min(uint64_t(packets_.size() - i), batch));
+    hsa_status_t err = SubmitPackets(queue, &packets_[i], count, UINT64_MAX);
+    assert(err == HSA_STATUS_SUCCESS && "Batch within queue size failed.");
+  }
+
+  AqlPacket tail = {};
+  tail.barrier_and.header = kBarrierHeader;
+  tail.barrier_and.completion_signal = Signal::Convert(done_.get());
+  hsa_status_t err = SubmitPackets(queue, &tail, 1, UINT64_MAX);
+  assert(err == HSA_STATUS_SUCCESS && "Single packet submission failed.");
+  if (completion_signal.handle == 0) return err;
+
+  tail.barrier_and.completion_signal = completion_signal;
+  return SubmitPackets(queue, &tail, 1, UINT64_MAX);
+}
+
+}  // namespace core
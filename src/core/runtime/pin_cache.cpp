@@ -0,0 +1,220 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "core/inc/pin_cache.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "core/inc/amd_memory_region.h"
+#include "core/inc/runtime.h"
+
+namespace core {
+
+bool PinCache::enabled() const {
+  return Runtime::runtime_singleton_->flag().pin_cache_size() != 0;
+}
+
+PinCache::RangeMap::iterator PinCache::FirstOverlap(uintptr_t addr) {
+  RangeMap::iterator it = ranges_.upper_bound(addr);
+  if (it != ranges_.begin()) {
+    RangeMap::iterator prev = it;
+    --prev;
+    if (prev->second->base + prev->second->size > addr) return prev;
+  }
+  return it;
+}
+
+bool PinCache::Lock(const amd::MemoryRegion& region, const std::vector<uint32_t>& nodes,
+                    void* host_ptr, size_t size, void** agent_ptr, hsa_status_t& status) {
+  const uintptr_t start = reinterpret_cast<uintptr_t>(host_ptr);
+  const uintptr_t base = AlignDown(start, 4096);
+  const uintptr_t end = AlignUp(start + size, 4096);
+
+  std::vector<uint32_t> sorted_nodes(nodes);
+  std::sort(sorted_nodes.begin(), sorted_nodes.end());
+  sorted_nodes.erase(std::unique(sorted_nodes.begin(), sorted_nodes.end()), sorted_nodes.end());
+
+  ScopedAcquire<KernelMutex> lock(&lock_);
+
+  RangeMap::iterator it = FirstOverlap(base);
+  Range* range = nullptr;
+  if (it != ranges_.end() && it->second->base <= base &&
+      it->second->base + it->second->size >= end && it->second->region == &region &&
+      !it->second->stale) {
+    range = it->second.get();
+
+    // Extend the mapping to any new nodes.
+    if (!std::includes(range->nodes.begin(), range->nodes.end(), sorted_nodes.begin(),
+                       sorted_nodes.end())) {
+      std::vector<uint32_t> merged;
+      std::set_union(range->nodes.begin(), range->nodes.end(), sorted_nodes.begin(),
+                     sorted_nodes.end(), std::back_inserter(merged));
+      uint64_t alternate_va = 0;
+      if (!amd::MemoryRegion::MakeKfdMemoryResident(
+              merged.size(), &merged[0], reinterpret_cast<void*>(range->base), range->size,
+              &alternate_va, region.map_flag())) {
+        status = HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+        return true;
+      }
+      range->nodes.swap(merged);
+    }
+
+    if (range->refs++ == 0) {
+      idle_.erase(range->idle);
+      idle_bytes_ -= range->size;
+    }
+  } else {
+    // Ranges in use can't be replaced.  Idle ones are evicted and merged into the new range.
+    for (RangeMap::iterator overlap = it;
+         overlap != ranges_.end() && overlap->second->base < end; ++overlap) {
+      if (overlap->second->refs != 0) return false;
+    }
+    while (it != ranges_.end() && it->second->base < end) {
+      RangeMap::iterator next = it;
+      ++next;
+      Evict(it);
+      it = next;
+    }
+
+    void* ptr = reinterpret_cast<void*>(base);
+    if (!amd::MemoryRegion::RegisterMemory(ptr, end - base, region.mem_flag())) {
+      status = HSA_STATUS_ERROR;
+      return true;
+    }
+    uint64_t alternate_va = 0;
+    if (!amd::MemoryRegion::MakeKfdMemoryResident(sorted_nodes.size(), &sorted_nodes[0], ptr,
+                                                  end - base, &alternate_va, region.map_flag())) {
+      amd::MemoryRegion::DeregisterMemory(ptr);
+      status = HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+      return true;
+    }
+
+    range = new Range();
+    range->region = &region;
+    range->base = base;
+    range->size = end - base;
+    range->nodes.swap(sorted_nodes);
+    range->agent_base = (alternate_va != 0) ? uintptr_t(alternate_va) : base;
+    range->refs = 1;
+    range->stale = false;
+    ranges_[base].reset(range);
+
+    Runtime::runtime_singleton_->RegisterPtrOwner(ptr, range->size, region.owner());
+  }
+
+  locks_[host_ptr].push_back(range);
+  *agent_ptr = reinterpret_cast<void*>(range->agent_base + (start - range->base));
+  status = HSA_STATUS_SUCCESS;
+  return true;
+}
+
+bool PinCache::Unlock(const void* host_ptr) {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+
+  auto locked = locks_.find(host_ptr);
+  if (locked == locks_.end()) return false;
+
+  Range* range = locked->second.back();
+  locked->second.pop_back();
+  if (locked->second.empty()) locks_.erase(locked);
+
+  if (--range->refs != 0) return true;
+
+  if (range->stale) {
+    Evict(ranges_.find(range->base));
+    return true;
+  }
+
+  idle_.push_front(range);
+  range->idle = idle_.begin();
+  idle_bytes_ += range->size;
+  Trim();
+  return true;
+}
+
+void PinCache::Invalidate(const void* ptr, size_t size) {
+  const uintptr_t start = reinterpret_cast<uintptr_t>(ptr);
+  const uintptr_t end = start + size;
+
+  ScopedAcquire<KernelMutex> lock(&lock_);
+
+  RangeMap::iterator it = FirstOverlap(start);
+  while (it != ranges_.end() && it->second->base < end) {
+    RangeMap::iterator next = it;
+    ++next;
+    if (it->second->refs == 0)
+      Evict(it);
+    else
+      it->second->stale = true;
+    it = next;
+  }
+}
+
+void PinCache::Flush() {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  while (!idle_.empty()) Evict(ranges_.find(idle_.back()->base));
+}
+
+void PinCache::Trim() {
+  const size_t limit = Runtime::runtime_singleton_->flag().pin_cache_size();
+  while (idle_bytes_ > limit) Evict(ranges_.find(idle_.back()->base));
+}
+
+void PinCache::Evict(RangeMap::iterator it) {
+  Range* range = it->second.get();
+  assert(range->refs == 0 && "Evicting a locked range.");
+
+  if (!range->stale) {
+    idle_.erase(range->idle);
+    idle_bytes_ -= range->size;
+  }
+
+  void* ptr = reinterpret_cast<void*>(range->base);
+  Runtime::runtime_singleton_->DeregisterPtrOwner(ptr);
+  amd::MemoryRegion::MakeKfdMemoryUnresident(ptr);
+  amd::MemoryRegion::DeregisterMemory(ptr);
+
+  ranges_.erase(it);
+}
+
+}  // namespace core
@@ -0,0 +1,220 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "core/inc/profile_buffer_pool.h"
+
+#include "core/inc/amd_gpu_agent.h"
+#include "core/inc/amd_memory_region.h"
+#include "core/inc/interrupt_signal.h"
+#include "core/inc/runtime.h"
+
+namespace core {
+
+// Buffer placement granularity.
+static const uint32_t kBufferAlignment = 256;
+
+ProfileBufferPool::ProfileBufferPool(Agent* agent, uint32_t command_size, uint32_t output_size,
+                                     uint32_t num_buffers, uint32_t batch_size,
+                                     hsa_amd_profile_data_callback_t callback, void* user_data)
+    : agent_(agent),
+      cpu_agent_(Runtime::runtime_singleton_->GetNearestCpuAgent(*agent)),
+      command_size_(AlignUp(command_size, kBufferAlignment)),
+      output_size_(AlignUp(output_size, kBufferAlignment)),
+      num_buffers_(num_buffers),
+      batch_size_(Min(Max(batch_size, 1U), num_buffers)),
+      callback_(callback),
+      user_data_(user_data),
+      commands_(nullptr),
+      outputs_(nullptr),
+      staging_(nullptr),
+      in_flight_(new InterruptSignal(0)) {}
+
+ProfileBufferPool::~ProfileBufferPool() {
+  Runtime* runtime = Runtime::runtime_singleton_;
+  if (outputs_ != nullptr) {
+    Flush();
+    runtime->FreeMemory(outputs_);
+  }
+  if (commands_ != nullptr) runtime->system_deallocator()(commands_);
+  if (staging_ != nullptr) runtime->system_deallocator()(staging_);
+}
+
+hsa_status_t ProfileBufferPool::Init() {
+  Runtime* runtime = Runtime::runtime_singleton_;
+  const amd::GpuAgent* gpu = static_cast<const amd::GpuAgent*>(agent_);
+  if (gpu->local_region() == nullptr) return HSA_STATUS_ERROR_INVALID_AGENT;
+
+  const size_t command_bytes = size_t(command_size_) * num_buffers_;
+  const size_t output_bytes = size_t(output_size_) * num_buffers_;
+
+  commands_ = reinterpret_cast<uint8_t*>(
+      runtime->AllocateNearSystemMemory(*agent_, command_bytes, MemoryRegion::AllocateNoFlags));
+  staging_ = reinterpret_cast<uint8_t*>(
+      runtime->AllocateNearSystemMemory(*agent_, output_bytes, MemoryRegion::AllocateNoFlags));
+  if ((commands_ == nullptr) || (staging_ == nullptr)) return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+
+  void* outputs = nullptr;
+  hsa_status_t err = runtime->AllocateMemory(gpu->local_region(), output_bytes,
+                                             MemoryRegion::AllocateNoFlags, &outputs);
+  if (err != HSA_STATUS_SUCCESS) return err;
+  outputs_ = reinterpret_cast<uint8_t*>(outputs);
+
+  // Hand out low ids first.
+  free_.reserve(num_buffers_);
+  for (uint32_t id = num_buffers_; id > 0; id--) free_.push_back(id - 1);
+  held_.assign(num_buffers_, false);
+  queued_ids_.reserve(batch_size_);
+  queued_signals_.reserve(batch_size_);
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t ProfileBufferPool::Acquire(hsa_amd_profile_buffer_t* buffer) {
+  AdaptiveWait wait(&freed_);
+  while (true) {
+    {
+      ScopedAcquire<KernelMutex> lock(&lock_);
+      if (!free_.empty()) {
+        const uint32_t id = free_.back();
+        free_.pop_back();
+        held_[id] = true;
+        buffer->id = id;
+        buffer->command = commands_ + size_t(id) * command_size_;
+        buffer->command_size = command_size_;
+        buffer->output = outputs_ + size_t(id) * output_size_;
+        buffer->output_size = output_size_;
+        return HSA_STATUS_SUCCESS;
+      }
+
+      if (!queued_ids_.empty()) {
+        hsa_status_t err = IssueBatch();
+        if (err != HSA_STATUS_SUCCESS) return err;
+      } else if (in_flight_->LoadRelaxed() == 0) {
+        // Every buffer is held by the caller, none will come back.
+        return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+      }
+    }
+    wait.Pause();
+  }
+}
+
+hsa_status_t ProfileBufferPool::Submit(uint32_t id, Signal* ready_signal) {
+  if (id >= num_buffers_) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  if (!held_[id]) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  held_[id] = false;
+  queued_ids_.push_back(id);
+  queued_signals_.push_back(ready_signal);
+  if (queued_ids_.size() < batch_size_) return HSA_STATUS_SUCCESS;
+  return IssueBatch();
+}
+
+hsa_status_t ProfileBufferPool::Flush() {
+  {
+    ScopedAcquire<KernelMutex> lock(&lock_);
+    hsa_status_t err = IssueBatch();
+    if (err != HSA_STATUS_SUCCESS) return err;
+  }
+  in_flight_->WaitRelaxed(HSA_SIGNAL_CONDITION_EQ, 0, uint64_t(-1), HSA_WAIT_STATE_BLOCKED);
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t ProfileBufferPool::IssueBatch() {
+  if (queued_ids_.empty()) return HSA_STATUS_SUCCESS;
+
+  std::shared_ptr<Batch> batch(new Batch());
+  batch->ids.swap(queued_ids_);
+  batch->copied.reset(new InterruptSignal(1));
+  std::vector<Signal*> ready;
+  ready.swap(queued_signals_);
+  queued_ids_.reserve(batch_size_);
+  queued_signals_.reserve(batch_size_);
+
+  std::vector<hsa_amd_memory_copy_desc_t> copies;
+  copies.reserve(batch->ids.size());
+  for (uint32_t id : batch->ids) {
+    const size_t offset = size_t(id) * output_size_;
+    const hsa_amd_memory_copy_desc_t copy = {staging_ + offset, outputs_ + offset, output_size_};
+    copies.push_back(copy);
+  }
+
+  Runtime* runtime = Runtime::runtime_singleton_;
+  hsa_status_t err =
+      runtime->CopyMemoryBatch(copies, *cpu_agent_, *agent_, ready, *batch->copied);
+  if (err != HSA_STATUS_SUCCESS) {
+    // The data is lost, keep the buffers usable.
+    free_.insert(free_.end(), batch->ids.begin(), batch->ids.end());
+    return err;
+  }
+
+  in_flight_->AddRelaxed(1);
+  std::vector<Signal*> copied(1, batch->copied.get());
+  // Host tasks report success by returning true, Complete can't fail.
+  err = runtime->SubmitHostTask(
+      [this, batch]() {
+        Complete(*batch);
+        return true;
+      },
+      *agent_, copied, *in_flight_);
+  if (err != HSA_STATUS_SUCCESS) {
+    // Nothing will deliver the data, recycle the buffers once the copy is done with them.
+    in_flight_->SubRelaxed(1);
+    batch->copied->WaitRelaxed(HSA_SIGNAL_CONDITION_EQ, 0, uint64_t(-1),
+                               HSA_WAIT_STATE_BLOCKED);
+    free_.insert(free_.end(), batch->ids.begin(), batch->ids.end());
+    return err;
+  }
+  return HSA_STATUS_SUCCESS;
+}
+
+void ProfileBufferPool::Complete(const Batch& batch) {
+  for (uint32_t id : batch.ids)
+    callback_(id, staging_ + size_t(id) * output_size_, output_size_, user_data_);
+
+  {
+    ScopedAcquire<KernelMutex> lock(&lock_);
+    free_.insert(free_.end(), batch.ids.begin(), batch.ids.end());
+  }
+  freed_.Notify();
+}
+
+}  // namespace core
@@ -42,6 +42,7 @@
 
 #include "core/inc/queue.h"
 #include "core/inc/runtime.h"
+#include "core/util/timer.h"
 
 namespace core {
 
@@ -53,4 +54,101 @@ void Queue::DefaultErrorHandler(hsa_status_t status, hsa_queue_t* source, void*
   }
 }
 
+void Queue::GetProgressStats(hsa_amd_queue_progress_stats_t* stats, ProgressSampler sampler) {
+  ScopedAcquire<KernelMutex> lock(&progress_lock_);
+  ProgressSample& last = progress_[sampler];
+
+  const uint64_t now =
+      uint64_t(double(os::ReadAccurateClock()) * 1e9 / double(os::AccurateClockFrequency()));
+  const uint64_t write = LoadWriteIndexRelaxed();
+  const uint64_t read = Min(LoadReadIndexRelaxed(), write);
+
+  stats->read_index = read;
+  stats->write_index = write;
+  stats->depth = write - read;
+  stats->sample_interval_ns = (last.sample_ns == 0) ? 0 : now - last.sample_ns;
+  stats->dispatch_rate = (stats->sample_interval_ns == 0)
+      ? 0
+      : uint64_t(double(read - last.read) * 1e9 / double(stats->sample_interval_ns));
+
+  // A queue is stalled from the last sample showing progress or an empty queue.
+  if ((read != last.read) || (stats->depth == 0) || (last.moved_ns == 0)) last.moved_ns = now;
+  stats->stall_time_ns = now - last.moved_ns;
+
+  last.read = read;
+  last.sample_ns = now;
+}
+
+hsa_status_t ReservePackets(Queue* queue, uint32_t count, uint64_t timeout_ns,
+                            uint64_t& write_index) {
+  const uint64_t size = queue->amd_queue_.hsa_queue.size;
+  assert(count <= size && "Reservation larger than the queue.");
+
+  // Poll briefly, then sleep with a growing delay while the queue is full.
+  static const uint32_t kPausePolls = 64;
+  static const int kMaxSleepUs = 128;
+  uint32_t polls = 0;
+  int sleep_us = 1;
+  const timer::fast_clock::time_point start = timer::fast_clock::now();
+
+  uint64_t write;
+  while (true) {
+    write = queue->LoadWriteIndexRelaxed();
+    const uint64_t read = queue->LoadReadIndexRelaxed();
+    if (write - read + count <= size) {
+      if (queue->CasWriteIndexRelaxed(write, write + count) == write) break;
+      continue;
+    }
+
+    if (polls < kPausePolls) {
+      polls++;
+      CpuRelax();
+      continue;
+    }
+    if (timeout_ns != UINT64_MAX &&
+        uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     timer::fast_clock::now() - start).count()) >= timeout_ns)
+      return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+    os::uSleep(sleep_us);
+    sleep_us = Min(sleep_us * 2, kMaxSleepUs);
+  }
+
+  write_index = write;
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t SubmitPackets(Queue* queue, const AqlPacket* packets, uint32_t count,
+                           uint64_t timeout_ns) {
+  const uint64_t size = queue->amd_queue_.hsa_queue.size;
+  if (count == 0) return HSA_STATUS_SUCCESS;
+  if (count > size) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  uint64_t write;
+  hsa_status_t err = ReservePackets(queue, count, timeout_ns, write);
+  if (err != HSA_STATUS_SUCCESS) return err;
+
+  AqlPacket* ring = reinterpret_cast<AqlPacket*>(queue->amd_queue_.hsa_queue.base_address);
+  const uint64_t mask = size - 1;
+
+  // Bodies first, leaving the headers invalid, then headers in order.
+  for (uint32_t i = 0; i < count; i++) {
+    AqlPacket& slot = ring[(write + i) & mask];
+    atomic::Store(&slot.dispatch.header,
+                  uint16_t(HSA_PACKET_TYPE_INVALID << HSA_PACKET_HEADER_TYPE),
+                  std::memory_order_relaxed);
+    memcpy(reinterpret_cast<uint8_t*>(&slot) + sizeof(uint32_t),
+           reinterpret_cast<const uint8_t*>(&packets[i]) + sizeof(uint32_t),
+           sizeof(AqlPacket) - sizeof(uint32_t));
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    const uint32_t header_setup = *reinterpret_cast<const uint32_t*>(&packets[i]);
+    atomic::Store(reinterpret_cast<uint32_t*>(&ring[(write + i) & mask]), header_setup,
+                  std::memory_order_release);
+  }
+
+  HSA::hsa_signal_store_screlease(queue->amd_queue_.hsa_queue.doorbell_signal,
+                                  write + count - 1);
+  return HSA_STATUS_SUCCESS;
+}
+
 }
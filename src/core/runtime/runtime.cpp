@@ -46,20 +46,25 @@
 #include <atomic>
 #include <cstring>
 #include <string>
-#include <thread>
+#include <utility>
 #include <vector>
 
 #include "core/common/shared.h"
 #include "core/inc/hsa_ext_interface.h"
+#include "core/inc/amd_aql_queue.h"
 #include "core/inc/amd_cpu_agent.h"
 #include "core/inc/amd_gpu_agent.h"
 #include "core/inc/amd_memory_region.h"
 #include "core/inc/amd_topology.h"
+#include "core/inc/default_signal.h"
 #include "core/inc/signal.h"
 #include "core/inc/interrupt_signal.h"
 #include "core/inc/hsa_ext_amd_impl.h"
 #include "core/inc/hsa_api_trace_int.h"
+#include "core/inc/hsa_api_stats.h"
 #include "core/util/os.h"
+#include "core/util/stream_copy.h"
+#include "core/util/timer.h"
 #include "inc/hsa_ven_amd_aqlprofile.h"
 
 #define HSA_VERSION_MAJOR 1
@@ -72,14 +77,15 @@ bool g_use_interrupt_wait = true;
 
 Runtime* Runtime::runtime_singleton_ = NULL;
 
-KernelMutex Runtime::bootstrap_lock_;
+KernelMutex Runtime::bootstrap_lock_("Runtime::bootstrap_lock_");
 
 static bool loaded = true;
 
 class RuntimeCleanup {
  public:
   ~RuntimeCleanup() {
-    if (!Runtime::IsOpen()) {
+    // Agents kept by a warm shutdown are reclaimed with the process.
+    if (!Runtime::IsOpen() && !Runtime::IsWarm()) {
       delete Runtime::runtime_singleton_;
     }
 
@@ -133,7 +139,7 @@ hsa_status_t Runtime::Release() {
 
   runtime_singleton_->ref_count_--;
 
-  if (runtime_singleton_->ref_count_ == 0) {
+  if ((runtime_singleton_->ref_count_ == 0) && !runtime_singleton_->platform_loaded_) {
     delete runtime_singleton_;
     runtime_singleton_ = nullptr;
   }
@@ -146,6 +152,11 @@ bool Runtime::IsOpen() {
          (Runtime::runtime_singleton_->ref_count_ != 0);
 }
 
+bool Runtime::IsWarm() {
+  return (Runtime::runtime_singleton_ != NULL) && !IsOpen() &&
+         Runtime::runtime_singleton_->platform_loaded_;
+}
+
 // Register agent information only.  Must not call anything that may use the registered information
 // since those tables are incomplete.
 void Runtime::RegisterAgent(Agent* agent) {
@@ -196,6 +207,9 @@ void Runtime::RegisterAgent(Agent* agent) {
       HsaClockCounters clocks;
       hsaKmtGetClockCounters(0, &clocks);
       sys_clock_freq_ = clocks.SystemClockFrequencyHz;
+
+      ScopedAcquire<KernelMutex> lock(&sys_clock_lock_);
+      SyncSystemClock();
     }
   } else if (agent->device_type() == Agent::DeviceType::kAmdGpuDevice) {
     gpu_agents_.push_back(agent);
@@ -227,6 +241,7 @@ void Runtime::DestroyAgents() {
 void Runtime::SetLinkCount(size_t num_nodes) {
   num_nodes_ = num_nodes;
   link_matrix_.resize(num_nodes * num_nodes);
+  link_topology_.Reset(num_nodes);
 }
 
 void Runtime::RegisterLinkInfo(uint32_t node_id_from, uint32_t node_id_to,
@@ -252,6 +267,61 @@ uint32_t Runtime::GetIndexLinkInfo(uint32_t node_id_from, uint32_t node_id_to) {
   return ((node_id_from * num_nodes_) + node_id_to);
 }
 
+Agent* Runtime::GetNearestCpuAgent(const Agent& agent) {
+  if (agent.device_type() == Agent::DeviceType::kAmdCpuDevice) return const_cast<Agent*>(&agent);
+
+  Agent* nearest = cpu_agents_[0];
+  LinkInfo best = GetLinkInfo(agent.node_id(), nearest->node_id());
+  for (size_t i = 1; i < cpu_agents_.size(); i++) {
+    const LinkInfo link = GetLinkInfo(agent.node_id(), cpu_agents_[i]->node_id());
+    // Nodes without link information report no hops.
+    if (link.num_hop == 0) continue;
+    if ((best.num_hop == 0) || (link.info.numa_distance < best.info.numa_distance) ||
+        ((link.info.numa_distance == best.info.numa_distance) && (link.num_hop < best.num_hop))) {
+      nearest = cpu_agents_[i];
+      best = link;
+    }
+  }
+  return nearest;
+}
+
+Agent* Runtime::GetStagingCpuAgent(const Agent& src_agent, const Agent& dst_agent) {
+  Agent* best = GetNearestCpuAgent(src_agent);
+  LinkTopology::Cost best_in = GetLinkCost(src_agent.node_id(), best->node_id());
+  LinkTopology::Cost best_out = GetLinkCost(best->node_id(), dst_agent.node_id());
+  uint64_t best_bandwidth = Min(best_in.bandwidth, best_out.bandwidth);
+  for (Agent* cpu : cpu_agents_) {
+    const LinkTopology::Cost in = GetLinkCost(src_agent.node_id(), cpu->node_id());
+    const LinkTopology::Cost out = GetLinkCost(cpu->node_id(), dst_agent.node_id());
+    const uint64_t bandwidth = Min(in.bandwidth, out.bandwidth);
+    if ((bandwidth > best_bandwidth) ||
+        ((bandwidth == best_bandwidth) && (bandwidth != 0) &&
+         (in.hops + out.hops < best_in.hops + best_out.hops))) {
+      best = cpu;
+      best_in = in;
+      best_out = out;
+      best_bandwidth = bandwidth;
+    }
+  }
+  return best;
+}
+
+const MemoryRegion* Runtime::GetNearestSystemRegion(const Agent& agent) {
+  for (const MemoryRegion* region : GetNearestCpuAgent(agent)->regions()) {
+    if (region->fine_grain()) return region;
+  }
+  return system_regions_fine_[0];
+}
+
+void* Runtime::AllocateNearSystemMemory(const Agent& agent, size_t size,
+                                        MemoryRegion::AllocateFlags alloc_flags) {
+  void* ptr = NULL;
+  return (HSA_STATUS_SUCCESS ==
+          AllocateMemory(GetNearestSystemRegion(agent), size, alloc_flags, &ptr))
+      ? ptr
+      : NULL;
+}
+
 hsa_status_t Runtime::IterateAgent(hsa_status_t (*callback)(hsa_agent_t agent,
                                                             void* data),
                                    void* data) {
@@ -275,112 +345,508 @@ hsa_status_t Runtime::IterateAgent(hsa_status_t (*callback)(hsa_agent_t agent,
 hsa_status_t Runtime::AllocateMemory(const MemoryRegion* region, size_t size,
                                      MemoryRegion::AllocateFlags alloc_flags,
                                      void** address) {
-  ScopedAcquire<KernelMutex> lock(&memory_lock_);
-  hsa_status_t status = region->Allocate(size, alloc_flags, address);
+  const bool user = (alloc_flags & MemoryRegion::AllocateUser) != 0;
+  const bool zero = (alloc_flags & MemoryRegion::AllocateZero) != 0;
+  alloc_flags &= ~(MemoryRegion::AllocateUser | MemoryRegion::AllocateZero);
+
+  // Application allocations are charged to the thread's accounting tag before the driver is
+  // asked for memory, so budgets fail fast.
+  // Regions and zero_pool_ round size up, the charge stays the requested size.
+  const uint32_t tag = MemoryBudget::ThreadTag();
+  const size_t charged = user ? size : 0;
+  if (user) {
+    hsa_status_t status = memory_budget_.Charge(tag, region, charged);
+    if (status != HSA_STATUS_SUCCESS) return status;
+  }
+
+  // Plain zero initialized device memory is recycled through zero_pool_, which scrubs it in the
+  // background once freed.
+  const bool local = static_cast<const amd::MemoryRegion*>(region)->IsLocalMemory();
+  // Placement flags only apply to system memory.
+  const MemoryRegion::AllocateFlags kSystemOnly =
+      MemoryRegion::AllocatePrefault | MemoryRegion::AllocateNumaBind;
+  const bool recycle = zero && local &&
+      ((alloc_flags & ~(MemoryRegion::AllocateRestrict | kSystemOnly)) == 0);
+
+  hsa_status_t status = HSA_STATUS_SUCCESS;
+  *address = recycle ? zero_pool_.Take(region, size) : nullptr;
+  if (*address == nullptr) {
+    status = region->Allocate(size, alloc_flags, address);
+    // Scrubbed buffers are the first memory to give back.
+    if ((status == HSA_STATUS_ERROR_OUT_OF_RESOURCES) && (zero_pool_.Trim(region) != 0))
+      status = region->Allocate(size, alloc_flags, address);
+
+    // Not tracked yet, so filled by the owner rather than through FillMemory.
+    // Allocations are at least page granular, so the dword tail is in bounds.
+    if ((status == HSA_STATUS_SUCCESS) && zero) {
+      const size_t dwords = AlignUp(size, sizeof(uint32_t)) / sizeof(uint32_t);
+      if (local) {
+        status = region->owner()->DmaFill(*address, 0, dwords);
+        if (status != HSA_STATUS_SUCCESS) region->Free(*address, size);
+      } else {
+        stream::HostFill(*address, 0, dwords);
+      }
+    }
+  }
 
   // Track the allocation result so that it could be freed properly.
   if (status == HSA_STATUS_SUCCESS) {
-    allocation_map_[*address] = AllocationRegion(region, size);
+    allocation_map_.Insert(*address, size, AllocationRegion(region, size, user, tag, charged, recycle));
+  } else if (user) {
+    memory_budget_.Release(tag, region, charged);
   }
 
   return status;
 }
 
+void Runtime::FreeUserAllocations() {
+  std::vector<void*> user_ptrs;
+  allocation_map_.ForEach([&](const void* base, size_t, const AllocationRegion& alloc) {
+    if (alloc.user && (alloc.region != nullptr)) user_ptrs.push_back(const_cast<void*>(base));
+  });
+  for (void* ptr : user_ptrs) FreeMemory(ptr);
+}
+
 hsa_status_t Runtime::FreeMemory(void* ptr) {
   if (ptr == nullptr) {
     return HSA_STATUS_SUCCESS;
   }
 
-  const MemoryRegion* region = nullptr;
-  size_t size = 0;
-  std::unique_ptr<std::vector<AllocationRegion::notifier_t>> notifiers;
+  DeferredFree alloc;
+  hsa_status_t err = TakeAllocation(ptr, alloc);
+  if (err != HSA_STATUS_SUCCESS) return err;
+
+  return ReleaseAllocation(alloc);
+}
+
+hsa_status_t Runtime::FreeMemoryAsync(void* ptr, hsa_signal_t signal) {
+  if (ptr == nullptr) {
+    return HSA_STATUS_SUCCESS;
+  }
+
+  std::unique_ptr<DeferredFree> alloc(new DeferredFree());
+  hsa_status_t err = TakeAllocation(ptr, *alloc);
+  if (err != HSA_STATUS_SUCCESS) return err;
+
+  if (signal.handle == 0) {
+    QueueDeferredFree(alloc.release());
+    return HSA_STATUS_SUCCESS;
+  }
+
+  err = SetAsyncSignalHandler(signal, HSA_SIGNAL_CONDITION_EQ, 0, DeferredFreeReady, alloc.get());
+  if (err != HSA_STATUS_SUCCESS) {
+    // The memory is no longer tracked, so it can't be handed back to the caller.
+    // Wait for the signal here instead.
+    hsa_signal_handle(signal)->WaitRelaxed(HSA_SIGNAL_CONDITION_EQ, 0, uint64_t(-1),
+                                           HSA_WAIT_STATE_BLOCKED);
+    return ReleaseAllocation(*alloc);
+  }
+  alloc.release();
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t Runtime::TakeAllocation(void* ptr, DeferredFree& alloc) {
+  alloc.region = nullptr;
+  alloc.ptr = ptr;
+  alloc.size = 0;
+  alloc.user = false;
+  alloc.tag = 0;
+  alloc.charged = 0;
+  alloc.zeroed = false;
+
+  const bool found = allocation_map_.Erase(ptr, [&](size_t, AllocationRegion& mem) {
+    alloc.region = mem.region;
+    alloc.size = mem.size;
+    alloc.user = mem.user;
+    alloc.tag = mem.tag;
+    alloc.charged = mem.charged;
+    alloc.zeroed = mem.zeroed;
+
+    // Imported fragments can't be released with FreeMemory.
+    if (mem.region == nullptr) return false;
+
+    alloc.notifiers = std::move(mem.notifiers);
+    return true;
+  });
+
+  if (!found) {
+    debug_warning(false && "Can't find address in allocation map");
+    return HSA_STATUS_ERROR_INVALID_ALLOCATION;
+  }
+
+  if (alloc.region == nullptr) {
+    assert(false && "Can't release imported memory with free.");
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t Runtime::ReleaseAllocation(DeferredFree& alloc) {
+  if (alloc.notifiers) {
+    // Notifiers can't run while holding the lock or the callback won't be able to manage memory.
+    // The memory triggering the notification has already been removed from the memory map so
+    // can't be double released during the callback.
+    for (auto& notifier : *alloc.notifiers) {
+      notifier.callback(notifier.ptr, notifier.user_data);
+    }
+  }
+
+  hsa_status_t err = HSA_STATUS_SUCCESS;
+  if (!alloc.zeroed || !runtime_singleton_->zero_pool_.Put(alloc.region, alloc.ptr, alloc.size))
+    err = alloc.region->Free(alloc.ptr, alloc.size);
+  if (alloc.user) runtime_singleton_->memory_budget_.Release(alloc.tag, alloc.region, alloc.charged);
+  return err;
+}
 
+void Runtime::QueueDeferredFree(DeferredFree* alloc) {
+  std::unique_ptr<DeferredFree> entry(alloc);
+  bool schedule;
   {
-    ScopedAcquire<KernelMutex> lock(&memory_lock_);
+    ScopedAcquire<KernelMutex> lock(&deferred_free_lock_);
+    // Memory freed during shutdown is left to process teardown.
+    if (deferred_free_closed_) return;
+    deferred_frees_.push_back(std::move(entry));
+    schedule = !deferred_free_scheduled_;
+    deferred_free_scheduled_ = true;
+  }
+
+  if (schedule) {
+    static const hsa_signal_t null_signal = {0};
+    hsa_status_t err = SetAsyncSignalHandler(null_signal, HSA_SIGNAL_CONDITION_EQ, 0,
+                                             (hsa_amd_signal_handler)ReleaseDeferredFrees, this);
+    if (err != HSA_STATUS_SUCCESS) ReleaseDeferredFrees(this);
+  }
+}
+
+void Runtime::ReleaseDeferredFrees(void* arg) {
+  Runtime* runtime = reinterpret_cast<Runtime*>(arg);
+  ScopedAcquire<KernelMutex> release_lock(&runtime->deferred_release_lock_);
+
+  std::vector<std::unique_ptr<DeferredFree>> frees;
+  {
+    ScopedAcquire<KernelMutex> lock(&runtime->deferred_free_lock_);
+    frees.swap(runtime->deferred_frees_);
+    runtime->deferred_free_scheduled_ = false;
+  }
+
+  for (auto& alloc : frees) ReleaseAllocation(*alloc);
+}
+
+bool Runtime::DeferredFreeReady(hsa_signal_value_t value, void* arg) {
+  runtime_singleton_->QueueDeferredFree(reinterpret_cast<DeferredFree*>(arg));
+  return false;
+}
+
+Signal* Runtime::CreateTimelineProxy(Signal& timeline) {
+  Signal* proxy = new DefaultSignal(1);
+  timeline.Retain();
+  auto* link = new std::pair<Signal*, Signal*>(proxy, &timeline);
+  hsa_status_t err = SetAsyncSignalHandler(Signal::Convert(proxy), HSA_SIGNAL_CONDITION_LT, 1,
+                                           TimelineProxyDone, link);
+  if (err != HSA_STATUS_SUCCESS) {
+    delete link;
+    timeline.Release();
+    proxy->DestroySignal();
+    return nullptr;
+  }
+  return proxy;
+}
+
+bool Runtime::TimelineProxyDone(hsa_signal_value_t value, void* arg) {
+  std::unique_ptr<std::pair<Signal*, Signal*>> link(
+      reinterpret_cast<std::pair<Signal*, Signal*>*>(arg));
+  if (value == 0) {
+    // Profiled copies stamp the proxy, their times are read from the timeline.
+    link->second->signal_.start_ts = link->first->signal_.start_ts;
+    link->second->signal_.end_ts = link->first->signal_.end_ts;
+    link->second->CompleteRelease();
+  }
+  link->second->Release();
+  link->first->DestroySignal();
+  return false;
+}
+
+void Runtime::CollectStats(hsa_amd_stats_page_t& page) {
+  GetSystemInfo(HSA_SYSTEM_INFO_TIMESTAMP, &page.timestamp);
+  page.signal_pool_size = SharedSignalPool.capacity();
 
-    std::map<const void*, AllocationRegion>::iterator it = allocation_map_.find(ptr);
+  page.async_events = 0;
+  for (auto& control : async_events_control_)
+    page.async_events += control->watched.load(std::memory_order_relaxed);
+
+  uint32_t n = 0;
+  for (const MemoryRegion* region : system_regions_fine_) {
+    if (n == HSA_AMD_STATS_MAX_AGENTS) break;
+    static_cast<const amd::MemoryRegion*>(region)->GetStats(&page.system_pools[n++]);
+  }
+  page.num_system_pools = n;
+
+  n = 0;
+  for (Agent* agent : gpu_agents_) {
+    if (n == HSA_AMD_STATS_MAX_AGENTS) break;
+    static_cast<amd::GpuAgent*>(agent)->CollectStats(page.agents[n++]);
+  }
+  page.num_agents = n;
+
+  page.total_queues = amd::AqlQueue::CollectStats(page.queues, HSA_AMD_STATS_MAX_QUEUES);
+  page.num_queues = uint32_t(Min(page.total_queues, uint64_t(HSA_AMD_STATS_MAX_QUEUES)));
+}
+
+hsa_status_t Runtime::CopyFile(int fd, uint64_t file_offset, void* ptr, size_t size,
+                               Agent& agent, bool to_device,
+                               const std::vector<core::Signal*>& dep_signals,
+                               core::Signal& completion_signal) {
+  Agent* gpu = &agent;
+  return SubmitHostTask(
+      [=]() {
+        return StreamFile(fd, file_offset, ptr, size, *gpu, to_device) == HSA_STATUS_SUCCESS;
+      },
+      agent, dep_signals, completion_signal, true);
+}
 
-    if (it == allocation_map_.end()) {
-      debug_warning(false && "Can't find address in allocation map");
-      return HSA_STATUS_ERROR_INVALID_ALLOCATION;
+hsa_status_t Runtime::StreamFile(int fd, uint64_t file_offset, void* ptr, size_t size,
+                                 Agent& gpu_agent, bool to_device) {
+  if (size == 0) return HSA_STATUS_SUCCESS;
+
+  // A ring of staging buffers keeps the file and the DMA engine busy at once, file I/O on one
+  // chunk overlaps the copies of the chunks before it.  Buffers are page aligned and chunks are
+  // whole pages except the last, so O_DIRECT descriptors work for aligned offsets and sizes.
+  const size_t kStreamChunk = 4 * 1024 * 1024;
+  const int kStreamSlots = 4;
+  const size_t chunk = Min(size, kStreamChunk);
+  size_t temp_size = kStreamSlots * chunk;
+  core::Agent& host = *GetNearestCpuAgent(gpu_agent);
+  const MemoryRegion* staging_region = GetNearestSystemRegion(gpu_agent);
+  void* temp = nullptr;
+  hsa_status_t err =
+      staging_region->Allocate(temp_size, core::MemoryRegion::AllocateNoFlags, &temp);
+  if (err != HSA_STATUS_SUCCESS) return err;
+  MAKE_SCOPE_GUARD([&]() { staging_region->Free(temp, temp_size); });
+
+  core::unique_signal_ptr done[kStreamSlots];
+  for (int i = 0; i < kStreamSlots; i++) done[i].reset(new core::DefaultSignal(0));
+
+  // Wait for all submitted copies before the staging buffers are released.
+  MAKE_SCOPE_GUARD([&]() {
+    for (int i = 0; i < kStreamSlots; i++)
+      done[i]->WaitRelaxed(HSA_SIGNAL_CONDITION_EQ, 0, -1, HSA_WAIT_STATE_BLOCKED);
+  });
+
+  uint8_t* device = reinterpret_cast<uint8_t*>(ptr);
+  const auto& buffer = [&](int slot) { return reinterpret_cast<uint8_t*>(temp) + slot * chunk; };
+  std::vector<core::Signal*> no_deps;
+
+  if (to_device) {
+    for (size_t offset = 0, i = 0; offset < size; offset += chunk, i = (i + 1) % kStreamSlots) {
+      const size_t len = Min(chunk, size - offset);
+      done[i]->WaitRelaxed(HSA_SIGNAL_CONDITION_EQ, 0, -1, HSA_WAIT_STATE_BLOCKED);
+      if (os::ReadFileAt(fd, buffer(i), len, file_offset + offset) != len)
+        return HSA_STATUS_ERROR;
+
+      done[i]->StoreRelaxed(1);
+      err = gpu_agent.DmaCopy(device + offset, gpu_agent, buffer(i), host, len, no_deps,
+                              *done[i]);
+      if (err != HSA_STATUS_SUCCESS) {
+        done[i]->StoreRelaxed(0);
+        return err;
+      }
     }
-    region = it->second.region;
-    size = it->second.size;
+    return HSA_STATUS_SUCCESS;
+  }
 
-    // Imported fragments can't be released with FreeMemory.
-    if (region == nullptr) {
-      assert(false && "Can't release imported memory with free.");
-      return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  // Chunk k always lands in slot k % kStreamSlots.  Every slot is kept fetching while earlier
+  // chunks are written out.
+  size_t fetched = 0;
+  const auto& fetch = [&](int slot) {
+    const size_t len = Min(chunk, size - fetched);
+    done[slot]->StoreRelaxed(1);
+    hsa_status_t err = gpu_agent.DmaCopy(buffer(slot), host, device + fetched, gpu_agent, len,
+                                         no_deps, *done[slot]);
+    if (err != HSA_STATUS_SUCCESS) {
+      done[slot]->StoreRelaxed(0);
+      return err;
     }
+    fetched += len;
+    return HSA_STATUS_SUCCESS;
+  };
 
-    notifiers = std::move(it->second.notifiers);
+  for (int i = 0; i < kStreamSlots && fetched < size; i++) {
+    err = fetch(i);
+    if (err != HSA_STATUS_SUCCESS) return err;
+  }
 
-    allocation_map_.erase(it);
+  for (size_t offset = 0, i = 0; offset < size; offset += chunk, i = (i + 1) % kStreamSlots) {
+    const size_t len = Min(chunk, size - offset);
+    done[i]->WaitRelaxed(HSA_SIGNAL_CONDITION_EQ, 0, -1, HSA_WAIT_STATE_BLOCKED);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (os::WriteFileAt(fd, buffer(i), len, file_offset + offset) != len) return HSA_STATUS_ERROR;
 
-    // Fast path to avoid doubling lock ops in the common case (no notifiers).
-    if (!notifiers) return region->Free(ptr, size);
+    if (fetched < size) {
+      err = fetch(i);
+      if (err != HSA_STATUS_SUCCESS) return err;
+    }
   }
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t Runtime::PrefetchMemory(const void* ptr, size_t size, Agent& agent,
+                                     const std::vector<core::Signal*>& dep_signals,
+                                     core::Signal& completion_signal) {
+  bool found = false;
+  allocation_map_.Find(ptr, true, [&](const void* base, size_t length,
+                                      const AllocationRegion& alloc) {
+    found = (alloc.region != nullptr) &&
+        (reinterpret_cast<uintptr_t>(ptr) + size <= reinterpret_cast<uintptr_t>(base) + length);
+  });
+  if (!found) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  std::unique_ptr<DeferredPrefetch> prefetch(new DeferredPrefetch());
+  prefetch->ptr = ptr;
+  prefetch->size = size;
+  prefetch->agent = &agent;
+  prefetch->dep_signals = dep_signals;
+  prefetch->next_dep = 0;
+  prefetch->completion_signal = &completion_signal;
+
+  // Without pending dependencies there is nothing to overlap with, run it here.
+  bool pending = false;
+  for (core::Signal* dep : dep_signals) pending |= (dep->LoadRelaxed() != 0);
+  if (!pending) prefetch->dep_signals.clear();
+
+  PrefetchReady(0, prefetch.release());
+  return HSA_STATUS_SUCCESS;
+}
 
-  // Notifiers can't run while holding the lock or the callback won't be able to manage memory.
-  // The memory triggering the notification has already been removed from the memory map so can't
-  // be double released during the callback.
-  for (auto& notifier : *notifiers) {
-    notifier.callback(notifier.ptr, notifier.user_data);
+bool Runtime::PrefetchReady(hsa_signal_value_t value, void* arg) {
+  DeferredPrefetch* prefetch = reinterpret_cast<DeferredPrefetch*>(arg);
+
+  while (prefetch->next_dep < prefetch->dep_signals.size()) {
+    core::Signal* dep = prefetch->dep_signals[prefetch->next_dep++];
+    if (dep->LoadRelaxed() == 0) continue;
+    if (runtime_singleton_->SetAsyncSignalHandler(core::Signal::Convert(dep),
+                                                  HSA_SIGNAL_CONDITION_EQ, 0, PrefetchReady,
+                                                  prefetch) == HSA_STATUS_SUCCESS)
+      return false;
+    dep->WaitRelaxed(HSA_SIGNAL_CONDITION_EQ, 0, uint64_t(-1), HSA_WAIT_STATE_BLOCKED);
   }
 
-  // Fragment allocator requires protection.
-  ScopedAcquire<KernelMutex> lock(&memory_lock_);
-  return region->Free(ptr, size);
+  bool lazy;
+  hsa_status_t err =
+      runtime_singleton_->MapOnFirstUse(prefetch->ptr, prefetch->size, *prefetch->agent, lazy);
+  debug_warning((err == HSA_STATUS_SUCCESS) && "Prefetch mapping failed.");
+  prefetch->completion_signal->CompleteRelease();
+  delete prefetch;
+  return false;
 }
 
 hsa_status_t Runtime::RegisterReleaseNotifier(void* ptr, hsa_amd_deallocation_callback_t callback,
                                               void* user_data) {
-  ScopedAcquire<KernelMutex> lock(&memory_lock_);
-  auto mem = allocation_map_.upper_bound(ptr);
-  if (mem != allocation_map_.begin()) {
-    mem--;
-
+  hsa_status_t ret = HSA_STATUS_ERROR_INVALID_ALLOCATION;
+  allocation_map_.Update(ptr, true, [&](const void*, size_t, AllocationRegion& mem) {
     // No support for imported fragments yet.
-    if (mem->second.region == nullptr) return HSA_STATUS_ERROR_INVALID_ALLOCATION;
-
-    if ((mem->first <= ptr) &&
-        (ptr < reinterpret_cast<const uint8_t*>(mem->first) + mem->second.size)) {
-      auto& notifiers = mem->second.notifiers;
-      if (!notifiers) notifiers.reset(new std::vector<AllocationRegion::notifier_t>);
-      AllocationRegion::notifier_t notifier = {
-          ptr, AMD::callback_t<hsa_amd_deallocation_callback_t>(callback), user_data};
-      notifiers->push_back(notifier);
-      return HSA_STATUS_SUCCESS;
-    }
-  }
-  return HSA_STATUS_ERROR_INVALID_ALLOCATION;
+    if (mem.region == nullptr) return;
+
+    auto& notifiers = mem.notifiers;
+    if (!notifiers) notifiers.reset(new std::vector<AllocationRegion::notifier_t>);
+    AllocationRegion::notifier_t notifier = {
+        ptr, AMD::callback_t<hsa_amd_deallocation_callback_t>(callback), user_data};
+    notifiers->push_back(notifier);
+    ret = HSA_STATUS_SUCCESS;
+  });
+  return ret;
 }
 
 hsa_status_t Runtime::DeregisterReleaseNotifier(void* ptr,
                                                 hsa_amd_deallocation_callback_t callback) {
   hsa_status_t ret = HSA_STATUS_ERROR_INVALID_ARGUMENT;
-  ScopedAcquire<KernelMutex> lock(&memory_lock_);
-  auto mem = allocation_map_.upper_bound(ptr);
-  if (mem != allocation_map_.begin()) {
-    mem--;
-    if ((mem->first <= ptr) &&
-        (ptr < reinterpret_cast<const uint8_t*>(mem->first) + mem->second.size)) {
-      auto& notifiers = mem->second.notifiers;
-      if (!notifiers) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
-      for (size_t i = 0; i < notifiers->size(); i++) {
-        if (((*notifiers)[i].ptr == ptr) && ((*notifiers)[i].callback) == callback) {
-          (*notifiers)[i] = std::move((*notifiers)[notifiers->size() - 1]);
-          notifiers->pop_back();
-          i--;
-          ret = HSA_STATUS_SUCCESS;
-        }
+  allocation_map_.Update(ptr, true, [&](const void*, size_t, AllocationRegion& mem) {
+    auto& notifiers = mem.notifiers;
+    if (!notifiers) return;
+    for (size_t i = 0; i < notifiers->size(); i++) {
+      if (((*notifiers)[i].ptr == ptr) && ((*notifiers)[i].callback) == callback) {
+        (*notifiers)[i] = std::move((*notifiers)[notifiers->size() - 1]);
+        notifiers->pop_back();
+        i--;
+        ret = HSA_STATUS_SUCCESS;
       }
     }
-  }
+  });
   return ret;
 }
 
+bool Runtime::IsMapped(const void* ptr, const Agent& agent) {
+  hsa_amd_pointer_info_t info;
+  info.size = sizeof(info);
+  uint32_t count = 0;
+  hsa_agent_t* accessible = nullptr;
+  hsa_status_t err = PtrInfo(const_cast<void*>(ptr), &info, malloc, &count, &accessible);
+  if (err != HSA_STATUS_SUCCESS) return false;
+  MAKE_SCOPE_GUARD([&]() { free(accessible); });
+  for (uint32_t i = 0; i < count; i++)
+    if (accessible[i].handle == agent.public_handle().handle) return true;
+  return false;
+}
+
+hsa_status_t Runtime::MapOnFirstUse(const void* ptr, size_t size, Agent& agent, bool& lazy) {
+  lazy = false;
+  if (!flag_.lazy_system_mapping() || agent.device_type() != Agent::DeviceType::kAmdGpuDevice)
+    return HSA_STATUS_SUCCESS;
+
+  const amd::MemoryRegion* region = nullptr;
+  const void* alloc_base = nullptr;
+  size_t alloc_size = 0;
+  allocation_map_.Find(ptr, true, [&](const void* base, size_t length,
+                                      const AllocationRegion& alloc) {
+    if (alloc.region == nullptr) return;
+    if (reinterpret_cast<uintptr_t>(ptr) + size > reinterpret_cast<uintptr_t>(base) + length)
+      return;
+    region = static_cast<const amd::MemoryRegion*>(alloc.region);
+    alloc_base = base;
+    alloc_size = length;
+  });
+  if (region == nullptr || !region->IsSystem()) return HSA_STATUS_SUCCESS;
+
+  return region->MapOnFirstUse(alloc_base, alloc_size, agent, lazy);
+}
+
+bool Runtime::LookupPtrOwner(const void* ptr, size_t size, Agent*& owner) {
+  const auto& covers = [&](const void* base, size_t length) {
+    return reinterpret_cast<uintptr_t>(ptr) + size <= reinterpret_cast<uintptr_t>(base) + length;
+  };
+
+  bool found = false;
+  allocation_map_.Find(ptr, true, [&](const void* base, size_t length,
+                                      const AllocationRegion& alloc) {
+    // Imported fragments have no region, their owner is in ptr_owner_map_.
+    if ((alloc.region != nullptr) && covers(base, length)) {
+      owner = alloc.region->owner();
+      found = true;
+    }
+  });
+  if (found) return true;
+
+  ptr_owner_map_.Find(ptr, true, [&](const void* base, size_t length, Agent* const& agent) {
+    if (covers(base, length)) {
+      owner = agent;
+      found = true;
+    }
+  });
+  return found;
+}
+
+void Runtime::RegisterMappedPtrOwner(void* ptr, size_t size) {
+  hsa_amd_pointer_info_t info;
+  info.size = sizeof(info);
+  if (PtrInfo(ptr, &info, nullptr, nullptr, nullptr) != HSA_STATUS_SUCCESS) return;
+  // The thunk may not report an owner for imported memory.
+  if (info.agentOwner.handle == 0) return;
+  RegisterPtrOwner(ptr, size, Agent::Convert(info.agentOwner));
+}
+
 hsa_status_t Runtime::CopyMemory(void* dst, const void* src, size_t size) {
+  Tracer::Span trace(tracer_, HSA_AMD_TRACE_RECORD_COPY, size);
+
   // Choose agents from pointer info
   bool is_src_system = false;
   bool is_dst_system = false;
@@ -389,6 +855,10 @@ hsa_status_t Runtime::CopyMemory(void* dst, const void* src, size_t size) {
 
   // Fetch ownership
   const auto& is_system_mem = [&](void* ptr, core::Agent*& agent) {
+    // Ranges the runtime allocated or mapped need no thunk query.
+    if (LookupPtrOwner(ptr, size, agent))
+      return agent->device_type() != core::Agent::DeviceType::kAmdGpuDevice;
+
     hsa_amd_pointer_info_t info;
     info.size = sizeof(info);
     hsa_status_t err = PtrInfo(ptr, &info, nullptr, nullptr, nullptr);
@@ -410,24 +880,53 @@ hsa_status_t Runtime::CopyMemory(void* dst, const void* src, size_t size) {
 
   // CPU-CPU
   if (is_src_system && is_dst_system) {
-    memcpy(dst, src, size);
-    return HSA_STATUS_SUCCESS;
+    return cpu_copy_pool_.CopySync(dst, *dst_agent, src, size);
   }
 
   // Same GPU
   if (src_agent->node_id() == dst_agent->node_id()) return dst_agent->DmaCopy(dst, src, size);
 
   // GPU-CPU
+  // Lazily mapped system allocations only need mapping to the copying GPU.
+  {
+    core::Agent* gpu = is_src_system ? dst_agent : src_agent;
+    const void* host_ptr = is_src_system ? src : dst;
+    bool lazy;
+    hsa_status_t err = MapOnFirstUse(host_ptr, size, *gpu, lazy);
+    if (err != HSA_STATUS_SUCCESS) return err;
+    if (lazy) return gpu->DmaCopy(dst, src, size);
+  }
+
   // Must ensure that system memory is visible to the GPU during the copy.
   const amd::MemoryRegion* system_region =
       static_cast<const amd::MemoryRegion*>(system_regions_fine_[0]);
 
   const auto& locked_copy = [&](void* ptr, core::Agent* locking_agent, bool locking_src) {
+    // Small copies bounce through a pre-pinned buffer to avoid the register/unregister cost.
+    // The buffer is placed on the GPU's socket.
+    if (size <= kStagingBufferSize) {
+      const MemoryRegion* staging_region = GetNearestSystemRegion(*locking_agent);
+      void* staging = AcquireStagingBuffer(staging_region);
+      if (staging != nullptr) {
+        MAKE_SCOPE_GUARD([&]() { ReleaseStagingBuffer(staging_region, staging); });
+        if (locking_src) {
+          memcpy(staging, src, size);
+          return locking_agent->DmaCopy(dst, staging, size);
+        }
+        hsa_status_t err = locking_agent->DmaCopy(staging, src, size);
+        if (err == HSA_STATUS_SUCCESS) memcpy(dst, staging, size);
+        return err;
+      }
+    }
+
+    if (size > 2 * kLockedCopyChunkSize)
+      return PipelinedLockedCopy(dst, src, size, locking_agent, locking_src);
+
     void* gpuPtr;
     hsa_agent_t agent = locking_agent->public_handle();
-    hsa_status_t err = system_region->Lock(1, &agent, ptr, size, &gpuPtr);
+    hsa_status_t err = system_region->Lock(1, &agent, ptr, size, &gpuPtr, false);
     if (err != HSA_STATUS_SUCCESS) return err;
-    MAKE_SCOPE_GUARD([&]() { system_region->Unlock(ptr); });
+    MAKE_SCOPE_GUARD([&]() { system_region->Unlock(ptr, false); });
     if (locking_src)
       return locking_agent->DmaCopy(dst, gpuPtr, size);
     else
@@ -437,20 +936,153 @@ hsa_status_t Runtime::CopyMemory(void* dst, const void* src, size_t size) {
   if (is_src_system) return locked_copy(const_cast<void*>(src), dst_agent, true);
   if (is_dst_system) return locked_copy(dst, src_agent, false);
 
-  /*
-  GPU-GPU - functional support, not a performance path.
-  
-  This goes through system memory because we have to support copying between non-peer GPUs
-  and we can't use P2P pointers even if the GPUs are peers.  Because hsa_amd_agents_allow_access
-  requires the caller to specify all allowed agents we can't assume that a peer mapped pointer
-  would remain mapped for the duration of the copy.
-  */
+  // GPU-GPU
+  // Copy directly when the GPUs are linked and one agent has the other's buffer mapped.  Mappings
+  // are sampled here, hsa_amd_agents_allow_access revoking them during the copy is a caller race.
+  if (GetLinkInfo(src_agent->node_id(), dst_agent->node_id()).num_hop != 0) {
+    if (IsMapped(dst, *src_agent)) return src_agent->DmaCopy(dst, src, size);
+    if (IsMapped(src, *dst_agent)) return dst_agent->DmaCopy(dst, src, size);
+  }
+
+  // Not peers, pipeline through a pair of system memory staging buffers so the copy out of one
+  // chunk overlaps the copy in of the next.
+  // The buffers are placed on the CPU node with the fastest path through it.
+  const size_t kStagingChunk = 4 * 1024 * 1024;
+  const size_t chunk = Min(size, kStagingChunk);
+  size_t temp_size = 2 * chunk;
   void* temp = nullptr;
-  system_region->Allocate(size, core::MemoryRegion::AllocateNoFlags, &temp);
-  MAKE_SCOPE_GUARD([&]() { system_region->Free(temp, size); });
-  hsa_status_t err = src_agent->DmaCopy(temp, src, size);
-  if (err == HSA_STATUS_SUCCESS) err = dst_agent->DmaCopy(dst, temp, size);
-  return err;
+  core::Agent& host = *GetStagingCpuAgent(*src_agent, *dst_agent);
+  const MemoryRegion* staging_region = GetNearestSystemRegion(host);
+  hsa_status_t err =
+      staging_region->Allocate(temp_size, core::MemoryRegion::AllocateNoFlags, &temp);
+  if (err != HSA_STATUS_SUCCESS) return err;
+  MAKE_SCOPE_GUARD([&]() { staging_region->Free(temp, temp_size); });
+
+  core::unique_signal_ptr staged[2];
+  core::unique_signal_ptr drained[2];
+  for (int i = 0; i < 2; i++) {
+    staged[i].reset(new core::DefaultSignal(0));
+    drained[i].reset(new core::DefaultSignal(0));
+  }
+
+  // Wait for all submitted work before the staging buffers are released.
+  MAKE_SCOPE_GUARD([&]() {
+    for (int i = 0; i < 2; i++) {
+      staged[i]->WaitRelaxed(HSA_SIGNAL_CONDITION_EQ, 0, -1, HSA_WAIT_STATE_BLOCKED);
+      drained[i]->WaitRelaxed(HSA_SIGNAL_CONDITION_EQ, 0, -1, HSA_WAIT_STATE_BLOCKED);
+    }
+  });
+
+  std::vector<core::Signal*> no_deps;
+  for (size_t offset = 0, i = 0; offset < size; offset += chunk, i ^= 1) {
+    const size_t len = Min(chunk, size - offset);
+    void* buffer = reinterpret_cast<uint8_t*>(temp) + i * chunk;
+
+    drained[i]->WaitRelaxed(HSA_SIGNAL_CONDITION_EQ, 0, -1, HSA_WAIT_STATE_BLOCKED);
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    staged[i]->StoreRelaxed(1);
+    err = src_agent->DmaCopy(buffer, host, reinterpret_cast<const uint8_t*>(src) + offset,
+                             *src_agent, len, no_deps, *staged[i]);
+    if (err != HSA_STATUS_SUCCESS) {
+      staged[i]->StoreRelaxed(0);
+      return err;
+    }
+
+    std::vector<core::Signal*> deps(1, staged[i].get());
+    drained[i]->StoreRelaxed(1);
+    err = dst_agent->DmaCopy(reinterpret_cast<uint8_t*>(dst) + offset, *dst_agent, buffer, host,
+                             len, deps, *drained[i]);
+    if (err != HSA_STATUS_SUCCESS) {
+      drained[i]->StoreRelaxed(0);
+      return err;
+    }
+  }
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t Runtime::PipelinedLockedCopy(void* dst, const void* src, size_t size,
+                                          core::Agent* gpu_agent, bool h2d) {
+  const amd::MemoryRegion* system_region =
+      static_cast<const amd::MemoryRegion*>(system_regions_fine_[0]);
+  core::Agent& host = *cpu_agents_[0];
+  hsa_agent_t agent = gpu_agent->public_handle();
+
+  uint8_t* host_ptr = reinterpret_cast<uint8_t*>(h2d ? const_cast<void*>(src) : dst);
+  uint8_t* gpu_ptr = reinterpret_cast<uint8_t*>(h2d ? dst : const_cast<void*>(src));
+
+  // Two chunks in flight, each remembers its pinned range until its copy completes.
+  core::unique_signal_ptr done[2];
+  void* locked[2] = {nullptr, nullptr};
+  for (int i = 0; i < 2; i++) done[i].reset(new core::DefaultSignal(0));
+
+  const auto& retire = [&](int slot) {
+    if (locked[slot] == nullptr) return;
+    done[slot]->WaitRelaxed(HSA_SIGNAL_CONDITION_EQ, 0, -1, HSA_WAIT_STATE_BLOCKED);
+    system_region->Unlock(locked[slot], false);
+    locked[slot] = nullptr;
+  };
+  MAKE_SCOPE_GUARD([&]() {
+    retire(0);
+    retire(1);
+  });
+
+  std::vector<core::Signal*> no_deps;
+  int slot = 0;
+  size_t offset = 0;
+  while (offset < size) {
+    // Keep chunk boundaries page aligned so neighbouring chunks never pin the same page.
+    size_t end = AlignDown(uintptr_t(host_ptr) + offset + kLockedCopyChunkSize, 4096) -
+        uintptr_t(host_ptr);
+    end = Min(end, size);
+    const size_t len = end - offset;
+
+    retire(slot);
+
+    void* agent_ptr;
+    hsa_status_t err = system_region->Lock(1, &agent, host_ptr + offset, len, &agent_ptr, false);
+    if (err != HSA_STATUS_SUCCESS) return err;
+    locked[slot] = host_ptr + offset;
+
+    done[slot]->StoreRelaxed(1);
+    if (h2d)
+      err = gpu_agent->DmaCopy(gpu_ptr + offset, *gpu_agent, agent_ptr, host, len, no_deps,
+                               *done[slot]);
+    else
+      err = gpu_agent->DmaCopy(agent_ptr, host, gpu_ptr + offset, *gpu_agent, len, no_deps,
+                               *done[slot]);
+    if (err != HSA_STATUS_SUCCESS) {
+      done[slot]->StoreRelaxed(0);
+      return err;
+    }
+
+    offset = end;
+    slot ^= 1;
+  }
+  return HSA_STATUS_SUCCESS;
+}
+
+void* Runtime::AcquireStagingBuffer(const MemoryRegion* region) {
+  {
+    ScopedAcquire<KernelMutex> lock(&staging_lock_);
+    std::vector<void*>& buffers = staging_buffers_[region];
+    if (!buffers.empty()) {
+      void* ret = buffers.back();
+      buffers.pop_back();
+      return ret;
+    }
+  }
+
+  size_t size = kStagingBufferSize;
+  void* ret = nullptr;
+  if (region->Allocate(size, core::MemoryRegion::AllocateNoFlags, &ret) != HSA_STATUS_SUCCESS)
+    return nullptr;
+  return ret;
+}
+
+void Runtime::ReleaseStagingBuffer(const MemoryRegion* region, void* buffer) {
+  ScopedAcquire<KernelMutex> lock(&staging_lock_);
+  staging_buffers_[region].push_back(buffer);
 }
 
 hsa_status_t Runtime::CopyMemory(void* dst, core::Agent& dst_agent,
@@ -466,44 +1098,391 @@ hsa_status_t Runtime::CopyMemory(void* dst, core::Agent& dst_agent,
     core::Agent* copy_agent = (src_gpu) ? &src_agent : &dst_agent;
     if (flag_.rev_copy_dir() && dst_gpu && src_gpu)
       copy_agent = (copy_agent == &src_agent) ? &dst_agent : &src_agent;
+
+    TraceAsyncCopy(copy_agent->node_id(), size);
+
+    bool lazy;
+    hsa_status_t err = MapOnFirstUse(dst, size, *copy_agent, lazy);
+    if (err == HSA_STATUS_SUCCESS) err = MapOnFirstUse(src, size, *copy_agent, lazy);
+    if (err != HSA_STATUS_SUCCESS) return err;
+
     return copy_agent->DmaCopy(dst, dst_agent, src, src_agent, size, dep_signals,
                                completion_signal);
   }
 
-  // For cpu to cpu, fire and forget a copy thread.
+  TraceAsyncCopy(src_agent.node_id(), size);
+
+  // For cpu to cpu, hand the copy to the worker pool.
   const bool profiling_enabled =
       (dst_agent.profiling_enabled() || src_agent.profiling_enabled());
-  std::thread(
-      [](void* dst, const void* src, size_t size,
-         std::vector<core::Signal*> dep_signals,
-         core::Signal* completion_signal, bool profiling_enabled) {
-
-        for (core::Signal* dep : dep_signals) {
-          dep->WaitRelaxed(HSA_SIGNAL_CONDITION_EQ, 0, UINT64_MAX,
-                           HSA_WAIT_STATE_BLOCKED);
-        }
+  return cpu_copy_pool_.Submit(dst, dst_agent, src, size, dep_signals, completion_signal,
+                               profiling_enabled);
+}
 
-        if (profiling_enabled) {
-          core::Runtime::runtime_singleton_->GetSystemInfo(HSA_SYSTEM_INFO_TIMESTAMP,
-                                                           &completion_signal->signal_.start_ts);
-        }
+hsa_status_t Runtime::CopyMemoryBatch(const std::vector<hsa_amd_memory_copy_desc_t>& copies,
+                                      core::Agent& dst_agent, core::Agent& src_agent,
+                                      std::vector<core::Signal*>& dep_signals,
+                                      core::Signal& completion_signal) {
+  const bool dst_gpu =
+      (dst_agent.device_type() == core::Agent::DeviceType::kAmdGpuDevice);
+  const bool src_gpu =
+      (src_agent.device_type() == core::Agent::DeviceType::kAmdGpuDevice);
+  if (dst_gpu || src_gpu) {
+    core::Agent* copy_agent = (src_gpu) ? &src_agent : &dst_agent;
+    if (flag_.rev_copy_dir() && dst_gpu && src_gpu)
+      copy_agent = (copy_agent == &src_agent) ? &dst_agent : &src_agent;
+
+    for (const hsa_amd_memory_copy_desc_t& copy : copies) {
+      TraceAsyncCopy(copy_agent->node_id(), copy.size);
+      bool lazy;
+      hsa_status_t err = MapOnFirstUse(copy.dst, copy.size, *copy_agent, lazy);
+      if (err == HSA_STATUS_SUCCESS) err = MapOnFirstUse(copy.src, copy.size, *copy_agent, lazy);
+      if (err != HSA_STATUS_SUCCESS) return err;
+    }
+
+    return copy_agent->DmaCopyBatch(copies, dst_agent, src_agent, dep_signals,
+                                    completion_signal);
+  }
+
+  for (const hsa_amd_memory_copy_desc_t& copy : copies)
+    TraceAsyncCopy(src_agent.node_id(), copy.size);
 
-        memcpy(dst, src, size);
+  const bool profiling_enabled =
+      (dst_agent.profiling_enabled() || src_agent.profiling_enabled());
+  return cpu_copy_pool_.SubmitBatch(copies, dst_agent, dep_signals, completion_signal,
+                                    profiling_enabled);
+}
 
-        if (profiling_enabled) {
-          core::Runtime::runtime_singleton_->GetSystemInfo(HSA_SYSTEM_INFO_TIMESTAMP,
-                                                           &completion_signal->signal_.end_ts);
+hsa_status_t Runtime::CopyMemoryMulticast(const std::vector<void*>& dsts,
+                                          const std::vector<core::Agent*>& dst_agents,
+                                          const void* src, core::Agent& src_agent, size_t size,
+                                          std::vector<core::Signal*>& dep_signals,
+                                          core::Signal& completion_signal) {
+  assert(!dsts.empty() && dsts.size() == dst_agents.size() && size != 0 &&
+         "Bad multicast copy.");
+  const size_t num_dsts = dsts.size();
+  const int kSource = -1;
+
+  // Grow the relay tree one destination at a time, feeding the destination with the best
+  // bandwidth from the source or from a destination already in the tree.  A feeder's bandwidth
+  // is shared among the destinations it feeds.  Relays are restricted to direct XGMI links
+  // where the feeding GPU, which runs the copy, can write the destination.
+  std::vector<int> parent(num_dsts, kSource);
+  std::vector<uint32_t> fanout(num_dsts, 0);
+  std::vector<size_t> order;
+  std::vector<bool> placed(num_dsts, false);
+  uint32_t source_fanout = 0;
+  const auto& can_relay = [&](size_t from, size_t to) {
+    if (dst_agents[from]->device_type() != core::Agent::DeviceType::kAmdGpuDevice ||
+        dst_agents[to]->device_type() != core::Agent::DeviceType::kAmdGpuDevice ||
+        dst_agents[from] == dst_agents[to] || flag_.rev_copy_dir())
+      return false;
+    const LinkInfo link = GetLinkInfo(dst_agents[from]->node_id(), dst_agents[to]->node_id());
+    return (link.num_hop == 1) && (link.info.link_type == HSA_AMD_LINK_INFO_TYPE_XGMI) &&
+        IsMapped(dsts[to], *dst_agents[from]);
+  };
+
+  while (order.size() < num_dsts) {
+    size_t best = 0;
+    int best_parent = kSource;
+    double best_bandwidth = -1;
+    for (size_t to = 0; to < num_dsts; to++) {
+      if (placed[to]) continue;
+      // The source is always usable, treat unknown bandwidth as the slowest link.
+      const uint64_t direct = GetLinkCost(src_agent.node_id(), dst_agents[to]->node_id()).bandwidth;
+      double bandwidth = double(Max(direct, uint64_t(1))) / (source_fanout + 1);
+      int from_parent = kSource;
+      for (size_t from : order) {
+        if (!can_relay(from, to)) continue;
+        const uint64_t relay =
+            GetLinkCost(dst_agents[from]->node_id(), dst_agents[to]->node_id()).bandwidth;
+        const double shared = double(relay) / (fanout[from] + 1);
+        if (shared > bandwidth) {
+          bandwidth = shared;
+          from_parent = int(from);
         }
+      }
+      if (bandwidth > best_bandwidth) {
+        best_bandwidth = bandwidth;
+        best = to;
+        best_parent = from_parent;
+      }
+    }
+    placed[best] = true;
+    parent[best] = best_parent;
+    if (best_parent == kSource)
+      source_fanout++;
+    else
+      fanout[best_parent]++;
+    order.push_back(best);
+  }
 
-        completion_signal->SubRelease(1);
-      },
-      dst, src, size, dep_signals, &completion_signal,
-      profiling_enabled).detach();
+  // Enough chunks for the hops to overlap without flooding the engines with small copies.
+  const size_t kMaxChunks = 8;
+  const size_t kMinChunk = 4 * 1024 * 1024;
+  const size_t chunk = Min(size, Max(kMinChunk, AlignUp(size / kMaxChunks, size_t(4096))));
+  const size_t num_chunks = (size + chunk - 1) / chunk;
+
+  // arrived[d * num_chunks + c] is decremented once chunk c has landed in destination d.
+  std::vector<core::Signal*> arrived(num_dsts * num_chunks, nullptr);
+  std::vector<core::Signal*> submitted;
+  hsa_status_t err = HSA_STATUS_SUCCESS;
+  for (size_t dst : order) {
+    const bool relayed = (parent[dst] != kSource);
+    const uint8_t* from = relayed ? reinterpret_cast<const uint8_t*>(dsts[parent[dst]])
+                                  : reinterpret_cast<const uint8_t*>(src);
+    core::Agent& from_agent = relayed ? *dst_agents[parent[dst]] : src_agent;
+    uint8_t* to = reinterpret_cast<uint8_t*>(dsts[dst]);
+
+    for (size_t c = 0; (c < num_chunks) && (err == HSA_STATUS_SUCCESS); c++) {
+      const size_t offset = c * chunk;
+      const size_t len = Min(chunk, size - offset);
+      std::vector<core::Signal*> deps =
+          relayed ? std::vector<core::Signal*>(1, arrived[parent[dst] * num_chunks + c])
+                  : dep_signals;
+      core::Signal* signal = new core::DefaultSignal(1);
+      err = CopyMemory(to + offset, *dst_agents[dst], from + offset, from_agent, len, deps,
+                       *signal);
+      if (err != HSA_STATUS_SUCCESS) {
+        signal->DestroySignal();
+        break;
+      }
+      arrived[dst * num_chunks + c] = signal;
+      submitted.push_back(signal);
+    }
+    if (err != HSA_STATUS_SUCCESS) break;
+  }
 
+  if (submitted.empty()) return err;
+
+  // Release the chunk signals and signal completion once every copy has landed.  A partial
+  // submission can't be recalled, its failure is reported through the completion signal.
+  const bool failed = (err != HSA_STATUS_SUCCESS);
+  hsa_status_t status = SubmitHostTask(
+      [submitted, failed]() {
+        for (core::Signal* signal : submitted) signal->DestroySignal();
+        return !failed;
+      },
+      *dst_agents[order[0]], submitted, completion_signal);
+  if (status != HSA_STATUS_SUCCESS) {
+    // Without a host worker, retire the copies here.
+    for (core::Signal* signal : submitted) {
+      signal->WaitRelaxed(HSA_SIGNAL_CONDITION_EQ, 0, -1, HSA_WAIT_STATE_BLOCKED);
+      signal->DestroySignal();
+    }
+    return status;
+  }
   return HSA_STATUS_SUCCESS;
 }
 
+namespace {
+struct QueueFenceSignals {
+  Signal* arrive;
+  Signal* depart;
+};
+
+bool ReleaseQueueFence(hsa_signal_value_t value, void* arg) {
+  QueueFenceSignals* fence = reinterpret_cast<QueueFenceSignals*>(arg);
+  fence->arrive->DestroySignal();
+  fence->depart->DestroySignal();
+  delete fence;
+  return false;
+}
+}  // namespace
+
+hsa_status_t Runtime::QueueFence(const std::vector<Queue*>& queues,
+                                 const std::vector<Agent*>& copy_agents) {
+  std::vector<Blit*> engines;
+  for (Agent* agent : copy_agents)
+    static_cast<amd::GpuAgent*>(agent)->AsyncCopyEngines(engines);
+
+  const size_t participants = queues.size() + engines.size();
+  if (participants == 0) return HSA_STATUS_SUCCESS;
+
+  // Only the device waits on arrive, the async handler waits on depart.
+  QueueFenceSignals* fence = new QueueFenceSignals;
+  fence->arrive = new DefaultSignal(hsa_signal_value_t(participants));
+  fence->depart = g_use_interrupt_wait
+      ? static_cast<Signal*>(new InterruptSignal(hsa_signal_value_t(participants)))
+      : static_cast<Signal*>(new DefaultSignal(hsa_signal_value_t(participants)));
+
+  const uint16_t kBarrierHeader = (HSA_PACKET_TYPE_BARRIER_AND << HSA_PACKET_HEADER_TYPE) |
+      (1 << HSA_PACKET_HEADER_BARRIER) |
+      (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_SCACQUIRE_FENCE_SCOPE) |
+      (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_SCRELEASE_FENCE_SCOPE);
+  AqlPacket packets[2];
+  memset(packets, 0, sizeof(packets));
+  packets[0].barrier_and.header = kBarrierHeader;
+  packets[0].barrier_and.completion_signal = Signal::Convert(fence->arrive);
+  packets[1].barrier_and.header = kBarrierHeader;
+  packets[1].barrier_and.dep_signal[0] = Signal::Convert(fence->arrive);
+  packets[1].barrier_and.completion_signal = Signal::Convert(fence->depart);
+
+  // A participant that could not take its part arrives and departs from here, the others are
+  // still released but no longer ordered against it.
+  hsa_status_t ret = HSA_STATUS_SUCCESS;
+  for (Queue* queue : queues) {
+    hsa_status_t err = SubmitPackets(queue, packets, 2, UINT64_MAX);
+    if (err != HSA_STATUS_SUCCESS) {
+      fence->arrive->SubRelaxed(1);
+      fence->depart->SubRelaxed(1);
+      ret = err;
+    }
+  }
+
+  std::vector<Signal*> no_deps;
+  std::vector<Signal*> arrive_dep(1, fence->arrive);
+  for (Blit* engine : engines) {
+    hsa_status_t err = engine->SubmitBarrier(no_deps, *fence->arrive);
+    if (err != HSA_STATUS_SUCCESS) fence->arrive->SubRelaxed(1);
+    if (err == HSA_STATUS_SUCCESS) err = engine->SubmitBarrier(arrive_dep, *fence->depart);
+    if (err != HSA_STATUS_SUCCESS) {
+      fence->depart->SubRelaxed(1);
+      ret = err;
+    }
+  }
+
+  hsa_status_t err = SetAsyncSignalHandler(Signal::Convert(fence->depart), HSA_SIGNAL_CONDITION_EQ,
+                                           0, ReleaseQueueFence, fence);
+  return (ret != HSA_STATUS_SUCCESS) ? ret : err;
+}
+
+uint64_t Runtime::SystemTimestamp() {
+  double time;
+  uint64_t tick;
+  double ratio;
+  for (;;) {
+    uint32_t seq;
+    do {
+      seq = sys_clock_seq_.load(std::memory_order_acquire);
+      time = sys_clock_time_.load(std::memory_order_relaxed);
+      tick = sys_clock_tick_.load(std::memory_order_relaxed);
+      ratio = sys_clock_ratio_.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+    } while (((seq & 1) != 0) || (seq != sys_clock_seq_.load(std::memory_order_relaxed)));
+
+    // No correlation before the first CPU agent is registered.
+    if (ratio == 0.0) {
+      HsaClockCounters clocks;
+      hsaKmtGetClockCounters(0, &clocks);
+      return clocks.SystemClockCounter;
+    }
+
+    const double now = timer::fast_clock::now().time_since_epoch().count();
+    const double elapsed = Max(now - time, 0.0);
+    const uint64_t extrapolated = tick + uint64_t(ratio * elapsed);
+    if (elapsed <= double(kSystemClockResyncInterval) * 1e9) return extrapolated;
+
+    // Only one thread resyncs, others keep extrapolating.
+    if (!sys_clock_lock_.Try()) return extrapolated;
+    const bool synced = (time != sys_clock_time_.load(std::memory_order_relaxed)) ||
+        SyncSystemClock();
+    sys_clock_lock_.Release();
+    if (!synced) return extrapolated;
+  }
+}
+
+bool Runtime::SyncSystemClock() {
+  // Bracket the driver query, the midpoint is the best estimate of when it
+  // sampled the clock.
+  HsaClockCounters clocks;
+  const double before = timer::fast_clock::now().time_since_epoch().count();
+  HSAKMT_STATUS err = hsaKmtGetClockCounters(0, &clocks);
+  const double after = timer::fast_clock::now().time_since_epoch().count();
+  assert(err == HSAKMT_STATUS_SUCCESS && "hsaGetClockCounters error");
+  if (err != HSAKMT_STATUS_SUCCESS) return false;
+
+  const double time = (before + after) / 2.0;
+  uint64_t tick = clocks.SystemClockCounter;
+
+  double ratio;
+  const double last_ratio = sys_clock_ratio_.load(std::memory_order_relaxed);
+  if (last_ratio == 0.0) {
+    sys_clock_time0_ = time;
+    sys_clock_tick0_ = tick;
+    ratio = double(clocks.SystemClockFrequencyHz) * 1e-12;
+  } else {
+    // Never step back past timestamps already extrapolated from the previous
+    // correlation, measuring drift over the whole run keeps the correction small.
+    const uint64_t extrapolated = sys_clock_tick_.load(std::memory_order_relaxed) +
+        uint64_t(last_ratio * (time - sys_clock_time_.load(std::memory_order_relaxed)));
+    tick = Max(tick, extrapolated);
+    ratio = double(clocks.SystemClockCounter - sys_clock_tick0_) / (time - sys_clock_time0_);
+  }
+
+  const uint32_t seq = sys_clock_seq_.load(std::memory_order_relaxed);
+  sys_clock_seq_.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  sys_clock_time_.store(time, std::memory_order_relaxed);
+  sys_clock_tick_.store(tick, std::memory_order_relaxed);
+  sys_clock_ratio_.store(ratio, std::memory_order_relaxed);
+  sys_clock_seq_.store(seq + 2, std::memory_order_release);
+  return true;
+}
+
+void Runtime::TraceAsyncCopy(uint32_t node_id, size_t size) {
+  if (!tracer_.enabled()) return;
+  hsa_amd_trace_record_t record = {};
+  record.kind = HSA_AMD_TRACE_RECORD_ASYNC_COPY;
+  record.node_id = node_id;
+  record.start = Tracer::Now();
+  record.size = size;
+  tracer_.Record(record);
+}
+
 hsa_status_t Runtime::FillMemory(void* ptr, uint32_t value, size_t count) {
+  Tracer::Span trace(tracer_, HSA_AMD_TRACE_RECORD_FILL, count * sizeof(uint32_t));
+
+  core::Agent* blit_agent;
+  core::Agent* owner;
+  hsa_status_t err = FillAgent(ptr, count * sizeof(uint32_t), &blit_agent, &owner);
+  if (err != HSA_STATUS_SUCCESS) return err;
+
+  if (blit_agent) return blit_agent->DmaFill(ptr, value, count);
+
+  // Host and unmapped SVM addresses are set by the host.
+  stream::HostFill(ptr, value, count);
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t Runtime::SubmitHostTask(std::function<bool()> task, const Agent& agent,
+                                     const std::vector<core::Signal*>& dep_signals,
+                                     core::Signal& completion_signal, bool user) {
+  return cpu_copy_pool_.SubmitTask(std::move(task), *GetNearestCpuAgent(agent), dep_signals,
+                                   completion_signal, user);
+}
+
+hsa_status_t Runtime::FillMemory(const std::vector<core::FillRange>& ranges, uint32_t value,
+                                 std::vector<core::Signal*>& dep_signals,
+                                 core::Signal& completion_signal) {
+  assert(!ranges.empty() && "Empty fill.");
+  uintptr_t start = uintptr_t(ranges[0].ptr);
+  uintptr_t end = start;
+  for (const core::FillRange& range : ranges) {
+    start = Min(start, uintptr_t(range.ptr));
+    end = Max(end, uintptr_t(range.ptr) + range.size);
+  }
+
+  core::Agent* fill_agent;
+  core::Agent* owner;
+  hsa_status_t err = FillAgent(reinterpret_cast<void*>(start), end - start, &fill_agent, &owner);
+  if (err != HSA_STATUS_SUCCESS) return err;
+
+  if (fill_agent) return fill_agent->DmaFill(ranges, value, dep_signals, completion_signal);
+
+  // Host memory is set by the copy workers of the owning node, as for copies.
+  const core::Agent* dst_agent =
+      ((owner != nullptr) && (owner->device_type() == core::Agent::DeviceType::kAmdCpuDevice))
+      ? owner
+      : cpu_agents_[0];
+  return cpu_copy_pool_.SubmitFill(ranges, value, *dst_agent, dep_signals, completion_signal,
+                                   dst_agent->profiling_enabled());
+}
+
+hsa_status_t Runtime::FillAgent(void* ptr, size_t size, core::Agent** fill_agent,
+                                core::Agent** owner) {
+  *fill_agent = nullptr;
+
   // Choose blit agent from pointer info
   hsa_amd_pointer_info_t info;
   uint32_t agent_count;
@@ -512,8 +1491,9 @@ hsa_status_t Runtime::FillMemory(void* ptr, uint32_t value, size_t count) {
   MAKE_SCOPE_GUARD([&]() { free(accessible); });
   hsa_status_t err = PtrInfo(ptr, &info, malloc, &agent_count, &accessible);
   if (err != HSA_STATUS_SUCCESS) return err;
+  *owner = core::Agent::Convert(info.agentOwner);
 
-  ptrdiff_t endPtr = (ptrdiff_t)ptr + count * sizeof(uint32_t);
+  ptrdiff_t endPtr = (ptrdiff_t)ptr + size;
 
   // Check for GPU fill
   // Selects GPU fill for SVM and Locked allocations if a GPU address is given and is mapped.
@@ -530,37 +1510,70 @@ hsa_status_t Runtime::FillMemory(void* ptr, uint32_t value, size_t count) {
         }
       }
     }
-    if (blit_agent) return blit_agent->DmaFill(ptr, value, count);
+    if (blit_agent) {
+      *fill_agent = blit_agent;
+      return HSA_STATUS_SUCCESS;
+    }
   }
 
-  // Host and unmapped SVM addresses copy via host.
+  // Host and unmapped SVM addresses are set via host.
   if (info.hostBaseAddress <= ptr && endPtr <= (ptrdiff_t)info.hostBaseAddress + info.sizeInBytes) {
-    memset(ptr, value, count * sizeof(uint32_t));
     return HSA_STATUS_SUCCESS;
   }
 
   return HSA_STATUS_ERROR_INVALID_ALLOCATION;
 }
 
+// Zero pool buffers are handed to unrelated allocations, so only memory mapped to its owner
+// alone may be recycled, as with the region's block cache.
+static bool SharesWithPeers(const MemoryRegion* region, uint32_t num_agents,
+                            const hsa_agent_t* agents) {
+  if ((region == nullptr) || (agents == nullptr)) return false;
+  const uint64_t owner = region->owner()->public_handle().handle;
+  for (uint32_t i = 0; i < num_agents; i++) {
+    if (agents[i].handle != owner) return true;
+  }
+  return false;
+}
+
 hsa_status_t Runtime::AllowAccess(uint32_t num_agents,
                                   const hsa_agent_t* agents, const void* ptr) {
   const amd::MemoryRegion* amd_region = NULL;
   size_t alloc_size = 0;
 
-  {
-    ScopedAcquire<KernelMutex> lock(&memory_lock_);
+  const bool found =
+      allocation_map_.Update(ptr, false, [&](const void*, size_t, AllocationRegion& alloc) {
+        amd_region = reinterpret_cast<const amd::MemoryRegion*>(alloc.region);
+        alloc_size = alloc.size;
+        if (SharesWithPeers(alloc.region, num_agents, agents)) alloc.zeroed = false;
+      });
 
-    std::map<const void*, AllocationRegion>::const_iterator it = allocation_map_.find(ptr);
+  if (!found) {
+    return HSA_STATUS_ERROR;
+  }
 
-    if (it == allocation_map_.end()) {
-      return HSA_STATUS_ERROR;
-    }
+  return amd_region->AllowAccess(num_agents, agents, ptr, alloc_size);
+}
 
-    amd_region = reinterpret_cast<const amd::MemoryRegion*>(it->second.region);
-    alloc_size = it->second.size;
+hsa_status_t Runtime::AllowAccess(uint32_t num_agents, const hsa_agent_t* agents,
+                                  uint32_t num_ptrs, const void* const* ptrs) {
+  // Group the allocations by region so that each region handles its share in one call.
+  std::map<const amd::MemoryRegion*, std::vector<std::pair<const void*, size_t>>> batches;
+  for (uint32_t i = 0; i < num_ptrs; i++) {
+    const bool found = allocation_map_.Update(
+        ptrs[i], false, [&](const void*, size_t, AllocationRegion& alloc) {
+          batches[reinterpret_cast<const amd::MemoryRegion*>(alloc.region)].push_back(
+              std::make_pair(ptrs[i], alloc.size));
+          if (SharesWithPeers(alloc.region, num_agents, agents)) alloc.zeroed = false;
+        });
+    if (!found) return HSA_STATUS_ERROR;
   }
 
-  return amd_region->AllowAccess(num_agents, agents, ptr, alloc_size);
+  for (const auto& batch : batches) {
+    hsa_status_t err = batch.first->AllowAccess(num_agents, agents, batch.second);
+    if (err != HSA_STATUS_SUCCESS) return err;
+  }
+  return HSA_STATUS_SUCCESS;
 }
 
 hsa_status_t Runtime::GetSystemInfo(hsa_system_info_t attribute, void* value) {
@@ -572,16 +1585,11 @@ hsa_status_t Runtime::GetSystemInfo(hsa_system_info_t attribute, void* value) {
       *((uint16_t*)value) = HSA_VERSION_MINOR;
       break;
     case HSA_SYSTEM_INFO_TIMESTAMP: {
-      HsaClockCounters clocks;
-      hsaKmtGetClockCounters(0, &clocks);
-      *((uint64_t*)value) = clocks.SystemClockCounter;
+      *((uint64_t*)value) = SystemTimestamp();
       break;
     }
     case HSA_SYSTEM_INFO_TIMESTAMP_FREQUENCY: {
-      assert(sys_clock_freq_ != 0 &&
-             "Use of HSA_SYSTEM_INFO_TIMESTAMP_FREQUENCY before HSA "
-             "initialization completes.");
-      *(uint64_t*)value = sys_clock_freq_;
+      *(uint64_t*)value = sys_clock_freq();
       break;
     }
     case HSA_SYSTEM_INFO_SIGNAL_MAX_WAIT:
@@ -642,90 +1650,113 @@ hsa_status_t Runtime::SetAsyncSignalHandler(hsa_signal_t signal,
                                             hsa_signal_condition_t cond,
                                             hsa_signal_value_t value,
                                             hsa_amd_signal_handler handler,
-                                            void* arg) {
-  // Indicate that this signal is in use.
-  if (signal.handle != 0) hsa_signal_handle(signal)->Retain();
-
-  ScopedAcquire<KernelMutex> scope_lock(&async_events_control_.lock);
+                                            void* arg, bool user) {
+  const uint32_t num_threads = uint32_t(async_events_control_.size());
+  const uint32_t thread_index = (signal.handle != 0)
+      ? uint32_t((signal.handle / sizeof(amd_signal_t)) % num_threads)
+      : (async_events_next_++ % num_threads);
+  AsyncEventsControl& control = *async_events_control_[thread_index];
 
   // Lazy initializer
-  if (async_events_control_.async_events_thread_ == NULL) {
-    // Create monitoring thread control signal
-    auto err = HSA::hsa_signal_create(0, 0, NULL, &async_events_control_.wake);
-    if (err != HSA_STATUS_SUCCESS) {
-      assert(false && "Asyncronous events control signal creation error.");
-      return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
-    }
-    async_events_.PushBack(async_events_control_.wake, HSA_SIGNAL_CONDITION_NE,
-                           0, NULL, NULL);
-
-    // Start event monitoring thread
-    async_events_control_.exit = false;
-    async_events_control_.async_events_thread_ =
-        os::CreateThread(AsyncEventsLoop, NULL);
-    if (async_events_control_.async_events_thread_ == NULL) {
-      assert(false && "Asyncronous events thread creation error.");
-      return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+  if (!control.started.load(std::memory_order_acquire)) {
+    ScopedAcquire<KernelMutex> scope_lock(&async_events_lock_);
+    if (!control.started.load(std::memory_order_relaxed)) {
+      // Create monitoring thread control signal
+      auto err = HSA::hsa_signal_create(0, 0, NULL, &control.wake);
+      if (err != HSA_STATUS_SUCCESS) {
+        assert(false && "Asyncronous events control signal creation error.");
+        return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+      }
+      control.async_events_.PushBack(control.wake, HSA_SIGNAL_CONDITION_NE, 0, NULL, NULL, false);
+
+      // Start event monitoring thread
+      control.exit = false;
+      control.async_events_thread_ = os::CreateThread(AsyncEventsLoop, &control);
+      if (control.async_events_thread_ == NULL) {
+        assert(false && "Asyncronous events thread creation error.");
+        control.async_events_.Clear();
+        HSA::hsa_signal_destroy(control.wake);
+        return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+      }
+      control.started.store(true, std::memory_order_release);
     }
   }
 
-  new_async_events_.PushBack(signal, cond, value, handler, arg);
+  // Indicate that this signal is in use.
+  if (signal.handle != 0) hsa_signal_handle(signal)->Retain();
 
-  hsa_signal_handle(async_events_control_.wake)->StoreRelease(1);
+  AsyncEventNode* node = new AsyncEventNode;
+  node->signal = signal;
+  node->cond = cond;
+  node->value = value;
+  node->handler = handler;
+  node->arg = arg;
+  node->user = user;
+  QueueAsyncEvent(control, node);
 
   return HSA_STATUS_SUCCESS;
 }
 
+void Runtime::QueueAsyncEvent(AsyncEventsControl& control, AsyncEventNode* node) {
+  node->next = control.new_async_events_.load(std::memory_order_relaxed);
+  while (!control.new_async_events_.compare_exchange_weak(
+      node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+  }
+
+  hsa_signal_handle(control.wake)->StoreRelease(1);
+}
+
+void Runtime::ExecuteAsyncEvent(AsyncEventsControl& control, AsyncEventNode* node,
+                                hsa_signal_value_t value) {
+  // The node carries the signal reference taken by SetAsyncSignalHandler until the handler
+  // is dropped.
+  std::shared_ptr<AsyncEventNode> event(node);
+  AsyncExecutor::Lane lane = node->user ? AsyncExecutor::kUserLane : AsyncExecutor::kRuntimeLane;
+  AsyncEventsControl* owner = &control;
+
+  async_executor_.Submit(lane,
+                         [event, owner, value]() {
+                           if (event->signal.handle == 0) {
+                             ((void (*)(void*))event->handler)(event->arg);
+                             return;
+                           }
+                           if (!event->handler(value, event->arg)) {
+                             hsa_signal_handle(event->signal)->Release();
+                             return;
+                           }
+                           AsyncEventNode* rearm = new AsyncEventNode(*event);
+                           QueueAsyncEvent(*owner, rearm);
+                         },
+                         [event]() {
+                           if (event->signal.handle != 0)
+                             hsa_signal_handle(event->signal)->Release();
+                         });
+}
+
 hsa_status_t Runtime::InteropMap(uint32_t num_agents, Agent** agents,
                                  int interop_handle, uint32_t flags,
                                  size_t* size, void** ptr,
                                  size_t* metadata_size, const void** metadata) {
-  static const int tinyArraySize=8;
-  HsaGraphicsResourceInfo info;
-
-  HSAuint32 short_nodes[tinyArraySize];
-  HSAuint32* nodes = short_nodes;
-  if (num_agents > tinyArraySize) {
-    nodes = new HSAuint32[num_agents];
-    if (nodes == NULL) return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
-  }
-  MAKE_SCOPE_GUARD([&]() {
-    if (num_agents > tinyArraySize) delete[] nodes;
-  });
-
+  std::vector<uint32_t> nodes(num_agents);
   for (uint32_t i = 0; i < num_agents; i++)
     agents[i]->GetInfo((hsa_agent_info_t)HSA_AMD_AGENT_INFO_DRIVER_NODE_ID,
                        &nodes[i]);
 
-  if (hsaKmtRegisterGraphicsHandleToNodes(interop_handle, &info, num_agents,
-                                          nodes) != HSAKMT_STATUS_SUCCESS)
-    return HSA_STATUS_ERROR;
-
-  HSAuint64 altAddress;
-  HsaMemMapFlags map_flags;
-  map_flags.Value = 0;
-  map_flags.ui32.PageSize = HSA_PAGE_SIZE_64KB;
-  if (hsaKmtMapMemoryToGPUNodes(info.MemoryAddress, info.SizeInBytes,
-                                &altAddress, map_flags, num_agents,
-                                nodes) != HSAKMT_STATUS_SUCCESS) {
-    map_flags.ui32.PageSize = HSA_PAGE_SIZE_4KB;
-    if (hsaKmtMapMemoryToGPUNodes(info.MemoryAddress, info.SizeInBytes, &altAddress, map_flags,
-                                  num_agents, nodes) != HSAKMT_STATUS_SUCCESS) {
-      hsaKmtDeregisterMemory(info.MemoryAddress);
-      return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
-    }
-  }
-
-  if (metadata_size != NULL) *metadata_size = info.MetadataSizeInBytes;
-  if (metadata != NULL) *metadata = info.Metadata;
+  bool first;
+  hsa_status_t err =
+      interop_cache_.Map(interop_handle, nodes, size, ptr, metadata_size, metadata, first);
+  if (err != HSA_STATUS_SUCCESS) return err;
 
-  *size = info.SizeInBytes;
-  *ptr = info.MemoryAddress;
+  if (first) RegisterMappedPtrOwner(*ptr, *size);
 
   return HSA_STATUS_SUCCESS;
 }
 
 hsa_status_t Runtime::InteropUnmap(void* ptr) {
+  hsa_status_t status;
+  if (interop_cache_.Unmap(ptr, status)) return status;
+
+  DeregisterPtrOwner(ptr);
   if(hsaKmtUnmapMemoryToGPU(ptr)!=HSAKMT_STATUS_SUCCESS)
     return HSA_STATUS_ERROR_INVALID_ARGUMENT;
   if(hsaKmtDeregisterMemory(ptr)!=HSAKMT_STATUS_SUCCESS)
@@ -756,9 +1787,12 @@ hsa_status_t Runtime::PtrInfo(void* ptr, hsa_amd_pointer_info_t* info, void* (*a
   bool returnListData =
       ((alloc != nullptr) && (num_agents_accessible != nullptr) && (accessible != nullptr));
 
-  {  // memory_lock protects access to the NMappedNodes array and fragment user data since these may
-     // change with calls to memory APIs.
-    ScopedAcquire<KernelMutex> lock(&memory_lock_);
+  {  // memory_lock protects access to the NMappedNodes array since it may change with calls to
+     // memory APIs.  Queries that don't return the list leave memory_lock alone.
+    if (returnListData) memory_lock_.Acquire();
+    MAKE_SCOPE_GUARD([&]() {
+      if (returnListData) memory_lock_.Release();
+    });
     hsaKmtQueryPointerInfo(ptr, &thunkInfo);
     if (returnListData) {
       assert(thunkInfo.NMappedNodes <= agents_by_node_.size() &&
@@ -780,20 +1814,16 @@ hsa_status_t Runtime::PtrInfo(void* ptr, hsa_amd_pointer_info_t* info, void* (*a
       block_info->length = retInfo.sizeInBytes;
     }
     if (retInfo.type == HSA_EXT_POINTER_TYPE_HSA) {
-      auto fragment = allocation_map_.upper_bound(ptr);
-      if (fragment != allocation_map_.begin()) {
-        fragment--;
-        if ((fragment->first <= ptr) &&
-            (ptr < reinterpret_cast<const uint8_t*>(fragment->first) + fragment->second.size)) {
-          // agent and host address must match here.  Only lock memory is allowed to have differing
-          // addresses but lock memory has type HSA_EXT_POINTER_TYPE_LOCKED and cannot be
-          // suballocated.
-          retInfo.agentBaseAddress = const_cast<void*>(fragment->first);
-          retInfo.hostBaseAddress = retInfo.agentBaseAddress;
-          retInfo.sizeInBytes = fragment->second.size;
-          retInfo.userData = fragment->second.user_ptr;
-        }
-      }
+      allocation_map_.Find(
+          ptr, true, [&](const void* base, size_t size, const AllocationRegion& fragment) {
+            // agent and host address must match here.  Only lock memory is allowed to have
+            // differing addresses but lock memory has type HSA_EXT_POINTER_TYPE_LOCKED and cannot
+            // be suballocated.
+            retInfo.agentBaseAddress = const_cast<void*>(base);
+            retInfo.hostBaseAddress = retInfo.agentBaseAddress;
+            retInfo.sizeInBytes = size;
+            retInfo.userData = fragment.user_ptr;
+          });
     }
   }  // end lock scope
 
@@ -845,14 +1875,12 @@ hsa_status_t Runtime::PtrInfo(void* ptr, hsa_amd_pointer_info_t* info, void* (*a
 }
 
 hsa_status_t Runtime::SetPtrInfoData(void* ptr, void* userptr) {
-  {  // Use allocation map if possible to handle fragments.
-    ScopedAcquire<KernelMutex> lock(&memory_lock_);
-    const auto& it = allocation_map_.find(ptr);
-    if (it != allocation_map_.end()) {
-      it->second.user_ptr = userptr;
-      return HSA_STATUS_SUCCESS;
-    }
-  }
+  // Use allocation map if possible to handle fragments.
+  if (allocation_map_.Update(ptr, false, [&](const void*, size_t, AllocationRegion& alloc) {
+        alloc.user_ptr = userptr;
+      }))
+    return HSA_STATUS_SUCCESS;
+
   // Cover entries not in the allocation map (graphics, lock,...)
   if (hsaKmtSetMemoryUserData(ptr, userptr) == HSAKMT_STATUS_SUCCESS)
     return HSA_STATUS_SUCCESS;
@@ -871,6 +1899,18 @@ hsa_status_t Runtime::IPCCreate(void* ptr, size_t len, hsa_amd_ipc_memory_t* han
   info.size = sizeof(info);
   if (PtrInfo(ptr, &info, nullptr, nullptr, nullptr, &block) != HSA_STATUS_SUCCESS)
     return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  // Whole allocations may be padded beyond the requested length, share them as they are.
+  const bool whole = (block.base == ptr) && (info.sizeInBytes == block.length) &&
+      (len <= block.length);
+  if (whole) len = block.length;
+
+  // Importers keep the memory mapped after a local free, so it may not be reused.
+  allocation_map_.Find(ptr, true, [&](const void* base, size_t, const AllocationRegion& alloc) {
+    const amd::MemoryRegion* region = static_cast<const amd::MemoryRegion*>(alloc.region);
+    if ((region != nullptr) && region->IsLocalMemory()) region->ExcludeFromBlockCache(base);
+  });
+
   if ((block.base != ptr) || (block.length != len)) {
     if (!IsMultipleOf(block.base, 2 * 1024 * 1024)) {
       assert(false && "Fragment's block not aligned to 2MB!");
@@ -893,179 +1933,181 @@ hsa_status_t Runtime::IPCCreate(void* ptr, size_t len, hsa_amd_ipc_memory_t* han
 
 hsa_status_t Runtime::IPCAttach(const hsa_amd_ipc_memory_t* handle, size_t len, uint32_t num_agents,
                                 Agent** agents, void** mapped_ptr) {
-  static const int tinyArraySize = 8;
-  void* importAddress;
-  HSAuint64 importSize;
-  HSAuint64 altAddress;
-
   hsa_amd_ipc_memory_t importHandle;
   importHandle = *handle;
 
   // Extract fragment info
   bool isFragment = false;
   uint32_t fragOffset = 0;
-  auto fixFragment = [&]() {
-    if (!isFragment) return;
-    importAddress = reinterpret_cast<uint8_t*>(importAddress) + fragOffset;
-    len = Min(len, importSize - fragOffset);
-    ScopedAcquire<KernelMutex> lock(&memory_lock_);
-    allocation_map_[importAddress] = AllocationRegion(nullptr, len);
-  };
-
   if ((importHandle.handle[6] & 0x80000000) != 0) {
     isFragment = true;
     fragOffset = (importHandle.handle[6] & 0x1FF) * 4096;
     importHandle.handle[6] &= ~(0x80000000 | 0x1FF);
   }
 
-  if (num_agents == 0) {
-    if (hsaKmtRegisterSharedHandle(reinterpret_cast<const HsaSharedMemoryHandle*>(&importHandle),
-                                   &importAddress, &importSize) != HSAKMT_STATUS_SUCCESS)
-      return HSA_STATUS_ERROR_INVALID_ARGUMENT;
-    if (hsaKmtMapMemoryToGPU(importAddress, importSize, &altAddress) != HSAKMT_STATUS_SUCCESS) {
-      hsaKmtDeregisterMemory(importAddress);
-      return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
-    }
-    fixFragment();
-    *mapped_ptr = importAddress;
-    return HSA_STATUS_SUCCESS;
-  }
-
-  HSAuint32* nodes = nullptr;
-  if (num_agents > tinyArraySize)
-    nodes = new HSAuint32[num_agents];
-  else
-    nodes = (HSAuint32*)alloca(sizeof(HSAuint32) * num_agents);
-  if (nodes == NULL) return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
-
-  MAKE_SCOPE_GUARD([&]() {
-    if (num_agents > tinyArraySize) delete[] nodes;
-  });
-
+  std::vector<uint32_t> nodes(num_agents);
   for (uint32_t i = 0; i < num_agents; i++)
     agents[i]->GetInfo((hsa_agent_info_t)HSA_AMD_AGENT_INFO_DRIVER_NODE_ID, &nodes[i]);
 
-  if (hsaKmtRegisterSharedHandleToNodes(
-          reinterpret_cast<const HsaSharedMemoryHandle*>(&importHandle), &importAddress,
-          &importSize, num_agents, nodes) != HSAKMT_STATUS_SUCCESS)
-    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
-
-  HsaMemMapFlags map_flags;
-  map_flags.Value = 0;
-  map_flags.ui32.PageSize = HSA_PAGE_SIZE_64KB;
-  if (hsaKmtMapMemoryToGPUNodes(importAddress, importSize, &altAddress, map_flags, num_agents,
-                                nodes) != HSAKMT_STATUS_SUCCESS) {
-    map_flags.ui32.PageSize = HSA_PAGE_SIZE_4KB;
-    if (hsaKmtMapMemoryToGPUNodes(importAddress, importSize, &altAddress, map_flags, num_agents,
-                                  nodes) != HSAKMT_STATUS_SUCCESS) {
-      hsaKmtDeregisterMemory(importAddress);
-      return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
-    }
-  }
+  // Repeated attaches of the same pointer share its bookkeeping.
+  void* importAddress;
+  size_t importSize;
+  hsa_status_t err = ipc_cache_.Attach(
+      importHandle, nodes, fragOffset, &importAddress, &importSize,
+      [&](void* ptr, size_t size) {
+        const size_t frag_len = Min(len, size - fragOffset);
+        if (isFragment) allocation_map_.Insert(ptr, frag_len, AllocationRegion(nullptr, frag_len));
+        RegisterMappedPtrOwner(ptr, isFragment ? frag_len : size);
+      });
+  if (err != HSA_STATUS_SUCCESS) return err;
 
-  fixFragment();
   *mapped_ptr = importAddress;
   return HSA_STATUS_SUCCESS;
 }
 
 hsa_status_t Runtime::IPCDetach(void* ptr) {
-  {  // Handle imported fragments.
-    ScopedAcquire<KernelMutex> lock(&memory_lock_);
-    const auto& it = allocation_map_.find(ptr);
-    if (it != allocation_map_.end()) {
-      if (it->second.region != nullptr) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
-      allocation_map_.erase(it);
-      lock.Release();  // Can't hold memory lock when using pointer info.
-
-      PtrInfoBlockData block;
-      hsa_amd_pointer_info_t info;
-      info.size = sizeof(info);
-      if (PtrInfo(ptr, &info, nullptr, nullptr, nullptr, &block) != HSA_STATUS_SUCCESS)
-        return HSA_STATUS_ERROR_INVALID_ARGUMENT;
-      ptr = block.base;
-    }
-  }
-  if (hsaKmtUnmapMemoryToGPU(ptr) != HSAKMT_STATUS_SUCCESS)
-    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
-  if (hsaKmtDeregisterMemory(ptr) != HSAKMT_STATUS_SUCCESS)
-    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
-  return HSA_STATUS_SUCCESS;
+  // Bookkeeping is dropped under the cache lock, before a new attach of ptr can add its own.
+  const bool attached = ipc_cache_.Detach(ptr, [&]() {
+    DeregisterPtrOwner(ptr);
+    // Drop the entry of imported fragments.
+    allocation_map_.Erase(ptr,
+                          [](size_t, AllocationRegion& alloc) { return alloc.region == nullptr; });
+  });
+  return attached ? HSA_STATUS_SUCCESS : HSA_STATUS_ERROR_INVALID_ARGUMENT;
 }
 
-void Runtime::AsyncEventsLoop(void*) {
-  auto& async_events_control_ = runtime_singleton_->async_events_control_;
-  auto& async_events_ = runtime_singleton_->async_events_;
-  auto& new_async_events_ = runtime_singleton_->new_async_events_;
+void Runtime::AsyncEventsLoop(void* arg) {
+  AsyncEventsControl& control = *reinterpret_cast<AsyncEventsControl*>(arg);
+  AsyncEvents& async_events = control.async_events_;
+  ThreadPolicies::ThreadState policy_state;
+
+  while (!control.exit) {
+    runtime_singleton_->thread_policies().Apply(ThreadPolicies::kAsyncEvents, policy_state);
 
-  while (!async_events_control_.exit) {
     // Wait for a signal
     hsa_signal_value_t value;
-    uint32_t index = AMD::hsa_amd_signal_wait_any(
-        uint32_t(async_events_.Size()), &async_events_.signal_[0],
-        &async_events_.cond_[0], &async_events_.value_[0], uint64_t(-1),
-        HSA_WAIT_STATE_BLOCKED, &value);
+    uint32_t index = async_events.signal_.Wait(uint64_t(-1), HSA_WAIT_STATE_BLOCKED, &value);
 
     // Reset the control signal
     if (index == 0) {
-      hsa_signal_handle(async_events_control_.wake)->StoreRelaxed(0);
+      hsa_signal_handle(control.wake)->StoreRelaxed(0);
     } else if (index != -1) {
       // No error or timout occured, process the handler
-      assert(async_events_.handler_[index] != NULL);
-      bool keep =
-          async_events_.handler_[index](value, async_events_.arg_[index]);
-      if (!keep) {
-        hsa_signal_handle(async_events_.signal_[index])->Release();
-        async_events_.CopyIndex(index, async_events_.Size() - 1);
-        async_events_.PopBack();
+      assert(async_events.handler_[index] != NULL);
+      if (runtime_singleton_->async_executor_.started()) {
+        // Stop watching the signal until a worker has run the handler and decided whether to
+        // keep it.
+        AsyncEventNode* event = new AsyncEventNode;
+        event->signal = async_events.signal_.Get(index);
+        event->cond = async_events.signal_.Condition(index);
+        event->value = async_events.signal_.Value(index);
+        event->handler = async_events.handler_[index];
+        event->arg = async_events.arg_[index];
+        event->user = async_events.user_[index];
+        async_events.Remove(index);
+        runtime_singleton_->ExecuteAsyncEvent(control, event, value);
+      } else {
+        bool keep = async_events.handler_[index](value, async_events.arg_[index]);
+        if (!keep) {
+          hsa_signal_handle(async_events.signal_.Get(index))->Release();
+          async_events.Remove(index);
+        }
+      }
+    } else {
+      // The wait only fails when a watched signal has been destroyed, so dead
+      // signals need not be searched for on every wakeup.
+      index = 0;
+      while (index != async_events.Size()) {
+        if (!hsa_signal_handle(async_events.signal_.Get(index))->IsValid()) {
+          hsa_signal_handle(async_events.signal_.Get(index))->Release();
+          async_events.Remove(index);
+          continue;
+        }
+        index++;
       }
     }
 
-    // Check for dead signals
-    index = 0;
-    while (index != async_events_.Size()) {
-      if (!hsa_signal_handle(async_events_.signal_[index])->IsValid()) {
-        hsa_signal_handle(async_events_.signal_[index])->Release();
-        async_events_.CopyIndex(index, async_events_.Size() - 1);
-        async_events_.PopBack();
+    // Take new registrations, restoring registration order.
+    AsyncEventNode* node = control.new_async_events_.exchange(NULL, std::memory_order_acquire);
+    AsyncEventNode* ordered = NULL;
+    while (node != NULL) {
+      AsyncEventNode* next = node->next;
+      node->next = ordered;
+      ordered = node;
+      node = next;
+    }
+
+    // Insert new signals and call plain functions
+    while (ordered != NULL) {
+      std::unique_ptr<AsyncEventNode> event(ordered);
+      ordered = ordered->next;
+      if (event->user && control.drop_user.load(std::memory_order_acquire)) {
+        if (event->signal.handle != 0) hsa_signal_handle(event->signal)->Release();
         continue;
       }
-      index++;
-    }
-
-    // Insert new signals and find plain functions
-    typedef std::pair<void (*)(void*), void*> func_arg_t;
-    std::vector<func_arg_t> functions;
-    {
-      ScopedAcquire<KernelMutex> scope_lock(&async_events_control_.lock);
-      for (size_t i = 0; i < new_async_events_.Size(); i++) {
-        if (new_async_events_.signal_[i].handle == 0) {
-          functions.push_back(
-              func_arg_t((void (*)(void*))new_async_events_.handler_[i],
-                         new_async_events_.arg_[i]));
+      if (event->signal.handle == 0) {
+        if (runtime_singleton_->async_executor_.started()) {
+          runtime_singleton_->ExecuteAsyncEvent(control, event.release(), 0);
+        } else {
+          ((void (*)(void*))event->handler)(event->arg);
+        }
+        continue;
+      }
+      async_events.PushBack(event->signal, event->cond, event->value, event->handler,
+                            event->arg, event->user);
+    }
+
+    // Sweep application handlers for a warm shutdown, see DropUserAsyncEvents.
+    const uint32_t drop = control.drop_request;
+    if (drop != control.drop_done) {
+      index = 1;
+      while (index < async_events.Size()) {
+        if (!async_events.user_[index]) {
+          index++;
           continue;
         }
-        async_events_.PushBack(
-            new_async_events_.signal_[i], new_async_events_.cond_[i],
-            new_async_events_.value_[i], new_async_events_.handler_[i],
-            new_async_events_.arg_[i]);
+        hsa_signal_handle(async_events.signal_.Get(index))->Release();
+        async_events.Remove(index);
       }
-      new_async_events_.Clear();
+      control.drop_done = drop;
+      os::WakeAllOnAddress(&control.drop_done);
     }
 
-    // Call plain functions
-    for (size_t i = 0; i < functions.size(); i++)
-      functions[i].first(functions[i].second);
-    functions.clear();
+    // Entry 0 is the control signal.
+    control.watched.store(uint32_t(async_events.Size() - 1), std::memory_order_relaxed);
   }
 
   // Release wait count of all pending signals
-  for (size_t i = 1; i < async_events_.Size(); i++)
-    hsa_signal_handle(async_events_.signal_[i])->Release();
-  async_events_.Clear();
+  for (size_t i = 1; i < async_events.Size(); i++)
+    hsa_signal_handle(async_events.signal_.Get(i))->Release();
+  async_events.Clear();
+
+  AsyncEventNode* node = control.new_async_events_.exchange(NULL, std::memory_order_acquire);
+  while (node != NULL) {
+    std::unique_ptr<AsyncEventNode> event(node);
+    node = node->next;
+    if (event->signal.handle != 0) hsa_signal_handle(event->signal)->Release();
+  }
+}
 
-  for (size_t i = 0; i < new_async_events_.Size(); i++)
-    hsa_signal_handle(new_async_events_.signal_[i])->Release();
-  new_async_events_.Clear();
+void Runtime::DropUserAsyncEvents() {
+  for (auto& control : async_events_control_) {
+    if (!control->started.load(std::memory_order_acquire)) continue;
+    control->drop_user.store(true, std::memory_order_release);
+    const uint32_t request = control->drop_request + 1;
+    control->drop_request = request;
+    hsa_signal_handle(control->wake)->StoreRelease(1);
+    uint32_t done;
+    while ((done = control->drop_done) != request) os::WaitOnAddress(&control->drop_done, done, 10);
+  }
+}
+
+void Runtime::CancelUserWork() {
+  // Handlers running on the user lane may keep themselves, the second sweep drops those.
+  DropUserAsyncEvents();
+  async_executor_.DrainUserLane();
+  DropUserAsyncEvents();
+  cpu_copy_pool_.CancelUserTasks();
 }
 
 void Runtime::BindVmFaultHandler() {
@@ -1189,44 +2231,36 @@ bool Runtime::VMFaultHandler(hsa_signal_value_t val, void* arg) {
           (fault.Failure.Imprecise == 1) ? "(may not be exact address)" : "", reason.c_str());
 
 #ifndef NDEBUG
-      runtime_singleton_->memory_lock_.Acquire();
-      auto it = runtime_singleton_->allocation_map_.upper_bound(
-          reinterpret_cast<void*>(fault.VirtualAddress));
-      for (int i = 0; i < 2; i++) {
-        if (it != runtime_singleton_->allocation_map_.begin()) it--;
-      }
+      std::vector<std::pair<const void*, size_t>> nearby;
       fprintf(stderr, "Nearby memory map:\n");
-      auto start = it;
-      for (int i = 0; i < 3; i++) {
-        if (it == runtime_singleton_->allocation_map_.end()) break;
-        std::string kind = "Non-HSA";
-        if (it->second.region != nullptr) {
-          const amd::MemoryRegion* region =
-              static_cast<const amd::MemoryRegion*>(it->second.region);
-          if (region->IsSystem())
-            kind = "System";
-          else if (region->IsLocalMemory())
-            kind = "VRAM";
-          else if (region->IsScratch())
-            kind = "Scratch";
-          else if (region->IsLDS())
-            kind = "LDS";
-        }
-        fprintf(stderr, "%p, 0x%lx, %s\n", it->first, it->second.size, kind.c_str());
-        it++;
-      }
+      runtime_singleton_->allocation_map_.ForEachNear(
+          reinterpret_cast<void*>(fault.VirtualAddress), 2, 1,
+          [&](const void* base, size_t size, const AllocationRegion& alloc) {
+            std::string kind = "Non-HSA";
+            if (alloc.region != nullptr) {
+              const amd::MemoryRegion* region =
+                  static_cast<const amd::MemoryRegion*>(alloc.region);
+              if (region->IsSystem())
+                kind = "System";
+              else if (region->IsLocalMemory())
+                kind = "VRAM";
+              else if (region->IsScratch())
+                kind = "Scratch";
+              else if (region->IsLDS())
+                kind = "LDS";
+            }
+            fprintf(stderr, "%p, 0x%lx, %s\n", base, size, kind.c_str());
+            nearby.push_back(std::make_pair(base, size));
+          });
       fprintf(stderr, "\n");
-      it = start;
-      runtime_singleton_->memory_lock_.Release();
       hsa_amd_pointer_info_t info;
       PtrInfoBlockData block;
       uint32_t count;
       hsa_agent_t* canAccess;
       info.size = sizeof(info);
-      for (int i = 0; i < 3; i++) {
-        if (it == runtime_singleton_->allocation_map_.end()) break;
-        runtime_singleton_->PtrInfo(const_cast<void*>(it->first), &info, malloc, &count, &canAccess,
-                                    &block);
+      for (auto& range : nearby) {
+        runtime_singleton_->PtrInfo(const_cast<void*>(range.first), &info, malloc, &count,
+                                    &canAccess, &block);
         fprintf(stderr,
                 "PtrInfo:\n\tAddress: %p-%p/%p-%p\n\tSize: 0x%lx\n\tType: %u\n\tOwner: %p\n",
                 info.agentBaseAddress, (char*)info.agentBaseAddress + info.sizeInBytes,
@@ -1237,7 +2271,6 @@ bool Runtime::VMFaultHandler(hsa_signal_value_t val, void* arg) {
           fprintf(stderr, "\t\t%p\n", reinterpret_cast<void*>(canAccess[t].handle));
         fprintf(stderr, "\tIn block: %p, 0x%lx\n", block.base, block.length);
         free(canAccess);
-        it++;
       }
 #endif  //! NDEBUG
     }
@@ -1250,20 +2283,56 @@ bool Runtime::VMFaultHandler(hsa_signal_value_t val, void* arg) {
 
 Runtime::Runtime()
     : region_gpu_(nullptr),
+      async_events_next_(0),
+      deferred_free_scheduled_(false),
+      deferred_free_closed_(false),
       sys_clock_freq_(0),
+      sys_clock_seq_(0),
+      sys_clock_time_(0.0),
+      sys_clock_tick_(0),
+      sys_clock_ratio_(0.0),
+      sys_clock_time0_(0.0),
+      sys_clock_tick0_(0),
       vm_fault_event_(nullptr),
       vm_fault_signal_(nullptr),
-      ref_count_(0) {}
+      ref_count_(0),
+      platform_loaded_(false),
+      tools_own_agents_(false) {}
 
 hsa_status_t Runtime::Load() {
   flag_.Refresh();
 
-  g_use_interrupt_wait = flag_.enable_interrupt();
+  if (flag_.lock_stats()) LockStats::Enable();
+
+  // Settings the agents were built with stay in force across warm restarts.
+  const bool warm = platform_loaded_;
+  if (!warm) {
+    g_use_interrupt_wait = flag_.enable_interrupt();
+    thread_policies_.Parse(flag_.thread_policy());
+
+    const uint32_t async_event_threads = Max(1U, flag_.async_event_threads());
+    for (uint32_t i = 0; i < async_event_threads; i++)
+      async_events_control_.emplace_back(new AsyncEventsControl());
+
+    if (flag_.async_handler_workers() != 0 &&
+        !async_executor_.Start(flag_.async_handler_workers())) {
+      return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+    }
 
-  if (!amd::Load()) {
-    return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+    if (!amd::Load()) {
+      return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+    }
+    platform_loaded_ = true;
+    BindVmFaultHandler();
   }
-  BindVmFaultHandler();
+
+  {
+    ScopedAcquire<KernelMutex> lock(&deferred_free_lock_);
+    deferred_free_closed_ = false;
+  }
+
+  for (auto& control : async_events_control_)
+    control->drop_user.store(false, std::memory_order_release);
 
   loader_ = amd::hsa::loader::Loader::Create(&loader_context_);
 
@@ -1271,15 +2340,23 @@ hsa_status_t Runtime::Load() {
   LoadExtensions();
 
   // Initialize per GPU scratch, blits, and trap handler
-  for (core::Agent* agent : gpu_agents_) {
-    hsa_status_t status =
-        reinterpret_cast<amd::GpuAgentInt*>(agent)->PostToolsInit();
+  if (!warm) {
+    for (core::Agent* agent : gpu_agents_) {
+      hsa_status_t status =
+          reinterpret_cast<amd::GpuAgentInt*>(agent)->PostToolsInit();
 
-    if (status != HSA_STATUS_SUCCESS) {
-      return status;
+      if (status != HSA_STATUS_SUCCESS) {
+        return status;
+      }
     }
   }
 
+  tracer_.Open(flag_.trace_file());
+  stats_export_.Open(flag_.stats_shm(), flag_.stats_shm_interval());
+
+  // Count API calls before tools wrap the table.
+  ApiStats::Enable(hsa_api_table_, flag_.api_stats_period());
+
   // Load tools libraries
   LoadTools();
 
@@ -1287,16 +2364,64 @@ hsa_status_t Runtime::Load() {
 }
 
 void Runtime::Unload() {
+  // Agents from tool libraries must go before the libraries are closed.
+  const bool warm = flag_.warm_restart() && !tools_own_agents_;
+
+  // The application's callbacks and tasks must not outlive the session.
+  if (warm) CancelUserWork();
+
+  stats_export_.Close();
+  tracer_.Close();
+  if (flag_.api_stats_period() != 0) ApiStats::Report(stderr);
+  if (flag_.lock_stats()) LockStats::Report(stderr);
   UnloadTools();
   UnloadExtensions();
 
   amd::hsa::loader::Loader::Destroy(loader_);
   loader_ = nullptr;
 
+  for (auto& buffers : staging_buffers_) {
+    for (void* buffer : buffers.second) buffers.first->Free(buffer, kStagingBufferSize);
+  }
+  staging_buffers_.clear();
+
+  pin_cache_.Flush();
+  ipc_cache_.Flush();
+  interop_cache_.Flush();
+
+  // Release queued frees while their regions still exist.  Frees still waiting
+  // on a signal are dropped.
+  {
+    ScopedAcquire<KernelMutex> lock(&deferred_free_lock_);
+    deferred_free_closed_ = true;
+  }
+  {
+    ScopedAcquire<KernelMutex> release_lock(&deferred_release_lock_);
+    for (auto& alloc : deferred_frees_) ReleaseAllocation(*alloc);
+    deferred_frees_.clear();
+  }
+
+  if (warm) {
+    // Handles of the session become invalid, the agents and what they own stay loaded.
+    FreeUserAllocations();
+    zero_pool_.Trim(nullptr);
+    CloseTools();
+    return;
+  }
+
+  // Scrubbed buffers go back to their regions while the agents still exist.
+  zero_pool_.Trim(nullptr);
+
   std::for_each(gpu_agents_.begin(), gpu_agents_.end(), DeleteObject());
   gpu_agents_.clear();
 
-  async_events_control_.Shutdown();
+  // Workers may queue kept handlers back to the monitoring threads, so they stop first.
+  async_executor_.Shutdown();
+  for (auto& control : async_events_control_) control->Shutdown();
+  async_events_control_.clear();
+
+  cpu_copy_pool_.Shutdown();
+  host_queue_processor_.Shutdown();
 
   if (vm_fault_signal_ != nullptr) {
     vm_fault_signal_->DestroySignal();
@@ -1314,6 +2439,8 @@ void Runtime::Unload() {
   CloseTools();
 
   amd::Unload();
+  platform_loaded_ = false;
+  tools_own_agents_ = false;
 }
 
 void Runtime::LoadExtensions() {
@@ -1343,6 +2470,10 @@ void Runtime::LoadExtensions() {
 
 void Runtime::UnloadExtensions() { extensions_.Unload(); }
 
+static double ToolLoadMs(timer::fast_clock::time_point start, timer::fast_clock::time_point end) {
+  return timer::duration_cast<std::chrono::duration<double, std::milli>>(end - start).count();
+}
+
 static std::vector<std::string> parse_tool_names(std::string tool_names) {
   std::vector<std::string> names;
   std::string name = "";
@@ -1405,7 +2536,9 @@ void Runtime::LoadTools() {
     std::vector<std::string> names = parse_tool_names(tool_names);
     std::vector<const char*> failed;
     for (auto& name : names) {
+      const auto load_start = timer::fast_clock::now();
       os::LibHandle tool = os::LoadLib(name);
+      const auto load_end = timer::fast_clock::now();
 
       if (tool != NULL) {
         tool_libs_.push_back(tool);
@@ -1421,6 +2554,19 @@ void Runtime::LoadTools() {
             continue;
           }
         }
+        const auto init_end = timer::fast_clock::now();
+
+        if (flag().report_tool_load_time())
+          fprintf(stderr, "Tool lib \"%s\" loaded in %.3f ms, OnLoad took %.3f ms.\n",
+                  name.c_str(), ToolLoadMs(load_start, load_end), ToolLoadMs(load_end, init_end));
+
+        // Tools deferring their heavy initialization run it before the first queue is created.
+        tool_init_t deferred = (tool_init_t)os::GetExportAddress(tool, "OnLoadDeferred");
+        if (deferred) {
+          ScopedAcquire<KernelMutex> lock(&deferred_tools_lock_);
+          deferred_tools_.push_back(DeferredTool{deferred, name});
+          deferred_tools_pending_.store(true, std::memory_order_release);
+        }
 
         tool_wrap_t wrap;
         wrap = (tool_wrap_t)os::GetExportAddress(tool, "WrapAgent");
@@ -1435,6 +2581,7 @@ void Runtime::LoadTools() {
                 assert(agent->IsValid() &&
                        "Agent returned from WrapAgent is not valid");
                 agent_list->at(agent_idx) = agent;
+                tools_own_agents_ = true;
               }
             }
           }
@@ -1442,7 +2589,14 @@ void Runtime::LoadTools() {
 
         tool_add_t add;
         add = (tool_add_t)os::GetExportAddress(tool, "AddAgent");
-        if (add) add(this);
+        if (add) {
+          add(this);
+          tools_own_agents_ = true;
+        }
+
+        Tracer::Consumer trace;
+        trace = (Tracer::Consumer)os::GetExportAddress(tool, "OnTrace");
+        if (trace) tracer_.AddConsumer(trace);
       }
       else {
         if (flag().report_tool_load_failures())
@@ -1452,7 +2606,62 @@ void Runtime::LoadTools() {
   }
 }
 
+bool Runtime::LoadDeferredTools() {
+  // Calls made by the deferred initializations themselves find the runtime as their OnLoad left
+  // it.
+  static thread_local bool initializing = false;
+  if (initializing || !deferred_tools_pending_.load(std::memory_order_acquire)) return false;
+
+  std::vector<DeferredTool> tools;
+  {
+    ScopedAcquire<KernelMutex> lock(&deferred_tools_lock_);
+    if (!deferred_tools_pending_.load(std::memory_order_relaxed)) return false;
+    if (deferred_tools_.empty()) {
+      // Another thread is running them, wait for the table they leave.
+      lock.Release();
+      while (atomic::Load(&deferred_tools_running_, std::memory_order_acquire) != 0)
+        os::WaitOnAddress(&deferred_tools_running_, 1, 10);
+      return true;
+    }
+    tools.swap(deferred_tools_);
+    atomic::Store(&deferred_tools_running_, 1U, std::memory_order_relaxed);
+  }
+
+  // Failed tools stay open, their OnLoad may have installed hooks.
+  initializing = true;
+  std::vector<const char*> failed;
+  for (auto& tool : tools) {
+    const auto start = timer::fast_clock::now();
+    const bool loaded = tool.init(&hsa_api_table_.hsa_api, hsa_api_table_.hsa_api.version.major_id,
+                                  failed.size(), failed.data());
+    const auto end = timer::fast_clock::now();
+    if (!loaded) {
+      failed.push_back(tool.name.c_str());
+      if (flag().report_tool_load_failures())
+        fprintf(stderr, "Tool lib \"%s\" failed deferred initialization.\n", tool.name.c_str());
+    } else if (flag().report_tool_load_time()) {
+      fprintf(stderr, "Tool lib \"%s\" OnLoadDeferred took %.3f ms.\n", tool.name.c_str(),
+              ToolLoadMs(start, end));
+    }
+  }
+  initializing = false;
+
+  {
+    ScopedAcquire<KernelMutex> lock(&deferred_tools_lock_);
+    deferred_tools_pending_.store(false, std::memory_order_release);
+    atomic::Store(&deferred_tools_running_, 0U, std::memory_order_release);
+  }
+  os::WakeAllOnAddress(&deferred_tools_running_);
+  return true;
+}
+
 void Runtime::UnloadTools() {
+  {
+    ScopedAcquire<KernelMutex> lock(&deferred_tools_lock_);
+    deferred_tools_.clear();
+    deferred_tools_pending_.store(false, std::memory_order_relaxed);
+  }
+
   typedef void (*tool_unload_t)();
   for (size_t i = tool_libs_.size(); i != 0; i--) {
     tool_unload_t unld;
@@ -1474,51 +2683,44 @@ void Runtime::CloseTools() {
 }
 
 void Runtime::AsyncEventsControl::Shutdown() {
-  if (async_events_thread_ != NULL) {
+  if (started) {
     exit = true;
     hsa_signal_handle(wake)->StoreRelaxed(1);
     os::WaitForThread(async_events_thread_);
     os::CloseThread(async_events_thread_);
     async_events_thread_ = NULL;
     HSA::hsa_signal_destroy(wake);
+    started = false;
   }
 }
 
 void Runtime::AsyncEvents::PushBack(hsa_signal_t signal,
                                     hsa_signal_condition_t cond,
                                     hsa_signal_value_t value,
-                                    hsa_amd_signal_handler handler, void* arg) {
-  signal_.push_back(signal);
-  cond_.push_back(cond);
-  value_.push_back(value);
+                                    hsa_amd_signal_handler handler, void* arg, bool user) {
+  signal_.Add(signal, cond, value);
   handler_.push_back(handler);
   arg_.push_back(arg);
+  user_.push_back(user);
 }
 
-void Runtime::AsyncEvents::CopyIndex(size_t dst, size_t src) {
-  signal_[dst] = signal_[src];
-  cond_[dst] = cond_[src];
-  value_[dst] = value_[src];
-  handler_[dst] = handler_[src];
-  arg_[dst] = arg_[src];
-}
-
-size_t Runtime::AsyncEvents::Size() { return signal_.size(); }
-
-void Runtime::AsyncEvents::PopBack() {
-  signal_.pop_back();
-  cond_.pop_back();
-  value_.pop_back();
+void Runtime::AsyncEvents::Remove(size_t index) {
+  signal_.Remove(index);
+  handler_[index] = handler_.back();
+  arg_[index] = arg_.back();
+  user_[index] = user_.back();
   handler_.pop_back();
   arg_.pop_back();
+  user_.pop_back();
 }
 
+size_t Runtime::AsyncEvents::Size() { return signal_.Size(); }
+
 void Runtime::AsyncEvents::Clear() {
-  signal_.clear();
-  cond_.clear();
-  value_.clear();
+  signal_.Clear();
   handler_.clear();
   arg_.clear();
+  user_.clear();
 }
 
 hsa_status_t Runtime::SetCustomSystemEventHandler(hsa_amd_system_event_callback_t callback,
@@ -51,26 +51,53 @@
 
 namespace core {
 
-KernelMutex Signal::ipcLock_;
-std::map<decltype(hsa_signal_t::handle), Signal*> Signal::ipcMap_;
+Signal::IpcShard Signal::ipcShards_[Signal::kIpcShards];
+
+// Signal objects are binned in kObjectGranule steps.  Larger objects use the heap.
+static const size_t kObjectGranule = 64;
+static const size_t kObjectClasses = 16;
+
+// Never destroyed, signals may be released during static destruction.
+static FreeListCache<void*>* ObjectCache(size_t size_class) {
+  static FreeListCache<void*>* caches = new FreeListCache<void*>[kObjectClasses];
+  return &caches[size_class];
+}
 
 void SharedSignalPool_t::clear() {
+  std::vector<SharedSignal*> cached;
+  free_list_.Drain(cached);
+
+  ScopedAcquire<KernelMutex> lock(&lock_);
   ifdebug {
     size_t capacity = 0;
     for (auto& block : block_list_) capacity += block.second;
-    if (capacity != free_list_.size())
+    if (capacity != cached.size())
       debug_print("Warning: Resource leak detected by SharedSignalPool, %ld Signals leaked.\n",
-                  capacity - free_list_.size());
+                  capacity - cached.size());
   }
 
   for (auto& block : block_list_) free_(block.first);
   block_list_.clear();
-  free_list_.clear();
+  block_size_ = minblock_;
+}
+
+size_t SharedSignalPool_t::capacity() {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  size_t capacity = 0;
+  for (auto& block : block_list_) capacity += block.second;
+  return capacity;
 }
 
 SharedSignal* SharedSignalPool_t::alloc() {
+  SharedSignal* ret;
+  if (free_list_.Get(ret)) {
+    new (ret) SharedSignal();
+    return ret;
+  }
+
   ScopedAcquire<KernelMutex> lock(&lock_);
-  if (free_list_.empty()) {
+  // Another thread may have grown the pool meanwhile.
+  if (!free_list_.Get(ret)) {
     SharedSignal* block = reinterpret_cast<SharedSignal*>(
         allocate_(block_size_ * sizeof(SharedSignal), __alignof(SharedSignal), 0));
     if (block == nullptr) {
@@ -84,17 +111,17 @@ SharedSignal* SharedSignalPool_t::alloc() {
     block_list_.push_back(std::make_pair(block, block_size_));
     throwGuard.Dismiss();
 
-
-    for (int i = 0; i < block_size_; i++) {
-      free_list_.push_back(&block[i]);
-    }
+    // Keep the first slot, the rest go to the shared depot.
+    std::vector<SharedSignal*> slots;
+    slots.reserve(block_size_ - 1);
+    for (size_t i = 1; i < block_size_; i++) slots.push_back(&block[i]);
+    free_list_.Add(slots);
+    ret = block;
 
     block_size_ *= 2;
   }
 
-  SharedSignal* ret = free_list_.back();
   new (ret) SharedSignal();
-  free_list_.pop_back();
   return ret;
 }
 
@@ -102,9 +129,9 @@ void SharedSignalPool_t::free(SharedSignal* ptr) {
   if (ptr == nullptr) return;
 
   ptr->~SharedSignal();
-  ScopedAcquire<KernelMutex> lock(&lock_);
 
   ifdebug {
+    ScopedAcquire<KernelMutex> lock(&lock_);
     bool valid = false;
     for (auto& block : block_list_) {
       if ((block.first <= ptr) &&
@@ -116,7 +143,7 @@ void SharedSignalPool_t::free(SharedSignal* ptr) {
     assert(valid && "Object does not belong to pool.");
   }
 
-  free_list_.push_back(ptr);
+  free_list_.Put(ptr);
 }
 
 LocalSignal::LocalSignal(hsa_signal_value_t initial_value, bool exportable)
@@ -126,35 +153,57 @@ LocalSignal::LocalSignal(hsa_signal_value_t initial_value, bool exportable)
   local_signal_.shared_object()->amd_signal.value = initial_value;
 }
 
+void* Signal::operator new(size_t size) {
+  const size_t size_class = (size - 1) / kObjectGranule;
+  if (size_class >= kObjectClasses) return ::operator new(size);
+  void* ret;
+  if (ObjectCache(size_class)->Get(ret)) return ret;
+  return ::operator new((size_class + 1) * kObjectGranule);
+}
+
+void Signal::operator delete(void* ptr, size_t size) {
+  if (ptr == nullptr) return;
+  const size_t size_class = (size - 1) / kObjectGranule;
+  if (size_class >= kObjectClasses) {
+    ::operator delete(ptr);
+    return;
+  }
+  ObjectCache(size_class)->Put(ptr);
+}
+
 void Signal::registerIpc() {
-  ScopedAcquire<KernelMutex> lock(&ipcLock_);
   auto handle = Convert(this);
-  assert(ipcMap_.find(handle.handle) == ipcMap_.end() &&
+  IpcShard& shard = ipcShard(handle.handle);
+  ScopedAcquire<KernelMutex> lock(&shard.lock);
+  assert(shard.map.find(handle.handle) == shard.map.end() &&
          "Can't register the same IPC signal twice.");
-  ipcMap_[handle.handle] = this;
+  shard.map[handle.handle] = this;
 }
 
 bool Signal::deregisterIpc() {
-  ScopedAcquire<KernelMutex> lock(&ipcLock_);
-  if (refcount_ != 0) return false;
   auto handle = Convert(this);
-  const auto& it = ipcMap_.find(handle.handle);
-  assert(it != ipcMap_.end() && "Deregister on non-IPC signal.");
-  ipcMap_.erase(it);
+  IpcShard& shard = ipcShard(handle.handle);
+  ScopedAcquire<KernelMutex> lock(&shard.lock);
+  if (refcount_ != 0) return false;
+  const auto& it = shard.map.find(handle.handle);
+  assert(it != shard.map.end() && "Deregister on non-IPC signal.");
+  shard.map.erase(it);
   return true;
 }
 
 Signal* Signal::lookupIpc(hsa_signal_t signal) {
-  ScopedAcquire<KernelMutex> lock(&ipcLock_);
-  const auto& it = ipcMap_.find(signal.handle);
-  if (it == ipcMap_.end()) return nullptr;
+  IpcShard& shard = ipcShard(signal.handle);
+  ScopedAcquire<KernelMutex> lock(&shard.lock);
+  const auto& it = shard.map.find(signal.handle);
+  if (it == shard.map.end()) return nullptr;
   return it->second;
 }
 
 Signal* Signal::duplicateIpc(hsa_signal_t signal) {
-  ScopedAcquire<KernelMutex> lock(&ipcLock_);
-  const auto& it = ipcMap_.find(signal.handle);
-  if (it == ipcMap_.end()) return nullptr;
+  IpcShard& shard = ipcShard(signal.handle);
+  ScopedAcquire<KernelMutex> lock(&shard.lock);
+  const auto& it = shard.map.find(signal.handle);
+  if (it == shard.map.end()) return nullptr;
   it->second->refcount_++;
   it->second->Retain();
   return it->second;
@@ -180,71 +229,164 @@ uint32_t Signal::WaitAny(uint32_t signal_count, const hsa_signal_t* hsa_signals,
                          const hsa_signal_condition_t* conds, const hsa_signal_value_t* values,
                          uint64_t timeout, hsa_wait_state_t wait_hint,
                          hsa_signal_value_t* satisfying_value) {
-  hsa_signal_handle* signals =
-      reinterpret_cast<hsa_signal_handle*>(const_cast<hsa_signal_t*>(hsa_signals));
+  SignalWaitSet wait_set;
+  for (uint32_t i = 0; i < signal_count; i++) wait_set.Add(hsa_signals[i], conds[i], values[i]);
+  return wait_set.Wait(timeout, wait_hint, satisfying_value);
+}
 
-  for (uint32_t i = 0; i < signal_count; i++) signals[i]->Retain();
+const uint64_t WaitPolicy::kMaxSpinNs;
+const uint64_t WaitPolicy::kMinSpinNs;
 
-  MAKE_SCOPE_GUARD([&]() {
-    for (uint32_t i = 0; i < signal_count; i++) signals[i]->Release();
-  });
+static __forceinline uint64_t ToNs(timer::fast_clock::duration time) {
+  return uint64_t(std::chrono::duration<double, std::nano>(time).count());
+}
 
-  uint32_t prior = 0;
-  for (uint32_t i = 0; i < signal_count; i++) prior = Max(prior, signals[i]->waiting_++);
+// The first waits spin for kMaxSpin, as before the spin was sized.
+WaitPolicy::WaitPolicy()
+    : expected_ns_(kMaxSpinNs / 2), waits_(0), spin_ns_(0), sleeps_(0), sleep_ns_(0) {}
 
-  MAKE_SCOPE_GUARD([&]() {
-    for (uint32_t i = 0; i < signal_count; i++) signals[i]->waiting_--;
-  });
+timer::fast_clock::duration WaitPolicy::Spin() const {
+  const uint64_t expected = Expected();
+  const uint64_t spin = (expected > kMaxSpinNs) ? kMinSpinNs
+                                                : Max(kMinSpinNs, Min(kMaxSpinNs, expected * 2));
+  return std::chrono::duration<double, std::nano>(double(spin));
+}
 
-  // Allow only the first waiter to sleep (temporary, known to be bad).
-  if (prior != 0) wait_hint = HSA_WAIT_STATE_ACTIVE;
+void WaitPolicy::Record(bool satisfied, timer::fast_clock::duration elapsed, uint32_t sleeps,
+                        timer::fast_clock::duration sleep_time) {
+  const uint64_t elapsed_ns = ToNs(elapsed);
+  const uint64_t sleep_ns = Min(ToNs(sleep_time), elapsed_ns);
 
-  // Ensure that all signals in the list can be slept on.
-  if (wait_hint != HSA_WAIT_STATE_ACTIVE) {
-    for (uint32_t i = 0; i < signal_count; i++) {
-      if (signals[i]->EopEvent() == NULL) {
-        wait_hint = HSA_WAIT_STATE_ACTIVE;
-        break;
-      }
+  waits_.fetch_add(1, std::memory_order_relaxed);
+  spin_ns_.fetch_add(elapsed_ns - sleep_ns, std::memory_order_relaxed);
+  sleeps_.fetch_add(sleeps, std::memory_order_relaxed);
+  sleep_ns_.fetch_add(sleep_ns, std::memory_order_relaxed);
+
+  if (!satisfied) return;
+
+  // Average with a weight of 1/8 for the new wait.  Waits far beyond the
+  // spin range are clamped so that one long wait can not stop all spinning
+  // for long.
+  const int64_t sample = int64_t(Min(elapsed_ns, kMaxSpinNs * 4));
+  const int64_t expected = int64_t(Expected());
+  expected_ns_.store(uint64_t(expected + (sample - expected) / 8), std::memory_order_relaxed);
+}
+
+void WaitPolicy::GetStats(hsa_amd_signal_wait_stats_t* stats) const {
+  stats->wait_count = waits_.load(std::memory_order_relaxed);
+  stats->spin_time_ns = spin_ns_.load(std::memory_order_relaxed);
+  stats->sleep_count = sleeps_.load(std::memory_order_relaxed);
+  stats->sleep_time_ns = sleep_ns_.load(std::memory_order_relaxed);
+  stats->expected_wait_ns = Expected();
+}
+
+const uint32_t SignalWaitSet::kFollowerSliceMs;
+
+SignalWaitSet::SignalWaitSet() : sleepable_(false), events_dirty_(true), next_(0) {}
+
+void SignalWaitSet::Add(hsa_signal_t signal, hsa_signal_condition_t cond,
+                        hsa_signal_value_t value) {
+  hsa_signal_handle(signal)->Retain();
+  signals_.push_back(signal);
+  conds_.push_back(cond);
+  values_.push_back(value);
+  events_dirty_ = true;
+}
+
+void SignalWaitSet::Remove(size_t index) {
+  hsa_signal_handle(signals_[index])->Release();
+  signals_[index] = signals_.back();
+  conds_[index] = conds_.back();
+  values_[index] = values_.back();
+  signals_.pop_back();
+  conds_.pop_back();
+  values_.pop_back();
+  events_dirty_ = true;
+}
+
+void SignalWaitSet::Clear() {
+  for (hsa_signal_t signal : signals_) hsa_signal_handle(signal)->Release();
+  signals_.clear();
+  conds_.clear();
+  values_.clear();
+  events_.clear();
+  events_dirty_ = true;
+  next_ = 0;
+}
+
+void SignalWaitSet::UpdateEvents() {
+  // Sleeping requires every signal to carry an event.
+  events_.clear();
+  sleepable_ = true;
+  for (hsa_signal_t signal : signals_) {
+    HsaEvent* event = hsa_signal_handle(signal)->EopEvent();
+    if (event == NULL) {
+      sleepable_ = false;
+      events_.clear();
+      break;
     }
+    events_.push_back(event);
   }
+  std::sort(events_.begin(), events_.end());
+  events_.erase(std::unique(events_.begin(), events_.end()), events_.end());
+  events_dirty_ = false;
+}
+
+uint32_t SignalWaitSet::Wait(uint64_t timeout, hsa_wait_state_t wait_hint,
+                             hsa_signal_value_t* satisfying_value) {
+  const uint32_t signal_count = uint32_t(signals_.size());
+  if (signal_count == 0) return uint32_t(-1);
+
+  hsa_signal_handle* signals = reinterpret_cast<hsa_signal_handle*>(&signals_[0]);
+  const hsa_signal_condition_t* conds = &conds_[0];
+  const hsa_signal_value_t* values = &values_[0];
+
+  for (uint32_t i = 0; i < signal_count; i++) signals[i]->waiting_++;
 
-  const uint32_t small_size = 10;
-  HsaEvent* short_evts[small_size];
-  HsaEvent** evts = NULL;
-  uint32_t unique_evts = 0;
-  if (wait_hint != HSA_WAIT_STATE_ACTIVE) {
-    if (signal_count > small_size)
-      evts = new HsaEvent* [signal_count];
-    else
-      evts = short_evts;
-    for (uint32_t i = 0; i < signal_count; i++)
-      evts[i] = signals[i]->EopEvent();
-    std::sort(evts, evts + signal_count);
-    HsaEvent** end = std::unique(evts, evts + signal_count);
-    unique_evts = uint32_t(end - evts);
-  }
   MAKE_SCOPE_GUARD([&]() {
-    if (signal_count > small_size) delete[] evts;
+    for (uint32_t i = 0; i < signal_count; i++) signals[i]->waiting_--;
   });
 
+  // Ensure that all signals in the list can be slept on.  The event list is
+  // only rebuilt after the set changed.
+  if (wait_hint != HSA_WAIT_STATE_ACTIVE) {
+    if (events_dirty_) UpdateEvents();
+    if (!sleepable_) wait_hint = HSA_WAIT_STATE_ACTIVE;
+  }
+
   int64_t value;
 
   timer::fast_clock::time_point start_time = timer::fast_clock::now();
 
-  // Set a polling timeout value
-  const timer::fast_clock::duration kMaxElapsed = std::chrono::microseconds(200);
-
   // Convert timeout value into the fast_clock domain
-  uint64_t hsa_freq;
-  HSA::hsa_system_get_info(HSA_SYSTEM_INFO_TIMESTAMP_FREQUENCY, &hsa_freq);
+  const uint64_t hsa_freq = Runtime::runtime_singleton_->sys_clock_freq();
   const timer::fast_clock::duration fast_timeout =
       timer::duration_from_seconds<timer::fast_clock::duration>(
           double(timeout) / double(hsa_freq));
 
+  // Scans start after the last satisfied signal so a busy signal can not hide
+  // the others.
+  if (next_ >= signal_count) next_ = 0;
+
+  // Poll as long as the signal expected to complete first asks for.
+  timer::fast_clock::duration spin = fast_timeout;
+  if (wait_hint != HSA_WAIT_STATE_ACTIVE) {
+    uint32_t first = 0;
+    for (uint32_t i = 1; i < signal_count; i++) {
+      if (signals[i]->wait_policy_.Expected() < signals[first]->wait_policy_.Expected()) first = i;
+    }
+    spin = signals[first]->wait_policy_.Spin();
+  }
+
+  uint32_t sleeps = 0;
+  timer::fast_clock::duration sleep_time(0);
+  SpinBackoff backoff;
   bool condition_met = false;
   while (true) {
-    for (uint32_t i = 0; i < signal_count; i++) {
+    for (uint32_t n = 0; n < signal_count; n++) {
+      uint32_t i = next_ + n;
+      if (i >= signal_count) i -= signal_count;
+
       if (!signals[i]->IsValid()) return uint32_t(-1);
 
       // Handling special event.
@@ -285,6 +427,9 @@ uint32_t Signal::WaitAny(uint32_t signal_count, const hsa_signal_t* hsa_signals,
       }
       if (condition_met) {
         if (satisfying_value != NULL) *satisfying_value = value;
+        next_ = i + 1;
+        signals[i]->wait_policy_.Record(true, timer::fast_clock::now() - start_time, sleeps,
+                                        sleep_time);
         return i;
       }
     }
@@ -294,12 +439,8 @@ uint32_t Signal::WaitAny(uint32_t signal_count, const hsa_signal_t* hsa_signals,
       return uint32_t(-1);
     }
 
-    if (wait_hint == HSA_WAIT_STATE_ACTIVE) {
-      continue;
-    }
-
-    if (time - start_time < kMaxElapsed) {
-    //  os::uSleep(20);
+    if (time - start_time < spin) {
+      backoff.Pause();
       continue;
     }
 
@@ -308,7 +449,23 @@ uint32_t Signal::WaitAny(uint32_t signal_count, const hsa_signal_t* hsa_signals,
     uint64_t ct=timer::duration_cast<std::chrono::milliseconds>(
       time_remaining).count();
     wait_ms = (ct>0xFFFFFFFEu) ? 0xFFFFFFFEu : ct;
-    hsaKmtWaitOnMultipleEvents(evts, unique_evts, false, wait_ms);
+
+    // Sleep on the events only if no other waiter sleeps on any of them.
+    // Otherwise sleep behind the first such waiter.  That covers only one
+    // signal, so the sleep is cut into short slices.
+    uint32_t claimed = 0;
+    while ((claimed < signal_count) && signals[claimed]->AcquireEventSleep()) claimed++;
+    if (claimed == signal_count)
+      hsaKmtWaitOnMultipleEvents(&events_[0], uint32_t(events_.size()), false, wait_ms);
+    for (uint32_t i = 0; i < claimed; i++) signals[i]->ReleaseEventSleep();
+    if (claimed != signal_count) {
+      Signal* sleeper = Signal::Convert(signals_[claimed]);
+      os::WaitOnAddress(&sleeper->wake_seq_,
+                        atomic::Load(&sleeper->wake_seq_, std::memory_order_acquire),
+                        Min(wait_ms, kFollowerSliceMs));
+    }
+    sleep_time += timer::fast_clock::now() - time;
+    sleeps++;
   }
 }
 
@@ -323,6 +480,79 @@ SignalGroup::SignalGroup(uint32_t num_signals, const hsa_signal_t* hsa_signals)
   for (uint32_t i = 0; i < count; i++) signals[i] = hsa_signals[i];
 }
 
+bool SignalGroup::Wait(uint32_t required, hsa_signal_condition_t condition,
+                       hsa_signal_value_t compare_value, uint64_t timeout,
+                       hsa_wait_state_t wait_hint, uint32_t& satisfied) const {
+  required = Min(required, count);
+
+  // Signals not yet seen satisfied, in group order.
+  std::vector<hsa_signal_t> pending(signals, signals + count);
+  satisfied = 0;
+  bool valid = true;
+  auto scan = [&]() {
+    size_t kept = 0;
+    for (hsa_signal_t signal : pending) {
+      Signal* sig = Signal::Convert(signal);
+      if (!sig->IsValid()) {
+        valid = false;
+        return;
+      }
+      const hsa_signal_value_t value = atomic::Load(&sig->signal_.value,
+                                                    std::memory_order_relaxed);
+      bool met = false;
+      switch (condition) {
+        case HSA_SIGNAL_CONDITION_EQ:
+          met = (value == compare_value);
+          break;
+        case HSA_SIGNAL_CONDITION_NE:
+          met = (value != compare_value);
+          break;
+        case HSA_SIGNAL_CONDITION_GTE:
+          met = (value >= compare_value);
+          break;
+        case HSA_SIGNAL_CONDITION_LT:
+          met = (value < compare_value);
+          break;
+        default:
+          assert(false && "Invalid signal condition.");
+          break;
+      }
+      if (met)
+        satisfied++;
+      else
+        pending[kept++] = signal;
+    }
+    pending.resize(kept);
+  };
+
+  const uint64_t hsa_freq = Runtime::runtime_singleton_->sys_clock_freq();
+  const timer::fast_clock::time_point start_time = timer::fast_clock::now();
+
+  scan();
+  while (valid && satisfied < required) {
+    // Remaining timeout in the system timestamp domain.
+    uint64_t remaining = timeout;
+    if (timeout != uint64_t(-1)) {
+      const double elapsed =
+          std::chrono::duration<double>(timer::fast_clock::now() - start_time).count();
+      const uint64_t elapsed_ticks = uint64_t(elapsed * double(hsa_freq));
+      if (elapsed_ticks >= timeout) break;
+      remaining = timeout - elapsed_ticks;
+    }
+
+    SignalWaitSet wait_set;
+    if (pending.size() == required - satisfied) {
+      wait_set.Add(pending.back(), condition, compare_value);
+    } else {
+      for (hsa_signal_t signal : pending) wait_set.Add(signal, condition, compare_value);
+    }
+    wait_set.Wait(remaining, wait_hint, NULL);
+    scan();
+  }
+  // Enough signals were seen before one was destroyed.
+  return valid || satisfied >= required;
+}
+
 }  // namespace core
 
 #endif  // header guard
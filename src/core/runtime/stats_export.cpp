@@ -0,0 +1,117 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "core/inc/stats_export.h"
+
+#include <atomic>
+#include <cstring>
+
+#include "core/inc/runtime.h"
+
+namespace core {
+
+void StatsExport::Open(const std::string& name, uint32_t interval_ms) {
+  if (name.empty() || (segment_ != NULL)) return;
+
+  segment_ = os::CreateSharedSegment(name, sizeof(hsa_amd_stats_page_t));
+  if (segment_ == NULL) {
+    fprintf(stderr, "HSA_STATS_SHM \"%s\" could not be created.\n", name.c_str());
+    return;
+  }
+  page_ = reinterpret_cast<hsa_amd_stats_page_t*>(os::SharedSegmentAddress(segment_));
+
+  memset(&sample_, 0, sizeof(sample_));
+  sample_.magic = HSA_AMD_STATS_PAGE_MAGIC;
+  sample_.version = HSA_AMD_STATS_PAGE_VERSION;
+  sample_.size = uint32_t(sizeof(hsa_amd_stats_page_t));
+  sample_.pid = uint64_t(os::GetProcessId());
+  interval_ms_ = Max(1U, interval_ms);
+
+  Publish();
+
+  exit_ = 0;
+  thread_ = os::CreateThread(PublishLoop, this);
+  if (thread_ == NULL) {
+    fprintf(stderr, "HSA_STATS_SHM \"%s\" can not be refreshed.\n", name.c_str());
+    Close();
+  }
+}
+
+void StatsExport::Close() {
+  if (segment_ == NULL) return;
+
+  if (thread_ != NULL) {
+    atomic::Store(&exit_, 1U, std::memory_order_release);
+    os::WakeAllOnAddress(&exit_);
+    os::WaitForThread(thread_);
+    os::CloseThread(thread_);
+    thread_ = NULL;
+  }
+
+  os::DestroySharedSegment(segment_);
+  segment_ = NULL;
+  page_ = NULL;
+}
+
+void StatsExport::PublishLoop(void* arg) {
+  StatsExport* exporter = reinterpret_cast<StatsExport*>(arg);
+  while (atomic::Load(&exporter->exit_, std::memory_order_acquire) == 0) {
+    os::WaitOnAddress(&exporter->exit_, 0, exporter->interval_ms_);
+    if (atomic::Load(&exporter->exit_, std::memory_order_acquire) != 0) break;
+    exporter->Publish();
+  }
+}
+
+void StatsExport::Publish() {
+  Runtime::runtime_singleton_->CollectStats(sample_);
+
+  // Readers retry while the sequence is odd or moved during their copy.
+  const uint64_t sequence = page_->sequence;
+  sample_.sequence = sequence + 1;
+  atomic::Store(&page_->sequence, sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(page_, &sample_, sizeof(sample_));
+  std::atomic_thread_fence(std::memory_order_release);
+  atomic::Store(&page_->sequence, sequence + 2, std::memory_order_relaxed);
+}
+
+}  // namespace core
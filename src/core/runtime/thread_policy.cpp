@@ -0,0 +1,185 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "core/inc/thread_policy.h"
+
+#include <cstdlib>
+
+#include "core/inc/amd_cpu_agent.h"
+#include "core/inc/runtime.h"
+#include "core/util/os.h"
+
+namespace core {
+
+// Splits @p str at each @p delim.
+static std::vector<std::string> Split(const std::string& str, char delim) {
+  std::vector<std::string> parts;
+  size_t start = 0;
+  while (true) {
+    const size_t end = str.find(delim, start);
+    parts.push_back(str.substr(start, end - start));
+    if (end == std::string::npos) return parts;
+    start = end + 1;
+  }
+}
+
+static bool ParseInt(const std::string& str, int32_t& value) {
+  if (str.empty()) return false;
+  char* end;
+  const long parsed = strtol(str.c_str(), &end, 10);
+  if (*end != '\0') return false;
+  value = int32_t(parsed);
+  return true;
+}
+
+// Parses "first-last" ranges and single CPUs separated by '+'.
+static bool ParseCpus(const std::string& str, std::vector<uint32_t>& cpus) {
+  for (const std::string& range : Split(str, '+')) {
+    const size_t dash = range.find('-');
+    int32_t first, last;
+    if (!ParseInt(range.substr(0, dash), first)) return false;
+    last = first;
+    if ((dash != std::string::npos) && !ParseInt(range.substr(dash + 1), last)) return false;
+    if ((first < 0) || (last < first) || (uint32_t(last) >= os::MaxAffinityCpus())) return false;
+    for (int32_t cpu = first; cpu <= last; cpu++) cpus.push_back(uint32_t(cpu));
+  }
+  return true;
+}
+
+static bool ParseEntry(const std::string& entry, ThreadPolicies::Class& cls,
+                       ThreadPolicies::Policy& policy) {
+  static const char* kClasses[] = {"events", "handlers", "host_queue", "copy", "scheduler"};
+  static const char* kScheds[] = {"default", "normal", "batch", "idle", "fifo", "rr"};
+
+  const size_t colon = entry.find(':');
+  if (colon == std::string::npos) return false;
+  const std::string name = entry.substr(0, colon);
+  uint32_t index = 0;
+  while ((index < ThreadPolicies::kNumClasses) && (name != kClasses[index])) index++;
+  if (index == ThreadPolicies::kNumClasses) return false;
+  cls = ThreadPolicies::Class(index);
+
+  for (const std::string& setting : Split(entry.substr(colon + 1), ',')) {
+    const size_t equal = setting.find('=');
+    if (equal == std::string::npos) return false;
+    const std::string key = setting.substr(0, equal);
+    const std::string value = setting.substr(equal + 1);
+    if (key == "cpus") {
+      if (!ParseCpus(value, policy.cpus)) return false;
+    } else if (key == "numa") {
+      if (!ParseInt(value, policy.numa_node)) return false;
+    } else if (key == "prio") {
+      if (!ParseInt(value, policy.priority)) return false;
+    } else if (key == "sched") {
+      uint32_t sched = 0;
+      while ((sched < sizeof(kScheds) / sizeof(kScheds[0])) && (value != kScheds[sched])) sched++;
+      if (sched == sizeof(kScheds) / sizeof(kScheds[0])) return false;
+      policy.sched = hsa_amd_thread_sched_t(sched);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ThreadPolicies::Parse(const std::string& spec) {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  for (Policy& policy : policies_) policy = Policy();
+  if (!spec.empty()) {
+    for (const std::string& entry : Split(spec, ';')) {
+      Class cls;
+      Policy policy;
+      if (ParseEntry(entry, cls, policy)) policies_[cls] = policy;
+    }
+  }
+  generation_.fetch_add(1, std::memory_order_release);
+}
+
+void ThreadPolicies::Set(Class cls, const Policy& policy) {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  policies_[cls] = policy;
+  generation_.fetch_add(1, std::memory_order_release);
+}
+
+void ThreadPolicies::Update(Class cls, ThreadState& state) {
+  Policy policy;
+  {
+    ScopedAcquire<KernelMutex> lock(&lock_);
+    policy = policies_[cls];
+    state.generation = generation_.load(std::memory_order_relaxed);
+  }
+
+  if (!state.saved) {
+    state.saved = true;
+    state.cpus_saved = os::GetThreadAffinityList(state.cpus);
+    state.sched_saved = os::GetThreadScheduling(state.sched, state.priority);
+  }
+
+  if (policy.cpus.empty() && (policy.numa_node >= 0)) {
+    for (const Agent* agent : Runtime::runtime_singleton_->cpu_agents()) {
+      if (agent->node_id() != uint32_t(policy.numa_node)) continue;
+      const amd::CpuAgent* cpu = static_cast<const amd::CpuAgent*>(agent);
+      for (uint32_t i = 0; i < cpu->num_cpus(); i++) policy.cpus.push_back(cpu->first_cpu_id() + i);
+    }
+  }
+
+  // Failures, such as real time classes without the privilege, leave the thread as it is.
+  // Fields a previous policy set and this one leaves unset go back to what the thread had.
+  if (!policy.cpus.empty()) {
+    os::SetThreadAffinityList(policy.cpus.data(), uint32_t(policy.cpus.size()));
+    state.cpus_set = true;
+  } else if (state.cpus_set) {
+    if (state.cpus_saved) os::SetThreadAffinityList(state.cpus.data(), uint32_t(state.cpus.size()));
+    state.cpus_set = false;
+  }
+
+  if (policy.sched != HSA_AMD_THREAD_SCHED_DEFAULT) {
+    os::SetThreadScheduling(os::ThreadSched(policy.sched - HSA_AMD_THREAD_SCHED_NORMAL),
+                            policy.priority);
+    state.sched_set = true;
+  } else if (state.sched_set) {
+    if (state.sched_saved) os::SetThreadScheduling(state.sched, state.priority);
+    state.sched_set = false;
+  }
+}
+
+}  // namespace core
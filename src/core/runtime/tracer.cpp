@@ -0,0 +1,150 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "core/inc/tracer.h"
+
+namespace core {
+
+std::atomic<uint64_t> Tracer::next_id_(1);
+
+void Tracer::Open(const std::string& path) {
+  if (path.empty()) return;
+
+  ScopedAcquire<KernelMutex> lock(&drain_lock_);
+  if (file_ != NULL) return;
+
+  file_ = fopen(path.c_str(), "wb");
+  if (file_ == NULL) {
+    fprintf(stderr, "HSA_TRACE_FILE \"%s\" could not be opened.\n", path.c_str());
+    return;
+  }
+
+  struct {
+    char magic[8];
+    uint32_t record_size;
+    uint32_t reserved;
+    uint64_t tick_frequency;
+  } header = {{'H', 'S', 'A', 'T', 'R', 'A', 'C', 'E'},
+              uint32_t(sizeof(hsa_amd_trace_record_t)),
+              0,
+              os::AccurateClockFrequency()};
+  fwrite(&header, sizeof(header), 1, file_);
+  enabled_.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::AddConsumer(Consumer consumer) {
+  ScopedAcquire<KernelMutex> lock(&drain_lock_);
+  consumers_.push_back(consumer);
+  enabled_.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::Close() {
+  ScopedAcquire<KernelMutex> lock(&drain_lock_);
+  if (!enabled_.load(std::memory_order_relaxed)) return;
+  enabled_.store(false, std::memory_order_relaxed);
+
+  Drain();
+
+  const uint64_t dropped = dropped_.exchange(0);
+  if (dropped != 0) debug_print("Tracing dropped %lu records.\n", (unsigned long)dropped);
+
+  if (file_ != NULL) {
+    fclose(file_);
+    file_ = NULL;
+  }
+  consumers_.clear();
+}
+
+Tracer::Ring* Tracer::LocalRing() {
+  static thread_local uint64_t owner = 0;
+  static thread_local Ring* ring = NULL;
+  if (owner == id_) return ring;
+
+  Ring* local = new Ring();
+  ScopedAcquire<KernelMutex> lock(&rings_lock_);
+  rings_.push_back(std::unique_ptr<Ring>(local));
+  owner = id_;
+  ring = local;
+  return ring;
+}
+
+void Tracer::Record(const hsa_amd_trace_record_t& record) {
+  if (!enabled()) return;
+
+  Ring* ring = LocalRing();
+  const uint64_t head = ring->head.load(std::memory_order_relaxed);
+  const uint64_t tail = ring->tail.load(std::memory_order_acquire);
+  if (head - tail == kRingSize) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  ring->records[head % kRingSize] = record;
+  ring->head.store(head + 1, std::memory_order_release);
+
+  // Drain from a producer thread rather than a dedicated one, but never wait for another drain.
+  if ((head + 1 - tail >= kRingSize / 2) && drain_lock_.Try()) {
+    Drain();
+    drain_lock_.Release();
+  }
+}
+
+void Tracer::Drain() {
+  batch_.clear();
+  {
+    ScopedAcquire<KernelMutex> lock(&rings_lock_);
+    for (auto& ring : rings_) {
+      const uint64_t head = ring->head.load(std::memory_order_acquire);
+      uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+      for (; tail != head; tail++) batch_.push_back(ring->records[tail % kRingSize]);
+      ring->tail.store(tail, std::memory_order_release);
+    }
+  }
+  if (batch_.empty()) return;
+
+  if (file_ != NULL) fwrite(&batch_[0], sizeof(hsa_amd_trace_record_t), batch_.size(), file_);
+
+  const uint64_t tick_frequency = os::AccurateClockFrequency();
+  for (Consumer consumer : consumers_) consumer(&batch_[0], batch_.size(), tick_frequency);
+}
+
+}  // namespace core
@@ -0,0 +1,138 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "core/inc/zero_pool.h"
+
+#include <atomic>
+
+#include "core/inc/agent.h"
+#include "core/inc/default_signal.h"
+#include "core/inc/memory_region.h"
+#include "core/inc/runtime.h"
+
+namespace core {
+
+// A pooled buffer may be this much larger than the request.
+static size_t MaxSlack(size_t size) { return size / 4; }
+
+void* ZeroPool::Take(const MemoryRegion* region, size_t& size) {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  auto pool = buffers_.find(region);
+  if (pool == buffers_.end()) return nullptr;
+
+  // Scrubs land roughly in order, only look at the first few candidates.
+  const int kMaxProbes = 4;
+  BufferMap& buffers = pool->second;
+  int probes = 0;
+  for (BufferMap::iterator it = buffers.lower_bound(size);
+       (it != buffers.end()) && (it->first <= size + MaxSlack(size)) && (probes < kMaxProbes);
+       ++it, ++probes) {
+    Buffer& buffer = it->second;
+    if (buffer.scrubbed->LoadRelaxed() != 0) continue;
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    void* ptr = buffer.ptr;
+    size = buffer.size;
+    buffer.scrubbed->DestroySignal();
+    held_bytes_ -= size;
+    buffers.erase(it);
+    return ptr;
+  }
+  return nullptr;
+}
+
+bool ZeroPool::Put(const MemoryRegion* region, void* ptr, size_t size) {
+  const size_t limit = Runtime::runtime_singleton_->flag().zero_pool_size();
+  {
+    ScopedAcquire<KernelMutex> lock(&lock_);
+    if (held_bytes_ + size > limit) return false;
+    held_bytes_ += size;
+  }
+
+  Buffer buffer = {region, ptr, size, new DefaultSignal(1)};
+  std::vector<FillRange> ranges(1, FillRange{ptr, size});
+  std::vector<Signal*> no_deps;
+  hsa_status_t err = region->owner()->DmaFill(ranges, 0, no_deps, *buffer.scrubbed);
+
+  if (err != HSA_STATUS_SUCCESS) {
+    buffer.scrubbed->DestroySignal();
+    ScopedAcquire<KernelMutex> lock(&lock_);
+    held_bytes_ -= size;
+    return false;
+  }
+
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  buffers_[region].insert(std::make_pair(size, buffer));
+  return true;
+}
+
+size_t ZeroPool::Trim(const MemoryRegion* region) {
+  std::vector<Buffer> released;
+  {
+    ScopedAcquire<KernelMutex> lock(&lock_);
+    for (auto pool = buffers_.begin(); pool != buffers_.end();) {
+      if ((region != nullptr) && (pool->first != region)) {
+        ++pool;
+        continue;
+      }
+      for (auto& entry : pool->second) released.push_back(entry.second);
+      pool = buffers_.erase(pool);
+    }
+    for (const Buffer& buffer : released) held_bytes_ -= buffer.size;
+  }
+
+  size_t bytes = 0;
+  for (const Buffer& buffer : released) bytes += buffer.size;
+  Release(released);
+  return bytes;
+}
+
+void ZeroPool::Release(const std::vector<Buffer>& buffers) {
+  for (const Buffer& buffer : buffers) {
+    buffer.scrubbed->WaitRelaxed(HSA_SIGNAL_CONDITION_EQ, 0, uint64_t(-1),
+                                 HSA_WAIT_STATE_BLOCKED);
+    buffer.scrubbed->DestroySignal();
+    buffer.region->Free(buffer.ptr, buffer.size);
+  }
+}
+
+}  // namespace core
@@ -79,14 +79,106 @@ class Flag {
     var = os::GetEnvVar("HSA_SDMA_WAIT_IDLE");
     sdma_wait_idle_ = (var == "1") ? true : false;
 
+    var = os::GetEnvVar("HSA_SDMA_QUEUE_SIZE");
+    sdma_queue_size_ = (var.empty()) ? 1024 * 1024 : size_t(atoi(var.c_str())) * 1024;
+
+    var = os::GetEnvVar("HSA_SDMA_STRIPES");
+    sdma_stripes_ = static_cast<uint32_t>(atoi(var.c_str()));
+
+    // Spread single host<->device copies over this many SDMA rings per direction.
+    var = os::GetEnvVar("HSA_SDMA_RINGS");
+    sdma_rings_ = static_cast<uint32_t>(atoi(var.c_str()));
+
+    // Measure host<->device bandwidth with the blits on first link cost query.
+    var = os::GetEnvVar("HSA_LINK_CALIBRATION");
+    link_calibration_ = (var == "1") ? true : false;
+
+    // Run device to {host,device} compute blits on their own queues instead of the utility queue.
+    var = os::GetEnvVar("HSA_DEDICATED_BLIT_QUEUES");
+    dedicated_blit_queues_ = (var == "1") ? true : false;
+
+    // Number of device to device blit queues used round robin with dedicated blit queues.
+    var = os::GetEnvVar("HSA_D2D_BLIT_QUEUES");
+    d2d_blit_queues_ = (var.empty()) ? 1 : static_cast<uint32_t>(atoi(var.c_str()));
+
+    // Hex CU mask, lowest CU in the least significant bit, of queues used only for blits.
+    blit_cu_mask_ = os::GetEnvVar("HSA_BLIT_CU_MASK");
+
+    // Choose SDMA or compute blits per host<->device copy instead of per direction.
+    var = os::GetEnvVar("HSA_BLIT_COST_MODEL");
+    blit_cost_model_ = (var == "1") ? true : false;
+
+    var = os::GetEnvVar("HSA_CPU_COPY_THREADS");
+    cpu_copy_threads_ = (var.empty()) ? 2 : static_cast<uint32_t>(atoi(var.c_str()));
+
+    var = os::GetEnvVar("HSA_ASYNC_EVENT_THREADS");
+    async_event_threads_ = (var.empty()) ? 1 : static_cast<uint32_t>(atoi(var.c_str()));
+
+    // Workers running application async handlers and functions, 0 runs them on the event
+    // threads.
+    var = os::GetEnvVar("HSA_ASYNC_HANDLER_WORKERS");
+    async_handler_workers_ = (var.empty()) ? 0 : static_cast<uint32_t>(atoi(var.c_str()));
+
     var = os::GetEnvVar("HSA_MAX_QUEUES");
     max_queues_ = static_cast<uint32_t>(atoi(var.c_str()));
 
+    // Number of hardware queues per agent shared by user queues, 0 (default) disables pooling.
+    var = os::GetEnvVar("HSA_QUEUE_POOL_SIZE");
+    queue_pool_size_ = static_cast<uint32_t>(atoi(var.c_str()));
+
+    // "load" places new queues on the least loaded hardware queue, otherwise round robin.
+    queue_pool_policy_ = os::GetEnvVar("HSA_QUEUE_POOL_POLICY");
+
+    // Ring buffers of destroyed queues kept per agent for reuse.
+    var = os::GetEnvVar("HSA_RING_BUFFER_CACHE");
+    ring_buffer_cache_ = (var.empty()) ? 4 : static_cast<uint32_t>(atoi(var.c_str()));
+
+    var = os::GetEnvVar("HSA_DEFER_QUEUE_SCRATCH");
+    defer_queue_scratch_ = (var == "1") ? true : false;
+
+    // Worker threads executing CPU agent queues, 0 disables CPU queue creation.
+    var = os::GetEnvVar("HSA_HOST_QUEUE_THREADS");
+    host_queue_threads_ = static_cast<uint32_t>(atoi(var.c_str()));
+
+    // Backlog sampling period of classified queues, in microseconds.
+    var = os::GetEnvVar("HSA_QUEUE_SCHED_INTERVAL");
+    queue_sched_interval_ = (var.empty()) ? 1000 : static_cast<uint32_t>(atoi(var.c_str()));
+
     var = os::GetEnvVar("HSA_SCRATCH_MEM");
     scratch_mem_size_ = atoi(var.c_str());
 
     tools_lib_names_ = os::GetEnvVar("HSA_TOOLS_LIB");
 
+    // Count API calls and time one in every HSA_API_STATS calls, 0 (default) disables.
+    var = os::GetEnvVar("HSA_API_STATS");
+    api_stats_period_ = static_cast<uint32_t>(atoi(var.c_str()));
+
+    // Count lock acquisitions, waits and hold times, reported at shutdown.
+    var = os::GetEnvVar("HSA_LOCK_STATS");
+    lock_stats_ = (var == "1") ? true : false;
+
+    // Keep agents, regions, internal queues and blits across hsa_shut_down and the next hsa_init.
+    var = os::GetEnvVar("HSA_WARM_RESTART");
+    warm_restart_ = (var == "1") ? true : false;
+
+    // Directory of the persistent hsa_ext_program_finalize cache, unset disables it.
+    finalizer_cache_dir_ = os::GetEnvVar("HSA_FINALIZER_CACHE_DIR");
+
+    // Size limit of the finalizer cache directory in MB.
+    var = os::GetEnvVar("HSA_FINALIZER_CACHE_SIZE");
+    finalizer_cache_size_ = size_t((var.empty()) ? 512 : atoi(var.c_str())) * 1024 * 1024;
+
+    // Memory pool block cache retention: whole free 2MB fragment blocks are released once the
+    // cache exceeds ratio times the bytes of blocks in use, or the MB limit if set.
+    var = os::GetEnvVar("HSA_FRAGMENT_CACHE_RATIO");
+    fragment_cache_ratio_ = (var.empty()) ? 2 : atoi(var.c_str());
+
+    var = os::GetEnvVar("HSA_FRAGMENT_CACHE_MAX");
+    fragment_cache_max_ = (var.empty()) ? SIZE_MAX : size_t(atoi(var.c_str())) * 1024 * 1024;
+
+    // Binary trace of dispatches, copies and fills, see hsa_amd_trace_record_t.
+    trace_file_ = os::GetEnvVar("HSA_TRACE_FILE");
+
     var = os::GetEnvVar("HSA_TOOLS_REPORT_LOAD_FAILURE");
 
     ifdebug {
@@ -95,9 +187,42 @@ class Flag {
       report_tool_load_failures_ = (var == "0") ? false : true;
     }
 
+    var = os::GetEnvVar("HSA_TOOLS_REPORT_LOAD_TIME");
+    report_tool_load_time_ = (var == "1") ? true : false;
+
     var = os::GetEnvVar("HSA_DISABLE_FRAGMENT_ALLOCATOR");
     disable_fragment_alloc_ = (var == "1") ? true : false;
 
+    var = os::GetEnvVar("HSA_LAZY_SYSTEM_MAPPING");
+    lazy_system_mapping_ = (var == "1") ? true : false;
+
+    var = os::GetEnvVar("HSA_MEMORY_POOL_TRACE");
+    memory_pool_trace_ = (var == "1") ? true : false;
+
+    var = os::GetEnvVar("HSA_SYSTEM_HUGE_PAGES");
+    system_huge_pages_ = (var == "1") ? true : false;
+
+    // Size limit in MB, 0 disables the cache.
+    var = os::GetEnvVar("HSA_LARGE_BLOCK_CACHE");
+    large_block_cache_size_ = size_t((var.empty()) ? 256 : atoi(var.c_str())) * 1024 * 1024;
+
+    // Size limit of idle locked ranges in MB, 0 (default) disables the cache.
+    var = os::GetEnvVar("HSA_PIN_CACHE_SIZE");
+    pin_cache_size_ = size_t(atoi(var.c_str())) * 1024 * 1024;
+
+    // Size limit of scrubbed VRAM kept for zero initialized allocations in MB, 0 zeroes every
+    // allocation on the allocation path.
+    var = os::GetEnvVar("HSA_ZERO_POOL_SIZE");
+    zero_pool_size_ = size_t((var.empty()) ? 256 : atoi(var.c_str())) * 1024 * 1024;
+
+    // Number of detached IPC imports kept mapped, 0 (default) unmaps on last detach.
+    var = os::GetEnvVar("HSA_IPC_CACHE_SIZE");
+    ipc_cache_size_ = size_t(atoi(var.c_str()));
+
+    // Number of unmapped interop buffers kept registered, 0 (default) unregisters on last unmap.
+    var = os::GetEnvVar("HSA_INTEROP_CACHE_SIZE");
+    interop_cache_size_ = size_t(atoi(var.c_str()));
+
     var = os::GetEnvVar("HSA_ENABLE_SDMA_HDP_FLUSH");
     enable_sdma_hdp_flush_ = (var == "0") ? false : true;
 
@@ -106,6 +231,20 @@ class Flag {
 
     var = os::GetEnvVar("HSA_FORCE_FINE_GRAIN_PCIE");
     fine_grain_pcie_ = (var == "1") ? true : false;
+
+    // Kernarg pool in VRAM on large BAR GPUs, off by default.
+    var = os::GetEnvVar("HSA_VRAM_KERNARG");
+    vram_kernarg_ = (var == "1") ? true : false;
+
+    var = os::GetEnvVar("HSA_PARALLEL_DISCOVERY");
+    parallel_discovery_ = (var == "0") ? false : true;
+
+    thread_policy_ = os::GetEnvVar("HSA_THREAD_POLICY");
+
+    stats_shm_ = os::GetEnvVar("HSA_STATS_SHM");
+
+    var = os::GetEnvVar("HSA_STATS_SHM_INTERVAL");
+    stats_shm_interval_ = (var.empty()) ? 100 : static_cast<uint32_t>(atoi(var.c_str()));
   }
 
   bool check_flat_scratch() const { return check_flat_scratch_; }
@@ -124,22 +263,100 @@ class Flag {
 
   bool report_tool_load_failures() const { return report_tool_load_failures_; }
 
+  bool report_tool_load_time() const { return report_tool_load_time_; }
+
   bool disable_fragment_alloc() const { return disable_fragment_alloc_; }
 
+  size_t large_block_cache_size() const { return large_block_cache_size_; }
+
+  bool system_huge_pages() const { return system_huge_pages_; }
+
+  bool memory_pool_trace() const { return memory_pool_trace_; }
+
+  bool lazy_system_mapping() const { return lazy_system_mapping_; }
+
+  size_t pin_cache_size() const { return pin_cache_size_; }
+
+  size_t zero_pool_size() const { return zero_pool_size_; }
+
+  size_t ipc_cache_size() const { return ipc_cache_size_; }
+
+  size_t interop_cache_size() const { return interop_cache_size_; }
+
   bool rev_copy_dir() const { return rev_copy_dir_; }
 
   bool fine_grain_pcie() const { return fine_grain_pcie_; }
 
+  bool vram_kernarg() const { return vram_kernarg_; }
+
+  bool parallel_discovery() const { return parallel_discovery_; }
+
+  std::string thread_policy() const { return thread_policy_; }
+
+  std::string stats_shm() const { return stats_shm_; }
+
+  uint32_t stats_shm_interval() const { return stats_shm_interval_; }
+
   std::string enable_sdma() const { return enable_sdma_; }
 
   std::string visible_gpus() const { return visible_gpus_; }
 
+  uint32_t sdma_stripes() const { return sdma_stripes_; }
+
+  uint32_t sdma_rings() const { return sdma_rings_; }
+
+  bool link_calibration() const { return link_calibration_; }
+
+  bool blit_cost_model() const { return blit_cost_model_; }
+
+  bool dedicated_blit_queues() const { return dedicated_blit_queues_; }
+
+  uint32_t d2d_blit_queues() const { return d2d_blit_queues_; }
+
+  std::string blit_cu_mask() const { return blit_cu_mask_; }
+
+  size_t sdma_queue_size() const { return sdma_queue_size_; }
+
+  uint32_t cpu_copy_threads() const { return cpu_copy_threads_; }
+
+  uint32_t async_event_threads() const { return async_event_threads_; }
+
+  uint32_t async_handler_workers() const { return async_handler_workers_; }
+
   uint32_t max_queues() const { return max_queues_; }
 
+  uint32_t queue_pool_size() const { return queue_pool_size_; }
+
+  uint32_t ring_buffer_cache() const { return ring_buffer_cache_; }
+
+  bool defer_queue_scratch() const { return defer_queue_scratch_; }
+
+  uint32_t host_queue_threads() const { return host_queue_threads_; }
+
+  uint32_t queue_sched_interval() const { return queue_sched_interval_; }
+
+  std::string queue_pool_policy() const { return queue_pool_policy_; }
+
   size_t scratch_mem_size() const { return scratch_mem_size_; }
 
   std::string tools_lib_names() const { return tools_lib_names_; }
 
+  std::string trace_file() const { return trace_file_; }
+
+  uint32_t api_stats_period() const { return api_stats_period_; }
+
+  bool lock_stats() const { return lock_stats_; }
+
+  bool warm_restart() const { return warm_restart_; }
+
+  std::string finalizer_cache_dir() const { return finalizer_cache_dir_; }
+
+  size_t finalizer_cache_size() const { return finalizer_cache_size_; }
+
+  size_t fragment_cache_ratio() const { return fragment_cache_ratio_; }
+
+  size_t fragment_cache_max() const { return fragment_cache_max_; }
+
  private:
   bool check_flat_scratch_;
   bool enable_vm_fault_message_;
@@ -149,20 +366,74 @@ class Flag {
   bool sdma_wait_idle_;
   bool enable_queue_fault_message_;
   bool report_tool_load_failures_;
+  bool report_tool_load_time_;
   bool disable_fragment_alloc_;
+  size_t large_block_cache_size_;
+  bool system_huge_pages_;
+  bool memory_pool_trace_;
+  bool lazy_system_mapping_;
+  size_t pin_cache_size_;
+  size_t zero_pool_size_;
+  size_t ipc_cache_size_;
+  size_t interop_cache_size_;
   bool rev_copy_dir_;
   bool fine_grain_pcie_;
+  bool vram_kernarg_;
+  bool parallel_discovery_;
+  std::string thread_policy_;
+  std::string stats_shm_;
+  uint32_t stats_shm_interval_;
 
   std::string enable_sdma_;
 
   std::string visible_gpus_;
 
+  uint32_t sdma_stripes_;
+  uint32_t sdma_rings_;
+  bool link_calibration_;
+
+  bool blit_cost_model_;
+
+  bool dedicated_blit_queues_;
+
+  uint32_t d2d_blit_queues_;
+
+  std::string blit_cu_mask_;
+
+  size_t sdma_queue_size_;
+
+  uint32_t cpu_copy_threads_;
+
+  uint32_t async_event_threads_;
+
+  uint32_t async_handler_workers_;
+
   uint32_t max_queues_;
+  uint32_t queue_pool_size_;
+  std::string queue_pool_policy_;
+  uint32_t ring_buffer_cache_;
+  bool defer_queue_scratch_;
+  uint32_t host_queue_threads_;
+  uint32_t queue_sched_interval_;
 
   size_t scratch_mem_size_;
 
   std::string tools_lib_names_;
 
+  std::string trace_file_;
+
+  uint32_t api_stats_period_;
+
+  bool lock_stats_;
+
+  bool warm_restart_;
+
+  std::string finalizer_cache_dir_;
+  size_t finalizer_cache_size_;
+
+  size_t fragment_cache_ratio_;
+  size_t fragment_cache_max_;
+
   DISALLOW_COPY_AND_ASSIGN(Flag);
 };
 
@@ -0,0 +1,141 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Thread sharded cache of free objects for high churn allocators.
+
+#ifndef HSA_RUNTIME_CORE_UTIL_FREE_LIST_CACHE_H_
+#define HSA_RUNTIME_CORE_UTIL_FREE_LIST_CACHE_H_
+
+#include <atomic>
+#include <vector>
+
+#include "core/util/utils.h"
+#include "core/util/locks.h"
+
+/*
+ * Free list of T split over kSlots slots with a shared depot.
+ *
+ * Threads are dealt round robin to slots, so a slot lock is rarely contended and
+ * Get/Put normally touch no shared state.  A slot holding more than 2 * kBatch
+ * items hands kBatch of them to the depot, and an empty slot takes up to kBatch
+ * back, so the depot lock is taken once per batch.  Items are never freed; the
+ * owner drains them with Drain.
+ */
+template <typename T> class FreeListCache {
+ public:
+  static const uint32_t kSlots = 16;
+  static const size_t kBatch = 32;
+
+  FreeListCache() {}
+
+  /// @brief Takes a free item, returns false if none is cached.
+  bool Get(T& item) {
+    Slot& slot = LocalSlot();
+    ScopedAcquire<KernelMutex> lock(&slot.lock);
+    if (slot.items.empty() && !Refill(slot)) return false;
+    item = slot.items.back();
+    slot.items.pop_back();
+    return true;
+  }
+
+  /// @brief Returns @p item to the cache.
+  void Put(T item) {
+    Slot& slot = LocalSlot();
+    ScopedAcquire<KernelMutex> lock(&slot.lock);
+    slot.items.push_back(item);
+    if (slot.items.size() > 2 * kBatch) {
+      ScopedAcquire<KernelMutex> depot_lock(&depot_lock_);
+      depot_.insert(depot_.end(), slot.items.end() - kBatch, slot.items.end());
+      slot.items.resize(slot.items.size() - kBatch);
+    }
+  }
+
+  /// @brief Adds newly created items directly to the depot.
+  void Add(const std::vector<T>& items) {
+    ScopedAcquire<KernelMutex> depot_lock(&depot_lock_);
+    depot_.insert(depot_.end(), items.begin(), items.end());
+  }
+
+  /// @brief Moves every cached item to @p out.
+  void Drain(std::vector<T>& out) {
+    for (uint32_t i = 0; i < kSlots; i++) {
+      ScopedAcquire<KernelMutex> lock(&slots_[i].lock);
+      out.insert(out.end(), slots_[i].items.begin(), slots_[i].items.end());
+      slots_[i].items.clear();
+    }
+    ScopedAcquire<KernelMutex> depot_lock(&depot_lock_);
+    out.insert(out.end(), depot_.begin(), depot_.end());
+    depot_.clear();
+  }
+
+ private:
+  struct Slot {
+    KernelMutex lock;
+    std::vector<T> items;
+  };
+
+  Slot& LocalSlot() {
+    static std::atomic<uint32_t> next_slot(0);
+    static thread_local uint32_t slot = uint32_t(-1);
+    if (slot == uint32_t(-1)) slot = next_slot++ % kSlots;
+    return slots_[slot];
+  }
+
+  /// Moves up to kBatch items from the depot to @p slot.  Must hold slot.lock.
+  bool Refill(Slot& slot) {
+    ScopedAcquire<KernelMutex> depot_lock(&depot_lock_);
+    if (depot_.empty()) return false;
+    const size_t count = Min(depot_.size(), size_t(kBatch));
+    slot.items.insert(slot.items.end(), depot_.end() - count, depot_.end());
+    depot_.resize(depot_.size() - count);
+    return true;
+  }
+
+  Slot slots_[kSlots];
+
+  KernelMutex depot_lock_;
+  std::vector<T> depot_;
+
+  DISALLOW_COPY_AND_ASSIGN(FreeListCache);
+};
+
+#endif  // HSA_RUNTIME_CORE_UTIL_FREE_LIST_CACHE_H_
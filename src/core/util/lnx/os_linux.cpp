@@ -45,20 +45,30 @@
 #include "core/util/utils.h"
 
 #include <link.h>
+#include <dirent.h>
 #include <dlfcn.h>
+#include <fcntl.h>
 #include <pthread.h>
 #include <limits.h>
 #include <sched.h>
+#include <linux/futex.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/sysinfo.h>
 #include <sys/time.h>
 #include <sys/utsname.h>
 #include <unistd.h>
 #include <errno.h>
+#include <cctype>
 #include <cstring>
 #include <atomic>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace os {
 
@@ -189,6 +199,23 @@ void* GetExportAddress(LibHandle lib, std::string export_name) {
 
 void CloseLib(LibHandle lib) { dlclose(*(void**)&lib); }
 
+bool GetLibIdentity(LibHandle lib, std::string& identity) {
+  link_map* map;
+  if (dlinfo(*(void**)&lib, RTLD_DI_LINKMAP, &map) != 0 || map->l_name == nullptr ||
+      map->l_name[0] == '\0')
+    return false;
+
+  struct stat info;
+  if (stat(map->l_name, &info) != 0) return false;
+
+  identity = map->l_name;
+  identity += ":" + std::to_string(uint64_t(info.st_dev)) + ":" +
+      std::to_string(uint64_t(info.st_ino)) + ":" + std::to_string(uint64_t(info.st_size)) +
+      ":" + std::to_string(uint64_t(info.st_mtim.tv_sec)) + "." +
+      std::to_string(uint64_t(info.st_mtim.tv_nsec));
+  return true;
+}
+
 Mutex CreateMutex() {
   pthread_mutex_t* mutex = new pthread_mutex_t;
   pthread_mutex_init(mutex, NULL);
@@ -212,12 +239,146 @@ void DestroyMutex(Mutex lock) {
   delete *(pthread_mutex_t**)&lock;
 }
 
+SharedMutex CreateSharedMutex() {
+  pthread_rwlock_t* lock = new pthread_rwlock_t;
+  pthread_rwlock_init(lock, NULL);
+  return *(SharedMutex*)&lock;
+}
+
+bool AcquireSharedMutex(SharedMutex lock, bool shared) {
+  if (shared) return pthread_rwlock_rdlock(*(pthread_rwlock_t**)&lock) == 0;
+  return pthread_rwlock_wrlock(*(pthread_rwlock_t**)&lock) == 0;
+}
+
+void ReleaseSharedMutex(SharedMutex lock, bool shared) {
+  pthread_rwlock_unlock(*(pthread_rwlock_t**)&lock);
+}
+
+void DestroySharedMutex(SharedMutex lock) {
+  pthread_rwlock_destroy(*(pthread_rwlock_t**)&lock);
+  delete *(pthread_rwlock_t**)&lock;
+}
+
 void Sleep(int delay_in_millisec) { usleep(delay_in_millisec * 1000); }
 
 void uSleep(int delayInUs) { usleep(delayInUs); }
 
 void YieldThread() { sched_yield(); }
 
+bool SetThreadAffinity(uint32_t first_cpu, uint32_t num_cpus) {
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  for (uint32_t i = first_cpu; (i < first_cpu + num_cpus) && (i < CPU_SETSIZE); i++)
+    CPU_SET(i, &cpus);
+  return sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+}
+
+bool SetThreadAffinityList(const uint32_t* cpus, uint32_t num_cpus) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (uint32_t i = 0; i < num_cpus; i++)
+    if (cpus[i] < CPU_SETSIZE) CPU_SET(cpus[i], &set);
+  if (CPU_COUNT(&set) == 0) return false;
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+bool GetThreadAffinityList(std::vector<uint32_t>& cpus) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) != 0) return false;
+  cpus.clear();
+  for (uint32_t i = 0; i < CPU_SETSIZE; i++)
+    if (CPU_ISSET(i, &set)) cpus.push_back(i);
+  return !cpus.empty();
+}
+
+uint32_t MaxAffinityCpus() { return CPU_SETSIZE; }
+
+bool GetThreadScheduling(ThreadSched& sched, int& priority) {
+  const int policy = sched_getscheduler(0);
+  switch (policy) {
+    case SCHED_OTHER:
+      sched = kSchedNormal;
+      break;
+    case SCHED_BATCH:
+      sched = kSchedBatch;
+      break;
+    case SCHED_IDLE:
+      sched = kSchedIdle;
+      break;
+    case SCHED_FIFO:
+      sched = kSchedFifo;
+      break;
+    case SCHED_RR:
+      sched = kSchedRoundRobin;
+      break;
+    default:
+      return false;
+  }
+
+  if ((sched == kSchedFifo) || (sched == kSchedRoundRobin)) {
+    sched_param param;
+    if (sched_getparam(0, &param) != 0) return false;
+    priority = param.sched_priority;
+    return true;
+  }
+
+  // -1 is a valid nice value, errno tells failures apart.
+  errno = 0;
+  priority = getpriority(PRIO_PROCESS, id_t(syscall(SYS_gettid)));
+  return errno == 0;
+}
+
+bool SetThreadScheduling(ThreadSched sched, int priority) {
+  static const int kPolicies[] = {SCHED_OTHER, SCHED_BATCH, SCHED_IDLE, SCHED_FIFO, SCHED_RR};
+  const bool real_time = (sched == kSchedFifo) || (sched == kSchedRoundRobin);
+
+  sched_param param;
+  memset(&param, 0, sizeof(param));
+  if (real_time) param.sched_priority = priority;
+  if (sched_setscheduler(0, kPolicies[sched], &param) != 0) return false;
+
+  // Nice values are per thread on Linux.
+  if ((sched == kSchedNormal) || (sched == kSchedBatch))
+    return setpriority(PRIO_PROCESS, pid_t(syscall(SYS_gettid)), priority) == 0;
+  return true;
+}
+
+void WaitOnAddress(volatile uint32_t* addr, uint32_t value, uint32_t timeout_ms) {
+  struct timespec timeout;
+  timeout.tv_sec = timeout_ms / 1000;
+  timeout.tv_nsec = long(timeout_ms % 1000) * 1000000;
+  syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, value, &timeout, NULL, 0);
+}
+
+void WaitOnAddressUs(volatile uint32_t* addr, uint32_t value, uint32_t timeout_us) {
+  struct timespec timeout;
+  timeout.tv_sec = timeout_us / 1000000;
+  timeout.tv_nsec = long(timeout_us % 1000000) * 1000;
+  syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, value, &timeout, NULL, 0);
+}
+
+void WakeAllOnAddress(volatile uint32_t* addr) {
+  syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+bool WaitOnSharedAddressUs(volatile uint32_t* addr, uint32_t value, uint32_t timeout_us) {
+  struct timespec timeout;
+  timeout.tv_sec = timeout_us / 1000000;
+  timeout.tv_nsec = long(timeout_us % 1000000) * 1000;
+  // Pages the kernel can not key a shared futex on fail with EFAULT or EINVAL.
+  if (syscall(SYS_futex, addr, FUTEX_WAIT, value, &timeout, NULL, 0) == 0) return true;
+  return (errno == ETIMEDOUT) || (errno == EAGAIN) || (errno == EINTR);
+}
+
+void WakeAllOnSharedAddress(volatile uint32_t* addr) {
+  syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+void WakeOneOnAddress(volatile uint32_t* addr) {
+  syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
 Thread CreateThread(ThreadEntry function, void* threadArgument, uint stackSize) {
   os_thread* result = new os_thread(function, threadArgument, stackSize);
   if (!result->Valid()) {
@@ -272,6 +433,149 @@ size_t GetUsablePhysicalHostMemorySize() {
   return std::min(GetUserModeVirtualMemorySize(), physical_size);
 }
 
+bool AdviseHugePages(void* ptr, size_t size) {
+#ifdef MADV_HUGEPAGE
+  return madvise(ptr, size, MADV_HUGEPAGE) == 0;
+#else
+  return false;
+#endif
+}
+
+bool GetCpuNumaNode(uint32_t cpu, uint32_t& node) {
+  // The CPU's sysfs directory links to its node as node<N>.
+  const std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+  DIR* dir = opendir(path.c_str());
+  if (dir == nullptr) return false;
+
+  bool found = false;
+  while (dirent* ent = readdir(dir)) {
+    char* end;
+    if (strncmp(ent->d_name, "node", 4) != 0 || !isdigit(uint8_t(ent->d_name[4]))) continue;
+    const unsigned long value = strtoul(ent->d_name + 4, &end, 10);
+    if (*end != '\0') continue;
+    node = uint32_t(value);
+    found = true;
+    break;
+  }
+  closedir(dir);
+  return found;
+}
+
+bool BindToNumaNode(void* ptr, size_t size, uint32_t node) {
+  // Same values as numaif.h, which comes with libnuma rather than libc.
+  const int kMpolBind = 2;
+  const unsigned kMpolMfMove = 1 << 1;
+  const uint32_t bits = sizeof(unsigned long) * 8;
+  std::vector<unsigned long> mask(node / bits + 1, 0);
+  mask[node / bits] |= 1UL << (node % bits);
+  return syscall(SYS_mbind, ptr, size, kMpolBind, mask.data(), mask.size() * bits + 1,
+                 kMpolMfMove) == 0;
+}
+
+void PrefaultMemory(void* ptr, size_t size) {
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+  if (madvise(ptr, size, MADV_POPULATE_WRITE) == 0) return;
+
+  // Kernels before 5.14, write fault each page in.
+  const size_t page_size = size_t(sysconf(_SC_PAGESIZE));
+  volatile char* bytes = reinterpret_cast<volatile char*>(ptr);
+  for (size_t offset = 0; offset < size; offset += page_size) bytes[offset] = bytes[offset];
+}
+
+void* MapFile(int fd, size_t size) {
+  void* ptr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (ptr == MAP_FAILED) return NULL;
+  // Start reading ahead, the whole file is about to be parsed and uploaded.
+  madvise(ptr, size, MADV_WILLNEED);
+  return ptr;
+}
+
+void UnmapFile(void* ptr, size_t size) { munmap(ptr, size); }
+
+// Identity of the inode shared by anonymous inode files, 0 until looked up.
+static std::atomic<uint64_t> anon_inode_device(0);
+static std::atomic<uint64_t> anon_inode_number(0);
+
+bool GetFileId(int fd, uint64_t& device, uint64_t& inode) {
+  struct stat st;
+  if (fstat(fd, &st) != 0) return false;
+  device = uint64_t(st.st_dev);
+  inode = uint64_t(st.st_ino);
+
+  // Anonymous inode files, such as dma-bufs before Linux 5.3, all share one inode, which does not
+  // tell them apart.  An eventfd is always one of them.
+  if (anon_inode_number.load(std::memory_order_acquire) == 0) {
+    int anon_fd = eventfd(0, EFD_CLOEXEC);
+    if (anon_fd < 0) return false;
+    struct stat anon_st;
+    const bool found = (fstat(anon_fd, &anon_st) == 0);
+    close(anon_fd);
+    if (!found) return false;
+    anon_inode_device.store(uint64_t(anon_st.st_dev), std::memory_order_relaxed);
+    anon_inode_number.store(uint64_t(anon_st.st_ino), std::memory_order_release);
+  }
+  return (device != anon_inode_device.load(std::memory_order_relaxed)) ||
+      (inode != anon_inode_number.load(std::memory_order_relaxed));
+}
+
+size_t ReadFileAt(int fd, void* buffer, size_t size, uint64_t offset) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t ret = pread(fd, reinterpret_cast<char*>(buffer) + done, size - done, offset + done);
+    if (ret < 0 && errno == EINTR) continue;
+    if (ret <= 0) break;
+    done += size_t(ret);
+  }
+  return done;
+}
+
+size_t WriteFileAt(int fd, const void* buffer, size_t size, uint64_t offset) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t ret =
+        pwrite(fd, reinterpret_cast<const char*>(buffer) + done, size - done, offset + done);
+    if (ret < 0 && errno == EINTR) continue;
+    if (ret <= 0) break;
+    done += size_t(ret);
+  }
+  return done;
+}
+
+struct SharedSegmentDescriptor {
+  std::string name;
+  void* ptr;
+  size_t size;
+};
+
+SharedSegment CreateSharedSegment(const std::string& name, size_t size) {
+  const std::string path = (name[0] == '/') ? name : "/" + name;
+  const int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP);
+  if (fd == -1) return NULL;
+  void* ptr = MAP_FAILED;
+  if (ftruncate(fd, size) == 0) ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED) {
+    shm_unlink(path.c_str());
+    return NULL;
+  }
+  return new SharedSegmentDescriptor{path, ptr, size};
+}
+
+void* SharedSegmentAddress(SharedSegment segment) {
+  return reinterpret_cast<SharedSegmentDescriptor*>(segment)->ptr;
+}
+
+void DestroySharedSegment(SharedSegment segment) {
+  SharedSegmentDescriptor* descriptor = reinterpret_cast<SharedSegmentDescriptor*>(segment);
+  munmap(descriptor->ptr, descriptor->size);
+  shm_unlink(descriptor->name.c_str());
+  delete descriptor;
+}
+
+uint32_t GetProcessId() { return uint32_t(getpid()); }
+
 uintptr_t GetUserModeVirtualMemoryBase() { return (uintptr_t)0; }
 
 // Os event implementation
@@ -0,0 +1,178 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+// 
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+// 
+// Developed by:
+// 
+//                 AMD Research and AMD HSA Software Development
+// 
+//                 Advanced Micro Devices, Inc.
+// 
+//                 www.amd.com
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+// 
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "core/util/lock_stats.h"
+
+#include <string.h>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include "core/util/os.h"
+
+std::atomic<bool> LockStats::enabled_(false);
+
+namespace {
+// Sites are looked up from inside locks, so they are guarded by a lock that is not counted.
+std::mutex& SitesLock() {
+  static std::mutex lock;
+  return lock;
+}
+
+std::vector<LockStats::Site*>& Sites() {
+  static std::vector<LockStats::Site*> sites;
+  return sites;
+}
+
+uint64_t ElapsedNs(uint64_t start, uint64_t end) {
+  static const double kNsPerTick = 1e9 / double(os::AccurateClockFrequency());
+  return uint64_t(double(end - start) * kNsPerTick);
+}
+
+uint32_t Bucket(uint64_t ns) {
+  uint32_t bucket = 0;
+  for (uint64_t v = ns >> 7; (v != 0) && (bucket < LockStats::kBuckets - 1); v >>= 1) bucket++;
+  return bucket;
+}
+}  // namespace
+
+void LockStats::Enable() { enabled_.store(true, std::memory_order_relaxed); }
+
+LockStats::Site* LockStats::Lookup(const char* name) {
+  if (name == nullptr) name = "(unnamed)";
+
+  std::lock_guard<std::mutex> lock(SitesLock());
+  for (Site* site : Sites())
+    if (strcmp(site->name, name) == 0) return site;
+
+  Site* site = new Site();
+  site->name = name;
+  Sites().push_back(site);
+  return site;
+}
+
+uint64_t LockStats::Probe::Contended() const { return os::ReadAccurateClock(); }
+
+void LockStats::Probe::Acquired(uint64_t wait_start) {
+  if (site_ == nullptr) site_ = Lookup(name_);
+  acquired_ = os::ReadAccurateClock();
+
+  site_->acquisitions.fetch_add(1, std::memory_order_relaxed);
+  if (wait_start == 0) return;
+
+  const uint64_t ns = ElapsedNs(wait_start, acquired_);
+  site_->contended.fetch_add(1, std::memory_order_relaxed);
+  site_->wait_ns.fetch_add(ns, std::memory_order_relaxed);
+  site_->wait_buckets[Bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void LockStats::Probe::Releasing() {
+  // Acquired before counting was enabled.
+  if (acquired_ == 0) return;
+
+  const uint64_t ns = ElapsedNs(acquired_, os::ReadAccurateClock());
+  acquired_ = 0;
+  site_->hold_ns.fetch_add(ns, std::memory_order_relaxed);
+  site_->hold_buckets[Bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void LockStats::Report(FILE* out) {
+  struct Row {
+    const char* name;
+    uint64_t acquisitions;
+    uint64_t contended;
+    uint64_t wait_ns;
+    uint64_t hold_ns;
+    uint64_t wait_buckets[kBuckets];
+    uint64_t hold_buckets[kBuckets];
+  };
+  std::vector<Row> rows;
+
+  {
+    std::lock_guard<std::mutex> lock(SitesLock());
+    for (Site* site : Sites()) {
+      Row row = {site->name, 0, 0, 0, 0, {}, {}};
+      row.acquisitions = site->acquisitions.exchange(0, std::memory_order_relaxed);
+      row.contended = site->contended.exchange(0, std::memory_order_relaxed);
+      row.wait_ns = site->wait_ns.exchange(0, std::memory_order_relaxed);
+      row.hold_ns = site->hold_ns.exchange(0, std::memory_order_relaxed);
+      for (uint32_t i = 0; i < kBuckets; i++) {
+        row.wait_buckets[i] = site->wait_buckets[i].exchange(0, std::memory_order_relaxed);
+        row.hold_buckets[i] = site->hold_buckets[i].exchange(0, std::memory_order_relaxed);
+      }
+      if (row.acquisitions != 0) rows.push_back(row);
+    }
+  }
+  if (rows.empty()) return;
+
+  std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+    return (a.wait_ns != b.wait_ns) ? (a.wait_ns > b.wait_ns) : (a.hold_ns > b.hold_ns);
+  });
+
+  // Upper bound in ns of the bucket holding the sample at fraction @p q of @p count.
+  const auto& quantile = [](const uint64_t* buckets, uint64_t count, double q) -> uint64_t {
+    const uint64_t rank = uint64_t(q * double(count - 1));
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < kBuckets; i++) {
+      seen += buckets[i];
+      if (seen > rank) return uint64_t(1) << (i + 7);
+    }
+    return uint64_t(1) << (kBuckets + 6);
+  };
+
+  fprintf(out, "HSA lock stats\n");
+  fprintf(out, "%-32s %12s %12s %12s %10s %12s %10s %10s\n", "lock", "acquired", "contended",
+          "wait_us", "p99_wait<", "hold_us", "p50_hold<", "p99_hold<");
+  for (const Row& row : rows) {
+    // Holds still in progress at the report have not been counted yet.
+    uint64_t holds = 0;
+    for (uint32_t i = 0; i < kBuckets; i++) holds += row.hold_buckets[i];
+    fprintf(out, "%-32s %12llu %12llu %12.1f %10llu %12.1f %10llu %10llu\n", row.name,
+            (unsigned long long)row.acquisitions, (unsigned long long)row.contended,
+            row.wait_ns / 1000.0,
+            (unsigned long long)(row.contended ? quantile(row.wait_buckets, row.contended, 0.99)
+                                               : 0),
+            row.hold_ns / 1000.0,
+            (unsigned long long)(holds ? quantile(row.hold_buckets, holds, 0.5) : 0),
+            (unsigned long long)(holds ? quantile(row.hold_buckets, holds, 0.99) : 0));
+  }
+}
@@ -0,0 +1,113 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+// 
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+// 
+// Developed by:
+// 
+//                 AMD Research and AMD HSA Software Development
+// 
+//                 Advanced Micro Devices, Inc.
+// 
+//                 www.amd.com
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+// 
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HSA_RUNTIME_CORE_UTIL_LOCK_STATS_H_
+#define HSA_RUNTIME_CORE_UTIL_LOCK_STATS_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+
+#include "core/util/utils.h"
+
+/// @brief Contention counters of KernelMutex and SpinMutex, grouped by lock name.
+///
+/// Disabled by default, when Enable has not been called locks only test one flag.  Once enabled
+/// each acquisition is counted against the site named by its lock and the time spent waiting for
+/// and holding the lock are added to log2 histograms.  Locks without a name share one site.
+/// Report may be called at any time, for instance from a debugger; it prints and resets the
+/// counters.
+class LockStats {
+ public:
+  // Time bucket i counts acquisitions waiting or holding [2^(i+6), 2^(i+7)) ns, the first and last
+  // bucket also take shorter and longer ones.
+  static const uint32_t kBuckets = 16;
+
+  /// @brief Counters of the locks sharing one name.
+  struct Site {
+    const char* name;
+    std::atomic<uint64_t> acquisitions;
+    std::atomic<uint64_t> contended;
+    std::atomic<uint64_t> wait_ns;
+    std::atomic<uint64_t> hold_ns;
+    std::atomic<uint64_t> wait_buckets[kBuckets];
+    std::atomic<uint64_t> hold_buckets[kBuckets];
+  };
+
+  /// @brief Start counting lock acquisitions.
+  static void Enable();
+
+  static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+  /// @brief Print the sites acquired since the last report to @p out, most waited on first, and
+  /// reset their counters.
+  static void Report(FILE* out);
+
+  /// @brief Per lock state, the lock's own mutual exclusion protects it.
+  class Probe {
+   public:
+    explicit Probe(const char* name) : name_(name), site_(nullptr), acquired_(0) {}
+
+    /// @brief Returns a timestamp to pass to Acquired if the lock is about to be waited on.
+    uint64_t Contended() const;
+
+    /// @brief Record an acquisition, @p wait_start is 0 if it did not wait.  Caller holds the lock.
+    void Acquired(uint64_t wait_start);
+
+    /// @brief Record the hold time.  Caller still holds the lock.
+    void Releasing();
+
+   private:
+    const char* name_;
+    Site* site_;
+    uint64_t acquired_;
+    DISALLOW_COPY_AND_ASSIGN(Probe);
+  };
+
+ private:
+  /// @brief Returns the site of @p name, created on first use and never freed.
+  static Site* Lookup(const char* name);
+
+  static std::atomic<bool> enabled_;
+};
+
+#endif  // HSA_RUNTIME_CORE_UTIL_LOCK_STATS_H_
@@ -47,6 +47,7 @@
 
 #include "utils.h"
 #include "os.h"
+#include "lock_stats.h"
 
 /// @brief: A class behaves as a lock in a scope. When trying to enter into the
 /// critical section, creat a object of this class. After the control path goes
@@ -80,46 +81,191 @@ class ScopedAcquire {
 /// Uses the kernel's scheduler to keep the waiting thread from being scheduled
 /// until the lock is released (Best for long waits, though anything using
 /// a kernel object is a long wait).
+/// @p name groups the lock's acquisitions in LockStats reports.
 class KernelMutex {
  public:
-  KernelMutex() { lock_ = os::CreateMutex(); }
+  KernelMutex() : probe_(nullptr) { lock_ = os::CreateMutex(); }
+  explicit KernelMutex(const char* name) : probe_(name) { lock_ = os::CreateMutex(); }
   ~KernelMutex() { os::DestroyMutex(lock_); }
 
-  bool Try() { return os::TryAcquireMutex(lock_); }
-  bool Acquire() { return os::AcquireMutex(lock_); }
-  void Release() { os::ReleaseMutex(lock_); }
+  bool Try() {
+    if (!os::TryAcquireMutex(lock_)) return false;
+    if (LockStats::enabled()) probe_.Acquired(0);
+    return true;
+  }
+  bool Acquire() {
+    if (!LockStats::enabled()) return os::AcquireMutex(lock_);
+    if (Try()) return true;
+    const uint64_t wait_start = probe_.Contended();
+    if (!os::AcquireMutex(lock_)) return false;
+    probe_.Acquired(wait_start);
+    return true;
+  }
+  void Release() {
+    if (LockStats::enabled()) probe_.Releasing();
+    os::ReleaseMutex(lock_);
+  }
 
  private:
   os::Mutex lock_;
+  LockStats::Probe probe_;
 
   /// @brief: Disable copiable and assignable ability.
   DISALLOW_COPY_AND_ASSIGN(KernelMutex);
 };
 
+/// @brief: a reader/writer mutex.  Acquire and Release take it exclusively.
+/// For shared access lock the view returned by shared(), e.g.
+/// ScopedAcquire<KernelSharedMutex::Shared> lock(mutex.shared()).
+class KernelSharedMutex {
+ public:
+  class Shared {
+   public:
+    explicit Shared(KernelSharedMutex* lock) : lock_(lock) {}
+
+    bool Acquire() { return os::AcquireSharedMutex(lock_->lock_, true); }
+    void Release() { os::ReleaseSharedMutex(lock_->lock_, true); }
+
+   private:
+    KernelSharedMutex* lock_;
+
+    /// @brief: Disable copiable and assignable ability.
+    DISALLOW_COPY_AND_ASSIGN(Shared);
+  };
+
+  KernelSharedMutex() : shared_(this) { lock_ = os::CreateSharedMutex(); }
+  ~KernelSharedMutex() { os::DestroySharedMutex(lock_); }
+
+  bool Acquire() { return os::AcquireSharedMutex(lock_, false); }
+  void Release() { os::ReleaseSharedMutex(lock_, false); }
+
+  Shared* shared() { return &shared_; }
+
+ private:
+  os::SharedMutex lock_;
+  Shared shared_;
+
+  /// @brief: Disable copiable and assignable ability.
+  DISALLOW_COPY_AND_ASSIGN(KernelSharedMutex);
+};
+
+/// @brief: advanced by the side making progress to wake threads pacing a wait
+/// on it with AdaptiveWait.  Notify costs one atomic add unless a waiter
+/// sleeps.
+class ProgressEvent {
+ public:
+  ProgressEvent() : seq_(0), sleepers_(0) {}
+
+  /// @brief: Wake the threads sleeping on the event.
+  void Notify() {
+    atomic::Add(&seq_, 1U, std::memory_order_seq_cst);
+    if (atomic::Load(&sleepers_, std::memory_order_seq_cst) != 0) os::WakeAllOnAddress(&seq_);
+  }
+
+  uint32_t sequence() const { return atomic::Load(&seq_, std::memory_order_acquire); }
+
+  /// @brief: Sleep for up to @p timeout_us unless notified since @p seen was read.
+  void Sleep(uint32_t seen, uint32_t timeout_us) {
+    atomic::Increment(&sleepers_, std::memory_order_seq_cst);
+    os::WaitOnAddressUs(&seq_, seen, timeout_us);
+    atomic::Decrement(&sleepers_, std::memory_order_relaxed);
+  }
+
+ private:
+  volatile uint32_t seq_;
+  volatile uint32_t sleepers_;
+
+  /// @brief: Disable copiable and assignable ability.
+  DISALLOW_COPY_AND_ASSIGN(ProgressEvent);
+};
+
+/// @brief: paces a polling wait for another thread or the hardware, e.g.
+/// AdaptiveWait wait(&event); while (!done()) wait.Pause();
+/// Spins with the processor paused for a bounded number of polls, then sleeps
+/// in slices doubling up to kMaxSleepUs.  Sleeps end early on a notify of
+/// @p event.  Hardware progress wakes nobody, so waits without an event rely
+/// on the slices alone.
+class AdaptiveWait {
+ public:
+  explicit AdaptiveWait(ProgressEvent* event = nullptr)
+      : event_(event), seen_(event ? event->sequence() : 0), polls_(0), sleep_us_(kMinSleepUs) {}
+
+  void Pause() {
+    if (polls_ < kSpinPolls) {
+      polls_++;
+      CpuRelax();
+      return;
+    }
+
+    if (event_ != nullptr) {
+      event_->Sleep(seen_, sleep_us_);
+      seen_ = event_->sequence();
+    } else {
+      os::uSleep(sleep_us_);
+    }
+    if (sleep_us_ < kMaxSleepUs) sleep_us_ *= 2;
+  }
+
+ private:
+  static const uint32_t kSpinPolls = 256;
+  static const uint32_t kMinSleepUs = 2;
+  static const uint32_t kMaxSleepUs = 256;
+
+  ProgressEvent* event_;
+  uint32_t seen_;
+  uint32_t polls_;
+  uint32_t sleep_us_;
+
+  /// @brief: Disable copiable and assignable ability.
+  DISALLOW_COPY_AND_ASSIGN(AdaptiveWait);
+};
+
 /// @brief: represents a spin lock.
 /// For very short hold durations on the order of the thread scheduling
-/// quanta or less.
+/// quanta or less.  Contended acquires spin briefly with the processor paused
+/// and then sleep on the lock word until a release wakes them.
 class SpinMutex {
  public:
-  SpinMutex() { lock_ = 0; }
+  SpinMutex() : probe_(nullptr) { lock_ = kFree; }
+  explicit SpinMutex(const char* name) : probe_(name) { lock_ = kFree; }
 
   bool Try() {
-    int old = 0;
-    return lock_.compare_exchange_strong(old, 1);
+    if (atomic::Cas(&lock_, kHeld, kFree, std::memory_order_acquire) != kFree) return false;
+    if (LockStats::enabled()) probe_.Acquired(0);
+    return true;
   }
   bool Acquire() {
-    int old = 0;
-    while (!lock_.compare_exchange_strong(old, 1))
-	{
-		old=0;
-    os::YieldThread();
-	}
+    if (Try()) return true;
+
+    const uint64_t wait_start = LockStats::enabled() ? probe_.Contended() : 0;
+    bool acquired = false;
+    for (uint32_t i = 0; (i < kSpinPolls) && !acquired; i++) {
+      CpuRelax();
+      acquired = (atomic::Load(&lock_, std::memory_order_relaxed) == kFree) &&
+          (atomic::Cas(&lock_, kHeld, kFree, std::memory_order_acquire) == kFree);
+    }
+    // Once slept, the lock is taken as contended so the release wakes the next sleeper.
+    if (!acquired) {
+      while (atomic::Exchange(&lock_, kContended, std::memory_order_acquire) != kFree)
+        os::WaitOnAddress(&lock_, kContended, UINT32_MAX);
+    }
+    if (LockStats::enabled()) probe_.Acquired(wait_start);
     return true;
   }
-  void Release() { lock_ = 0; }
+  void Release() {
+    if (LockStats::enabled()) probe_.Releasing();
+    if (atomic::Exchange(&lock_, kFree, std::memory_order_release) == kContended)
+      os::WakeOneOnAddress(&lock_);
+  }
 
  private:
-  std::atomic<int> lock_;
+  static const uint32_t kFree = 0;
+  static const uint32_t kHeld = 1;
+  static const uint32_t kContended = 2;
+  static const uint32_t kSpinPolls = 128;
+
+  volatile uint32_t lock_;
+  LockStats::Probe probe_;
 
   /// @brief: Disable copiable and assignable ability.
   DISALLOW_COPY_AND_ASSIGN(SpinMutex);
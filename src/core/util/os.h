@@ -46,13 +46,16 @@
 #define HSA_RUNTIME_CORE_UTIL_OS_H_
 
 #include <string>
+#include <vector>
 #include "utils.h"
 
 namespace os {
 typedef void* LibHandle;
 typedef void* Mutex;
+typedef void* SharedMutex;
 typedef void* Thread;
 typedef void* EventHandle;
+typedef void* SharedSegment;
 
 enum class os_t { OS_WIN = 0, OS_LINUX, COUNT };
 static __forceinline std::underlying_type<os_t>::type os_index(os_t val) {
@@ -83,6 +86,13 @@ void* GetExportAddress(LibHandle lib, std::string export_name);
 /// @param: lib(Input), library handle which will be unloaded.
 void CloseLib(LibHandle lib);
 
+/// @brief: Describes the file a library was loaded from, its path, size and
+/// modification time, so that replacing the library changes the result.
+/// @param: lib(Input), library handle.
+/// @param: identity(Output), opaque description of the file.
+/// @return: bool, false if the file can not be determined.
+bool GetLibIdentity(LibHandle lib, std::string& identity);
+
 /// @brief: Creates a mutex, will return NULL if failed.
 /// @param: void.
 /// @return: Mutex.
@@ -109,6 +119,29 @@ void ReleaseMutex(Mutex lock);
 /// @return: void.
 void DestroyMutex(Mutex lock);
 
+/// @brief: Creates a reader/writer mutex, will return NULL if failed.
+/// @param: void.
+/// @return: SharedMutex.
+SharedMutex CreateSharedMutex();
+
+/// @brief: Aquires the mutex, shared with other shared owners if shared is
+/// true and exclusively otherwise.  Waits until the mutex can be acquired.
+/// @param: lock(Input), handle to the mutex.
+/// @param: shared(Input), true to acquire shared ownership.
+/// @return: bool.
+bool AcquireSharedMutex(SharedMutex lock, bool shared);
+
+/// @brief: Releases the mutex.
+/// @param: lock(Input), handle to the mutex.
+/// @param: shared(Input), must match the shared argument of the acquire.
+/// @return: void.
+void ReleaseSharedMutex(SharedMutex lock, bool shared);
+
+/// @brief: Destroys the mutex.
+/// @param: lock(Input), handle to the mutex.
+/// @return: void.
+void DestroySharedMutex(SharedMutex lock);
+
 /// @brief: Puts current thread to sleep.
 /// @param: delayInMs(Input), time in millisecond for sleeping.
 /// @return: void.
@@ -124,6 +157,75 @@ void uSleep(int delayInUs);
 /// @return: void.
 void YieldThread();
 
+/// @brief: Binds the calling thread to a contiguous range of CPUs.
+/// @param: first_cpu(Input), id of the first CPU.
+/// @param: num_cpus(Input), number of CPUs in the range.
+/// @return: bool, true if the affinity was applied.
+bool SetThreadAffinity(uint32_t first_cpu, uint32_t num_cpus);
+
+/// @brief: Binds the calling thread to a list of CPUs.
+/// @param: cpus(Input), ids of the CPUs.
+/// @param: num_cpus(Input), number of entries in @p cpus.
+/// @return: bool, true if the affinity was applied.
+bool SetThreadAffinityList(const uint32_t* cpus, uint32_t num_cpus);
+
+/// @brief: Returns the CPUs the calling thread may run on.
+/// @param: cpus(Output), ids of the CPUs.
+/// @return: bool, true if the affinity was read.
+bool GetThreadAffinityList(std::vector<uint32_t>& cpus);
+
+/// @brief: Returns the number of CPU ids an affinity list can address.
+/// @return: uint32_t, CPU ids from 0 up to this value, exclusive, are valid.
+uint32_t MaxAffinityCpus();
+
+/// @brief: Scheduling classes of SetThreadScheduling.
+enum ThreadSched { kSchedNormal, kSchedBatch, kSchedIdle, kSchedFifo, kSchedRoundRobin };
+
+/// @brief: Returns the scheduling class and priority of the calling thread, as
+/// taken by SetThreadScheduling.
+/// @param: sched(Output), scheduling class.
+/// @param: priority(Output), nice value or real time priority.
+/// @return: bool, true if the class and priority were read.
+bool GetThreadScheduling(ThreadSched& sched, int& priority);
+
+/// @brief: Sets the scheduling class and priority of the calling thread.
+/// @param: sched(Input), scheduling class.
+/// @param: priority(Input), nice value for the normal and batch classes,
+/// real time priority for the FIFO and round robin classes, ignored otherwise.
+/// @return: bool, true if the class and priority were applied.
+bool SetThreadScheduling(ThreadSched sched, int priority);
+
+/// @brief: Sleeps while the value at an address is unchanged.  May return early.
+/// @param: addr(Input), address to watch.
+/// @param: value(Input), value expected at @p addr.
+/// @param: timeout_ms(Input), maximum time to sleep in milliseconds.
+/// @return: void.
+void WaitOnAddress(volatile uint32_t* addr, uint32_t value, uint32_t timeout_ms);
+
+/// @brief: Same as WaitOnAddress with a timeout in microseconds.  Precision is
+/// that of the platform's sleeps.
+void WaitOnAddressUs(volatile uint32_t* addr, uint32_t value, uint32_t timeout_us);
+
+/// @brief: Wakes one thread sleeping in WaitOnAddress on an address.
+/// @param: addr(Input), address watched by the sleepers.
+/// @return: void.
+void WakeOneOnAddress(volatile uint32_t* addr);
+
+/// @brief: Wakes all threads sleeping in WaitOnAddress on an address.
+/// @param: addr(Input), address watched by the sleepers.
+/// @return: void.
+void WakeAllOnAddress(volatile uint32_t* addr);
+
+/// @brief: Same as WaitOnAddressUs for an address in memory mapped by several
+/// processes.
+/// @return: false if the platform can not sleep on @p addr, the caller must
+/// then sleep by other means.
+bool WaitOnSharedAddressUs(volatile uint32_t* addr, uint32_t value, uint32_t timeout_us);
+
+/// @brief: Wakes all threads of any process sleeping in WaitOnSharedAddressUs
+/// on an address.
+void WakeAllOnSharedAddress(volatile uint32_t* addr);
+
 typedef void (*ThreadEntry)(void*);
 
 /// @brief: Creates a thread will return NULL if failed.
@@ -173,6 +275,91 @@ size_t GetUserModeVirtualMemorySize();
 /// @return: size_t, size of the physical host system memory.
 size_t GetUsablePhysicalHostMemorySize();
 
+/// @brief: Asks for transparent huge page backing of a range of memory not yet
+/// touched.
+/// @param: ptr(Input), base of the range, aligned to a huge page.
+/// @param: size(Input), size of the range in bytes.
+/// @return: bool, true if the advice was accepted.
+bool AdviseHugePages(void* ptr, size_t size);
+
+/// @brief: Looks up the OS NUMA node of a CPU.
+/// @param: cpu(Input), id of the CPU.
+/// @param: node(Output), NUMA node as numbered by the OS.
+/// @return: bool, false if the node is not known.
+bool GetCpuNumaNode(uint32_t cpu, uint32_t& node);
+
+/// @brief: Places the pages of a range of memory, including pages already
+/// present, on one NUMA node.
+/// @param: ptr(Input), base of the range, page aligned.
+/// @param: size(Input), size of the range in bytes.
+/// @param: node(Input), NUMA node as numbered by the OS, which need not match
+/// the KFD node id of the CPU agent.
+/// @return: bool, true if the policy was applied.
+bool BindToNumaNode(void* ptr, size_t size, uint32_t node);
+
+/// @brief: Backs every page of a range of writable memory so that first
+/// accesses do not fault.  The contents are left unchanged.
+/// @param: ptr(Input), base of the range, page aligned.
+/// @param: size(Input), size of the range in bytes.
+/// @return: void.
+void PrefaultMemory(void* ptr, size_t size);
+
+/// @brief: Maps the first bytes of a file read-only into the address space.
+/// @param: fd(Input), descriptor of the file, open for reading.
+/// @param: size(Input), number of bytes to map.
+/// @return: void*, base of the mapping or NULL if the file can't be mapped.
+void* MapFile(int fd, size_t size);
+
+/// @brief: Unmaps a mapping returned by MapFile.
+/// @param: ptr(Input), base of the mapping.
+/// @param: size(Input), size passed to MapFile.
+void UnmapFile(void* ptr, size_t size);
+
+/// @brief: Identifies the file behind a descriptor, stable across descriptor reuse.  Files
+/// without an inode of their own, which can't be told apart, are not identified.
+/// @param: fd(Input), descriptor of the file.
+/// @param: device(Output), device holding the file.
+/// @param: inode(Output), file number on @p device.
+/// @return: bool, false if the file can't be identified.
+bool GetFileId(int fd, uint64_t& device, uint64_t& inode);
+
+/// @brief: Reads from a file at an offset without moving its file position.
+/// @param: fd(Input), descriptor of the file, open for reading.
+/// @param: buffer(Output), destination of the data.
+/// @param: size(Input), number of bytes to read.
+/// @param: offset(Input), file offset of the first byte.
+/// @return: size_t, bytes read, less than @p size at end of file or on error.
+size_t ReadFileAt(int fd, void* buffer, size_t size, uint64_t offset);
+
+/// @brief: Writes to a file at an offset without moving its file position.
+/// @param: fd(Input), descriptor of the file, open for writing.
+/// @param: buffer(Input), source of the data.
+/// @param: size(Input), number of bytes to write.
+/// @param: offset(Input), file offset of the first byte.
+/// @return: size_t, bytes written, less than @p size on error.
+size_t WriteFileAt(int fd, const void* buffer, size_t size, uint64_t offset);
+
+/// @brief: Creates a named shared memory segment, readable by other processes
+/// of the same user or group, and maps it.  Fails if the name is taken.
+/// @param: name(Input), name of the segment.
+/// @param: size(Input), size of the segment in bytes.
+/// @return: SharedSegment, handle to the segment, NULL on failure.
+SharedSegment CreateSharedSegment(const std::string& name, size_t size);
+
+/// @brief: Returns the address a shared segment is mapped at.
+/// @param: segment(Input), handle returned by CreateSharedSegment.
+/// @return: void*, address of the first byte of the segment.
+void* SharedSegmentAddress(SharedSegment segment);
+
+/// @brief: Unmaps a shared segment and removes its name.
+/// @param: segment(Input), handle returned by CreateSharedSegment.
+/// @return: void.
+void DestroySharedSegment(SharedSegment segment);
+
+/// @brief: Returns the id of the calling process.
+/// @return: uint32_t, process id.
+uint32_t GetProcessId();
+
 /// @brief: Gets the virtual memory base address. It is hardcoded to 0.
 /// @param: void.
 /// @return: uintptr_t, always 0.
@@ -0,0 +1,255 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Address range index with sharded reader/writer locking.
+
+#ifndef HSA_RUNTIME_CORE_UTIL_SHARDED_RANGE_MAP_H_
+#define HSA_RUNTIME_CORE_UTIL_SHARDED_RANGE_MAP_H_
+
+#include <map>
+#include <utility>
+
+#include "core/util/utils.h"
+#include "core/util/locks.h"
+
+/*
+ * Map of disjoint address ranges to values, for many concurrent lookups and
+ * fewer updates.
+ *
+ * The address space is cut into kGranule sized granules which are dealt round
+ * robin to kShards shards.  Each shard lists the ranges overlapping any of its
+ * granules, so a lookup only visits the shard of the queried address and takes
+ * its lock shared.  Values are stored once.  Changes lock every shard listing
+ * the range exclusively, in shard order.
+ */
+template <typename T> class ShardedRangeMap {
+ public:
+  static const uint32_t kShards = 16;
+  static const size_t kGranule = 2 * 1024 * 1024;
+
+  ShardedRangeMap() {}
+  ~ShardedRangeMap() { Clear(); }
+
+  /// @brief Adds [base, base + size), replacing a range at the same base.
+  void Insert(const void* base, size_t size, T&& value) {
+    Entry* entry = new Entry(uintptr_t(base), size, std::move(value));
+    const uint32_t shards = ShardMask(entry->base, size);
+    LockShards(shards);
+    Entry* old = nullptr;
+    for (uint32_t i = 0; i < kShards; i++) {
+      if ((shards & (1u << i)) == 0) continue;
+      Entry*& slot = shards_[i].ranges[entry->base];
+      if (slot != nullptr) old = slot;
+      slot = entry;
+    }
+    UnlockShards(shards);
+    if (old != nullptr) Erase(old);
+  }
+
+  /// @brief Calls f(base, size, value) with the shard lock held shared for the
+  /// range starting at @p ptr, or containing it if @p containing.  Returns
+  /// false if there is no such range.
+  template <typename F> bool Find(const void* ptr, bool containing, F f) {
+    Shard& shard = shards_[ShardOf(uintptr_t(ptr))];
+    ScopedAcquire<KernelSharedMutex::Shared> lock(shard.lock.shared());
+    const Entry* entry = Lookup(shard, uintptr_t(ptr), containing);
+    if (entry == nullptr) return false;
+    f(reinterpret_cast<const void*>(entry->base), entry->size, entry->value);
+    return true;
+  }
+
+  /// @brief As Find but holds the range exclusively, so f may modify the value.
+  template <typename F> bool Update(const void* ptr, bool containing, F f) {
+    while (true) {
+      uint32_t shards;
+      {
+        Shard& shard = shards_[ShardOf(uintptr_t(ptr))];
+        ScopedAcquire<KernelSharedMutex::Shared> lock(shard.lock.shared());
+        const Entry* entry = Lookup(shard, uintptr_t(ptr), containing);
+        if (entry == nullptr) return false;
+        shards = ShardMask(entry->base, entry->size);
+      }
+      // Revalidate, the range may have changed while no lock was held.
+      LockShards(shards);
+      Entry* entry = Lookup(shards_[ShardOf(uintptr_t(ptr))], uintptr_t(ptr), containing);
+      if ((entry != nullptr) && (ShardMask(entry->base, entry->size) == shards)) {
+        f(reinterpret_cast<const void*>(entry->base), entry->size, entry->value);
+        UnlockShards(shards);
+        return true;
+      }
+      UnlockShards(shards);
+      if (entry == nullptr) return false;
+    }
+  }
+
+  /// @brief Removes the range starting at @p base if f(size, value) returns
+  /// true.  f runs with the range held exclusively and may move the value out.
+  /// Returns false if there is no such range.
+  template <typename F> bool Erase(const void* base, F f) {
+    Entry* removed = nullptr;
+    const bool found = Update(base, false, [&](const void*, size_t size, T& value) {
+      if (!f(size, value)) return;
+      const uint32_t shards = ShardMask(uintptr_t(base), size);
+      for (uint32_t i = 0; i < kShards; i++) {
+        if ((shards & (1u << i)) == 0) continue;
+        auto it = shards_[i].ranges.find(uintptr_t(base));
+        removed = it->second;
+        shards_[i].ranges.erase(it);
+      }
+    });
+    delete removed;
+    return found;
+  }
+
+  /// @brief Calls f(base, size, value) for up to @p before ranges below @p ptr
+  /// and @p after ranges from @p ptr on, among those in the shard of @p ptr.
+  /// For diagnostics, neighbours listed only in other shards are skipped.
+  template <typename F> void ForEachNear(const void* ptr, int before, int after, F f) {
+    Shard& shard = shards_[ShardOf(uintptr_t(ptr))];
+    ScopedAcquire<KernelSharedMutex::Shared> lock(shard.lock.shared());
+    auto it = shard.ranges.upper_bound(uintptr_t(ptr));
+    for (int i = 0; (i < before) && (it != shard.ranges.begin()); i++) it--;
+    for (int i = 0; (i < before + after) && (it != shard.ranges.end()); i++, it++)
+      f(reinterpret_cast<const void*>(it->second->base), it->second->size, it->second->value);
+  }
+
+  /// @brief Calls f(base, size, value) once for every range, with every shard
+  /// held shared.  f must not change the map.
+  template <typename F> void ForEach(F f) {
+    for (uint32_t i = 0; i < kShards; i++) shards_[i].lock.shared()->Acquire();
+    for (uint32_t i = 0; i < kShards; i++) {
+      for (auto& range : shards_[i].ranges) {
+        if (LowestShard(ShardMask(range.second->base, range.second->size)) == i)
+          f(reinterpret_cast<const void*>(range.second->base), range.second->size,
+            range.second->value);
+      }
+    }
+    for (uint32_t i = 0; i < kShards; i++) shards_[i].lock.shared()->Release();
+  }
+
+  void Clear() {
+    LockShards(AllShards());
+    for (uint32_t i = 0; i < kShards; i++) {
+      for (auto& range : shards_[i].ranges) {
+        // Delete each entry once, from the lowest shard listing it.
+        if (LowestShard(ShardMask(range.second->base, range.second->size)) == i)
+          delete range.second;
+      }
+      shards_[i].ranges.clear();
+    }
+    UnlockShards(AllShards());
+  }
+
+ private:
+  struct Entry {
+    Entry(uintptr_t base_arg, size_t size_arg, T&& value_arg)
+        : base(base_arg), size(size_arg), value(std::move(value_arg)) {}
+    uintptr_t base;
+    size_t size;
+    T value;
+  };
+
+  struct Shard {
+    KernelSharedMutex lock;
+    std::map<uintptr_t, Entry*> ranges;
+  };
+
+  static uint32_t AllShards() { return uint32_t((1ull << kShards) - 1); }
+
+  static uint32_t ShardOf(uintptr_t address) { return uint32_t((address / kGranule) % kShards); }
+
+  static uint32_t ShardMask(uintptr_t base, size_t size) {
+    const uintptr_t first = base / kGranule;
+    const uintptr_t last = (base + Max(size, size_t(1)) - 1) / kGranule;
+    if (last - first + 1 >= kShards) return AllShards();
+    uint32_t mask = 0;
+    for (uintptr_t granule = first; granule <= last; granule++) mask |= 1u << (granule % kShards);
+    return mask;
+  }
+
+  static uint32_t LowestShard(uint32_t mask) {
+    uint32_t i = 0;
+    while ((mask & (1u << i)) == 0) i++;
+    return i;
+  }
+
+  static Entry* Lookup(Shard& shard, uintptr_t ptr, bool containing) {
+    if (!containing) {
+      auto it = shard.ranges.find(ptr);
+      return (it == shard.ranges.end()) ? nullptr : it->second;
+    }
+    auto it = shard.ranges.upper_bound(ptr);
+    if (it == shard.ranges.begin()) return nullptr;
+    it--;
+    Entry* entry = it->second;
+    return (ptr < entry->base + entry->size) ? entry : nullptr;
+  }
+
+  void LockShards(uint32_t mask) {
+    for (uint32_t i = 0; i < kShards; i++)
+      if ((mask & (1u << i)) != 0) shards_[i].lock.Acquire();
+  }
+
+  void UnlockShards(uint32_t mask) {
+    for (uint32_t i = 0; i < kShards; i++)
+      if ((mask & (1u << i)) != 0) shards_[i].lock.Release();
+  }
+
+  /// @brief Removes and deletes an entry that is no longer listed at its base.
+  void Erase(Entry* entry) {
+    const uint32_t shards = ShardMask(entry->base, entry->size);
+    LockShards(shards);
+    for (uint32_t i = 0; i < kShards; i++) {
+      if ((shards & (1u << i)) == 0) continue;
+      auto it = shards_[i].ranges.find(entry->base);
+      if ((it != shards_[i].ranges.end()) && (it->second == entry)) shards_[i].ranges.erase(it);
+    }
+    UnlockShards(shards);
+    delete entry;
+  }
+
+  Shard shards_[kShards];
+
+  DISALLOW_COPY_AND_ASSIGN(ShardedRangeMap);
+};
+
+#endif  // HSA_RUNTIME_CORE_UTIL_SHARDED_RANGE_MAP_H_
@@ -40,62 +40,177 @@
 //
 ////////////////////////////////////////////////////////////////////////////////
 
-// A simple best fit memory allocator with eager compaction.  Manages block sub-allocation.
-// For use when memory efficiency is more important than allocation speed.
-// O(log n) time.
+// A segregated fit memory allocator with eager compaction.  Manages block sub-allocation.
+// Free fragments are kept in size class bins found through a bitmap, and fragment headers are
+// stored in a side array per block so that splitting and coalescing need no node allocations.
+// O(1) time for alloc and free, except for the lookup of the block holding a freed pointer
+// which is O(log blocks).
 
 #ifndef HSA_RUNTME_CORE_UTIL_SIMPLE_HEAP_H_
 #define HSA_RUNTME_CORE_UTIL_SIMPLE_HEAP_H_
 
-#include <map>
+#include <stdint.h>
 #include <deque>
-#include <utility>
+#include <map>
+#include <memory>
+#include <new>
+#include <vector>
 
 #include "core/util/utils.h"
 
-template <typename Allocator> class SimpleHeap {
+/// Allocations are rounded up to Granule bytes.  Blocks returned by Allocator must be Granule
+/// aligned.
+template <typename Allocator, size_t Granule = 4096> class SimpleHeap {
  private:
-  struct Fragment_T {
-    typedef std::multimap<size_t, uintptr_t>::iterator ptr_t;
-    ptr_t free_list_entry_;
-    size_t size;
-
-    Fragment_T(ptr_t Iterator, size_t Len) : free_list_entry_(Iterator), size(Len) {}
-    Fragment_T() = default;
+  struct Block;
+
+  /// Header for a granule of a block.  Only the header of the first granule of a fragment is
+  /// live, the header of the last granule of a free fragment records where it starts.
+  struct Fragment {
+    Fragment* prev_;  // Bin links while free.
+    Fragment* next_;
+    Block* block_;
+    uint32_t granules_;  // Fragment length if this granule starts one, else 0.
+    uint32_t head_;      // Index of the start of the free fragment ending here.
+    bool free_;
   };
 
   struct Block {
     uintptr_t base_ptr_;
     size_t length_;
+    std::vector<Fragment> frags_;
 
-    Block(uintptr_t base, size_t length) : base_ptr_(base), length_(length) {}
-    Block() = default;
+    Block(uintptr_t base, size_t length) : base_ptr_(base), length_(length) {
+      frags_.resize(length / Granule);
+      for (auto& frag : frags_) frag.block_ = this;
+    }
   };
 
+  // Sizes below kLinear granules have a bin each, above that each power of two is split
+  // into kSub bins.
+  static const uint32_t kSubLog2 = 3;
+  static const uint32_t kSub = 1 << kSubLog2;
+  static const uint32_t kLinearLog2 = kSubLog2 + 1;
+  static const uint32_t kLinear = 1 << kLinearLog2;
+  static const uint32_t kBins = kLinear + (32 - kLinearLog2) * kSub;
+  static const uint32_t kMapWords = (kBins + 63) / 64;
+
   Allocator block_allocator_;
 
-  std::multimap<size_t, uintptr_t> free_list_;
-  std::map<uintptr_t, std::map<uintptr_t, Fragment_T>> block_list_;
-  std::deque<Block> block_cache_;
+  Fragment* bins_[kBins];
+  uint64_t bin_map_[kMapWords];
+
+  std::map<uintptr_t, std::unique_ptr<Block>> block_list_;
+  std::deque<std::unique_ptr<Block>> block_cache_;
 
   size_t in_use_size_;
   size_t cache_size_;
+  size_t free_size_;
+
+  // Block cache retention, see set_cache_policy.
+  size_t cache_ratio_;
+  size_t cache_min_blocks_;
+  size_t cache_max_bytes_;
+
+  static uint32_t floorLog2(uint64_t x) { return 63 - __builtin_clzll(x); }
+
+  static uint32_t binOf(uint64_t granules) {
+    if (granules < kLinear) return uint32_t(granules);
+    uint32_t fl = floorLog2(granules);
+    return kLinear + (fl - kLinearLog2) * kSub + uint32_t(granules >> (fl - kSubLog2)) - kSub;
+  }
+
+  /// Lowest bin all of whose fragments hold at least @p granules.
+  static uint32_t fitBinOf(uint64_t granules) {
+    if (granules < kLinear) return uint32_t(granules);
+    granules += (uint64_t(1) << (floorLog2(granules) - kSubLog2)) - 1;
+    return binOf(granules);
+  }
+
+  static uintptr_t addressOf(const Fragment* frag) {
+    return frag->block_->base_ptr_ + (frag - frag->block_->frags_.data()) * Granule;
+  }
 
-  __forceinline bool isFree(const Fragment_T& node) {
-    return node.free_list_entry_ != free_list_.end();
+  static uint32_t indexOf(const Fragment* frag) {
+    return uint32_t(frag - frag->block_->frags_.data());
   }
-  __forceinline void setUsed(Fragment_T& node) { node.free_list_entry_ = free_list_.end(); }
-  __forceinline void setFree(Fragment_T& node, typename Fragment_T::ptr_t Iterator) {
-    node.free_list_entry_ = Iterator;
+
+  void insertFree(Fragment* frag) {
+    Block* block = frag->block_;
+    uint32_t index = indexOf(frag);
+    frag->free_ = true;
+    block->frags_[index + frag->granules_ - 1].head_ = index;
+
+    uint32_t bin = binOf(frag->granules_);
+    frag->prev_ = nullptr;
+    frag->next_ = bins_[bin];
+    if (frag->next_ != nullptr) frag->next_->prev_ = frag;
+    bins_[bin] = frag;
+    bin_map_[bin / 64] |= uint64_t(1) << (bin % 64);
+    free_size_ += size_t(frag->granules_) * Granule;
+  }
+
+  void removeFree(Fragment* frag) {
+    uint32_t bin = binOf(frag->granules_);
+    if (frag->prev_ != nullptr)
+      frag->prev_->next_ = frag->next_;
+    else
+      bins_[bin] = frag->next_;
+    if (frag->next_ != nullptr) frag->next_->prev_ = frag->prev_;
+    if (bins_[bin] == nullptr) bin_map_[bin / 64] &= ~(uint64_t(1) << (bin % 64));
+    frag->free_ = false;
+    free_size_ -= size_t(frag->granules_) * Granule;
+  }
+
+  /// First non-empty bin at or above @p bin, kBins if none.
+  uint32_t findBin(uint32_t bin) const {
+    uint32_t word = bin / 64;
+    if (word >= kMapWords) return kBins;
+    uint64_t bits = bin_map_[word] & (~uint64_t(0) << (bin % 64));
+    while (bits == 0) {
+      if (++word == kMapWords) return kBins;
+      bits = bin_map_[word];
+    }
+    return word * 64 + __builtin_ctzll(bits);
+  }
+
+  /// Sub-allocates @p granules from the start of free fragment @p frag.
+  void* carve(Fragment* frag, uint32_t granules) {
+    removeFree(frag);
+    uint32_t remainder = frag->granules_ - granules;
+    frag->granules_ = granules;
+    if (remainder != 0) {
+      Fragment* rest = frag + granules;
+      rest->granules_ = remainder;
+      insertFree(rest);
+    }
+    return reinterpret_cast<void*>(addressOf(frag));
   }
-  __forceinline Fragment_T makeFragment(size_t Len) { return Fragment_T(free_list_.end(), Len); }
-  __forceinline Fragment_T makeFragment(typename Fragment_T::ptr_t Iterator, size_t Len) {
-    return Fragment_T(Iterator, Len);
+
+  void releaseCache() {
+    while (!block_cache_.empty() &&
+           (cache_size_ > cache_max_bytes_ ||
+            (block_cache_.size() > cache_min_blocks_ &&
+             cache_size_ > in_use_size_ * cache_ratio_))) {
+      const auto& block = block_cache_.front();
+      block_allocator_.free(reinterpret_cast<void*>(block->base_ptr_), block->length_);
+      cache_size_ -= block->length_;
+      block_cache_.pop_front();
+    }
   }
 
  public:
   explicit SimpleHeap(const Allocator& BlockAllocator = Allocator())
-      : block_allocator_(BlockAllocator), in_use_size_(0), cache_size_(0) {}
+      : block_allocator_(BlockAllocator),
+        in_use_size_(0),
+        cache_size_(0),
+        free_size_(0),
+        cache_ratio_(2),
+        cache_min_blocks_(1),
+        cache_max_bytes_(SIZE_MAX) {
+    for (auto& bin : bins_) bin = nullptr;
+    for (auto& word : bin_map_) word = 0;
+  }
   ~SimpleHeap() {
     trim();
     // Leak here may be due to the user.  Check is for debugging only.
@@ -114,62 +229,43 @@ template <typename Allocator> class SimpleHeap {
       return nullptr;
     }
 
-    // Find best fit.
-    auto free_fragment = free_list_.lower_bound(bytes);
-    uintptr_t base;
-    size_t size;
-
-    if (free_fragment != free_list_.end()) {
-      base = free_fragment->second;
-      size = free_fragment->first;
-      free_list_.erase(free_fragment);
-
-      assert(size >= bytes && "SimpleHeap: map lower_bound failure.");
-
-      // Find the containing block and fragment
-      auto it = block_list_.upper_bound(base);
-      it--;
-      auto& frag_map = it->second;
-      const auto& fragment = frag_map.find(base);
-
-      assert(fragment != frag_map.end() && "Inconsistency in SimpleHeap.");
-      assert(size == fragment->second.size && "Inconsistency in SimpleHeap.");
-
-      // Sub-allocate from fragment.
-      fragment->second.size = bytes;
-      setUsed(fragment->second);
-      // Record remaining free space.
-      if (size > bytes) {
-        free_fragment = free_list_.insert(std::make_pair(size - bytes, base + bytes));
-        frag_map[base + bytes] = makeFragment(free_fragment, size - bytes);
-      }
-      return reinterpret_cast<void*>(base);
-    }
+    uint32_t granules = uint32_t(Max(AlignUp(bytes, Granule) / Granule, size_t(1)));
+
+    // Take the head of the first bin guaranteed to fit.
+    uint32_t bin = findBin(fitBinOf(granules));
+    if (bin != kBins) return carve(bins_[bin], granules);
+
+    // Only the bin of the request itself may have fragments that are just large enough.
+    for (Fragment* frag = bins_[binOf(granules)]; frag != nullptr; frag = frag->next_)
+      if (frag->granules_ >= granules) return carve(frag, granules);
 
     // No usable fragment, check block cache
+    std::unique_ptr<Block> block;
     if (!block_cache_.empty()) {
-      const auto& block = block_cache_.back();
-      base = block.base_ptr_;
-      size = block.length_;
+      block = std::move(block_cache_.back());
       block_cache_.pop_back();
-      cache_size_ -= size;
+      cache_size_ -= block->length_;
     } else {  // Alloc new block
+      size_t size;
       void* ptr = block_allocator_.alloc(bytes, size);
-      base = reinterpret_cast<uintptr_t>(ptr);
       assert(ptr != nullptr && "Block allocation failed, Allocator is expected to throw.");
+      assert((reinterpret_cast<uintptr_t>(ptr) % Granule == 0) && (size % Granule == 0) &&
+             "Block is not granule aligned.");
+      try {
+        block.reset(new Block(reinterpret_cast<uintptr_t>(ptr), size));
+      } catch (...) {
+        block_allocator_.free(ptr, size);
+        throw;
+      }
     }
 
-    in_use_size_ += size;
-    assert(size >= bytes && "Alloc exceeds block size.");
-    // Sub alloc and insert free region.
-    if (size > bytes) {
-      free_fragment = free_list_.insert(std::make_pair(size - bytes, base + bytes));
-      block_list_[base][base + bytes] = makeFragment(free_fragment, size - bytes);
-    }
-    // Track used region
-    block_list_[base][base] = makeFragment(bytes);
-
-    return reinterpret_cast<void*>(base);
+    assert(block->length_ >= size_t(granules) * Granule && "Alloc exceeds block size.");
+    in_use_size_ += block->length_;
+    Fragment* frag = &block->frags_[0];
+    frag->granules_ = uint32_t(block->frags_.size());
+    insertFree(frag);
+    block_list_[block->base_ptr_] = std::move(block);
+    return carve(frag, granules);
   }
 
   bool free(void* ptr) {
@@ -178,71 +274,107 @@ template <typename Allocator> class SimpleHeap {
     uintptr_t base = reinterpret_cast<uintptr_t>(ptr);
 
     // Find fragment and validate.
-    auto frag_map_it = block_list_.upper_bound(base);
-    if (frag_map_it == block_list_.begin()) return false;
-    frag_map_it--;
-    auto& frag_map = frag_map_it->second;
-    auto fragment = frag_map.find(base);
-    if (fragment == frag_map.end() || isFree(fragment->second)) return false;
+    auto block_it = block_list_.upper_bound(base);
+    if (block_it == block_list_.begin()) return false;
+    block_it--;
+    Block* block = block_it->second.get();
+    size_t offset = base - block->base_ptr_;
+    if (offset >= block->length_ || offset % Granule != 0) return false;
+    uint32_t index = uint32_t(offset / Granule);
+    Fragment* frag = &block->frags_[index];
+    if (frag->granules_ == 0 || frag->free_) return false;
 
     // Merge lower
-    if (fragment != frag_map.begin()) {
-      auto lower = fragment;
-      lower--;
-      if (isFree(lower->second)) {
-        free_list_.erase(lower->second.free_list_entry_);
-        lower->second.size += fragment->second.size;
-        frag_map.erase(fragment);
-        fragment = lower;
+    if (index != 0) {
+      uint32_t head = block->frags_[index - 1].head_;
+      Fragment* lower = &block->frags_[head];
+      if (head < index && lower->free_ && lower->granules_ != 0 &&
+          head + lower->granules_ == index) {
+        removeFree(lower);
+        lower->granules_ += frag->granules_;
+        frag->granules_ = 0;
+        frag = lower;
+        index = head;
       }
     }
 
     // Merge upper
     {
-      auto upper = fragment;
-      upper++;
-      if ((upper != frag_map.end()) && isFree(upper->second)) {
-        free_list_.erase(upper->second.free_list_entry_);
-        fragment->second.size += upper->second.size;
-        frag_map.erase(upper);
+      uint32_t next = index + frag->granules_;
+      if (next < block->frags_.size()) {
+        Fragment* upper = &block->frags_[next];
+        if (upper->free_) {
+          removeFree(upper);
+          frag->granules_ += upper->granules_;
+          upper->granules_ = 0;
+        }
       }
     }
 
     // Move whole free blocks to block cache
-    if (frag_map.size() == 1) {
-      in_use_size_ -= fragment->second.size;
-      cache_size_ += fragment->second.size;
-      block_cache_.push_back(Block(fragment->first, fragment->second.size));
-      block_list_.erase(frag_map_it);
+    if (frag->granules_ == block->frags_.size()) {
+      frag->granules_ = 0;
+      in_use_size_ -= block->length_;
+      cache_size_ += block->length_;
+      block_cache_.push_back(std::move(block_it->second));
+      block_list_.erase(block_it);
 
       // Release old blocks when over cache limit.
-      while ((block_cache_.size() > 1) && (cache_size_ > in_use_size_ * 2)) {
-        const auto& block = block_cache_.front();
-        block_allocator_.free(reinterpret_cast<void*>(block.base_ptr_), block.length_);
-        cache_size_ -= block.length_;
-        block_cache_.pop_front();
-      }
+      releaseCache();
 
       // Don't publish free space since block was moved to the cache.
       return true;
     }
 
     // Report free fragment
-    const auto& freeEntry =
-        free_list_.insert(std::make_pair(fragment->second.size, fragment->first));
-    setFree(fragment->second, freeEntry);
-
+    insertFree(frag);
     return true;
   }
 
   void trim() {
     for (const auto& block : block_cache_)
-      block_allocator_.free(reinterpret_cast<void*>(block.base_ptr_), block.length_);
+      block_allocator_.free(reinterpret_cast<void*>(block->base_ptr_), block->length_);
     block_cache_.clear();
     cache_size_ = 0;
   }
 
+  /// Sets how many whole free blocks are kept for reuse.  The oldest cached blocks are
+  /// released while the cache holds more than @p max_bytes, or while it holds more than
+  /// @p min_blocks blocks and more than @p ratio times block_size() bytes.  Defaults to
+  /// (2, 1, SIZE_MAX).
+  void set_cache_policy(size_t ratio, size_t min_blocks, size_t max_bytes) {
+    cache_ratio_ = ratio;
+    cache_min_blocks_ = min_blocks;
+    cache_max_bytes_ = max_bytes;
+    releaseCache();
+  }
+
   size_t max_alloc() const { return block_allocator_.block_size(); }
+
+  /// Bytes of blocks holding fragments, free or not.
+  size_t block_size() const { return in_use_size_; }
+
+  /// Bytes of whole free blocks kept for reuse.
+  size_t cache_size() const { return cache_size_; }
+
+  /// Free bytes within block_size().
+  size_t free_size() const { return free_size_; }
+
+  size_t largest_free() const {
+    if (!block_cache_.empty()) return max_alloc();
+    uint32_t top = kBins;
+    for (uint32_t word = kMapWords; word-- != 0;) {
+      if (bin_map_[word] != 0) {
+        top = word * 64 + floorLog2(bin_map_[word]);
+        break;
+      }
+    }
+    if (top == kBins) return 0;
+    uint32_t ret = 0;
+    for (const Fragment* frag = bins_[top]; frag != nullptr; frag = frag->next_)
+      ret = Max(ret, frag->granules_);
+    return size_t(ret) * Granule;
+  }
 };
 
 #endif  // HSA_RUNTME_CORE_UTIL_SIMPLE_HEAP_H_
@@ -0,0 +1,133 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+// 
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+// 
+// Developed by:
+// 
+//                 AMD Research and AMD HSA Software Development
+// 
+//                 Advanced Micro Devices, Inc.
+// 
+//                 www.amd.com
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+// 
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "core/util/stream_copy.h"
+
+#include "core/util/utils.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#define STREAM_COPY_SSE2 1
+#endif
+
+namespace stream {
+
+#if defined(STREAM_COPY_SSE2)
+
+// SSE2 is part of the x86-64 baseline, so no dispatch is needed.  Wider stores
+// don't help here: write-combined memory drains one 64 byte line at a time.
+
+void Copy(void* dst, const void* src, size_t size) {
+  uint8_t* d = reinterpret_cast<uint8_t*>(dst);
+  const uint8_t* s = reinterpret_cast<const uint8_t*>(src);
+
+  // Align the destination, streaming stores must be 16 byte aligned.
+  const size_t head = std::min(size, size_t(AlignUp(uintptr_t(d), 16) - uintptr_t(d)));
+  memcpy(d, s, head);
+  d += head;
+  s += head;
+  size -= head;
+
+  while (size >= 64) {
+    __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+    __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 16));
+    __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 32));
+    __m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 48));
+    _mm_stream_si128(reinterpret_cast<__m128i*>(d), r0);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(d + 16), r1);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(d + 32), r2);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(d + 48), r3);
+    d += 64;
+    s += 64;
+    size -= 64;
+  }
+  while (size >= 16) {
+    _mm_stream_si128(reinterpret_cast<__m128i*>(d),
+                     _mm_loadu_si128(reinterpret_cast<const __m128i*>(s)));
+    d += 16;
+    s += 16;
+    size -= 16;
+  }
+  memcpy(d, s, size);
+
+  // Order the streaming stores before whatever publishes the data.
+  _mm_sfence();
+}
+
+void Fill(void* dst, uint32_t value, size_t count) {
+  uint32_t* d = reinterpret_cast<uint32_t*>(dst);
+
+  while (count != 0 && !IsMultipleOf(d, 16)) {
+    *d++ = value;
+    count--;
+  }
+
+  const __m128i v = _mm_set1_epi32(int(value));
+  while (count >= 16) {
+    _mm_stream_si128(reinterpret_cast<__m128i*>(d), v);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(d + 4), v);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(d + 8), v);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(d + 12), v);
+    d += 16;
+    count -= 16;
+  }
+  while (count >= 4) {
+    _mm_stream_si128(reinterpret_cast<__m128i*>(d), v);
+    d += 4;
+    count -= 4;
+  }
+  std::fill_n(d, count, value);
+
+  _mm_sfence();
+}
+
+#else
+
+void Copy(void* dst, const void* src, size_t size) { memcpy(dst, src, size); }
+
+void Fill(void* dst, uint32_t value, size_t count) {
+  std::fill_n(reinterpret_cast<uint32_t*>(dst), count, value);
+}
+
+#endif
+
+}  // namespace stream
@@ -0,0 +1,86 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+// 
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+// 
+// Developed by:
+// 
+//                 AMD Research and AMD HSA Software Development
+// 
+//                 Advanced Micro Devices, Inc.
+// 
+//                 www.amd.com
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+// 
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Host copies and fills with non-temporal stores.
+
+#ifndef HSA_RUNTIME_CORE_UTIL_STREAM_COPY_H_
+#define HSA_RUNTIME_CORE_UTIL_STREAM_COPY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace stream {
+
+// Copies and fills from this size bypass the caches.  Smaller ones are left to
+// libc, the destination is likely to be read again soon.
+static const size_t kThreshold = 256 * 1024;
+
+/// @brief Copy with non-temporal stores.  Intended for destinations mapped
+/// write-combined or uncached, and copies much larger than the caches.
+void Copy(void* dst, const void* src, size_t size);
+
+/// @brief Set @p count dwords at @p dst to @p value with non-temporal
+/// stores.  @p dst must be dword aligned.
+void Fill(void* dst, uint32_t value, size_t count);
+
+/// @brief Copy between host memory, streaming copies from kThreshold.
+inline void HostCopy(void* dst, const void* src, size_t size) {
+  if (size >= kThreshold)
+    Copy(dst, src, size);
+  else
+    memcpy(dst, src, size);
+}
+
+/// @brief Set dwords of host memory, streaming fills from kThreshold.
+inline void HostFill(void* dst, uint32_t value, size_t count) {
+  if (count * sizeof(uint32_t) >= kThreshold)
+    Fill(dst, value, count);
+  else
+    std::fill_n(reinterpret_cast<uint32_t*>(dst), count, value);
+}
+
+}  // namespace stream
+
+#endif  // HSA_RUNTIME_CORE_UTIL_STREAM_COPY_H_
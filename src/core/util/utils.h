@@ -305,6 +305,13 @@ static __forceinline uint64_t NextPow2(uint64_t value) {
   return v + 1;
 }
 
+/// @brief Hints the processor that the caller is spinning.
+static __forceinline void CpuRelax() {
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+  _mm_pause();
+#endif
+}
+
 static __forceinline bool strIsEmpty(const char* str) noexcept { return str[0] == '\0'; }
 
 #include "atomic_helpers.h"
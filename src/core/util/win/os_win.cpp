@@ -82,6 +82,21 @@ void* GetExportAddress(LibHandle lib, std::string export_name) {
 
 void CloseLib(LibHandle lib) { FreeLibrary(*(::HMODULE*)&lib); }
 
+bool GetLibIdentity(LibHandle lib, std::string& identity) {
+  char path[MAX_PATH];
+  const DWORD len = GetModuleFileNameA(*(HMODULE*)&lib, path, MAX_PATH);
+  if (len == 0 || len == MAX_PATH) return false;
+
+  WIN32_FILE_ATTRIBUTE_DATA info;
+  if (!GetFileAttributesExA(path, GetFileExInfoStandard, &info)) return false;
+
+  identity = path;
+  identity += ":" + std::to_string(uint64_t(info.nFileSizeHigh) << 32 | info.nFileSizeLow) +
+      ":" + std::to_string(uint64_t(info.ftLastWriteTime.dwHighDateTime) << 32 |
+                           info.ftLastWriteTime.dwLowDateTime);
+  return true;
+}
+
 Mutex CreateMutex() { return CreateEvent(NULL, false, true, NULL); }
 
 bool TryAcquireMutex(Mutex lock) {
@@ -96,12 +111,118 @@ void ReleaseMutex(Mutex lock) { SetEvent(*(::HANDLE*)&lock); }
 
 void DestroyMutex(Mutex lock) { CloseHandle(*(::HANDLE*)&lock); }
 
+SharedMutex CreateSharedMutex() {
+  ::SRWLOCK* lock = new ::SRWLOCK;
+  InitializeSRWLock(lock);
+  return lock;
+}
+
+bool AcquireSharedMutex(SharedMutex lock, bool shared) {
+  if (shared)
+    AcquireSRWLockShared((::SRWLOCK*)lock);
+  else
+    AcquireSRWLockExclusive((::SRWLOCK*)lock);
+  return true;
+}
+
+void ReleaseSharedMutex(SharedMutex lock, bool shared) {
+  if (shared)
+    ReleaseSRWLockShared((::SRWLOCK*)lock);
+  else
+    ReleaseSRWLockExclusive((::SRWLOCK*)lock);
+}
+
+void DestroySharedMutex(SharedMutex lock) { delete (::SRWLOCK*)lock; }
+
 void Sleep(int delay_in_millisecond) { ::Sleep(delay_in_millisecond); }
 
 void uSleep(int delayInUs) { ::Sleep(delayInUs / 1000); }
 
 void YieldThread() { ::Sleep(0); }
 
+bool SetThreadAffinity(uint32_t first_cpu, uint32_t num_cpus) {
+  DWORD_PTR mask = 0;
+  for (uint32_t i = first_cpu; (i < first_cpu + num_cpus) && (i < sizeof(mask) * 8); i++)
+    mask |= DWORD_PTR(1) << i;
+  return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+}
+
+bool SetThreadAffinityList(const uint32_t* cpus, uint32_t num_cpus) {
+  DWORD_PTR mask = 0;
+  for (uint32_t i = 0; i < num_cpus; i++)
+    if (cpus[i] < sizeof(mask) * 8) mask |= DWORD_PTR(1) << cpus[i];
+  if (mask == 0) return false;
+  return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+}
+
+bool GetThreadAffinityList(std::vector<uint32_t>& cpus) {
+  // There is no getter, setting a mask returns the previous one, which is put back.
+  DWORD_PTR process_mask;
+  DWORD_PTR system_mask;
+  if (!GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask)) return false;
+  const DWORD_PTR mask = SetThreadAffinityMask(GetCurrentThread(), process_mask);
+  if (mask == 0) return false;
+  SetThreadAffinityMask(GetCurrentThread(), mask);
+  cpus.clear();
+  for (uint32_t i = 0; i < sizeof(mask) * 8; i++)
+    if ((mask & (DWORD_PTR(1) << i)) != 0) cpus.push_back(i);
+  return !cpus.empty();
+}
+
+uint32_t MaxAffinityCpus() { return uint32_t(sizeof(DWORD_PTR) * 8); }
+
+bool GetThreadScheduling(ThreadSched& sched, int& priority) {
+  const int level = GetThreadPriority(GetCurrentThread());
+  if (level == THREAD_PRIORITY_ERROR_RETURN) return false;
+  priority = 0;
+  if (level == THREAD_PRIORITY_IDLE) {
+    sched = kSchedIdle;
+  } else if (level == THREAD_PRIORITY_TIME_CRITICAL) {
+    sched = kSchedFifo;
+  } else {
+    sched = kSchedNormal;
+    priority = -level * 8;
+  }
+  return true;
+}
+
+bool SetThreadScheduling(ThreadSched sched, int priority) {
+  // Only priorities are available, nice values map to the five priority levels.
+  int level;
+  switch (sched) {
+    case kSchedIdle:
+      level = THREAD_PRIORITY_IDLE;
+      break;
+    case kSchedFifo:
+    case kSchedRoundRobin:
+      level = THREAD_PRIORITY_TIME_CRITICAL;
+      break;
+    default:
+      level = std::max(THREAD_PRIORITY_LOWEST, std::min(THREAD_PRIORITY_HIGHEST, -priority / 8));
+      break;
+  }
+  return SetThreadPriority(GetCurrentThread(), level) != 0;
+}
+
+void WaitOnAddress(volatile uint32_t* addr, uint32_t value, uint32_t timeout_ms) {
+  ::WaitOnAddress(addr, &value, sizeof(value), timeout_ms);
+}
+
+void WaitOnAddressUs(volatile uint32_t* addr, uint32_t value, uint32_t timeout_us) {
+  ::WaitOnAddress(addr, &value, sizeof(value), (timeout_us + 999) / 1000);
+}
+
+void WakeAllOnAddress(volatile uint32_t* addr) { ::WakeByAddressAll((PVOID)addr); }
+
+// WaitOnAddress does not cross processes.
+bool WaitOnSharedAddressUs(volatile uint32_t* addr, uint32_t value, uint32_t timeout_us) {
+  return false;
+}
+
+void WakeAllOnSharedAddress(volatile uint32_t* addr) {}
+
+void WakeOneOnAddress(volatile uint32_t* addr) { ::WakeByAddressSingle((PVOID)addr); }
+
 struct ThreadArgs {
   void* entry_args;
   ThreadEntry entry_function;
@@ -170,6 +291,65 @@ size_t GetUsablePhysicalHostMemorySize() {
   return std::min(GetUserModeVirtualMemorySize(), physical_size);
 }
 
+bool AdviseHugePages(void* ptr, size_t size) { return false; }
+
+bool GetCpuNumaNode(uint32_t cpu, uint32_t& node) { return false; }
+
+bool BindToNumaNode(void* ptr, size_t size, uint32_t node) { return false; }
+
+void PrefaultMemory(void* ptr, size_t size) {
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  volatile char* bytes = reinterpret_cast<volatile char*>(ptr);
+  for (size_t offset = 0; offset < size; offset += info.dwPageSize) bytes[offset] = bytes[offset];
+}
+
+void* MapFile(int fd, size_t size) { return NULL; }
+
+void UnmapFile(void* ptr, size_t size) {}
+
+bool GetFileId(int fd, uint64_t& device, uint64_t& inode) { return false; }
+
+size_t ReadFileAt(int fd, void* buffer, size_t size, uint64_t offset) { return 0; }
+
+size_t WriteFileAt(int fd, const void* buffer, size_t size, uint64_t offset) { return 0; }
+
+struct SharedSegmentDescriptor {
+  ::HANDLE mapping;
+  void* ptr;
+};
+
+SharedSegment CreateSharedSegment(const std::string& name, size_t size) {
+  const std::string path = "Local\\" + name;
+  ::HANDLE mapping =
+      CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, DWORD(uint64_t(size) >> 32),
+                         DWORD(size), path.c_str());
+  if (mapping == NULL) return NULL;
+  if (GetLastError() == ERROR_ALREADY_EXISTS) {
+    CloseHandle(mapping);
+    return NULL;
+  }
+  void* ptr = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+  if (ptr == NULL) {
+    CloseHandle(mapping);
+    return NULL;
+  }
+  return new SharedSegmentDescriptor{mapping, ptr};
+}
+
+void* SharedSegmentAddress(SharedSegment segment) {
+  return reinterpret_cast<SharedSegmentDescriptor*>(segment)->ptr;
+}
+
+void DestroySharedSegment(SharedSegment segment) {
+  SharedSegmentDescriptor* descriptor = reinterpret_cast<SharedSegmentDescriptor*>(segment);
+  UnmapViewOfFile(descriptor->ptr);
+  CloseHandle(descriptor->mapping);
+  delete descriptor;
+}
+
+uint32_t GetProcessId() { return uint32_t(GetCurrentProcessId()); }
+
 uintptr_t GetUserModeVirtualMemoryBase() { return (uintptr_t)0; }
 
 // Os event wrappers
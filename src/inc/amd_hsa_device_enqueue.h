@@ -0,0 +1,90 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2015, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Helpers for kernels submitting AQL packets to a queue created with
+// hsa_amd_queue_create_device_enqueue. Usable from host code as well, they
+// only rely on the amd_queue_t layout and the compiler's __atomic builtins.
+
+#ifndef AMD_HSA_DEVICE_ENQUEUE_H
+#define AMD_HSA_DEVICE_ENQUEUE_H
+
+#include "amd_hsa_common.h"
+#include "amd_hsa_queue.h"
+#include "amd_hsa_signal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Reserve @p count consecutive packet slots, waiting for the packet processor
+// to free them. Returns the packet id of the first slot.
+static __inline__ uint64_t amd_device_enqueue_reserve(amd_queue_t* queue, uint64_t count) {
+  uint64_t id = __atomic_fetch_add(&queue->write_dispatch_id, count, __ATOMIC_RELAXED);
+  while (id + count - __atomic_load_n(&queue->read_dispatch_id, __ATOMIC_ACQUIRE) >
+         queue->hsa_queue.size) {
+  }
+  return id;
+}
+
+// Address of the slot for packet @p id.
+static __inline__ void* amd_device_enqueue_slot(const amd_queue_t* queue, uint64_t id) {
+  return (char*)queue->hsa_queue.base_address + (id & (queue->hsa_queue.size - 1)) * 64;
+}
+
+// Hand a fully written packet over to the packet processor. @p header and
+// @p setup form the first dword of the packet and must be stored last.
+static __inline__ void amd_device_enqueue_publish(void* slot, uint16_t header, uint16_t setup) {
+  __atomic_store_n((uint32_t*)slot, (uint32_t)header | ((uint32_t)setup << 16),
+                   __ATOMIC_RELEASE);
+}
+
+// Notify the packet processor of packets up to and including @p id.
+static __inline__ void amd_device_enqueue_ring(amd_queue_t* queue, uint64_t id) {
+  amd_signal_t* doorbell = (amd_signal_t*)queue->hsa_queue.doorbell_signal.handle;
+  __atomic_store_n(doorbell->hardware_doorbell_ptr, id, __ATOMIC_RELEASE);
+}
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // AMD_HSA_DEVICE_ENQUEUE_H
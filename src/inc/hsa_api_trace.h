@@ -92,6 +92,19 @@ hsa_status_t hsa_amd_queue_intercept_create(
     void (*callback)(hsa_status_t status, hsa_queue_t* source, void* data), void* data,
     uint32_t private_segment_size, uint32_t group_segment_size, hsa_queue_t** queue);
 
+// Participation of a registered interceptor in packet processing.  Observing interceptors are
+// called with the packets as written by the application and their writes are discarded, which
+// lets queues without rewriting interceptors forward packets in batches.
+typedef enum {
+  HSA_AMD_QUEUE_INTERCEPT_MODE_REWRITE = 0,
+  HSA_AMD_QUEUE_INTERCEPT_MODE_OBSERVE = 1,
+  HSA_AMD_QUEUE_INTERCEPT_MODE_DISABLED = 2
+} hsa_amd_queue_intercept_mode_t;
+hsa_status_t hsa_amd_queue_intercept_set_mode(hsa_queue_t* queue,
+                                              hsa_amd_queue_intercept_handler callback,
+                                              void* user_data,
+                                              hsa_amd_queue_intercept_mode_t mode);
+
 typedef void (*hsa_amd_runtime_queue_notifier)(const hsa_queue_t* queue, hsa_agent_t agent,
                                                void* data);
 hsa_status_t hsa_amd_runtime_queue_create_register(hsa_amd_runtime_queue_notifier callback,
@@ -182,6 +195,51 @@ struct AmdExtTable {
   decltype(hsa_amd_memory_lock_to_pool)* hsa_amd_memory_lock_to_pool_fn;
   decltype(hsa_amd_register_deallocation_callback)* hsa_amd_register_deallocation_callback_fn;
   decltype(hsa_amd_deregister_deallocation_callback)* hsa_amd_deregister_deallocation_callback_fn;
+  decltype(hsa_amd_memory_async_copy_batch)* hsa_amd_memory_async_copy_batch_fn;
+  decltype(hsa_amd_signal_wait_stats)* hsa_amd_signal_wait_stats_fn;
+  decltype(hsa_amd_memory_pool_free_async)* hsa_amd_memory_pool_free_async_fn;
+  decltype(hsa_amd_memory_lock_cache_invalidate)* hsa_amd_memory_lock_cache_invalidate_fn;
+  decltype(hsa_amd_queue_submit)* hsa_amd_queue_submit_fn;
+  decltype(hsa_amd_queue_intercept_set_mode)* hsa_amd_queue_intercept_set_mode_fn;
+  decltype(hsa_amd_queue_set_agent_dispatch_handler)* hsa_amd_queue_set_agent_dispatch_handler_fn;
+  decltype(hsa_amd_queue_set_class)* hsa_amd_queue_set_class_fn;
+  decltype(hsa_amd_queue_get_progress_stats)* hsa_amd_queue_get_progress_stats_fn;
+  decltype(hsa_amd_profiling_convert_ticks_to_system_domain)* hsa_amd_profiling_convert_ticks_to_system_domain_fn;
+  decltype(hsa_amd_executable_load_agent_code_objects)* hsa_amd_executable_load_agent_code_objects_fn;
+  decltype(hsa_amd_executable_get_kernels)* hsa_amd_executable_get_kernels_fn;
+  decltype(hsa_amd_memory_async_fill)* hsa_amd_memory_async_fill_fn;
+  decltype(hsa_amd_memory_async_fill_rect)* hsa_amd_memory_async_fill_rect_fn;
+  decltype(hsa_amd_agent_get_memory_pools)* hsa_amd_agent_get_memory_pools_fn;
+  decltype(hsa_amd_memory_async_prefetch)* hsa_amd_memory_async_prefetch_fn;
+  decltype(hsa_amd_launch_template_create)* hsa_amd_launch_template_create_fn;
+  decltype(hsa_amd_launch_template_dispatch)* hsa_amd_launch_template_dispatch_fn;
+  decltype(hsa_amd_launch_template_destroy)* hsa_amd_launch_template_destroy_fn;
+  decltype(hsa_amd_queue_capture_begin)* hsa_amd_queue_capture_begin_fn;
+  decltype(hsa_amd_queue_capture_end)* hsa_amd_queue_capture_end_fn;
+  decltype(hsa_amd_graph_launch)* hsa_amd_graph_launch_fn;
+  decltype(hsa_amd_graph_destroy)* hsa_amd_graph_destroy_fn;
+  decltype(hsa_amd_queue_create_device_enqueue)* hsa_amd_queue_create_device_enqueue_fn;
+  decltype(hsa_amd_queue_fence)* hsa_amd_queue_fence_fn;
+  decltype(hsa_amd_agent_link_cost)* hsa_amd_agent_link_cost_fn;
+  decltype(hsa_amd_image_import_async)* hsa_amd_image_import_async_fn;
+  decltype(hsa_amd_image_export_async)* hsa_amd_image_export_async_fn;
+  decltype(hsa_amd_image_copy_async)* hsa_amd_image_copy_async_fn;
+  decltype(hsa_amd_image_clear_async)* hsa_amd_image_clear_async_fn;
+  decltype(hsa_amd_profile_pool_create)* hsa_amd_profile_pool_create_fn;
+  decltype(hsa_amd_profile_pool_acquire)* hsa_amd_profile_pool_acquire_fn;
+  decltype(hsa_amd_profile_pool_submit)* hsa_amd_profile_pool_submit_fn;
+  decltype(hsa_amd_profile_pool_flush)* hsa_amd_profile_pool_flush_fn;
+  decltype(hsa_amd_profile_pool_destroy)* hsa_amd_profile_pool_destroy_fn;
+  decltype(hsa_amd_agents_allow_access_batch)* hsa_amd_agents_allow_access_batch_fn;
+  decltype(hsa_amd_memory_tag_set)* hsa_amd_memory_tag_set_fn;
+  decltype(hsa_amd_memory_budget_set)* hsa_amd_memory_budget_set_fn;
+  decltype(hsa_amd_memory_usage_get)* hsa_amd_memory_usage_get_fn;
+  decltype(hsa_amd_signal_group_wait_n)* hsa_amd_signal_group_wait_n_fn;
+  decltype(hsa_amd_signal_group_wait_all)* hsa_amd_signal_group_wait_all_fn;
+  decltype(hsa_amd_memory_file_read_async)* hsa_amd_memory_file_read_async_fn;
+  decltype(hsa_amd_memory_file_write_async)* hsa_amd_memory_file_write_async_fn;
+  decltype(hsa_amd_memory_async_copy_multicast)* hsa_amd_memory_async_copy_multicast_fn;
+  decltype(hsa_amd_thread_policy_set)* hsa_amd_thread_policy_set_fn;
 };
 
 // Table to export HSA Core Runtime Apis
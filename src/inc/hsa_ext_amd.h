@@ -152,9 +152,60 @@ typedef enum hsa_amd_agent_info_s {
    * model and should be treated with caution.
    * The type of this attribute is hsa_amd_hdp_flush_t.
    */
-  HSA_AMD_AGENT_INFO_HDP_FLUSH = 0xA00E
+  HSA_AMD_AGENT_INFO_HDP_FLUSH = 0xA00E,
+  /**
+   * Fine grained system memory pool closest to the agent, with the smallest NUMA distance.
+   * The runtime places its own host memory for the agent, such as queue rings, kernel arguments
+   * and staging buffers, in this pool.
+   * The type of this attribute is hsa_amd_memory_pool_t.
+   */
+  HSA_AMD_AGENT_INFO_NEAREST_HOST_POOL = 0xA00F,
+  /**
+   * Counts of the asynchronous linear copies submitted by the agent, by direction and
+   * by the engine that performed them.
+   * The type of this attribute is hsa_amd_agent_blit_stats_t.
+   */
+  HSA_AMD_AGENT_INFO_BLIT_STATS = 0xA010
 } hsa_amd_agent_info_t;
 
+/**
+ * @brief Use of one copy engine type for one direction.
+ */
+typedef struct hsa_amd_blit_engine_stats_s {
+  /**
+  * Copies submitted to SDMA engines.
+  */
+  uint64_t sdma_copies;
+  /**
+  * Bytes copied by SDMA engines.
+  */
+  uint64_t sdma_bytes;
+  /**
+  * Copies submitted as compute kernels.
+  */
+  uint64_t kernel_copies;
+  /**
+  * Bytes copied by compute kernels.
+  */
+  uint64_t kernel_bytes;
+} hsa_amd_blit_engine_stats_t;
+
+/**
+ * @brief Asynchronous copy counters of an agent.
+ *
+ * @details Counts are totals since the runtime was initialized. When the
+ * environment variable HSA_BLIT_COST_MODEL is set to 1 the engine of each
+ * host to device and device to host copy is chosen from its size, alignment
+ * and the backlog of the engines, these counters report the outcome.
+ * Copies between two devices, including peer copies, are counted as
+ * device_to_device.
+ */
+typedef struct hsa_amd_agent_blit_stats_s {
+  hsa_amd_blit_engine_stats_t host_to_device;
+  hsa_amd_blit_engine_stats_t device_to_host;
+  hsa_amd_blit_engine_stats_t device_to_device;
+} hsa_amd_agent_blit_stats_t;
+
 typedef struct hsa_amd_hdp_flush_s {
   uint32_t* HDP_MEM_FLUSH_CNTL;
   uint32_t* HDP_REG_FLUSH_CNTL;
@@ -397,6 +448,37 @@ hsa_status_t HSA_API
                                                     uint64_t agent_tick,
                                                     uint64_t* system_tick);
 
+/**
+ * @brief Converts an array of the agent's ticks to HSA system domain ticks.
+ *
+ * @details Equivalent to calling
+ * ::hsa_amd_profiling_convert_tick_to_system_domain on each element, but the
+ * clock correlation is looked up once for the whole array.
+ *
+ * @param[in] agent The agent used to retrieve the agent ticks.
+ *
+ * @param[in] agent_ticks Array of @p count tick counts retrieved from @p agent.
+ *
+ * @param[out] system_ticks Array of @p count translated HSA system domain
+ * ticks. May be the same array as @p agent_ticks.
+ *
+ * @param[in] count Number of ticks to convert.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_AGENT The agent is invalid.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p agent_ticks or @p system_ticks
+ * is NULL and @p count is not 0.
+ */
+hsa_status_t HSA_API
+    hsa_amd_profiling_convert_ticks_to_system_domain(hsa_agent_t agent,
+                                                     const uint64_t* agent_ticks,
+                                                     uint64_t* system_ticks, size_t count);
+
 /**
  * @brief Signal attribute flags.
  */
@@ -412,8 +494,25 @@ typedef enum {
    * Profiling using an IPC enabled signal is only supported in a single process
    * at a time.  Producing profiling data in one process and consuming it in
    * another process is undefined.
+   * Blocked host waits sleep once their spin phase is over. Host updates of
+   * the value from any process wake them immediately, GPU updates are seen
+   * within at most a millisecond.
    */
   HSA_AMD_SIGNAL_IPC = 2,
+  /**
+   * Signal counts completed operations instead of being decremented by them.
+   * Every runtime operation given the signal as its completion signal, such as
+   * an async copy, fill or host task, adds one to the value when it finishes,
+   * so one signal can track a whole stream of work: with an initial value of 0,
+   * the work of the first N submissions is done once the value is at least N,
+   * which is waited for with ::HSA_SIGNAL_CONDITION_GTE.  Values only follow
+   * submission order for work that executes in order, e.g. operations chained
+   * through their dependencies or issued to a single engine.
+   * AQL packets decrement their completion signal as required by the HSA
+   * specification and must not use timeline signals.  Cannot be combined with
+   * ::HSA_AMD_SIGNAL_IPC.
+   */
+  HSA_AMD_SIGNAL_TIMELINE = 4,
 } hsa_amd_signal_attribute_t;
 
 /**
@@ -571,6 +670,122 @@ uint32_t HSA_API
                             hsa_wait_state_t wait_hint,
                             hsa_signal_value_t* satisfying_value);
 
+/**
+ * @brief Wait statistics of a signal.
+ */
+typedef struct hsa_amd_signal_wait_stats_s {
+  /**
+   * Number of completed waits on the signal.
+   */
+  uint64_t wait_count;
+  /**
+   * Total time waiters spent polling the signal, in nanoseconds.
+   */
+  uint64_t spin_time_ns;
+  /**
+   * Number of times a waiter went to sleep.
+   */
+  uint64_t sleep_count;
+  /**
+   * Total time waiters spent sleeping, in nanoseconds.
+   */
+  uint64_t sleep_time_ns;
+  /**
+   * Wait time the runtime currently expects, in nanoseconds.  Waits spin only
+   * when this is short.
+   */
+  uint64_t expected_wait_ns;
+} hsa_amd_signal_wait_stats_t;
+
+/**
+ * @brief Query the wait statistics of a signal.
+ *
+ * @details Waits on a signal first poll it and then sleep.  The polling time is
+ * sized from the wait times seen so far on the signal.  Waits on several
+ * signals are counted against the signal that satisfied them.
+ *
+ * @param[in] signal Signal to query.
+ *
+ * @param[out] stats Wait statistics of @p signal.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_SIGNAL @p signal is invalid.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p stats is NULL.
+ */
+hsa_status_t HSA_API hsa_amd_signal_wait_stats(hsa_signal_t signal,
+                                               hsa_amd_signal_wait_stats_t* stats);
+
+/**
+ * @brief Wait until a number of signals in a signal group satisfy a
+ * condition.
+ *
+ * @details Each signal counts once it has been observed satisfying @p
+ * condition during the wait. Signals are not required to satisfy it at the
+ * same time. When every signal not yet satisfied is needed, the caller sleeps
+ * on the last signal of the group and then checks the rest, so a group of
+ * completions that finish in group order, such as copies submitted to one
+ * engine, wakes the caller once rather than once per signal. The function
+ * provides acquire memory semantics.
+ *
+ * @param[in] signal_group Signal group.
+ *
+ * @param[in] num_required Number of signals that must satisfy @p condition,
+ * between 1 and the size of the group.
+ *
+ * @param[in] condition Condition applied to every signal.
+ *
+ * @param[in] compare_value Value compared with each signal value.
+ *
+ * @param[in] timeout_hint Maximum duration of the wait, in the same unit as
+ * the system timestamp.
+ *
+ * @param[in] wait_state_hint Hint used by the application to indicate the
+ * preferred waiting state.
+ *
+ * @param[out] num_satisfied Number of signals seen satisfying @p condition,
+ * less than @p num_required if the timeout elapsed.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_SIGNAL_GROUP @p signal_group is invalid.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_SIGNAL A signal of the group was
+ * destroyed before enough signals were satisfied. @p num_satisfied holds the
+ * count seen until then.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p num_required is 0 or larger
+ * than the group, @p condition is not a valid condition, or @p num_satisfied
+ * is NULL.
+ */
+hsa_status_t HSA_API hsa_amd_signal_group_wait_n(hsa_signal_group_t signal_group,
+                                                 uint32_t num_required,
+                                                 hsa_signal_condition_t condition,
+                                                 hsa_signal_value_t compare_value,
+                                                 uint64_t timeout_hint,
+                                                 hsa_wait_state_t wait_state_hint,
+                                                 uint32_t* num_satisfied);
+
+/**
+ * @brief Wait until every signal in a signal group satisfies a condition.
+ *
+ * @details Equivalent to ::hsa_amd_signal_group_wait_n with @p num_required
+ * set to the size of the group.
+ */
+hsa_status_t HSA_API hsa_amd_signal_group_wait_all(hsa_signal_group_t signal_group,
+                                                   hsa_signal_condition_t condition,
+                                                   hsa_signal_value_t compare_value,
+                                                   uint64_t timeout_hint,
+                                                   hsa_wait_state_t wait_state_hint,
+                                                   uint32_t* num_satisfied);
+
 /**
  * @brief Query image limits.
  *
@@ -624,184 +839,1312 @@ hsa_status_t HSA_API hsa_amd_queue_cu_set_mask(const hsa_queue_t* queue,
                                                const uint32_t* cu_mask);
 
 /**
- * @brief Memory segments associated with a memory pool.
+ * @brief Submit AQL packets to a queue and ring its doorbell once.
+ *
+ * @details Reserves @p count consecutive slots once the queue has room for all
+ * of them, copies the packets and publishes their headers in order, then
+ * notifies the packet processor with a single doorbell store.  Safe to call
+ * concurrently from several threads on a multi-producer queue, and mixes with
+ * producers using the hsa_queue_* index functions directly.  While the queue
+ * is full the call polls briefly and then sleeps, up to @p timeout_ns.
+ *
+ * @param[in] queue Queue to submit to.  Hardware queues and queues created by
+ * ::hsa_amd_queue_intercept_create are supported.
+ *
+ * @param[in] packets Array of @p count 64 byte AQL packets, including complete
+ * headers.
+ *
+ * @param[in] count Number of packets, at most the queue size.
+ *
+ * @param[in] timeout_ns Maximum time to wait for queue space in nanoseconds.
+ * UINT64_MAX waits indefinitely.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The packets have been submitted.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_QUEUE @p queue is NULL or invalid.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p packets is NULL or @p count
+ * exceeds the queue size.
+ *
+ * @retval ::HSA_STATUS_ERROR_OUT_OF_RESOURCES The queue did not have room for
+ * the packets within @p timeout_ns.  No packet was written.
  */
-typedef enum {
-  /**
-   * Global segment. Used to hold data that is shared by all agents.
-   */
-  HSA_AMD_SEGMENT_GLOBAL = 0,
-  /**
-   * Read-only segment. Used to hold data that remains constant during the
-   * execution of a kernel.
-   */
-  HSA_AMD_SEGMENT_READONLY = 1,
-  /**
-   * Private segment. Used to hold data that is local to a single work-item.
-   */
-  HSA_AMD_SEGMENT_PRIVATE = 2,
-  /**
-   * Group segment. Used to hold data that is shared by the work-items of a
-   * work-group.
-   */
-  HSA_AMD_SEGMENT_GROUP = 3,
-} hsa_amd_segment_t;
+hsa_status_t HSA_API hsa_amd_queue_submit(hsa_queue_t* queue, const void* packets,
+                                          uint32_t count, uint64_t timeout_ns);
 
 /**
- * @brief A memory pool represents physical storage on an agent.
+ * @brief Pre-encoded kernel dispatch to one queue.
  */
-typedef struct hsa_amd_memory_pool_s {
+typedef struct hsa_amd_launch_template_s {
   /**
-   * Opaque handle.
+   * Opaque handle. Two handles reference the same object of the enclosing type
+   * if and only if they are equal.
    */
   uint64_t handle;
-} hsa_amd_memory_pool_t;
-
-typedef enum hsa_amd_memory_pool_global_flag_s {
-  /**
-   * The application can use allocations in the memory pool to store kernel
-   * arguments, and provide the values for the kernarg segment of
-   * a kernel dispatch.
-   */
-  HSA_AMD_MEMORY_POOL_GLOBAL_FLAG_KERNARG_INIT = 1,
-  /**
-   * Updates to memory in this pool conform to HSA memory consistency model.
-   * If this flag is set, then ::HSA_AMD_MEMORY_POOL_GLOBAL_FLAG_COARSE_GRAINED
-   * must not be set.
-   */
-  HSA_AMD_MEMORY_POOL_GLOBAL_FLAG_FINE_GRAINED = 2,
-  /**
-   * Writes to memory in this pool can be performed by a single agent at a time.
-   */
-  HSA_AMD_MEMORY_POOL_GLOBAL_FLAG_COARSE_GRAINED = 4
-} hsa_amd_memory_pool_global_flag_t;
-
-/**
- * @brief Memory pool features.
- */
-typedef enum {
-  /**
-  * Segment where the memory pool resides. The type of this attribute is
-  * ::hsa_amd_segment_t.
-  */
-  HSA_AMD_MEMORY_POOL_INFO_SEGMENT = 0,
-  /**
-  * Flag mask. The value of this attribute is undefined if the value of
-  * ::HSA_AMD_MEMORY_POOL_INFO_SEGMENT is not ::HSA_AMD_SEGMENT_GLOBAL. The type
-  * of
-  * this attribute is uint32_t, a bit-field of
-  * ::hsa_amd_memory_pool_global_flag_t
-  * values.
-  */
-  HSA_AMD_MEMORY_POOL_INFO_GLOBAL_FLAGS = 1,
-  /**
-  * Size of this pool, in bytes. The type of this attribute is size_t.
-  */
-  HSA_AMD_MEMORY_POOL_INFO_SIZE = 2,
-  /**
-  * Indicates whether memory in this pool can be allocated using
-  * ::hsa_amd_memory_pool_allocate. The type of this attribute is bool.
-  *
-  * The value of this flag is always false for memory pools in the group and
-  * private segments.
-  */
-  HSA_AMD_MEMORY_POOL_INFO_RUNTIME_ALLOC_ALLOWED = 5,
-  /**
-  * Allocation granularity of buffers allocated by
-  * ::hsa_amd_memory_pool_allocate
-  * in this memory pool. The size of a buffer allocated in this pool is a
-  * multiple of the value of this attribute. The value of this attribute is
-  * only defined if ::HSA_AMD_MEMORY_POOL_INFO_RUNTIME_ALLOC_ALLOWED is true for
-  * this pool. The type of this attribute is size_t.
-  */
-  HSA_AMD_MEMORY_POOL_INFO_RUNTIME_ALLOC_GRANULE = 6,
-  /**
-  * Alignment of buffers allocated by ::hsa_amd_memory_pool_allocate in this
-  * pool. The value of this attribute is only defined if
-  * ::HSA_AMD_MEMORY_POOL_INFO_RUNTIME_ALLOC_ALLOWED is true for this pool, and
-  * must be a power of 2. The type of this attribute is size_t.
-  */
-  HSA_AMD_MEMORY_POOL_INFO_RUNTIME_ALLOC_ALIGNMENT = 7,
-  /**
-  * This memory_pool can be made directly accessible by all the agents in the
-  * system (::hsa_amd_agent_memory_pool_get_info does not return 
-  * ::HSA_AMD_MEMORY_POOL_ACCESS_NEVER_ALLOWED for any agent). The type of this
-  * attribute is bool.
-  */
-  HSA_AMD_MEMORY_POOL_INFO_ACCESSIBLE_BY_ALL = 15,
-} hsa_amd_memory_pool_info_t;
+} hsa_amd_launch_template_t;
 
 /**
- * @brief Get the current value of an attribute of a memory pool.
+ * @brief Capture a kernel dispatch for repeated launches to a queue.
  *
- * @param[in] memory_pool A valid memory pool.
+ * @details The dispatch packet is encoded once from @p kernel and @p dispatch,
+ * and kernel argument memory for twice the queue depth is allocated with it.
+ * Each ::hsa_amd_launch_template_dispatch then only copies the packet and the
+ * kernel arguments and publishes the header, without taking locks or
+ * allocating memory.
  *
- * @param[in] attribute Attribute to query.
+ * The kernel arguments of a launch are overwritten by the launch a whole queue
+ * length of packets later on the same template.  A launch must therefore
+ * complete before the packet processor has consumed the next queue size
+ * packets, which holds unless that many later packets run concurrently with
+ * it.
  *
- * @param[out] value Pointer to a application-allocated buffer where to store
- * the value of the attribute. If the buffer passed by the application is not
- * large enough to hold the value of @p attribute, the behavior is undefined.
+ * @param[in] queue Queue the template dispatches to, with an agent able to run
+ * @p kernel.  The template must be destroyed before the queue.
  *
- * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ * @param[in] kernel Kernel symbol of a frozen executable.
+ *
+ * @param[in] dispatch Packet supplying the header, setup, workgroup and grid
+ * sizes of every launch.  The header type must be
+ * HSA_PACKET_TYPE_KERNEL_DISPATCH.  The kernel object is taken from @p kernel,
+ * group and private segment sizes are raised to those of @p kernel, and kernel
+ * argument address and completion signal are ignored.
+ *
+ * @param[out] launch Created template.
  *
+ * @retval ::HSA_STATUS_SUCCESS The template has been created.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_QUEUE @p queue is NULL or invalid.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_EXECUTABLE_SYMBOL @p kernel is not a
+ * kernel symbol.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_PACKET_FORMAT @p dispatch is not a kernel
+ * dispatch packet.
+ *
+ * @retval ::HSA_STATUS_ERROR_OUT_OF_RESOURCES Kernel argument memory could not
+ * be allocated.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p dispatch or @p launch is NULL.
  */
-hsa_status_t HSA_API
-    hsa_amd_memory_pool_get_info(hsa_amd_memory_pool_t memory_pool,
-                                 hsa_amd_memory_pool_info_t attribute,
-                                 void* value);
+hsa_status_t HSA_API hsa_amd_launch_template_create(hsa_queue_t* queue,
+                                                    hsa_executable_symbol_t kernel,
+                                                    const hsa_kernel_dispatch_packet_t* dispatch,
+                                                    hsa_amd_launch_template_t* launch);
 
 /**
- * @brief Iterate over the memory pools associated with a given agent, and
- * invoke an application-defined callback on every iteration.
- *
- * @details An agent can directly access buffers located in some memory pool, or
- * be enabled to access them by the application (see ::hsa_amd_agents_allow_access),
- * yet that memory pool may not be returned by this function for that given
- * agent.
+ * @brief Launch a kernel from a template.
  *
- * A memory pool of fine-grained type must be associated only with the host.
+ * @details Waits for a free queue slot, then writes the captured packet with a
+ * copy of the kernel arguments and rings the doorbell.  Safe to call
+ * concurrently from several threads on a multi-producer queue.
  *
- * @param[in] agent A valid agent.
+ * @param[in] launch Template to launch.
  *
- * @param[in] callback Callback to be invoked on the same thread that called
- * ::hsa_amd_agent_iterate_memory_pools, serially, once per memory pool that is
- * associated with the agent.  The HSA runtime passes two arguments to the
- * callback: the memory pool, and the application data.  If @p callback
- * returns a status other than ::HSA_STATUS_SUCCESS for a particular iteration,
- * the traversal stops and ::hsa_amd_agent_iterate_memory_pools returns that status
- * value.
+ * @param[in] kernarg Kernel arguments, the kernarg segment size of the kernel
+ * in bytes.  May be NULL if that size is zero.
  *
- * @param[in] data Application data that is passed to @p callback on every
- * iteration. May be NULL.
+ * @param[in] completion_signal Completion signal of the dispatch, may be
+ * zero.
  *
- * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ * @retval ::HSA_STATUS_SUCCESS The dispatch has been submitted.
  *
  * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
  * initialized.
  *
- * @retval ::HSA_STATUS_ERROR_INVALID_AGENT The agent is invalid.
- *
- * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p callback is NULL.
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p launch is invalid or
+ * @p kernarg is NULL for a kernel with arguments.
  */
-hsa_status_t HSA_API hsa_amd_agent_iterate_memory_pools(
-    hsa_agent_t agent,
-    hsa_status_t (*callback)(hsa_amd_memory_pool_t memory_pool, void* data),
-    void* data);
+hsa_status_t HSA_API hsa_amd_launch_template_dispatch(hsa_amd_launch_template_t launch,
+                                                      const void* kernarg,
+                                                      hsa_signal_t completion_signal);
 
 /**
- * @brief Allocate a block of memory (or buffer) in the specified pool.
+ * @brief Destroy a launch template and release its kernel argument memory.
  *
- * @param[in] memory_pool Memory pool where to allocate memory from. The memory
- * pool must have the ::HSA_AMD_MEMORY_POOL_INFO_RUNTIME_ALLOC_ALLOWED flag set.
+ * @details Dispatches submitted from the template must have completed.
  *
- * @param[in] size Allocation size, in bytes. Must not be zero. This value is
- * rounded up to the nearest multiple of
- * ::HSA_AMD_MEMORY_POOL_INFO_RUNTIME_ALLOC_GRANULE in @p memory_pool.
+ * @param[in] launch Template to destroy.
  *
- * @param[in] flags A bit-field that is used to specify allocation
- * directives. Reserved parameter, must be 0.
+ * @retval ::HSA_STATUS_SUCCESS The template has been destroyed.
  *
- * @param[out] ptr Pointer to the location where to store the base virtual
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p launch is invalid.
+ */
+hsa_status_t HSA_API hsa_amd_launch_template_destroy(hsa_amd_launch_template_t launch);
+
+/**
+ * @brief Sequence of AQL packets captured from a queue.
+ */
+typedef struct hsa_amd_graph_s {
+  /**
+   * Opaque handle. Two handles reference the same object of the enclosing type
+   * if and only if they are equal.
+   */
+  uint64_t handle;
+} hsa_amd_graph_t;
+
+/**
+ * @brief Start capturing the packets submitted to a queue.
+ *
+ * @details Until ::hsa_amd_queue_capture_end, packets processed from @p queue
+ * are recorded in a graph instead of being executed.  Dispatch, barrier and
+ * agent dispatch packets are recorded as they would have been submitted to
+ * hardware, after any rewriting by interceptors.  Their completion signals
+ * are not decremented during capture.
+ *
+ * @param[in] queue Queue created by hsa_amd_queue_intercept_create.
+ *
+ * @retval ::HSA_STATUS_SUCCESS Capture has started.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_QUEUE @p queue is invalid or not an
+ * intercept queue.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p queue is already capturing.
+ */
+hsa_status_t HSA_API hsa_amd_queue_capture_begin(hsa_queue_t* queue);
+
+/**
+ * @brief Stop capturing a queue and return the captured graph.
+ *
+ * @details Packets written but not yet announced with a doorbell store when
+ * capture ends are executed normally.
+ *
+ * @param[in] queue Capturing queue.
+ *
+ * @param[out] graph Captured graph.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The graph has been returned.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_QUEUE @p queue is invalid or not an
+ * intercept queue.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p graph is NULL or @p queue
+ * is not capturing.
+ */
+hsa_status_t HSA_API hsa_amd_queue_capture_end(hsa_queue_t* queue, hsa_amd_graph_t* graph);
+
+/**
+ * @brief Replay a captured graph.
+ *
+ * @details Submits the captured packets to @p queue in batches of half the
+ * queue size, followed by barriers tracking completion.  Kernel argument
+ * buffers captured by reference must still hold the arguments.  Before the
+ * packets are submitted the completion signals of captured packets are
+ * restored to their values at capture, so replays of the same graph are
+ * serialized: a launch first waits for the previous replay to finish.
+ *
+ * @param[in] graph Graph to replay.
+ *
+ * @param[in] queue Queue of the agent the graph was captured on.  May be any
+ * queue of that agent.
+ *
+ * @param[in] completion_signal Signal decremented once the replay has
+ * finished, may be zero.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The graph has been submitted.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_QUEUE @p queue is NULL or invalid.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p graph is invalid.
+ */
+hsa_status_t HSA_API hsa_amd_graph_launch(hsa_amd_graph_t graph, hsa_queue_t* queue,
+                                          hsa_signal_t completion_signal);
+
+/**
+ * @brief Destroy a graph, after waiting for its last replay to finish.
+ *
+ * @param[in] graph Graph to destroy.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The graph has been destroyed.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p graph is invalid.
+ */
+hsa_status_t HSA_API hsa_amd_graph_destroy(hsa_amd_graph_t graph);
+
+/**
+ * @brief Create a user mode queue that kernels running on @p agent may submit
+ * packets to.
+ *
+ * @details Behaves as ::hsa_queue_create, except the ring buffer is placed in
+ * host visible device memory when the agent has any, and the queue is never
+ * shared with or taken from the runtime's queue pool. Device-side producers
+ * reserve packet slots by incrementing the write index, write the packet,
+ * publish its header and store the packet id to the doorbell signal's
+ * hardware doorbell. amd_hsa_device_enqueue.h provides these steps. Host
+ * threads may keep submitting to the queue through the usual HSA APIs.
+ *
+ * @param[in] agent GPU agent where the queue and its producers run.
+ *
+ * @param[in] size Number of packets the queue is expected to hold. Must be a
+ * power of 2.
+ *
+ * @param[in] type Type of the queue, must be ::HSA_QUEUE_TYPE_MULTI since
+ * devices and hosts may produce concurrently.
+ *
+ * @param[in] callback Queue error callback, as for ::hsa_queue_create.
+ *
+ * @param[in] data Application data passed to @p callback.
+ *
+ * @param[in] private_segment_size Hint for the maximum private segment usage
+ * per work-item, or UINT32_MAX.
+ *
+ * @param[in] group_segment_size Hint for the maximum group segment usage per
+ * work-group, or UINT32_MAX.
+ *
+ * @param[out] queue Memory location where the runtime stores the new queue.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The queue has been created.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_AGENT @p agent is not a GPU agent.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_QUEUE_CREATION The agent does not ring
+ * 64-bit AQL doorbells, which device-side producers require.
+ *
+ * @retval ::HSA_STATUS_ERROR_OUT_OF_RESOURCES There are no resources left for
+ * the queue.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p size is not a power of two,
+ * @p type is not ::HSA_QUEUE_TYPE_MULTI or @p queue is NULL.
+ */
+hsa_status_t HSA_API hsa_amd_queue_create_device_enqueue(
+    hsa_agent_t agent, uint32_t size, hsa_queue_type32_t type,
+    void (*callback)(hsa_status_t status, hsa_queue_t* source, void* data), void* data,
+    uint32_t private_segment_size, uint32_t group_segment_size, hsa_queue_t** queue);
+
+/**
+ * @brief Order work across several queues and copy engines without a host
+ * wait.
+ *
+ * @details Inserts a fence on every queue in @p queues and on the engines
+ * that asynchronous copies of every agent in @p copy_agents have been issued
+ * to. Packets and copies submitted after the call start only once all work
+ * submitted to every participant before the call has finished. Queues wait
+ * with barrier-AND packets and SDMA engines with register polls on a shared
+ * runtime signal, no host thread takes part.
+ *
+ * @param[in] num_queues Number of queues in @p queues.
+ *
+ * @param[in] queues Queues to fence. May be NULL if @p num_queues is 0.
+ *
+ * @param[in] num_copy_agents Number of agents in @p copy_agents.
+ *
+ * @param[in] copy_agents GPU agents whose copy engines join the fence. May be
+ * NULL if @p num_copy_agents is 0.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The fence has been submitted.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_QUEUE A queue is invalid.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_AGENT An agent is invalid or not a GPU.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p queues or @p copy_agents is
+ * NULL while its count is not 0.
+ */
+hsa_status_t HSA_API hsa_amd_queue_fence(uint32_t num_queues, hsa_queue_t* const* queues,
+                                         uint32_t num_copy_agents,
+                                         const hsa_agent_t* copy_agents);
+
+/**
+ * @brief Cost of moving data between two agents.
+ */
+typedef struct hsa_amd_link_cost_s {
+  /**
+   * Number of links on the best path, 0 if the agents share a node or are not
+   * connected.
+   */
+  uint32_t hops;
+
+  /**
+   * Sum of the latencies of the links on the path, in nanoseconds.
+   */
+  uint32_t latency;
+
+  /**
+   * Bandwidth of the slowest link on the path, in MB/s. 0 if the agents share
+   * a node or are not connected.
+   */
+  uint64_t bandwidth;
+
+  /**
+   * True if @a bandwidth was measured by the runtime rather than reported by
+   * the kernel driver. Only set with HSA_LINK_CALIBRATION=1.
+   */
+  bool calibrated;
+} hsa_amd_link_cost_t;
+
+/**
+ * @brief Query the cost of moving data from @p src_agent to @p dst_agent.
+ *
+ * @details Agents without a direct link are joined through the path with the
+ * fewest links, then the most bandwidth. Links reported without bandwidth or
+ * latency are given typical values of their type.
+ *
+ * @param[in] src_agent Agent the data is read from.
+ *
+ * @param[in] dst_agent Agent the data is written to.
+ *
+ * @param[out] cost Memory location where the runtime stores the cost.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The cost has been stored.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_AGENT An agent is invalid.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p cost is NULL.
+ */
+hsa_status_t HSA_API hsa_amd_agent_link_cost(hsa_agent_t src_agent, hsa_agent_t dst_agent,
+                                             hsa_amd_link_cost_t* cost);
+
+/**
+ * @brief Asynchronous ::hsa_ext_image_import.
+ *
+ * @details The import starts after every signal in @p dep_signals has the
+ * value 0, and @p completion_signal is decremented once it has finished.
+ * Arguments are validated when the call is made; @p image_region is copied,
+ * @p src_memory must stay valid until completion. Errors raised by the image
+ * extension while the import runs are not reported.
+ *
+ * @param[in] agent GPU agent, as for ::hsa_ext_image_import.
+ *
+ * @param[in] src_memory Source memory.
+ *
+ * @param[in] src_row_pitch Row pitch of the source, in bytes.
+ *
+ * @param[in] src_slice_pitch Slice pitch of the source, in bytes.
+ *
+ * @param[in] dst_image Destination image.
+ *
+ * @param[in] image_region Region of the image to write.
+ *
+ * @param[in] num_dep_signals Number of dependent signals.
+ *
+ * @param[in] dep_signals List of signals that must be 0 before the import
+ * starts.
+ *
+ * @param[in] completion_signal Signal decremented on completion.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The import has been queued.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime or the image
+ * extension has not been initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_AGENT @p agent is not a GPU agent.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_SIGNAL A signal is invalid.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT A pointer is NULL, or
+ * @p num_dep_signals and @p dep_signals disagree.
+ *
+ * @retval ::HSA_STATUS_ERROR_OUT_OF_RESOURCES No host worker is available.
+ */
+hsa_status_t HSA_API hsa_amd_image_import_async(hsa_agent_t agent, const void* src_memory,
+                                                size_t src_row_pitch, size_t src_slice_pitch,
+                                                hsa_ext_image_t dst_image,
+                                                const hsa_ext_image_region_t* image_region,
+                                                uint32_t num_dep_signals,
+                                                const hsa_signal_t* dep_signals,
+                                                hsa_signal_t completion_signal);
+
+/**
+ * @brief Asynchronous ::hsa_ext_image_export, with the dependency and
+ * completion semantics of ::hsa_amd_image_import_async.
+ */
+hsa_status_t HSA_API hsa_amd_image_export_async(hsa_agent_t agent, hsa_ext_image_t src_image,
+                                                void* dst_memory, size_t dst_row_pitch,
+                                                size_t dst_slice_pitch,
+                                                const hsa_ext_image_region_t* image_region,
+                                                uint32_t num_dep_signals,
+                                                const hsa_signal_t* dep_signals,
+                                                hsa_signal_t completion_signal);
+
+/**
+ * @brief Asynchronous ::hsa_ext_image_copy, with the dependency and
+ * completion semantics of ::hsa_amd_image_import_async. The offsets and
+ * range are copied.
+ */
+hsa_status_t HSA_API hsa_amd_image_copy_async(hsa_agent_t agent, hsa_ext_image_t src_image,
+                                              const hsa_dim3_t* src_offset,
+                                              hsa_ext_image_t dst_image,
+                                              const hsa_dim3_t* dst_offset,
+                                              const hsa_dim3_t* range, uint32_t num_dep_signals,
+                                              const hsa_signal_t* dep_signals,
+                                              hsa_signal_t completion_signal);
+
+/**
+ * @brief Asynchronous ::hsa_ext_image_clear, with the dependency and
+ * completion semantics of ::hsa_amd_image_import_async. @p data, four 32 bit
+ * channels, is copied.
+ */
+hsa_status_t HSA_API hsa_amd_image_clear_async(hsa_agent_t agent, hsa_ext_image_t image,
+                                               const void* data,
+                                               const hsa_ext_image_region_t* image_region,
+                                               uint32_t num_dep_signals,
+                                               const hsa_signal_t* dep_signals,
+                                               hsa_signal_t completion_signal);
+
+/**
+ * @brief Pool of counter collection buffers managed by the runtime.
+ */
+typedef struct hsa_amd_profile_pool_s {
+  /**
+   * Opaque handle. Two handles reference the same object of the enclosing type
+   * if and only if they are equal.
+   */
+  uint64_t handle;
+} hsa_amd_profile_pool_t;
+
+/**
+ * @brief Buffers of one profiled dispatch, to be placed in the command_buffer and
+ * output_buffer descriptors of an aqlprofile profile.
+ */
+typedef struct hsa_amd_profile_buffer_s {
+  /**
+   * Buffer id, passed to ::hsa_amd_profile_pool_submit and to the data callback.
+   */
+  uint32_t id;
+  /**
+   * Command buffer in fine grain system memory.
+   */
+  void* command;
+  /**
+   * Command buffer size in bytes.
+   */
+  uint32_t command_size;
+  /**
+   * Output buffer in device local memory. It is not accessible by the host.
+   */
+  void* output;
+  /**
+   * Output buffer size in bytes.
+   */
+  uint32_t output_size;
+} hsa_amd_profile_buffer_t;
+
+/**
+ * @brief Receives the output of a submitted buffer.
+ *
+ * @details @p data is a host copy of the output buffer, valid for the duration
+ * of the call. To decode it, point the output_buffer descriptor of a copy of
+ * the profile at @p data. The buffer is free again when the callback returns.
+ * Callbacks run on runtime threads and must not block on other submissions of
+ * the same pool.
+ */
+typedef void (*hsa_amd_profile_data_callback_t)(uint32_t id, const void* data, uint32_t size,
+                                                void* user_data);
+
+/**
+ * @brief Create a pool of counter collection buffers for a GPU agent.
+ *
+ * @details Output buffers are read back asynchronously with one DMA copy per
+ * @p batch_size submitted buffers, so collection for each dispatch costs no
+ * host access to device memory and no wait.
+ *
+ * @param[in] agent GPU agent.
+ *
+ * @param[in] command_size Size of each command buffer, as reported by
+ * HSA_VEN_AMD_AQLPROFILE_INFO_COMMAND_BUFFER_SIZE. Rounded up.
+ *
+ * @param[in] output_size Size of each output buffer, as reported by
+ * HSA_VEN_AMD_AQLPROFILE_INFO_PMC_DATA_SIZE. Rounded up.
+ *
+ * @param[in] num_buffers Number of buffers.
+ *
+ * @param[in] batch_size Number of submitted buffers read back together,
+ * clamped to [1, @p num_buffers].
+ *
+ * @param[in] callback Callback receiving the output of each buffer.
+ *
+ * @param[in] user_data Passed to @p callback.
+ *
+ * @param[out] pool Created pool.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The pool has been created.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_AGENT @p agent is not a GPU agent with
+ * local memory.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT A size or @p num_buffers is 0, or
+ * @p callback or @p pool is NULL.
+ *
+ * @retval ::HSA_STATUS_ERROR_OUT_OF_RESOURCES The buffers could not be
+ * allocated.
+ */
+hsa_status_t HSA_API hsa_amd_profile_pool_create(hsa_agent_t agent, uint32_t command_size,
+                                                 uint32_t output_size, uint32_t num_buffers,
+                                                 uint32_t batch_size,
+                                                 hsa_amd_profile_data_callback_t callback,
+                                                 void* user_data, hsa_amd_profile_pool_t* pool);
+
+/**
+ * @brief Take a free buffer from the pool.
+ *
+ * @details If no buffer is free, the submitted buffers are read back and the
+ * call waits for their callbacks.
+ *
+ * @retval ::HSA_STATUS_SUCCESS @p buffer has been filled in.
+ *
+ * @retval ::HSA_STATUS_ERROR_OUT_OF_RESOURCES Every buffer is acquired and not
+ * submitted.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p pool is invalid or @p buffer
+ * is NULL.
+ */
+hsa_status_t HSA_API hsa_amd_profile_pool_acquire(hsa_amd_profile_pool_t pool,
+                                                  hsa_amd_profile_buffer_t* buffer);
+
+/**
+ * @brief Queue an acquired buffer for readback.
+ *
+ * @param[in] pool Pool.
+ *
+ * @param[in] id Id of the buffer.
+ *
+ * @param[in] ready_signal Signal reaching 0 once the output buffer is written,
+ * usually the completion signal of the profile stop packet. It must remain
+ * valid until the callback for the buffer has run.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The buffer has been queued.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_SIGNAL @p ready_signal is invalid.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p pool or @p id is invalid, or
+ * the buffer is not acquired, such as when it was already submitted.
+ */
+hsa_status_t HSA_API hsa_amd_profile_pool_submit(hsa_amd_profile_pool_t pool, uint32_t id,
+                                                 hsa_signal_t ready_signal);
+
+/**
+ * @brief Read back every submitted buffer and wait until their callbacks
+ * have returned.
+ *
+ * @retval ::HSA_STATUS_SUCCESS Every submitted buffer has been delivered.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p pool is invalid.
+ */
+hsa_status_t HSA_API hsa_amd_profile_pool_flush(hsa_amd_profile_pool_t pool);
+
+/**
+ * @brief Flush and destroy a pool. Buffers of the pool must no longer be in
+ * use by the device.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The pool has been destroyed.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p pool is invalid.
+ */
+hsa_status_t HSA_API hsa_amd_profile_pool_destroy(hsa_amd_profile_pool_t pool);
+
+/**
+ * @brief Progress of a queue at one sample.
+ */
+typedef struct hsa_amd_queue_progress_stats_s {
+  /**
+   * Read index at the sample.
+   */
+  uint64_t read_index;
+  /**
+   * Write index at the sample.
+   */
+  uint64_t write_index;
+  /**
+   * Packets written but not yet consumed.
+   */
+  uint64_t depth;
+  /**
+   * Packets consumed per second since the previous sample.
+   */
+  uint64_t dispatch_rate;
+  /**
+   * Time the queue has held packets without its read index advancing, in
+   * nanoseconds, as seen by the samples.
+   */
+  uint64_t stall_time_ns;
+  /**
+   * Time since the previous sample in nanoseconds, 0 for the first sample.
+   */
+  uint64_t sample_interval_ns;
+} hsa_amd_queue_progress_stats_t;
+
+/**
+ * @brief Sample the progress of a queue.
+ *
+ * @details Reads the read and write indices of @p queue and compares them with
+ * the previous sample.  Queues placed in a class with
+ * ::hsa_amd_queue_set_class are also sampled by the runtime every
+ * HSA_QUEUE_SCHED_INTERVAL, so their dispatch rate and stall time are kept
+ * current between calls.
+ *
+ * @param[in] queue Queue to sample.
+ *
+ * @param[out] stats Progress of the queue.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The queue has been sampled.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_QUEUE @p queue is invalid.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p stats is NULL.
+ */
+hsa_status_t HSA_API hsa_amd_queue_get_progress_stats(const hsa_queue_t* queue,
+                                                      hsa_amd_queue_progress_stats_t* stats);
+
+/**
+ * @brief Kind of operation described by a ::hsa_amd_trace_record_t.
+ */
+typedef enum {
+  /**
+   * AQL packet submitted through an intercepted queue.
+   */
+  HSA_AMD_TRACE_RECORD_DISPATCH = 0,
+  /**
+   * Asynchronous memory copy.
+   */
+  HSA_AMD_TRACE_RECORD_ASYNC_COPY = 1,
+  /**
+   * Blocking memory copy.
+   */
+  HSA_AMD_TRACE_RECORD_COPY = 2,
+  /**
+   * Blocking memory fill.
+   */
+  HSA_AMD_TRACE_RECORD_FILL = 3
+} hsa_amd_trace_record_kind_t;
+
+/**
+ * @brief Operation recorded by runtime tracing.
+ *
+ * @details Tracing is enabled by setting HSA_TRACE_FILE to the path of a
+ * binary trace file, or by a tool library exporting
+ * @code
+ * void OnTrace(const hsa_amd_trace_record_t* records, size_t count,
+ *              uint64_t tick_frequency);
+ * @endcode
+ * which receives batches of records in the order each thread produced them.
+ * The trace file starts with the 8 byte magic "HSATRACE", a uint32_t record
+ * size and a uint32_t reserved field, and a uint64_t tick frequency, followed
+ * by records.
+ */
+typedef struct hsa_amd_trace_record_s {
+  /**
+   * An ::hsa_amd_trace_record_kind_t.
+   */
+  uint32_t kind;
+  /**
+   * Node id of the agent performing an asynchronous copy, 0 otherwise.
+   */
+  uint32_t node_id;
+  /**
+   * Id of the queue for dispatches, 0 otherwise.
+   */
+  uint64_t queue_id;
+  /**
+   * Packet index for dispatches, 0 otherwise.
+   */
+  uint64_t packet_id;
+  /**
+   * Kernel object of kernel dispatches, 0 otherwise.
+   */
+  uint64_t kernel_object;
+  /**
+   * Host tick at which the runtime submitted the operation.
+   */
+  uint64_t start;
+  /**
+   * Host tick at which the runtime observed completion, 0 for operations
+   * completing asynchronously.
+   */
+  uint64_t end;
+  /**
+   * Bytes copied or filled, 0 for dispatches.
+   */
+  uint64_t size;
+  uint64_t reserved;
+} hsa_amd_trace_record_t;
+
+/**
+ * @brief Function executing an agent dispatch packet of a CPU agent queue.
+ *
+ * @param[in] packet Agent dispatch packet.  The completion signal of the
+ * packet is decremented by the runtime after the function returns.
+ *
+ * @param[in] data User data given to
+ * ::hsa_amd_queue_set_agent_dispatch_handler.
+ */
+typedef void (*hsa_amd_agent_dispatch_handler)(const hsa_agent_dispatch_packet_t* packet,
+                                               void* data);
+
+/**
+ * @brief Set the function executing agent dispatch packets of a CPU agent
+ * queue.
+ *
+ * @details CPU agent queues are executed by runtime worker threads when the
+ * HSA_HOST_QUEUE_THREADS environment variable is set, in which case
+ * ::hsa_queue_create accepts CPU agents.  Barrier-AND and barrier-OR packets
+ * are processed by the runtime.  Agent dispatch packets are passed to
+ * @p handler on a worker thread, in queue order.  Packets waiting for a
+ * handler stay in the queue until one is set.  The handler must not destroy
+ * its own queue.
+ *
+ * @param[in] queue Queue created on a CPU agent with ::hsa_queue_create.
+ *
+ * @param[in] handler Function executing agent dispatch packets, or NULL to
+ * stop executing them.
+ *
+ * @param[in] data User data passed to @p handler.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The handler has been set.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_QUEUE @p queue is invalid or its packets
+ * are not executed by the runtime.
+ */
+hsa_status_t HSA_API hsa_amd_queue_set_agent_dispatch_handler(hsa_queue_t* queue,
+                                                              hsa_amd_agent_dispatch_handler handler,
+                                                              void* data);
+
+/**
+ * @brief Memory segments associated with a memory pool.
+ */
+typedef enum {
+  /**
+   * Global segment. Used to hold data that is shared by all agents.
+   */
+  HSA_AMD_SEGMENT_GLOBAL = 0,
+  /**
+   * Read-only segment. Used to hold data that remains constant during the
+   * execution of a kernel.
+   */
+  HSA_AMD_SEGMENT_READONLY = 1,
+  /**
+   * Private segment. Used to hold data that is local to a single work-item.
+   */
+  HSA_AMD_SEGMENT_PRIVATE = 2,
+  /**
+   * Group segment. Used to hold data that is shared by the work-items of a
+   * work-group.
+   */
+  HSA_AMD_SEGMENT_GROUP = 3,
+} hsa_amd_segment_t;
+
+/**
+ * @brief A memory pool represents physical storage on an agent.
+ */
+typedef struct hsa_amd_memory_pool_s {
+  /**
+   * Opaque handle.
+   */
+  uint64_t handle;
+} hsa_amd_memory_pool_t;
+
+typedef enum hsa_amd_memory_pool_global_flag_s {
+  /**
+   * The application can use allocations in the memory pool to store kernel
+   * arguments, and provide the values for the kernarg segment of
+   * a kernel dispatch.
+   *
+   * With HSA_VRAM_KERNARG=1, GPUs with a fully host visible frame buffer also
+   * report a kernarg pool in device memory.  Host writes to it are write
+   * combined and are made visible to the GPU when a doorbell of one of its
+   * queues is rung through the runtime.  The pool is only usable by the owning
+   * GPU.
+   */
+  HSA_AMD_MEMORY_POOL_GLOBAL_FLAG_KERNARG_INIT = 1,
+  /**
+   * Updates to memory in this pool conform to HSA memory consistency model.
+   * If this flag is set, then ::HSA_AMD_MEMORY_POOL_GLOBAL_FLAG_COARSE_GRAINED
+   * must not be set.
+   */
+  HSA_AMD_MEMORY_POOL_GLOBAL_FLAG_FINE_GRAINED = 2,
+  /**
+   * Writes to memory in this pool can be performed by a single agent at a time.
+   */
+  HSA_AMD_MEMORY_POOL_GLOBAL_FLAG_COARSE_GRAINED = 4
+} hsa_amd_memory_pool_global_flag_t;
+
+/**
+ * @brief Memory pool features.
+ */
+typedef enum {
+  /**
+  * Segment where the memory pool resides. The type of this attribute is
+  * ::hsa_amd_segment_t.
+  */
+  HSA_AMD_MEMORY_POOL_INFO_SEGMENT = 0,
+  /**
+  * Flag mask. The value of this attribute is undefined if the value of
+  * ::HSA_AMD_MEMORY_POOL_INFO_SEGMENT is not ::HSA_AMD_SEGMENT_GLOBAL. The type
+  * of
+  * this attribute is uint32_t, a bit-field of
+  * ::hsa_amd_memory_pool_global_flag_t
+  * values.
+  */
+  HSA_AMD_MEMORY_POOL_INFO_GLOBAL_FLAGS = 1,
+  /**
+  * Size of this pool, in bytes. The type of this attribute is size_t.
+  */
+  HSA_AMD_MEMORY_POOL_INFO_SIZE = 2,
+  /**
+  * Indicates whether memory in this pool can be allocated using
+  * ::hsa_amd_memory_pool_allocate. The type of this attribute is bool.
+  *
+  * The value of this flag is always false for memory pools in the group and
+  * private segments.
+  */
+  HSA_AMD_MEMORY_POOL_INFO_RUNTIME_ALLOC_ALLOWED = 5,
+  /**
+  * Allocation granularity of buffers allocated by
+  * ::hsa_amd_memory_pool_allocate
+  * in this memory pool. The size of a buffer allocated in this pool is a
+  * multiple of the value of this attribute. The value of this attribute is
+  * only defined if ::HSA_AMD_MEMORY_POOL_INFO_RUNTIME_ALLOC_ALLOWED is true for
+  * this pool. The type of this attribute is size_t.
+  */
+  HSA_AMD_MEMORY_POOL_INFO_RUNTIME_ALLOC_GRANULE = 6,
+  /**
+  * Alignment of buffers allocated by ::hsa_amd_memory_pool_allocate in this
+  * pool. The value of this attribute is only defined if
+  * ::HSA_AMD_MEMORY_POOL_INFO_RUNTIME_ALLOC_ALLOWED is true for this pool, and
+  * must be a power of 2. The type of this attribute is size_t.
+  */
+  HSA_AMD_MEMORY_POOL_INFO_RUNTIME_ALLOC_ALIGNMENT = 7,
+  /**
+  * This memory_pool can be made directly accessible by all the agents in the
+  * system (::hsa_amd_agent_memory_pool_get_info does not return 
+  * ::HSA_AMD_MEMORY_POOL_ACCESS_NEVER_ALLOWED for any agent). The type of this
+  * attribute is bool.
+  */
+  HSA_AMD_MEMORY_POOL_INFO_ACCESSIBLE_BY_ALL = 15,
+  /**
+  * Page size used for allocations made with
+  * ::HSA_AMD_MEMORY_POOL_HUGE_PAGE_FLAG, or 0 if the pool does not support
+  * huge pages. The type of this attribute is size_t.
+  */
+  HSA_AMD_MEMORY_POOL_INFO_HUGE_PAGE_SIZE = 16,
+  /**
+  * Allocation counters of this pool. The type of this attribute is
+  * ::hsa_amd_memory_pool_stats_t.
+  */
+  HSA_AMD_MEMORY_POOL_INFO_STATS = 17,
+  /**
+  * The most recent allocation events of this pool. Events are only recorded
+  * when the environment variable HSA_MEMORY_POOL_TRACE is set to 1, otherwise
+  * the trace is empty. The type of this attribute is
+  * ::hsa_amd_memory_pool_trace_t.
+  */
+  HSA_AMD_MEMORY_POOL_INFO_TRACE = 18,
+} hsa_amd_memory_pool_info_t;
+
+/**
+ * @brief Allocation counters of a memory pool.
+ *
+ * @details Byte counts are a snapshot. Counts of events are totals since the
+ * runtime was initialized, rates can be derived from successive queries. The
+ * fragment allocator serves small device memory allocations out of blocks it
+ * allocates from the kernel driver; fragment_free_bytes over
+ * fragment_block_bytes measures its fragmentation.
+ */
+typedef struct hsa_amd_memory_pool_stats_s {
+  /**
+  * Bytes currently allocated from the kernel driver.
+  */
+  uint64_t driver_bytes;
+  /**
+  * Bytes currently held by live allocations of the pool.
+  */
+  uint64_t used_bytes;
+  /**
+  * Bytes of freed large allocations cached for reuse.
+  */
+  uint64_t cached_bytes;
+  /**
+  * Bytes of the blocks held by the fragment allocator.
+  */
+  uint64_t fragment_block_bytes;
+  /**
+  * Free bytes within fragment_block_bytes.
+  */
+  uint64_t fragment_free_bytes;
+  /**
+  * Size of the largest free fragment.
+  */
+  uint64_t largest_free_fragment;
+  /**
+  * Number of successful allocations.
+  */
+  uint64_t alloc_count;
+  /**
+  * Number of frees.
+  */
+  uint64_t free_count;
+  /**
+  * Number of failed allocations.
+  */
+  uint64_t failed_alloc_count;
+  /**
+  * Number of times cached memory was released to satisfy an allocation.
+  */
+  uint64_t trim_count;
+} hsa_amd_memory_pool_stats_t;
+
+/**
+ * @brief Magic value of ::hsa_amd_stats_page_t, the bytes "HSASTATS".
+ */
+#define HSA_AMD_STATS_PAGE_MAGIC 0x5354415453415348ull
+
+/**
+ * @brief Layout version of ::hsa_amd_stats_page_t.
+ */
+#define HSA_AMD_STATS_PAGE_VERSION 1
+
+/**
+ * @brief Number of pool, GPU agent and queue entries of ::hsa_amd_stats_page_t.
+ */
+#define HSA_AMD_STATS_MAX_AGENTS 32
+#define HSA_AMD_STATS_MAX_QUEUES 256
+
+/**
+ * @brief Occupancy of the ring of a copy engine.
+ */
+typedef struct hsa_amd_stats_ring_s {
+  /**
+   * Bytes of commands submitted and not yet consumed by the engine.
+   */
+  uint64_t used;
+  /**
+   * Size of the ring in bytes, 0 if the engine has not been created.
+   */
+  uint64_t size;
+} hsa_amd_stats_ring_t;
+
+/**
+ * @brief Counters of a GPU agent in ::hsa_amd_stats_page_t.
+ */
+typedef struct hsa_amd_stats_agent_s {
+  /**
+   * Node id of the agent.
+   */
+  uint32_t node_id;
+  uint32_t reserved;
+  /**
+   * Asynchronous copy counters, as reported by HSA_AMD_AGENT_INFO_BLIT_STATS.
+   */
+  hsa_amd_agent_blit_stats_t blits;
+  /**
+   * Rings of the host to device, device to host and device to device engines.
+   */
+  hsa_amd_stats_ring_t rings[3];
+  /**
+   * Size of the scratch pool and bytes of it not assigned to queues.
+   */
+  uint64_t scratch_size;
+  uint64_t scratch_free;
+  /**
+   * Counters of the agent's local memory pool, as reported by
+   * HSA_AMD_MEMORY_POOL_INFO_STATS.
+   */
+  hsa_amd_memory_pool_stats_t local_pool;
+} hsa_amd_stats_agent_t;
+
+/**
+ * @brief AQL queue in ::hsa_amd_stats_page_t.  The queue depth is
+ * write_index - read_index.
+ */
+typedef struct hsa_amd_stats_queue_s {
+  /**
+   * Id of the queue, as in hsa_queue_t.
+   */
+  uint64_t id;
+  /**
+   * Node id of the agent of the queue.
+   */
+  uint32_t node_id;
+  /**
+   * Size of the queue in packets.
+   */
+  uint32_t size;
+  uint64_t read_index;
+  uint64_t write_index;
+} hsa_amd_stats_queue_t;
+
+/**
+ * @brief Runtime counters published to shared memory.
+ *
+ * @details Setting HSA_STATS_SHM to a name makes the runtime create the
+ * shared memory segment of that name, "/name" under Linux and "Local\name"
+ * under Windows, holding one ::hsa_amd_stats_page_t.  A runtime thread
+ * refreshes it every HSA_STATS_SHM_INTERVAL milliseconds, 100 by default,
+ * from state the runtime already maintains, the submission paths are not
+ * instrumented for it.
+ * Readers in other processes copy the page, retrying while @p sequence is odd
+ * or changed during the copy.  Under Linux the segment is readable by the
+ * user and group of the process.  If a segment of that name already exists
+ * no page is published.  The segment is removed when the runtime shuts down.
+ */
+typedef struct hsa_amd_stats_page_s {
+  /**
+   * ::HSA_AMD_STATS_PAGE_MAGIC.
+   */
+  uint64_t magic;
+  /**
+   * ::HSA_AMD_STATS_PAGE_VERSION.
+   */
+  uint32_t version;
+  /**
+   * Size of the page structure in bytes.
+   */
+  uint32_t size;
+  /**
+   * Incremented before and after each update, odd while an update is in progress.
+   */
+  volatile uint64_t sequence;
+  /**
+   * Process id of the runtime.
+   */
+  uint64_t pid;
+  /**
+   * Value of HSA_SYSTEM_INFO_TIMESTAMP at the update.
+   */
+  uint64_t timestamp;
+  /**
+   * Signals the signal pool has room for.
+   */
+  uint64_t signal_pool_size;
+  /**
+   * Asynchronous signal handlers being watched.
+   */
+  uint64_t async_events;
+  /**
+   * Valid entries of @p system_pools, @p agents and @p queues.
+   */
+  uint32_t num_system_pools;
+  uint32_t num_agents;
+  uint32_t num_queues;
+  uint32_t reserved;
+  /**
+   * Queues of the process, including those past HSA_AMD_STATS_MAX_QUEUES.
+   */
+  uint64_t total_queues;
+  /**
+   * Counters of the fine grained system memory pools.
+   */
+  hsa_amd_memory_pool_stats_t system_pools[HSA_AMD_STATS_MAX_AGENTS];
+  /**
+   * GPU agents.
+   */
+  hsa_amd_stats_agent_t agents[HSA_AMD_STATS_MAX_AGENTS];
+  hsa_amd_stats_queue_t queues[HSA_AMD_STATS_MAX_QUEUES];
+} hsa_amd_stats_page_t;
+
+/**
+ * @brief Kinds of allocation trace events.
+ */
+typedef enum hsa_amd_memory_pool_trace_op_s {
+  HSA_AMD_MEMORY_POOL_TRACE_ALLOC = 0,
+  HSA_AMD_MEMORY_POOL_TRACE_FREE = 1,
+  HSA_AMD_MEMORY_POOL_TRACE_ALLOC_FAILED = 2,
+  /**
+  * Cached memory was released before retrying an allocation of size bytes.
+  */
+  HSA_AMD_MEMORY_POOL_TRACE_TRIM = 3
+} hsa_amd_memory_pool_trace_op_t;
+
+/**
+ * @brief Allocation trace event.
+ */
+typedef struct hsa_amd_memory_pool_trace_event_s {
+  /**
+  * Host monotonic time of the event, in nanoseconds.
+  */
+  uint64_t time_ns;
+  /**
+  * Address of the allocation, 0 for failed allocations and trims.
+  */
+  uint64_t address;
+  /**
+  * Size of the allocation in bytes.
+  */
+  uint64_t size;
+  /**
+  * A ::hsa_amd_memory_pool_trace_op_t value.
+  */
+  uint32_t op;
+  uint32_t reserved;
+} hsa_amd_memory_pool_trace_event_t;
+
+/**
+ * @brief Number of events kept in a memory pool trace.
+ */
+#define HSA_AMD_MEMORY_POOL_TRACE_EVENTS 256
+
+/**
+ * @brief The most recent allocation events of a memory pool.
+ */
+typedef struct hsa_amd_memory_pool_trace_s {
+  /**
+  * Number of events recorded since the runtime was initialized, including
+  * events that no longer fit in @p events.
+  */
+  uint64_t total_count;
+  /**
+  * Number of valid entries in @p events.
+  */
+  uint32_t count;
+  uint32_t reserved;
+  /**
+  * Events, oldest first.
+  */
+  hsa_amd_memory_pool_trace_event_t events[HSA_AMD_MEMORY_POOL_TRACE_EVENTS];
+} hsa_amd_memory_pool_trace_t;
+
+/**
+ * @brief Memory pool allocation flags.
+ */
+typedef enum hsa_amd_memory_pool_flag_s {
+  /**
+  * Default allocation.
+  */
+  HSA_AMD_MEMORY_POOL_STANDARD_FLAG = 0,
+  /**
+  * Back the buffer with huge pages and map it to GPUs with matching page
+  * table fragments. The size is rounded up to a multiple of
+  * ::HSA_AMD_MEMORY_POOL_INFO_HUGE_PAGE_SIZE. For system memory the kernel may
+  * fall back to smaller pages if no huge pages are available.
+  */
+  HSA_AMD_MEMORY_POOL_HUGE_PAGE_FLAG = 1,
+  /**
+  * The buffer will be shared with ::hsa_amd_ipc_memory_create. It is given its
+  * own allocation, rounded up to 64KB rather than placed in a larger shared
+  * block, so that exporting it exposes and importers map only the buffer.
+  */
+  HSA_AMD_MEMORY_POOL_IPC_FLAG = 2,
+  /**
+  * The buffer is filled with zeros before it is returned. Device memory
+  * allocated with only this flag is scrubbed in the background by the owning
+  * GPU when it is freed, and is handed out again by later zero initialized
+  * allocations of about the same size without a fill on the allocation path.
+  * HSA_ZERO_POOL_SIZE sets the limit in MB of scrubbed memory kept, 256 by
+  * default.
+  */
+  HSA_AMD_MEMORY_POOL_ZERO_FLAG = 4,
+  /**
+  * Back every page of a system memory buffer before it is returned, so that
+  * first accesses by the CPU do not fault. Ignored by device memory pools.
+  */
+  HSA_AMD_MEMORY_POOL_PREFAULT_FLAG = 8,
+  /**
+  * Place the pages of a system memory buffer on the NUMA node of the CPU agent
+  * owning the pool. Pick the pool of the CPU agent nearest the thread or GPU
+  * using the buffer. The placement is best effort. Ignored by device memory
+  * pools.
+  */
+  HSA_AMD_MEMORY_POOL_NUMA_BIND_FLAG = 16
+} hsa_amd_memory_pool_flag_t;
+
+/**
+ * @brief Get the current value of an attribute of a memory pool.
+ *
+ * @param[in] memory_pool A valid memory pool.
+ *
+ * @param[in] attribute Attribute to query.
+ *
+ * @param[out] value Pointer to a application-allocated buffer where to store
+ * the value of the attribute. If the buffer passed by the application is not
+ * large enough to hold the value of @p attribute, the behavior is undefined.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ */
+hsa_status_t HSA_API
+    hsa_amd_memory_pool_get_info(hsa_amd_memory_pool_t memory_pool,
+                                 hsa_amd_memory_pool_info_t attribute,
+                                 void* value);
+
+/**
+ * @brief Iterate over the memory pools associated with a given agent, and
+ * invoke an application-defined callback on every iteration.
+ *
+ * @details An agent can directly access buffers located in some memory pool, or
+ * be enabled to access them by the application (see ::hsa_amd_agents_allow_access),
+ * yet that memory pool may not be returned by this function for that given
+ * agent.
+ *
+ * A memory pool of fine-grained type must be associated only with the host.
+ *
+ * @param[in] agent A valid agent.
+ *
+ * @param[in] callback Callback to be invoked on the same thread that called
+ * ::hsa_amd_agent_iterate_memory_pools, serially, once per memory pool that is
+ * associated with the agent.  The HSA runtime passes two arguments to the
+ * callback: the memory pool, and the application data.  If @p callback
+ * returns a status other than ::HSA_STATUS_SUCCESS for a particular iteration,
+ * the traversal stops and ::hsa_amd_agent_iterate_memory_pools returns that status
+ * value.
+ *
+ * @param[in] data Application data that is passed to @p callback on every
+ * iteration. May be NULL.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_AGENT The agent is invalid.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p callback is NULL.
+ */
+hsa_status_t HSA_API hsa_amd_agent_iterate_memory_pools(
+    hsa_agent_t agent,
+    hsa_status_t (*callback)(hsa_amd_memory_pool_t memory_pool, void* data),
+    void* data);
+
+/**
+ * @brief Allocate a block of memory (or buffer) in the specified pool.
+ *
+ * @param[in] memory_pool Memory pool where to allocate memory from. The memory
+ * pool must have the ::HSA_AMD_MEMORY_POOL_INFO_RUNTIME_ALLOC_ALLOWED flag set.
+ *
+ * @param[in] size Allocation size, in bytes. Must not be zero. This value is
+ * rounded up to the nearest multiple of
+ * ::HSA_AMD_MEMORY_POOL_INFO_RUNTIME_ALLOC_GRANULE in @p memory_pool.
+ *
+ * @param[in] flags A bit-field of ::hsa_amd_memory_pool_flag_t values that is
+ * used to specify allocation directives.
+ *
+ * @param[out] ptr Pointer to the location where to store the base virtual
  * address of
  * the allocated block. The returned base address is aligned to the value of
  * ::HSA_AMD_MEMORY_POOL_INFO_RUNTIME_ALLOC_ALIGNMENT in @p memory_pool. If the
@@ -821,7 +2164,7 @@ hsa_status_t HSA_API hsa_amd_agent_iterate_memory_pools(
  * HSA_AMD_MEMORY_POOL_INFO_ALLOC_MAX_SIZE in @p memory_pool.
  *
  * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p ptr is NULL, or @p size is 0,
- * or flags is not 0.
+ * or flags contains unknown bits.
  *
  */
 hsa_status_t HSA_API
@@ -843,6 +2186,163 @@ hsa_status_t HSA_API
  */
 hsa_status_t HSA_API hsa_amd_memory_pool_free(void* ptr);
 
+/**
+ * @brief Deallocate a block of memory previously allocated using
+ * ::hsa_amd_memory_pool_allocate once @p signal reaches 0, without blocking the
+ * caller.
+ *
+ * @details The block is released on a runtime thread, together with other
+ * blocks freed around the same time. Deallocation callbacks registered for the
+ * block run on that thread before the memory is released. @p ptr must not be
+ * used or freed again once the call returns. Blocks still waiting on their
+ * signal at ::hsa_shut_down are released at process exit.
+ *
+ * @param[in] ptr Pointer to a memory block. If @p ptr does not match a value
+ * previously returned by ::hsa_amd_memory_pool_allocate, the behavior is undefined.
+ *
+ * @param[in] signal Signal to wait on before releasing the block, typically the
+ * completion signal of the last work using it, or a null handle to release the
+ * block as soon as possible.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The deallocation has been queued.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_SIGNAL @p signal is not a valid signal.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ALLOCATION @p ptr is not a block allocated
+ * by ::hsa_amd_memory_pool_allocate.
+ */
+hsa_status_t HSA_API hsa_amd_memory_pool_free_async(void* ptr, hsa_signal_t signal);
+
+/**
+ * @brief Accounting tag naming the process wide totals of a memory pool.
+ */
+#define HSA_AMD_MEMORY_TAG_ALL UINT32_MAX
+
+/**
+ * @brief Memory usage of an accounting tag in a memory pool.
+ */
+typedef struct hsa_amd_memory_usage_s {
+  /**
+   * Bytes currently allocated.
+   */
+  size_t used;
+  /**
+   * Largest value of @a used seen.
+   */
+  size_t peak;
+  /**
+   * Budget, SIZE_MAX if unlimited.
+   */
+  size_t limit;
+  /**
+   * Number of live allocations.
+   */
+  uint64_t allocations;
+} hsa_amd_memory_usage_t;
+
+/**
+ * @brief Called when an allocation would exceed a budget set with
+ * ::hsa_amd_memory_budget_set.
+ *
+ * @details Runs on the allocating thread, without runtime locks held, so it
+ * may free memory to make room. Returning true retries the charge, which calls
+ * the callback again if the budget is still exceeded; returning false fails
+ * the allocation with ::HSA_STATUS_ERROR_OUT_OF_RESOURCES.
+ *
+ * @param[in] tag Tag whose budget is exceeded, ::HSA_AMD_MEMORY_TAG_ALL for
+ * the pool total.
+ *
+ * @param[in] pool Memory pool of the allocation.
+ *
+ * @param[in] size Size of the allocation.
+ *
+ * @param[in] used Bytes charged to @p tag in @p pool.
+ *
+ * @param[in] limit Budget of @p tag in @p pool.
+ *
+ * @param[in] data User data passed to ::hsa_amd_memory_budget_set.
+ */
+typedef bool (*hsa_amd_memory_budget_callback_t)(uint32_t tag, hsa_amd_memory_pool_t pool,
+                                                 size_t size, size_t used, size_t limit,
+                                                 void* data);
+
+/**
+ * @brief Set the accounting tag that allocations of the calling thread are
+ * charged to.
+ *
+ * @details Memory allocated with ::hsa_amd_memory_pool_allocate or
+ * ::hsa_memory_allocate is charged to the tag of the allocating thread until
+ * it is freed, whichever thread frees it. Threads start with tag 0.
+ *
+ * @param[in] tag Accounting tag, such as a model or tenant id. Must not be
+ * ::HSA_AMD_MEMORY_TAG_ALL.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p tag is
+ * ::HSA_AMD_MEMORY_TAG_ALL.
+ */
+hsa_status_t HSA_API hsa_amd_memory_tag_set(uint32_t tag);
+
+/**
+ * @brief Limit the memory an accounting tag may allocate from a memory pool.
+ *
+ * @details Allocations that would take the tag, or the pool total for
+ * ::HSA_AMD_MEMORY_TAG_ALL, over @p limit run @p callback if set and otherwise
+ * fail with ::HSA_STATUS_ERROR_OUT_OF_RESOURCES without reaching the driver.
+ * Memory already allocated is not affected.
+ *
+ * @param[in] pool Memory pool.
+ *
+ * @param[in] tag Accounting tag, or ::HSA_AMD_MEMORY_TAG_ALL.
+ *
+ * @param[in] limit Budget in bytes, SIZE_MAX to remove it.
+ *
+ * @param[in] callback Callback run when the budget would be exceeded. May be
+ * NULL.
+ *
+ * @param[in] data User data passed to @p callback.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_MEMORY_POOL @p pool is invalid.
+ */
+hsa_status_t HSA_API hsa_amd_memory_budget_set(hsa_amd_memory_pool_t pool, uint32_t tag,
+                                               size_t limit,
+                                               hsa_amd_memory_budget_callback_t callback,
+                                               void* data);
+
+/**
+ * @brief Query the memory usage of an accounting tag in a memory pool.
+ *
+ * @param[in] pool Memory pool.
+ *
+ * @param[in] tag Accounting tag, or ::HSA_AMD_MEMORY_TAG_ALL for the usage of
+ * the whole process.
+ *
+ * @param[out] usage Usage of @p tag.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_MEMORY_POOL @p pool is invalid.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p usage is NULL.
+ */
+hsa_status_t HSA_API hsa_amd_memory_usage_get(hsa_amd_memory_pool_t pool, uint32_t tag,
+                                              hsa_amd_memory_usage_t* usage);
+
 /**
  * @brief Asynchronously copy a block of memory from the location pointed to by
  * @p src on the @p src_agent to the memory block pointed to by @p dst on the @p
@@ -852,57 +2352,169 @@ hsa_status_t HSA_API hsa_amd_memory_pool_free(void* ptr);
  * released the buffer to system scope prior to executing the copy API and the receiving device
  * must execute a system scope acquire fence prior to use of the destination buffer.
  *
- * @param[out] dst Buffer where the content is to be copied.
+ * @param[out] dst Buffer where the content is to be copied.
+ *
+ * @param[in] dst_agent Agent associated with the @p dst. The agent must be able to directly
+ * access both the source and destination buffers in their current locations.
+ *
+ * @param[in] src A valid pointer to the source of data to be copied. The source
+ * buffer must not overlap with the destination buffer, otherwise the copy will succeed
+ * but contents of @p dst is undefined.
+ *
+ * @param[in] src_agent Agent associated with the @p src. The agent must be able to directly
+ * access both the source and destination buffers in their current locations.
+ *
+ * @param[in] size Number of bytes to copy. If @p size is 0, no copy is
+ * performed and the function returns success. Copying a number of bytes larger
+ * than the size of the buffers pointed by @p dst or @p src results in undefined
+ * behavior.
+ *
+ * @param[in] num_dep_signals Number of dependent signals. Can be 0.
+ *
+ * @param[in] dep_signals List of signals that must be waited on before the copy
+ * operation starts. The copy will start after every signal has been observed with
+ * the value 0. The dependent signal should not include completion signal from hsa_amd_memory_async_copy
+ * operation to be issued in future as that can result in a deadlock. If @p num_dep_signals is 0, this
+ * argument is ignored.
+ *
+ * @param[in] completion_signal Signal used to indicate completion of the copy
+ * operation. When the copy operation is finished, the value of the signal is
+ * decremented. The runtime indicates that an error has occurred during the copy
+ * operation by setting the value of the completion signal to a negative
+ * number. The signal handle must not be 0.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully. The
+ * application is responsible for checking for asynchronous error conditions
+ * (see the description of @p completion_signal).
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_AGENT The agent is invalid.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_SIGNAL @p completion_signal is invalid.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT The source or destination
+ * pointers are NULL, or the completion signal is 0.
+ */
+hsa_status_t HSA_API
+    hsa_amd_memory_async_copy(void* dst, hsa_agent_t dst_agent, const void* src,
+                              hsa_agent_t src_agent, size_t size,
+                              uint32_t num_dep_signals,
+                              const hsa_signal_t* dep_signals,
+                              hsa_signal_t completion_signal);
+
+/**
+ * @brief Asynchronously read a range of a file into memory accessible to a GPU.
+ *
+ * @details The file is read in chunks into a ring of pinned system memory
+ * staging buffers, and each chunk is copied to @p dst by the DMA engines of
+ * @p dst_agent while the next chunks are read. This avoids an intermediate
+ * host copy of the data and the cost of registering the destination.
+ *
+ * The read starts after every signal in @p dep_signals has been observed with
+ * the value 0, and runs on a runtime host thread. Staging buffers are page
+ * aligned and chunks are a multiple of the page size except the last, so @p fd
+ * may be opened with O_DIRECT as long as @p file_offset and @p size meet the
+ * file system's alignment requirements.
+ *
+ * @param[in] fd File descriptor open for reading. It must stay open until the
+ * read has completed.
+ *
+ * @param[in] file_offset Offset in the file of the first byte to read.
+ *
+ * @param[in] dst Destination of the data. The buffer must be accessible to
+ * @p dst_agent.
+ *
+ * @param[in] size Number of bytes to read.
+ *
+ * @param[in] dst_agent GPU agent copying the data to @p dst.
+ *
+ * @param[in] num_dep_signals Number of dependent signals. Can be 0.
+ *
+ * @param[in] dep_signals List of signals that must be waited on before the read
+ * starts. If @p num_dep_signals is 0, this argument is ignored.
+ *
+ * @param[in] completion_signal Signal decremented when the read has finished.
+ * If the file ends before @p size bytes or an I/O or copy error occurs the
+ * signal value is left negative.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The read has been queued.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_AGENT @p dst_agent is invalid or is not a
+ * GPU.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_SIGNAL @p completion_signal or a
+ * dependent signal is invalid.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p fd is negative, @p dst is
+ * NULL, or @p dep_signals does not match @p num_dep_signals.
+ *
+ * @retval ::HSA_STATUS_ERROR_OUT_OF_RESOURCES The runtime host threads could
+ * not be started.
+ */
+hsa_status_t HSA_API hsa_amd_memory_file_read_async(int fd, uint64_t file_offset, void* dst,
+                                                    size_t size, hsa_agent_t dst_agent,
+                                                    uint32_t num_dep_signals,
+                                                    const hsa_signal_t* dep_signals,
+                                                    hsa_signal_t completion_signal);
+
+/**
+ * @brief Asynchronously write memory accessible to a GPU to a range of a file.
+ *
+ * @details The reverse of ::hsa_amd_memory_file_read_async, intended for
+ * checkpoints. Chunks of @p src are copied by the DMA engines of @p src_agent
+ * into pinned staging buffers and written to @p fd as each copy lands, while
+ * the following chunks are still being copied. Alignment requirements for
+ * O_DIRECT descriptors are as for ::hsa_amd_memory_file_read_async.
  *
- * @param[in] dst_agent Agent associated with the @p dst. The agent must be able to directly
- * access both the source and destination buffers in their current locations.
+ * @param[in] fd File descriptor open for writing. It must stay open until the
+ * write has completed.
  *
- * @param[in] src A valid pointer to the source of data to be copied. The source
- * buffer must not overlap with the destination buffer, otherwise the copy will succeed
- * but contents of @p dst is undefined.
+ * @param[in] file_offset Offset in the file of the first byte to write.
  *
- * @param[in] src_agent Agent associated with the @p src. The agent must be able to directly
- * access both the source and destination buffers in their current locations.
+ * @param[in] src Source of the data. The buffer must be accessible to
+ * @p src_agent and must not be modified until the write has completed.
  *
- * @param[in] size Number of bytes to copy. If @p size is 0, no copy is
- * performed and the function returns success. Copying a number of bytes larger
- * than the size of the buffers pointed by @p dst or @p src results in undefined
- * behavior.
+ * @param[in] size Number of bytes to write.
+ *
+ * @param[in] src_agent GPU agent copying the data from @p src.
  *
  * @param[in] num_dep_signals Number of dependent signals. Can be 0.
  *
- * @param[in] dep_signals List of signals that must be waited on before the copy
- * operation starts. The copy will start after every signal has been observed with
- * the value 0. The dependent signal should not include completion signal from hsa_amd_memory_async_copy
- * operation to be issued in future as that can result in a deadlock. If @p num_dep_signals is 0, this
- * argument is ignored.
+ * @param[in] dep_signals List of signals that must be waited on before the
+ * write starts. If @p num_dep_signals is 0, this argument is ignored.
  *
- * @param[in] completion_signal Signal used to indicate completion of the copy
- * operation. When the copy operation is finished, the value of the signal is
- * decremented. The runtime indicates that an error has occurred during the copy
- * operation by setting the value of the completion signal to a negative
- * number. The signal handle must not be 0.
+ * @param[in] completion_signal Signal decremented when the data has been
+ * handed to the file. If an I/O or copy error occurs the signal value is left
+ * negative.
  *
- * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully. The
- * application is responsible for checking for asynchronous error conditions
- * (see the description of @p completion_signal).
+ * @retval ::HSA_STATUS_SUCCESS The write has been queued.
  *
  * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
  * initialized.
  *
- * @retval ::HSA_STATUS_ERROR_INVALID_AGENT The agent is invalid.
+ * @retval ::HSA_STATUS_ERROR_INVALID_AGENT @p src_agent is invalid or is not a
+ * GPU.
  *
- * @retval ::HSA_STATUS_ERROR_INVALID_SIGNAL @p completion_signal is invalid.
+ * @retval ::HSA_STATUS_ERROR_INVALID_SIGNAL @p completion_signal or a
+ * dependent signal is invalid.
  *
- * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT The source or destination
- * pointers are NULL, or the completion signal is 0.
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p fd is negative, @p src is
+ * NULL, or @p dep_signals does not match @p num_dep_signals.
+ *
+ * @retval ::HSA_STATUS_ERROR_OUT_OF_RESOURCES The runtime host threads could
+ * not be started.
  */
-hsa_status_t HSA_API
-    hsa_amd_memory_async_copy(void* dst, hsa_agent_t dst_agent, const void* src,
-                              hsa_agent_t src_agent, size_t size,
-                              uint32_t num_dep_signals,
-                              const hsa_signal_t* dep_signals,
-                              hsa_signal_t completion_signal);
+hsa_status_t HSA_API hsa_amd_memory_file_write_async(int fd, uint64_t file_offset,
+                                                     const void* src, size_t size,
+                                                     hsa_agent_t src_agent,
+                                                     uint32_t num_dep_signals,
+                                                     const hsa_signal_t* dep_signals,
+                                                     hsa_signal_t completion_signal);
 
 /*
 [Provisional API]
@@ -941,6 +2553,48 @@ hsa_status_t HSA_API hsa_amd_memory_async_copy_rect(
     hsa_amd_copy_direction_t dir, uint32_t num_dep_signals, const hsa_signal_t* dep_signals,
     hsa_signal_t completion_signal);
 
+/*
+[Provisional API]
+Linear copy descriptor for hsa_amd_memory_async_copy_batch.
+*/
+typedef struct hsa_amd_memory_copy_desc_s {
+  void* dst;
+  const void* src;
+  size_t size;
+} hsa_amd_memory_copy_desc_t;
+
+/*
+[Provisional API]
+Batched memory copy API.  Submits @p num_copies linear copies that share the same agents,
+dependencies and completion signal.  Each copy must meet the requirements of
+hsa_amd_memory_async_copy.  Copies within a batch may execute in any order and must not overlap.
+The copies are started after every signal in @p dep_signals has been observed with the value 0 and
+@p completion_signal is decremented once, after all copies have finished.  The whole batch is
+written to the copy engine or blit queue with a single submission, blit kernel copies of one batch
+run concurrently.
+*/
+hsa_status_t HSA_API hsa_amd_memory_async_copy_batch(
+    uint32_t num_copies, const hsa_amd_memory_copy_desc_t* copies, hsa_agent_t dst_agent,
+    hsa_agent_t src_agent, uint32_t num_dep_signals, const hsa_signal_t* dep_signals,
+    hsa_signal_t completion_signal);
+
+/*
+[Provisional API]
+Multicast memory copy API.  Copies @p size bytes from @p src to each of the @p num_dsts buffers in
+@p dsts, the buffer dsts[i] being associated with dst_agents[i].  Each destination must meet the
+requirements of hsa_amd_memory_async_copy for a copy from @p src.  Destination GPUs directly
+connected by XGMI to a destination GPU are fed from that GPU instead of from @p src when it has
+access to their buffer, so the source is read fewer times than there are destinations.  The copy is
+pipelined in chunks across the hops.  Destinations must not overlap each other or the source.
+The copies are started after every signal in @p dep_signals has been observed with the value 0 and
+@p completion_signal is decremented once, after all destinations have been written.  As with
+hsa_amd_memory_async_copy, a negative completion signal value reports an error during the copy.
+*/
+hsa_status_t HSA_API hsa_amd_memory_async_copy_multicast(
+    uint32_t num_dsts, void* const* dsts, const hsa_agent_t* dst_agents, const void* src,
+    hsa_agent_t src_agent, size_t size, uint32_t num_dep_signals,
+    const hsa_signal_t* dep_signals, hsa_signal_t completion_signal);
+
 /**
  * @brief Type of accesses to a memory pool from a given agent.
  */
@@ -1152,6 +2806,52 @@ hsa_status_t HSA_API
     hsa_amd_agents_allow_access(uint32_t num_agents, const hsa_agent_t* agents,
                                 const uint32_t* flags, const void* ptr);
 
+/**
+ * @brief Enable direct access to several buffers from a given set of agents.
+ *
+ * @details Equivalent to calling ::hsa_amd_agents_allow_access for each
+ * pointer in @p ptrs, but the agents are validated and the runtime locks
+ * taken once per memory pool involved, and buffers sharing an underlying
+ * allocation block are mapped together. Intended for sharing an arena of
+ * many buffers with peer agents.
+ *
+ * All pointers are validated before access to any buffer is changed. If
+ * mapping fails part way through, some of the buffers may already have had
+ * their access updated.
+ *
+ * @param[in] num_agents Size of @p agents.
+ *
+ * @param[in] agents List of agents.
+ *
+ * @param[in] flags Must be NULL.
+ *
+ * @param[in] num_ptrs Size of @p ptrs.
+ *
+ * @param[in] ptrs List of buffers previously allocated using
+ * ::hsa_amd_memory_pool_allocate.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p num_agents or @p num_ptrs is
+ * 0, @p agents or @p ptrs is NULL, an element of @p ptrs is NULL, or @p flags
+ * is not NULL.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_AGENT An agent in @p agents is invalid.
+ *
+ * @retval ::HSA_STATUS_ERROR A pointer in @p ptrs was not allocated by the
+ * runtime.
+ *
+ * @retval ::HSA_STATUS_ERROR_OUT_OF_RESOURCES Mapping a buffer failed.
+ */
+hsa_status_t HSA_API hsa_amd_agents_allow_access_batch(uint32_t num_agents,
+                                                       const hsa_agent_t* agents,
+                                                       const uint32_t* flags,
+                                                       uint32_t num_ptrs,
+                                                       const void* const* ptrs);
+
 /**
  * @brief Query if buffers currently located in some memory pool can be
  * relocated to a destination memory pool.
@@ -1224,6 +2924,52 @@ hsa_status_t HSA_API hsa_amd_memory_migrate(const void* ptr,
                                             hsa_amd_memory_pool_t memory_pool,
                                             uint32_t flags);
 
+/**
+ * @brief Prepare a range of an allocation for use by an agent,
+ * asynchronously.
+ *
+ * @details Once every signal in @p dep_signals has reached zero, the range is
+ * made resident for @p agent and @p completion_signal is decremented.  System
+ * memory allocations that are mapped on first use (HSA_LAZY_SYSTEM_MAPPING)
+ * are mapped to @p agent ahead of the first copy or kernel using them.
+ * Other allocations are already resident and only signal completion.  The
+ * mappings in effect are reported by ::hsa_amd_pointer_info.
+ *
+ * The data is not moved, the virtual address and the memory pool of the
+ * allocation stay the same.
+ *
+ * @param[in] ptr Start of the range, within an allocation made by
+ * ::hsa_amd_memory_pool_allocate.
+ *
+ * @param[in] size Size of the range in bytes.
+ *
+ * @param[in] agent Agent that will access the range.
+ *
+ * @param[in] num_dep_signals Number of dependent signals. Can be 0.
+ *
+ * @param[in] dep_signals List of signals that must be waited on before the
+ * range is prepared. May be NULL if @p num_dep_signals is 0.
+ *
+ * @param[in] completion_signal Signal decremented once the range is ready.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The prefetch has been queued.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_AGENT The agent is invalid.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_SIGNAL A signal is invalid.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT The range is not within an
+ * allocation, or @p num_dep_signals is 0 while @p dep_signals is not NULL or
+ * the opposite.
+ */
+hsa_status_t HSA_API hsa_amd_memory_async_prefetch(const void* ptr, size_t size,
+                                                   hsa_agent_t agent, uint32_t num_dep_signals,
+                                                   const hsa_signal_t* dep_signals,
+                                                   hsa_signal_t completion_signal);
+
 /**
  *
  * @brief Pin a host pointer allocated by C/C++ or OS allocator (i.e. ordinary system DRAM) and
@@ -1329,6 +3075,31 @@ hsa_status_t HSA_API hsa_amd_memory_lock_to_pool(void* host_ptr, size_t size, hs
  */
 hsa_status_t HSA_API hsa_amd_memory_unlock(void* host_ptr);
 
+/**
+ *
+ * @brief Drop cached registrations of host memory in a range.
+ *
+ * @details When HSA_PIN_CACHE_SIZE is set, ranges pinned via
+ * ::hsa_amd_memory_lock or ::hsa_amd_memory_lock_to_pool stay registered after
+ * they are unpinned so later locks of the same memory are cheap.  The runtime
+ * cannot observe the memory being unmapped, so the application must call this
+ * function before releasing memory it has locked to the OS.  Ranges which are
+ * still pinned are released by their last ::hsa_amd_memory_unlock.  The call is
+ * a no-op when the cache is disabled.
+ *
+ * @param[in] host_ptr Start of the range.
+ *
+ * @param[in] size Size of the range in bytes.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p host_ptr is NULL.
+ */
+hsa_status_t HSA_API hsa_amd_memory_lock_cache_invalidate(void* host_ptr, size_t size);
+
 /**
  * @brief Sets the first @p count of uint32_t of the block of memory pointed by
  * @p ptr to the specified @p value.
@@ -1354,6 +3125,62 @@ hsa_status_t HSA_API hsa_amd_memory_unlock(void* host_ptr);
 hsa_status_t HSA_API
     hsa_amd_memory_fill(void* ptr, uint32_t value, size_t count);
 
+/**
+ * @brief Asynchronously sets @p count elements of @p value_size bytes, starting
+ * at @p ptr, to the low @p value_size bytes of @p value.
+ *
+ * @details The fill starts after every signal in @p dep_signals has been
+ * observed with the value 0, and @p completion_signal is decremented once the
+ * fill has finished. Memory accessible to a GPU is filled by that GPU, on its
+ * SDMA engine where one is used for device to host copies, otherwise memory is
+ * filled by host threads. The fill must start and end on a 4 byte boundary.
+ *
+ * @param[in] ptr Pointer to the block of memory to fill.
+ *
+ * @param[in] value Value to be set.
+ *
+ * @param[in] value_size Size of the fill pattern in bytes, 1, 2 or 4.
+ *
+ * @param[in] count Number of elements to be set to the value.
+ *
+ * @param[in] num_dep_signals Number of dependent signals. Can be 0.
+ *
+ * @param[in] dep_signals List of signals that must be waited on before the
+ * fill starts. Can be NULL if @p num_dep_signals is 0.
+ *
+ * @param[in] completion_signal Signal decremented when the fill has finished.
+ *
+ * @retval HSA_STATUS_SUCCESS The fill has been submitted.
+ *
+ * @retval HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval HSA_STATUS_ERROR_INVALID_SIGNAL @p completion_signal or a signal in
+ * @p dep_signals is invalid.
+ *
+ * @retval HSA_STATUS_ERROR_INVALID_ARGUMENT @p ptr is NULL, @p value_size is
+ * not 1, 2 or 4, or the fill does not start and end on a 4 byte boundary.
+ *
+ * @retval HSA_STATUS_ERROR_INVALID_ALLOCATION if the given memory
+ * region was not allocated with HSA runtime APIs.
+ */
+hsa_status_t HSA_API hsa_amd_memory_async_fill(void* ptr, uint32_t value, uint32_t value_size,
+                                               size_t count, uint32_t num_dep_signals,
+                                               const hsa_signal_t* dep_signals,
+                                               hsa_signal_t completion_signal);
+
+/*
+[Provisional API]
+Pitched memory fill API.  Sets the @p range of @p dst at @p dst_offset as
+hsa_amd_memory_async_fill does.  Offsets and range carry x in bytes, y and z in rows and layers.
+Base, pitch, slice, x offset and x range must be multiples of 4 bytes.  The rect must lie within
+a single allocation.
+*/
+hsa_status_t HSA_API hsa_amd_memory_async_fill_rect(
+    const hsa_pitched_ptr_t* dst, const hsa_dim3_t* dst_offset, const hsa_dim3_t* range,
+    uint32_t value, uint32_t value_size, uint32_t num_dep_signals,
+    const hsa_signal_t* dep_signals, hsa_signal_t completion_signal);
+
 /**
  * @brief Maps an interop object into the HSA flat address space and establishes
  * memory residency.  The metadata pointer is valid during the lifetime of the
@@ -1610,6 +3437,10 @@ typedef struct hsa_amd_ipc_memory_s {
  * Repeated calls for the same allocation may, but are not required to, return
  * unique handles.
  *
+ * Device memory suballocated from a larger block shares the whole block with
+ * the importer.  Allocate with ::HSA_AMD_MEMORY_POOL_IPC_FLAG to share only
+ * the allocation.
+ *
  * @param[in] ptr Pointer to memory allocated via ROCr APIs to prepare for
  * sharing.
  *
@@ -1864,6 +3695,61 @@ typedef enum hsa_amd_queue_priority_s {
 hsa_status_t HSA_API hsa_amd_queue_set_priority(hsa_queue_t* queue,
                                                 hsa_amd_queue_priority_t priority);
 
+/**
+ * @brief Scheduling class of a queue, see ::hsa_amd_queue_set_class.
+ */
+typedef enum hsa_amd_queue_class_s {
+  /**
+  Priority and CU mask are left to the application.
+  */
+  HSA_AMD_QUEUE_CLASS_DEFAULT = 0,
+  /**
+  Protected from batch queues of its agent while it has packets pending.
+  */
+  HSA_AMD_QUEUE_CLASS_LATENCY = 1,
+  /**
+  Yields priority and CUs to latency class queues of its agent with packets
+  pending.
+  */
+  HSA_AMD_QUEUE_CLASS_BATCH = 2,
+} hsa_amd_queue_class_t;
+
+/**
+ * @brief Let the runtime manage the priority and CU mask of a queue.
+ *
+ * @details The runtime periodically samples the backlog, write index minus
+ * read index, of the classified queues of each agent.  While a latency class
+ * queue has a backlog, latency queues run at high priority on all CUs and
+ * batch queues run at low priority on a share of the CUs proportional to the
+ * sum of their weights.  Once latency queues stay drained, every classified
+ * queue returns to normal priority on all CUs.  The sampling period is set by
+ * the HSA_QUEUE_SCHED_INTERVAL environment variable in microseconds.
+ *
+ * Priorities and CU masks set by the application on a classified queue are
+ * overridden.
+ *
+ * @param[in] queue Compute queue.
+ *
+ * @param[in] queue_class Scheduling class.  ::HSA_AMD_QUEUE_CLASS_DEFAULT
+ * releases the queue and restores normal priority on all CUs.
+ *
+ * @param[in] weight Relative share of the queue within its class, 0 is
+ * treated as 1.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The class has been set.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_QUEUE @p queue is not a compute queue
+ * with its own hardware queue.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p queue_class is not a valid
+ * value from ::hsa_amd_queue_class_t.
+ */
+hsa_status_t HSA_API hsa_amd_queue_set_class(hsa_queue_t* queue,
+                                             hsa_amd_queue_class_t queue_class, uint32_t weight);
+
 /**
  * @brief Deallocation notifier function type.
  */
@@ -1924,6 +3810,247 @@ hsa_status_t HSA_API hsa_amd_register_deallocation_callback(void* ptr,
 hsa_status_t HSA_API hsa_amd_deregister_deallocation_callback(void* ptr,
                                                       hsa_amd_deallocation_callback_t callback);
 
+/**
+ * @brief Load a program code object into an executable for several agents.
+ *
+ * @details Equivalent to calling ::hsa_executable_load_agent_code_object once
+ * per agent, except that the code object is parsed once and, for code object
+ * v2 and later, the memory allocation, copy and relocation of each agent's
+ * segments run concurrently.
+ *
+ * @param[in] executable Executable.
+ *
+ * @param[in] num_agents Number of entries in @p agents.
+ *
+ * @param[in] agents Distinct agents to load the code object for.
+ *
+ * @param[in] code_object_reader A code object reader that holds the code
+ * object to load.
+ *
+ * @param[in] options Standard and vendor-specific options. May be NULL.
+ *
+ * @param[out] loaded_code_objects If not NULL, array of @p num_agents entries
+ * that receives the handle of the loaded code object of each agent.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The code object was loaded for every agent.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_EXECUTABLE The executable is invalid.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_CODE_OBJECT_READER @p code_object_reader
+ * is invalid.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p agents is NULL,
+ * @p num_agents is 0 or @p agents contains duplicates.
+ *
+ * @retval ::HSA_STATUS_ERROR_FROZEN_EXECUTABLE The executable is frozen.
+ */
+hsa_status_t HSA_API hsa_amd_executable_load_agent_code_objects(
+    hsa_executable_t executable, uint32_t num_agents, const hsa_agent_t* agents,
+    hsa_code_object_reader_t code_object_reader, const char* options,
+    hsa_loaded_code_object_t* loaded_code_objects);
+
+/**
+ * @brief Launch attributes of one kernel of a frozen executable, as returned
+ * by ::hsa_amd_executable_get_kernels.
+ */
+typedef struct hsa_amd_executable_kernel_s {
+  /**
+   * 64-bit FNV-1a hash of the bytes of the name accepted by
+   * ::hsa_executable_get_symbol_by_name for this kernel, without the
+   * terminating NUL.
+   */
+  uint64_t name_hash;
+  /**
+   * Value of ::HSA_EXECUTABLE_SYMBOL_INFO_KERNEL_OBJECT.
+   */
+  uint64_t kernel_object;
+  /**
+   * The kernel's symbol, for any other query.
+   */
+  hsa_executable_symbol_t symbol;
+  /**
+   * Agent the kernel was loaded for.
+   */
+  hsa_agent_t agent;
+  uint32_t kernarg_segment_size;
+  uint32_t kernarg_segment_alignment;
+  uint32_t group_segment_size;
+  uint32_t private_segment_size;
+  /**
+   * Non-zero if the kernel uses a dynamic call stack.
+   */
+  uint8_t is_dynamic_callstack;
+  uint8_t reserved[15];
+} hsa_amd_executable_kernel_t;
+
+/**
+ * @brief Retrieve the launch attributes of every kernel in a frozen executable
+ * with a single call.
+ *
+ * @param[in] executable Frozen executable.
+ *
+ * @param[out] kernels Array of @p count entries to fill, in no particular
+ * order. May be NULL to query the number of kernels only.
+ *
+ * @param[in,out] count On input, the number of entries in @p kernels. On
+ * output, the number of kernels in the executable. At most the input number of
+ * entries are written.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_EXECUTABLE The executable is invalid or
+ * not frozen.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p count is NULL.
+ */
+hsa_status_t HSA_API hsa_amd_executable_get_kernels(hsa_executable_t executable,
+                                                    hsa_amd_executable_kernel_t* kernels,
+                                                    uint32_t* count);
+
+/**
+ * @brief Attributes of one memory pool, as returned by
+ * ::hsa_amd_agent_get_memory_pools.
+ */
+typedef struct hsa_amd_memory_pool_desc_s {
+  hsa_amd_memory_pool_t memory_pool;
+  /**
+   * Value of ::HSA_AMD_MEMORY_POOL_INFO_SEGMENT.
+   */
+  hsa_amd_segment_t segment;
+  /**
+   * Value of ::HSA_AMD_MEMORY_POOL_INFO_GLOBAL_FLAGS.
+   */
+  uint32_t global_flags;
+  size_t size;
+  /**
+   * Value of ::HSA_REGION_INFO_ALLOC_MAX_SIZE.
+   */
+  size_t alloc_max_size;
+  size_t alloc_granule;
+  size_t alloc_alignment;
+  /**
+   * Value of ::HSA_AMD_AGENT_MEMORY_POOL_INFO_ACCESS for the accessing agent.
+   */
+  hsa_amd_memory_pool_access_t access;
+  /**
+   * Value of ::HSA_AMD_AGENT_MEMORY_POOL_INFO_NUM_LINK_HOPS for the accessing
+   * agent.
+   */
+  uint32_t num_link_hops;
+  /**
+   * Non-zero if ::HSA_AMD_MEMORY_POOL_INFO_RUNTIME_ALLOC_ALLOWED is set.
+   */
+  uint8_t alloc_allowed;
+  /**
+   * Non-zero if ::HSA_AMD_MEMORY_POOL_INFO_ACCESSIBLE_BY_ALL is set.
+   */
+  uint8_t accessible_by_all;
+  uint8_t reserved[14];
+} hsa_amd_memory_pool_desc_t;
+
+/**
+ * @brief Retrieve the attributes of every memory pool associated with an agent
+ * with a single call.
+ *
+ * @details The pools are the ones visited by
+ * ::hsa_amd_agent_iterate_memory_pools, in the same order.
+ *
+ * @param[in] agent Agent owning the memory pools.
+ *
+ * @param[in] accessing_agent Agent for which the access and link fields are
+ * reported.
+ *
+ * @param[out] memory_pools Array of @p count entries to fill. May be NULL to
+ * query the number of memory pools only.
+ *
+ * @param[in,out] count On input, the number of entries in @p memory_pools. On
+ * output, the number of memory pools associated with @p agent. At most the
+ * input number of entries are written.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_AGENT @p agent or @p accessing_agent is
+ * invalid.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p count is NULL.
+ */
+hsa_status_t HSA_API hsa_amd_agent_get_memory_pools(hsa_agent_t agent,
+                                                    hsa_agent_t accessing_agent,
+                                                    hsa_amd_memory_pool_desc_t* memory_pools,
+                                                    uint32_t* count);
+
+/*
+[Provisional API]
+Classes of threads created by the runtime.
+*/
+typedef enum {
+  /* Threads watching the signals of asynchronous signal handlers. */
+  HSA_AMD_THREAD_ASYNC_EVENTS = 0,
+  /* Workers running asynchronous signal handlers, see HSA_ASYNC_HANDLER_WORKERS. */
+  HSA_AMD_THREAD_ASYNC_HANDLERS = 1,
+  /* Workers processing host queues. */
+  HSA_AMD_THREAD_HOST_QUEUE = 2,
+  /* Workers performing CPU copies and host tasks. */
+  HSA_AMD_THREAD_CPU_COPY = 3,
+  /* Thread sampling queues for the queue scheduler. */
+  HSA_AMD_THREAD_QUEUE_SCHEDULER = 4
+} hsa_amd_thread_class_t;
+
+/*
+[Provisional API]
+Scheduling classes of runtime threads.  The runtime does not change the class of threads left with
+HSA_AMD_THREAD_SCHED_DEFAULT.
+*/
+typedef enum {
+  HSA_AMD_THREAD_SCHED_DEFAULT = 0,
+  HSA_AMD_THREAD_SCHED_NORMAL = 1,
+  HSA_AMD_THREAD_SCHED_BATCH = 2,
+  HSA_AMD_THREAD_SCHED_IDLE = 3,
+  HSA_AMD_THREAD_SCHED_FIFO = 4,
+  HSA_AMD_THREAD_SCHED_RR = 5
+} hsa_amd_thread_sched_t;
+
+/*
+[Provisional API]
+Placement and scheduling of a class of runtime threads.
+*/
+typedef struct hsa_amd_thread_policy_s {
+  /* CPUs the threads may run on, NULL when num_cpus is 0 to keep the affinity. */
+  const uint32_t* cpus;
+  uint32_t num_cpus;
+  /*
+  HSA_AGENT_INFO_NODE of a CPU agent whose cores the threads run on when num_cpus is 0, -1 to
+  keep the affinity.
+  */
+  int32_t numa_node;
+  hsa_amd_thread_sched_t sched;
+  /*
+  Nice value for the normal and batch classes, real time priority for the FIFO and round robin
+  classes.  Ignored for the other classes.
+  */
+  int32_t priority;
+} hsa_amd_thread_policy_t;
+
+/*
+[Provisional API]
+Sets the CPU affinity and scheduling of the runtime threads of @p thread_class, replacing any policy
+given by HSA_THREAD_POLICY.  Threads apply the policy themselves, existing threads when they next
+wake, so it may not be in effect when the call returns.  Settings the operating system refuses, such
+as real time classes without the privilege, leave the threads unchanged.  Fields left unset do not
+revert earlier settings of running threads.
+*/
+hsa_status_t HSA_API hsa_amd_thread_policy_set(hsa_amd_thread_class_t thread_class,
+                                               const hsa_amd_thread_policy_t* policy);
+
 #ifdef __cplusplus
 }  // end extern "C" block
 #endif
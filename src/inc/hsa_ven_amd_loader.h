@@ -365,7 +365,17 @@ typedef enum hsa_ven_amd_loader_loaded_code_object_info_e {
    * value of this attribute is only defined if the executable in which the code
    * object is loaded is froozen. The type of this attribute is ::uint64_t.
    */
-  HSA_VEN_AMD_LOADER_LOADED_CODE_OBJECT_INFO_LOAD_SIZE = 10
+  HSA_VEN_AMD_LOADER_LOADED_CODE_OBJECT_INFO_LOAD_SIZE = 10,
+  /**
+   * Number of relocations applied while loading the code object. The type of
+   * this attribute is ::uint64_t.
+   */
+  HSA_VEN_AMD_LOADER_LOADED_CODE_OBJECT_INFO_RELOCATION_COUNT = 11,
+  /**
+   * Time spent applying relocations while loading the code object, in
+   * nanoseconds. The type of this attribute is ::uint64_t.
+   */
+  HSA_VEN_AMD_LOADER_LOADED_CODE_OBJECT_INFO_RELOCATION_TIME = 12
 } hsa_ven_amd_loader_loaded_code_object_info_t;
 
 /**
@@ -693,7 +693,12 @@ namespace amd {
       bool copyToBuffer(void** buf, size_t* size = 0) override;
       bool copyToBuffer(void* buf, size_t size) override;
 
-      const char* data() override { assert(buffer); return buffer; }
+      const char* data() override
+      {
+        if (buffer) { return buffer; }
+        assert(!image.empty());
+        return image.data();
+      }
       uint64_t size() override;
 
       bool push();
@@ -749,6 +754,8 @@ namespace amd {
       bool frozen;
       int elfclass;
       FileImage img;
+      // Contiguous file image serialized by the last push().
+      std::vector<char> image;
       const char* buffer;
       size_t bufferSize;
       Elf* e;
@@ -766,6 +773,8 @@ namespace amd {
       bool elfEnd();
       bool push0();
       bool pullElf();
+      bool writeImage();
+      bool imageWrite(uint64_t offset, unsigned encoding, Elf_Type type, const void* mem, size_t size);
 
       friend class GElfSection;
       friend class GElfSymbolTable;
@@ -985,6 +994,13 @@ namespace amd {
 
     bool GElfSection::getData(uint64_t offset, void* dest, uint64_t size)
     {
+      // Sections pulled from an image are read from the data captured by pull, without calling
+      // back into libelf, so that loads for several agents can share one image.
+      if (data0.size() != 0) {
+        if (offset > data0.size() || size > data0.size() - offset) { return false; }
+        memcpy(dest, data0.raw() + offset, size);
+        return true;
+      }
       Elf_Data* edata = 0;
       uint64_t coffset = 0;
       uint64_t csize = 0;
@@ -1171,25 +1187,38 @@ namespace amd {
       return true;
     }
 
+    static bool FindNote(const char* notes, uint64_t size, const std::string& name, uint32_t type,
+                         void** desc, uint32_t* desc_size)
+    {
+      uint32_t note_offset = 0;
+      while (note_offset < size) {
+        const char* notec = notes + note_offset;
+        const Elf64_Nhdr* note = (const Elf64_Nhdr*) notec;
+        if (type == note->n_type) {
+          std::string note_name = GetNoteString(note->n_namesz, notec + sizeof(Elf64_Nhdr));
+          if (name == note_name) {
+            *desc = const_cast<char*>(notec) + sizeof(Elf64_Nhdr) + alignUp(note->n_namesz, 4);
+            *desc_size = note->n_descsz;
+            return true;
+          }
+        }
+        note_offset += sizeof(Elf64_Nhdr) + alignUp(note->n_namesz, 4) + alignUp(note->n_descsz, 4);
+      }
+      return false;
+    }
+
     bool GElfNoteSection::getNote(const std::string& name, uint32_t type, void** desc, uint32_t* desc_size)
     {
+      // Notes of a pulled image are walked in the data captured by pull, as in getData.
+      if (data0.size() != 0) {
+        return FindNote((const char*) data0.raw(), data0.size(), name, type, desc, desc_size);
+      }
       Elf_Data* data = 0;
       Elf_Scn *scn = elf_getscn(elf->e, ndxscn);
       assert(scn);
       while ((data = elf_getdata(scn, data)) != 0) {
-        uint32_t note_offset = 0;
-        while (note_offset < data->d_size) {
-          char* notec = (char *) data->d_buf + note_offset;
-          Elf64_Nhdr* note = (Elf64_Nhdr*) notec;
-          if (type == note->n_type) {
-            std::string note_name = GetNoteString(note->n_namesz, notec + sizeof(Elf64_Nhdr));
-            if (name == note_name) {
-              *desc = notec + sizeof(Elf64_Nhdr) + alignUp(note->n_namesz, 4);
-              *desc_size = note->n_descsz;
-              return true;
-            }
-          }
-          note_offset += sizeof(Elf64_Nhdr) + alignUp(note->n_namesz, 4) + alignUp(note->n_descsz, 4);
+        if (FindNote((const char*) data->d_buf, data->d_size, name, type, desc, desc_size)) {
+          return true;
         }
       }
       return false;
@@ -1335,7 +1364,7 @@ namespace amd {
         return !out.fail();
       } else {
         if (!push()) { return false; }
-        return img.writeTo(filename);
+        return writeTo(filename);
       }
     }
 
@@ -1455,6 +1484,8 @@ namespace amd {
     {
       if (buffer) {
         return ElfSize(buffer);
+      } else if (!image.empty()) {
+        return image.size();
       } else {
         return img.getSize();
       }
@@ -1492,7 +1523,72 @@ namespace amd {
     bool GElfImage::push()
     {
       if (!push0()) { return false; }
-      if (elf_update(e, ELF_C_WRITE) < 0) { return elfError("elf_update (2) failed"); }
+      return writeImage();
+    }
+
+    bool GElfImage::imageWrite(uint64_t offset, unsigned encoding, Elf_Type type, const void* mem, size_t size)
+    {
+      if (size == 0) { return true; }
+      if (offset > image.size() || size > image.size() - offset) {
+        out << "Error: ELF image write out of bounds" << std::endl;
+        return false;
+      }
+      Elf_Data src, dst;
+      memset(&src, 0, sizeof(src));
+      memset(&dst, 0, sizeof(dst));
+      src.d_buf = const_cast<void*>(mem);
+      src.d_type = type;
+      src.d_size = size;
+      src.d_version = EV_CURRENT;
+      dst.d_buf = &image[offset];
+      dst.d_size = image.size() - offset;
+      dst.d_version = EV_CURRENT;
+      if (!gelf_xlatetof(e, &dst, &src, encoding)) { return elfError("gelf_xlatetof failed"); }
+      return true;
+    }
+
+    // Serializes the laid out image into a contiguous buffer, the same bytes
+    // elf_update(ELF_C_WRITE) would write, without a file round trip.
+    bool GElfImage::writeImage()
+    {
+      off_t imageSize = elf_update(e, ELF_C_NULL);
+      if (imageSize < 0) { return elfError("elf_update (2) failed"); }
+      GElf_Ehdr eh;
+      if (!gelf_getehdr(e, &eh)) { return elfError("gelf_getehdr failed"); }
+      image.assign((size_t) imageSize, 0);
+
+      const unsigned encoding = eh.e_ident[EI_DATA];
+      const bool is64 = elfclass == ELFCLASS64;
+      const void* mem = is64 ? (const void*) elf64_getehdr(e) : (const void*) elf32_getehdr(e);
+      if (!imageWrite(0, encoding, ELF_T_EHDR, mem, is64 ? sizeof(Elf64_Ehdr) : sizeof(Elf32_Ehdr))) { return false; }
+
+      size_t phnum;
+      if (elf_getphdrnum(e, &phnum) < 0) { return elfError("elf_getphdrnum failed"); }
+      if (phnum > 0) {
+        mem = is64 ? (const void*) elf64_getphdr(e) : (const void*) elf32_getphdr(e);
+        if (!mem) { return elfError("elf_getphdr failed"); }
+        size_t phdrSize = is64 ? sizeof(Elf64_Phdr) : sizeof(Elf32_Phdr);
+        if (!imageWrite(eh.e_phoff, encoding, ELF_T_PHDR, mem, phnum * phdrSize)) { return false; }
+      }
+
+      size_t shnum;
+      if (elf_getshdrnum(e, &shnum) < 0) { return elfError("elf_getshdrnum failed"); }
+      const size_t shdrSize = is64 ? sizeof(Elf64_Shdr) : sizeof(Elf32_Shdr);
+      for (size_t n = 0; n < shnum; ++n) {
+        Elf_Scn* scn = elf_getscn(e, n);
+        if (!scn) { return elfError("elf_getscn failed"); }
+        mem = is64 ? (const void*) elf64_getshdr(scn) : (const void*) elf32_getshdr(scn);
+        if (!mem) { return elfError("elf_getshdr failed"); }
+        if (!imageWrite(eh.e_shoff + n * eh.e_shentsize, encoding, ELF_T_SHDR, mem, shdrSize)) { return false; }
+        GElf_Shdr shdr;
+        if (!gelf_getshdr(scn, &shdr)) { return elfError("gelf_getshdr failed"); }
+        if (n == 0 || shdr.sh_type == SHT_NOBITS) { continue; }
+        Elf_Data* data = 0;
+        while ((data = elf_getdata(scn, data)) != 0) {
+          if (!data->d_buf) { continue; }
+          if (!imageWrite(shdr.sh_offset + data->d_off, encoding, data->d_type, data->d_buf, data->d_size)) { return false; }
+        }
+      }
       return true;
     }
 
@@ -1523,6 +1619,12 @@ namespace amd {
 
     bool GElfImage::writeTo(const std::string& filename)
     {
+      if (!image.empty()) {
+        std::ofstream out(filename.c_str(), std::ios::binary);
+        if (out.fail()) { return false; }
+        out.write(image.data(), image.size());
+        return !out.fail();
+      }
       if (!img.writeTo(filename)) { return imgError(); }
       return true;
     }
@@ -1534,6 +1636,11 @@ namespace amd {
         memcpy(*buf, buffer, bufferSize);
         if (size) { *size = bufferSize; }
         return true;
+      } else if (!image.empty()) {
+        *buf = malloc(image.size());
+        memcpy(*buf, image.data(), image.size());
+        if (size) { *size = image.size(); }
+        return true;
       } else {
         return img.copyTo(buf, size);
       }
@@ -1545,6 +1652,10 @@ namespace amd {
         if (size < bufferSize) { return false; }
         memcpy(buf, buffer, bufferSize);
         return true;
+      } else if (!image.empty()) {
+        if (size < image.size()) { return false; }
+        memcpy(buf, image.data(), image.size());
+        return true;
       } else {
         return img.copyTo(buf, size);
       }
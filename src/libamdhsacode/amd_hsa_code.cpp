@@ -271,7 +271,9 @@ namespace code {
       : img(nullptr),
         combineDataSegments(combineDataSegments_),
         hsatext(0), imageInit(0), samplerInit(0),
-        debugInfo(0), debugLine(0), debugAbbrev(0)
+        debugInfo(0), debugLine(0), debugAbbrev(0),
+        headerElf(nullptr), headerSize(0), headerNotes(nullptr), headerNotesSize(0),
+        headerMachine(0), headerEFlags(0), headerABIVersion(0)
     {
       for (unsigned i = 0; i < AMDGPU_HSA_SEGMENT_LAST; ++i) {
         for (unsigned j = 0; j < 2; ++j) {
@@ -402,6 +404,88 @@ namespace code {
       return InitAsBuffer(elfmemrd, 0);
     }
 
+    bool AmdHsaCode::InitHeadersAsBuffer(const void* buffer, size_t size)
+    {
+      if (img || !buffer) { return false; }
+      if (size == 0) { size = amd::elf::ElfSize(buffer); }
+
+      const char* bytes = static_cast<const char*>(buffer);
+      if (size < sizeof(Elf64_Ehdr)) {
+        out << "ELF error: Truncated header" << std::endl;
+        return false;
+      }
+      const Elf64_Ehdr* ehdr = static_cast<const Elf64_Ehdr*>(buffer);
+      if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 || ehdr->e_ident[EI_CLASS] != ELFCLASS64) {
+        out << "ELF error: Not a 64-bit ELF" << std::endl;
+        return false;
+      }
+      if (ehdr->e_shentsize != sizeof(Elf64_Shdr) || ehdr->e_shoff > size ||
+          (size - ehdr->e_shoff) / sizeof(Elf64_Shdr) < ehdr->e_shnum ||
+          ehdr->e_shstrndx >= ehdr->e_shnum) {
+        out << "ELF error: Invalid section headers" << std::endl;
+        return false;
+      }
+
+      // Notes are looked up in the ".note" section, as GElfImage does.
+      const Elf64_Shdr* shdr = reinterpret_cast<const Elf64_Shdr*>(bytes + ehdr->e_shoff);
+      const Elf64_Shdr& shstrtab = shdr[ehdr->e_shstrndx];
+      if (shstrtab.sh_offset > size || size - shstrtab.sh_offset < shstrtab.sh_size) {
+        out << "ELF error: Invalid section name table" << std::endl;
+        return false;
+      }
+      const char* names = bytes + shstrtab.sh_offset;
+      static const char noteName[] = ".note";
+      for (uint16_t i = 1; i < ehdr->e_shnum; ++i) {
+        if (shdr[i].sh_type != SHT_NOTE) { continue; }
+        if (shdr[i].sh_name >= shstrtab.sh_size ||
+            shstrtab.sh_size - shdr[i].sh_name < sizeof(noteName) ||
+            memcmp(names + shdr[i].sh_name, noteName, sizeof(noteName)) != 0) {
+          continue;
+        }
+        if (shdr[i].sh_offset > size || size - shdr[i].sh_offset < shdr[i].sh_size) {
+          out << "ELF error: Invalid note section" << std::endl;
+          return false;
+        }
+        headerNotes = bytes + shdr[i].sh_offset;
+        headerNotesSize = shdr[i].sh_size;
+        break;
+      }
+
+      headerElf = bytes;
+      headerSize = size;
+      headerMachine = ehdr->e_machine;
+      headerEFlags = ehdr->e_flags;
+      headerABIVersion = ehdr->e_ident[EI_ABIVERSION];
+      return true;
+    }
+
+    bool AmdHsaCode::InitHeadersAsHandle(hsa_code_object_t code_object)
+    {
+      void *elfmemrd = reinterpret_cast<void*>(code_object.handle);
+      if (!elfmemrd) { return false; }
+      return InitHeadersAsBuffer(elfmemrd, 0);
+    }
+
+    bool AmdHsaCode::GetHeaderNote(const std::string& name, uint32_t type, void** desc, uint32_t* desc_size)
+    {
+      uint64_t offset = 0;
+      while (headerNotes && headerNotesSize - offset >= sizeof(Elf64_Nhdr)) {
+        const char* notec = headerNotes + offset;
+        const Elf64_Nhdr* note = reinterpret_cast<const Elf64_Nhdr*>(notec);
+        uint64_t name_size = alignUp(note->n_namesz, 4);
+        uint64_t note_desc_size = alignUp(note->n_descsz, 4);
+        if (headerNotesSize - offset - sizeof(Elf64_Nhdr) < name_size + note_desc_size) { return false; }
+        if (type == note->n_type &&
+            name == GetNoteString(note->n_namesz, notec + sizeof(Elf64_Nhdr))) {
+          *desc = const_cast<char*>(notec + sizeof(Elf64_Nhdr) + name_size);
+          *desc_size = note->n_descsz;
+          return true;
+        }
+        offset += sizeof(Elf64_Nhdr) + name_size + note_desc_size;
+      }
+      return false;
+    }
+
     bool AmdHsaCode::InitNew(bool xnack)
     {
       if (!img) {
@@ -428,12 +512,12 @@ namespace code {
 
     const char* AmdHsaCode::ElfData()
     {
-      return img->data();
+      return img ? img->data() : headerElf;
     }
 
     uint64_t AmdHsaCode::ElfSize()
     {
-      return img->size();
+      return img ? img->size() : headerSize;
     }
 
     bool AmdHsaCode::Validate()
@@ -463,7 +547,7 @@ namespace code {
     {
       amdgpu_hsa_note_code_object_version_t* desc;
       if (!GetAmdNote(NT_AMDGPU_HSA_CODE_OBJECT_VERSION, &desc)) {
-        if (img->ABIVersion() != 0 && img->ABIVersion() != 1)
+        if (ABIVersion() != 0 && ABIVersion() != 1)
           return false;
 
         *major = 3;
@@ -605,6 +689,40 @@ namespace code {
       return NewName;
     }
 
+    static bool GetIsaFromEFlags(uint32_t EFlags, std::string& isaName)
+    {
+      isaName += "amdgcn-amd-amdhsa--";
+      unsigned MACH = EFlags & EF_AMDGPU_MACH_LC;
+      switch (MACH) {
+      case EF_AMDGPU_MACH_AMDGCN_GFX700_LC: isaName += "gfx700"; break;
+      case EF_AMDGPU_MACH_AMDGCN_GFX701_LC: isaName += "gfx701"; break;
+      case EF_AMDGPU_MACH_AMDGCN_GFX702_LC: isaName += "gfx702"; break;
+      case EF_AMDGPU_MACH_AMDGCN_GFX801_LC: isaName += "gfx801"; break;
+      case EF_AMDGPU_MACH_AMDGCN_GFX802_LC: isaName += "gfx802"; break;
+      case EF_AMDGPU_MACH_AMDGCN_GFX803_LC: isaName += "gfx803"; break;
+      case EF_AMDGPU_MACH_AMDGCN_GFX810_LC: isaName += "gfx810"; break;
+      case EF_AMDGPU_MACH_AMDGCN_GFX900_LC: isaName += "gfx900"; break;
+      case EF_AMDGPU_MACH_AMDGCN_GFX902_LC: isaName += "gfx902"; break;
+      case EF_AMDGPU_MACH_AMDGCN_GFX904_LC: isaName += "gfx904"; break;
+      case EF_AMDGPU_MACH_AMDGCN_GFX906_LC: isaName += "gfx906"; break;
+      default: return false;
+      }
+
+      if (EFlags & EF_AMDGPU_XNACK_LC)
+        isaName += "+xnack";
+
+      if (EFlags & EF_AMDGPU_SRAM_ECC_LC)
+        isaName += "+sram-ecc";
+
+      return true;
+    }
+
+    bool GetElfIsa(const void* elf, size_t size, std::string& isaName)
+    {
+      AmdHsaCode code;
+      return code.InitHeadersAsBuffer(elf, size) && code.GetIsa(isaName);
+    }
+
     bool AmdHsaCode::GetIsa(std::string& isaName)
     {
       isaName.clear();
@@ -614,30 +732,7 @@ namespace code {
 
       if (!GetCodeObjectVersion(&codeObjectMajorVersion, &codeObjectMinorVersion)) { return false; }
       if (codeObjectMajorVersion >= 3) {
-        isaName += "amdgcn-amd-amdhsa--";
-        unsigned MACH = img->EFlags() & EF_AMDGPU_MACH_LC;
-        switch (MACH) {
-        case EF_AMDGPU_MACH_AMDGCN_GFX700_LC: isaName += "gfx700"; break;
-        case EF_AMDGPU_MACH_AMDGCN_GFX701_LC: isaName += "gfx701"; break;
-        case EF_AMDGPU_MACH_AMDGCN_GFX702_LC: isaName += "gfx702"; break;
-        case EF_AMDGPU_MACH_AMDGCN_GFX801_LC: isaName += "gfx801"; break;
-        case EF_AMDGPU_MACH_AMDGCN_GFX802_LC: isaName += "gfx802"; break;
-        case EF_AMDGPU_MACH_AMDGCN_GFX803_LC: isaName += "gfx803"; break;
-        case EF_AMDGPU_MACH_AMDGCN_GFX810_LC: isaName += "gfx810"; break;
-        case EF_AMDGPU_MACH_AMDGCN_GFX900_LC: isaName += "gfx900"; break;
-        case EF_AMDGPU_MACH_AMDGCN_GFX902_LC: isaName += "gfx902"; break;
-        case EF_AMDGPU_MACH_AMDGCN_GFX904_LC: isaName += "gfx904"; break;
-        case EF_AMDGPU_MACH_AMDGCN_GFX906_LC: isaName += "gfx906"; break;
-        default: return false;
-        }
-
-        if (img->EFlags() & EF_AMDGPU_XNACK_LC)
-          isaName += "+xnack";
-
-        if (img->EFlags() & EF_AMDGPU_SRAM_ECC_LC)
-          isaName += "+sram-ecc";
-
-        return true;
+        return GetIsaFromEFlags(EFlags(), isaName);
       } else {
         std::string vendor_name, architecture_name;
         uint32_t major_version, minor_version, stepping;
@@ -654,7 +749,7 @@ namespace code {
 
         amdgpu_hsa_note_hsail_t *hsailNote;
         bool IsFinalizer = GetAmdNote(NT_AMDGPU_HSA_HSAIL, &hsailNote);
-        isaName = ConvertOldTargetNameToNew(isaName, IsFinalizer, img->EFlags());
+        isaName = ConvertOldTargetNameToNew(isaName, IsFinalizer, EFlags());
         return true;
       }
     }
@@ -58,6 +58,9 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#ifdef HAVE_MEMFD_CREATE
+#include <sys/syscall.h>
+#endif
 #endif // _WIN32
 #include "Brig.h"
 
@@ -947,6 +950,11 @@ bool ReadFileIntoBuffer(const std::string& filename, std::vector<char>& buffer)
 
 int OpenTempFile(const char* prefix)
 {
+#ifdef HAVE_MEMFD_CREATE
+  // Anonymous memory backed file, no filesystem round trip.
+  int fd = syscall(__NR_memfd_create, prefix, 0);
+  if (fd >= 0) { return fd; }
+#endif
   unsigned c = 0;
   std::string tname = prefix;
   tname += "_";
@@ -124,7 +124,8 @@ namespace code_options {
 const char* hsaerr2str(hsa_status_t status);
 bool ReadFileIntoBuffer(const std::string& filename, std::vector<char>& buffer);
 
-// Create new empty temporary file that will be deleted when closed.
+// Create new empty temporary file that will be deleted when closed. Uses an
+// anonymous memory file where available.
 int OpenTempFile(const char* prefix);
 void CloseTempFile(int fd);
 
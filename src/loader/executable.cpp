@@ -47,13 +47,18 @@
 #include <cstring>
 #include <iostream>
 #include <atomic>
+#include <chrono>
 #include <fstream>
+#include <new>
+#include <system_error>
+#include <thread>
 #include <libelf.h>
 #include "amd_hsa_elf.h"
 #include "amd_hsa_kernel_code.h"
 #include "amd_hsa_code.hpp"
 #include "amd_hsa_code_util.hpp"
 #include "amd_options.hpp"
+#include "snapshot.hpp"
 
 #include "AMDHSAKernelDescriptor.h"
 
@@ -75,6 +80,7 @@ public:
   const amd::options::NoArgOption* DumpAll() const { return &dump_all; }
   const amd::options::ValueOption<std::string>* DumpDir() const { return &dump_dir; }
   const amd::options::PrefixOption* Substitute() const { return &substitute; }
+  const amd::options::ValueOption<std::string>* SnapshotDir() const { return &snapshot_dir; }
 
   bool ParseOptions(const std::string& options);
   void Reset();
@@ -94,6 +100,7 @@ private:
   amd::options::NoArgOption dump_all;
   amd::options::ValueOption<std::string> dump_dir;
   amd::options::PrefixOption substitute;
+  amd::options::ValueOption<std::string> snapshot_dir;
   amd::options::OptionParser option_parser;
 };
 
@@ -105,6 +112,7 @@ LoaderOptions::LoaderOptions(std::ostream& error) :
   dump_all("dump-all", "Dump all finalizer input and output (as above)"),
   dump_dir("dump-dir", "Dump directory"),
   substitute("substitute", "Substitute code object with given index or index range on loading from file"),
+  snapshot_dir("snapshot-dir", "Load code objects from and save them to relocated snapshots in this directory"),
   option_parser(false, error)
 {
   option_parser.AddOption(&help);
@@ -114,6 +122,7 @@ LoaderOptions::LoaderOptions(std::ostream& error) :
   option_parser.AddOption(&dump_all);
   option_parser.AddOption(&dump_dir);
   option_parser.AddOption(&substitute);
+  option_parser.AddOption(&snapshot_dir);
 }
 
 bool LoaderOptions::ParseOptions(const std::string& options)
@@ -143,12 +152,82 @@ void Loader::Destroy(Loader *loader)
   delete loader;
 }
 
+uint64_t HashBytes(const void *data, size_t size, uint64_t seed)
+{
+  // FNV-1a over 64-bit words.
+  const uint64_t prime = 0x100000001b3ULL;
+  uint64_t hash = (0xcbf29ce484222325ULL ^ seed) * prime;
+  const char *bytes = reinterpret_cast<const char*>(data);
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, bytes + i, sizeof(word));
+    hash = (hash ^ word) * prime;
+  }
+  for (; i < size; ++i) {
+    hash = (hash ^ uint8_t(bytes[i])) * prime;
+  }
+  return hash;
+}
+
+SymbolImpl* SymbolMap::Find(const char *name, size_t length, hsa_agent_t agent) const
+{
+  auto range = table_.equal_range(Hash(name, length, agent.handle));
+  for (auto it = range.first; it != range.second; ++it) {
+    const Entry &entry = it->second;
+    if (entry.agent == agent.handle && entry.name.size() == length &&
+        memcmp(entry.name.data(), name, length) == 0) {
+      return entry.symbol;
+    }
+  }
+  return nullptr;
+}
+
+bool SymbolMap::Insert(const std::string &name, hsa_agent_t agent, SymbolImpl *symbol)
+{
+  if (Find(name, agent)) { return false; }
+  Entry entry = {name, agent.handle, symbol};
+  table_.insert(std::make_pair(Hash(name.data(), name.size(), agent.handle), entry));
+  return true;
+}
+
+std::shared_ptr<CodeObjectCache::Entry> CodeObjectCache::Acquire(const void *elf, size_t size)
+{
+  if (size == 0) { size = amd::elf::ElfSize(elf); }
+  if (size == 0) { return nullptr; }
+  uint64_t hash = HashBytes(elf, size, size);
+
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+      const std::shared_ptr<Entry> &entry = *it;
+      if (entry->hash == hash && entry->code->ElfSize() == size &&
+          memcmp(entry->code->ElfData(), elf, size) == 0) {
+        entries_.splice(entries_.begin(), entries_, it);
+        return entry;
+      }
+    }
+  }
+
+  // Parse outside the lock, a concurrent miss on the same ELF just parses it
+  // twice.
+  std::shared_ptr<Entry> entry(new Entry());
+  entry->code.reset(new code::AmdHsaCode());
+  entry->hash = hash;
+  if (!entry->code->InitFromBuffer(elf, size)) { return nullptr; }
+
+  std::lock_guard<std::mutex> lock(lock_);
+  entries_.push_front(entry);
+  if (entries_.size() > capacity_) { entries_.pop_back(); }
+  return entry;
+}
+
 Executable* AmdHsaCodeLoader::CreateExecutable(
   hsa_profile_t profile, const char *options, hsa_default_float_rounding_mode_t default_float_rounding_mode)
 {
   WriterLockGuard<ReaderWriterLock> writer_lock(rw_lock_);
 
-  executables.push_back(new ExecutableImpl(profile, context, executables.size(), default_float_rounding_mode));
+  executables.push_back(new ExecutableImpl(profile, context, &code_cache, &segment_index, executables.size(), default_float_rounding_mode));
   return executables.back();
 }
 
@@ -157,6 +236,7 @@ void AmdHsaCodeLoader::DestroyExecutable(Executable *executable)
   WriterLockGuard<ReaderWriterLock> writer_lock(rw_lock_);
 
   executables[((ExecutableImpl*)executable)->id()] = nullptr;
+  segment_index.Remove(executable);
   delete executable;
 }
 
@@ -225,20 +305,10 @@ hsa_status_t AmdHsaCodeLoader::QuerySegmentDescriptors(
 
 uint64_t AmdHsaCodeLoader::FindHostAddress(uint64_t device_address)
 {
-  ReaderLockGuard<ReaderWriterLock> reader_lock(rw_lock_);
   if (device_address == 0) {
     return 0;
   }
-
-  for (auto &exec : executables) {
-    if (exec != nullptr) {
-      uint64_t host_address = exec->FindHostAddress(device_address);
-      if (host_address != 0) {
-        return host_address;
-      }
-    }
-  }
-  return 0;
+  return segment_index.Find(device_address, nullptr);
 }
 
 void AmdHsaCodeLoader::PrintHelp(std::ostream& out)
@@ -626,15 +696,21 @@ void Segment::Destroy()
 ExecutableImpl::ExecutableImpl(
     const hsa_profile_t &_profile,
     Context *context,
+    CodeObjectCache *code_cache,
+    SegmentIndex *segment_index,
     size_t id,
     hsa_default_float_rounding_mode_t default_float_rounding_mode)
   : Executable()
   , profile_(_profile)
   , context_(context)
+  , code_cache_(code_cache)
+  , segment_index_(segment_index)
   , id_(id)
   , default_float_rounding_mode_(default_float_rounding_mode)
   , state_(HSA_EXECUTABLE_STATE_UNFROZEN)
+  , frozen_(false)
   , program_allocation_segment(nullptr)
+  , loading_begin_(0)
 {
 }
 
@@ -646,10 +722,10 @@ ExecutableImpl::~ExecutableImpl() {
   objects.clear();
 
   for (auto &symbol_entry : program_symbols_) {
-    delete symbol_entry.second;
+    delete symbol_entry.second.symbol;
   }
   for (auto &symbol_entry : agent_symbols_) {
-    delete symbol_entry.second;
+    delete symbol_entry.second.symbol;
   }
 }
 
@@ -663,13 +739,13 @@ hsa_status_t ExecutableImpl::DefineProgramExternalVariable(
     return HSA_STATUS_ERROR_FROZEN_EXECUTABLE;
   }
 
-  auto symbol_entry = program_symbols_.find(std::string(name));
-  if (symbol_entry != program_symbols_.end()) {
+  hsa_agent_t no_agent = {0};
+  if (program_symbols_.Find(name, strlen(name), no_agent)) {
     return HSA_STATUS_ERROR_VARIABLE_ALREADY_DEFINED;
   }
 
-  program_symbols_.insert(
-    std::make_pair(std::string(name),
+  program_symbols_.Insert(
+    std::string(name), no_agent,
                    new VariableSymbol(true,
                                       "", // Only program linkage symbols can be
                                           // defined.
@@ -682,7 +758,7 @@ hsa_status_t ExecutableImpl::DefineProgramExternalVariable(
                                       0,     // TODO: align.
                                       false, // TODO: const.
                                       true,
-                                      reinterpret_cast<uint64_t>(address))));
+                                      reinterpret_cast<uint64_t>(address)));
   return HSA_STATUS_SUCCESS;
 }
 
@@ -699,28 +775,27 @@ hsa_status_t ExecutableImpl::DefineAgentExternalVariable(
     return HSA_STATUS_ERROR_FROZEN_EXECUTABLE;
   }
 
-  auto symbol_entry = agent_symbols_.find(std::make_pair(std::string(name), agent));
-  if (symbol_entry != agent_symbols_.end()) {
+  if (agent_symbols_.Find(name, strlen(name), agent)) {
     return HSA_STATUS_ERROR_VARIABLE_ALREADY_DEFINED;
   }
 
-  auto insert_status = agent_symbols_.insert(
-    std::make_pair(std::make_pair(std::string(name), agent),
-                   new VariableSymbol(true,
-                                      "", // Only program linkage symbols can be
-                                          // defined.
-                                      std::string(name),
-                                      HSA_SYMBOL_LINKAGE_PROGRAM,
-                                      true,
-                                      HSA_VARIABLE_ALLOCATION_AGENT,
-                                      segment,
-                                      0,     // TODO: size.
-                                      0,     // TODO: align.
-                                      false, // TODO: const.
-                                      true,
-                                      reinterpret_cast<uint64_t>(address))));
-  assert(insert_status.second);
-  insert_status.first->second->agent = agent;
+  VariableSymbol *symbol = new VariableSymbol(true,
+                                              "", // Only program linkage symbols can be
+                                                  // defined.
+                                              std::string(name),
+                                              HSA_SYMBOL_LINKAGE_PROGRAM,
+                                              true,
+                                              HSA_VARIABLE_ALLOCATION_AGENT,
+                                              segment,
+                                              0,     // TODO: size.
+                                              0,     // TODO: align.
+                                              false, // TODO: const.
+                                              true,
+                                              reinterpret_cast<uint64_t>(address));
+  symbol->agent = agent;
+  bool inserted = agent_symbols_.Insert(std::string(name), agent, symbol);
+  assert(inserted);
+  (void)inserted;
 
   return HSA_STATUS_SUCCESS;
 }
@@ -728,14 +803,22 @@ hsa_status_t ExecutableImpl::DefineAgentExternalVariable(
 bool ExecutableImpl::IsProgramSymbol(const char *symbol_name) {
   assert(symbol_name);
 
+  hsa_agent_t no_agent = {0};
+  if (frozen_.load(std::memory_order_acquire)) {
+    return program_symbols_.Find(symbol_name, strlen(symbol_name), no_agent) != nullptr;
+  }
   ReaderLockGuard<ReaderWriterLock> reader_lock(rw_lock_);
-  return program_symbols_.find(std::string(symbol_name)) != program_symbols_.end();
+  return program_symbols_.Find(symbol_name, strlen(symbol_name), no_agent) != nullptr;
 }
 
 Symbol* ExecutableImpl::GetSymbol(
   const char *symbol_name,
   const hsa_agent_t *agent)
 {
+  // The symbol tables never change once the executable is frozen.
+  if (frozen_.load(std::memory_order_acquire)) {
+    return this->GetSymbolInternal(symbol_name, agent);
+  }
   ReaderLockGuard<ReaderWriterLock> reader_lock(rw_lock_);
   return this->GetSymbolInternal(symbol_name, agent);
 }
@@ -746,24 +829,16 @@ Symbol* ExecutableImpl::GetSymbolInternal(
 {
   assert(symbol_name);
 
-  std::string mangled_name = std::string(symbol_name);
-  if (mangled_name.empty()) {
+  size_t length = strlen(symbol_name);
+  if (length == 0) {
     return nullptr;
   }
 
   if (!agent) {
-    auto program_symbol = program_symbols_.find(mangled_name);
-    if (program_symbol != program_symbols_.end()) {
-      return program_symbol->second;
-    }
-    return nullptr;
-  }
-
-  auto agent_symbol = agent_symbols_.find(std::make_pair(mangled_name, *agent));
-  if (agent_symbol != agent_symbols_.end()) {
-    return agent_symbol->second;
+    hsa_agent_t no_agent = {0};
+    return program_symbols_.Find(symbol_name, length, no_agent);
   }
-  return nullptr;
+  return agent_symbols_.Find(symbol_name, length, *agent);
 }
 
 hsa_status_t ExecutableImpl::IterateSymbols(
@@ -774,14 +849,14 @@ hsa_status_t ExecutableImpl::IterateSymbols(
 
   for (auto &symbol_entry : program_symbols_) {
     hsa_status_t hsc =
-      callback(Executable::Handle(this), Symbol::Handle(symbol_entry.second), data);
+      callback(Executable::Handle(this), Symbol::Handle(symbol_entry.second.symbol), data);
     if (HSA_STATUS_SUCCESS != hsc) {
       return hsc;
     }
   }
   for (auto &symbol_entry : agent_symbols_) {
     hsa_status_t hsc =
-      callback(Executable::Handle(this), Symbol::Handle(symbol_entry.second), data);
+      callback(Executable::Handle(this), Symbol::Handle(symbol_entry.second.symbol), data);
     if (HSA_STATUS_SUCCESS != hsc) {
       return hsc;
     }
@@ -801,12 +876,12 @@ hsa_status_t ExecutableImpl::IterateAgentSymbols(
   assert(callback);
 
   for (auto &symbol_entry : agent_symbols_) {
-    if (symbol_entry.second->GetAgent().handle != agent.handle) {
+    if (symbol_entry.second.symbol->GetAgent().handle != agent.handle) {
       continue;
     }
 
     hsa_status_t status = callback(
-        Executable::Handle(this), agent, Symbol::Handle(symbol_entry.second),
+        Executable::Handle(this), agent, Symbol::Handle(symbol_entry.second.symbol),
         data);
     if (status != HSA_STATUS_SUCCESS) {
       return status;
@@ -826,7 +901,7 @@ hsa_status_t ExecutableImpl::IterateProgramSymbols(
 
   for (auto &symbol_entry : program_symbols_) {
     hsa_status_t status = callback(
-        Executable::Handle(this), Symbol::Handle(symbol_entry.second), data);
+        Executable::Handle(this), Symbol::Handle(symbol_entry.second.symbol), data);
     if (status != HSA_STATUS_SUCCESS) {
       return status;
     }
@@ -933,20 +1008,73 @@ int64_t LoadedCodeObjectImpl::getDelta() const {
 hsa_executable_t AmdHsaCodeLoader::FindExecutable(uint64_t device_address)
 {
   hsa_executable_t execHandle = {0};
-  ReaderLockGuard<ReaderWriterLock> reader_lock(rw_lock_);
   if (device_address == 0) {
     return execHandle;
   }
 
-  for (auto &exec : executables) {
-    if (exec != nullptr) {
-      uint64_t host_address = exec->FindHostAddress(device_address);
-      if (host_address != 0) {
-        return Executable::Handle(exec);
+  Executable *exec = nullptr;
+  if (segment_index.Find(device_address, &exec) != 0) {
+    return Executable::Handle(exec);
+  }
+  return execHandle;
+}
+
+void SegmentIndex::Add(Executable *executable, const std::vector<Segment*> &segments)
+{
+  std::lock_guard<std::mutex> lock(writer_lock_);
+  std::vector<Entry> *entries = new std::vector<Entry>(*entries_.load());
+  for (Segment *seg : segments) {
+    Entry entry = {(uint64_t)(uintptr_t)seg->Address(seg->VAddr()), seg->Size(), executable, seg};
+    entries->insert(std::upper_bound(entries->begin(), entries->end(), entry,
+                                     [](const Entry &a, const Entry &b) { return a.base < b.base; }),
+                    entry);
+  }
+  Publish(entries);
+}
+
+void SegmentIndex::Remove(Executable *executable)
+{
+  std::lock_guard<std::mutex> lock(writer_lock_);
+  std::vector<Entry> *entries = new std::vector<Entry>(*entries_.load());
+  entries->erase(std::remove_if(entries->begin(), entries->end(),
+                                [=](const Entry &e) { return e.executable == executable; }),
+                 entries->end());
+  Publish(entries);
+}
+
+void SegmentIndex::Publish(std::vector<Entry> *entries)
+{
+  std::vector<Entry> *old = entries_.exchange(entries);
+  // Readers arriving from here on see the new index.
+  while (readers_.load() != 0) {
+    std::this_thread::yield();
+  }
+  delete old;
+}
+
+uint64_t SegmentIndex::Find(uint64_t device_address, Executable **executable)
+{
+  readers_.fetch_add(1);
+  const std::vector<Entry> &entries = *entries_.load();
+
+  uint64_t host_address = 0;
+  auto it = std::upper_bound(entries.begin(), entries.end(), device_address,
+                             [](uint64_t addr, const Entry &e) { return addr < e.base; });
+  if (it != entries.begin()) {
+    --it;
+    if (device_address - it->base < it->size) {
+      Segment *seg = it->segment;
+      void *haddr = context_->SegmentHostAddress(
+        seg->ElfSegment(), seg->Agent(), seg->Ptr(), device_address - it->base);
+      host_address = nullptr == haddr ? 0 : (uint64_t)(uintptr_t)haddr;
+      if (executable != nullptr && host_address != 0) {
+        *executable = it->executable;
       }
     }
   }
-  return execHandle;
+
+  readers_.fetch_sub(1);
+  return host_address;
 }
 
 uint64_t ExecutableImpl::FindHostAddress(uint64_t device_address)
@@ -1034,6 +1162,29 @@ hsa_status_t ExecutableImpl::LoadCodeObject(
   const char *options,
   hsa_loaded_code_object_t *loaded_code_object)
 {
+  return LoadCodeObjects(&agent, 1, code_object, code_object_size, options,
+                         loaded_code_object);
+}
+
+hsa_status_t ExecutableImpl::LoadCodeObjects(
+  const hsa_agent_t *agents,
+  size_t num_agents,
+  hsa_code_object_t code_object,
+  size_t code_object_size,
+  const char *options,
+  hsa_loaded_code_object_t *loaded_code_objects_out)
+{
+  if (!agents || num_agents == 0) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+  for (size_t i = 0; i < num_agents; ++i) {
+    for (size_t j = 0; j < i; ++j) {
+      if (agents[j].handle == agents[i].handle) {
+        return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+      }
+    }
+  }
+
   WriterLockGuard<ReaderWriterLock> writer_lock(rw_lock_);
   if (HSA_EXECUTABLE_STATE_FROZEN == state_) {
     return HSA_STATUS_ERROR_FROZEN_EXECUTABLE;
@@ -1075,8 +1226,6 @@ hsa_status_t ExecutableImpl::LoadCodeObject(
 
   uint32_t codeNum = NextCodeObjectNum();
 
-  code.reset(new code::AmdHsaCode());
-
   std::string substituteFileName;
   for (const Substitute& ss : substitutes) {
     if (codeNum >= std::get<0>(ss) && codeNum <= std::get<1>(ss)) {
@@ -1084,18 +1233,70 @@ hsa_status_t ExecutableImpl::LoadCodeObject(
       break;
     }
   }
+  bool dumping = loaderOptions.DumpAll()->is_set() || loaderOptions.DumpCode()->is_set() ||
+                 loaderOptions.DumpIsa()->is_set() || loaderOptions.DumpExec()->is_set();
+
   std::vector<char> buffer;
+  std::shared_ptr<CodeObjectCache::Entry> cached;
+  std::unique_lock<std::mutex> cached_lock;
+  const void *elf_data;
+  uint64_t elf_hash = 0;
+  std::string snapshotFile;
   if (substituteFileName.empty()) {
-   if (!code->InitAsHandle(code_object)) {
-      return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+    elf_data = reinterpret_cast<const void*>(code_object.handle);
+    if (!elf_data) { return HSA_STATUS_ERROR_INVALID_CODE_OBJECT; }
+    size_t elf_size = code_object_size ? code_object_size : amd::elf::ElfSize(elf_data);
+    if (loaderOptions.SnapshotDir()->is_set() && !dumping) {
+      elf_hash = HashBytes(elf_data, elf_size, elf_size);
+      snapshotFile = Snapshot::FileName(loaderOptions.SnapshotDir()->value(), elf_hash);
+      Snapshot snapshot;
+      if (snapshot.Read(snapshotFile) && snapshot.elf_hash == elf_hash &&
+          snapshot.elf_size == elf_size && memcmp(snapshot.elf.data(), elf_data, elf_size) == 0) {
+        hsa_status_t status = LoadSnapshot(agents, num_agents, snapshot, elf_data);
+        if (status != HSA_STATUS_SUCCESS) { return status; }
+        IndexLoadedSegments();
+        if (nullptr != loaded_code_objects_out) {
+          for (size_t i = 0; i < num_agents; ++i) {
+            loaded_code_objects_out[i] =
+                LoadedCodeObject::Handle(loaded_code_objects[loading_begin_ + i]);
+          }
+        }
+        return HSA_STATUS_SUCCESS;
+      }
+    }
+    // Callers probe code objects against agents until one loads, so reject
+    // code objects for other targets before parsing them.
+    std::string elfIsa;
+    if (code::GetElfIsa(elf_data, elf_size, elfIsa)) {
+      hsa_isa_t elfIsaHandle = context_->IsaFromName(elfIsa.c_str());
+      if (!elfIsaHandle.handle) { return HSA_STATUS_ERROR_INVALID_ISA_NAME; }
+      for (size_t i = 0; i < num_agents; ++i) {
+        if (agents[i].handle != 0 && !context_->IsaSupportedByAgent(agents[i], elfIsaHandle)) {
+          return HSA_STATUS_ERROR_INCOMPATIBLE_ARGUMENTS;
+        }
+      }
+    }
+    if (elf_size <= CodeObjectCache::kMaxEntrySize) {
+      // Repeated loads of the same ELF reuse its parsed form.
+      cached = code_cache_->Acquire(elf_data, elf_size);
+      if (!cached) { return HSA_STATUS_ERROR_INVALID_CODE_OBJECT; }
+      cached_lock = std::unique_lock<std::mutex>(cached->lock);
+      code = cached->code;
+    } else {
+      code.reset(new code::AmdHsaCode());
+      if (!code->InitAsBuffer(elf_data, elf_size)) {
+        return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+      }
     }
   } else {
     if (!ReadFileIntoBuffer(substituteFileName, buffer)) {
       return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
     }
+    code.reset(new code::AmdHsaCode());
     if (!code->InitAsBuffer(&buffer[0], buffer.size())) {
       return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
     }
+    elf_data = code->ElfData();
   }
 
   if (loaderOptions.DumpAll()->is_set() || loaderOptions.DumpCode()->is_set()) {
@@ -1118,7 +1319,11 @@ hsa_status_t ExecutableImpl::LoadCodeObject(
   }
 
   if (majorVersion != 1 && majorVersion != 2 && majorVersion != 3) { return HSA_STATUS_ERROR_INVALID_CODE_OBJECT; }
-  if (agent.handle == 0 && majorVersion == 1) { return HSA_STATUS_ERROR_INVALID_AGENT; }
+  for (size_t i = 0; i < num_agents; ++i) {
+    if (agents[i].handle == 0 && (majorVersion == 1 || num_agents > 1)) {
+      return HSA_STATUS_ERROR_INVALID_AGENT;
+    }
+  }
 
   uint32_t codeHsailMajor;
   uint32_t codeHsailMinor;
@@ -1135,30 +1340,58 @@ hsa_status_t ExecutableImpl::LoadCodeObject(
   hsa_isa_t objectsIsa = context_->IsaFromName(codeIsa.c_str());
   if (!objectsIsa.handle) { return HSA_STATUS_ERROR_INVALID_ISA_NAME; }
 
-  if (agent.handle != 0 && !context_->IsaSupportedByAgent(agent, objectsIsa)) {
-    return HSA_STATUS_ERROR_INCOMPATIBLE_ARGUMENTS;
+  for (size_t i = 0; i < num_agents; ++i) {
+    if (agents[i].handle != 0 && !context_->IsaSupportedByAgent(agents[i], objectsIsa)) {
+      return HSA_STATUS_ERROR_INCOMPATIBLE_ARGUMENTS;
+    }
   }
 
   hsa_status_t status;
 
-  objects.push_back(new LoadedCodeObjectImpl(this, agent, code->ElfData(), code->ElfSize()));
-  loaded_code_objects.push_back((LoadedCodeObjectImpl*)objects.back());
+  loading_begin_ = loaded_code_objects.size();
+  for (size_t i = 0; i < num_agents; ++i) {
+    objects.push_back(new LoadedCodeObjectImpl(this, agents[i], elf_data, code->ElfSize()));
+    loaded_code_objects.push_back((LoadedCodeObjectImpl*)objects.back());
+  }
 
-  status = LoadSegments(agent, code.get(), majorVersion);
-  if (status != HSA_STATUS_SUCCESS) return status;
+  if (num_agents > 1 && majorVersion >= 2) {
+    // Relocations only refer to this code object's own segments or to
+    // external symbols defined before loading, so they do not depend on the
+    // symbols registered below.
+    status = LoadSegmentsParallel(agents, num_agents);
+    if (status != HSA_STATUS_SUCCESS) { return status; }
 
-  for (size_t i = 0; i < code->SymbolCount(); ++i) {
-    if (majorVersion >= 2 &&
-        code->GetSymbol(i)->elfSym()->type() != STT_AMDGPU_HSA_KERNEL &&
-        code->GetSymbol(i)->elfSym()->binding() == STB_LOCAL)
-      continue;
+    for (size_t i = 0; i < num_agents; ++i) {
+      status = LoadSymbols(agents[i], majorVersion);
+      if (status != HSA_STATUS_SUCCESS) { return status; }
+    }
+  } else {
+    for (size_t i = 0; i < num_agents; ++i) {
+      status = LoadSegments(agents[i], code.get(), majorVersion);
+      if (status != HSA_STATUS_SUCCESS) return status;
 
-    status = LoadSymbol(agent, code->GetSymbol(i), majorVersion);
-    if (status != HSA_STATUS_SUCCESS) { return status; }
+      status = LoadSymbols(agents[i], majorVersion);
+      if (status != HSA_STATUS_SUCCESS) { return status; }
+
+      status = ApplyRelocations(agents[i], code.get());
+      if (status != HSA_STATUS_SUCCESS) { return status; }
+    }
   }
 
-  status = ApplyRelocations(agent, code.get());
-  if (status != HSA_STATUS_SUCCESS) { return status; }
+  if (!snapshotFile.empty() && majorVersion >= 2) {
+    Snapshot snapshot;
+    snapshot.elf_hash = elf_hash;
+    snapshot.elf_size = code->ElfSize();
+    const char *elf = reinterpret_cast<const char*>(code->ElfData());
+    snapshot.elf.assign(elf, elf + snapshot.elf_size);
+    snapshot.isa = codeIsa;
+    snapshot.profile = codeProfile;
+    if (TakeSnapshot(agents[0], snapshot)) {
+      if (!snapshot.Write(snapshotFile)) {
+        // Ignore error.
+      }
+    }
+  }
 
   code.reset();
 
@@ -1168,17 +1401,85 @@ hsa_status_t ExecutableImpl::LoadCodeObject(
     }
   }
 
-  if (nullptr != loaded_code_object) { *loaded_code_object = LoadedCodeObject::Handle(loaded_code_objects.back()); }
+  IndexLoadedSegments();
+
+  if (nullptr != loaded_code_objects_out) {
+    for (size_t i = 0; i < num_agents; ++i) {
+      loaded_code_objects_out[i] =
+          LoadedCodeObject::Handle(loaded_code_objects[loading_begin_ + i]);
+    }
+  }
   return HSA_STATUS_SUCCESS;
 }
 
+void ExecutableImpl::IndexLoadedSegments()
+{
+  std::vector<Segment*> segments;
+  for (size_t i = loading_begin_; i < loaded_code_objects.size(); ++i) {
+    for (Segment *seg : loaded_code_objects[i]->LoadedSegments()) {
+      segments.push_back(seg);
+    }
+  }
+  segment_index_->Add(this, segments);
+}
+
 hsa_status_t ExecutableImpl::LoadSegments(hsa_agent_t agent,
                                           const code::AmdHsaCode *c,
                                           uint32_t majorVersion) {
   if (majorVersion < 2)
     return LoadSegmentsV1(agent, c);
-  else
-    return LoadSegmentsV2(agent, c);
+
+  hsa_status_t status = LoadSegmentsV2(agent, c);
+  if (status != HSA_STATUS_SUCCESS) return status;
+
+  objects.push_back(LoadingCodeObject(agent)->LoadedSegments().back());
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t ExecutableImpl::LoadSegmentsParallel(const hsa_agent_t *agents,
+                                                  size_t num_agents) {
+  // Each agent gets its own segment and loaded code object, and the symbol
+  // tables are only read until the threads are joined.
+  std::vector<hsa_status_t> status(num_agents, HSA_STATUS_SUCCESS);
+  auto load = [&](size_t i) {
+    try {
+      status[i] = LoadSegmentsV2(agents[i], code.get());
+      if (status[i] == HSA_STATUS_SUCCESS) {
+        status[i] = ApplyRelocations(agents[i], code.get());
+      }
+    } catch (const std::bad_alloc&) {
+      status[i] = HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+    } catch (...) {
+      status[i] = HSA_STATUS_ERROR;
+    }
+  };
+
+  std::vector<std::thread> workers;
+  size_t next = 1;
+  try {
+    for (; next < num_agents; ++next) {
+      workers.emplace_back(load, next);
+    }
+  } catch (const std::system_error&) {
+    // Load whatever did not get a thread on this one.
+  }
+  for (; next < num_agents; ++next) {
+    load(next);
+  }
+  load(0);
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+
+  for (size_t i = loading_begin_; i < loaded_code_objects.size(); ++i) {
+    const std::vector<Segment*> &segments = loaded_code_objects[i]->LoadedSegments();
+    objects.insert(objects.end(), segments.begin(), segments.end());
+  }
+
+  for (hsa_status_t s : status) {
+    if (s != HSA_STATUS_SUCCESS) { return s; }
+  }
+  return HSA_STATUS_SUCCESS;
 }
 
 hsa_status_t ExecutableImpl::LoadSegmentsV1(hsa_agent_t agent,
@@ -1216,8 +1517,7 @@ hsa_status_t ExecutableImpl::LoadSegmentsV2(hsa_agent_t agent,
     if (status != HSA_STATUS_SUCCESS) return status;
   }
 
-  objects.push_back(load_segment);
-  loaded_code_objects.back()->LoadedSegments().push_back(load_segment);
+  LoadingCodeObject(agent)->LoadedSegments().push_back(load_segment);
 
   return HSA_STATUS_SUCCESS;
 }
@@ -1246,7 +1546,7 @@ hsa_status_t ExecutableImpl::LoadSegmentV1(hsa_agent_t agent,
     }
   }
   assert(new_seg);
-  loaded_code_objects.back()->LoadedSegments().push_back(new_seg);
+  LoadingCodeObject(agent)->LoadedSegments().push_back(new_seg);
   return HSA_STATUS_SUCCESS;
 }
 
@@ -1259,6 +1559,21 @@ hsa_status_t ExecutableImpl::LoadSegmentV2(const code::Segment *data_segment,
   return HSA_STATUS_SUCCESS;
 }
 
+hsa_status_t ExecutableImpl::LoadSymbols(hsa_agent_t agent,
+                                         uint32_t majorVersion)
+{
+  for (size_t i = 0; i < code->SymbolCount(); ++i) {
+    if (majorVersion >= 2 &&
+        code->GetSymbol(i)->elfSym()->type() != STT_AMDGPU_HSA_KERNEL &&
+        code->GetSymbol(i)->elfSym()->binding() == STB_LOCAL)
+      continue;
+
+    hsa_status_t status = LoadSymbol(agent, code->GetSymbol(i), majorVersion);
+    if (status != HSA_STATUS_SUCCESS) { return status; }
+  }
+  return HSA_STATUS_SUCCESS;
+}
+
 hsa_status_t ExecutableImpl::LoadSymbol(hsa_agent_t agent,
                                         code::Symbol* sym,
                                         uint32_t majorVersion)
@@ -1287,14 +1602,13 @@ hsa_status_t ExecutableImpl::LoadDefinitionSymbol(hsa_agent_t agent,
     isAgent = agent.handle != 0;
   }
   if (isAgent) {
-    auto agent_symbol = agent_symbols_.find(std::make_pair(sym->Name(), agent));
-    if (agent_symbol != agent_symbols_.end()) {
+    if (agent_symbols_.Find(sym->Name(), agent)) {
       // TODO(spec): this is not spec compliant.
       return HSA_STATUS_ERROR_VARIABLE_ALREADY_DEFINED;
     }
   } else {
-    auto program_symbol = program_symbols_.find(sym->Name());
-    if (program_symbol != program_symbols_.end()) {
+    hsa_agent_t no_agent = {0};
+    if (program_symbols_.Find(sym->Name(), no_agent)) {
       // TODO(spec): this is not spec compliant.
       return HSA_STATUS_ERROR_VARIABLE_ALREADY_DEFINED;
     }
@@ -1377,7 +1691,7 @@ hsa_status_t ExecutableImpl::LoadDefinitionSymbol(hsa_agent_t agent,
                                       size,
                                       256,
                                       address);
-      kernel_symbol->debug_info.elf_raw = code->ElfData();
+      kernel_symbol->debug_info.elf_raw = LoadingCodeObject(agent)->ElfData();
       kernel_symbol->debug_info.elf_size = code->ElfSize();
       kernel_symbol->debug_info.kernel_name = kernel_symbol->full_name.c_str();
       kernel_symbol->debug_info.owning_segment = (void*)SymbolSegment(agent, sym)->Address(sym->GetSection()->addr());
@@ -1396,9 +1710,10 @@ hsa_status_t ExecutableImpl::LoadDefinitionSymbol(hsa_agent_t agent,
   assert(symbol);
   if (isAgent) {
     symbol->agent = agent;
-    agent_symbols_.insert(std::make_pair(std::make_pair(sym->Name(), agent), symbol));
+    agent_symbols_.Insert(sym->Name(), agent, symbol);
   } else {
-    program_symbols_.insert(std::make_pair(sym->Name(), symbol));
+    hsa_agent_t no_agent = {0};
+    program_symbols_.Insert(sym->Name(), no_agent, symbol);
   }
   return HSA_STATUS_SUCCESS;
 }
@@ -1407,10 +1722,9 @@ hsa_status_t ExecutableImpl::LoadDeclarationSymbol(hsa_agent_t agent,
                                                    code::Symbol* sym,
                                                    uint32_t majorVersion)
 {
-  auto program_symbol = program_symbols_.find(sym->Name());
-  if (program_symbol == program_symbols_.end()) {
-    auto agent_symbol = agent_symbols_.find(std::make_pair(sym->Name(), agent));
-    if (agent_symbol == agent_symbols_.end()) {
+  hsa_agent_t no_agent = {0};
+  if (!program_symbols_.Find(sym->Name(), no_agent)) {
+    if (!agent_symbols_.Find(sym->Name(), agent)) {
       // TODO(spec): this is not spec compliant.
       return HSA_STATUS_ERROR_VARIABLE_UNDEFINED;
     }
@@ -1418,9 +1732,233 @@ hsa_status_t ExecutableImpl::LoadDeclarationSymbol(hsa_agent_t agent,
   return HSA_STATUS_SUCCESS;
 }
 
-Segment* ExecutableImpl::VirtualAddressSegment(uint64_t vaddr)
+bool ExecutableImpl::TakeSnapshot(hsa_agent_t agent, Snapshot &snapshot)
+{
+  LoadedCodeObjectImpl *loaded_code_object = LoadingCodeObject(agent);
+  if (loaded_code_object->LoadedSegments().size() != 1) { return false; }
+  Segment *segment = loaded_code_object->LoadedSegments().front();
+  uint64_t base = reinterpret_cast<uint64_t>(segment->Address(segment->VAddr()));
+
+  const char *image = reinterpret_cast<const char*>(context_->SegmentHostAddress(
+      segment->ElfSegment(), agent, segment->Ptr(), 0));
+  if (!image) { return false; }
+  size_t image_size = segment->Size();
+  while (image_size && !image[image_size - 1]) { --image_size; }
+  snapshot.vaddr = segment->VAddr();
+  snapshot.size = segment->Size();
+  snapshot.storage_offset = segment->StorageOffset();
+  snapshot.image.assign(image, image + image_size);
+
+  snapshot.fixups.clear();
+  for (size_t i = 0; i < code->RelocationSectionCount(); ++i) {
+    code::RelocationSection *sec = code->GetRelocationSection(i);
+    if (sec->targetSection()) { return false; }
+    for (size_t j = 0; j < sec->relocationCount(); ++j) {
+      code::Relocation *rel = sec->relocation(j);
+      uint64_t address = 0;
+      if (rel->type() == R_AMDGPU_RELATIVE64) {
+        address = reinterpret_cast<uint64_t>(segment->Address(0)) - segment->VAddr() + rel->addend();
+      } else {
+        // External symbols may be defined elsewhere next time.
+        if (rel->symbol()->type() == STT_NOTYPE) { return false; }
+        if (ResolveRelocationSymbol(agent, rel, &address) != HSA_STATUS_SUCCESS) { return false; }
+        address += rel->addend();
+      }
+      Snapshot::Fixup fixup;
+      fixup.vaddr = rel->offset();
+      fixup.type = rel->type();
+      fixup.target = int64_t(address - base);
+      snapshot.fixups.push_back(fixup);
+    }
+  }
+
+  snapshot.symbols.clear();
+  for (size_t i = 0; i < code->SymbolCount(); ++i) {
+    code::Symbol *sym = code->GetSymbol(i);
+    if (sym->elfSym()->type() != STT_AMDGPU_HSA_KERNEL &&
+        sym->elfSym()->binding() == STB_LOCAL)
+      continue;
+    if (sym->IsDeclaration()) { return false; }
+
+    hsa_agent_t no_agent = {0};
+    SymbolImpl *symbol = agent.handle != 0 ? agent_symbols_.Find(sym->Name(), agent)
+                                           : program_symbols_.Find(sym->Name(), no_agent);
+    if (!symbol) { return false; }
+
+    Snapshot::Symbol s = {};
+    s.name = sym->Name();
+    s.module_name = symbol->module_name;
+    s.symbol_name = symbol->symbol_name;
+    s.kind = symbol->kind;
+    s.linkage = symbol->linkage;
+    s.offset = int64_t(symbol->address - base);
+    if (symbol->IsKernel()) {
+      // The debug info of code object v2 kernels is patched into the
+      // segment at every load.
+      if (!string_ends_with(symbol->symbol_name, ".kd")) { return false; }
+      KernelSymbol *kernel = static_cast<KernelSymbol*>(symbol);
+      s.size = kernel->size;
+      s.alignment = kernel->alignment;
+      s.kernarg_segment_size = kernel->kernarg_segment_size;
+      s.kernarg_segment_alignment = kernel->kernarg_segment_alignment;
+      s.group_segment_size = kernel->group_segment_size;
+      s.private_segment_size = kernel->private_segment_size;
+      s.is_dynamic_callstack = kernel->is_dynamic_callstack;
+    } else {
+      VariableSymbol *variable = static_cast<VariableSymbol*>(symbol);
+      s.size = variable->size;
+      s.alignment = variable->alignment;
+      s.allocation = variable->allocation;
+      s.segment = variable->segment;
+      s.is_constant = variable->is_constant;
+    }
+    snapshot.symbols.push_back(s);
+  }
+  return true;
+}
+
+hsa_status_t ExecutableImpl::LoadSnapshot(const hsa_agent_t *agents,
+                                          size_t num_agents,
+                                          const Snapshot &snapshot,
+                                          const void *elf_data)
+{
+  for (size_t i = 0; i < num_agents; ++i) {
+    if (agents[i].handle == 0 && num_agents > 1) {
+      return HSA_STATUS_ERROR_INVALID_AGENT;
+    }
+  }
+  if (hsa_profile_t(snapshot.profile) != profile_) {
+    return HSA_STATUS_ERROR_INCOMPATIBLE_ARGUMENTS;
+  }
+
+  hsa_isa_t objectsIsa = context_->IsaFromName(snapshot.isa.c_str());
+  if (!objectsIsa.handle) { return HSA_STATUS_ERROR_INVALID_ISA_NAME; }
+  for (size_t i = 0; i < num_agents; ++i) {
+    if (agents[i].handle != 0 && !context_->IsaSupportedByAgent(agents[i], objectsIsa)) {
+      return HSA_STATUS_ERROR_INCOMPATIBLE_ARGUMENTS;
+    }
+  }
+
+  for (const Snapshot::Fixup &fixup : snapshot.fixups) {
+    size_t slot_size = sizeof(uint64_t);
+    switch (fixup.type) {
+      case R_AMDGPU_32_HIGH:
+      case R_AMDGPU_32_LOW:
+        slot_size = sizeof(uint32_t);
+        break;
+      case R_AMDGPU_64:
+      case R_AMDGPU_RELATIVE64:
+        break;
+      default:
+        return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+    }
+    if (fixup.vaddr < snapshot.vaddr || snapshot.size < slot_size ||
+        fixup.vaddr - snapshot.vaddr > snapshot.size - slot_size) {
+      return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+    }
+  }
+
+  loading_begin_ = loaded_code_objects.size();
+  for (size_t i = 0; i < num_agents; ++i) {
+    objects.push_back(new LoadedCodeObjectImpl(this, agents[i], elf_data, snapshot.elf_size));
+    loaded_code_objects.push_back((LoadedCodeObjectImpl*)objects.back());
+  }
+
+  for (size_t i = 0; i < num_agents; ++i) {
+    hsa_agent_t agent = agents[i];
+    void *ptr = context_->SegmentAlloc(AMDGPU_HSA_SEGMENT_CODE_AGENT, agent, snapshot.size,
+        AMD_ISA_ALIGN_BYTES, true);
+    if (!ptr) return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+
+    Segment *segment = new Segment(this, agent, AMDGPU_HSA_SEGMENT_CODE_AGENT,
+        ptr, snapshot.size, snapshot.vaddr, snapshot.storage_offset);
+    LoadingCodeObject(agent)->LoadedSegments().push_back(segment);
+    objects.push_back(segment);
+
+    auto start = std::chrono::steady_clock::now();
+    if (!snapshot.image.empty()) {
+      segment->Copy(snapshot.vaddr, snapshot.image.data(), snapshot.image.size());
+    }
+    uint64_t base = reinterpret_cast<uint64_t>(segment->Address(segment->VAddr()));
+    for (const Snapshot::Fixup &fixup : snapshot.fixups) {
+      uint64_t address = base + fixup.target;
+      if (fixup.type == R_AMDGPU_32_HIGH) {
+        uint32_t address32 = uint32_t((address >> 32) & 0xFFFFFFFF);
+        segment->Copy(fixup.vaddr, &address32, sizeof(address32));
+      } else if (fixup.type == R_AMDGPU_32_LOW) {
+        uint32_t address32 = uint32_t(address & 0xFFFFFFFF);
+        segment->Copy(fixup.vaddr, &address32, sizeof(address32));
+      } else {
+        segment->Copy(fixup.vaddr, &address, sizeof(address));
+      }
+    }
+    auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start);
+    LoadingCodeObject(agent)->AddRelocationStats(snapshot.fixups.size(), time.count());
+
+    for (const Snapshot::Symbol &s : snapshot.symbols) {
+      uint64_t address = base + s.offset;
+      SymbolImpl *symbol = nullptr;
+      if (s.kind == HSA_SYMBOL_KIND_KERNEL) {
+        symbol = new KernelSymbol(true,
+                                  s.module_name,
+                                  s.symbol_name,
+                                  hsa_symbol_linkage_t(s.linkage),
+                                  true, // is_definition
+                                  s.kernarg_segment_size,
+                                  s.kernarg_segment_alignment,
+                                  s.group_segment_size,
+                                  s.private_segment_size,
+                                  s.is_dynamic_callstack,
+                                  s.size,
+                                  s.alignment,
+                                  address);
+      } else {
+        symbol = new VariableSymbol(true,
+                                    s.module_name,
+                                    s.symbol_name,
+                                    hsa_symbol_linkage_t(s.linkage),
+                                    true, // is_definition
+                                    hsa_variable_allocation_t(s.allocation),
+                                    hsa_variable_segment_t(s.segment),
+                                    s.size,
+                                    s.alignment,
+                                    s.is_constant,
+                                    false,
+                                    address);
+      }
+
+      bool inserted;
+      if (agent.handle != 0) {
+        symbol->agent = agent;
+        inserted = agent_symbols_.Insert(s.name, agent, symbol);
+      } else {
+        hsa_agent_t no_agent = {0};
+        inserted = program_symbols_.Insert(s.name, no_agent, symbol);
+      }
+      if (!inserted) {
+        delete symbol;
+        // TODO(spec): this is not spec compliant.
+        return HSA_STATUS_ERROR_VARIABLE_ALREADY_DEFINED;
+      }
+    }
+  }
+  return HSA_STATUS_SUCCESS;
+}
+
+LoadedCodeObjectImpl* ExecutableImpl::LoadingCodeObject(hsa_agent_t agent)
+{
+  for (size_t i = loading_begin_; i < loaded_code_objects.size(); ++i) {
+    if (loaded_code_objects[i]->Agent().handle == agent.handle) {
+      return loaded_code_objects[i];
+    }
+  }
+  return loaded_code_objects.back();
+}
+
+Segment* ExecutableImpl::VirtualAddressSegment(hsa_agent_t agent, uint64_t vaddr)
 {
-  for (auto &seg : loaded_code_objects.back()->LoadedSegments()) {
+  for (auto &seg : LoadingCodeObject(agent)->LoadedSegments()) {
     if (seg->IsAddressInSegment(vaddr)) {
       return seg;
     }
@@ -1450,7 +1988,7 @@ Segment* ExecutableImpl::SymbolSegment(hsa_agent_t agent, code::Symbol* sym)
 
 Segment* ExecutableImpl::SectionSegment(hsa_agent_t agent, code::Section* sec)
 {
-  for (Segment* seg : loaded_code_objects.back()->LoadedSegments()) {
+  for (Segment* seg : LoadingCodeObject(agent)->LoadedSegments()) {
     if (seg->IsAddressInSegment(sec->addr())) {
       return seg;
     }
@@ -1460,8 +1998,11 @@ Segment* ExecutableImpl::SectionSegment(hsa_agent_t agent, code::Section* sec)
 
 hsa_status_t ExecutableImpl::ApplyRelocations(hsa_agent_t agent, amd::hsa::code::AmdHsaCode *c)
 {
+  auto start = std::chrono::steady_clock::now();
+  uint64_t count = 0;
   hsa_status_t status = HSA_STATUS_SUCCESS;
   for (size_t i = 0; i < c->RelocationSectionCount(); ++i) {
+    count += c->GetRelocationSection(i)->relocationCount();
     if (c->GetRelocationSection(i)->targetSection()) {
       status = ApplyStaticRelocationSection(agent, c->GetRelocationSection(i));
     } else {
@@ -1480,6 +2021,9 @@ hsa_status_t ExecutableImpl::ApplyRelocations(hsa_agent_t agent, amd::hsa::code:
     }
     if (status != HSA_STATUS_SUCCESS) { return status; }
   }
+  auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start);
+  LoadingCodeObject(agent)->AddRelocationStats(count, time.count());
   return HSA_STATUS_SUCCESS;
 }
 
@@ -1654,43 +2198,37 @@ hsa_status_t ExecutableImpl::ApplyStaticRelocation(hsa_agent_t agent, amd::hsa::
 
 hsa_status_t ExecutableImpl::ApplyDynamicRelocationSection(hsa_agent_t agent, amd::hsa::code::RelocationSection* sec)
 {
+  // Tables of pointers relocate many times against the same few symbols.
+  SymbolAddressCache symbol_addresses;
   hsa_status_t status = HSA_STATUS_SUCCESS;
   for (size_t i = 0; i < sec->relocationCount(); ++i) {
-    status = ApplyDynamicRelocation(agent, sec->relocation(i));
+    status = ApplyDynamicRelocation(agent, sec->relocation(i), symbol_addresses);
     if (status != HSA_STATUS_SUCCESS) { return status; }
   }
   return HSA_STATUS_SUCCESS;
 }
 
-hsa_status_t ExecutableImpl::ApplyDynamicRelocation(hsa_agent_t agent, amd::hsa::code::Relocation *rel)
+hsa_status_t ExecutableImpl::ApplyDynamicRelocation(hsa_agent_t agent, amd::hsa::code::Relocation *rel,
+                                                    SymbolAddressCache &symbol_addresses)
 {
-  Segment* relSeg = VirtualAddressSegment(rel->offset());
-  uint64_t symAddr = 0;
-  switch (rel->symbol()->type()) {
-    case STT_OBJECT:
-    case STT_AMDGPU_HSA_KERNEL:
-    case STT_FUNC:
-    {
-      Segment* symSeg = VirtualAddressSegment(rel->symbol()->value());
-      symAddr = reinterpret_cast<uint64_t>(symSeg->Address(rel->symbol()->value()));
-      break;
-    }
+  Segment* relSeg = VirtualAddressSegment(agent, rel->offset());
 
-    // External symbols, they must be defined prior loading.
-    case STT_NOTYPE:
-    {
-      // TODO: Only agent allocation variables are supported in v2.1. How will
-      // we distinguish between program allocation and agent allocation
-      // variables?
-      auto agent_symbol = agent_symbols_.find(std::make_pair(rel->symbol()->name(), agent));
-      if (agent_symbol != agent_symbols_.end())
-        symAddr = agent_symbol->second->address;
-      break;
-    }
+  // Relative relocations do not refer to a symbol.
+  if (rel->type() == R_AMDGPU_RELATIVE64) {
+    int64_t baseDelta = reinterpret_cast<uint64_t>(relSeg->Address(0)) - relSeg->VAddr();
+    uint64_t relocatedAddr = baseDelta + rel->addend();
+    relSeg->Copy(rel->offset(), &relocatedAddr, sizeof(relocatedAddr));
+    return HSA_STATUS_SUCCESS;
+  }
 
-    default:
-      // Only objects and kernels are supported in v2.1.
-      return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+  uint64_t symAddr = 0;
+  auto cached = symbol_addresses.find(rel->symbolIndex());
+  if (cached != symbol_addresses.end()) {
+    symAddr = cached->second;
+  } else {
+    hsa_status_t status = ResolveRelocationSymbol(agent, rel, &symAddr);
+    if (status != HSA_STATUS_SUCCESS) { return status; }
+    symbol_addresses[rel->symbolIndex()] = symAddr;
   }
   symAddr += rel->addend();
 
@@ -1724,17 +2262,43 @@ hsa_status_t ExecutableImpl::ApplyDynamicRelocation(hsa_agent_t agent, amd::hsa:
       break;
     }
 
-    case R_AMDGPU_RELATIVE64:
+    default:
+      return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+  }
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t ExecutableImpl::ResolveRelocationSymbol(hsa_agent_t agent, amd::hsa::code::Relocation *rel,
+                                                     uint64_t *address)
+{
+  uint64_t symAddr = 0;
+  switch (rel->symbol()->type()) {
+    case STT_OBJECT:
+    case STT_AMDGPU_HSA_KERNEL:
+    case STT_FUNC:
+    {
+      Segment* symSeg = VirtualAddressSegment(agent, rel->symbol()->value());
+      symAddr = reinterpret_cast<uint64_t>(symSeg->Address(rel->symbol()->value()));
+      break;
+    }
+
+    // External symbols, they must be defined prior loading.
+    case STT_NOTYPE:
     {
-      int64_t baseDelta = reinterpret_cast<uint64_t>(relSeg->Address(0)) - relSeg->VAddr();
-      uint64_t relocatedAddr = baseDelta + rel->addend();
-      relSeg->Copy(rel->offset(), &relocatedAddr, sizeof(relocatedAddr));
+      // TODO: Only agent allocation variables are supported in v2.1. How will
+      // we distinguish between program allocation and agent allocation
+      // variables?
+      SymbolImpl* agent_symbol = agent_symbols_.Find(rel->symbol()->name(), agent);
+      if (agent_symbol)
+        symAddr = agent_symbol->address;
       break;
     }
 
     default:
+      // Only objects and kernels are supported in v2.1.
       return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
   }
+  *address = symAddr;
   return HSA_STATUS_SUCCESS;
 }
 
@@ -1751,6 +2315,47 @@ hsa_status_t ExecutableImpl::Freeze(const char *options) {
   }
 
   state_ = HSA_EXECUTABLE_STATE_FROZEN;
+  frozen_.store(true, std::memory_order_release);
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t ExecutableImpl::GetKernels(hsa_amd_executable_kernel_t *kernels,
+                                        uint32_t *count) {
+  assert(count);
+  // Frozen symbol tables are read without the lock, see GetSymbol.
+  if (!frozen_.load(std::memory_order_acquire)) {
+    return HSA_STATUS_ERROR_INVALID_EXECUTABLE;
+  }
+
+  uint32_t capacity = kernels ? *count : 0;
+  uint32_t total = 0;
+  SymbolMap *maps[] = {&agent_symbols_, &program_symbols_};
+  for (SymbolMap *map : maps) {
+    for (auto &symbol_entry : *map) {
+      SymbolImpl *symbol = symbol_entry.second.symbol;
+      if (!symbol->IsKernel()) { continue; }
+      if (total < capacity) {
+        const KernelSymbol *kernel = static_cast<const KernelSymbol*>(symbol);
+        const std::string &name = symbol_entry.second.name;
+        hsa_amd_executable_kernel_t &out = kernels[total];
+        memset(&out, 0, sizeof(out));
+        // Plain byte-wise FNV-1a, as documented for name_hash.
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (char c : name) { hash = (hash ^ uint8_t(c)) * 0x100000001b3ULL; }
+        out.name_hash = hash;
+        out.kernel_object = kernel->address;
+        out.symbol = Symbol::Handle(symbol);
+        if (map == &agent_symbols_) { out.agent = kernel->agent; }
+        out.kernarg_segment_size = kernel->kernarg_segment_size;
+        out.kernarg_segment_alignment = kernel->kernarg_segment_alignment;
+        out.group_segment_size = kernel->group_segment_size;
+        out.private_segment_size = kernel->private_segment_size;
+        out.is_dynamic_callstack = kernel->is_dynamic_callstack ? 1 : 0;
+      }
+      ++total;
+    }
+  }
+  *count = total;
   return HSA_STATUS_SUCCESS;
 }
 
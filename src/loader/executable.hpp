@@ -44,10 +44,13 @@
 #define HSA_RUNTIME_CORE_LOADER_EXECUTABLE_HPP_
 
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cstdint>
 #include <libelf.h>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -64,6 +67,7 @@ namespace hsa {
 namespace loader {
 
 class MemoryAddress;
+struct Snapshot;
 class SymbolImpl;
 class KernelSymbol;
 class VariableSymbol;
@@ -257,14 +261,21 @@ private:
   const void *elf_data;
   const size_t elf_size;
   std::vector<Segment*> loaded_segments;
+  uint64_t relocation_count;
+  uint64_t relocation_time;
 
 public:
   LoadedCodeObjectImpl(ExecutableImpl *owner_, hsa_agent_t agent_, const void *elf_data_, size_t elf_size_)
-    : ExecutableObject(owner_, agent_), elf_data(elf_data_), elf_size(elf_size_) {}
+    : ExecutableObject(owner_, agent_), elf_data(elf_data_), elf_size(elf_size_),
+      relocation_count(0), relocation_time(0) {}
 
   const void* ElfData() const { return elf_data; }
   size_t ElfSize() const { return elf_size; }
   std::vector<Segment*>& LoadedSegments() { return loaded_segments; }
+  void AddRelocationStats(uint64_t count, uint64_t time_ns) {
+    relocation_count += count;
+    relocation_time += time_ns;
+  }
 
   bool GetInfo(amd_loaded_code_object_info_t attribute, void *value) override;
 
@@ -286,6 +297,8 @@ public:
   uint64_t getLoadBase() const override;
   uint64_t getLoadSize() const override;
   int64_t getDelta() const override;
+  uint64_t getRelocationCount() const override { return relocation_count; }
+  uint64_t getRelocationTime() const override { return relocation_time; }
 };
 
 class Segment : public LoadedSegment, public ExecutableObject {
@@ -344,23 +357,127 @@ public:
   void Destroy() override;
 };
 
-typedef std::string ProgramSymbol;
-typedef std::unordered_map<ProgramSymbol, SymbolImpl*> ProgramSymbolMap;
+/// @returns FNV-1a hash of the @p size bytes at @p data, seeded with @p seed.
+uint64_t HashBytes(const void *data, size_t size, uint64_t seed = 0);
 
-typedef std::pair<std::string, hsa_agent_t> AgentSymbol;
-struct ASC {
-  bool operator()(const AgentSymbol &las, const AgentSymbol &ras) const {
-    return las.first == ras.first && las.second.handle == ras.second.handle;
+/// @brief Symbol table keyed by name and agent. Lookups hash the caller's
+/// name in place, so they neither copy it nor allocate.
+class SymbolMap final {
+public:
+  struct Entry {
+    std::string name;
+    uint64_t agent;
+    SymbolImpl *symbol;
+  };
+  typedef std::unordered_multimap<uint64_t, Entry> Table;
+
+  SymbolImpl* Find(const char *name, size_t length, hsa_agent_t agent) const;
+  SymbolImpl* Find(const std::string &name, hsa_agent_t agent) const {
+    return Find(name.data(), name.size(), agent);
   }
-};
-struct ASH {
-  size_t operator()(const AgentSymbol &as) const {
-    size_t h = std::hash<std::string>()(as.first);
-    size_t i = std::hash<uint64_t>()(as.second.handle);
-    return h ^ (i << 1);
+
+  /// Adds @p symbol under @p name and @p agent. Returns false, leaving the
+  /// table unchanged, if the pair is already taken.
+  bool Insert(const std::string &name, hsa_agent_t agent, SymbolImpl *symbol);
+
+  Table::iterator begin() { return table_.begin(); }
+  Table::iterator end() { return table_.end(); }
+
+private:
+  static uint64_t Hash(const char *name, size_t length, uint64_t agent) {
+    return HashBytes(name, length, agent);
   }
+
+  Table table_;
+};
+
+/// Program symbols are keyed with a null agent.
+typedef SymbolMap ProgramSymbolMap;
+typedef SymbolMap AgentSymbolMap;
+
+//===----------------------------------------------------------------------===//
+// CodeObjectCache.                                                           //
+//===----------------------------------------------------------------------===//
+
+/// @brief Parsed code objects shared by all executables of a loader, keyed by
+/// a hash of the ELF contents and evicted least recently used first.
+class CodeObjectCache final {
+public:
+  struct Entry {
+    /// Serializes loads from the parsed code object, which libelf does not
+    /// guarantee to be safe for concurrent use.
+    std::mutex lock;
+    std::shared_ptr<code::AmdHsaCode> code;
+    uint64_t hash;
+  };
+
+  /// Larger code objects are parsed in place instead of copied into the
+  /// cache.
+  static const size_t kMaxEntrySize = 64 * 1024 * 1024;
+
+  explicit CodeObjectCache(size_t capacity) : capacity_(capacity) {}
+
+  /// @returns the entry for the @p size bytes of ELF at @p elf, parsing a
+  /// private copy of the ELF on a miss, or null if it is not a valid ELF.
+  std::shared_ptr<Entry> Acquire(const void *elf, size_t size);
+
+private:
+  CodeObjectCache(const CodeObjectCache&);
+  CodeObjectCache& operator=(const CodeObjectCache&);
+
+  const size_t capacity_;
+  std::mutex lock_;
+  /// Most recently used first.
+  std::list<std::shared_ptr<Entry>> entries_;
+};
+
+//===----------------------------------------------------------------------===//
+// SegmentIndex.                                                              //
+//===----------------------------------------------------------------------===//
+
+/// @brief Loaded segments of every executable of a loader, sorted by device
+/// address.
+///
+/// Lookups never take the loader lock, they only count themselves as readers
+/// of the current index.  Writers publish a new copy of the index and wait for
+/// the readers of the previous copy before freeing it, so a segment found by a
+/// lookup stays valid until the lookup ends.
+class SegmentIndex final {
+public:
+  explicit SegmentIndex(Context *context)
+    : context_(context), entries_(new std::vector<Entry>()), readers_(0) {}
+  ~SegmentIndex() { delete entries_.load(); }
+
+  /// Index @p segments of @p executable.
+  void Add(Executable *executable, const std::vector<Segment*> &segments);
+
+  /// Drop every segment of @p executable.  After return no lookup uses them.
+  void Remove(Executable *executable);
+
+  /// @returns the host address of @p device_address, 0 if it is in no
+  /// segment.  Stores the owning executable in @p executable if not null.
+  uint64_t Find(uint64_t device_address, Executable **executable);
+
+private:
+  SegmentIndex(const SegmentIndex&);
+  SegmentIndex& operator=(const SegmentIndex&);
+
+  struct Entry {
+    uint64_t base;
+    uint64_t size;
+    Executable *executable;
+    Segment *segment;
+  };
+
+  /// Swap in @p entries and free the previous index once unused.  Caller
+  /// holds ::writer_lock_.
+  void Publish(std::vector<Entry> *entries);
+
+  Context *context_;
+  std::atomic<std::vector<Entry>*> entries_;
+  std::atomic<uint32_t> readers_;
+  std::mutex writer_lock_;
 };
-typedef std::unordered_map<AgentSymbol, SymbolImpl*, ASH, ASC> AgentSymbolMap;
 
 class ExecutableImpl final: public Executable {
 public:
@@ -374,6 +491,8 @@ public:
   ExecutableImpl(
       const hsa_profile_t &_profile,
       Context *context,
+      CodeObjectCache *code_cache,
+      SegmentIndex *segment_index,
       size_t id,
       hsa_default_float_rounding_mode_t default_float_rounding_mode);
 
@@ -403,8 +522,19 @@ public:
     const char *options,
     hsa_loaded_code_object_t *loaded_code_object) override;
 
+  hsa_status_t LoadCodeObjects(
+    const hsa_agent_t *agents,
+    size_t num_agents,
+    hsa_code_object_t code_object,
+    size_t code_object_size,
+    const char *options,
+    hsa_loaded_code_object_t *loaded_code_objects) override;
+
   hsa_status_t Freeze(const char *options) override;
 
+  hsa_status_t GetKernels(hsa_amd_executable_kernel_t *kernels,
+                          uint32_t *count) override;
+
   hsa_status_t Validate(uint32_t *result) override {
     amd::hsa::common::ReaderLockGuard<amd::hsa::common::ReaderWriterLock> reader_lock(rw_lock_);
     assert(result);
@@ -468,7 +598,7 @@ private:
   ExecutableImpl(const ExecutableImpl &e);
   ExecutableImpl& operator=(const ExecutableImpl &e);
 
-  std::unique_ptr<amd::hsa::code::AmdHsaCode> code;
+  std::shared_ptr<amd::hsa::code::AmdHsaCode> code;
 
   Symbol* GetSymbolInternal(
     const char *symbol_name,
@@ -481,7 +611,11 @@ private:
   hsa_status_t LoadSegmentV1(hsa_agent_t agent, const code::Segment *s);
   hsa_status_t LoadSegmentV2(const code::Segment *data_segment,
                              loader::Segment *load_segment);
+  /// Loads the segments of every agent in @p agents and applies their
+  /// relocations, one thread per agent. Code object v2 and later only.
+  hsa_status_t LoadSegmentsParallel(const hsa_agent_t *agents, size_t num_agents);
 
+  hsa_status_t LoadSymbols(hsa_agent_t agent, uint32_t majorVersion);
   hsa_status_t LoadSymbol(hsa_agent_t agent, amd::hsa::code::Symbol* sym, uint32_t majorVersion);
   hsa_status_t LoadDefinitionSymbol(hsa_agent_t agent, amd::hsa::code::Symbol* sym, uint32_t majorVersion);
   hsa_status_t LoadDeclarationSymbol(hsa_agent_t agent, amd::hsa::code::Symbol* sym, uint32_t majorVersion);
@@ -490,9 +624,25 @@ private:
   hsa_status_t ApplyStaticRelocationSection(hsa_agent_t agent, amd::hsa::code::RelocationSection* sec);
   hsa_status_t ApplyStaticRelocation(hsa_agent_t agent, amd::hsa::code::Relocation *rel);
   hsa_status_t ApplyDynamicRelocationSection(hsa_agent_t agent, amd::hsa::code::RelocationSection* sec);
-  hsa_status_t ApplyDynamicRelocation(hsa_agent_t agent, amd::hsa::code::Relocation *rel);
-
-  Segment* VirtualAddressSegment(uint64_t vaddr);
+  /// Resolved symbol addresses of one relocation section, by symbol index.
+  typedef std::unordered_map<uint32_t, uint64_t> SymbolAddressCache;
+  hsa_status_t ApplyDynamicRelocation(hsa_agent_t agent, amd::hsa::code::Relocation *rel,
+                                      SymbolAddressCache &symbol_addresses);
+  hsa_status_t ResolveRelocationSymbol(hsa_agent_t agent, amd::hsa::code::Relocation *rel,
+                                       uint64_t *address);
+
+  /// Captures the code object just loaded for @p agent, before freezing.
+  /// Returns false if it cannot be loaded from a snapshot, e.g. because it
+  /// refers to external symbols.
+  bool TakeSnapshot(hsa_agent_t agent, Snapshot &snapshot);
+  /// Loads @p snapshot of the code object at @p elf_data for every agent in
+  /// @p agents, in place of parsing and relocating it.
+  hsa_status_t LoadSnapshot(const hsa_agent_t *agents, size_t num_agents,
+                            const Snapshot &snapshot, const void *elf_data);
+
+  /// Returns the code object being loaded for @p agent.
+  LoadedCodeObjectImpl* LoadingCodeObject(hsa_agent_t agent);
+  Segment* VirtualAddressSegment(hsa_agent_t agent, uint64_t vaddr);
   uint64_t SymbolAddress(hsa_agent_t agent, amd::hsa::code::Symbol* sym);
   uint64_t SymbolAddress(hsa_agent_t agent, amd::elf::Symbol* sym);
   Segment* SymbolSegment(hsa_agent_t agent, amd::hsa::code::Symbol* sym);
@@ -501,15 +651,25 @@ private:
   amd::hsa::common::ReaderWriterLock rw_lock_;
   hsa_profile_t profile_;
   Context *context_;
+  CodeObjectCache *code_cache_;
+  SegmentIndex *segment_index_;
   const size_t id_;
   hsa_default_float_rounding_mode_t default_float_rounding_mode_;
   hsa_executable_state_t state_;
+  /// Set once frozen, after which the symbol tables are read without locking.
+  std::atomic<bool> frozen_;
 
   ProgramSymbolMap program_symbols_;
   AgentSymbolMap agent_symbols_;
   std::vector<ExecutableObject*> objects;
   Segment *program_allocation_segment;
   std::vector<LoadedCodeObjectImpl*> loaded_code_objects;
+  /// Index of the first loaded code object created by the current load.
+  size_t loading_begin_;
+
+  /// Add the segments of the code objects created by the current load to
+  /// ::segment_index_.
+  void IndexLoadedSegments();
 };
 
 class AmdHsaCodeLoader : public Loader {
@@ -517,10 +677,15 @@ private:
   Context* context;
   std::vector<Executable*> executables;
   amd::hsa::common::ReaderWriterLock rw_lock_;
+  CodeObjectCache code_cache;
+  SegmentIndex segment_index;
+
+  static const size_t kCodeCacheCapacity = 32;
 
 public:
   AmdHsaCodeLoader(Context* context_)
-    : context(context_) { assert(context); }
+    : context(context_), code_cache(kCodeCacheCapacity), segment_index(context_)
+    { assert(context); }
 
   Context* GetContext() const override { return context; }
 
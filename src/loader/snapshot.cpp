@@ -0,0 +1,243 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2026, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "snapshot.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+namespace amd {
+namespace hsa {
+namespace loader {
+
+namespace {
+
+const uint32_t kSnapshotMagic = 0x50414e53; // "SNAP"
+/// Bumped whenever the layout below changes.
+const uint32_t kSnapshotVersion = 2;
+
+class SnapshotWriter {
+public:
+  explicit SnapshotWriter(std::ostream &out) : out_(out) {}
+
+  template <typename T> void Put(const T &value) {
+    out_.write(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+  void Put(const std::string &value) {
+    Put(uint64_t(value.size()));
+    out_.write(value.data(), value.size());
+  }
+
+private:
+  std::ostream &out_;
+};
+
+class SnapshotReader {
+public:
+  SnapshotReader(const char *data, size_t size) : data_(data), size_(size), pos_(0) {}
+
+  template <typename T> bool Get(T &value) {
+    if (size_ - pos_ < sizeof(value)) { return false; }
+    memcpy(&value, data_ + pos_, sizeof(value));
+    pos_ += sizeof(value);
+    return true;
+  }
+  bool Get(std::string &value) {
+    uint64_t length;
+    if (!Get(length) || size_ - pos_ < length) { return false; }
+    value.assign(data_ + pos_, length);
+    pos_ += length;
+    return true;
+  }
+  bool Get(std::vector<char> &value) {
+    uint64_t length;
+    if (!Get(length) || size_ - pos_ < length) { return false; }
+    value.assign(data_ + pos_, data_ + pos_ + length);
+    pos_ += length;
+    return true;
+  }
+  /// @returns whether @p count records of at least @p size bytes each fit in
+  /// the rest of the file, which bounds allocations for corrupt counts.
+  bool Fits(uint64_t count, size_t size) const {
+    return count <= (size_ - pos_) / size;
+  }
+
+private:
+  const char *data_;
+  size_t size_;
+  size_t pos_;
+};
+
+}
+
+std::string Snapshot::FileName(const std::string &dir, uint64_t elf_hash)
+{
+  std::ostringstream name;
+  name << dir << "/amdcode-" << std::hex << elf_hash << ".snapshot";
+  return name.str();
+}
+
+bool Snapshot::Read(const std::string &file)
+{
+  std::ifstream in(file, std::ios::in | std::ios::binary);
+  if (!in) { return false; }
+  std::vector<char> buffer((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  if (in.bad()) { return false; }
+
+  SnapshotReader reader(buffer.data(), buffer.size());
+  uint32_t magic, version;
+  if (!reader.Get(magic) || magic != kSnapshotMagic) { return false; }
+  if (!reader.Get(version) || version != kSnapshotVersion) { return false; }
+  if (!reader.Get(elf_hash) || !reader.Get(elf_size) || !reader.Get(elf) ||
+      !reader.Get(isa) ||
+      !reader.Get(profile) || !reader.Get(vaddr) || !reader.Get(size) ||
+      !reader.Get(storage_offset) || !reader.Get(image)) {
+    return false;
+  }
+  if (elf.size() != elf_size || image.size() > size) { return false; }
+
+  uint64_t count;
+  const size_t fixup_size = sizeof(uint64_t) + sizeof(uint32_t) + sizeof(int64_t);
+  if (!reader.Get(count) || !reader.Fits(count, fixup_size)) { return false; }
+  fixups.resize(count);
+  for (Fixup &fixup : fixups) {
+    if (!reader.Get(fixup.vaddr) || !reader.Get(fixup.type) || !reader.Get(fixup.target)) {
+      return false;
+    }
+  }
+
+  if (!reader.Get(count) || !reader.Fits(count, 3 * sizeof(uint64_t))) { return false; }
+  symbols.resize(count);
+  for (Symbol &symbol : symbols) {
+    if (!reader.Get(symbol.name) || !reader.Get(symbol.module_name) ||
+        !reader.Get(symbol.symbol_name) || !reader.Get(symbol.kind) ||
+        !reader.Get(symbol.linkage) || !reader.Get(symbol.offset) ||
+        !reader.Get(symbol.size) || !reader.Get(symbol.alignment) ||
+        !reader.Get(symbol.kernarg_segment_size) ||
+        !reader.Get(symbol.kernarg_segment_alignment) ||
+        !reader.Get(symbol.group_segment_size) ||
+        !reader.Get(symbol.private_segment_size) ||
+        !reader.Get(symbol.is_dynamic_callstack) ||
+        !reader.Get(symbol.allocation) || !reader.Get(symbol.segment) ||
+        !reader.Get(symbol.is_constant)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Snapshot::Write(const std::string &file) const
+{
+  // Unique enough between the processes and executables racing to write the
+  // same snapshot.
+  std::ostringstream temp;
+  temp << file << ".tmp" << std::hex << reinterpret_cast<uintptr_t>(this)
+       << std::chrono::steady_clock::now().time_since_epoch().count();
+
+  {
+    std::ofstream out(temp.str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out) { return false; }
+
+    SnapshotWriter writer(out);
+    writer.Put(kSnapshotMagic);
+    writer.Put(kSnapshotVersion);
+    writer.Put(elf_hash);
+    writer.Put(elf_size);
+    writer.Put(uint64_t(elf.size()));
+    out.write(elf.data(), elf.size());
+    writer.Put(isa);
+    writer.Put(profile);
+    writer.Put(vaddr);
+    writer.Put(size);
+    writer.Put(storage_offset);
+    writer.Put(uint64_t(image.size()));
+    out.write(image.data(), image.size());
+
+    writer.Put(uint64_t(fixups.size()));
+    for (const Fixup &fixup : fixups) {
+      writer.Put(fixup.vaddr);
+      writer.Put(fixup.type);
+      writer.Put(fixup.target);
+    }
+
+    writer.Put(uint64_t(symbols.size()));
+    for (const Symbol &symbol : symbols) {
+      writer.Put(symbol.name);
+      writer.Put(symbol.module_name);
+      writer.Put(symbol.symbol_name);
+      writer.Put(symbol.kind);
+      writer.Put(symbol.linkage);
+      writer.Put(symbol.offset);
+      writer.Put(symbol.size);
+      writer.Put(symbol.alignment);
+      writer.Put(symbol.kernarg_segment_size);
+      writer.Put(symbol.kernarg_segment_alignment);
+      writer.Put(symbol.group_segment_size);
+      writer.Put(symbol.private_segment_size);
+      writer.Put(symbol.is_dynamic_callstack);
+      writer.Put(symbol.allocation);
+      writer.Put(symbol.segment);
+      writer.Put(symbol.is_constant);
+    }
+
+    out.flush();
+    if (!out) {
+      out.close();
+      std::remove(temp.str().c_str());
+      return false;
+    }
+  }
+
+  if (std::rename(temp.str().c_str(), file.c_str()) != 0) {
+    std::remove(temp.str().c_str());
+    return false;
+  }
+  return true;
+}
+
+} // namespace loader
+} // namespace hsa
+} // namespace amd
@@ -0,0 +1,124 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// The University of Illinois/NCSA
+// Open Source License (NCSA)
+//
+// Copyright (c) 2014-2026, Advanced Micro Devices, Inc. All rights reserved.
+//
+// Developed by:
+//
+//                 AMD Research and AMD HSA Software Development
+//
+//                 Advanced Micro Devices, Inc.
+//
+//                 www.amd.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal with the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimers.
+//  - Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimers in
+//    the documentation and/or other materials provided with the distribution.
+//  - Neither the names of Advanced Micro Devices, Inc,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this Software without specific prior written
+//    permission.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS WITH THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HSA_RUNTIME_CORE_LOADER_SNAPSHOT_HPP_
+#define HSA_RUNTIME_CORE_LOADER_SNAPSHOT_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace amd {
+namespace hsa {
+namespace loader {
+
+//===----------------------------------------------------------------------===//
+// Snapshot.                                                                  //
+//===----------------------------------------------------------------------===//
+
+/// @brief Position independent image of a loaded v2+ code object: its load
+/// segment after relocation, the relocations to redo against a new segment
+/// base, and its symbol table. Loading a snapshot skips ELF parsing, symbol
+/// resolution and relocation processing.
+struct Snapshot {
+  /// Relocation of the slot at @p vaddr to the segment base plus @p target.
+  struct Fixup {
+    uint64_t vaddr;
+    uint32_t type;
+    int64_t target;
+  };
+
+  struct Symbol {
+    /// Symbol table key.
+    std::string name;
+    std::string module_name;
+    std::string symbol_name;
+    uint32_t kind;
+    uint32_t linkage;
+    /// Address relative to the segment base.
+    int64_t offset;
+    uint32_t size;
+    uint32_t alignment;
+    // Kernels.
+    uint32_t kernarg_segment_size;
+    uint32_t kernarg_segment_alignment;
+    uint32_t group_segment_size;
+    uint32_t private_segment_size;
+    bool is_dynamic_callstack;
+    // Variables.
+    uint32_t allocation;
+    uint32_t segment;
+    bool is_constant;
+  };
+
+  uint64_t elf_hash;
+  uint64_t elf_size;
+  /// ELF the snapshot was taken from. The hash only names the file, a
+  /// snapshot is loaded for an ELF with exactly these bytes.
+  std::vector<char> elf;
+  std::string isa;
+  uint32_t profile;
+  uint64_t vaddr;
+  uint64_t size;
+  uint64_t storage_offset;
+  /// Segment contents, without trailing zeros.
+  std::vector<char> image;
+  std::vector<Fixup> fixups;
+  std::vector<Symbol> symbols;
+
+  /// @returns the snapshot file in @p dir for the ELF hashing to @p elf_hash.
+  static std::string FileName(const std::string &dir, uint64_t elf_hash);
+
+  /// Reads @p file. Returns false if it is missing, truncated or written by
+  /// another snapshot format.
+  bool Read(const std::string &file);
+
+  /// Writes @p file through a temporary file, so that concurrent readers
+  /// never see a partial snapshot.
+  bool Write(const std::string &file) const;
+};
+
+} // namespace loader
+} // namespace hsa
+} // namespace amd
+
+#endif // HSA_RUNTIME_CORE_LOADER_SNAPSHOT_HPP_